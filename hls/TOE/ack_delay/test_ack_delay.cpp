@@ -36,6 +36,8 @@ int main()
 {
 	stream<extendedEvent> input;
 	stream<extendedEvent> output;
+	stream<ap_uint<1> > readCountFifo;
+	stream<ap_uint<1> > writeCountFifo;
 
 	extendedEvent ev;
 
@@ -54,7 +56,11 @@ int main()
 			inCount++;
 		}
 
-		ack_delay(input, output);
+		ack_delay(input, output, readCountFifo, writeCountFifo);
+		if (!readCountFifo.empty())
+			readCountFifo.read();
+		if (!writeCountFifo.empty())
+			writeCountFifo.read();
 		count++;
 	}
 
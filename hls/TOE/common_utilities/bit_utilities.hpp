@@ -0,0 +1,226 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _BIT_UTILITIES_HPP_DEFINED_
+#define _BIT_UTILITIES_HPP_DEFINED_
+
+#include "ap_int.h"
+
+/*
+ * Width templated bit utilities. All of them are built as balanced trees,
+ * so the logic depth grows with log2 of the width instead of linearly like
+ * the if/else chains and case statements they replace. Widths must be a
+ * power of two.
+ */
+
+template <int N> struct ceilLog2 	{ static const int value = 1 + ceilLog2<(N + 1) / 2>::value; };
+template <> struct ceilLog2<1> 		{ static const int value = 0; };
+
+
+/**
+ * @brief      Number of bits set
+ */
+template <int W>
+struct popcountTree {
+	static ap_uint<ceilLog2<W+1>::value> compute(ap_uint<W> x) {
+#pragma HLS INLINE
+		ap_uint<ceilLog2<W/2+1>::value> low  = popcountTree<W/2>::compute(x(W/2-1, 0));
+		ap_uint<ceilLog2<W/2+1>::value> high = popcountTree<W/2>::compute(x(W-1, W/2));
+		return low + high;
+	}
+};
+
+template <>
+struct popcountTree<1> {
+	static ap_uint<1> compute(ap_uint<1> x) {
+#pragma HLS INLINE
+		return x;
+	}
+};
+
+template <int W>
+ap_uint<ceilLog2<W+1>::value> popcount(ap_uint<W> x) {
+#pragma HLS INLINE
+	return popcountTree<W>::compute(x);
+}
+
+
+/**
+ * @brief      Leading one detector. The MSB of the result says if any bit is set,
+ *             the remaining bits are the position of the most significant one.
+ *             Only multiplexers, the position of each half is concatenated.
+ */
+template <int W>
+struct leadingOneTree {
+	static const int L = ceilLog2<W>::value;
+	static ap_uint<L+1> compute(ap_uint<W> x) {
+#pragma HLS INLINE
+		ap_uint<L> 	 low  = leadingOneTree<W/2>::compute(x(W/2-1, 0));
+		ap_uint<L> 	 high = leadingOneTree<W/2>::compute(x(W-1, W/2));
+		ap_uint<L+1> result;
+
+		result.bit(L) 		= high.bit(L-1) | low.bit(L-1);
+		result.bit(L-1) 	= high.bit(L-1);
+		if (high.bit(L-1))
+			result(L-2, 0) 	= high(L-2, 0);
+		else
+			result(L-2, 0) 	= low(L-2, 0);
+		return result;
+	}
+};
+
+template <>
+struct leadingOneTree<2> {
+	static ap_uint<2> compute(ap_uint<2> x) {
+#pragma HLS INLINE
+		return (ap_uint<1>(x.bit(1) | x.bit(0)), ap_uint<1>(x.bit(1)));
+	}
+};
+
+template <int W>
+ap_uint<ceilLog2<W>::value+1> leadingOne(ap_uint<W> x) {
+#pragma HLS INLINE
+	return leadingOneTree<W>::compute(x);
+}
+
+/**
+ * @brief      Position of the most significant one plus one, 0 if no bit is set.
+ *             For a keep it is the amount of valid bytes.
+ */
+template <int W>
+ap_uint<ceilLog2<W+1>::value> highestSetBitCount(ap_uint<W> x) {
+#pragma HLS INLINE
+	const int L = ceilLog2<W>::value;
+	ap_uint<L+1> position = leadingOne<W>(x);
+	ap_uint<ceilLog2<W+1>::value> count = 0;
+
+	if (position.bit(L))
+		count = position(L-1, 0) + 1;
+	return count;
+}
+
+
+/**
+ * @brief      Thermometer code, bits [0, n) are set. n in [0, W-1]
+ */
+template <int W>
+struct thermometerTree {
+	static const int L = ceilLog2<W>::value;
+	static ap_uint<W> compute(ap_uint<L> n) {
+#pragma HLS INLINE
+		ap_uint<W/2> half = thermometerTree<W/2>::compute(n(L-2, 0));
+		ap_uint<W> 	 result;
+
+		if (n.bit(L-1)){
+			result(W-1, W/2) 	= half;
+			result(W/2-1, 0) 	= ~ap_uint<W/2>(0);
+		}
+		else {
+			result(W-1, W/2) 	= 0;
+			result(W/2-1, 0) 	= half;
+		}
+		return result;
+	}
+};
+
+template <>
+struct thermometerTree<2> {
+	static ap_uint<2> compute(ap_uint<1> n) {
+#pragma HLS INLINE
+		return ap_uint<2>(n);
+	}
+};
+
+/**
+ * @brief      Mask with bits [0, n) set. n in [0, W]
+ */
+template <int W>
+ap_uint<W> lowMask(ap_uint<ceilLog2<W+1>::value> n) {
+#pragma HLS INLINE
+	const int L = ceilLog2<W>::value;
+	if (n.bit(L))
+		return ~ap_uint<W>(0);
+	else
+		return thermometerTree<W>::compute(n(L-1, 0));
+}
+
+
+/**
+ * @brief      Shifts N elements of E bits to the left by n elements, log2(N) stages
+ *             of 2:1 multiplexers
+ */
+template <int E, int N>
+ap_uint<E*N> elementShiftLeft(ap_uint<E*N> x, ap_uint<ceilLog2<N>::value> n) {
+#pragma HLS INLINE
+	shift_stages: for (int s = 0; s < ceilLog2<N>::value; s++){
+	#pragma HLS UNROLL
+		if (n.bit(s))
+			x = x << (E << s);
+	}
+	return x;
+}
+
+/**
+ * @brief      Funnel shifter. Returns the N elements of E bits that start n elements
+ *             above the bottom of (high, low). n=0 returns low.
+ */
+template <int E, int N>
+ap_uint<E*N> elementFunnelRight(ap_uint<E*N> high, ap_uint<E*N> low, ap_uint<ceilLog2<N>::value> n) {
+#pragma HLS INLINE
+	ap_uint<2*E*N> x = (high, low);
+
+	funnel_stages: for (int s = 0; s < ceilLog2<N>::value; s++){
+	#pragma HLS UNROLL
+		if (n.bit(s))
+			x = x >> (E << s);
+	}
+	return x(E*N-1, 0);
+}
+
+/**
+ * @brief      Expands a keep to a mask of the data, one byte per keep bit
+ */
+template <int N>
+ap_uint<8*N> keep2mask(ap_uint<N> keep) {
+#pragma HLS INLINE
+	ap_uint<8*N> mask;
+	expand_keep: for (int i = 0; i < N; i++){
+	#pragma HLS UNROLL
+		mask(i*8+7, i*8) = keep.bit(i) ? 0xFF : 0x00;
+	}
+	return mask;
+}
+
+#endif
@@ -0,0 +1,294 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "../toe.hpp"
+#include "bit_utilities.hpp"
+
+/*
+ * Synthesis timing comparison between the former priority chain / case
+ * statement implementations of the keep and alignment helpers and the tree
+ * based ones of bit_utilities.hpp. Each pair of top functions computes the
+ * same thing between registers, run scripts/bit_utilities_timing.tcl to get
+ * the estimated clock period of every one of them.
+ * The *_chain functions are also the reference models of the testbench.
+ */
+
+template <int W>
+ap_uint<ceilLog2<W+1>::value> keep2len_chain(ap_uint<W> keepValue){
+#pragma HLS INLINE
+	ap_uint<ceilLog2<W+1>::value> length = 0;
+	priority_chain: for (int i = 0; i < W; i++){			// Same if/else if chain, the last assignment has priority
+	#pragma HLS UNROLL
+		if (keepValue.bit(i))
+			length = i + 1;
+	}
+	return length;
+}
+
+ap_uint<64> len2Keep_table(ap_uint<6> length) {
+#pragma HLS INLINE
+	const ap_uint<64> keep_table[64]={
+		0xFFFFFFFFFFFFFFFF,
+		0x0000000000000001,
+		0x0000000000000003,
+		0x0000000000000007,
+		0x000000000000000F,
+		0x000000000000001F,
+		0x000000000000003F,
+		0x000000000000007F,
+		0x00000000000000FF,
+		0x00000000000001FF,
+		0x00000000000003FF,
+		0x00000000000007FF,
+		0x0000000000000FFF,
+		0x0000000000001FFF,
+		0x0000000000003FFF,
+		0x0000000000007FFF,
+		0x000000000000FFFF,
+		0x000000000001FFFF,
+		0x000000000003FFFF,
+		0x000000000007FFFF,
+		0x00000000000FFFFF,
+		0x00000000001FFFFF,
+		0x00000000003FFFFF,
+		0x00000000007FFFFF,
+		0x0000000000FFFFFF,
+		0x0000000001FFFFFF,
+		0x0000000003FFFFFF,
+		0x0000000007FFFFFF,
+		0x000000000FFFFFFF,
+		0x000000001FFFFFFF,
+		0x000000003FFFFFFF,
+		0x000000007FFFFFFF,
+		0x00000000FFFFFFFF,
+		0x00000001FFFFFFFF,
+		0x00000003FFFFFFFF,
+		0x00000007FFFFFFFF,
+		0x0000000FFFFFFFFF,
+		0x0000001FFFFFFFFF,
+		0x0000003FFFFFFFFF,
+		0x0000007FFFFFFFFF,
+		0x000000FFFFFFFFFF,
+		0x000001FFFFFFFFFF,
+		0x000003FFFFFFFFFF,
+		0x000007FFFFFFFFFF,
+		0x00000FFFFFFFFFFF,
+		0x00001FFFFFFFFFFF,
+		0x00003FFFFFFFFFFF,
+		0x00007FFFFFFFFFFF,
+		0x0000FFFFFFFFFFFF,
+		0x0001FFFFFFFFFFFF,
+		0x0003FFFFFFFFFFFF,
+		0x0007FFFFFFFFFFFF,
+		0x000FFFFFFFFFFFFF,
+		0x001FFFFFFFFFFFFF,
+		0x003FFFFFFFFFFFFF,
+		0x007FFFFFFFFFFFFF,
+		0x00FFFFFFFFFFFFFF,
+		0x01FFFFFFFFFFFFFF,
+		0x03FFFFFFFFFFFFFF,
+		0x07FFFFFFFFFFFFFF,
+		0x0FFFFFFFFFFFFFFF,
+		0x1FFFFFFFFFFFFFFF,
+		0x3FFFFFFFFFFFFFFF,
+		0x7FFFFFFFFFFFFFFF
+	};
+
+	return keep_table[length];
+}
+
+template <int B>
+void align_words_from_memory_case(
+			ap_uint<8*B> 	currData,
+			ap_uint<B> 		currKeep,
+			ap_uint<8*B> 	prevData,
+			ap_uint<B> 		prevKeep,
+			ap_uint<ceilLog2<B>::value> byte_offset,
+			ap_uint<8*B>& 	sendData,
+			ap_uint<B>& 	sendKeep){
+#pragma HLS INLINE
+	sendData = currData;
+	sendKeep = currKeep;
+	offset_case: for (int n = 1; n < B; n++){				// One case per offset
+	#pragma HLS UNROLL
+		if (byte_offset.to_int() == n){
+			sendData = (currData(8*B-1-8*n, 0), prevData(8*n-1, 0));
+			sendKeep = (currKeep(B-1-n, 0), prevKeep(n-1, 0));
+		}
+	}
+}
+
+template <int B>
+void align_words_to_memory_case(
+			ap_uint<8*B> 	currData,
+			ap_uint<B> 		currKeep,
+			ap_uint<8*B> 	prevData,
+			ap_uint<B> 		prevKeep,
+			ap_uint<ceilLog2<B>::value> byte_offset,
+			ap_uint<8*B>& 	sendData,
+			ap_uint<B>& 	sendKeep){
+#pragma HLS INLINE
+	sendData = currData;
+	sendKeep = currKeep;
+	offset_case: for (int n = 1; n < B; n++){
+	#pragma HLS UNROLL
+		if (byte_offset.to_int() == n){
+			sendData = (currData(8*n-1, 0), prevData(8*B-1, 8*n));
+			sendKeep = (currKeep(n-1, 0), prevKeep(B-1, n));
+		}
+	}
+}
+
+template <int B>
+void align_words_from_memory_tree(
+			ap_uint<8*B> 	currData,
+			ap_uint<B> 		currKeep,
+			ap_uint<8*B> 	prevData,
+			ap_uint<B> 		prevKeep,
+			ap_uint<ceilLog2<B>::value> byte_offset,
+			ap_uint<8*B>& 	sendData,
+			ap_uint<B>& 	sendKeep){
+#pragma HLS INLINE
+	ap_uint<B> prevKeepMask = thermometerTree<B>::compute(byte_offset);
+
+	sendData = elementShiftLeft<8,B>(currData, byte_offset) | (prevData & keep2mask<B>(prevKeepMask));
+	sendKeep = elementShiftLeft<1,B>(currKeep, byte_offset) | (prevKeep & prevKeepMask);
+}
+
+template <int B>
+void align_words_to_memory_tree(
+			ap_uint<8*B> 	currData,
+			ap_uint<B> 		currKeep,
+			ap_uint<8*B> 	prevData,
+			ap_uint<B> 		prevKeep,
+			ap_uint<ceilLog2<B>::value> byte_offset,
+			ap_uint<8*B>& 	sendData,
+			ap_uint<B>& 	sendKeep){
+#pragma HLS INLINE
+	if (byte_offset == 0){
+		sendData = currData;
+		sendKeep = currKeep;
+	}
+	else {
+		sendData = elementFunnelRight<8,B>(currData, prevData, byte_offset);
+		sendKeep = elementFunnelRight<1,B>(currKeep, prevKeep, byte_offset);
+	}
+}
+
+/* Top functions, the script registers inputs and outputs */
+
+void keep2len_chain_512(ap_uint<64> keep, ap_uint<7>& length){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	length = keep2len_chain<64>(keep);
+}
+
+void keep2len_tree_512(ap_uint<64> keep, ap_uint<7>& length){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	length = highestSetBitCount<64>(keep);
+}
+
+void keep2len_chain_1024(ap_uint<128> keep, ap_uint<8>& length){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	length = keep2len_chain<128>(keep);
+}
+
+void keep2len_tree_1024(ap_uint<128> keep, ap_uint<8>& length){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	length = highestSetBitCount<128>(keep);
+}
+
+void popcount_tree_1024(ap_uint<128> keep, ap_uint<8>& length){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	length = popcount<128>(keep);
+}
+
+void len2keep_table_512(ap_uint<6> length, ap_uint<64>& keep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	keep = len2Keep_table(length);
+}
+
+void len2keep_tree_512(ap_uint<6> length, ap_uint<64>& keep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	keep = (length == 0) ? ap_uint<64>(~ap_uint<64>(0)) : thermometerTree<64>::compute(length);
+}
+
+void align_from_memory_case_512(ap_uint<512> currData, ap_uint<64> currKeep, ap_uint<512> prevData, ap_uint<64> prevKeep,
+		ap_uint<6> byte_offset, ap_uint<512>& sendData, ap_uint<64>& sendKeep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	align_words_from_memory_case<64>(currData, currKeep, prevData, prevKeep, byte_offset, sendData, sendKeep);
+}
+
+void align_from_memory_tree_512(ap_uint<512> currData, ap_uint<64> currKeep, ap_uint<512> prevData, ap_uint<64> prevKeep,
+		ap_uint<6> byte_offset, ap_uint<512>& sendData, ap_uint<64>& sendKeep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	align_words_from_memory_tree<64>(currData, currKeep, prevData, prevKeep, byte_offset, sendData, sendKeep);
+}
+
+void align_to_memory_case_512(ap_uint<512> currData, ap_uint<64> currKeep, ap_uint<512> prevData, ap_uint<64> prevKeep,
+		ap_uint<6> byte_offset, ap_uint<512>& sendData, ap_uint<64>& sendKeep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	align_words_to_memory_case<64>(currData, currKeep, prevData, prevKeep, byte_offset, sendData, sendKeep);
+}
+
+void align_to_memory_tree_512(ap_uint<512> currData, ap_uint<64> currKeep, ap_uint<512> prevData, ap_uint<64> prevKeep,
+		ap_uint<6> byte_offset, ap_uint<512>& sendData, ap_uint<64>& sendKeep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	align_words_to_memory_tree<64>(currData, currKeep, prevData, prevKeep, byte_offset, sendData, sendKeep);
+}
+
+void align_to_memory_case_1024(ap_uint<1024> currData, ap_uint<128> currKeep, ap_uint<1024> prevData, ap_uint<128> prevKeep,
+		ap_uint<7> byte_offset, ap_uint<1024>& sendData, ap_uint<128>& sendKeep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	align_words_to_memory_case<128>(currData, currKeep, prevData, prevKeep, byte_offset, sendData, sendKeep);
+}
+
+void align_to_memory_tree_1024(ap_uint<1024> currData, ap_uint<128> currKeep, ap_uint<1024> prevData, ap_uint<128> prevKeep,
+		ap_uint<7> byte_offset, ap_uint<1024>& sendData, ap_uint<128>& sendKeep){
+#pragma HLS PIPELINE II=1
+#pragma HLS INTERFACE ap_ctrl_none port=return
+	align_words_to_memory_tree<128>(currData, currKeep, prevData, prevKeep, byte_offset, sendData, sendKeep);
+}
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _UTILITIES_HPP_DEFINED_
 
 #include "../toe.hpp"
+#include "bit_utilities.hpp"
 
 ap_uint<7> keep2len(ap_uint<64> keepValue);
 
@@ -50,13 +51,6 @@ void align_words_from_memory (
 			axiWord& 	SendWord
 	);
 
-void AlingWordFromMemoryStageOne(
-			axiWord 	currWord,
-			axiWord 	prevWord,
-			ap_uint<6>	byte_offset,
-			axiWord& 	SendWord
-	);
-
 void align_words_to_memory (
 			axiWord 	currWord,
 			axiWord 	prevWord,
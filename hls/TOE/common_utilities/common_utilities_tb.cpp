@@ -35,44 +35,205 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "common_utilities.hpp"
 
-
 using namespace hls;
 using namespace std;
 
+/*
+ * Equivalence of the tree based bit utilities with the former implementations.
+ * 16-bit instances are checked exhaustively, 64 and 128-bit ones with every
+ * contiguous keep, every one and two bit pattern and random values. Aligners
+ * are checked for every offset.
+ */
+
+/* Former implementations, see bit_utilities_timing.cpp */
+void keep2len_chain_512(ap_uint<64> keep, ap_uint<7>& length);
+void keep2len_chain_1024(ap_uint<128> keep, ap_uint<8>& length);
+void keep2len_tree_1024(ap_uint<128> keep, ap_uint<8>& length);
+void popcount_tree_1024(ap_uint<128> keep, ap_uint<8>& length);
+void len2keep_table_512(ap_uint<6> length, ap_uint<64>& keep);
+void align_from_memory_case_512(ap_uint<512> currData, ap_uint<64> currKeep, ap_uint<512> prevData, ap_uint<64> prevKeep,
+		ap_uint<6> byte_offset, ap_uint<512>& sendData, ap_uint<64>& sendKeep);
+void align_to_memory_case_512(ap_uint<512> currData, ap_uint<64> currKeep, ap_uint<512> prevData, ap_uint<64> prevKeep,
+		ap_uint<6> byte_offset, ap_uint<512>& sendData, ap_uint<64>& sendKeep);
+void align_to_memory_case_1024(ap_uint<1024> currData, ap_uint<128> currKeep, ap_uint<1024> prevData, ap_uint<128> prevKeep,
+		ap_uint<7> byte_offset, ap_uint<1024>& sendData, ap_uint<128>& sendKeep);
+void align_to_memory_tree_1024(ap_uint<1024> currData, ap_uint<128> currKeep, ap_uint<1024> prevData, ap_uint<128> prevKeep,
+		ap_uint<7> byte_offset, ap_uint<1024>& sendData, ap_uint<128>& sendKeep);
+
+template <int W>
+ap_uint<W> randomBits(){
+	ap_uint<W> value;
+	for (int i = 0; i < W; i += 16)
+		value(((i + 15) < W ? i + 15 : W - 1), i) = rand();
+	return value;
+}
 
-int main()
-{
-	axiWord 	currWord;
-	axiWord 	prevWord;
-	axiWord 	SendWord;
-	ap_uint<6>	byte_offset=1;
-	int i;
+int check_small_widths(){
+	int errors = 0;
+
+	for (unsigned int x = 0; x < 65536; x++){
+		ap_uint<16> value = x;
+		int ones = 0, highest = 0;
+		for (int i = 0; i < 16; i++){
+			if ((x >> i) & 1){
+				ones++;
+				highest = i + 1;
+			}
+		}
+		if (popcount<16>(value).to_int() != ones){
+			cout << "popcount<16>(" << hex << x << ") = " << dec << popcount<16>(value) << " expected " << ones << endl;
+			errors++;
+		}
+		if (highestSetBitCount<16>(value).to_int() != highest){
+			cout << "highestSetBitCount<16>(" << hex << x << ") = " << dec << highestSetBitCount<16>(value) << " expected " << highest << endl;
+			errors++;
+		}
+	}
+
+	for (int n = 0; n <= 16; n++){
+		if (lowMask<16>(n) != ap_uint<16>((1 << n) - 1)){
+			cout << "lowMask<16>(" << dec << n << ") = " << hex << lowMask<16>(n) << endl;
+			errors++;
+		}
+	}
+	return errors;
+}
 
+int check_keep_length(){
+	std::vector<ap_uint<128> > patterns;
+	ap_uint<7> 	tree64, chain64;
+	ap_uint<8> 	tree128, chain128, ones128;
+	int errors = 0;
+
+	for (int n = 0; n <= 128; n++){
+		patterns.push_back(lowMask<128>(n));								// Contiguous keeps
+		for (int m = 0; m < 128; m++){
+			ap_uint<128> twoBits = 0;
+			twoBits.bit(m) = 1;
+			if (n < 128)
+				twoBits.bit(n) = 1;
+			patterns.push_back(twoBits);
+		}
+	}
+	for (int r = 0; r < 100000; r++)
+		patterns.push_back(randomBits<128>() >> (rand() % 128));
+
+	for (size_t p = 0; p < patterns.size(); p++){
+		ap_uint<64> keep64 = patterns[p](63,0);
+
+		tree64 = keep2len(keep64);
+		keep2len_chain_512(keep64, chain64);
+		if (tree64 != chain64){
+			cout << "keep2len(" << hex << keep64 << ") = " << dec << tree64 << " expected " << chain64 << endl;
+			errors++;
+		}
+
+		keep2len_tree_1024(patterns[p], tree128);
+		keep2len_chain_1024(patterns[p], chain128);
+		if (tree128 != chain128){
+			cout << "highestSetBitCount<128>(" << hex << patterns[p] << ") = " << dec << tree128 << " expected " << chain128 << endl;
+			errors++;
+		}
+
+		int ones = 0;
+		for (int i = 0; i < 128; i++)
+			ones += patterns[p].bit(i);
+		popcount_tree_1024(patterns[p], ones128);
+		if (ones128.to_int() != ones){
+			cout << "popcount<128>(" << hex << patterns[p] << ") = " << dec << ones128 << " expected " << ones << endl;
+			errors++;
+		}
+	}
 
-	for (i=0; i < 64 ; i++){
-		prevWord.data(((i*8)+7),i*8) = i;
-		prevWord.keep.bit(i)=1;
+	for (int length = 0; length < 64; length++){
+		ap_uint<64> table;
+		len2keep_table_512(length, table);
+		if (len2Keep(length) != table){
+			cout << "len2Keep(" << dec << length << ") = " << hex << len2Keep(length) << " expected " << table << endl;
+			errors++;
+		}
 	}
+	return errors;
+}
 
-	for (i=0; i < 64 ; i++){
-		currWord.data(((i*8)+7),i*8) = i + 64;
-		currWord.keep.bit(i)=1;
+int check_aligners(){
+	axiWord 	currWord;
+	axiWord 	prevWord;
+	axiWord 	sendWord;
+	ap_uint<512> refData;
+	ap_uint<64> refKeep;
+	int errors = 0;
+
+	for (int r = 0; r < 200; r++){
+		currWord.data = randomBits<512>();
+		currWord.keep = randomBits<64>();
+		prevWord.data = randomBits<512>();
+		prevWord.keep = randomBits<64>();
+
+		for (int offset = 0; offset < 64; offset++){
+			align_words_from_memory(currWord, prevWord, offset, sendWord);
+			align_from_memory_case_512(currWord.data, currWord.keep, prevWord.data, prevWord.keep, offset, refData, refKeep);
+			if (sendWord.data != refData || sendWord.keep != refKeep){
+				cout << "align_words_from_memory offset " << dec << offset << " mismatch" << endl;
+				errors++;
+			}
+
+			align_words_to_memory(currWord, prevWord, offset, sendWord);
+			align_to_memory_case_512(currWord.data, currWord.keep, prevWord.data, prevWord.keep, offset, refData, refKeep);
+			if (sendWord.data != refData || sendWord.keep != refKeep){
+				cout << "align_words_to_memory offset " << dec << offset << " mismatch" << endl;
+				errors++;
+			}
+		}
+
+		ap_uint<1024> 	currData1024 = (currWord.data, prevWord.data);
+		ap_uint<1024> 	prevData1024 = (prevWord.data, currWord.data);
+		ap_uint<128> 	currKeep1024 = (currWord.keep, prevWord.keep);
+		ap_uint<128> 	prevKeep1024 = (prevWord.keep, currWord.keep);
+		ap_uint<1024> 	treeData1024, caseData1024;
+		ap_uint<128> 	treeKeep1024, caseKeep1024;
+		for (int offset = 0; offset < 128; offset++){
+			align_to_memory_tree_1024(currData1024, currKeep1024, prevData1024, prevKeep1024, offset, treeData1024, treeKeep1024);
+			align_to_memory_case_1024(currData1024, currKeep1024, prevData1024, prevKeep1024, offset, caseData1024, caseKeep1024);
+			if (treeData1024 != caseData1024 || treeKeep1024 != caseKeep1024){
+				cout << "align_words_to_memory 1024-bit offset " << dec << offset << " mismatch" << endl;
+				errors++;
+			}
+		}
+
+		/* combine_words drops the IP header but 12 bytes that become the pseudo header */
+		for (int ip_headerlen = 5; ip_headerlen < 16; ip_headerlen++){
+			int shift = ip_headerlen * 4 - 12;
+			combine_words(currWord, prevWord, ip_headerlen, sendWord);
+			for (int b = 0; b < 64; b++){
+				bool fromPrev = (b + shift) < 64;
+				int  source   = fromPrev ? b + shift : b + shift - 64;
+				ap_uint<8> expectedByte = fromPrev ? prevWord.data(source*8+7, source*8) : currWord.data(source*8+7, source*8);
+				ap_uint<1> expectedKeep = fromPrev ? prevWord.keep.bit(source) : currWord.keep.bit(source);
+				if (sendWord.data(b*8+7, b*8) != expectedByte || sendWord.keep.bit(b) != expectedKeep){
+					cout << "combine_words ip_headerlen " << dec << ip_headerlen << " byte " << b << " mismatch" << endl;
+					errors++;
+					break;
+				}
+			}
+		}
 	}
+	return errors;
+}
 
-	cout << "prevWord " << setw(130) << hex << prevWord.data << endl;
-	cout << "currWord " << setw(130) << hex << currWord.data << endl << endl;
+int main()
+{
+	int errors = 0;
 
-	align_words_from_memory (
-			currWord,
-			prevWord,
-			byte_offset,
-			SendWord);
+	srand(1);
+	errors += check_small_widths();
+	errors += check_keep_length();
+	errors += check_aligners();
 
-	AlingWordFromMemoryStageOne(
-			currWord,
-			prevWord,
-			byte_offset,
-			SendWord);
+	if (errors)
+		cout << "Bit utilities: " << dec << errors << " errors" << endl;
+	else
+		cout << "Bit utilities: tree implementations match" << endl;
 
-	return 0;
+	return errors;
 }
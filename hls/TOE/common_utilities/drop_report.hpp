@@ -0,0 +1,117 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _DROP_REPORT_HPP_DEFINED_
+#define _DROP_REPORT_HPP_DEFINED_
+
+#include "ap_int.h"
+#include <hls_stream.h>
+
+// DROP_REPORTS flag, the TOE RX engine, packet_handler and icmp_server report every packet they
+// discard with its reason on m_axis_drop_report, to be counted by the drop_counters block.
+// It adds a port to each of them, off by default, build with -DDROP_REPORTS=1
+#ifndef DROP_REPORTS
+#define DROP_REPORTS 0
+#endif
+
+/**
+ * Reason codes of the packets the network stack discards. Every stage that drops a
+ * packet reports one of them to the drop_counters block, the codes are shared by all
+ * the IPs so the counters of the whole stack live in a single table.
+ */
+typedef ap_uint<8> dropReason;
+
+static const dropReason DROP_NONE 				=  0;		// The packet is not dropped
+// TOE RX engine
+static const dropReason DROP_RX_BAD_CHECKSUM 	=  1;		// TCP checksum is wrong
+static const dropReason DROP_RX_PORT_CLOSED 	=  2;		// Destination port is not open, a RST is sent back
+static const dropReason DROP_RX_LOOKUP_MISS 	=  3;		// Port is open but there is no session and none can be created
+static const dropReason DROP_RX_OUT_OF_WINDOW 	=  4;		// Payload is not in order
+static const dropReason DROP_RX_NO_SPACE 		=  5;		// Payload in order, but the RX buffer is full
+static const dropReason DROP_RX_INVALID_STATE 	=  6;		// Payload in a TCP state that does not accept data
+// packet_handler
+static const dropReason DROP_PH_ETHERTYPE 		=  7;		// Neither ARP nor IPv4
+static const dropReason DROP_PH_PROTOCOL 		=  8;		// IPv4 but not a version 4 ICMP, TCP or UDP packet
+static const dropReason DROP_PH_VLAN 			=  9;		// Unknown VLAN, or IP address of another VLAN
+static const dropReason DROP_PH_FRAGMENT 		= 10;		// IPv4 fragment that cannot be reassembled
+static const dropReason DROP_PH_REASSEMBLY_TIMEOUT = 11;	// Incomplete datagram given up
+// icmp_server
+static const dropReason DROP_ICMP_NOT_FOR_US 	= 12;		// Destination IP address is not ours
+static const dropReason DROP_ICMP_NOT_ECHO 		= 13;		// ICMP message other than echo request
+static const dropReason DROP_ICMP_BAD_CHECKSUM 	= 14;		// IP header checksum is wrong
+// Any source
+static const dropReason DROP_REPORT_LOST 		= 15;		// The report of a drop found its FIFO full, the reason is unknown
+
+#define NUM_DROP_REASONS 16
+
+/**
+ * One dropped packet. Drops that happen once the session is known carry its ID.
+ */
+struct dropReport {
+	dropReason		reason;
+	ap_uint<16>		sessionID;
+	ap_uint<1>		sessionValid;
+	dropReport() {}
+	dropReport(dropReason reason)
+			:reason(reason), sessionID(0), sessionValid(0) {}
+	dropReport(dropReason reason, ap_uint<16> id)
+			:reason(reason), sessionID(id), sessionValid(1) {}
+};
+
+/**
+ * Writes the report of a stage without waiting for the FIFO, so a missing or slow drop_counters
+ * never stalls the data path. A report that finds the FIFO full is only counted in lost, and
+ * each lost report is sent as DROP_REPORT_LOST in a later cycle without a drop, which keeps the
+ * total of drops exact. Called once per cycle, with DROP_NONE when there is nothing to report.
+ */
+inline void reportDrop(
+			hls::stream<dropReport>&	reportOut,
+			dropReport					report,
+			ap_uint<16>&				lost) {
+#pragma HLS INLINE
+
+	if (report.reason != DROP_NONE) {
+		if (!reportOut.full())
+			reportOut.write(report);
+		else if (lost != 0xFFFF)
+			lost++;
+	}
+	else if (lost != 0 && !reportOut.full()) {
+		reportOut.write(dropReport(DROP_REPORT_LOST));
+		lost--;
+	}
+}
+
+#endif
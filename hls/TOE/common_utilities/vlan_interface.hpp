@@ -0,0 +1,59 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _VLAN_INTERFACE_HPP_DEFINED_
+#define _VLAN_INTERFACE_HPP_DEFINED_
+
+#include "ap_int.h"
+
+#define NUM_VLAN_INTERFACES 8
+
+/**
+ * L3 interface bound to a VLAN. The same table is given to the packet_handler, the
+ * ethernet_header_inserter and the arp_server. The packet_handler accepts tagged frames
+ * by VLAN ID and IP address, the other two tag the packets sourced from the interface
+ * and use its MAC address, subnet mask and default gateway.
+ * Addresses are in network byte order as they are in the packet, as myIpAddress.
+ */
+struct vlanInterface {
+	ap_uint<1>		valid;
+	ap_uint<12>		vlanID;
+	ap_uint<32>		ipAddress;
+	ap_uint<48>		macAddress;
+	ap_uint<32>		subNetMask;
+	ap_uint<32>		defaultGateway;
+};
+
+#endif
@@ -46,7 +46,6 @@ void event_engine(	stream<event>&				txApp2eventEng_setEvent,
 					stream<ap_uint<1> >&		txEngFifoReadCount) {
 #pragma HLS PIPELINE II=1
 
-	static ap_uint<1> eventEnginePriority = 0;
 	static ap_uint<8> ee_writeCounter = 0;
 	static ap_uint<8> ee_adReadCounter = 0; //depends on FIFO depth
 	static ap_uint<8> ee_adWriteCounter = 0; //depends on FIFO depth
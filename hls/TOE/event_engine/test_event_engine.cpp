@@ -37,6 +37,9 @@ int main()
 	stream<extendedEvent>		rxEng2eventEng_setEvent;
 	stream<event>				timer2eventEng_setEvent;
 	stream<extendedEvent>		eventEng2txEng_event;
+	stream<ap_uint<1> >			ackDelayFifoReadCount;
+	stream<ap_uint<1> >			ackDelayFifoWriteCount;
+	stream<ap_uint<1> >			txEngFifoReadCount;
 
 	extendedEvent ev;
 	int count=0;
@@ -45,7 +48,10 @@ int main()
 		event_engine(	txApp2eventEng_setEvent,
 						rxEng2eventEng_setEvent,
 						timer2eventEng_setEvent,
-						eventEng2txEng_event);
+						eventEng2txEng_event,
+						ackDelayFifoReadCount,
+						ackDelayFifoWriteCount,
+						txEngFifoReadCount);
 
 		if (count == 20)
 		{
@@ -62,6 +68,7 @@ int main()
 		{
 			eventEng2txEng_event.read(ev);
 			std::cout << ev.type << std::endl;
+			txEngFifoReadCount.write(1);
 		}
 		count++;
 	}
@@ -0,0 +1,206 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "instrumentation.hpp"
+
+#ifndef __SYNTHESIS__
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#endif
+
+/** @ingroup instrumentation
+ *  Bucket of a latency, the number of bits it takes, limited to the last bucket
+ */
+ap_uint<5> instrLatencyBucket(ap_uint<32> latency) {
+#pragma HLS INLINE
+	ap_uint<5> bucket = 0;
+
+	for (int i = 0; i < 32; i++) {
+	#pragma HLS UNROLL
+		if (latency.bit(i))
+			bucket = i + 1;
+	}
+	if (bucket > INSTR_LATENCY_BUCKETS - 1)
+		bucket = INSTR_LATENCY_BUCKETS - 1;
+	return bucket;
+}
+
+/** @ingroup instrumentation
+ *  Builds the latency histogram out of the stamps of the probes. The first packet received
+ *  after a packet was sent starts a measurement, the next packet sent ends it. A stamp of
+ *  both probes in the same cycle cannot be a request and its answer, so the sent one is
+ *  taken first.
+ *  @param[in]		rxStamp, stamps of the packets at ipRxData
+ *  @param[in]		txStamp, stamps of the packets at ipTxData
+ *  @param[in,out]	regs, AXI4-Lite registers
+ */
+void instrCollector(
+			stream<instrStamp>&		rxStamp,
+			stream<instrStamp>&		txStamp,
+			instrRegs&				regs) {
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static ap_uint<32>		ic_histogram[INSTR_LATENCY_BUCKETS];
+	#pragma HLS ARRAY_PARTITION variable=ic_histogram complete dim=1
+	static ap_uint<32>		ic_samples = 0;
+	static ap_uint<32>		ic_max = 0;
+	static ap_uint<64>		ic_sum = 0;
+	static ap_uint<32>		ic_rxPackets = 0;
+	static ap_uint<32>		ic_txPackets = 0;
+	static ap_uint<32>		ic_rxStallCycles = 0;
+	static ap_uint<32>		ic_txStallCycles = 0;
+	static bool				ic_rxPending = false;
+	static ap_uint<32>		ic_rxTime;
+
+	instrStamp				stamp;
+	ap_uint<32>				latency;
+
+	if (!txStamp.empty()) {
+		txStamp.read(stamp);
+		ic_txPackets++;
+		ic_txStallCycles = stamp.stallCycles;
+		if (ic_rxPending) {
+			latency = stamp.time - ic_rxTime;
+			ic_histogram[instrLatencyBucket(latency)]++;
+			ic_samples++;
+			ic_sum += latency;
+			if (latency > ic_max)
+				ic_max = latency;
+			ic_rxPending = false;
+		}
+	}
+	if (!rxStamp.empty()) {
+		rxStamp.read(stamp);
+		ic_rxPackets++;
+		ic_rxStallCycles = stamp.stallCycles;
+		if (!ic_rxPending) {
+			ic_rxTime = stamp.time;
+			ic_rxPending = true;
+		}
+	}
+
+	regs.latencyCount 	= ic_histogram[regs.latencyBucket];
+	regs.latencySamples = ic_samples;
+	regs.latencyMax 	= ic_max;
+	regs.latencySum 	= ic_sum;
+	regs.rxPackets 		= ic_rxPackets;
+	regs.txPackets 		= ic_txPackets;
+	regs.rxStallCycles 	= ic_rxStallCycles;
+	regs.txStallCycles 	= ic_txStallCycles;
+}
+
+#ifndef __SYNTHESIS__
+
+struct instrFifoRecord {
+	std::string		name;
+	std::string		producer;
+	std::string		consumer;
+	unsigned		depth;
+	unsigned		highWater;
+	uint64_t		samples;
+	uint64_t		busyCycles;
+	uint64_t		fullCycles;
+	uint64_t		occupancySum;
+};
+
+static std::map<std::string, instrFifoRecord> instrFifos;
+
+void instrSampleFifo(const char* name, const char* producer, const char* consumer, unsigned occupancy, unsigned depth) {
+	instrFifoRecord& fifo = instrFifos[name];
+
+	if (fifo.samples == 0) {
+		fifo.name 		= name;
+		fifo.producer 	= producer;
+		fifo.consumer 	= consumer;
+		fifo.depth 		= depth;
+	}
+	fifo.samples++;
+	fifo.occupancySum += occupancy;
+	if (occupancy > fifo.highWater)
+		fifo.highWater = occupancy;
+	if (occupancy != 0)
+		fifo.busyCycles++;
+	if (occupancy >= depth)
+		fifo.fullCycles++;
+}
+
+static bool instrMoreFull(const instrFifoRecord* a, const instrFifoRecord* b) {
+	if (a->fullCycles != b->fullCycles)
+		return a->fullCycles > b->fullCycles;
+	return a->highWater * b->depth > b->highWater * a->depth;
+}
+
+/*
+ * Prints the FIFOs that spent most cycles full and the stall cycles of every producer,
+ * the consumer of the first FIFO is the process holding the data path back.
+ */
+void instrBottleneckReport(std::ostream& out, unsigned topFifos) {
+	std::vector<const instrFifoRecord*>		fifos;
+	std::map<std::string, uint64_t>			stalls;
+	std::map<std::string, uint64_t>::iterator 	process;
+	std::vector<std::pair<uint64_t, std::string> > processes;
+
+	for (std::map<std::string, instrFifoRecord>::iterator it = instrFifos.begin(); it != instrFifos.end(); it++) {
+		fifos.push_back(&it->second);
+		stalls[it->second.producer] += it->second.fullCycles;
+	}
+	std::sort(fifos.begin(), fifos.end(), instrMoreFull);
+	for (process = stalls.begin(); process != stalls.end(); process++)
+		processes.push_back(std::make_pair(process->second, process->first));
+	std::sort(processes.rbegin(), processes.rend());
+
+	out << "  ------- FIFOs (" << fifos.size() << " sampled) ------- " << std::endl;
+	out << std::setw(34) << "fifo" << std::setw(8) << "depth" << std::setw(8) << "high" << std::setw(12) << "full" << std::setw(12) << "busy" << std::setw(10) << "average" << std::endl;
+	for (unsigned i = 0; i < fifos.size() && i < topFifos; i++) {
+		const instrFifoRecord* fifo = fifos[i];
+		out << std::setw(34) << fifo->name << std::setw(8) << fifo->depth << std::setw(8) << fifo->highWater;
+		out << std::setw(12) << fifo->fullCycles << std::setw(12) << fifo->busyCycles;
+		out << std::setw(10) << std::fixed << std::setprecision(2) << (double) fifo->occupancySum / fifo->samples << std::endl;
+	}
+	out << "  ------- Producer stall cycles ------- " << std::endl;
+	for (unsigned i = 0; i < processes.size(); i++) {
+		if (processes[i].first != 0)
+			out << std::setw(34) << processes[i].second << " -> " << processes[i].first << std::endl;
+	}
+	if (fifos.empty() || fifos[0]->fullCycles == 0)
+		out << "  Bottleneck: none, no FIFO reached its depth" << std::endl;
+	else
+		out << "  Bottleneck: " << fifos[0]->consumer << ", " << fifos[0]->name << " full for " << fifos[0]->fullCycles << " of " << fifos[0]->samples << " cycles" << std::endl;
+}
+
+#endif
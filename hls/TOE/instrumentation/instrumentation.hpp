@@ -0,0 +1,108 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _INSTRUMENTATION_HPP_
+#define _INSTRUMENTATION_HPP_
+
+#include "../toe.hpp"
+#ifndef __SYNTHESIS__
+#include <ostream>
+#endif
+
+/** @defgroup instrumentation Instrumentation
+ *  @ingroup tcp_module
+ */
+
+struct instrStamp {
+	ap_uint<32>		time;
+	ap_uint<32>		stallCycles;
+	instrStamp() {}
+	instrStamp(ap_uint<32> time, ap_uint<32> stalls)
+			:time(time), stallCycles(stalls) {}
+};
+
+ap_uint<5> instrLatencyBucket(ap_uint<32> latency);
+
+/** @ingroup instrumentation
+ *  Forwards a packet stream, sends the cycle and the number of stall cycles so far when the
+ *  first word of a packet goes through. The ID gives every probe its own state
+ */
+template <int ID>
+void instrProbe(
+			stream<axiWord>&		dataIn,
+			stream<axiWord>&		dataOut,
+			stream<instrStamp>&		stampOut) {
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static ap_uint<32>	ip_cycle = 0;
+	static ap_uint<32>	ip_stallCycles = 0;
+	static bool			ip_firstWord = true;
+	axiWord 			currWord;
+
+	if (!dataIn.empty()) {
+		if (!dataOut.full()) {
+			dataIn.read(currWord);
+			dataOut.write(currWord);
+			if (ip_firstWord)
+				stampOut.write(instrStamp(ip_cycle, ip_stallCycles));
+			ip_firstWord = currWord.last;
+		}
+		else
+			ip_stallCycles++;
+	}
+	ip_cycle++;
+}
+
+void instrCollector(
+			stream<instrStamp>&		rxStamp,
+			stream<instrStamp>&		txStamp,
+			instrRegs&				regs);
+
+#ifndef __SYNTHESIS__
+/*
+ * C simulation only. Every FIFO registered with INSTR_FIFO is sampled once per call,
+ * which is once per cycle. Streams are unbounded in C simulation, a FIFO at or above its
+ * depth is a cycle its producer would have been stalled in hardware.
+ */
+void instrSampleFifo(const char* name, const char* producer, const char* consumer, unsigned occupancy, unsigned depth);
+void instrBottleneckReport(std::ostream& out, unsigned topFifos);
+
+#define INSTR_FIFO(fifo, depth, producer, consumer) instrSampleFifo(#fifo, producer, consumer, fifo.size(), depth)
+#else
+#define INSTR_FIFO(fifo, depth, producer, consumer)
+#endif
+
+#endif
@@ -0,0 +1,364 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "latency_histogram.hpp"
+
+/** @ingroup latency_histogram
+ *  Log-linear bucket of a latency. Latencies below (1 << LAT_SUB_BUCKET_BITS) have their own
+ *  bucket, above every power of two is split in (1 << LAT_SUB_BUCKET_BITS) buckets
+ */
+ap_uint<7> latBucket(ap_uint<32> latency) {
+#pragma HLS INLINE
+	ap_uint<5> 	msb = 0;
+	ap_uint<5>	shift;
+	ap_uint<7>	bucket;
+
+	for (int i = 0; i < 32; i++) {
+	#pragma HLS UNROLL
+		if (latency.bit(i))
+			msb = i;
+	}
+	if (latency < (1 << LAT_SUB_BUCKET_BITS)) {
+		bucket = latency(6, 0);
+	}
+	else {
+		shift 	= msb - LAT_SUB_BUCKET_BITS;
+		bucket 	= ((msb - LAT_SUB_BUCKET_BITS + 1) << LAT_SUB_BUCKET_BITS) | ((latency >> shift) & ((1 << LAT_SUB_BUCKET_BITS) - 1));
+	}
+	return bucket;
+}
+
+/** @ingroup latency_histogram
+ *  Smallest latency of a bucket
+ */
+ap_uint<32> latBucketLow(ap_uint<7> bucket) {
+#pragma HLS INLINE
+	ap_uint<32> low;
+	ap_uint<5>	exponent = bucket >> LAT_SUB_BUCKET_BITS;
+	ap_uint<32>	mantissa = (1 << LAT_SUB_BUCKET_BITS) + bucket(LAT_SUB_BUCKET_BITS-1, 0);
+
+	if (bucket < (1 << LAT_SUB_BUCKET_BITS))
+		low = bucket;
+	else
+		low = mantissa << (exponent - 1);
+	return low;
+}
+
+/** @ingroup latency_histogram
+ *  Follows one application write and one segment per session. A write accepted when the
+ *  session has none pending is timed until the first transmission of the segment that
+ *  carries its first byte, the write to wire latency. A segment sent when the session has
+ *  none pending is timed until the ACK that covers its last byte, the round trip time, a
+ *  retransmission of the session cancels it (Karn). The segments of the TX engine are paired,
+ *  in order, with the sequence numbers of the packets with payload the IP stitcher sends, so
+ *  the time is the one of the packet on the wire.
+ *  The samples go in a log-linear histogram of the group of the session. An open sets the
+ *  group, from the listen port rules for a passive open, otherwise group 0.
+ *  One event or register access is served per cycle, the tables and the histograms are read
+ *  and written once, the write of the previous cycle is forwarded to the read. A clear takes
+ *  2 * LAT_BUCKETS cycles, the events wait. Waiting events are served in the order they
+ *  happen to a segment, application write, packet on the wire and ACK.
+ *  @param[in]		appWriteIn, writes accepted by the TX application interface
+ *  @param[in]		txSegmentIn, segments with payload of the TX engine
+ *  @param[in]		wireSeqIn, sequence numbers of the packets with payload on the wire
+ *  @param[in]		ackIn, ACK numbers and opens of the RX engine
+ *  @param[out]		rttUpdateOut, smoothed RTT of a session for the statistics
+ *  @param[in,out]	regs, AXI4-Lite registers
+ */
+void latency_histogram(
+			stream<latAppWrite>&		appWriteIn,
+			stream<latTxSegment>&		txSegmentIn,
+			stream<ap_uint<32> >&		wireSeqIn,
+			stream<latAck>&				ackIn,
+#if (STATISTICS_MODULE)
+			stream<latRttUpdate>&		rttUpdateOut,
+#endif
+			latencyRegs&				regs) {
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	const int HIST_BITS = 1 + LAT_GROUP_BITS + 7;
+
+	static ap_uint<32>			lh_histogram[2 * (1 << LAT_GROUP_BITS) * LAT_BUCKETS];
+	#pragma HLS RESOURCE variable=lh_histogram core=RAM_T2P_BRAM
+	#pragma HLS DEPENDENCE variable=lh_histogram inter false
+	static latAppEntry			lh_appTable[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=lh_appTable core=RAM_T2P_BRAM
+	#pragma HLS DEPENDENCE variable=lh_appTable inter false
+	static latRttEntry			lh_rttTable[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=lh_rttTable core=RAM_T2P_BRAM
+	#pragma HLS DEPENDENCE variable=lh_rttTable inter false
+
+	static bool						lh_portRuleValid[LAT_PORT_RULES];
+	#pragma HLS ARRAY_PARTITION variable=lh_portRuleValid complete
+	static ap_uint<16>				lh_portRulePort[LAT_PORT_RULES];
+	#pragma HLS ARRAY_PARTITION variable=lh_portRulePort complete
+	static ap_uint<LAT_GROUP_BITS>	lh_portRuleGroup[LAT_PORT_RULES];
+	#pragma HLS ARRAY_PARTITION variable=lh_portRuleGroup complete
+
+	static ap_uint<32>				lh_now = 0;
+	static ap_uint<32>				lh_appSamples = 0;
+	static ap_uint<32>				lh_rttSamples = 0;
+	static ap_uint<1>				lh_readEnable_r = 0;
+	static ap_uint<1>				lh_clear_r = 0;
+	static ap_uint<1>				lh_portWrite_r = 0;
+	static ap_uint<1>				lh_sessionWrite_r = 0;
+	static bool						lh_readPending = false;
+	static bool						lh_sessionWritePending = false;
+	static bool						lh_clearing = false;
+	static ap_uint<LAT_GROUP_BITS>	lh_clearGroup;
+	static ap_uint<8>				lh_clearIndex;
+
+	// Writes of the previous cycle
+	static bool						lh_histValid_r = false;
+	static ap_uint<HIST_BITS>		lh_histIndex_r;
+	static ap_uint<32>				lh_histCount_r;
+	static bool						lh_appValid_r = false;
+	static ap_uint<16>				lh_appID_r;
+	static latAppEntry				lh_appEntry_r;
+	static bool						lh_rttValid_r = false;
+	static ap_uint<16>				lh_rttID_r;
+	static latRttEntry				lh_rttEntry_r;
+
+	latAppWrite				appWrite;
+	latTxSegment			segment;
+	ap_uint<32>				wireSeq;
+	latAck					ack;
+	latAppEntry				appEntry;
+	latRttEntry				rttEntry;
+	ap_uint<16>				id;
+	ap_uint<WINDOW_BITS>	offset;
+	ap_int<34>				srttDiff;
+	ap_uint<HIST_BITS>		histIndex;
+	ap_uint<32>				histCount;
+	bool					histWrite = false;
+	bool					appWriteBack = false;
+	bool					rttWriteBack = false;
+	bool					sample = false;
+	ap_uint<1>				sampleKind;
+	ap_uint<LAT_GROUP_BITS>	sampleGroup;
+	ap_uint<32>				sampleLatency;
+
+	if (regs.readEnable && !lh_readEnable_r) {
+		lh_readPending = true;
+	}
+	if (regs.sessionWrite && !lh_sessionWrite_r && (regs.sessionID < MAX_SESSIONS)) {
+		lh_sessionWritePending = true;
+	}
+	if (regs.clear && !lh_clear_r && !lh_clearing) {
+		lh_clearing 	= true;
+		lh_clearGroup 	= regs.group;
+		lh_clearIndex 	= 0;
+	}
+	if (regs.portWrite && !lh_portWrite_r) {
+		lh_portRuleValid[regs.portRuleID] 	= regs.portRuleValid;
+		lh_portRulePort[regs.portRuleID] 	= regs.listenPort;
+		lh_portRuleGroup[regs.portRuleID] 	= regs.portGroup;
+	}
+
+	if (lh_clearing) {
+		histIndex 	= (lh_clearIndex.bit(7), lh_clearGroup, lh_clearIndex(6, 0));
+		histCount 	= 0;
+		histWrite 	= true;
+		if (lh_clearIndex == 2 * LAT_BUCKETS - 1)
+			lh_clearing = false;
+		lh_clearIndex++;
+	}
+	else if (lh_readPending || lh_sessionWritePending) {
+		id = regs.sessionID;
+		if (lh_rttValid_r && (lh_rttID_r == id))
+			rttEntry = lh_rttEntry_r;
+		else
+			rttEntry = lh_rttTable[id];
+
+		if (lh_readPending) {
+			histIndex = (regs.kind, regs.group, regs.bucket);
+			if (lh_histValid_r && (lh_histIndex_r == histIndex))
+				regs.bucketCount = lh_histCount_r;
+			else
+				regs.bucketCount = lh_histogram[histIndex];
+			regs.sessionRTT = rttEntry.srtt;
+			lh_readPending = false;
+		}
+		else {
+			rttEntry.group = regs.sessionGroup;
+			rttWriteBack = true;
+			lh_sessionWritePending = false;
+		}
+	}
+	else if (!appWriteIn.empty()) {
+		appWriteIn.read(appWrite);
+		id = appWrite.sessionID;
+		if (lh_appValid_r && (lh_appID_r == id))
+			appEntry = lh_appEntry_r;
+		else
+			appEntry = lh_appTable[id];
+
+		if (!appEntry.valid) {
+			appEntry.valid 		= true;
+			appEntry.address 	= appWrite.address;
+			appEntry.time 		= lh_now;
+			appWriteBack 		= true;
+		}
+	}
+	else if (!txSegmentIn.empty() && !wireSeqIn.empty()) {
+		txSegmentIn.read(segment);
+		wireSeqIn.read(wireSeq);
+		id = segment.sessionID;
+		if (lh_appValid_r && (lh_appID_r == id))
+			appEntry = lh_appEntry_r;
+		else
+			appEntry = lh_appTable[id];
+		if (lh_rttValid_r && (lh_rttID_r == id))
+			rttEntry = lh_rttEntry_r;
+		else
+			rttEntry = lh_rttTable[id];
+
+		if (wireSeq == segment.seqNumb) {		// Always, unless the two streams got out of step
+			if (segment.retransmit) {
+				rttEntry.valid = false;
+			}
+			else {
+				offset = appEntry.address - segment.seqNumb(WINDOW_BITS-1, 0);
+				if (appEntry.valid && (offset < segment.length)) {
+					sample 			= true;
+					sampleKind 		= 0;
+					sampleGroup 	= rttEntry.group;
+					sampleLatency 	= lh_now - appEntry.time;
+					appEntry.valid 	= false;
+				}
+				else if (appEntry.valid && offset.bit(WINDOW_BITS-1)) {		// The write was sent before it was seen
+					appEntry.valid 	= false;
+				}
+				if (!rttEntry.valid) {
+					rttEntry.valid 	= true;
+					rttEntry.seqEnd = segment.seqNumb + segment.length;
+					rttEntry.time 	= lh_now;
+				}
+			}
+			appWriteBack = true;
+			rttWriteBack = true;
+		}
+	}
+	else if (!ackIn.empty()) {
+		ackIn.read(ack);
+		id = ack.sessionID;
+		if (lh_rttValid_r && (lh_rttID_r == id))
+			rttEntry = lh_rttEntry_r;
+		else
+			rttEntry = lh_rttTable[id];
+
+		if (ack.open) {
+			rttEntry.valid 	= false;
+			rttEntry.srtt 	= 0;
+			rttEntry.group 	= 0;
+			if (ack.passive) {
+				for (int i = 0; i < LAT_PORT_RULES; i++) {
+				#pragma HLS UNROLL
+					if (lh_portRuleValid[i] && (lh_portRulePort[i] == ack.port))
+						rttEntry.group = lh_portRuleGroup[i];
+				}
+			}
+			appEntry.valid 	= false;
+			appWriteBack 	= true;
+#if (STATISTICS_MODULE)
+			if (!rttUpdateOut.full())
+				rttUpdateOut.write(latRttUpdate(id, 0));
+#endif
+		}
+		else if (rttEntry.valid && !ap_int<32>(ack.ackNumb - rttEntry.seqEnd).bit(31)) {
+			sample 			= true;
+			sampleKind 		= 1;
+			sampleGroup 	= rttEntry.group;
+			sampleLatency 	= lh_now - rttEntry.time;
+			rttEntry.valid 	= false;
+			// RFC 6298, SRTT = 7/8 SRTT + 1/8 R
+			if (rttEntry.srtt == 0) {
+				rttEntry.srtt = sampleLatency;
+			}
+			else {
+				srttDiff 		= ap_int<34>(sampleLatency) - ap_int<34>(rttEntry.srtt);
+				rttEntry.srtt 	= rttEntry.srtt + (srttDiff >> 3);
+			}
+#if (STATISTICS_MODULE)
+			if (!rttUpdateOut.full())
+				rttUpdateOut.write(latRttUpdate(id, rttEntry.srtt));
+#endif
+		}
+		rttWriteBack = true;
+	}
+
+	if (sample) {
+		histIndex = (sampleKind, sampleGroup, latBucket(sampleLatency));
+		if (lh_histValid_r && (lh_histIndex_r == histIndex))
+			histCount = lh_histCount_r + 1;
+		else
+			histCount = lh_histogram[histIndex] + 1;
+		histWrite = true;
+		if (sampleKind == 0)
+			lh_appSamples++;
+		else
+			lh_rttSamples++;
+	}
+
+	if (histWrite) {
+		lh_histogram[histIndex] = histCount;
+		lh_histIndex_r = histIndex;
+		lh_histCount_r = histCount;
+	}
+	if (appWriteBack) {
+		lh_appTable[id] = appEntry;
+		lh_appID_r 		= id;
+		lh_appEntry_r 	= appEntry;
+	}
+	if (rttWriteBack) {
+		lh_rttTable[id] = rttEntry;
+		lh_rttID_r 		= id;
+		lh_rttEntry_r 	= rttEntry;
+	}
+	lh_histValid_r 	= histWrite;
+	lh_appValid_r 	= appWriteBack;
+	lh_rttValid_r 	= rttWriteBack;
+
+	regs.bucketLow 		= latBucketLow(regs.bucket);
+	regs.clearBusy 		= lh_clearing;
+	regs.appSamples 	= lh_appSamples;
+	regs.rttSamples 	= lh_rttSamples;
+
+	lh_readEnable_r 	= regs.readEnable;
+	lh_clear_r 			= regs.clear;
+	lh_portWrite_r 		= regs.portWrite;
+	lh_sessionWrite_r 	= regs.sessionWrite;
+	lh_now++;
+}
@@ -0,0 +1,74 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _LATENCY_HISTOGRAM_HPP_
+#define _LATENCY_HISTOGRAM_HPP_
+
+#include "../toe.hpp"
+
+using namespace hls;
+
+/** @defgroup latency_histogram Latency Histogram
+ *  @ingroup tcp_module
+ */
+
+struct latAppEntry {
+	bool					valid;
+	ap_uint<WINDOW_BITS>	address;
+	ap_uint<32>				time;
+};
+
+struct latRttEntry {
+	bool						valid;
+	ap_uint<32>					seqEnd;
+	ap_uint<32>					time;
+	ap_uint<32>					srtt;
+	ap_uint<LAT_GROUP_BITS>		group;
+};
+
+ap_uint<7> latBucket(ap_uint<32> latency);
+ap_uint<32> latBucketLow(ap_uint<7> bucket);
+
+void latency_histogram(
+			stream<latAppWrite>&		appWriteIn,
+			stream<latTxSegment>&		txSegmentIn,
+			stream<ap_uint<32> >&		wireSeqIn,
+			stream<latAck>&				ackIn,
+#if (STATISTICS_MODULE)
+			stream<latRttUpdate>&		rttUpdateOut,
+#endif
+			latencyRegs&				regs);
+
+#endif
@@ -0,0 +1,217 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "latency_histogram.hpp"
+#include <iostream>
+
+#define CHECK(cond, msg) do { if (!(cond)) { std::cout << "ERROR " << msg << std::endl; errors++; } } while (0)
+
+/*
+ * Injects application writes, segments, packets on the wire and ACKs with known delays and
+ * checks the buckets they land in, the smoothed RTT, that a retransmission cancels the RTT
+ * sample, the groups given by listen port and by session, and the clear of a group.
+ */
+struct latIf {
+	stream<latAppWrite>		appWriteIn;
+	stream<latTxSegment>	txSegmentIn;
+	stream<ap_uint<32> >	wireSeqIn;
+	stream<latAck>			ackIn;
+	stream<latRttUpdate>	rttUpdateOut;
+	latencyRegs				regs;
+	uint32_t				lastRtt[MAX_SESSIONS];
+
+	latIf() {
+		regs.readEnable = 0;
+		regs.clear = 0;
+		regs.portWrite = 0;
+		regs.sessionWrite = 0;
+		regs.sessionID = 0;
+		for (int i = 0; i < MAX_SESSIONS; i++)
+			lastRtt[i] = 0;
+	}
+	void run(int cycles = 1) {
+		for (int i = 0; i < cycles; i++) {
+			latency_histogram(appWriteIn, txSegmentIn, wireSeqIn, ackIn,
+#if (STATISTICS_MODULE)
+					rttUpdateOut,
+#endif
+					regs);
+			while (!rttUpdateOut.empty()) {
+				latRttUpdate upd = rttUpdateOut.read();
+				lastRtt[upd.sessionID] = upd.srtt;
+			}
+		}
+	}
+	uint32_t readBucket(int kind, int group, int bucket) {
+		regs.kind = kind;
+		regs.group = group;
+		regs.bucket = bucket;
+		regs.readEnable = 1;
+		run();
+		regs.readEnable = 0;
+		run();
+		return regs.bucketCount;
+	}
+	uint32_t readRtt(int id) {
+		regs.sessionID = id;
+		regs.readEnable = 1;
+		run();
+		regs.readEnable = 0;
+		run();
+		return regs.sessionRTT;
+	}
+	// One segment leaves the TX engine and goes on the wire in the next cycle
+	void send(int id, ap_uint<32> seq, int length, bool retransmit = false) {
+		txSegmentIn.write(latTxSegment(id, seq, length, retransmit));
+		wireSeqIn.write(seq);
+		run();
+	}
+};
+
+int main(int argc, char **argv) {
+	latIf 		lat;
+	int 		errors = 0;
+	ap_uint<32> seq = 0xfffff000;		// Wraps around
+	uint32_t 	rttSamples;
+	const bool	rttStream = STATISTICS_MODULE;	// Without statistics the smoothed RTT is only a register
+
+	// Buckets cover the 32-bit range, in order and without holes
+	for (uint64_t v = 0; v < (1ULL << 32); v = (v < 64) ? v + 1 : v + v / 7 + 3) {
+		ap_uint<7> b = latBucket(v);
+		CHECK(latBucketLow(b) <= v, "latency " << v << " below bucket " << b << " from " << latBucketLow(b));
+		if (b < latBucket(0xffffffff))
+			CHECK(v < latBucketLow(b + 1), "latency " << v << " above bucket " << b);
+	}
+	CHECK(latBucket(0xffffffff) < LAT_BUCKETS, "last bucket " << latBucket(0xffffffff));
+
+	// Active open of session 1, write to wire after 37 cycles and round trip of 500 cycles
+	lat.ackIn.write(latAck(1, false, 0));
+	lat.run();
+	lat.appWriteIn.write(latAppWrite(1, seq(WINDOW_BITS-1, 0)));
+	lat.run(37);
+	lat.send(1, seq, 1000);
+	lat.run(499);
+	lat.ackIn.write(latAck(1, seq + 1000));
+	lat.run();
+	CHECK(lat.readBucket(0, 0, latBucket(37)) == 1, "write to wire of 37 cycles not in bucket " << latBucket(37));
+	CHECK(lat.readBucket(1, 0, latBucket(500)) == 1, "round trip of 500 cycles not in bucket " << latBucket(500));
+	CHECK(lat.readRtt(1) == 500 && (!rttStream || lat.lastRtt[1] == 500), "smoothed RTT " << lat.regs.sessionRTT << " instead of 500");
+	seq += 1000;
+
+	// A write in the middle of a segment, with the same cycle forwarded
+	lat.appWriteIn.write(latAppWrite(1, ap_uint<32>(seq + 10)(WINDOW_BITS-1, 0)));
+	lat.run();
+	lat.send(1, seq, 100);
+	CHECK(lat.readBucket(0, 0, 1) == 1, "write to wire of 1 cycle");
+
+	// SRTT = 7/8 SRTT + 1/8 R
+	lat.run(999);
+	lat.ackIn.write(latAck(1, seq + 100));
+	lat.run();
+	CHECK(lat.readRtt(1) == 500 + 500 / 8, "smoothed RTT " << lat.regs.sessionRTT << " instead of " << 500 + 500 / 8);
+	seq += 100;
+
+	// A retransmission cancels the round trip sample, only the next segment is timed
+	rttSamples = lat.regs.rttSamples;
+	lat.send(1, seq, 200);
+	lat.run(300);
+	lat.send(1, seq, 200, true);
+	lat.run(50);
+	lat.ackIn.write(latAck(1, seq + 200));
+	lat.run();
+	CHECK(lat.regs.rttSamples == rttSamples, "round trip sampled across a retransmission");
+	seq += 200;
+	lat.send(1, seq, 200);
+	lat.run(63);
+	lat.ackIn.write(latAck(1, seq + 100));		// Does not cover the segment
+	lat.run(10);
+	lat.ackIn.write(latAck(1, seq + 200));
+	lat.run();
+	CHECK(lat.readBucket(1, 0, latBucket(74)) == 1, "round trip of 74 cycles");
+	seq += 200;
+
+	// Connections to port 5001 are in group 2, session 3 is moved to group 3
+	lat.regs.portRuleID = 1;
+	lat.regs.portRuleValid = 1;
+	lat.regs.listenPort = 5001;
+	lat.regs.portGroup = 2;
+	lat.regs.portWrite = 1;
+	lat.run();
+	lat.regs.portWrite = 0;
+	lat.ackIn.write(latAck(2, true, 5001));
+	lat.ackIn.write(latAck(3, true, 5001));
+	lat.run(2);
+	lat.regs.sessionID = 3;
+	lat.regs.sessionGroup = 3;
+	lat.regs.sessionWrite = 1;
+	lat.run();
+	lat.regs.sessionWrite = 0;
+	for (int id = 2; id <= 3; id++) {
+		lat.send(id, 0x1000, 10);
+		lat.run(2999);
+		lat.ackIn.write(latAck(id, 0x1000 + 10));
+		lat.run();
+	}
+	CHECK(lat.readBucket(1, 2, latBucket(3000)) == 1, "round trip of group 2");
+	CHECK(lat.readBucket(1, 3, latBucket(3000)) == 1, "round trip of group 3");
+	CHECK(lat.readBucket(1, 0, latBucket(3000)) == 0, "round trip of group 2 or 3 in group 0");
+	CHECK(lat.readRtt(2) == 3000, "smoothed RTT of session 2");
+
+	// A new connection starts without RTT
+	lat.ackIn.write(latAck(2, true, 5001));
+	lat.run();
+	CHECK(lat.readRtt(2) == 0 && (!rttStream || lat.lastRtt[2] == 0), "smoothed RTT of a new connection");
+
+	// Clear of group 0, events wait meanwhile
+	lat.regs.clear = 1;
+	lat.regs.group = 0;
+	lat.run();
+	lat.regs.clear = 0;
+	lat.appWriteIn.write(latAppWrite(1, seq(WINDOW_BITS-1, 0)));
+	lat.send(1, seq, 10);
+	int clearCycles = 2;
+	while (lat.regs.clearBusy) {
+		lat.run();
+		clearCycles++;
+	}
+	lat.run(2);
+	CHECK(clearCycles == 2 * LAT_BUCKETS, "clear took " << clearCycles << " cycles");
+	CHECK(lat.readBucket(0, 0, latBucket(37)) == 0 && lat.readBucket(1, 0, latBucket(500)) == 0, "group 0 not cleared");
+	CHECK(lat.readBucket(0, 0, 1) == 1, "write during the clear");
+	CHECK(lat.readBucket(1, 2, latBucket(3000)) == 1, "group 2 cleared");
+
+	std::cout << lat.regs.appSamples << " write to wire and " << lat.regs.rttSamples << " round trip samples" << std::endl;
+	std::cout << (errors ? "FAILED" : "PASSED") << std::endl;
+	return (errors != 0);
+}
@@ -0,0 +1,857 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "mem_scheduler.hpp"
+
+/**
+ * @brief      Merges read commands of a client that are adjacent in the same session 
+ *             buffer, e.g. the segments of a retransmission or consecutive application
+ *             reads. A command is only appended to a burst that ends at a word boundary,
+ *             so the data can be cut back at word boundaries. The length of every command
+ *             goes to the read router, which marks where each one ends.
+ */
+void ms_read_coalescer(
+			stream<mmCmd>			readCmdIn[MS_CLIENTS],
+			stream<msBurst>			rdBursts[MS_CLIENTS],
+			stream<ap_uint<23> >	rdPieces[MS_CLIENTS]) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static msBurst 		acc[MS_CLIENTS];
+	static bool 		accValid[MS_CLIENTS];
+	static ap_uint<4> 	accCount[MS_CLIENTS];
+	static ap_uint<8> 	accIdle[MS_CLIENTS];
+	#pragma HLS ARRAY_PARTITION variable=acc complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=accValid complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=accCount complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=accIdle complete dim=1
+
+	mmCmd 				cmd;
+	bool 				adjacent;
+
+	read_clients: for (int c = 0; c < MS_CLIENTS; c++){
+	#pragma HLS UNROLL
+		if (!readCmdIn[c].empty()){
+			readCmdIn[c].read(cmd);
+			rdPieces[c].write(cmd.bbt);
+
+			adjacent = accValid[c] && 
+					(acc[c].addr + acc[c].length == cmd.saddr) &&
+					(acc[c].addr(31, WINDOW_BITS) == cmd.saddr(31, WINDOW_BITS)) &&
+					(acc[c].length(5, 0) == 0) &&
+					(acc[c].length + cmd.bbt <= MS_READ_MAX_BYTES) &&
+					(accCount[c] < MS_MAX_MERGE);
+
+			if (adjacent){
+				acc[c].length 	+= cmd.bbt;
+				accCount[c]++;
+			}
+			else {
+				if (accValid[c])
+					rdBursts[c].write(acc[c]);
+				acc[c] 			= msBurst(cmd.saddr, cmd.bbt, 0, c);
+				accValid[c] 	= true;
+				accCount[c] 	= 1;
+			}
+			accIdle[c] = 0;
+		}
+		else if (accValid[c]){
+			if (accIdle[c] == MS_READ_HOLD - 1){
+				rdBursts[c].write(acc[c]);
+				accValid[c] = false;
+			}
+			accIdle[c]++;
+		}
+	}
+}
+
+/**
+ * @brief      Collects the write commands of both clients in write combining slots. A command
+ *             that starts where an open slot of the same client and session ends is appended 
+ *             to it, otherwise it gets a new slot. The slots are byte banked so a command can 
+ *             be appended at any offset at one word per cycle. A slot is closed when it is 
+ *             full, when it holds MS_MAX_MERGE commands, when it has not been appended to for 
+ *             MS_WRITE_HOLD cycles or when its slot is needed. Closed slots go to the scheduler, 
+ *             which decides when their data is sent to the memory. The scheduler is told about 
+ *             a slot when it is opened and when its data has been sent, so it can hold the 
+ *             reads that overlap it. Commands longer than a slot are split in several parts. The commands in a slot go to the status handler when 
+ *             the slot is sent, so it gets them in issue order.
+ */
+void ms_write_buffer(
+			stream<mmCmd>					writeCmdIn[MS_CLIENTS],
+			stream<axiWord>					writeDataIn[MS_CLIENTS],
+			stream<ap_uint<1> >				seqRelease[MS_CLIENTS],
+			stream<ap_uint<MS_SLOT_BITS> >&	wrIssue,
+			stream<msBurst>&				wrOpened,
+			stream<msBurst>&				wrBursts,
+			stream<msSlotInfo>&				slotInfo,
+			stream<msWriteDone>&			wrDone,
+			stream<axiWord>&				writeDataOut) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static ap_uint<8> 	slotBuffer[64][MS_SLOTS * MS_SLOT_ROWS];
+	#pragma HLS ARRAY_PARTITION variable=slotBuffer complete dim=1
+	#pragma HLS RESOURCE variable=slotBuffer core=RAM_T2P_BRAM
+	#pragma HLS DEPENDENCE variable=slotBuffer inter false
+
+	enum slotStates {SLOT_FREE, SLOT_OPEN, SLOT_CLOSED};
+	static slotStates 							slotState[MS_SLOTS];
+	static ap_uint<1> 							slotClient[MS_SLOTS];
+	static ap_uint<32> 							slotAddr[MS_SLOTS];
+	static ap_uint<13> 							slotFill[MS_SLOTS];
+	static ap_uint<4> 							slotCount[MS_SLOTS];
+	static ap_uint<8> 							slotIdle[MS_SLOTS];
+	static bool 								slotForce[MS_SLOTS];
+	static ap_uint<MS_MAX_MERGE*MS_SEQ_BITS> 	slotSeqs[MS_SLOTS];
+	static ap_uint<MS_MAX_MERGE*4> 				slotPieces[MS_SLOTS];
+	static ap_uint<MS_MAX_MERGE> 				slotFinals[MS_SLOTS];
+	#pragma HLS ARRAY_PARTITION variable=slotState complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotClient complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotAddr complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotFill complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotCount complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotIdle complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotForce complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotSeqs complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotPieces complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotFinals complete dim=1
+
+	// Command of each client, a part is the piece of the command that goes in one slot
+	static mmCmd 								pendCmd[MS_CLIENTS];
+	static bool 								pendValid[MS_CLIENTS];
+	static bool 								cmdActive[MS_CLIENTS];
+	static bool 								cmdNeedSlot[MS_CLIENTS];
+	static ap_uint<MS_SLOT_BITS> 				cmdSlot[MS_CLIENTS];
+	static ap_uint<13> 							cmdOffset[MS_CLIENTS];
+	static ap_uint<7> 							cmdWord[MS_CLIENTS];
+	static ap_uint<13> 							cmdPartLeft[MS_CLIENTS];
+	static ap_uint<23> 							cmdLeft[MS_CLIENTS];
+	static ap_uint<32> 							cmdAddr[MS_CLIENTS];
+	static ap_uint<MS_SEQ_BITS> 				cmdSeq[MS_CLIENTS];
+	static ap_uint<4> 							cmdPiece[MS_CLIENTS];
+	static ap_uint<MS_SEQ_BITS> 				nextSeq[MS_CLIENTS];
+	static ap_uint<MS_SEQ_BITS+1> 				inFlight[MS_CLIENTS];
+	#pragma HLS ARRAY_PARTITION variable=pendCmd complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=pendValid complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdActive complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdNeedSlot complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdSlot complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdOffset complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdWord complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdPartLeft complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdLeft complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdAddr complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdSeq complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=cmdPiece complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=nextSeq complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=inFlight complete dim=1
+
+	static ap_uint<1> 				placeClient = 0;
+	static ap_uint<1> 				appendClient = 0;
+
+	static bool 					sending = false;
+	static ap_uint<MS_SLOT_BITS> 	sendSlot;
+	static ap_uint<7> 				sendRow;
+	static ap_uint<13> 				sendLeft;
+
+	ap_uint<1> 						c;
+	ap_uint<1> 						a;
+	bool 							busy[MS_SLOTS];
+	bool 							appended[MS_SLOTS];
+	bool 							matchFound = false;
+	bool 							freeFound = false;
+	bool 							victimFound = false;
+	bool 							closeFound = false;
+	bool 							placed = false;
+	ap_uint<MS_SLOT_BITS> 			match = 0;
+	ap_uint<MS_SLOT_BITS> 			freeSlot = 0;
+	ap_uint<MS_SLOT_BITS> 			victim = 0;
+	ap_uint<MS_SLOT_BITS> 			closeSlot = 0;
+	ap_uint<MS_SLOT_BITS> 			s;
+	ap_uint<13> 					partOffset;
+	ap_uint<13> 					partLength;
+	ap_uint<4> 						k;
+	axiWord 						currWord;
+	axiWord 						sendWord;
+	ap_uint<6> 						shift;
+	ap_uint<MS_SLOT_BITS+7> 		row;
+	ap_uint<512> 					rotData;
+	ap_uint<64> 					rotKeep;
+	ap_uint<7> 						bytes;
+	msSlotInfo 						info;
+	#pragma HLS ARRAY_PARTITION variable=busy complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=appended complete dim=1
+
+	release_seqs: for (int i = 0; i < MS_CLIENTS; i++){
+	#pragma HLS UNROLL
+		if (!seqRelease[i].empty()){
+			seqRelease[i].read();
+			inFlight[i]--;
+		}
+		if (!pendValid[i] && !cmdActive[i] && !writeCmdIn[i].empty()){
+			writeCmdIn[i].read(pendCmd[i]);
+			pendValid[i] = true;
+		}
+	}
+
+	busy_slots: for (int j = 0; j < MS_SLOTS; j++){
+	#pragma HLS UNROLL
+		busy[j] 	= false;
+		appended[j] = false;
+		for (int i = 0; i < MS_CLIENTS; i++){
+			if (cmdActive[i] && !cmdNeedSlot[i] && cmdSlot[i].to_int() == j)
+				busy[j] = true;
+		}
+	}
+
+	/* Place the command of one client per cycle */
+	c = placeClient;
+	placeClient++;
+	find_slot: for (int j = 0; j < MS_SLOTS; j++){
+	#pragma HLS UNROLL
+		if (!matchFound && slotState[j] == SLOT_OPEN && slotClient[j] == c && !slotForce[j] &&
+				slotAddr[j] + slotFill[j] == pendCmd[c].saddr &&
+				slotAddr[j](31, WINDOW_BITS) == pendCmd[c].saddr(31, WINDOW_BITS) &&
+				slotFill[j] + pendCmd[c].bbt <= MS_SLOT_BYTES &&
+				slotCount[j] < MS_MAX_MERGE){
+			match 		= j;
+			matchFound 	= true;
+		}
+		if (!freeFound && slotState[j] == SLOT_FREE){
+			freeSlot 	= j;
+			freeFound 	= true;
+		}
+		if (!victimFound && slotState[j] == SLOT_OPEN && !busy[j]){
+			victim 		= j;
+			victimFound = true;
+		}
+	}
+
+	if (pendValid[c] && inFlight[c] < MS_SEQS){
+		if (matchFound){
+			s 			= match;
+			partOffset 	= slotFill[match];
+			partLength 	= pendCmd[c].bbt;
+			placed 		= true;
+		}
+		else if (freeFound){
+			s 			= freeSlot;
+			partOffset 	= 0;
+			partLength 	= (pendCmd[c].bbt > MS_SLOT_BYTES) ? (ap_uint<23>) MS_SLOT_BYTES : pendCmd[c].bbt;
+			placed 		= true;
+		}
+		if (placed){
+			cmdSeq[c] 		= nextSeq[c];
+			cmdPiece[c] 	= 0;
+			cmdLeft[c] 		= pendCmd[c].bbt;
+			cmdAddr[c] 		= pendCmd[c].saddr;
+			nextSeq[c]++;
+			inFlight[c]++;
+			pendValid[c] 	= false;
+		}
+	}
+	else if (cmdActive[c] && cmdNeedSlot[c] && freeFound){
+		s 				= freeSlot;
+		partOffset 		= 0;
+		partLength 		= (cmdLeft[c] > MS_SLOT_BYTES) ? (ap_uint<23>) MS_SLOT_BYTES : cmdLeft[c];
+		cmdPiece[c]++;
+		placed 			= true;
+	}
+
+	if (placed){
+		if (partOffset == 0){
+			slotState[s] 	= SLOT_OPEN;
+			slotClient[s] 	= c;
+			slotAddr[s] 	= cmdAddr[c];
+			slotFill[s] 	= 0;
+			slotCount[s] 	= 0;
+			slotForce[s] 	= false;
+			wrOpened.write(msBurst(cmdAddr[c], MS_SLOT_BYTES, s, c));
+		}
+		k = slotCount[s];
+		slotSeqs[s](k*MS_SEQ_BITS + MS_SEQ_BITS - 1, k*MS_SEQ_BITS) = cmdSeq[c];
+		slotPieces[s](k*4 + 3, k*4) 	= cmdPiece[c];
+		slotFinals[s].bit(k) 			= (partLength == cmdLeft[c]);
+		slotCount[s]++;
+		slotIdle[s] 		= 0;
+
+		cmdSlot[c] 			= s;
+		cmdOffset[c] 		= partOffset;
+		cmdWord[c] 			= 0;
+		cmdPartLeft[c] 		= partLength;
+		cmdActive[c] 		= true;
+		cmdNeedSlot[c] 		= false;
+		busy[s] 			= true;
+	}
+	else if ((pendValid[c] && inFlight[c] < MS_SEQS && !freeFound) || (cmdActive[c] && cmdNeedSlot[c] && !freeFound)){
+		if (victimFound)
+			slotForce[victim] = true; 							// Make room for the command
+	}
+
+	/* Append one word per cycle */
+	a = appendClient;
+	if (!(cmdActive[a] && !cmdNeedSlot[a] && !writeDataIn[a].empty()))
+		a = ~appendClient;
+	if (cmdActive[a] && !cmdNeedSlot[a] && !writeDataIn[a].empty()){
+		writeDataIn[a].read(currWord);
+		appendClient = ~a;
+
+		// Byte i of the word goes to bank (shift + i) % 64
+		s 		= cmdSlot[a];
+		shift 	= cmdOffset[a](5, 0);
+		row 	= s * MS_SLOT_ROWS + cmdOffset[a](12, 6) + cmdWord[a];
+		if (shift == 0){
+			rotData = currWord.data;
+			rotKeep = currWord.keep;
+		}
+		else {
+			rotData = elementFunnelRight<8,64>(currWord.data, currWord.data, 64 - shift);
+			rotKeep = elementFunnelRight<1,64>(currWord.keep, currWord.keep, 64 - shift);
+		}
+		slot_write: for (int b = 0; b < 64; b++){
+		#pragma HLS UNROLL
+			if (rotKeep.bit(b))
+				slotBuffer[b][row + (b < shift.to_int())] = rotData(b*8+7, b*8);
+		}
+
+		bytes 			= keep2len(currWord.keep);
+		slotFill[s] 	+= bytes;
+		slotIdle[s] 	= 0;
+		appended[s] 	= true;
+		cmdWord[a]++;
+		cmdPartLeft[a] 	-= bytes;
+		cmdLeft[a] 		-= bytes;
+		cmdAddr[a] 		+= bytes;
+		if (cmdPartLeft[a] == 0){
+			if (cmdLeft[a] == 0)
+				cmdActive[a] 	= false;
+			else
+				cmdNeedSlot[a] 	= true;
+			busy[s] = false;
+		}
+	}
+
+	/* Close one slot per cycle */
+	close_slot: for (int j = 0; j < MS_SLOTS; j++){
+	#pragma HLS UNROLL
+		if (!closeFound && slotState[j] == SLOT_OPEN && !busy[j] && 
+				(slotFill[j] == MS_SLOT_BYTES || slotCount[j] == MS_MAX_MERGE || slotIdle[j] >= MS_WRITE_HOLD || slotForce[j])){
+			closeSlot 	= j;
+			closeFound 	= true;
+		}
+		if (slotState[j] == SLOT_OPEN && !appended[j] && slotIdle[j] != 255)
+			slotIdle[j]++;
+	}
+
+	if (closeFound){
+		wrBursts.write(msBurst(slotAddr[closeSlot], slotFill[closeSlot], closeSlot, slotClient[closeSlot]));
+		slotState[closeSlot] = SLOT_CLOSED;
+	}
+
+	/* Send the slots the scheduler issued */
+	if (!sending && !wrIssue.empty()){
+		wrIssue.read(sendSlot);
+		info.client 	= slotClient[sendSlot];
+		info.count 		= slotCount[sendSlot];
+		info.seqs 		= slotSeqs[sendSlot];
+		info.pieces 	= slotPieces[sendSlot];
+		info.finals 	= slotFinals[sendSlot];
+		slotInfo.write(info);
+		sendRow 	= 0;
+		sendLeft 	= slotFill[sendSlot];
+		sending 	= true;
+	}
+	else if (sending){
+		slot_read: for (int b = 0; b < 64; b++){
+		#pragma HLS UNROLL
+			sendWord.data(b*8+7, b*8) = slotBuffer[b][sendSlot * MS_SLOT_ROWS + sendRow];
+		}
+		if (sendLeft > 64){
+			sendWord.keep 	= 0xFFFFFFFFFFFFFFFF;
+			sendWord.last 	= 0;
+			sendLeft 		-= 64;
+			sendRow++;
+		}
+		else {
+			sendWord.keep 	= lowMask<64>(sendLeft);
+			sendWord.last 	= 1;
+			slotState[sendSlot] = SLOT_FREE;
+			wrDone.write(msWriteDone(sendSlot, sendRow + 1));
+			sending 		= false;
+		}
+		writeDataOut.write(sendWord);
+	}
+}
+
+/**
+ * @brief      Decides which burst goes to the memory next. The candidates are the closed 
+ *             write slots and the oldest read burst of each client. It keeps the row that
+ *             is open in each bank and prefers, in this order, candidates that have waited
+ *             MS_MAX_AGE cycles, candidates that hit an open row, candidates in the same 
+ *             direction as the last one, and the oldest. Bursts are only issued while less
+ *             than MS_ISSUE_WINDOW words are in flight, so there is something to choose from.
+ *             Reads of a client keep their order. A read that overlaps a write slot is held
+ *             until the data of the slot has been sent to the memory, which serves it before
+ *             the read. The slot covers MS_SLOT_BYTES from its start while it is open and its
+ *             burst once it is closed. As with two independent data movers, a read is not 
+ *             ordered against writes that reach the write buffer after it.
+ *             Write commands are tagged with their issue number, which comes back in the status.
+ */
+void ms_scheduler(
+			stream<msBurst>&				wrOpened,
+			stream<msBurst>&				wrBursts,
+			stream<msBurst>					rdBursts[MS_CLIENTS],
+			stream<msWriteDone>&			wrDone,
+			stream<ap_uint<16> >&			rdDone,
+			stream<mmCmd>&					writeCmdOut,
+			stream<ap_uint<MS_SLOT_BITS> >&	wrIssue,
+			stream<mmCmd>&					readCmdOut,
+			stream<ap_uint<1> >&			rdIssue) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	const int MS_CANDIDATES = MS_SLOTS + MS_CLIENTS;
+
+	static msBurst 		cand[MS_CANDIDATES];
+	static bool 		candValid[MS_CANDIDATES];
+	static ap_uint<8> 	candAge[MS_CANDIDATES];
+	#pragma HLS ARRAY_PARTITION variable=cand complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=candValid complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=candAge complete dim=1
+
+	// Address range of every write slot whose data has not been sent yet
+	static ap_uint<32> 	pendAddr[MS_SLOTS];
+	static ap_uint<23> 	pendLength[MS_SLOTS];
+	static bool 		pendValid[MS_SLOTS];
+	#pragma HLS ARRAY_PARTITION variable=pendAddr complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=pendLength complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=pendValid complete dim=1
+
+	static ap_uint<32-MS_COL_BITS-MS_BANK_BITS> 	openRow[MS_BANKS];
+	static bool 									rowOpen[MS_BANKS];
+	#pragma HLS ARRAY_PARTITION variable=openRow complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=rowOpen complete dim=1
+
+	static bool 		lastWrite = false;
+	static ap_uint<16> 	inFlight = 0;
+	static ap_uint<4> 	writeTag = 0;
+
+	msBurst 			burst;
+	ap_uint<MS_BANK_BITS> bank;
+	bool 				rowHit;
+	bool 				isWrite;
+	ap_uint<11> 		score;
+	ap_uint<11> 		bestScore = 0;
+	int 				best = 0;
+	bool 				found = false;
+	ap_uint<32> 		endAddr;
+	bool 				held;
+	mmCmd 				cmd;
+	msWriteDone 		done;
+
+	if (!wrDone.empty()){
+		wrDone.read(done);
+		inFlight -= done.words;
+		pendValid[done.slot] 	= false;
+	}
+	if (!wrOpened.empty()){
+		wrOpened.read(burst);
+		pendAddr[burst.slot] 	= burst.addr;
+		pendLength[burst.slot] 	= burst.length;
+		pendValid[burst.slot] 	= true;
+	}
+	if (!wrBursts.empty()){
+		wrBursts.read(burst);
+		cand[burst.slot] 		= burst;
+		candValid[burst.slot] 	= true;
+		candAge[burst.slot] 	= 0;
+		pendLength[burst.slot] 	= burst.length;
+	}
+	load_reads: for (int c = 0; c < MS_CLIENTS; c++){
+	#pragma HLS UNROLL
+		if (!candValid[MS_SLOTS + c] && !rdBursts[c].empty()){
+			rdBursts[c].read(cand[MS_SLOTS + c]);
+			candValid[MS_SLOTS + c] = true;
+			candAge[MS_SLOTS + c] 	= 0;
+		}
+	}
+
+	if (!rdDone.empty())
+		inFlight -= rdDone.read();
+
+	select_burst: for (int i = 0; i < MS_CANDIDATES; i++){
+	#pragma HLS UNROLL
+		isWrite = (i < MS_SLOTS);
+		bank 	= cand[i].addr(MS_COL_BITS + MS_BANK_BITS - 1, MS_COL_BITS);
+		rowHit 	= rowOpen[bank] && (openRow[bank] == cand[i].addr(31, MS_COL_BITS + MS_BANK_BITS));
+		score 	= candAge[i];
+		score.bit(8) 	= (isWrite == lastWrite);
+		score.bit(9) 	= rowHit;
+		score.bit(10) 	= (candAge[i] >= MS_MAX_AGE);
+		held 	= false;
+		overlap_writes: for (int j = 0; j < MS_SLOTS; j++){
+		#pragma HLS UNROLL
+			if (!isWrite && pendValid[j] && 
+					cand[i].addr < pendAddr[j] + pendLength[j] && pendAddr[j] < cand[i].addr + cand[i].length)
+				held = true;
+		}
+		if (candValid[i] && !held && (!found || score > bestScore)){
+			best 		= i;
+			bestScore 	= score;
+			found 		= true;
+		}
+	}
+
+	if (found && inFlight < MS_ISSUE_WINDOW){
+		cmd 		= mmCmd(cand[best].addr, 0);
+		cmd.bbt 	= cand[best].length;
+		endAddr 	= cand[best].addr + cand[best].length - 1;
+		bank 		= endAddr(MS_COL_BITS + MS_BANK_BITS - 1, MS_COL_BITS);
+		openRow[bank] 	= endAddr(31, MS_COL_BITS + MS_BANK_BITS);
+		rowOpen[bank] 	= true;
+		inFlight 		+= (cand[best].length + 63) >> 6;
+
+		if (best < MS_SLOTS){
+			cmd.tag 	= writeTag;
+			writeCmdOut.write(cmd);
+			writeTag++;
+			wrIssue.write(best);
+			lastWrite 	= true;
+		}
+		else {
+			cmd.tag 	= cand[best].client;
+			readCmdOut.write(cmd);
+			rdIssue.write(cand[best].client);
+			lastWrite 	= false;
+		}
+		candValid[best] = false;
+	}
+
+	age_candidates: for (int i = 0; i < MS_CANDIDATES; i++){
+	#pragma HLS UNROLL
+		if (candValid[i] && candAge[i] != 255)
+			candAge[i]++;
+	}
+}
+
+/**
+ * @brief      Sends the read data of every burst to the client that issued it. The memory
+ *             returns the bursts in issue order. The burst is cut back in the commands that
+ *             were merged in it, each one ends with last.
+ */
+void ms_read_router(
+			stream<axiWord>&			readDataIn,
+			stream<ap_uint<1> >&		rdIssue,
+			stream<ap_uint<23> >		rdPieces[MS_CLIENTS],
+			stream<axiWord>				readDataOut[MS_CLIENTS],
+			stream<ap_uint<16> >&		rdDone) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static bool 		active = false;
+	static ap_uint<1> 	client;
+	static ap_uint<16> 	words;
+	static bool 		pieceValid[MS_CLIENTS];
+	static ap_uint<23> 	pieceLeft[MS_CLIENTS];
+	#pragma HLS ARRAY_PARTITION variable=pieceValid complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=pieceLeft complete dim=1
+
+	axiWord 			currWord;
+	axiWord 			sendWord;
+
+	if (!active){
+		if (!rdIssue.empty()){
+			rdIssue.read(client);
+			words 	= 0;
+			active 	= true;
+		}
+	}
+	else if (!pieceValid[client]){
+		if (!rdPieces[client].empty()){
+			rdPieces[client].read(pieceLeft[client]);
+			pieceValid[client] = true;
+		}
+	}
+	else if (!readDataIn.empty()){
+		readDataIn.read(currWord);
+		sendWord = currWord;
+		if (pieceLeft[client] <= 64){
+			sendWord.keep 		= lowMask<64>(pieceLeft[client]);
+			sendWord.last 		= 1;
+			pieceValid[client] 	= false;
+		}
+		else {
+			sendWord.last 		= 0;
+			pieceLeft[client] 	-= 64;
+		}
+		readDataOut[client].write(sendWord);
+		words++;
+		if (currWord.last){
+			rdDone.write(words);
+			active = false;
+		}
+	}
+}
+
+/**
+ * @brief      Returns one status per write command to each client, in command order. The
+ *             memory returns one status per burst in issue order, the tag has to be the next
+ *             issue number, otherwise the status is lost and the error is reported. Every 
+ *             command in the burst gets one more part completed, a command is done when all 
+ *             its parts are. The status of a command is the combination of its parts.
+ */
+void ms_write_status(
+			stream<msSlotInfo>&		slotInfo,
+			stream<mmStatus>&		writeStatusIn,
+			stream<mmStatus>		writeStatusOut[MS_CLIENTS],
+			stream<ap_uint<1> >		seqRelease[MS_CLIENTS]) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+
+	static ap_uint<5> 			completed[MS_CLIENTS][MS_SEQS];
+	static ap_uint<5> 			total[MS_CLIENTS][MS_SEQS];
+	static bool 				finalDone[MS_CLIENTS][MS_SEQS];
+	static mmStatus 			seqStatus[MS_CLIENTS][MS_SEQS];
+	#pragma HLS ARRAY_PARTITION variable=completed complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=total complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=finalDone complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=seqStatus complete dim=1
+	#pragma HLS DEPENDENCE variable=completed inter false
+	#pragma HLS DEPENDENCE variable=finalDone inter false
+
+	static ap_uint<MS_SEQ_BITS> relPtr[MS_CLIENTS];
+	#pragma HLS ARRAY_PARTITION variable=relPtr complete dim=1
+
+	static bool 				processing = false;
+	static msSlotInfo 			procInfo;
+	static ap_uint<4> 			procEntry;
+	static mmStatus 			procStatus;
+	static ap_uint<4> 			expectedTag = 0;
+
+	ap_uint<1> 					c;
+	ap_uint<MS_SEQ_BITS> 		seq;
+	ap_uint<4> 					piece;
+	mmStatus 					status;
+
+	if (processing){
+		c 		= procInfo.client;
+		seq 	= procInfo.seqs(procEntry*MS_SEQ_BITS + MS_SEQ_BITS - 1, procEntry*MS_SEQ_BITS);
+		piece 	= procInfo.pieces(procEntry*4 + 3, procEntry*4);
+
+		status = seqStatus[c][seq];
+		if (completed[c][seq] == 0){
+			status = procStatus;
+		}
+		else {
+			status.interr 	= status.interr | procStatus.interr;
+			status.decerr 	= status.decerr | procStatus.decerr;
+			status.slverr 	= status.slverr | procStatus.slverr;
+			status.okay 	= status.okay & procStatus.okay;
+		}
+		status.tag 				= 0;
+		seqStatus[c][seq] 		= status;
+		completed[c][seq]++;
+		if (procInfo.finals.bit(procEntry)){
+			total[c][seq] 		= piece + 1;
+			finalDone[c][seq] 	= true;
+		}
+
+		procEntry++;
+		if (procEntry == procInfo.count)
+			processing = false;
+	}
+	else if (!writeStatusIn.empty() && !slotInfo.empty()){
+		writeStatusIn.read(procStatus);
+		slotInfo.read(procInfo);
+		if (procStatus.tag != expectedTag){
+			procStatus.interr 	= 1;
+			procStatus.okay 	= 0;
+		}
+		expectedTag++;
+		procEntry 	= 0;
+		processing 	= true;
+	}
+
+	release_status: for (int i = 0; i < MS_CLIENTS; i++){
+	#pragma HLS UNROLL
+		seq = relPtr[i];
+		if (finalDone[i][seq] && completed[i][seq] == total[i][seq]){
+			writeStatusOut[i].write(seqStatus[i][seq]);
+			seqRelease[i].write(1);
+			finalDone[i][seq] 	= false;
+			completed[i][seq] 	= 0;
+			relPtr[i]++;
+		}
+	}
+}
+
+/**
+ * @brief      Shares one data mover between the RX and TX buffer interfaces of the TOE 
+ *             and improves the efficiency of the memory. Small writes are collected in write
+ *             combining slots, adjacent writes of the same session are merged in a single 
+ *             burst, and adjacent reads of the same session are merged as well. The bursts
+ *             are then reordered to hit open rows and avoid read/write turnarounds.
+ *             Each client sees its own read data and write status in command order, as if 
+ *             it had a data mover for itself. The output can go straight to a data mover or
+ *             through the memory_interleaver.
+ *
+ * @param      readCmdIn       Read commands from the TOE, RX and TX buffer
+ * @param      readDataOut     Read data to the TOE
+ * @param      writeCmdIn      Write commands from the TOE
+ * @param      writeDataIn     Write data from the TOE
+ * @param      writeStatusOut  Write status to the TOE
+ * @param      readCmdOut      Read commands to the data mover
+ * @param      readDataIn      Read data from the data mover
+ * @param      writeCmdOut     Write commands to the data mover
+ * @param      writeDataOut    Write data to the data mover
+ * @param      writeStatusIn   Write status from the data mover
+ */
+void mem_scheduler(
+					stream<mmCmd>			readCmdIn[MS_CLIENTS],
+					stream<axiWord>			readDataOut[MS_CLIENTS],
+					stream<mmCmd>			writeCmdIn[MS_CLIENTS],
+					stream<axiWord>			writeDataIn[MS_CLIENTS],
+					stream<mmStatus>		writeStatusOut[MS_CLIENTS],
+
+					stream<mmCmd>&			readCmdOut,
+					stream<axiWord>&		readDataIn,
+					stream<mmCmd>&			writeCmdOut,
+					stream<axiWord>&		writeDataOut,
+					stream<mmStatus>&		writeStatusIn) {
+
+#pragma HLS INTERFACE ap_ctrl_none port=return
+#pragma HLS DATAFLOW
+
+#pragma HLS INTERFACE axis register both port=readCmdIn name=s_axis_read_cmd
+#pragma HLS INTERFACE axis register both port=readDataOut name=m_axis_read_data
+#pragma HLS INTERFACE axis register both port=writeCmdIn name=s_axis_write_cmd
+#pragma HLS INTERFACE axis register both port=writeDataIn name=s_axis_write_data
+#pragma HLS INTERFACE axis register both port=writeStatusOut name=m_axis_write_sts
+
+#pragma HLS INTERFACE axis register both port=readCmdOut name=m_axis_mem_read_cmd
+#pragma HLS INTERFACE axis register both port=readDataIn name=s_axis_mem_read_data
+#pragma HLS INTERFACE axis register both port=writeCmdOut name=m_axis_mem_write_cmd
+#pragma HLS INTERFACE axis register both port=writeDataOut name=m_axis_mem_write_data
+#pragma HLS INTERFACE axis register both port=writeStatusIn name=s_axis_mem_write_sts
+
+#pragma HLS DATA_PACK variable=readCmdIn
+#pragma HLS DATA_PACK variable=writeCmdIn
+#pragma HLS DATA_PACK variable=writeStatusOut
+#pragma HLS DATA_PACK variable=readCmdOut
+#pragma HLS DATA_PACK variable=writeCmdOut
+#pragma HLS DATA_PACK variable=writeStatusIn
+
+	static stream<msBurst>					rdBursts[MS_CLIENTS];
+	#pragma HLS STREAM variable=rdBursts depth=4
+	#pragma HLS DATA_PACK variable=rdBursts
+
+	static stream<ap_uint<23> >				rdPieces[MS_CLIENTS];
+	#pragma HLS STREAM variable=rdPieces depth=64
+
+	static stream<ap_uint<1> >				rdIssue("rdIssue");
+	#pragma HLS STREAM variable=rdIssue depth=16
+
+	static stream<ap_uint<16> >				rdDone("rdDone");
+	#pragma HLS STREAM variable=rdDone depth=16
+
+	static stream<msBurst>					wrBursts("wrBursts");
+	#pragma HLS STREAM variable=wrBursts depth=8
+	#pragma HLS DATA_PACK variable=wrBursts
+
+	static stream<msSlotInfo>				slotInfo("slotInfo");
+	#pragma HLS STREAM variable=slotInfo depth=16
+	#pragma HLS DATA_PACK variable=slotInfo
+
+	static stream<ap_uint<MS_SLOT_BITS> >	wrIssue("wrIssue");
+	#pragma HLS STREAM variable=wrIssue depth=8
+
+	static stream<msBurst>					wrOpened("wrOpened");
+	#pragma HLS STREAM variable=wrOpened depth=4
+	#pragma HLS DATA_PACK variable=wrOpened
+
+	static stream<msWriteDone>				wrDone("wrDone");
+	#pragma HLS STREAM variable=wrDone depth=8
+	#pragma HLS DATA_PACK variable=wrDone
+
+	static stream<ap_uint<1> >				seqRelease[MS_CLIENTS];
+	#pragma HLS STREAM variable=seqRelease depth=64
+
+	ms_read_coalescer(
+			readCmdIn,
+			rdBursts,
+			rdPieces);
+
+	ms_write_buffer(
+			writeCmdIn,
+			writeDataIn,
+			seqRelease,
+			wrIssue,
+			wrOpened,
+			wrBursts,
+			slotInfo,
+			wrDone,
+			writeDataOut);
+
+	ms_scheduler(
+			wrOpened,
+			wrBursts,
+			rdBursts,
+			wrDone,
+			rdDone,
+			writeCmdOut,
+			wrIssue,
+			readCmdOut,
+			rdIssue);
+
+	ms_read_router(
+			readDataIn,
+			rdIssue,
+			rdPieces,
+			readDataOut,
+			rdDone);
+
+	ms_write_status(
+			slotInfo,
+			writeStatusIn,
+			writeStatusOut,
+			seqRelease);
+}
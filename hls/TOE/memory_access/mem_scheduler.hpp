@@ -0,0 +1,133 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _MEM_SCHEDULER_HPP_
+#define _MEM_SCHEDULER_HPP_
+
+#include "../toe.hpp"
+#include "../common_utilities/common_utilities.hpp"
+
+using namespace hls;
+
+// Data mover interfaces of the TOE sharing the memory, client 0 is the RX buffer and client 1 the TX buffer
+#define MS_CLIENTS 2
+
+// Write combining slots, each one holds a burst of up to MS_SLOT_BYTES
+#define MS_SLOTS 16
+static const uint8_t  MS_SLOT_BITS = 4;
+static const uint16_t MS_SLOT_BYTES = 4096;
+static const uint16_t MS_SLOT_ROWS = MS_SLOT_BYTES / 64;
+
+// Commands that can be merged in a single burst
+#define MS_MAX_MERGE 8
+
+// A write slot that is not appended to for MS_WRITE_HOLD cycles is closed. Read commands
+// wait at most MS_READ_HOLD cycles for an adjacent one
+static const uint8_t  MS_WRITE_HOLD = 64;
+static const uint8_t  MS_READ_HOLD = 4;
+static const uint16_t MS_READ_MAX_BYTES = 16384;
+
+// Write commands of each client in flight, the status is returned in command order
+static const uint8_t  MS_SEQ_BITS = 6;
+static const uint16_t MS_SEQS = (1 << MS_SEQ_BITS);
+
+// DDR address mapping {row, bank, column}, 8 KB pages and 16 banks
+static const uint8_t  MS_COL_BITS = 13;
+static const uint8_t  MS_BANK_BITS = 4;
+#define MS_BANKS 16
+
+// Words issued to the memory and not completed yet before the scheduler stops issuing,
+// candidates wait in the scheduler so they can be reordered
+static const uint16_t MS_ISSUE_WINDOW = 32;
+
+// A candidate that has been passed over for MS_MAX_AGE cycles is issued first
+static const uint8_t  MS_MAX_AGE = 64;
+
+/**
+ * Burst that is ready to be issued to the memory, slot is the write combining slot 
+ * that holds the data of a write burst
+ */
+struct msBurst
+{
+	ap_uint<32>					addr;
+	ap_uint<23>					length;
+	ap_uint<MS_SLOT_BITS>		slot;
+	ap_uint<1>					client;
+	msBurst() {}
+	msBurst(ap_uint<32> addr, ap_uint<23> length, ap_uint<MS_SLOT_BITS> slot, ap_uint<1> client)
+			:addr(addr), length(length), slot(slot), client(client) {}
+};
+
+/**
+ * Write slot whose data has been sent to the memory, words is the length of the burst
+ */
+struct msWriteDone
+{
+	ap_uint<MS_SLOT_BITS>		slot;
+	ap_uint<16>					words;
+	msWriteDone() {}
+	msWriteDone(ap_uint<MS_SLOT_BITS> slot, ap_uint<16> words)
+			:slot(slot), words(words) {}
+};
+
+/**
+ * Commands that went into a write burst. For every entry seqs holds the sequence number
+ * of the command, pieces which part of the command it is, and finals whether it is 
+ * the last part. Commands longer than a slot are split in several parts.
+ */
+struct msSlotInfo
+{
+	ap_uint<1>							client;
+	ap_uint<4>							count;
+	ap_uint<MS_MAX_MERGE*MS_SEQ_BITS>	seqs;
+	ap_uint<MS_MAX_MERGE*4>				pieces;
+	ap_uint<MS_MAX_MERGE>				finals;
+	msSlotInfo() {}
+};
+
+void mem_scheduler(
+					stream<mmCmd>			readCmdIn[MS_CLIENTS],
+					stream<axiWord>			readDataOut[MS_CLIENTS],
+					stream<mmCmd>			writeCmdIn[MS_CLIENTS],
+					stream<axiWord>			writeDataIn[MS_CLIENTS],
+					stream<mmStatus>		writeStatusOut[MS_CLIENTS],
+
+					stream<mmCmd>&			readCmdOut,
+					stream<axiWord>&		readDataIn,
+					stream<mmCmd>&			writeCmdOut,
+					stream<axiWord>&		writeDataOut,
+					stream<mmStatus>&		writeStatusIn);
+
+#endif
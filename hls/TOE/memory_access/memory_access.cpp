@@ -324,7 +324,7 @@ void app_MemDataRead_aligner(
 void tx_MemDataRead_aligner(
 					stream<axiWord>& 			DtaInNoAlig,
 					stream<memDoubleAccess>& 	MemoryDoubleAccess,
-#if (TCP_NODELAY)
+#if (TCP_NODELAY && !TX_RETRANSMIT_RING)
 					stream<bool>&				txEng_isDDRbypass,
 					stream<axiWord>&			txAppDataIn,
 #endif					
@@ -335,12 +335,12 @@ void tx_MemDataRead_aligner(
 	
 	enum tmra_states {READ_ACCESS , NO_BREAKDOWN , BREAKDOWN_BLOCK_0, BREAKDOWN_ALIGNED, 
 		              FIRST_MERGE, BREAKDOWN_BLOCK_1, EXTRA_DATA
-#if (TCP_NODELAY)
+#if (TCP_NODELAY && !TX_RETRANSMIT_RING)
 		, NO_USE_DDR , READ_BYPASS
 #endif
 	};
 
-#if (TCP_NODELAY)	
+#if (TCP_NODELAY && !TX_RETRANSMIT_RING)	
 	const tmra_states INITIAL_STATE = READ_BYPASS;
 #else	
 	const tmra_states INITIAL_STATE = READ_ACCESS;
@@ -356,11 +356,13 @@ void tx_MemDataRead_aligner(
 	axiWord 			currWord;
 	axiWord 			sendWord;
 
+#if (TCP_NODELAY && !TX_RETRANSMIT_RING)
 	bool 				bypass_ddr_i;
+#endif
 	bool 				write_word = true;
 
 	switch (tmra_fsm_state){
-#if (TCP_NODELAY)	
+#if (TCP_NODELAY && !TX_RETRANSMIT_RING)	
 		case READ_BYPASS: 
 			if (!txEng_isDDRbypass.empty()){
 				txEng_isDDRbypass.read(bypass_ddr_i);
@@ -656,13 +658,11 @@ void tx_Data_to_Memory(
 	static mmCmd 			command_i;
 	static ap_uint<64> 		keep_last_word;
 
-	bool 					rxWrBreakDown;
 	ap_uint<WINDOW_BITS+1> 	buffer_overflow;
 
 	axiWord 				currWord;
 	axiWord 				sendWord;
 	static axiWord 			prevWord;
-	static int				transaction = 0; // deleteme
 
 	switch (data2mem_state) {
 		case WAIT_CMD :
@@ -687,12 +687,9 @@ void tx_Data_to_Memory(
 						number_of_words_to_send = command_i.bbt.range(WINDOW_BITS-1,6);
 					}
 					count_word_sent 	= 1;
-					rxWrBreakDown 		= true;
 					data2mem_state = FWD_BREAKDOWN_0;
-					transaction = 0; // deleteme
 				}
 				else {
-					rxWrBreakDown 		= false;
 					command_i 			= input_command;
 					data2mem_state 	= FWD_NO_BREAKDOWN;
 				}
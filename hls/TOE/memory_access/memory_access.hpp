@@ -56,7 +56,7 @@ void tx_MemDataRead_aligner(
 					stream<axiWord>& 			mem_payload_unaligned,
 					stream<memDoubleAccess>& 	mem_two_access,
 				
-#if (TCP_NODELAY)
+#if (TCP_NODELAY && !TX_RETRANSMIT_RING)
 					stream<bool>&				txEng_isDDRbypass,
 					stream<axiWord>&			txApp2txEng_data_stream,
 #endif
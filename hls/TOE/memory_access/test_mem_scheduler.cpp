@@ -0,0 +1,453 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "mem_scheduler.hpp"
+#include "../testbench/dummy_memory.hpp"
+#include <vector>
+#include <deque>
+#include <cstdlib>
+#include <iomanip>
+
+using namespace std;
+
+#define DDR_CMD_CYCLES 			4 			// Cost of every command, address phase and controller
+#define DDR_ROW_MISS_CYCLES 	10 			// Precharge and activate, tRP + tRCD
+#define DDR_TURNAROUND_CYCLES 	4 			// Changing from reads to writes or back
+#define DDR_READ_LATENCY 		20 			// Cycles from reading a word to having it out
+
+/*
+ * Streams of the data mover interfaces of the TOE, client 0 is the RX buffer and
+ * client 1 the TX buffer
+ */
+struct clientPorts {
+	stream<mmCmd>		readCmd[MS_CLIENTS];
+	stream<axiWord>		readData[MS_CLIENTS];
+	stream<mmCmd>		writeCmd[MS_CLIENTS];
+	stream<axiWord>		writeData[MS_CLIENTS];
+	stream<mmStatus>	writeStatus[MS_CLIENTS];
+};
+
+struct memPort {
+	stream<mmCmd>*		readCmd;
+	stream<axiWord>*	readData;
+	stream<mmCmd>*		writeCmd;
+	stream<axiWord>*	writeData;
+	stream<mmStatus>*	writeStatus;
+	memPort(stream<mmCmd>* rc, stream<axiWord>* rd, stream<mmCmd>* wc, stream<axiWord>* wd, stream<mmStatus>* ws)
+		:readCmd(rc), readData(rd), writeCmd(wc), writeData(wd), writeStatus(ws) {}
+};
+
+/*
+ * DDR timing model on top of dummyMemory. The commands of all ports are served one at a 
+ * time in arrival order, at one word per cycle, which is the bandwidth of a DDR4-2400 
+ * channel at the TOE clock. On top of that every command, every row that has to be opened 
+ * and every change between reads and writes costs some cycles.
+ */
+class ddrModel {
+public:
+	ddrModel() :commands(0), rowMisses(0), dataCycles(0), active(false), lastWrite(false), penalty(0), cycle(0) {
+		for (int i = 0; i < MS_BANKS; i++)
+			openRow[i] = -1;
+	}
+
+	void addPort(memPort port) {
+		ports.push_back(port);
+	}
+
+	void step() {
+		cycle++;
+		for (size_t p = 0; p < ports.size(); p++){
+			if (!ports[p].readCmd->empty())
+				queue.push_back(request(p, false, ports[p].readCmd->read()));
+			if (!ports[p].writeCmd->empty())
+				queue.push_back(request(p, true, ports[p].writeCmd->read()));
+		}
+		while (!readOut.empty() && readOut.front().ready <= cycle){
+			ports[readOut.front().port].readData->write(readOut.front().word);
+			readOut.pop_front();
+		}
+
+		if (!active){
+			if (queue.empty())
+				return;
+			current = queue.front();
+			queue.pop_front();
+			active 	= true;
+			addr 	= current.cmd.saddr;
+			penalty = DDR_CMD_CYCLES + ((current.write != lastWrite) ? DDR_TURNAROUND_CYCLES : 0);
+			lastWrite = current.write;
+			checkRow(addr);
+			commands++;
+			if (current.write)
+				memory.setWriteCmd(current.cmd);
+			else
+				memory.setReadCmd(current.cmd);
+			return;
+		}
+		if (penalty > 0){
+			penalty--;
+			return;
+		}
+		if ((addr % 64 == 0 || addr == current.cmd.saddr) && checkRow(addr))
+			return;
+
+		axiWord word;
+		if (current.write){
+			if (ports[current.port].writeData->empty())
+				return;
+			ports[current.port].writeData->read(word);
+			memory.writeWord(word);
+			if (word.last){
+				mmStatus status;
+				status.tag 		= current.cmd.tag;
+				status.interr 	= 0;
+				status.decerr 	= 0;
+				status.slverr 	= 0;
+				status.okay 	= 1;
+				ports[current.port].writeStatus->write(status);
+			}
+		}
+		else {
+			memory.readWord(word);
+			readOut.push_back(delayedWord(cycle + DDR_READ_LATENCY, current.port, word));
+		}
+		dataCycles++;
+		addr = (addr & ~63u) + 64;
+		if (word.last)
+			active = false;
+	}
+
+	bool idle() {
+		return !active && queue.empty() && readOut.empty();
+	}
+
+	uint64_t 	commands;
+	uint64_t 	rowMisses;
+	uint64_t 	dataCycles;
+
+private:
+	struct request {
+		int 		port;
+		bool 		write;
+		mmCmd 		cmd;
+		request() {}
+		request(int port, bool write, mmCmd cmd) :port(port), write(write), cmd(cmd) {}
+	};
+	struct delayedWord {
+		uint64_t 	ready;
+		int 		port;
+		axiWord 	word;
+		delayedWord(uint64_t ready, int port, axiWord word) :ready(ready), port(port), word(word) {}
+	};
+
+	// Opens the row of addr if it is not open, returns true if it had to
+	bool checkRow(uint32_t addr) {
+		int 		bank = (addr >> MS_COL_BITS) % MS_BANKS;
+		int64_t 	row = addr >> (MS_COL_BITS + MS_BANK_BITS);
+		if (openRow[bank] == row)
+			return false;
+		openRow[bank] = row;
+		penalty += DDR_ROW_MISS_CYCLES;
+		rowMisses++;
+		return true;
+	}
+
+	dummyMemory 			memory;
+	vector<memPort> 		ports;
+	deque<request> 			queue;
+	deque<delayedWord> 		readOut;
+	request 				current;
+	bool 					active;
+	bool 					lastWrite;
+	int 					penalty;
+	uint32_t 				addr;
+	uint64_t 				cycle;
+	int64_t 				openRow[MS_BANKS];
+};
+
+/*
+ * Traffic of the two buffers of the TOE. Each client writes small chunks to the buffers of
+ * a few sessions, every session sequentially, and reads back data whose write status
+ * has been received, in runs of adjacent reads as retransmissions and application
+ * reads do. An eager client reads data as soon as the write buffer has taken it,
+ * before the status is back, so the scheduler has to keep the read behind the write.
+ * The read data is checked against what was written. As in the TOE, the buffers are
+ * circular and a command never crosses the end of the buffer.
+ */
+class trafficGenerator {
+public:
+	trafficGenerator(int sessions, int maxWrite, int operations, bool eager, unsigned seed)
+		:errors(0), bytes(0), sessions(sessions), maxWrite(maxWrite), operationsLeft(operations), eager(eager) {
+		srand(seed);
+		for (int c = 0; c < MS_CLIENTS; c++){
+			for (int s = 0; s < sessions; s++){
+				session ss;
+				ss.base 	= (c << 31) | ((s + 1) << WINDOW_BITS);
+				ss.written 	= rand() % BUFFER_SIZE; 		// Like the initial sequence number
+				ss.acked 	= ss.written;
+				ss.read 	= ss.written;
+				ss.freed 	= ss.written;
+				ss.data.resize(BUFFER_SIZE);
+				clientSessions[c].push_back(ss);
+			}
+			readRun[c] = 0;
+		}
+	}
+
+	void step(clientPorts& io) {
+		for (int c = 0; c < MS_CLIENTS; c++){
+			collectStatus(io, c);
+			collectData(io, c);
+			if (operationsLeft > 0 && (rand() % 2) && pendingWrites[c].size() < 32)
+				issueWrite(io, c);
+			if (operationsLeft > 0 && pendingReads[c].size() < 16)
+				issueRead(io, c);
+		}
+	}
+
+	bool done() {
+		for (int c = 0; c < MS_CLIENTS; c++){
+			if (!pendingWrites[c].empty() || !pendingReads[c].empty())
+				return false;
+		}
+		return operationsLeft <= 0;
+	}
+
+	int 		errors;
+	uint64_t 	bytes;
+
+private:
+	struct session {
+		uint32_t 		base;
+		uint32_t 		written;
+		uint32_t 		acked;
+		uint32_t 		read;
+		uint32_t 		freed;
+		vector<uint8_t> data;
+	};
+
+	void issueWrite(clientPorts& io, int c) {
+		int 		s = rand() % sessions;
+		session& 	ss = clientSessions[c][s];
+		uint32_t 	offset = ss.written % BUFFER_SIZE;
+		int 		length = 1 + rand() % maxWrite;
+		axiWord 	word;
+
+		length = min<uint32_t>(length, BUFFER_SIZE - offset);
+		if (ss.written + length - ss.freed > BUFFER_SIZE) 	// Space is free once the read data is back
+			return;
+		io.writeCmd[c].write(mmCmd(ss.base + offset, length));
+		for (int i = 0; i < length; i += 64){
+			word = axiWord(0, 0, i + 64 >= length);
+			for (int b = 0; b < 64 && i + b < length; b++){
+				ss.data[offset + i + b] = rand();
+				word.data(b*8+7, b*8) 	= ss.data[offset + i + b];
+				word.keep.bit(b) 		= 1;
+			}
+			io.writeData[c].write(word);
+		}
+		ss.written += length;
+		pendingWrites[c].push_back(make_pair(s, ss.written));
+		bytes += length;
+		operationsLeft--;
+	}
+
+	void issueRead(clientPorts& io, int c) {
+		int 		length;
+		uint32_t 	available;
+
+		if (readRun[c] == 0){
+			readSession[c] 	= rand() % sessions;
+			readRun[c] 		= 1 + rand() % 4;
+		}
+		session& 	ss = clientSessions[c][readSession[c]];
+		uint32_t 	offset = ss.read % BUFFER_SIZE;
+
+		length = 64 * (1 + rand() % 8);
+		length = min<uint32_t>(length, BUFFER_SIZE - offset);
+		// Once its data has been taken every write command has reached the write buffer
+		available = (eager && io.writeData[c].empty()) ? ss.written : ss.acked;
+		if ((int32_t) (available - ss.read) < length){ 		// The read can be ahead of the status
+			readRun[c] = 0;
+			return;
+		}
+		io.readCmd[c].write(mmCmd(ss.base + offset, length));
+		pendingReads[c].push_back(vector<uint8_t>(ss.data.begin() + offset, ss.data.begin() + offset + length));
+		readEnds[c].push_back(make_pair(readSession[c], ss.read + length));
+		ss.read += length;
+		readRun[c]--;
+		bytes += length;
+		operationsLeft--;
+	}
+
+	void collectStatus(clientPorts& io, int c) {
+		mmStatus status;
+
+		if (!io.writeStatus[c].empty()){
+			io.writeStatus[c].read(status);
+			if (pendingWrites[c].empty() || !status.okay){
+				cout << "Unexpected write status client " << c << endl;
+				errors++;
+				return;
+			}
+			clientSessions[c][pendingWrites[c].front().first].acked = pendingWrites[c].front().second;
+			pendingWrites[c].pop_front();
+		}
+	}
+
+	void collectData(clientPorts& io, int c) {
+		axiWord word;
+
+		if (!io.readData[c].empty()){
+			io.readData[c].read(word);
+			if (pendingReads[c].empty()){
+				cout << "Unexpected read data client " << c << endl;
+				errors++;
+				return;
+			}
+			vector<uint8_t>& expected = pendingReads[c].front();
+			for (int b = 0; b < 64; b++){
+				if (!word.keep.bit(b))
+					break;
+				if (readOffset[c] >= expected.size() || word.data(b*8+7, b*8) != expected[readOffset[c]]){
+					errors++;
+					break;
+				}
+				readOffset[c]++;
+			}
+			if (word.last){
+				if (readOffset[c] != expected.size()){
+					cout << "Read of " << expected.size() << " bytes returned " << readOffset[c] << endl;
+					errors++;
+				}
+				pendingReads[c].pop_front();
+				readOffset[c] = 0;
+				clientSessions[c][readEnds[c].front().first].freed = readEnds[c].front().second;
+				readEnds[c].pop_front();
+			}
+		}
+	}
+
+	int 							sessions;
+	int 							maxWrite;
+	int 							operationsLeft;
+	bool 							eager;
+	vector<session> 				clientSessions[MS_CLIENTS];
+	deque<pair<int, uint32_t> > 	pendingWrites[MS_CLIENTS];
+	deque<vector<uint8_t> > 		pendingReads[MS_CLIENTS];
+	deque<pair<int, uint32_t> > 	readEnds[MS_CLIENTS];
+	size_t 							readOffset[MS_CLIENTS] = {0, 0};
+	int 							readSession[MS_CLIENTS];
+	int 							readRun[MS_CLIENTS];
+};
+
+/*
+ * Runs the same traffic with every client on its own data mover port, as the TOE does
+ * today, and through the scheduler. Both share the same DDR channel.
+ */
+int runTraffic(bool scheduled, int sessions, int maxWrite, int operations, bool eager = false) {
+	static clientPorts 	io;
+	static stream<mmCmd>		readCmd;
+	static stream<axiWord>		readData;
+	static stream<mmCmd>		writeCmd;
+	static stream<axiWord>		writeData;
+	static stream<mmStatus>		writeStatus;
+
+	ddrModel 			ddr;
+	trafficGenerator 	traffic(sessions, maxWrite, operations, eager, 7);
+	uint64_t 			cycles = 0;
+
+	if (scheduled){
+		ddr.addPort(memPort(&readCmd, &readData, &writeCmd, &writeData, &writeStatus));
+	}
+	else {
+		for (int c = 0; c < MS_CLIENTS; c++)
+			ddr.addPort(memPort(&io.readCmd[c], &io.readData[c], &io.writeCmd[c], &io.writeData[c], &io.writeStatus[c]));
+	}
+
+	while ((!traffic.done() || !ddr.idle()) && cycles < 10000000){
+		traffic.step(io);
+		if (scheduled)
+			mem_scheduler(io.readCmd, io.readData, io.writeCmd, io.writeData, io.writeStatus,
+					readCmd, readData, writeCmd, writeData, writeStatus);
+		ddr.step();
+		cycles++;
+	}
+	for (int i = 0; i < 1000; i++){ 			// Nothing else may come out
+		if (scheduled)
+			mem_scheduler(io.readCmd, io.readData, io.writeCmd, io.writeData, io.writeStatus,
+					readCmd, readData, writeCmd, writeData, writeStatus);
+		ddr.step();
+	}
+	for (int c = 0; c < MS_CLIENTS; c++){
+		if (!io.readData[c].empty() || !io.writeStatus[c].empty()){
+			cout << "Extra responses for client " << c << endl;
+			traffic.errors++;
+		}
+	}
+
+	cout << setw(12) << (scheduled ? "scheduler" : "direct") << (eager ? "*" : " ") << setw(10) << sessions << setw(10) << maxWrite 
+		 << setw(10) << cycles << setw(10) << ddr.commands << setw(10) << ddr.rowMisses 
+		 << setw(10) << fixed << setprecision(1) << (100.0 * ddr.dataCycles / cycles)
+		 << setw(10) << setprecision(2) << (traffic.bytes / (cycles * 3.1)) << endl;
+
+	if (traffic.errors)
+		cout << traffic.errors << " errors" << endl;
+	return traffic.errors;
+}
+
+int main(int argc, char **argv) {
+
+	int errors = 0;
+	int operations = 20000;
+
+	cout << setw(13) << "" << setw(10) << "sessions" << setw(10) << "max wr" << setw(10) << "cycles" << setw(10) 
+		 << "commands" << setw(10) << "row miss" << setw(10) << "busy %" << setw(10) << "GB/s" << endl;
+	errors += runTraffic(false, 4, 256, operations);
+	errors += runTraffic(true, 4, 256, operations);
+	errors += runTraffic(false, 16, 256, operations);
+	errors += runTraffic(true, 16, 256, operations);
+	errors += runTraffic(false, 4, 2048, operations);
+	errors += runTraffic(true, 4, 2048, operations);
+	errors += runTraffic(false, 2, 9000, operations / 4);
+	errors += runTraffic(true, 2, 9000, operations / 4);
+	// Eager clients, marked with *, read data before its write status is back
+	errors += runTraffic(false, 4, 256, operations, true);
+	errors += runTraffic(true, 4, 256, operations, true);
+	errors += runTraffic(true, 16, 2048, operations, true);
+
+	cout << (errors ? "FAILED" : "PASSED") << endl;
+	return errors;
+}
@@ -153,7 +153,6 @@ void check_in_multiplexer(	stream<ap_uint<16> >&		rxEng2portTable_req,
 
 	static const bool LT = true;
 	static const bool FT = false;
-	static bool	dst = LT;
 	ap_uint<16>			checkPort;
 	ap_uint<16>			swappedCheckPort;
 
@@ -185,7 +184,6 @@ void check_out_multiplexer(	stream<bool>&				pt_dstFifoIn,
 
 	//enum portCheckDstType {LT, FT};
 	static const bool LT = true;
-	static const bool FT = false;
 	//static stream<bool> pt_dstFifo("pt_dstFifo");
 	//#pragma HLS STREAM variable=pt_dstFifo depth=4
 
@@ -47,7 +47,7 @@ int main()
 	stream<ap_uint<16> > rxPortTableIn("rxPortTableIn");
 	stream<bool> rxPortTableOut("rxPortTableOut");
 	stream<ap_uint<16> > rxAppListenIn("rxAppListenIn");
-	stream<bool> rxAppListenOut("rxAppListenOut");
+	stream<listenPortStatus> rxAppListenOut("rxAppListenOut");
 	//stream<ap_uint<16> > rxAppCloseIn("rxAppCloseIn");
 	//stream<ap_uint<1> > txAppGetPortIn("txAppGetPortIn");
 	stream<ap_uint<16> > txAppGetPortOut("txAppGetPortOut");
@@ -69,13 +69,8 @@ int main()
 		std::cout << "Error: could not open test output file." << std::endl;
 	}
 
-	uint16_t strbTemp;
-	uint64_t dataTemp;
-	uint16_t lastTemp;
 	int count = 0;
 
-	int pkgCount = 0;
-
 	/*while (inputFile >> std::hex >> dataTemp >> strbTemp >> lastTemp)
 	{
 		inData.data = dataTemp;
@@ -89,11 +84,7 @@ int main()
 	}*/
 
 	bool currBool = false;
-	ap_uint<16> currPort = 0;
 	ap_uint<16> port;
-	bool isOpen = false;
-	int mod = 0;
-	int randPort = 32767;
 	ap_uint<16> temp;
 	while (count < 500) //was 250
 	{
@@ -138,8 +129,8 @@ int main()
 		}
 		if (!rxAppListenOut.empty())
 		{
-			rxAppListenOut.read(currBool);
-			outputFile << "Listening " << (currBool ? "" : "not") << " successful" << std::endl;
+			listenPortStatus status = rxAppListenOut.read();
+			outputFile << "Listening " << (status.open_successfully ? "" : "not") << " successful" << std::endl;
 		}
 		/*if (!txAppGetPortOut.empty())
 		{
@@ -31,141 +31,245 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 
 using namespace hls;
 
+/** @ingroup retransmit_timer
+ *  Time-out interval after @p retries time-outs in a row, in table scans. The minimum interval
+ *  is shifted left by the backoff of the profile for every time-out and capped at its maximum.
+ */
+ap_uint<32> rt_interval(ap_uint<3> retries, rtProfile profile)
+{
+#pragma HLS INLINE
+	ap_uint<64> interval = ap_uint<64>(profile.rtoMin) << (retries * profile.backoffShift);
+
+	return (interval > profile.rtoMax) ? profile.rtoMax : ap_uint<32>(interval);
+}
+
+/** @ingroup retransmit_timer
+ *  True once @p now reached @p deadline, both count table scans and may wrap around
+ */
+bool rt_expired(ap_uint<32> deadline, ap_uint<32> now)
+{
+#pragma HLS INLINE
+	ap_uint<32> remaining = deadline - now;
+	return (remaining == 0) || remaining.bit(31);
+}
+
 /** @ingroup retransmit_timer
  *  The @ref tx_engine sends the Session-ID and Eventy type through the @param txRetransmitTimerFifoIn.
  *  If the timer is unactivated for this session it is activated, the time-out interval is set depending on
- *  how often the session already time-outed.
- *  The @ref rx_engine indicates when a timer for a specific session has to be stopped.
- *	If a timer times-out the corresponding EVent is fired back to the @ref tx_engine. If a session times-out more than 4 times
- *	in a row, it is aborted. The session is released through @param retransmitTimerReleaseFifoOut and the application is
+ *  how often the session already time-outed and on the retransmit profile of the session.
+ *  The @ref rx_engine indicates when a timer for a specific session has to be stopped, and on a passive open the
+ *  listen port, which picks the profile of the session. An active open starts with the default profile 0.
+ *	If a timer times-out the corresponding EVent is fired back to the @ref tx_engine. If a session times-out more than
+ *	the retries of its profile in a row, SYN and SYN-ACK have a limit of their own, it is aborted. The session is released through @param retransmitTimerReleaseFifoOut and the application is
  *	notified through @param timerNotificationFifoOut.
- *	Currently the II is 2 which means that the interval take twice as much time as defined.
+ *	A timer holds its deadline, counted in table scans, so the scan only reads the table and checks one session
+ *	every cycle. The set and the clear path write their deadline to a memory of their own and rt_fromSet tells which
+ *	one is valid, the active bits and retries are registers. Clear, set and the scan go in the same cycle, in this
+ *	order when they hit the same session; a session set or cleared in the cycle is not checked by the scan.
  *  @param[in]		rxEng2timer_clearRetransmitTimer
  *  @param[in]		txEng2timer_setRetransmitTimer
  *  @param[out]		rtTimer2eventEng_setEvent
  *  @param[out]		rtTimer2stateTable_releaseState
  *  @param[out]		rtTimer2rxApp_notification
+ *  @param[out]		rtTimer2txApp_notification
+ *  @param[in]		rt_policy_regs, profiles, listen port rules and per session profiles written through AXI4-Lite
  */
 void retransmit_timer(	stream<rxRetransmitTimerUpdate>&	rxEng2timer_clearRetransmitTimer,
 						stream<txRetransmitTimerSet>&		txEng2timer_setRetransmitTimer,
 						stream<event>&						rtTimer2eventEng_setEvent,
 						stream<ap_uint<16> >&				rtTimer2stateTable_releaseState,
 						stream<appNotification>&			rtTimer2rxApp_notification,
+#if (RT_POLICY_TABLE)
+						stream<openStatus>&					rtTimer2txApp_notification,
+						rtPolicyRegs&						rt_policy_regs)
+#else
 						stream<openStatus>&					rtTimer2txApp_notification)
+#endif
 {
 #pragma HLS PIPELINE II=1
 //#pragma HLS INLINE
 
-	static retransmitTimerEntry retransmitTimerTable[MAX_SESSIONS];
-	#pragma HLS RESOURCE variable=retransmitTimerTable core=RAM_T2P_BRAM
-	#pragma HLS DATA_PACK variable=retransmitTimerTable
-	#pragma HLS DEPENDENCE variable=retransmitTimerTable inter false
+	static ap_uint<32>			rt_setDeadline[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=rt_setDeadline core=RAM_2P_BRAM
+	#pragma HLS DEPENDENCE variable=rt_setDeadline inter false
+	static ap_uint<32>			rt_clearDeadline[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=rt_clearDeadline core=RAM_2P_BRAM
+	#pragma HLS DEPENDENCE variable=rt_clearDeadline inter false
+	static eventType			rt_type[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=rt_type core=RAM_2P_LUTRAM
+	#pragma HLS DEPENDENCE variable=rt_type inter false
+	static ap_uint<3>			rt_retries[MAX_SESSIONS];
+	#pragma HLS ARRAY_PARTITION variable=rt_retries complete
+	static rtProfile			rt_profiles[1 << RT_PROFILE_BITS];
+	#pragma HLS ARRAY_PARTITION variable=rt_profiles complete
+	static ap_uint<RT_PROFILE_BITS>	rt_sessionProfile[MAX_SESSIONS];
+	#pragma HLS ARRAY_PARTITION variable=rt_sessionProfile complete
+#if (RT_POLICY_TABLE)
+	static bool					rt_portRuleValid[RT_PORT_RULES];
+	#pragma HLS ARRAY_PARTITION variable=rt_portRuleValid complete
+	static ap_uint<16>			rt_portRulePort[RT_PORT_RULES];
+	#pragma HLS ARRAY_PARTITION variable=rt_portRulePort complete
+	static ap_uint<RT_PROFILE_BITS>	rt_portRuleProfile[RT_PORT_RULES];
+	#pragma HLS ARRAY_PARTITION variable=rt_portRuleProfile complete
+	static ap_uint<1>			rt_profileWrite_r = 0;
+	static ap_uint<1>			rt_portWrite_r = 0;
+	static ap_uint<1>			rt_sessionWrite_r = 0;
+#endif
+	static ap_uint<MAX_SESSIONS>	rt_active = 0;
+	static ap_uint<MAX_SESSIONS>	rt_fromSet = 0;
 
 	static ap_uint<16>			rt_position = 0;
-	static bool							rt_waitForWrite = false;
-	static ap_uint<16>					rt_prevPosition = 0;
-	static rxRetransmitTimerUpdate	rt_update;
+	static ap_uint<32>			rt_now = 0;
 
-	retransmitTimerEntry	currEntry;
-	ap_uint<1> operationSwitch = 0;
+	// Writes of the previous cycle, forwarded to the scan
+	static bool					rt_prevSetValid = false;
+	static bool					rt_prevSetDeadlineValid = false;
+	static ap_uint<16>			rt_prevSetID;
+	static ap_uint<32>			rt_prevSetDeadline;
+	static eventType			rt_prevSetType;
+	static bool					rt_prevClearValid = false;
+	static ap_uint<16>			rt_prevClearID;
+	static ap_uint<32>			rt_prevClearDeadline;
+
+	rxRetransmitTimerUpdate	update;
 	txRetransmitTimerSet	set;
-	ap_uint<16>				currID;
+	bool					clearValid = false;
+	bool					clearDeadlineValid = false;
+	bool					setValid = false;
+	bool					setDeadlineValid = false;
+	ap_uint<32>				clearDeadline;
+	ap_uint<32>				setDeadline;
+	ap_uint<16>				currID = rt_position;
+
+	// Scan reads
+	ap_uint<32>	currSetDeadline 	= rt_setDeadline[currID];
+	ap_uint<32>	currClearDeadline 	= rt_clearDeadline[currID];
+	eventType	currType 			= rt_type[currID];
+	if (rt_prevSetDeadlineValid && (rt_prevSetID == currID)) {
+		currSetDeadline = rt_prevSetDeadline;
+	}
+	if (rt_prevSetValid && (rt_prevSetID == currID)) {
+		currType = rt_prevSetType;
+	}
+	if (rt_prevClearValid && (rt_prevClearID == currID)) {
+		currClearDeadline = rt_prevClearDeadline;
+	}
 
-	if (rt_waitForWrite && (rt_update.sessionID != rt_prevPosition)) { //TODO maybe prevprev too
-	
-		if (!rt_update.stop) {
-			retransmitTimerTable[rt_update.sessionID].time = TIME_1s;
+	// RX Engine clears or restarts a timer
+	if (!rxEng2timer_clearRetransmitTimer.empty()) {
+		rxEng2timer_clearRetransmitTimer.read(update);
+		clearValid = true;
+		ap_uint<RT_PROFILE_BITS> profileID = rt_sessionProfile[update.sessionID];
+#if (RT_POLICY_TABLE)
+		if (update.open) {
+			profileID = 0;
+			for (uint8_t i = 0; i < RT_PORT_RULES; i++) {
+			#pragma HLS UNROLL
+				if (rt_portRuleValid[i] && (rt_portRulePort[i] == update.port)) {
+					profileID = rt_portRuleProfile[i];
+				}
+			}
+			rt_sessionProfile[update.sessionID] = profileID;
+		}
+#endif
+		if (!update.stop) {
+			clearDeadline = rt_now + rt_profiles[profileID].rtoMin + 1;
+			rt_clearDeadline[update.sessionID] = clearDeadline;
+			rt_fromSet.bit(update.sessionID) = 0;
+			clearDeadlineValid = true;
 		}
 		else {
-			retransmitTimerTable[rt_update.sessionID].time = 0;
-			retransmitTimerTable[rt_update.sessionID].active = false;
+			rt_active.bit(update.sessionID) = 0;
 		}
-		retransmitTimerTable[rt_update.sessionID].retries = 0;
-		rt_waitForWrite = false;
+		rt_retries[update.sessionID] = 0;
 	}
-	else if (!rxEng2timer_clearRetransmitTimer.empty() && !rt_waitForWrite) { //FIXME rx path has priority over tx path
-	
-		rxEng2timer_clearRetransmitTimer.read(rt_update);
-		rt_waitForWrite = true;
-	}
-	else {
-		currID = rt_position;
-
-		if (!txEng2timer_setRetransmitTimer.empty()) {
-			txEng2timer_setRetransmitTimer.read(set);		// TODO reply with set.sessionID-3 to avoid to make that computation here
-			currID = set.sessionID;
-			operationSwitch = 1;
-			if (set.sessionID-3 < rt_position && rt_position <= set.sessionID) {
-				rt_position += 5;
+
+	// TX Engine sets a timer, the interval grows with the time-outs in a row
+	if (!txEng2timer_setRetransmitTimer.empty()) {
+		txEng2timer_setRetransmitTimer.read(set);
+		setValid = true;
+		rt_type[set.sessionID] = set.type;
+		if (!rt_active.bit(set.sessionID)) {
+			ap_uint<RT_PROFILE_BITS> profileID = rt_sessionProfile[set.sessionID];
+			if ((set.type == SYN) && (rt_retries[set.sessionID] == 0)) {	// Active open
+				profileID = 0;
+				rt_sessionProfile[set.sessionID] = 0;
 			}
+			setDeadline = rt_now + rt_interval(rt_retries[set.sessionID], rt_profiles[profileID]) + 1;		// At least the interval
+			rt_setDeadline[set.sessionID] = setDeadline;
+			rt_fromSet.bit(set.sessionID) = 1;
+			setDeadlineValid = true;
+		}
+		rt_active.bit(set.sessionID) = 1;
+	}
+
+	// Scan
+	bool touched = (clearValid && (update.sessionID == currID)) || (setValid && (set.sessionID == currID));
+	ap_uint<32> currDeadline = rt_fromSet.bit(currID) ? currSetDeadline : currClearDeadline;
+
+	// We need to check if we can generate another event, otherwise we might end up in a Deadlock,
+	// since the TX Engine will not be able to set new retransmit timers
+	if (!touched && rt_active.bit(currID) && rt_expired(currDeadline, rt_now) && !rtTimer2eventEng_setEvent.full()) {
+		rtProfile	profile = rt_profiles[rt_sessionProfile[currID]];
+		ap_uint<3>	maxRetries = ((currType == SYN) || (currType == SYN_ACK)) ? profile.synMaxRetries : profile.maxRetries;
+		rt_active.bit(currID) = 0;
+		if (rt_retries[currID] < maxRetries) {
+			rt_retries[currID]++;
+			rtTimer2eventEng_setEvent.write(event(currType, currID, rt_retries[currID]));
+			std::cout << "Setting event for retransmit event type " << std::dec << currType << "\tat " << simCycleCounter << std::endl;
 		}
 		else {
-			// increment position
-			rt_position++;
-			if (rt_position >= MAX_SESSIONS) {
-				rt_position = 0;
+			rt_retries[currID] = 0;
+			rtTimer2stateTable_releaseState.write(currID);
+			if (currType == SYN) {
+				rtTimer2txApp_notification.write(openStatus(currID, false));
+			}
+			else {
+				rtTimer2rxApp_notification.write(appNotification(currID, true)); //TIME_OUT
 			}
-			operationSwitch = 0;
 		}
+	}
 
-		// Get entry from table
-		currEntry = retransmitTimerTable[currID];
-		switch (operationSwitch) {
-		case 1:
-			currEntry.type = set.type;
-			if (!currEntry.active)	{
-				switch(currEntry.retries)
-				{
-				case 0:
-					currEntry.time = TIME_1s; //TIME_5s;
-					break;
-				case 1:
-					currEntry.time = TIME_5s; //TIME_7s;
-					break;
-				case 2:
-					currEntry.time = TIME_10s; //TIME_15s;
-					break;
-				case 3:
-					currEntry.time = TIME_15s; //TIME_20s;
-					break;
-				default:
-					currEntry.time = TIME_30s; //TIME_30s;
-					break;
-				}
-			}
-			currEntry.active = true;
-			break;
-		case 0:
-			if (currEntry.active) {
-				if (currEntry.time > 0) {
-					currEntry.time--;
-				}
-				// We need to check if we can generate another event, otherwise we might end up in a Deadlock,
-				// since the TX Engine will not be able to set new retransmit timers
-				else if (!rtTimer2eventEng_setEvent.full()) {
-					currEntry.time = 0;
-					currEntry.active = false;
-					if (currEntry.retries < 4) {
-						currEntry.retries++;
-						rtTimer2eventEng_setEvent.write(event(currEntry.type, currID, currEntry.retries));
-						std::cout << "Setting event for retransmit event type " << std::dec << currEntry.type << "\tat " << simCycleCounter << std::endl;
-					}
-					else {
-						currEntry.retries = 0;
-						rtTimer2stateTable_releaseState.write(currID);
-						if (currEntry.type == SYN) {
-							rtTimer2txApp_notification.write(openStatus(currID, false));
-						}
-						else {
-							rtTimer2rxApp_notification.write(appNotification(currID, true)); //TIME_OUT
-						}
-					}
-				}
-			} //if active
-			break;
-		} //switch
-		// write entry back
-		retransmitTimerTable[currID] = currEntry;
-		rt_prevPosition = currID;
+#if (RT_POLICY_TABLE)
+	// Policy writes, on the rising edge of their strobe
+	if (rt_policy_regs.profileWrite && !rt_profileWrite_r) {
+		rt_profiles[rt_policy_regs.profileID] = rtProfile(rt_policy_regs.rtoMin, rt_policy_regs.rtoMax, rt_policy_regs.backoffShift,
+															rt_policy_regs.maxRetries, rt_policy_regs.synMaxRetries);
+	}
+	if (rt_policy_regs.portWrite && !rt_portWrite_r) {
+		rt_portRuleValid[rt_policy_regs.portRuleID] 	= rt_policy_regs.portRuleValid;
+		rt_portRulePort[rt_policy_regs.portRuleID] 		= rt_policy_regs.listenPort;
+		rt_portRuleProfile[rt_policy_regs.portRuleID] 	= rt_policy_regs.portProfile;
+	}
+	if (rt_policy_regs.sessionWrite && !rt_sessionWrite_r && (rt_policy_regs.sessionID < MAX_SESSIONS)) {
+		rt_sessionProfile[rt_policy_regs.sessionID] = rt_policy_regs.sessionProfile;
+	}
+	rt_profileWrite_r 	= rt_policy_regs.profileWrite;
+	rt_portWrite_r 		= rt_policy_regs.portWrite;
+	rt_sessionWrite_r 	= rt_policy_regs.sessionWrite;
+#endif
+
+	if (rt_position == MAX_SESSIONS-1) {
+		rt_position = 0;
+		rt_now++;
+	}
+	else {
+		rt_position++;
+	}
+
+	// The values are only kept when they were read or computed in this cycle
+	rt_prevSetValid 			= setValid;
+	rt_prevSetDeadlineValid 	= setDeadlineValid;
+	rt_prevClearValid 			= clearDeadlineValid;
+	if (setValid) {
+		rt_prevSetID 			= set.sessionID;
+		rt_prevSetType 			= set.type;
+	}
+	if (setDeadlineValid) {
+		rt_prevSetDeadline 		= setDeadline;
+	}
+	if (clearDeadlineValid) {
+		rt_prevClearID 			= update.sessionID;
+		rt_prevClearDeadline 	= clearDeadline;
 	}
 }
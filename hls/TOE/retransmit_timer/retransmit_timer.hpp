@@ -31,30 +31,20 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 using namespace hls;
 
 /** @ingroup retransmit_timer
- *
- */
-struct retransmitTimerEntry
-{
-	ap_uint<32>		time;
-	ap_uint<3>		retries;
-	bool			active;
-	eventType		type;
-};
-
-/** @ingroup retransmit_timer
- *
+ *  Retransmit profile, times count table scans. The default profile starts at 1 s and
+ *  doubles the interval at every time-out up to 60 s, the 5th time-out releases the session.
  */
-struct mergedInput
+struct rtProfile
 {
-	ap_uint<16>		sessionID;
-	eventType		type;
-	bool			stop;
-	bool			isSet;
-	mergedInput() {}
-	mergedInput(ap_uint<16> id, eventType t)
-			:sessionID(id), type(t), stop(false), isSet(true) {}
-	mergedInput(ap_uint<16> id, bool stop)
-			:sessionID(id), type(RT), stop(stop), isSet(false) {}
+	ap_uint<32>		rtoMin;
+	ap_uint<32>		rtoMax;
+	ap_uint<2>		backoffShift;
+	ap_uint<3>		maxRetries;
+	ap_uint<3>		synMaxRetries;
+	rtProfile()
+			:rtoMin(TIME_1s), rtoMax(TIME_60s), backoffShift(1), maxRetries(4), synMaxRetries(4) {}
+	rtProfile(ap_uint<32> min, ap_uint<32> max, ap_uint<2> shift, ap_uint<3> retries, ap_uint<3> synRetries)
+			:rtoMin(min), rtoMax(max), backoffShift(shift), maxRetries(retries), synMaxRetries(synRetries) {}
 };
 
 /** @defgroup retransmit_timer Retransmit Timer
@@ -65,4 +55,9 @@ void retransmit_timer(	stream<rxRetransmitTimerUpdate>&	rxEng2timer_clearRetrans
 						stream<event>&						rtTimer2eventEng_setEvent,
 						stream<ap_uint<16> >&				rtTimer2stateTable_releaseState,
 						stream<appNotification>&			rtTimer2rxApp_notification,
+#if (RT_POLICY_TABLE)
+						stream<openStatus>&					rtTimer2txApp_notification,
+						rtPolicyRegs&						rt_policy_regs);
+#else
 						stream<openStatus>&					rtTimer2txApp_notification);
+#endif
@@ -27,58 +27,333 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
 EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx, Inc.
 ************************************************/
 #include "retransmit_timer.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <sstream>
 
 using namespace hls;
 
-int main()
-{
-#pragma HLS inline region off
-	//axiWord inData;
-	event evOut;
-	stream<rxRetransmitTimerUpdate> rxEng_clearTimer;
-	stream<txRetransmitTimerSet> txEng_setTimer;
-	stream<event> eventFifoOut;
-	stream<ap_uint<16> >		releaseSessionFifoOut;
-	stream<appNotification> 	notificationFifoOut;
-
-	//std::ifstream inputFile;
-	std::ofstream outputFile;
-
-	/*inputFile.open("/home/dsidler/workspace/toe/retransmit_timer/in.dat");
-
-	if (!inputFile)
-	{
-		std::cout << "Error: could not open test input file." << std::endl;
+unsigned int	simCycleCounter = 0;
+
+/*
+ * Checks the time-outs of the retransmit timer, alone and while the TX engine sets
+ * and the RX engine clears other timers every cycle. The TIME_ constants count table
+ * scans, a time-out has to come between the interval and the interval plus two scans
+ * after the set. With RT_POLICY_TABLE the timeline of every profile is checked, the
+ * profiles are given to connections through AXI4-Lite and through their listen port.
+ */
+
+struct timeOut {
+	uint64_t		cycle;
+	event			ev;
+};
+
+struct rtTimerIf {
+	stream<rxRetransmitTimerUpdate> 	clearIn;
+	stream<txRetransmitTimerSet> 		setIn;
+	stream<event> 						eventOut;
+	stream<ap_uint<16> >				releaseOut;
+	stream<appNotification> 			rxAppOut;
+	stream<openStatus> 					txAppOut;
+	rtPolicyRegs						regs;
+	uint64_t							cycle;
+	std::vector<timeOut>				events;
+	std::vector<std::pair<uint64_t, ap_uint<16> > >	releases;
+
+	rtTimerIf() : regs(), cycle(0) {}
+	void run() {
+#if (RT_POLICY_TABLE)
+		retransmit_timer(clearIn, setIn, eventOut, releaseOut, rxAppOut, txAppOut, regs);
+#else
+		retransmit_timer(clearIn, setIn, eventOut, releaseOut, rxAppOut, txAppOut);
+#endif
+		while (!eventOut.empty()) {
+			timeOut to = {cycle, eventOut.read()};
+			events.push_back(to);
+		}
+		while (!releaseOut.empty()) {
+			releases.push_back(std::make_pair(cycle, releaseOut.read()));
+		}
+		cycle++;
+		simCycleCounter++;
+	}
+	void run(int cycles) {
+		for (int i = 0; i < cycles; i++) {
+			run();
+		}
+	}
+	// Index of the first time-out of a session from event first on, -1 if none
+	int find(ap_uint<16> id, int first) {
+		for (int i = first; i < (int) events.size(); i++) {
+			if (events[i].ev.sessionID == id)
+				return i;
+		}
 		return -1;
-	}*/
-	outputFile.open("/home/dasidler/toe/hls/toe/retransmit_timer/out.dat");
-	if (!outputFile)
-	{
-		std::cout << "Error: could not open test output file." << std::endl;
 	}
+	// AXI4-Lite writes, the strobe goes high for one cycle
+	void writeProfile(ap_uint<RT_PROFILE_BITS> id, const rtProfile& profile) {
+		regs.profileID 		= id;
+		regs.rtoMin 		= profile.rtoMin;
+		regs.rtoMax 		= profile.rtoMax;
+		regs.backoffShift 	= profile.backoffShift;
+		regs.maxRetries 	= profile.maxRetries;
+		regs.synMaxRetries 	= profile.synMaxRetries;
+		regs.profileWrite = 1;
+		run();
+		regs.profileWrite = 0;
+		run();
+	}
+	void writePortRule(ap_uint<2> rule, bool valid, ap_uint<16> port, ap_uint<RT_PROFILE_BITS> profile) {
+		regs.portRuleID 	= rule;
+		regs.portRuleValid 	= valid;
+		regs.listenPort 	= port;
+		regs.portProfile 	= profile;
+		regs.portWrite = 1;
+		run();
+		regs.portWrite = 0;
+		run();
+	}
+	void writeSession(ap_uint<16> id, ap_uint<RT_PROFILE_BITS> profile) {
+		regs.sessionID 		= id;
+		regs.sessionProfile = profile;
+		regs.sessionWrite = 1;
+		run();
+		regs.sessionWrite = 0;
+		run();
+	}
+};
 
-	uint32_t count = 0;
-	txEng_setTimer.write(txRetransmitTimerSet(7));
-	while (count < 50000)
-	{
-		if (count == 10 || count == 15)
-		{
-			txEng_setTimer.write(txRetransmitTimerSet(7));
+#define CHECK(cond, msg) if (!(cond)) { std::cout << "ERROR " << msg << std::endl; errors++; }
+
+bool inBound(uint64_t elapsed, ap_uint<32> interval)
+{
+	return (elapsed > interval * MAX_SESSIONS) && (elapsed <= (interval + 2) * MAX_SESSIONS);
+}
+
+// Reference of the interval after k time-outs in a row
+ap_uint<32> expectedInterval(const rtProfile& profile, int k)
+{
+	uint64_t interval = ((uint64_t) profile.rtoMin) << (k * profile.backoffShift);
+	return (interval > profile.rtoMax) ? profile.rtoMax : ap_uint<32>(interval);
+}
+
+/*
+ * The TX engine retransmits after every time-out until the session is released,
+ * every time-out has to follow the interval of the profile and the release has to come
+ * after its retries. Returns the number of errors
+ */
+int timeline(rtTimerIf& rt, ap_uint<16> id, eventType type, const rtProfile& profile, const char* name)
+{
+	int retries = ((type == SYN) || (type == SYN_ACK)) ? profile.synMaxRetries : profile.maxRetries;
+	int errors = 0;
+	int first = rt.events.size();
+
+	std::ostringstream scans;
+
+	rt.releases.clear();
+	for (int i = 0; i <= retries; i++) {
+		uint64_t setCycle = rt.cycle;
+		ap_uint<32> interval = expectedInterval(profile, i);
+		rt.setIn.write(txRetransmitTimerSet(id, type));
+		while ((rt.find(id, first) == -1) && rt.releases.empty() && (rt.cycle < setCycle + (interval + 4) * MAX_SESSIONS)) {
+			rt.run();
+		}
+		if (i < retries) {
+			int idx = rt.find(id, first);
+			CHECK(idx != -1, name << " time-out " << i + 1 << " missing");
+			if (idx == -1)
+				return errors;
+			scans << " " << (rt.events[idx].cycle - setCycle) / MAX_SESSIONS;
+			CHECK(inBound(rt.events[idx].cycle - setCycle, interval), name << " time-out " << i + 1 << " after " << rt.events[idx].cycle - setCycle << " cycles");
+			CHECK((rt.events[idx].ev.type == type) && (rt.events[idx].ev.rt_count.to_int() == i + 1), name << " event of time-out " << i + 1);
+			first = idx + 1;
+		}
+		else {
+			CHECK((rt.releases.size() == 1) && (rt.releases[0].second == id), name << " release after time-out " << i + 1);
+			if (rt.releases.empty())
+				return errors;
+			scans << " " << (rt.releases[0].first - setCycle) / MAX_SESSIONS << " release";
+			CHECK(inBound(rt.releases[0].first - setCycle, interval), name << " release after " << rt.releases[0].first - setCycle << " cycles");
+			if (type == SYN) {
+				CHECK(!rt.txAppOut.empty() && !rt.txAppOut.read().success, name << " SYN time-out reported");
+			}
+			else {
+				CHECK(!rt.rxAppOut.empty() && rt.rxAppOut.read().closed, name << " application notified of the time-out");
+			}
 		}
+	}
+	rt.releases.clear();
+	rt.run(2 * MAX_SESSIONS);
+	CHECK(rt.find(id, first) == -1, name << " time-out after the release");
 
+	std::cout << name << ": scans" << scans.str() << ": " << (errors ? "FAILED" : "passed") << std::endl;
+	return errors;
+}
 
-		retransmit_timer(rxEng_clearTimer, txEng_setTimer, eventFifoOut, releaseSessionFifoOut, notificationFifoOut);
-		if(!eventFifoOut.empty())
-		{
-			eventFifoOut.read(evOut);
-			outputFile << "Event happened, ID: " << evOut.sessionID;// << std::endl;
-			outputFile << "\t\t Count: " << count << std::endl;
+int ladderTest(rtTimerIf& rt)
+{
+	int errors = 0;
+
+	errors += timeline(rt, 7, RT, rtProfile(), "default");
+	// A SYN that is never answered is reported to the TX app
+	errors += timeline(rt, 9, SYN, rtProfile(), "default SYN");
+	return errors;
+}
+
+int clearTest(rtTimerIf& rt)
+{
+	int errors = 0;
+	int first;
+
+	// Stopped before the time-out
+	first = rt.events.size();
+	rt.setIn.write(txRetransmitTimerSet(11));
+	rt.run(MAX_SESSIONS);
+	rt.clearIn.write(rxRetransmitTimerUpdate(11, true));
+	rt.run((TIME_1s + 4) * MAX_SESSIONS);
+	CHECK(rt.find(11, first) == -1, "time-out of a stopped timer");
+
+	// Restarted by every ACK, times out one interval after the last one
+	rt.setIn.write(txRetransmitTimerSet(12));
+	for (int i = 0; i < 20; i++) {
+		rt.run(MAX_SESSIONS / 2);
+		rt.clearIn.write(rxRetransmitTimerUpdate(12, false));
+	}
+	uint64_t lastClear = rt.cycle;
+	CHECK(rt.find(12, first) == -1, "time-out while restarted");
+	rt.run((TIME_1s + 4) * MAX_SESSIONS);
+	int idx = rt.find(12, first);
+	CHECK((idx != -1) && inBound(rt.events[idx].cycle - lastClear, TIME_1s), "time-out after the last restart");
+	// Back to the first interval after a time-out followed by an ACK
+	rt.clearIn.write(rxRetransmitTimerUpdate(12, true));
+	rt.run(MAX_SESSIONS);
+
+	std::cout << "clear: " << (errors ? "FAILED" : "passed") << std::endl;
+	return errors;
+}
+
+/*
+ * Sessions 32 and up get a set and a clear every cycle, sessions 0 to 15 are set once
+ * at different times and have to time out in time anyway.
+ */
+int loadTest(rtTimerIf& rt)
+{
+	const int PROBES = 16;
+	std::vector<uint64_t> setCycle(PROBES, 0);
+	int errors = 0;
+	int first = rt.events.size();
+	uint64_t start = rt.cycle;
+	uint64_t maxElapsed = 0;
+	uint64_t minElapsed = ~0ULL;
+
+	srand(3);
+	while (rt.cycle < start + (TIME_1s + 4) * MAX_SESSIONS + PROBES * 37) {
+		int probe = (rt.cycle - start) / 37;
+		if ((probe < PROBES) && ((rt.cycle - start) % 37 == 0)) {
+			rt.setIn.write(txRetransmitTimerSet(probe));
+			setCycle[probe] = rt.cycle;
+		}
+		else {
+			rt.setIn.write(txRetransmitTimerSet(32 + rand() % 32));
+		}
+		rt.clearIn.write(rxRetransmitTimerUpdate(32 + rand() % 32, (rand() % 2) == 0));
+		rt.run();
+		CHECK(rt.setIn.empty() && rt.clearIn.empty(), "set and clear not taken in the cycle they came");
+		if (!rt.setIn.empty() || !rt.clearIn.empty()) {
+			break;
 		}
-		count++;
 	}
+	for (int i = 0; i < PROBES; i++) {
+		int idx = rt.find(i, first);
+		if (idx == -1) {
+			std::cout << "ERROR session " << i << " did not time out" << std::endl;
+			errors++;
+			continue;
+		}
+		uint64_t elapsed = rt.events[idx].cycle - setCycle[i];
+		maxElapsed = (elapsed > maxElapsed) ? elapsed : maxElapsed;
+		minElapsed = (elapsed < minElapsed) ? elapsed : minElapsed;
+		CHECK(inBound(elapsed, TIME_1s), "session " << i << " timed out after " << elapsed << " cycles");
+	}
+	std::cout << "load: time-outs after " << minElapsed << " to " << maxElapsed << " cycles, interval ";
+	std::cout << TIME_1s * MAX_SESSIONS << ": " << (errors ? "FAILED" : "passed") << std::endl;
+
+	// Stop the loaded timers
+	for (int i = 32; i < 64; i++) {
+		rt.clearIn.write(rxRetransmitTimerUpdate(i, true));
+		rt.run();
+	}
+	return errors;
+}
+
+#if (RT_POLICY_TABLE)
+int policyTest(rtTimerIf& rt)
+{
+	const rtProfile linear(2, 6, 1, 6, 2);			// 2, 4, 6, 6... scans
+	const rtProfile steep(3, 100, 2, 2, 1);			// 3, 12, 48 scans, one SYN-ACK retry
+	const rtProfile oneShot(4, 4, 0, 0, 0);			// Released at the first time-out
+	int errors = 0;
+
+	rt.writeProfile(1, linear);
+	rt.writeProfile(2, steep);
+	rt.writeProfile(3, oneShot);
 
+	// Per connection
+	rt.writeSession(20, 1);
+	errors += timeline(rt, 20, RT, linear, "session profile 1");
+	// An ACK restarts the timer with the minimum of the profile
+	int first = rt.events.size();
+	rt.setIn.write(txRetransmitTimerSet(20));
+	rt.run(MAX_SESSIONS);
+	rt.clearIn.write(rxRetransmitTimerUpdate(20, false));
+	uint64_t restart = rt.cycle;
+	rt.run((linear.rtoMin + 3) * MAX_SESSIONS);
+	int idx = rt.find(20, first);
+	CHECK((idx != -1) && inBound(rt.events[idx].cycle - restart, linear.rtoMin), "restart with the profile minimum");
+	rt.clearIn.write(rxRetransmitTimerUpdate(20, true));
+	rt.run(MAX_SESSIONS);
+	// An active open goes back to the default profile
+	errors += timeline(rt, 20, SYN, rtProfile(), "active open");
+
+	// Per listen port, SYN-ACK has its own retry limit
+	rt.writePortRule(0, true, 8080, 2);
+	rt.writePortRule(1, true, 5001, 3);
+	rt.clearIn.write(rxRetransmitTimerUpdate(21, 8080, true));
+	errors += timeline(rt, 21, SYN_ACK, steep, "port 8080 SYN-ACK");
+	rt.clearIn.write(rxRetransmitTimerUpdate(21, 8080, true));
+	errors += timeline(rt, 21, RT, steep, "port 8080");
+	rt.clearIn.write(rxRetransmitTimerUpdate(22, 5001, true));
+	errors += timeline(rt, 22, RT, oneShot, "port 5001");
+	rt.clearIn.write(rxRetransmitTimerUpdate(23, 80, true));
+	errors += timeline(rt, 23, RT, rtProfile(), "port 80");
+	rt.writePortRule(0, false, 8080, 2);
+	rt.clearIn.write(rxRetransmitTimerUpdate(21, 8080, true));
+	errors += timeline(rt, 21, RT, rtProfile(), "port 8080 rule removed");
+
+	// The default profile is written like the others
+	const rtProfile fastSyn(TIME_1s, TIME_60s, 1, 4, 1);
+	rt.writeProfile(0, fastSyn);
+	errors += timeline(rt, 24, SYN, fastSyn, "profile 0 SYN");
+	rt.writeProfile(0, rtProfile());
+
+	std::cout << "policy: " << (errors ? "FAILED" : "passed") << std::endl;
+	return errors;
+}
+#endif
+
+int main()
+{
+	rtTimerIf rt;
+	int errors = 0;
 
-	//should return comparison
+	errors += ladderTest(rt);
+	errors += clearTest(rt);
+	errors += loadTest(rt);
+#if (RT_POLICY_TABLE)
+	errors += policyTest(rt);
+#endif
 
-	return 0;
+	std::cout << (errors ? "FAILED" : "PASSED") << std::endl;
+	return (errors != 0);
 }
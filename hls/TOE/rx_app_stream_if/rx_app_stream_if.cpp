@@ -36,12 +36,59 @@ using namespace hls;
  *  The Application polls data from the buffer by sending a readRequest. The module checks
  *  if the readRequest is valid then it sends a read request to the memory. After processing
  *  the request the MetaData containig the Session-ID is also written back.
+ *  With RX_SESSION_QUEUES the readRequest goes to the queues of the sessions, which
+ *  return the session ID and the data. The app pointer is updated when the queue
+ *  reports that the data has left it, so the window is opened by the queue drain.
  *  @param[in]		appRxDataReq
  *  @param[in]		rxSar2rxApp_upd_rsp
+ *  @param[out]		rxQueueReadCmd
+ *  @param[in]		rxQueueDrained
  *  @param[out]		appRxDataRspIDsession
  *  @param[out]		rxApp2rxSar_upd_req
  *  @param[out]		rxBufferReadCmd
  */
+#if (RX_SESSION_QUEUES)
+void rx_app_stream_if(stream<appReadRequest>&		appRxDataReq,
+					  stream<rxSarAppd>&			rxSar2rxApp_upd_rsp,
+					  stream<appReadRequest>&		rxQueueReadCmd,
+					  stream<appReadRequest>&		rxQueueDrained,
+					  stream<rxSarAppd>&			rxApp2rxSar_upd_req)
+{
+#pragma HLS PIPELINE II=1
+
+	static ap_uint<16>				rasi_readLength;
+	static ap_uint<1>				rasi_fsmState 	= 0;
+	appReadRequest					app_read_request;
+	appReadRequest					drained;
+	rxSarAppd						rxSar;
+
+	switch (rasi_fsmState) {
+		case 0:
+			if (!rxQueueDrained.empty()) {
+				rxQueueDrained.read(drained);
+				// Get app pointer
+				rxApp2rxSar_upd_req.write(rxSarAppd(drained.sessionID));
+				rasi_readLength = drained.length;
+				rasi_fsmState = 1;
+			}
+			else if (!appRxDataReq.empty()) {
+				appRxDataReq.read(app_read_request);
+				if (app_read_request.length != 0) {
+					rxQueueReadCmd.write(app_read_request);
+				}
+			}
+			break;
+		case 1:
+			if (!rxSar2rxApp_upd_rsp.empty()) {
+				rxSar2rxApp_upd_rsp.read(rxSar);
+				// Update app read pointer, the drained bytes are free again
+				rxApp2rxSar_upd_req.write(rxSarAppd(rxSar.sessionID, rxSar.appd+rasi_readLength));
+				rasi_fsmState = 0;
+			}
+			break;
+	}
+}
+#else
 void rx_app_stream_if(stream<appReadRequest>&		appRxDataReq,
 					  stream<rxSarAppd>&			rxSar2rxApp_upd_rsp,
 					  stream<ap_uint<16> >&			appRxDataRspIDsession,
@@ -56,7 +103,9 @@ void rx_app_stream_if(stream<appReadRequest>&		appRxDataReq,
 	static ap_uint<2>				rasi_fsmState 	= 0;
 	appReadRequest					app_read_request;
 	rxSarAppd						rxSar;
+#if (!RX_DDR_BYPASS)
 	ap_uint<32> 					pkgAddr = 0;
+#endif
 
 	switch (rasi_fsmState) {
 		case 0:
@@ -87,3 +136,4 @@ void rx_app_stream_if(stream<appReadRequest>&		appRxDataReq,
 			break;
 	}
 }
+#endif
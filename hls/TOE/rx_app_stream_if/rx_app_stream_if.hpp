@@ -36,7 +36,12 @@ using namespace hls;
  */
 void rx_app_stream_if(	stream<appReadRequest>&		appRxDataReq,
 						stream<rxSarAppd>&			rxSar2rxApp_upd_rsp,
+#if (RX_SESSION_QUEUES)
+						stream<appReadRequest>&		rxQueueReadCmd,
+						stream<appReadRequest>&		rxQueueDrained,
+#else
 						stream<ap_uint<16> >&		appRxDataRspIDsession,
+#endif
 #if (!RX_DDR_BYPASS)
 						stream<cmd_internal>&		rxBufferReadCmd,
 #endif
@@ -36,22 +36,42 @@ int main()
 {
 	stream<appReadRequest>		appRxDataReq;
 	stream<rxSarAppd>			rxSar2rxApp_upd_rsp;
+#if (RX_SESSION_QUEUES)
+	stream<appReadRequest>		rxQueueReadCmd;
+	stream<appReadRequest>		rxQueueDrained;
+#else
 	stream<ap_uint<16> >		appRxDataRspMetadata;
+#endif
+#if (!RX_DDR_BYPASS)
+	stream<cmd_internal>		rxBufferReadCmd;
+#endif
 	stream<rxSarAppd>			rxApp2rxSar_upd_req;
-	stream<mmCmd>				rxBufferReadCmd;
 
 	rxSarAppd req;
-	mmCmd cmd;
+#if (!RX_DDR_BYPASS)
+	cmd_internal cmd;
+#endif
+#if (RX_SESSION_QUEUES)
+	appReadRequest queueCmd;
+#else
 	ap_uint<16> meta;
+#endif
 
 	int count = 0;
 	while (count < 50)
 	{
 		rx_app_stream_if(	appRxDataReq,
 							rxSar2rxApp_upd_rsp,
+#if (RX_SESSION_QUEUES)
+							rxQueueReadCmd,
+							rxQueueDrained,
+#else
 							appRxDataRspMetadata,
-							rxApp2rxSar_upd_req,
-							rxBufferReadCmd);
+#endif
+#if (!RX_DDR_BYPASS)
+							rxBufferReadCmd,
+#endif
+							rxApp2rxSar_upd_req);
 		if (!rxApp2rxSar_upd_req.empty())
 		{
 			rxApp2rxSar_upd_req.read(req);
@@ -60,18 +80,33 @@ int main()
 				req.appd = 2435;
 				rxSar2rxApp_upd_rsp.write(req);
 			}
+			else
+			{
+				std::cout << "App pointer: " << req.appd << std::endl;
+			}
 		}
-
+#if (!RX_DDR_BYPASS)
 		if (!rxBufferReadCmd.empty())
 		{
 			rxBufferReadCmd.read(cmd);
-			std::cout << "Cmd: " << cmd.saddr << std::endl;
+			std::cout << "Cmd: " << cmd.addr << std::endl;
+		}
+#endif
+#if (RX_SESSION_QUEUES)
+		// The session queue hands the whole request back as drained
+		if (!rxQueueReadCmd.empty())
+		{
+			rxQueueReadCmd.read(queueCmd);
+			std::cout << "Queue read: " << queueCmd.sessionID << " " << queueCmd.length << std::endl;
+			rxQueueDrained.write(queueCmd);
 		}
+#else
 		if (!appRxDataRspMetadata.empty())
 		{
 			appRxDataRspMetadata.read(meta);
 			std::cout << "Meta: " << meta << std::endl;
 		}
+#endif
 
 		if (count == 20)
 		{
@@ -399,13 +399,18 @@ void rxEngGetMetaData(
  * @param      rtl_checksum      The resource checksum
  * @param      metaPacketInfoIn    The meta packet data
  * @param      drop_payload  The correct checksum
+ * @param      metaPacketInfoOut   Metadata of the packets with a correct checksum
  * @param      portTableOut      The port table out
+ * @param      dropReportOut     One report per packet with a wrong checksum
  */
 void rxEngVerifyCheckSum (
 		stream<ap_uint<16> >&			rtl_checksum,
 		stream<rxEngPktMetaInfo>&		metaPacketInfoIn,
-		stream<bool>&					drop_payload,
+		stream<dropReason>&				drop_payload,
 		stream<rxEngPktMetaInfo>&		metaPacketInfoOut,
+#if (DROP_REPORTS)
+		stream<dropReport>&				dropReportOut,
+#endif
 		stream<ap_uint<16> >&			portTableOut)
 {
 #pragma HLS INLINE off
@@ -414,6 +419,10 @@ void rxEngVerifyCheckSum (
 	enum vc_states {READ_META_INFO, READ_CHECKSUM};
 	static vc_states fsm_vc_state = READ_META_INFO;
 	static rxEngPktMetaInfo	meta_VCS;
+#if (DROP_REPORTS)
+	static ap_uint<16>		vcs_lostReports = 0;
+	dropReason			drop = DROP_NONE;
+#endif
 
 	ap_uint<16>			checksum_i;
 	bool 				checksum_correct;
@@ -433,13 +442,21 @@ void rxEngVerifyCheckSum (
 					metaPacketInfoOut.write(meta_VCS);
 					portTableOut.write(meta_VCS.tuple.dstPort);
 				}
+#if (DROP_REPORTS)
+				else {
+					drop = DROP_RX_BAD_CHECKSUM;
+				}
+#endif
 				if (meta_VCS.digest.length!=0)				
-					drop_payload.write(!checksum_correct); // the value is inverted because it indicates dropping
+					drop_payload.write(checksum_correct ? DROP_NONE : DROP_RX_BAD_CHECKSUM);
 				fsm_vc_state = READ_META_INFO;
 			}
 
 			break;
 	}
+#if (DROP_REPORTS)
+	reportDrop(dropReportOut, dropReport(drop), vcs_lostReports);
+#endif
 
 }
 	
@@ -454,6 +471,7 @@ void rxEngVerifyCheckSum (
  * @param[Out]   rxEng2eventEng_setEvent  Set event
  * @param[Out]   dropDataFifoOut          The drop data fifo out
  * @param[Out]   fsmMetaDataFifo          The fsm meta data fifo
+ * @param[Out]   dropReportOut            One report per segment to a closed port or without session
  */
 void rxEngMetadataHandler(	
 			stream<rxEngPktMetaInfo>&				metaDataFifoIn,
@@ -461,7 +479,10 @@ void rxEngMetadataHandler(
 			stream<sessionLookupReply>&				sLookup2rxEng_rsp,
 			stream<sessionLookupQuery>&				rxEng2sLookup_req,
 			stream<extendedEvent>&					rxEng2eventEng_setEvent,
-			stream<bool>&							dropDataFifoOut,
+			stream<dropReason>&						dropDataFifoOut,
+#if (DROP_REPORTS)
+			stream<dropReport>&						dropReportOut,
+#endif
 			stream<rxFsmMetaData>&					fsmMetaDataFifo)
 {
 #pragma HLS INLINE off
@@ -474,6 +495,10 @@ void rxEngMetadataHandler(
 	static mhStateType 			mh_state = META;
 	static ap_uint<32> 			mh_srcIpAddress;
 	static ap_uint<16> 			mh_dstIpPort;
+#if (DROP_REPORTS)
+	static ap_uint<16> 			mh_lostReports = 0;
+	dropReason 					drop = DROP_NONE;
+#endif
 
 	fourTuple 					switchedTuple;
 	bool 						portIsOpen;
@@ -503,8 +528,11 @@ void rxEngMetadataHandler(
 					} 
 					//else ignore => do nothing
 					if (mh_meta.digest.length != 0) {			// Drop payload because port is closed
-						dropDataFifoOut.write(true);
+						dropDataFifoOut.write(DROP_RX_PORT_CLOSED);
 					}
+#if (DROP_REPORTS)
+					drop = DROP_RX_PORT_CLOSED;
+#endif
 				}
 				else { // Port is open. Make session lookup, only allow creation of new entry when SYN or SYN_ACK
 					rxEng2sLookup_req.write(sessionLookupQuery(mh_meta.tuple, (mh_meta.digest.syn && !mh_meta.digest.rst && !mh_meta.digest.fin)));
@@ -520,8 +548,13 @@ void rxEngMetadataHandler(
 					fsmMetaDataFifo.write(rxFsmMetaData(mh_lup.sessionID, mh_srcIpAddress, mh_dstIpPort, mh_meta.digest));
 				}
 				if (mh_meta.digest.length != 0) {
-					dropDataFifoOut.write(!mh_lup.hit);
+					dropDataFifoOut.write(mh_lup.hit ? DROP_NONE : DROP_RX_LOOKUP_MISS);
+				}
+#if (DROP_REPORTS)
+				if (!mh_lup.hit) {
+					drop = DROP_RX_LOOKUP_MISS;
 				}
+#endif
 	//			if (!mh_lup.hit)
 	//			{
 	//				// Port is Open, but we have no sessionID, that matches or is free
@@ -553,6 +586,9 @@ void rxEngMetadataHandler(
 
 			break;
 	}//switch
+#if (DROP_REPORTS)
+	reportDrop(dropReportOut, dropReport(drop), mh_lostReports);
+#endif
 }
 
 /** @ingroup rx_engine
@@ -576,6 +612,8 @@ void rxEngMetadataHandler(
  * @param[out]	openConStatusOut
  * @param[out]	rxEng2eventEng_setEvent
  * @param[out]	dropDataFifoOut
+ * @param[out]	dropReportOut
+ * @param[out]	rxEng2latency_ack, ACK numbers in synchronized states and opens for the latency histogram
  * @param[out]	rxBufferWriteCmd
  * @param[out]	rxEng2rxApp_notification
  */
@@ -593,10 +631,16 @@ void rxEngTcpFSM(
 			stream<ap_uint<16> >&					rxEng2timer_setCloseTimer,
 			stream<openStatus>&						openConStatusOut,
 			stream<event>&							rxEng2eventEng_setEvent,
-			stream<bool>&							dropDataFifoOut,
+			stream<dropReason>&						dropDataFifoOut,
+#if (DROP_REPORTS)
+			stream<dropReport>&						dropReportOut,
+#endif
 #if (STATISTICS_MODULE)
 			stream<rxStatsUpdate>&  				rxEngStatsUpdate,
 #endif				
+#if (LATENCY_HISTOGRAM)
+			stream<latAck>&							rxEng2latency_ack,
+#endif
 #if (!RX_DDR_BYPASS)
 			stream<mmCmd>&							rxBufferWriteCmd,
 #endif
@@ -612,10 +656,13 @@ void rxEngTcpFSM(
 	static fsmStateType fsm_state = LOAD;
 	static rxFsmMetaData fsm_meta;
 	static bool fsm_txSarRequest = false;
+#if (DROP_REPORTS)
+	static ap_uint<16> fsm_lostReports = 0;
+#endif
 
 
 	static ap_uint<4> 		control_bits = 0;
-	sessionState 			tcpState;
+	sessionState 			tcpState = CLOSED;
 	rxSarEntry 				rxSar;
 	rxTxSarReply 			txSar;
 	ap_uint<32> 			pkgAddr = 0;
@@ -624,6 +671,7 @@ void rxEngTcpFSM(
 
 	ap_uint<4>				rx_win_shift;	// used to computed the scale option for RX buffer
 	ap_uint<4>				tx_win_shift;	// used to computed the scale option for TX buffer
+	dropReason				payloadDrop = DROP_NONE;
 
 	switch(fsm_state) {
 		case LOAD:
@@ -670,6 +718,11 @@ void rxEngTcpFSM(
 						//std::cout << "RX_engine state " << std::dec << tcpState << "\tacknum " << std::hex << fsm_meta.meta.ackNumb <<  "\tat " << std::dec << simCycleCounter << std::endl;
 						rxEng2timer_clearRetransmitTimer.write(rxRetransmitTimerUpdate(fsm_meta.sessionID, (fsm_meta.meta.ackNumb == txSar.nextByte))); 		// Reset Retransmit Timer
 						if (tcpState == ESTABLISHED || tcpState == SYN_RECEIVED || tcpState == FIN_WAIT_1 || tcpState == CLOSING || tcpState == LAST_ACK) {
+#if (LATENCY_HISTOGRAM)
+							if (!rxEng2latency_ack.full()) {
+								rxEng2latency_ack.write(latAck(fsm_meta.sessionID, fsm_meta.meta.ackNumb));
+							}
+#endif
 							// Check if new ACK arrived
 							if (fsm_meta.meta.ackNumb == txSar.prevAck && txSar.prevAck != txSar.nextByte) {
 								// Not new ACK increase counter only if it does not contain data
@@ -721,10 +774,11 @@ void rxEngTcpFSM(
 #endif
 									// Only notify about  new data available
 									rxEng2rxApp_notification.write(appNotification(fsm_meta.sessionID, fsm_meta.meta.length, fsm_meta.srcIpAddress, fsm_meta.dstIpPort));
-									dropDataFifoOut.write(false);
+									dropDataFifoOut.write(DROP_NONE);
 								}
 								else {
-									dropDataFifoOut.write(true);
+									payloadDrop = (fsm_meta.meta.seqNumb != rxSar.recvd) ? DROP_RX_OUT_OF_WINDOW : DROP_RX_NO_SPACE;
+									dropDataFifoOut.write(payloadDrop);
 								}
 							}
 #if FAST_RETRANSMIT							
@@ -765,9 +819,6 @@ void rxEngTcpFSM(
 								//rtTimer.write(rxRetransmitTimerUpdate(fsm_meta.sessionID));
 								rxEng2stateTable_upd_req.write(stateQuery(fsm_meta.sessionID, tcpState, 1)); // or ESTABLISHED
 							}
-#if (STATISTICS_MODULE)							
-							rxEngStatsUpdate.write(rxStatsUpdate(fsm_meta.sessionID,fsm_meta.meta.length));
-#endif							
 						} //end state if
 						// TODO if timewait just send ACK, can it be time wait??
 						else {// state == (CLOSED || SYN_SENT || CLOSE_WAIT || FIN_WAIT_2 || TIME_WAIT)
@@ -775,7 +826,8 @@ void rxEngTcpFSM(
 							rxEng2eventEng_setEvent.write(rstEvent(fsm_meta.sessionID, fsm_meta.meta.seqNumb+fsm_meta.meta.length)); // noACK ?
 							
 							if (fsm_meta.meta.length != 0) { // if data is in the pipe it needs to be dropped
-								dropDataFifoOut.write(true);
+								payloadDrop = DROP_RX_INVALID_STATE;
+								dropDataFifoOut.write(payloadDrop);
 							}
 							rxEng2stateTable_upd_req.write(stateQuery(fsm_meta.sessionID, tcpState, 1));
 						}
@@ -801,6 +853,15 @@ void rxEngTcpFSM(
 							rxEng2txSar_upd_req.write((rxTxSarQuery(fsm_meta.sessionID, 0, fsm_meta.meta.winSize, txSar.cong_window, 0, false))); //TODO maybe include count check SYN_ACK event
 #endif				
 							rxEng2eventEng_setEvent.write(event(SYN_ACK, fsm_meta.sessionID));
+#if (RT_POLICY_TABLE)
+							// Passive open, the retransmit timer picks the profile of the listen port
+							if (tcpState == CLOSED) {
+								rxEng2timer_clearRetransmitTimer.write(rxRetransmitTimerUpdate(fsm_meta.sessionID, fsm_meta.dstIpPort, true));
+							}
+#endif
+#if (LATENCY_HISTOGRAM)
+							rxEng2latency_ack.write(latAck(fsm_meta.sessionID, tcpState == CLOSED, fsm_meta.dstIpPort));
+#endif
 							// Change State to SYN_RECEIVED
 							rxEng2stateTable_upd_req.write(stateQuery(fsm_meta.sessionID, SYN_RECEIVED, 1));
 						}
@@ -825,9 +886,6 @@ void rxEngTcpFSM(
 							//rxEng2eventEng_setEvent.write(rstEvent(fsm_meta.sessionID, fsm_meta.meta.seqNumb+fsm_meta.meta.length+1)); // FIXME is that correct? MR
 							rxEng2stateTable_upd_req.write(stateQuery(fsm_meta.sessionID, tcpState, 1));
 						}
-#if (STATISTICS_MODULE)							
-							rxEngStatsUpdate.write(rxStatsUpdate(fsm_meta.sessionID,0,true,false,false));
-#endif		
 					}
 					break;
 				case 3: //SYN_ACK
@@ -852,6 +910,9 @@ void rxEngTcpFSM(
 								rxEng2txSar_upd_req.write((rxTxSarQuery(fsm_meta.sessionID, fsm_meta.meta.ackNumb, fsm_meta.meta.winSize, txSar.cong_window, 0, false))); //CHANGE this was added //TODO maybe include count check
 #endif
 								openConStatusOut.write(openStatus(fsm_meta.sessionID, true));
+#if (LATENCY_HISTOGRAM)
+								rxEng2latency_ack.write(latAck(fsm_meta.sessionID, false, 0));
+#endif
 							}
 							else{ //TODO is this the correct procedure?
 								// Sent RST, RFC 793: fig.9 (old) duplicate SYN(+ACK)
@@ -864,9 +925,6 @@ void rxEngTcpFSM(
 							rxEng2eventEng_setEvent.write(event(ACK_NODELAY, fsm_meta.sessionID));
 							rxEng2stateTable_upd_req.write(stateQuery(fsm_meta.sessionID, tcpState, 1));
 						}
-#if (STATISTICS_MODULE)							
-							rxEngStatsUpdate.write(rxStatsUpdate(fsm_meta.sessionID,0,false,true,false));
-#endif							
 					}
 					break;
 				case 5: //FIN (_ACK)
@@ -896,7 +954,7 @@ void rxEngTcpFSM(
 #endif
 								// Tell Application new data is available and connection got closed
 								rxEng2rxApp_notification.write(appNotification(fsm_meta.sessionID, fsm_meta.meta.length, fsm_meta.srcIpAddress, fsm_meta.dstIpPort, true));
-								dropDataFifoOut.write(false);
+								dropDataFifoOut.write(DROP_NONE);
 							}
 							else if (tcpState == ESTABLISHED) {
 								// Tell Application connection got closed
@@ -924,12 +982,15 @@ void rxEngTcpFSM(
 							rxEng2stateTable_upd_req.write(stateQuery(fsm_meta.sessionID, tcpState, 1));
 							// If there is payload we need to drop it
 							if (fsm_meta.meta.length != 0) {
-								dropDataFifoOut.write(true);
+								if (tcpState == ESTABLISHED || tcpState == FIN_WAIT_1 || tcpState == FIN_WAIT_2) {
+									payloadDrop = DROP_RX_OUT_OF_WINDOW;
+								}
+								else {
+									payloadDrop = DROP_RX_INVALID_STATE;
+								}
+								dropDataFifoOut.write(payloadDrop);
 							}
 						}
-#if (STATISTICS_MODULE)							
-							rxEngStatsUpdate.write(rxStatsUpdate(fsm_meta.sessionID,0,false,false,true));
-#endif								
 					}
 					break;
 				default: //TODO MAYBE load everything all the time
@@ -973,24 +1034,42 @@ void rxEngTcpFSM(
 					} 
 					break;
 			} //switch control_bits
+#if (STATISTICS_MODULE)
+			// One update for every segment
+			if (fsm_state == LOAD) {
+				rxEngStatsUpdate.write(rxStatsUpdate(fsm_meta.sessionID, fsm_meta.meta.length, fsm_meta.meta.syn && !fsm_meta.meta.ack,
+													fsm_meta.meta.syn && fsm_meta.meta.ack, fsm_meta.meta.fin, fsm_meta.meta.rst, payloadDrop != DROP_NONE));
+			}
+#endif
 		break;
 	} //switch state
+#if (DROP_REPORTS)
+	reportDrop(dropReportOut, dropReport(payloadDrop, fsm_meta.sessionID), fsm_lostReports);
+#endif
 }
 
 /** @ingroup rx_engine
  *	Drops packets if their metadata did not match / are invalid, as indicated by @param dropBuffer
+ *	With DROP_CAPTURE one in DROP_CAPTURE_RATE dropped payloads is copied to @param dropCaptureOut,
+ *	after a word whose bits [7:0] carry the reason and [63:32] the number of the drop. The capture
+ *	never stalls the RX path: a sample whose header does not fit is skipped, a sample that runs
+ *	out of room is cut and closed later by an empty word with last set, keep is 0
  *	@param[in]		dataIn, incoming data stream
  *	@param[in]		VerifyChecksumDrop, Drop-FIFO indicating if packet needs to be dropped
  *	@param[in]		MetaHandlerDrop, Drop-FIFO indicating if packet needs to be dropped
  *	@param[in]		TCP_FSMDrop, Drop-FIFO indicating if packet needs to be dropped
  *	@param[out]		rxBufferDataOut, outgoing data stream
+ *	@param[out]		dropCaptureOut, sampled dropped payloads
  */
 
 void rxEngPacketDropper(
 			stream<axiWord>&		dataIn,
-			stream<bool>&			VerifyChecksumDrop,
-			stream<bool>&			MetaHandlerDrop,
-			stream<bool>&			TCP_FSMDrop,
+			stream<dropReason>&		VerifyChecksumDrop,
+			stream<dropReason>&		MetaHandlerDrop,
+			stream<dropReason>&		TCP_FSMDrop,
+#if (DROP_REPORTS && DROP_CAPTURE)
+			stream<axiWord>&		dropCaptureOut,
+#endif
 			stream<axiWord>&		rxBufferDataOut) 
 {
 #pragma HLS INLINE off
@@ -998,27 +1077,34 @@ void rxEngPacketDropper(
 
 	enum tpfStateType {RD_VERIFY_CHECKSUM, RD_META_HANDLER, RD_FSM_DROP, FWD, DROP};
 	static tpfStateType tpf_state = RD_VERIFY_CHECKSUM;
+#if (DROP_REPORTS && DROP_CAPTURE)
+	static ap_uint<32>	tpf_dropCount = 0;
+	static bool			tpf_capture = false;
+	static bool			tpf_captureCut = false;
+	bool				captureWritten = false;
+	axiWord 			captureHeader(0, 0xFFFFFFFFFFFFFFFFULL, 0);
+#endif
 
-	bool drop;
+	dropReason drop = DROP_NONE;
 	axiWord currWord;
 
 	switch (tpf_state) {
 		case RD_VERIFY_CHECKSUM :
 			if (!VerifyChecksumDrop.empty()){
 				VerifyChecksumDrop.read(drop);
-				tpf_state = (drop) ? DROP : RD_META_HANDLER;
+				tpf_state = (drop != DROP_NONE) ? DROP : RD_META_HANDLER;
 			}
 			break;
 		case RD_META_HANDLER:
 			if (!MetaHandlerDrop.empty()) {
 				MetaHandlerDrop.read(drop);
-				tpf_state = (drop) ? DROP : RD_FSM_DROP;
+				tpf_state = (drop != DROP_NONE) ? DROP : RD_FSM_DROP;
 			}
 			break;
 		case RD_FSM_DROP:
 			if (!TCP_FSMDrop.empty()) {
 				TCP_FSMDrop.read(drop);
-				tpf_state = (drop) ? DROP : FWD;
+				tpf_state = (drop != DROP_NONE) ? DROP : FWD;
 			}
 			break;
 		case FWD:
@@ -1031,10 +1117,37 @@ void rxEngPacketDropper(
 		case DROP:
 			if(!dataIn.empty()) {
 				dataIn.read(currWord);
+#if (DROP_REPORTS && DROP_CAPTURE)
+				if (tpf_capture && !dropCaptureOut.full()) {
+					dropCaptureOut.write(currWord);
+					captureWritten = true;
+				}
+				else if (tpf_capture) {			// No room, the rest of the sample is skipped
+					tpf_capture = false;
+					tpf_captureCut = true;
+				}
+#endif
 				tpf_state = (currWord.last) ? RD_VERIFY_CHECKSUM : DROP;
 			}
 			break;
 	} // switch
+
+#if (DROP_REPORTS && DROP_CAPTURE)
+	if (drop != DROP_NONE) {
+		// A sample starts only if its header fits and no cut sample is left open
+		tpf_capture = ((tpf_dropCount % DROP_CAPTURE_RATE) == 0) && !tpf_captureCut && !dropCaptureOut.full();
+		if (tpf_capture) {
+			captureHeader.data(7, 0)   = drop;
+			captureHeader.data(63, 32) = tpf_dropCount;
+			dropCaptureOut.write(captureHeader);
+		}
+		tpf_dropCount++;
+	}
+	else if (tpf_captureCut && !captureWritten && !dropCaptureOut.full()) {
+		dropCaptureOut.write(axiWord(0, 0, 1));		// Closes the cut sample
+		tpf_captureCut = false;
+	}
+#endif
 }
 
 /** @ingroup rx_engine
@@ -1115,6 +1228,39 @@ void rxEngEventMerger(
 	}
 }
 
+#if (DROP_REPORTS)
+/** @ingroup rx_engine
+ *  Merges the drop reports of the checksum, the metadata handler and the TCP state machine.
+ *  Reports are never waited for, a stage whose report FIFO is full counts the report as lost
+ *  instead of stalling the RX path and sends it later as DROP_REPORT_LOST, see reportDrop
+ *  @param[in]		checksumDrop
+ *  @param[in]		metaHandlerDrop
+ *  @param[in]		fsmDrop
+ *  @param[out]		dropReportOut
+ */
+void rxEngDropReportMerger(
+					stream<dropReport>& checksumDrop, 
+					stream<dropReport>& metaHandlerDrop, 
+					stream<dropReport>& fsmDrop, 
+					stream<dropReport>& dropReportOut)
+{
+	#pragma HLS PIPELINE II=1
+	#pragma HLS INLINE off
+
+	if (!dropReportOut.full()) {
+		if (!checksumDrop.empty()) {
+			dropReportOut.write(checksumDrop.read());
+		}
+		else if (!metaHandlerDrop.empty()) {
+			dropReportOut.write(metaHandlerDrop.read());
+		}
+		else if (!fsmDrop.empty()) {
+			dropReportOut.write(fsmDrop.read());
+		}
+	}
+}
+#endif
+
 
 /** @ingroup rx_engine
  *  The @ref rx_engine is processing the data packets on the receiving path.
@@ -1142,6 +1288,9 @@ void rxEngEventMerger(
  *  @param[out]		openConStatusOut
  *  @param[out]		rxEng2eventEng_setEvent
  *  @param[out]		rxEng2rxApp_notification
+ *  @param[out]		rxEng2latency_ack				: ACK numbers and opens for the latency histogram
+ *  @param[out]		dropReportOut					: Reason of every dropped segment
+ *  @param[out]		dropCaptureOut					: Sampled dropped payloads
  *  @param[out]		rxEng_pseudo_packet_to_checksum
  *  @param[in]		rxEng_pseudo_packet_res_checksum
  */
@@ -1172,6 +1321,15 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 #if (STATISTICS_MODULE)
 				stream<rxStatsUpdate>&  			rxEngStatsUpdate,
 #endif			
+#if (LATENCY_HISTOGRAM)
+				stream<latAck>&						rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+				stream<dropReport>&					dropReportOut,
+#if (DROP_CAPTURE)
+				stream<axiWord>&					dropCaptureOut,
+#endif
+#endif
 				stream<axiWord>&					rxEng_pseudo_packet_to_checksum,
 				stream<ap_uint<16> >&				rxEng_pseudo_packet_res_checksum)
 {
@@ -1196,7 +1354,7 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 #endif
 
 	// Meta Streams/FIFOs
-	static stream<bool>			rxEng_VerifyChecksumDrop("rxEng_VerifyChecksumDrop");
+	static stream<dropReason>	rxEng_VerifyChecksumDrop("rxEng_VerifyChecksumDrop");
 	#pragma HLS STREAM variable=rxEng_VerifyChecksumDrop depth=32
 
 	static stream<rxEngPktMetaInfo>		rxEngMetaInfoFifo("rxEngMetaInfoFifo");
@@ -1219,12 +1377,26 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 	#pragma HLS STREAM variable=rxEng_fsmEventFifo depth=8
 	#pragma HLS DATA_PACK variable=rxEng_fsmEventFifo
 
-	static stream<bool>					rxEng_metaHandlerDropFifo("rxEng_metaHandlerDropFifo");
+	static stream<dropReason>			rxEng_metaHandlerDropFifo("rxEng_metaHandlerDropFifo");
 	#pragma HLS STREAM variable=rxEng_metaHandlerDropFifo depth=32
 
-	static stream<bool>					rxEng_fsmDropFifo("rxEng_fsmDropFifo");
+	static stream<dropReason>			rxEng_fsmDropFifo("rxEng_fsmDropFifo");
 	#pragma HLS STREAM variable=rxEng_fsmDropFifo depth=32
 
+#if (DROP_REPORTS)
+	static stream<dropReport>			rxEng_checksumDropReport("rxEng_checksumDropReport");
+	#pragma HLS STREAM variable=rxEng_checksumDropReport depth=4
+	#pragma HLS DATA_PACK variable=rxEng_checksumDropReport
+
+	static stream<dropReport>			rxEng_metaHandlerDropReport("rxEng_metaHandlerDropReport");
+	#pragma HLS STREAM variable=rxEng_metaHandlerDropReport depth=4
+	#pragma HLS DATA_PACK variable=rxEng_metaHandlerDropReport
+
+	static stream<dropReport>			rxEng_fsmDropReport("rxEng_fsmDropReport");
+	#pragma HLS STREAM variable=rxEng_fsmDropReport depth=4
+	#pragma HLS DATA_PACK variable=rxEng_fsmDropReport
+#endif
+
 	static stream<appNotification> rx_internalNotificationFifo("rx_internalNotificationFifo");
 	#pragma HLS STREAM variable=rx_internalNotificationFifo depth=8 //This depends on the memory delay
 	#pragma HLS DATA_PACK variable=rx_internalNotificationFifo
@@ -1267,6 +1439,9 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 			rxEngMetaInfoFifo,
 			rxEng_VerifyChecksumDrop,
 			rxEngMetaInfoValid,
+#if (DROP_REPORTS)
+			rxEng_checksumDropReport,
+#endif
 			rxEng2portTable_req);
 
 	rxEngMetadataHandler(	
@@ -1276,6 +1451,9 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 			rxEng2sLookup_req,
 			rxEng_metaHandlerEventFifo,
 			rxEng_metaHandlerDropFifo,
+#if (DROP_REPORTS)
+			rxEng_metaHandlerDropReport,
+#endif
 			rxEng_fsmMetaDataFifo);
 
 	rxEngTcpFSM(			
@@ -1292,9 +1470,15 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 			openConStatusOut,
 			rxEng_fsmEventFifo,
 			rxEng_fsmDropFifo,
+#if (DROP_REPORTS)
+			rxEng_fsmDropReport,
+#endif
 #if (STATISTICS_MODULE)
 			rxEngStatsUpdate,
 #endif			
+#if (LATENCY_HISTOGRAM)
+			rxEng2latency_ack,
+#endif
 #if (!RX_DDR_BYPASS)
 			rxTcpFsm2wrAccessBreakdown,
 			rx_internalNotificationFifo,
@@ -1309,6 +1493,9 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 			rxEng_VerifyChecksumDrop,
 			rxEng_metaHandlerDropFifo,
 			rxEng_fsmDropFifo,
+#if (DROP_REPORTS && DROP_CAPTURE)
+			dropCaptureOut,
+#endif
 #if (!RX_DDR_BYPASS)			
 			rxPkgDrop2rxMemWriter);
 #else	
@@ -1335,6 +1522,38 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 			rxEng_metaHandlerEventFifo,
 			rxEng_fsmEventFifo,
 			rxEng2eventEng_setEvent);
+
+#if (DROP_REPORTS)
+	rxEngDropReportMerger(
+			rxEng_checksumDropReport,
+			rxEng_metaHandlerDropReport,
+			rxEng_fsmDropReport,
+			dropReportOut);
+#endif
+
+#if (INSTRUMENTATION)
+	INSTR_FIFO(rxEng_pseudo_packet_to_metadata,	16,		"rxEngPseudoHeaderInsert",	"rxEngGetMetaData");
+	INSTR_FIFO(rxEng_tcp_payload,				512,	"rxEngGetMetaData",			"rxEngPacketDropper");
+#if (WINDOW_SCALE)
+	INSTR_FIFO(rxEngMetaInfoBeforeWindow,		8,		"rxEngGetMetaData",			"rxParseTcpOptions");
+	INSTR_FIFO(rxEngMetaInfoFifo,				8,		"rxParseTcpOptions",		"rxEngVerifyCheckSum");
+#else
+	INSTR_FIFO(rxEngMetaInfoFifo,				8,		"rxEngGetMetaData",			"rxEngVerifyCheckSum");
+#endif
+	INSTR_FIFO(rxEng_VerifyChecksumDrop,		32,		"rxEngVerifyCheckSum",		"rxEngPacketDropper");
+	INSTR_FIFO(rxEngMetaInfoValid,				32,		"rxEngVerifyCheckSum",		"rxEngMetadataHandler");
+	INSTR_FIFO(rxEng_metaHandlerDropFifo,		32,		"rxEngMetadataHandler",		"rxEngPacketDropper");
+	INSTR_FIFO(rxEng_metaHandlerEventFifo,		8,		"rxEngMetadataHandler",		"rxEngEventMerger");
+	INSTR_FIFO(rxEng_fsmMetaDataFifo,			8,		"rxEngMetadataHandler",		"rxEngTcpFSM");
+	INSTR_FIFO(rxEng_fsmDropFifo,				32,		"rxEngTcpFSM",				"rxEngPacketDropper");
+	INSTR_FIFO(rxEng_fsmEventFifo,				8,		"rxEngTcpFSM",				"rxEngEventMerger");
+#if (!RX_DDR_BYPASS)
+	INSTR_FIFO(rxPkgDrop2rxMemWriter,			512,	"rxEngPacketDropper",		"Rx_Data_to_Memory");
+	INSTR_FIFO(rxTcpFsm2wrAccessBreakdown,		8,		"rxEngTcpFSM",				"Rx_Data_to_Memory");
+	INSTR_FIFO(rx_internalNotificationFifo,		8,		"rxEngTcpFSM",				"rxEngAppNotificationDelayer");
+	INSTR_FIFO(rxEngDoubleAccess,				8,		"Rx_Data_to_Memory",		"rxEngAppNotificationDelayer");
+#endif
+#endif
 }
 
 
@@ -32,6 +32,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 
 #include "../toe.hpp"
 #include "../memory_access/memory_access.hpp"
+#include "../instrumentation/instrumentation.hpp"
 
 using namespace hls;
 
@@ -112,6 +113,15 @@ void rx_engine(	stream<axiWord>&					ipRxData,
 #if (STATISTICS_MODULE)
 				stream<rxStatsUpdate>&  			rxEngStatsUpdate,
 #endif						
+#if (LATENCY_HISTOGRAM)
+				stream<latAck>&						rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+				stream<dropReport>&					dropReportOut,
+#if (DROP_CAPTURE)
+				stream<axiWord>&					dropCaptureOut,
+#endif
+#endif
 				stream<axiWord>&					rxEng_pseudo_packet_to_checksum,
 				stream<ap_uint<16> >&				rxEng_pseudo_packet_res_checksum);
 
@@ -88,8 +88,8 @@ void simRxSar(stream<rxSarRecvd>& req, stream<rxSarEntry>& rsp)
 
 }
 
-static txSarEntry currTxEntry;
-void simTxSar(stream<rxTxSarQuery>& req, stream<ap_uint<32> >& rsp)
+static rxTxSarReply currTxEntry;
+void simTxSar(stream<rxTxSarQuery>& req, stream<rxTxSarReply>& rsp)
 {
 	rxTxSarQuery query;
 	if (!req.empty())
@@ -97,17 +97,29 @@ void simTxSar(stream<rxTxSarQuery>& req, stream<ap_uint<32> >& rsp)
 		req.read(query);
 		if (query.write)
 		{
-			currTxEntry.ackd = query.ackd;
-			currTxEntry.recv_window = query.recv_window;
+			currTxEntry.prevAck = query.ackd;
+			currTxEntry.cong_window = query.cong_window;
 		}
 		else
 		{
-			rsp.write(currTxEntry.not_ackd);
+			rsp.write(currTxEntry);
 		}
 	}
 
 }
 
+/* Every segment passes the checksum, the TOE offloads the sum to the top level */
+void simChecksum(stream<axiWord>& pseudoPacket, stream<ap_uint<16> >& result)
+{
+	if (!pseudoPacket.empty())
+	{
+		if (pseudoPacket.read().last)
+		{
+			result.write(0);
+		}
+	}
+}
+
 int main(int argc, char* argv[])
 {
 
@@ -116,7 +128,7 @@ int main(int argc, char* argv[])
 	stream<sessionState>				stateTable2rxEng_upd_rsp("stateTable2rxEng_upd_rsp");
 	stream<bool>						portTable2rxEng_rsp("portTable2rxEng_rsp");
 	stream<rxSarEntry>					rxSar2rxEng_upd_rsp;
-	stream<ap_uint<32> >				txSar2rxEng_upd_rsp;
+	stream<rxTxSarReply>				txSar2rxEng_upd_rsp;
 	stream<mmStatus>					rxBufferWriteStatus;
 	stream<axiWord>						rxBufferWriteData;
 	stream<sessionLookupQuery>			rxEng2sLookup_req;
@@ -125,11 +137,27 @@ int main(int argc, char* argv[])
 	stream<rxSarRecvd>					rxEng2rxSar_upd_req;
 	stream<rxTxSarQuery>				rxEng2txSar_upd_req;
 	stream<rxRetransmitTimerUpdate>		rxEng2timer_clearRetransmitTimer;
+	stream<ap_uint<16> >				rxEng2timer_clearProbeTimer;
 	stream<ap_uint<16> >				rxEng2timer_setCloseTimer;
 	stream<openStatus>					openConStatusOut; //TODO remove
 	stream<extendedEvent>				rxEng2eventEng_setEvent("rxEng2eventEng_setEvent");
 	stream<mmCmd>						rxBufferWriteCmd;
 	stream<appNotification>				rxEng2rxApp_notification;
+	stream<txApp_client_status>			rxEng2txApp_client_notification;
+#if (STATISTICS_MODULE)
+	stream<rxStatsUpdate>				rxEngStatsUpdate;
+#endif
+#if (LATENCY_HISTOGRAM)
+	stream<latAck>						rxEng2latency_ack;
+#endif
+#if (DROP_REPORTS)
+	stream<dropReport>					dropReportOut;
+#if (DROP_CAPTURE)
+	stream<axiWord>						dropCaptureOut;
+#endif
+#endif
+	stream<axiWord>						rxEng_pseudo_packet_to_checksum;
+	stream<ap_uint<16> >				rxEng_pseudo_packet_res_checksum;
 
 	std::ifstream inputFile;
 	std::ofstream outputFile;
@@ -174,7 +202,10 @@ int main(int argc, char* argv[])
 					portTable2rxEng_rsp,
 					rxSar2rxEng_upd_rsp,
 					txSar2rxEng_upd_rsp,
+#if (!RX_DDR_BYPASS)
 					rxBufferWriteStatus,
+					rxBufferWriteCmd,
+#endif
 					rxBufferWriteData,
 					rxEng2sLookup_req,
 					rxEng2stateTable_upd_req,
@@ -182,16 +213,32 @@ int main(int argc, char* argv[])
 					rxEng2rxSar_upd_req,
 					rxEng2txSar_upd_req,
 					rxEng2timer_clearRetransmitTimer,
+					rxEng2timer_clearProbeTimer,
 					rxEng2timer_setCloseTimer,
 					openConStatusOut, //TODO remove
 					rxEng2eventEng_setEvent,
-					rxBufferWriteCmd,
-					rxEng2rxApp_notification);
+					rxEng2rxApp_notification,
+					rxEng2txApp_client_notification,
+#if (STATISTICS_MODULE)
+					rxEngStatsUpdate,
+#endif
+#if (LATENCY_HISTOGRAM)
+					rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+					dropReportOut,
+#if (DROP_CAPTURE)
+					dropCaptureOut,
+#endif
+#endif
+					rxEng_pseudo_packet_to_checksum,
+					rxEng_pseudo_packet_res_checksum);
 		simPortTable(rxEng2portTable_req, portTable2rxEng_rsp);
 		simSlookup(rxEng2sLookup_req, sLookup2rxEng_rsp);
 		simStateTable(rxEng2stateTable_upd_req, stateTable2rxEng_upd_rsp);
 		simRxSar(rxEng2rxSar_upd_req, rxSar2rxEng_upd_rsp);
 		simTxSar(rxEng2txSar_upd_req, txSar2rxEng_upd_rsp);
+		simChecksum(rxEng_pseudo_packet_to_checksum, rxEng_pseudo_packet_res_checksum);
 	}
 
 
@@ -204,7 +251,10 @@ int main(int argc, char* argv[])
 					portTable2rxEng_rsp,
 					rxSar2rxEng_upd_rsp,
 					txSar2rxEng_upd_rsp,
+#if (!RX_DDR_BYPASS)
 					rxBufferWriteStatus,
+					rxBufferWriteCmd,
+#endif
 					rxBufferWriteData,
 					rxEng2sLookup_req,
 					rxEng2stateTable_upd_req,
@@ -212,16 +262,32 @@ int main(int argc, char* argv[])
 					rxEng2rxSar_upd_req,
 					rxEng2txSar_upd_req,
 					rxEng2timer_clearRetransmitTimer,
+					rxEng2timer_clearProbeTimer,
 					rxEng2timer_setCloseTimer,
 					openConStatusOut, //TODO remove
 					rxEng2eventEng_setEvent,
-					rxBufferWriteCmd,
-					rxEng2rxApp_notification);
+					rxEng2rxApp_notification,
+					rxEng2txApp_client_notification,
+#if (STATISTICS_MODULE)
+					rxEngStatsUpdate,
+#endif
+#if (LATENCY_HISTOGRAM)
+					rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+					dropReportOut,
+#if (DROP_CAPTURE)
+					dropCaptureOut,
+#endif
+#endif
+					rxEng_pseudo_packet_to_checksum,
+					rxEng_pseudo_packet_res_checksum);
 		simPortTable(rxEng2portTable_req, portTable2rxEng_rsp);
 		simSlookup(rxEng2sLookup_req, sLookup2rxEng_rsp);
 		simStateTable(rxEng2stateTable_upd_req, stateTable2rxEng_upd_rsp);
 		simRxSar(rxEng2rxSar_upd_req, rxSar2rxEng_upd_rsp);
 		simTxSar(rxEng2txSar_upd_req, txSar2rxEng_upd_rsp);
+		simChecksum(rxEng_pseudo_packet_to_checksum, rxEng_pseudo_packet_res_checksum);
 		count++;
 	}
 
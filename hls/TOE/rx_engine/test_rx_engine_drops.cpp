@@ -0,0 +1,422 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "rx_engine.hpp"
+#include "../common_utilities/common_utilities.hpp"
+#include <iostream>
+#include <vector>
+#include <map>
+
+using namespace hls;
+
+/*
+ * Sends segments to the RX engine that have to be dropped for each of its reasons, plus
+ * segments that are accepted. The test plays the port table, session lookup, state table,
+ * SAR tables and checksum. The drop reports, the payload that reaches the buffer and the
+ * sampled capture of the dropped payloads are compared against what each segment expects.
+ */
+
+static const ap_uint<32> TOE_IP_ADDRESS 	= 0x0500A8C0;		// 192.168.0.5 in network order
+static const ap_uint<32> PEER_IP_ADDRESS 	= 0x0A00A8C0;		// 192.168.0.10
+static const uint16_t OPEN_PORT 	= 5001;
+static const uint16_t CLOSED_PORT 	= 6000;
+
+struct sessionModel {
+	uint16_t		id;
+	sessionState	state;
+	uint32_t		recvd;
+	uint32_t		appd;
+};
+
+// Peers are keyed by the source port of the segments
+static std::map<uint16_t, sessionModel> sessions;
+static std::vector<bool> checksumResults;
+
+void simPortTable(stream<ap_uint<16> >& req, stream<bool>& rsp)
+{
+	if (!req.empty()) {
+		rsp.write(byteSwap16(req.read()) == OPEN_PORT);
+	}
+}
+
+void simSlookup(stream<sessionLookupQuery>& req, stream<sessionLookupReply>& rsp)
+{
+	if (!req.empty()) {
+		sessionLookupQuery query = req.read();
+		uint16_t port = byteSwap16(query.tuple.srcPort);
+		if (sessions.count(port))
+			rsp.write(sessionLookupReply(sessions[port].id, true));
+		else
+			rsp.write(sessionLookupReply(0, false));
+	}
+}
+
+sessionModel& sessionById(ap_uint<16> id)
+{
+	std::map<uint16_t, sessionModel>::iterator it;
+	for (it = sessions.begin(); it != sessions.end(); it++) {
+		if (it->second.id == id)
+			break;
+	}
+	return it->second;
+}
+
+void simStateTable(stream<stateQuery>& req, stream<sessionState>& rsp)
+{
+	if (!req.empty()) {
+		stateQuery query = req.read();
+		if (query.write)
+			sessionById(query.sessionID).state = query.state;
+		else
+			rsp.write(sessionById(query.sessionID).state);
+	}
+}
+
+void simRxSar(stream<rxSarRecvd>& req, stream<rxSarEntry>& rsp)
+{
+	if (!req.empty()) {
+		rxSarRecvd query = req.read();
+		sessionModel& session = sessionById(query.sessionID);
+		if (query.write) {
+			session.recvd = query.recvd;
+		}
+		else {
+			rxSarEntry entry;
+			entry.recvd = session.recvd;
+			entry.appd 	= session.appd;
+#if (WINDOW_SCALE)
+			entry.rx_win_shift = 0;
+#endif
+			rsp.write(entry);
+		}
+	}
+}
+
+void simTxSar(stream<rxTxSarQuery>& req, stream<rxTxSarReply>& rsp)
+{
+	if (!req.empty()) {
+		rxTxSarQuery query = req.read();
+		if (!query.write) {			// Nothing was sent, every ACK is a new one
+#if (WINDOW_SCALE)
+			rsp.write(rxTxSarReply(100, 100, 10000, 0xFFFF, 0, false, 0));
+#else
+			rsp.write(rxTxSarReply(100, 100, 10000, 0xFFFF, 0, false));
+#endif
+		}
+	}
+}
+
+void simChecksum(stream<axiWord>& pseudoPacket, stream<ap_uint<16> >& result)
+{
+	static unsigned int packet = 0;
+	if (!pseudoPacket.empty()) {
+		if (pseudoPacket.read().last) {
+			result.write(checksumResults[packet++] ? 0 : 0xBEEF);
+		}
+	}
+}
+
+struct testSegment {
+	const char*	name;
+	uint16_t	srcPort;
+	uint16_t	dstPort;
+	uint32_t	seqNumb;
+	bool		fin;
+	uint16_t	length;
+	bool		checksumOk;
+	dropReason	expected;
+	uint16_t	expectedSession;
+};
+
+/*
+ * IPv4 packet with an ACK (FIN) segment, its payload bytes are a function of the
+ * segment number so the captured and forwarded payloads can be told apart
+ */
+void writeSegment(stream<axiWord>& ipRxData, const testSegment& seg, int number, std::vector<uint8_t>& payload)
+{
+	std::vector<uint8_t> bytes(40 + seg.length, 0);
+	uint16_t totalLength = 40 + seg.length;
+
+	bytes[0] 	= 0x45;
+	bytes[2] 	= totalLength >> 8;
+	bytes[3] 	= totalLength & 0xFF;
+	bytes[8] 	= 64;
+	bytes[9] 	= 6;
+	for (int i = 0; i < 4; i++) {
+		bytes[12 + i] = PEER_IP_ADDRESS(i*8+7, i*8);
+		bytes[16 + i] = TOE_IP_ADDRESS(i*8+7, i*8);
+	}
+	bytes[20] 	= seg.srcPort >> 8;
+	bytes[21] 	= seg.srcPort & 0xFF;
+	bytes[22] 	= seg.dstPort >> 8;
+	bytes[23] 	= seg.dstPort & 0xFF;
+	for (int i = 0; i < 4; i++) {
+		bytes[24 + i] = (seg.seqNumb >> (24 - i*8)) & 0xFF;
+		bytes[28 + i] = (100 >> (24 - i*8)) & 0xFF;				// ACK number
+	}
+	bytes[32] 	= 0x50;
+	bytes[33] 	= 0x10 | (seg.fin ? 0x01 : 0x00);
+	bytes[34] 	= 0xFF;
+	bytes[35] 	= 0xFF;
+	payload.clear();
+	for (int i = 0; i < seg.length; i++) {
+		bytes[40 + i] = (number * 16 + i) & 0xFF;
+		payload.push_back(bytes[40 + i]);
+	}
+
+	for (unsigned int w = 0; w < bytes.size(); w += 64) {
+		axiWord word(0, 0, 0);
+		for (unsigned int i = 0; i < 64 && (w + i) < bytes.size(); i++) {
+			word.data(i*8+7, i*8) 	= bytes[w + i];
+			word.keep.bit(i) 		= 1;
+		}
+		word.last = (w + 64) >= bytes.size();
+		ipRxData.write(word);
+	}
+}
+
+void appendPayload(std::vector<uint8_t>& out, axiWord word)
+{
+	for (int i = 0; i < 64; i++) {
+		if (word.keep.bit(i))
+			out.push_back(word.data(i*8+7, i*8));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	stream<axiWord>						ipRxData("ipRxData");
+	stream<sessionLookupReply>			sLookup2rxEng_rsp("sLookup2rxEng_rsp");
+	stream<sessionState>				stateTable2rxEng_upd_rsp("stateTable2rxEng_upd_rsp");
+	stream<bool>						portTable2rxEng_rsp("portTable2rxEng_rsp");
+	stream<rxSarEntry>					rxSar2rxEng_upd_rsp("rxSar2rxEng_upd_rsp");
+	stream<rxTxSarReply>				txSar2rxEng_upd_rsp("txSar2rxEng_upd_rsp");
+#if (!RX_DDR_BYPASS)
+	stream<mmStatus>					rxBufferWriteStatus("rxBufferWriteStatus");
+	stream<mmCmd>						rxBufferWriteCmd("rxBufferWriteCmd");
+#endif
+	stream<axiWord>						rxBufferWriteData("rxBufferWriteData");
+	stream<sessionLookupQuery>			rxEng2sLookup_req("rxEng2sLookup_req");
+	stream<stateQuery>					rxEng2stateTable_upd_req("rxEng2stateTable_upd_req");
+	stream<ap_uint<16> >				rxEng2portTable_req("rxEng2portTable_req");
+	stream<rxSarRecvd>					rxEng2rxSar_upd_req("rxEng2rxSar_upd_req");
+	stream<rxTxSarQuery>				rxEng2txSar_upd_req("rxEng2txSar_upd_req");
+	stream<rxRetransmitTimerUpdate>		rxEng2timer_clearRetransmitTimer("rxEng2timer_clearRetransmitTimer");
+	stream<ap_uint<16> >				rxEng2timer_clearProbeTimer("rxEng2timer_clearProbeTimer");
+	stream<ap_uint<16> >				rxEng2timer_setCloseTimer("rxEng2timer_setCloseTimer");
+	stream<openStatus>					openConStatusOut("openConStatusOut");
+	stream<extendedEvent>				rxEng2eventEng_setEvent("rxEng2eventEng_setEvent");
+	stream<appNotification>				rxEng2rxApp_notification("rxEng2rxApp_notification");
+	stream<txApp_client_status>			rxEng2txApp_client_notification("rxEng2txApp_client_notification");
+#if (STATISTICS_MODULE)
+	stream<rxStatsUpdate>				rxEngStatsUpdate("rxEngStatsUpdate");
+#endif
+#if (LATENCY_HISTOGRAM)
+	stream<latAck>						rxEng2latency_ack("rxEng2latency_ack");
+#endif
+	stream<dropReport>					dropReportOut("dropReportOut");
+	stream<axiWord>						dropCaptureOut("dropCaptureOut");
+	stream<axiWord>						rxEng_pseudo_packet_to_checksum("rxEng_pseudo_packet_to_checksum");
+	stream<ap_uint<16> >				rxEng_pseudo_packet_res_checksum("rxEng_pseudo_packet_res_checksum");
+
+#if !(DROP_REPORTS)
+	std::cout << "DROP_REPORTS is disabled, nothing to test" << std::endl;
+	return 0;
+#endif
+
+	sessions[40000] = (sessionModel) {3, ESTABLISHED, 1000, 0};
+	sessions[40001] = (sessionModel) {4, ESTABLISHED, 1000, 1001};		// Buffer is full, appd is one byte ahead
+	sessions[40002] = (sessionModel) {5, CLOSED, 1000, 0};
+
+	std::vector<testSegment> segments;
+	segments.push_back((testSegment) {"bad checksum",     40000, OPEN_PORT,   1000, false, 16, false, DROP_RX_BAD_CHECKSUM,  0});
+	segments.push_back((testSegment) {"bad checksum, no payload", 40000, OPEN_PORT, 1000, false, 0, false, DROP_RX_BAD_CHECKSUM, 0});
+	segments.push_back((testSegment) {"closed port",      40000, CLOSED_PORT, 1000, false, 16, true,  DROP_RX_PORT_CLOSED,   0});
+	segments.push_back((testSegment) {"lookup miss",      40003, OPEN_PORT,   1000, false, 16, true,  DROP_RX_LOOKUP_MISS,   0});
+	segments.push_back((testSegment) {"out of window",    40000, OPEN_PORT,   2000, false, 16, true,  DROP_RX_OUT_OF_WINDOW, 3});
+	segments.push_back((testSegment) {"no space",         40001, OPEN_PORT,   1000, false, 16, true,  DROP_RX_NO_SPACE,      4});
+	segments.push_back((testSegment) {"invalid state",    40002, OPEN_PORT,   1000, false, 16, true,  DROP_RX_INVALID_STATE, 5});
+	segments.push_back((testSegment) {"in order",         40000, OPEN_PORT,   1000, false, 16, true,  DROP_NONE,             3});
+	segments.push_back((testSegment) {"in order, 2 words",40000, OPEN_PORT,   1016, false, 80, true,  DROP_NONE,             3});
+	segments.push_back((testSegment) {"FIN out of order", 40000, OPEN_PORT,   5000, true,  16, true,  DROP_RX_OUT_OF_WINDOW, 3});
+	for (int i = 0; i < DROP_CAPTURE_RATE; i++) {		// The next capture is the first of these
+		segments.push_back((testSegment) {"old duplicate", 40000, OPEN_PORT, 900, false, (uint16_t) (24 + i), true, DROP_RX_OUT_OF_WINDOW, 3});
+	}
+
+	std::vector<uint8_t> 	expectedData;
+	std::vector<uint8_t> 	receivedData;
+	std::vector<std::vector<uint8_t> > droppedPayloads;
+	int 					payloadDrops = 0;
+	int 					errors = 0;
+
+	for (unsigned int s = 0; s < segments.size(); s++) {
+		const testSegment& seg = segments[s];
+		std::vector<uint8_t> payload;
+
+		checksumResults.push_back(seg.checksumOk);
+		writeSegment(ipRxData, seg, s, payload);
+		if (seg.expected == DROP_NONE)
+			expectedData.insert(expectedData.end(), payload.begin(), payload.end());
+		else if (seg.length != 0)
+			droppedPayloads.push_back(payload);
+
+		for (int cycle = 0; cycle < 200; cycle++) {
+			rx_engine(	ipRxData,
+						sLookup2rxEng_rsp,
+						stateTable2rxEng_upd_rsp,
+						portTable2rxEng_rsp,
+						rxSar2rxEng_upd_rsp,
+						txSar2rxEng_upd_rsp,
+#if (!RX_DDR_BYPASS)
+						rxBufferWriteStatus,
+						rxBufferWriteCmd,
+#endif
+						rxBufferWriteData,
+						rxEng2sLookup_req,
+						rxEng2stateTable_upd_req,
+						rxEng2portTable_req,
+						rxEng2rxSar_upd_req,
+						rxEng2txSar_upd_req,
+						rxEng2timer_clearRetransmitTimer,
+						rxEng2timer_clearProbeTimer,
+						rxEng2timer_setCloseTimer,
+						openConStatusOut,
+						rxEng2eventEng_setEvent,
+						rxEng2rxApp_notification,
+						rxEng2txApp_client_notification,
+#if (STATISTICS_MODULE)
+						rxEngStatsUpdate,
+#endif
+#if (LATENCY_HISTOGRAM)
+						rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+						dropReportOut,
+#if (DROP_CAPTURE)
+						dropCaptureOut,
+#endif
+#endif
+						rxEng_pseudo_packet_to_checksum,
+						rxEng_pseudo_packet_res_checksum);
+			simPortTable(rxEng2portTable_req, portTable2rxEng_rsp);
+			simSlookup(rxEng2sLookup_req, sLookup2rxEng_rsp);
+			simStateTable(rxEng2stateTable_upd_req, stateTable2rxEng_upd_rsp);
+			simRxSar(rxEng2rxSar_upd_req, rxSar2rxEng_upd_rsp);
+			simTxSar(rxEng2txSar_upd_req, txSar2rxEng_upd_rsp);
+			simChecksum(rxEng_pseudo_packet_to_checksum, rxEng_pseudo_packet_res_checksum);
+#if (!RX_DDR_BYPASS)
+			while (!rxBufferWriteCmd.empty()) {
+				rxBufferWriteCmd.read();
+				rxBufferWriteStatus.write(mmStatus(1));
+			}
+#endif
+			while (!rxBufferWriteData.empty())
+				appendPayload(receivedData, rxBufferWriteData.read());
+		}
+
+		if (seg.expected == DROP_NONE) {
+			if (!dropReportOut.empty()) {
+				dropReport report = dropReportOut.read();
+				std::cout << "ERROR " << seg.name << ": reported as dropped with reason " << std::dec << report.reason << std::endl;
+				errors++;
+			}
+		}
+		else if (dropReportOut.empty()) {
+			std::cout << "ERROR " << seg.name << ": no drop report" << std::endl;
+			errors++;
+		}
+		else {
+			dropReport report = dropReportOut.read();
+			bool sessionExpected = (seg.expected >= DROP_RX_OUT_OF_WINDOW);
+			if (report.reason != seg.expected || report.sessionValid != sessionExpected ||
+					(sessionExpected && report.sessionID != seg.expectedSession)) {
+				std::cout << "ERROR " << seg.name << ": reason " << std::dec << report.reason << " session " << report.sessionID
+						<< " (" << report.sessionValid << "), expected reason " << seg.expected << " session " << seg.expectedSession << std::endl;
+				errors++;
+			}
+			if (!dropReportOut.empty()) {
+				std::cout << "ERROR " << seg.name << ": more than one drop report" << std::endl;
+				errors++;
+			}
+		}
+		// Events, notifications and timers are not checked here
+		while (!rxEng2eventEng_setEvent.empty()) rxEng2eventEng_setEvent.read();
+		while (!rxEng2rxApp_notification.empty()) rxEng2rxApp_notification.read();
+		while (!rxEng2timer_clearRetransmitTimer.empty()) rxEng2timer_clearRetransmitTimer.read();
+		while (!rxEng2timer_clearProbeTimer.empty()) rxEng2timer_clearProbeTimer.read();
+		while (!rxEng2timer_setCloseTimer.empty()) rxEng2timer_setCloseTimer.read();
+#if (STATISTICS_MODULE)
+		while (!rxEngStatsUpdate.empty()) rxEngStatsUpdate.read();
+#endif
+		payloadDrops += (seg.expected != DROP_NONE && seg.length != 0);
+	}
+
+	if (receivedData != expectedData) {
+		std::cout << "ERROR " << receivedData.size() << " bytes reached the buffer, expected " << expectedData.size() << std::endl;
+		errors++;
+	}
+
+#if (DROP_CAPTURE)
+	// Dropped payloads number 0, DROP_CAPTURE_RATE, 2*DROP_CAPTURE_RATE... are captured
+	int captures = 0;
+	while (!dropCaptureOut.empty()) {
+		axiWord header = dropCaptureOut.read();
+		int number = header.data(63, 32);
+		std::vector<uint8_t> captured;
+		axiWord word;
+		do {
+			word = dropCaptureOut.read();
+			appendPayload(captured, word);
+		} while (!word.last && !dropCaptureOut.empty());
+
+		if (number != captures * DROP_CAPTURE_RATE || captured != droppedPayloads[number]) {
+			std::cout << "ERROR capture of drop " << number << " (" << captured.size() << " bytes) does not match" << std::endl;
+			errors++;
+		}
+		captures++;
+	}
+	if (captures != (payloadDrops + DROP_CAPTURE_RATE - 1) / DROP_CAPTURE_RATE) {
+		std::cout << "ERROR " << captures << " captures for " << payloadDrops << " dropped payloads" << std::endl;
+		errors++;
+	}
+#endif
+
+	std::cout << segments.size() << " segments, " << payloadDrops << " dropped payloads, " << receivedData.size() << " bytes delivered" << std::endl;
+	if (errors) {
+		std::cout << "FAILED with " << errors << " errors" << std::endl;
+		return -1;
+	}
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
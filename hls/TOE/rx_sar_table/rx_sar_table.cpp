@@ -39,6 +39,7 @@ using namespace hls;
  *  @param[in]		txEng2rxSar_upd_req
  *  @param[out]		rxSar2rxEng_upd_rsp
  *  @param[out]		rxSar2rxApp_upd_rsp
+ *  @param[out]		rxSar2rxQueues_reset
  *  @param[out]		rxSar2txEng_upd_rsp
  */
 void rx_sar_table(	stream<rxSarRecvd>&			rxEng2rxSar_upd_req,
@@ -46,6 +47,9 @@ void rx_sar_table(	stream<rxSarRecvd>&			rxEng2rxSar_upd_req,
 					stream<ap_uint<16> >&		txEng2rxSar_req, 		//read only
 					stream<rxSarEntry>&			rxSar2rxEng_upd_rsp,
 					stream<rxSarAppd>&			rxSar2rxApp_upd_rsp,
+#if (RX_SESSION_QUEUES)
+					stream<ap_uint<16> >&		rxSar2rxQueues_reset,
+#endif
 					stream<rxSarEntry_rsp>&		rxSar2txEng_rsp)
 {
 
@@ -100,7 +104,14 @@ void rx_sar_table(	stream<rxSarRecvd>&			rxEng2rxSar_upd_req,
 #if (WINDOW_SCALE)				
 				rx_table[in_recvd.sessionID].rx_win_shift = in_recvd.rx_win_shift;
 #endif				
+#if (RX_SESSION_QUEUES)
+				// The window is the free space of the on chip queue of the session, whatever 
+				// the previous connection left in it is dropped
+				rx_table[in_recvd.sessionID].appd = in_recvd.recvd + RX_QUEUE_WINDOW;
+				rxSar2rxQueues_reset.write(in_recvd.sessionID);
+#else
 				rx_table[in_recvd.sessionID].appd = in_recvd.recvd;
+#endif
 			}
 		}
 		else {
@@ -30,10 +30,11 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 
 using namespace hls;
 
-void emptyFifos(std::ofstream& out, stream<rxSarEntry>& rxFifoOut, stream<rxSarAppd>& appFifoOut, stream<rxSarEntry>& txFifoOut, int iter)
+void emptyFifos(std::ofstream& out, stream<rxSarEntry>& rxFifoOut, stream<rxSarAppd>& appFifoOut, stream<rxSarEntry_rsp>& txFifoOut, int iter)
 {
 	rxSarEntry outData;
 	rxSarAppd outAppData;
+	rxSarEntry_rsp outTxData;
 	while (!(rxFifoOut.empty()))
 	{
 		rxFifoOut.read(outData);
@@ -56,11 +57,11 @@ void emptyFifos(std::ofstream& out, stream<rxSarEntry>& rxFifoOut, stream<rxSarA
 
 	while (!(txFifoOut.empty()))
 	{
-		txFifoOut.read(outData);
+		txFifoOut.read(outTxData);
 		out << "Step " << iter << ": TX Fifo\t\t";
 		out << std::hex;
 		out << std::setfill('0');
-		out << std::setw(8) << outData.recvd << " " << std::setw(4) << outData.appd << " ";
+		out << std::setw(8) << outTxData.recvd << " " << std::setw(4) << outTxData.windowSize << " ";
 		out << std::endl;
 	}
 }
@@ -77,7 +78,10 @@ int main()
 	stream<rxSarAppd> appFifo;
 	stream<rxSarAppd> appFifoOut;
 	stream<rxSarEntry> rxFifoOut;
-	stream<rxSarEntry> txFifoOut;
+	stream<rxSarEntry_rsp> txFifoOut;
+#if (RX_SESSION_QUEUES)
+	stream<ap_uint<16> > queueResetOut;
+#endif
 
 	//std::vector<int> rxValues;
 	//std::vector<int> appValues;
@@ -134,7 +138,11 @@ int main()
 		default:
 			break;
 		}
+#if (RX_SESSION_QUEUES)
+		rx_sar_table(rxFifoIn, appFifo, txFifoIn, rxFifoOut, appFifoOut, queueResetOut, txFifoOut);
+#else
 		rx_sar_table(rxFifoIn, appFifo, txFifoIn, rxFifoOut, appFifoOut, txFifoOut);
+#endif
 		emptyFifos(outputFile, rxFifoOut, appFifoOut, txFifoOut, count);
 		count++;
 	}
@@ -146,7 +154,11 @@ int main()
 
 	while (count < 250)
 	{
+#if (RX_SESSION_QUEUES)
+		rx_sar_table(rxFifoIn, appFifo, txFifoIn, rxFifoOut, appFifoOut, queueResetOut, txFifoOut);
+#else
 		rx_sar_table(rxFifoIn, appFifo, txFifoIn, rxFifoOut, appFifoOut, txFifoOut);
+#endif
 		//bram_test(inFifo0, outFifo0);
 		count++;
 	}
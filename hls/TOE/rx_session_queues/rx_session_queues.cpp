@@ -0,0 +1,272 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "rx_session_queues.hpp"
+
+using namespace hls;
+
+/** @ingroup rx_session_queues
+ *  Keeps the payload of every session in its own queue on chip, so the application can 
+ *  read the sessions in any order and a session that is not read does not block the others.
+ *  The payload of each notification of the @ref rx_engine is appended to the queue of its 
+ *  session and the notification is forwarded once the data is in the queue. A read request
+ *  is served from the queue of its session, or from the next session that has data in round
+ *  robin order if it is for RX_QUEUE_ANY_SESSION. It gets at most the data that is in the 
+ *  queue. After the last word of a read the drained bytes are reported to the 
+ *  @ref rx_app_stream_if, which gives them back to the receive window of the session. 
+ *  The window never exceeds the free space of the queue, so writes never wait for reads.
+ *  When the @ref rx_sar_table opens the window of a new connection the queue of its session
+ *  is emptied, so nothing the previous connection left unread reaches the new one. A read
+ *  of the old data that is on its way ends normally but is not reported as drained.
+ *  The queues are byte packed, every row holds 64 bytes of a session. The partial last
+ *  row of each session is also kept aside, so a segment is appended without reading the 
+ *  queue. A write and a read of the queue memory per cycle.
+ *  @param[in]		rxEng2rxApp_notification
+ *  @param[in]		rxSar2rxQueues_reset
+ *  @param[in]		rxEngData
+ *  @param[in]		rxQueueReadCmd
+ *  @param[out]		appNotificationOut
+ *  @param[out]		appRxDataRspIDsession
+ *  @param[out]		rxDataRsp
+ *  @param[out]		rxQueueDrained
+ */
+void rx_session_queues(
+					stream<appNotification>&	rxEng2rxApp_notification,
+					stream<ap_uint<16> >&		rxSar2rxQueues_reset,
+					stream<axiWord>&			rxEngData,
+					stream<appReadRequest>&		rxQueueReadCmd,
+					stream<appNotification>&	appNotificationOut,
+					stream<ap_uint<16> >&		appRxDataRspIDsession,
+					stream<axiWord>&			rxDataRsp,
+					stream<appReadRequest>&		rxQueueDrained)
+{
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static ap_uint<512> 				queueMemory[MAX_SESSIONS * RX_QUEUE_ROWS];
+	#pragma HLS RESOURCE variable=queueMemory core=XPM_MEMORY uram
+	#pragma HLS DEPENDENCE variable=queueMemory inter false
+
+	static ap_uint<512> 				tailRow[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=tailRow core=RAM_2P_BRAM
+	#pragma HLS DEPENDENCE variable=tailRow inter false
+
+	static ap_uint<RX_QUEUE_BITS> 		queueHead[MAX_SESSIONS];
+	static ap_uint<RX_QUEUE_BITS> 		queueTail[MAX_SESSIONS];
+	#pragma HLS DEPENDENCE variable=queueHead inter false
+	#pragma HLS DEPENDENCE variable=queueTail inter false
+
+	static ap_uint<MAX_SESSIONS> 		readyMask = 0;
+	static ap_uint<16> 					lastServed = 0;
+	const int 							SB = ceilLog2<MAX_SESSIONS>::value;
+
+	enum rsqWrStates {WR_NOTIFICATION, WR_DATA, WR_FLUSH};
+	static rsqWrStates 					wr_state = WR_NOTIFICATION;
+	static appNotification 				wr_notification;
+	static ap_uint<RX_QUEUE_BITS> 		wr_pos;
+	static ap_uint<512> 				wr_carry;
+
+	enum rsqRdStates {RD_COMMAND, RD_FIRST_ROW, RD_DATA};
+	static rsqRdStates 					rd_state = RD_COMMAND;
+	static appReadRequest 				rd_cmd;
+	static bool 						rd_cmdValid = false;
+	static ap_uint<16> 					rd_session;
+	static ap_uint<RX_QUEUE_BITS> 		rd_pos;
+	static ap_uint<RX_QUEUE_BITS-6> 	rd_row;
+	static ap_uint<16> 					rd_length;
+	static ap_uint<16> 					rd_left;
+	static ap_uint<512> 				rd_prev;
+	static bool 						rd_flushed = false;
+
+	ap_uint<MAX_SESSIONS> 				setReady = 0;
+	ap_uint<MAX_SESSIONS> 				clearReady = 0;
+	ap_uint<16> 						id;
+	axiWord 							currWord;
+	axiWord 							sendWord;
+	ap_uint<6> 							shift;
+	ap_uint<7> 							bytes;
+	ap_uint<512> 						carryMask;
+	ap_uint<512> 						shiftedLow;
+	ap_uint<512> 						shiftedHigh;
+	ap_uint<512> 						row;
+	ap_uint<512> 						nextRow;
+	ap_uint<MAX_SESSIONS> 				candidates;
+	ap_uint<SB+1> 						pick;
+	ap_uint<RX_QUEUE_BITS> 				occupancy;
+	ap_uint<RX_QUEUE_BITS> 				newHead;
+	bool 								ready;
+	bool 								resetValid = false;
+	ap_uint<16> 						resetID;
+
+	// Append the payload of the notifications to the queue of their session
+	switch (wr_state) {
+		case WR_NOTIFICATION:
+			// The reset of a new connection comes before any of its notifications
+			if (!rxSar2rxQueues_reset.empty()) {
+				rxSar2rxQueues_reset.read(resetID);
+				resetValid 					= true;
+				queueHead[resetID] 			= queueTail[resetID];
+				clearReady.bit(resetID) 	= 1;
+				if (rd_state != RD_COMMAND && rd_session == resetID)
+					rd_flushed = true;
+			}
+			else if (!rxEng2rxApp_notification.empty()) {
+				rxEng2rxApp_notification.read(wr_notification);
+				if (wr_notification.length == 0) {
+					appNotificationOut.write(wr_notification);
+				}
+				else {
+					id 			= wr_notification.sessionID;
+					wr_pos 		= queueTail[id];
+					wr_carry 	= tailRow[id];
+					wr_state 	= WR_DATA;
+				}
+			}
+			break;
+		case WR_DATA:
+			if (!rxEngData.empty()) {
+				rxEngData.read(currWord);
+				id 			= wr_notification.sessionID;
+				shift 		= wr_pos(5, 0);
+				bytes 		= keep2len(currWord.keep);
+				// The bytes below shift are the ones already in the row
+				carryMask 	= keep2mask<64>(lowMask<64>(shift));
+				shiftedLow 	= elementShiftLeft<8, 64>(currWord.data, shift);
+				shiftedHigh = (shift == 0) ? ap_uint<512>(0) : elementFunnelRight<8, 64>(0, currWord.data, 64 - shift);
+				row 		= (wr_carry & carryMask) | (shiftedLow & ~carryMask);
+
+				queueMemory[id * RX_QUEUE_ROWS + wr_pos(RX_QUEUE_BITS-1, 6)] = row;
+				wr_carry 	= (shift + bytes >= 64) ? shiftedHigh : row;
+				wr_pos 		+= bytes;
+
+				if (currWord.last) {
+					if (shift + bytes > 64) { 		// The last bytes went to the next row
+						wr_state = WR_FLUSH;
+					}
+					else {
+						queueTail[id] 	= wr_pos;
+						tailRow[id] 	= wr_carry;
+						setReady.bit(id) = 1;
+						appNotificationOut.write(wr_notification);
+						wr_state = WR_NOTIFICATION;
+					}
+				}
+			}
+			break;
+		case WR_FLUSH:
+			id = wr_notification.sessionID;
+			queueMemory[id * RX_QUEUE_ROWS + wr_pos(RX_QUEUE_BITS-1, 6)] = wr_carry;
+			queueTail[id] 	= wr_pos;
+			tailRow[id] 	= wr_carry;
+			setReady.bit(id) = 1;
+			appNotificationOut.write(wr_notification);
+			wr_state = WR_NOTIFICATION;
+			break;
+	}
+
+	// Serve the read requests of the application
+	switch (rd_state) {
+		case RD_COMMAND:
+			if (!rd_cmdValid && !rxQueueReadCmd.empty()) {
+				rxQueueReadCmd.read(rd_cmd);
+				rd_cmdValid = true;
+			}
+			if (rd_cmdValid) {
+				if (rd_cmd.sessionID == RX_QUEUE_ANY_SESSION) {
+					// Round robin, the sessions below the last one served go first
+					candidates = readyMask & lowMask<MAX_SESSIONS>(lastServed(SB, 0));
+					if (candidates == 0)
+						candidates = readyMask;
+					pick 	= leadingOne<MAX_SESSIONS>(candidates);
+					ready 	= pick.bit(SB);
+					id 		= pick(SB-1, 0);
+				}
+				else {
+					id 		= rd_cmd.sessionID;
+					ready 	= readyMask.bit(id);
+				}
+				if (resetValid && id == resetID) 	// Emptied in this cycle
+					ready 	= false;
+				if (ready) {
+					occupancy 	= queueTail[id] - queueHead[id];
+					rd_length 	= (rd_cmd.length < occupancy) ? rd_cmd.length : (ap_uint<16>) occupancy;
+					rd_left 	= rd_length;
+					rd_session 	= id;
+					rd_pos 		= queueHead[id];
+					lastServed 	= id;
+					appRxDataRspIDsession.write(id);
+					rd_cmdValid = false;
+					rd_state 	= RD_FIRST_ROW;
+				}
+			}
+			break;
+		case RD_FIRST_ROW:
+			rd_prev 	= queueMemory[rd_session * RX_QUEUE_ROWS + rd_pos(RX_QUEUE_BITS-1, 6)];
+			rd_row 		= rd_pos(RX_QUEUE_BITS-1, 6) + 1;
+			rd_state 	= RD_DATA;
+			break;
+		case RD_DATA:
+			shift = rd_pos(5, 0);
+			nextRow = 0;
+			if (shift + rd_left > 64) { 		// This word has bytes of the next row
+				nextRow = queueMemory[rd_session * RX_QUEUE_ROWS + rd_row];
+				rd_row++;
+			}
+			sendWord.data = elementFunnelRight<8, 64>(nextRow, rd_prev, shift);
+			sendWord.keep = lowMask<64>((rd_left > 64) ? (ap_uint<7>) 64 : (ap_uint<7>) rd_left);
+			sendWord.last = (rd_left <= 64);
+			rxDataRsp.write(sendWord);
+			rd_prev = nextRow;
+
+			if (rd_left <= 64) {
+				if (!rd_flushed) {
+					newHead = rd_pos + rd_length;
+					queueHead[rd_session] = newHead;
+					if (newHead == queueTail[rd_session])
+						clearReady.bit(rd_session) = 1;
+					rxQueueDrained.write(appReadRequest(rd_session, rd_length));
+				}
+				rd_flushed 	= false;
+				rd_state 	= RD_COMMAND;
+			}
+			else {
+				rd_left -= 64;
+			}
+			break;
+	}
+
+	// A session that got data in this cycle is ready even if it was also drained
+	readyMask = (readyMask & ~clearReady) | setReady;
+}
@@ -0,0 +1,418 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "rx_session_queues.hpp"
+#include "../rx_app_stream_if/rx_app_stream_if.hpp"
+#include "../rx_sar_table/rx_sar_table.hpp"
+#include <vector>
+#include <deque>
+#include <cstdlib>
+#include <iomanip>
+
+using namespace std;
+
+#define SESSIONS 		4
+#define SEND_CYCLES 	200000 		// Cycles during which segments arrive, session 0 may be stalled for all of them
+
+static uint8_t payload(int session, uint32_t byte) {
+	return (byte * 11 + (byte >> 9) + session * 29) & 0xFF;
+}
+
+/*
+ * Receive side of the rx_engine. Segments of random length go to random sessions at one 
+ * word per cycle. As in rxEngTcpFSM a segment is only accepted if it fits in the free 
+ * space of the RX SAR table, otherwise the peer would have to wait for a window update
+ * and the segment goes to another session.
+ */
+class rxEngineModel {
+public:
+	rxEngineModel() :closedWindows(0), state(PICK), wordsLeft(0) {
+		for (int s = 0; s < SESSIONS; s++){
+			recvd[s] 	= 0;
+			sent[s] 	= 0;
+		}
+	}
+
+	void init(stream<rxSarRecvd>& rxEng2rxSar) {
+		for (int s = 0; s < SESSIONS; s++){
+			isn[s] = rand();
+			rxEng2rxSar.write(rxSarRecvd(s, isn[s], 1, 1, WINDOW_SCALE_BITS));
+		}
+	}
+
+	void step(uint64_t cycle, stream<rxSarRecvd>& rxEng2rxSar, stream<rxSarEntry>& rxSar2rxEng,
+			stream<appNotification>& notification, stream<axiWord>& rxData) {
+		rxSarEntry 				entry;
+		ap_uint<WINDOW_BITS> 	freeSpace;
+
+		switch (state){
+			case PICK:
+				if (cycle >= SEND_CYCLES)
+					return;
+				session = rand() % SESSIONS;
+				length 	= 1 + rand() % MSS.to_int();
+				rxEng2rxSar.write(rxSarRecvd(session));
+				state = CHECK;
+				break;
+			case CHECK:
+				if (rxSar2rxEng.empty())
+					return;
+				rxSar2rxEng.read(entry);
+				freeSpace = (entry.appd - entry.recvd(WINDOW_BITS-1, 0)) - 1;
+				if (freeSpace.to_int() > length){
+					rxEng2rxSar.write(rxSarRecvd(session, entry.recvd + length, 1));
+					notification.write(appNotification(ap_uint<16>(session), ap_uint<16>(length), ap_uint<32>(0x0A010101), ap_uint<16>(5001)));
+					wordsLeft 	= (length + 63) / 64;
+					offset 		= 0;
+					state 		= SEND;
+				}
+				else {
+					closedWindows++;
+					state = PICK;
+				}
+				break;
+			case SEND: {
+				axiWord word(0, 0, wordsLeft == 1);
+				for (int b = 0; b < 64 && offset < length; b++, offset++){
+					word.data(b*8+7, b*8) = payload(session, sent[session] + offset);
+					word.keep.bit(b) = 1;
+				}
+				rxData.write(word);
+				if (--wordsLeft == 0){
+					sent[session] += length;
+					state = PICK;
+				}
+				break;
+			}
+		}
+	}
+
+	uint64_t 	sent[SESSIONS];
+	uint64_t 	closedWindows;
+
+private:
+	enum modelStates {PICK, CHECK, SEND};
+	modelStates state;
+	int 		session;
+	int 		length;
+	int 		wordsLeft;
+	int 		offset;
+	uint32_t 	isn[SESSIONS];
+	uint32_t 	recvd[SESSIONS];
+};
+
+/*
+ * Application. It reads every notified segment of its session, except for session 0 
+ * while it is stalled. Once the stall ends it reads whatever is left with requests for
+ * any session. Every byte is checked.
+ */
+class appModel {
+public:
+	appModel(uint64_t stallUntil) :errors(0), stallUntil(stallUntil), moving(false), anyOutstanding(false) {
+		for (int s = 0; s < SESSIONS; s++){
+			notified[s] 	= 0;
+			received[s] 	= 0;
+			receivedAtEnd[s] = 0;
+		}
+	}
+
+	void step(uint64_t cycle, stream<appNotification>& notification, stream<appReadRequest>& request,
+			stream<ap_uint<16> >& responseID, stream<axiWord>& rxData) {
+		appNotification 	notif;
+		axiWord 			word;
+		ap_uint<16> 		id;
+
+		if (!notification.empty()){
+			notification.read(notif);
+			notified[notif.sessionID] += notif.length;
+			if (notif.sessionID != 0 || cycle >= stallUntil)
+				request.write(appReadRequest(notif.sessionID, notif.length));
+		}
+		if (cycle == stallUntil && notified[0] != received[0])
+			anyPending = true;
+		if (anyPending && !anyOutstanding && notified[0] != received[0]){
+			request.write(appReadRequest(RX_QUEUE_ANY_SESSION, 16384));
+			anyOutstanding = true;
+		}
+
+		if (!moving){
+			if (!responseID.empty()){
+				responseID.read(id);
+				session = id;
+				moving 	= true;
+			}
+		}
+		else if (!rxData.empty()){
+			rxData.read(word);
+			for (int b = 0; b < 64 && word.keep.bit(b); b++){
+				if (word.data(b*8+7, b*8) != payload(session, received[session])){
+					errors++;
+					break;
+				}
+				received[session]++;
+			}
+			if (word.last){
+				moving = false;
+				if (session == 0 && anyOutstanding && cycle >= stallUntil)
+					anyOutstanding = false;
+			}
+		}
+		if (cycle == SEND_CYCLES - 1){
+			for (int s = 0; s < SESSIONS; s++)
+				receivedAtEnd[s] = received[s];
+		}
+	}
+
+	uint64_t 	notified[SESSIONS];
+	uint64_t 	received[SESSIONS];
+	uint64_t 	receivedAtEnd[SESSIONS];
+	int 		errors;
+	bool 		anyPending = false;
+
+private:
+	uint64_t 	stallUntil;
+	bool 		moving;
+	bool 		anyOutstanding;
+	int 		session;
+};
+
+int runQueues(bool stall, uint64_t results[SESSIONS]) {
+	static stream<rxSarRecvd> 		rxEng2rxSar;
+	static stream<rxSarAppd> 		rxApp2rxSar;
+	static stream<ap_uint<16> > 	txEng2rxSar;
+	static stream<rxSarEntry> 		rxSar2rxEng;
+	static stream<rxSarAppd> 		rxSar2rxApp;
+	static stream<rxSarEntry_rsp> 	rxSar2txEng;
+	static stream<ap_uint<16> > 	rxSar2rxQueues;
+	static stream<appNotification> 	rxEngNotification;
+	static stream<axiWord> 			rxEngData;
+	static stream<appReadRequest> 	appRequest;
+	static stream<appReadRequest> 	queueReadCmd;
+	static stream<appReadRequest> 	queueDrained;
+	static stream<appNotification> 	appNotification;
+	static stream<ap_uint<16> > 	appResponseID;
+	static stream<axiWord> 			appData;
+
+	rxEngineModel 	rxEng;
+	appModel 		app(stall ? SEND_CYCLES : 0);
+	uint64_t 		cycle;
+	int 			errors = 0;
+	bool 			done = false;
+
+	srand(5);
+	rxEng.init(rxEng2rxSar);
+	for (cycle = 0; !done && cycle < 10 * SEND_CYCLES; cycle++){
+		rxEng.step(cycle, rxEng2rxSar, rxSar2rxEng, rxEngNotification, rxEngData);
+		rx_sar_table(rxEng2rxSar, rxApp2rxSar, txEng2rxSar, rxSar2rxEng, rxSar2rxApp, rxSar2rxQueues, rxSar2txEng);
+		rx_session_queues(rxEngNotification, rxSar2rxQueues, rxEngData, queueReadCmd, appNotification, appResponseID, appData, queueDrained);
+		rx_app_stream_if(appRequest, rxSar2rxApp, queueReadCmd, queueDrained, rxApp2rxSar);
+		app.step(cycle, appNotification, appRequest, appResponseID, appData);
+
+		done = cycle > SEND_CYCLES;
+		for (int s = 0; s < SESSIONS; s++)
+			done &= (app.received[s] == rxEng.sent[s]);
+	}
+	for (int i = 0; i < 16; i++){ 		// The last drained bytes go back to the window
+		rx_sar_table(rxEng2rxSar, rxApp2rxSar, txEng2rxSar, rxSar2rxEng, rxSar2rxApp, rxSar2rxQueues, rxSar2txEng);
+		rx_session_queues(rxEngNotification, rxSar2rxQueues, rxEngData, queueReadCmd, appNotification, appResponseID, appData, queueDrained);
+		rx_app_stream_if(appRequest, rxSar2rxApp, queueReadCmd, queueDrained, rxApp2rxSar);
+	}
+
+	errors += app.errors;
+	for (int s = 0; s < SESSIONS; s++){
+		if (app.received[s] != rxEng.sent[s]){
+			cout << "Session " << s << " received " << app.received[s] << " of " << rxEng.sent[s] << " bytes" << endl;
+			errors++;
+		}
+		results[s] = app.receivedAtEnd[s];
+		cout << setw(12) << (stall ? "stalled" : "no stall") << setw(10) << s 
+			 << setw(12) << app.receivedAtEnd[s] << setw(10) << fixed << setprecision(2) << (app.receivedAtEnd[s] / (SEND_CYCLES * 3.1))
+			 << setw(12) << rxEng.sent[s] << endl;
+	}
+	cout << setw(12) << "" << " segments that waited for the window " << rxEng.closedWindows << ", drained after " << cycle << " cycles" << endl;
+	if (errors)
+		cout << errors << " errors" << endl;
+	return errors;
+}
+
+/*
+ * The queues with the RX SAR table and rx_app_stream_if for the reuse test, the test
+ * drives the rx_engine and application side of the streams itself
+ */
+struct queueBench {
+	stream<rxSarRecvd> 			rxEng2rxSar;
+	stream<rxSarAppd> 			rxApp2rxSar;
+	stream<ap_uint<16> > 		txEng2rxSar;
+	stream<rxSarEntry> 			rxSar2rxEng;
+	stream<rxSarAppd> 			rxSar2rxApp;
+	stream<rxSarEntry_rsp> 		rxSar2txEng;
+	stream<ap_uint<16> > 		rxSar2rxQueues;
+	stream<appNotification> 	rxEngNotification;
+	stream<axiWord> 			rxEngData;
+	stream<appReadRequest> 		appRequest;
+	stream<appReadRequest> 		queueReadCmd;
+	stream<appReadRequest> 		queueDrained;
+	stream<appNotification> 	appNotif;
+	stream<ap_uint<16> > 		appResponseID;
+	stream<axiWord> 			appData;
+
+	void run(int cycles) {
+		for (int i = 0; i < cycles; i++){
+			rx_sar_table(rxEng2rxSar, rxApp2rxSar, txEng2rxSar, rxSar2rxEng, rxSar2rxApp, rxSar2rxQueues, rxSar2txEng);
+			rx_session_queues(rxEngNotification, rxSar2rxQueues, rxEngData, queueReadCmd, appNotif, appResponseID, appData, queueDrained);
+			rx_app_stream_if(appRequest, rxSar2rxApp, queueReadCmd, queueDrained, rxApp2rxSar);
+		}
+	}
+
+	// Free space the RX SAR table gives to the peer
+	uint32_t window(int session) {
+		rxSarEntry 	entry;
+
+		rxEng2rxSar.write(rxSarRecvd(session));
+		run(4);
+		rxSar2rxEng.read(entry);
+		return (entry.appd - entry.recvd(WINDOW_BITS-1, 0)) - 1;
+	}
+
+	// A segment of the session as rxEngTcpFSM delivers it, bytes come from payload(seed, ...)
+	void segment(int session, uint32_t recvd, int length, int seed) {
+		rxEng2rxSar.write(rxSarRecvd(session, recvd + length, 1));
+		rxEngNotification.write(appNotification(ap_uint<16>(session), ap_uint<16>(length), ap_uint<32>(0x0A010101), ap_uint<16>(5001)));
+		for (int i = 0; i < length; i += 64){
+			axiWord word(0, 0, i + 64 >= length);
+			for (int b = 0; b < 64 && i + b < length; b++){
+				word.data(b*8+7, b*8) = payload(seed, i + b);
+				word.keep.bit(b) = 1;
+			}
+			rxEngData.write(word);
+		}
+		run(length / 64 + 8);
+	}
+};
+
+/*
+ * A connection closes with data the application did not read and its session is reused.
+ * The new connection gets the whole window, and a read of any session only returns the
+ * data of the new connection.
+ */
+int reuseTest() {
+	static queueBench 	bench;
+	const int 			session = 2;
+	appNotification 	notif;
+	ap_uint<16> 		id;
+	axiWord 			word;
+	uint32_t 			received = 0;
+	int 				errors = 0;
+
+	// The old connection, the application reads a part of its only segment
+	bench.rxEng2rxSar.write(rxSarRecvd(session, 1000, 1, 1, WINDOW_SCALE_BITS));
+	bench.segment(session, 1000, 3000, 7);
+	bench.rxEngNotification.write(appNotification(session, 0x0A010101, 5001, true));
+	bench.appRequest.write(appReadRequest(session, 100));
+	bench.run(100);
+	while (!bench.appNotif.empty())
+		bench.appNotif.read(notif);
+	bench.appResponseID.read(id);
+	while (!bench.appData.empty())
+		bench.appData.read(word);
+
+	// The new connection on the same session
+	bench.rxEng2rxSar.write(rxSarRecvd(session, 50000, 1, 1, WINDOW_SCALE_BITS));
+	bench.run(10);
+	if (bench.window(session) != RX_QUEUE_WINDOW - 1){
+		cout << "The reused session opened a window of " << bench.window(session) << " bytes" << endl;
+		errors++;
+	}
+	bench.segment(session, 50000, 1000, session);
+	bench.appNotif.read(notif);
+	bench.appRequest.write(appReadRequest(RX_QUEUE_ANY_SESSION, 16384));
+	bench.run(100);
+
+	if (bench.appResponseID.empty() || bench.appResponseID.read() != session){
+		cout << "The read of any session did not get the reused session" << endl;
+		errors++;
+	}
+	while (!bench.appData.empty()){
+		bench.appData.read(word);
+		for (int b = 0; b < 64 && word.keep.bit(b); b++){
+			if (word.data(b*8+7, b*8) != payload(session, received)){
+				errors++;
+				break;
+			}
+			received++;
+		}
+	}
+	if (received != 1000 || !bench.appResponseID.empty()){
+		cout << "The reused session returned " << received << " bytes of 1000" << endl;
+		errors++;
+	}
+	if (bench.window(session) != RX_QUEUE_WINDOW - 1){
+		cout << "The window of the reused session did not open again" << endl;
+		errors++;
+	}
+
+	cout << setw(12) << "reuse" << " " << received << " bytes of the new connection" << endl;
+	if (errors)
+		cout << errors << " errors" << endl;
+	return errors;
+}
+
+int main(int argc, char **argv) {
+
+	int 		errors = 0;
+	uint64_t 	free[SESSIONS];
+	uint64_t 	stalled[SESSIONS];
+
+	cout << setw(12) << "" << setw(10) << "session" << setw(12) << "delivered" << setw(10) << "GB/s" << setw(12) << "sent" << endl;
+	errors += runQueues(false, free);
+	errors += runQueues(true, stalled);
+
+	// While session 0 is stalled its window closes and the others keep all the bandwidth
+	if (stalled[0] != 0){
+		cout << "The stalled session got data" << endl;
+		errors++;
+	}
+	for (int s = 1; s < SESSIONS; s++){
+		if (stalled[s] < free[s]){
+			cout << "Session " << s << " got less data while session 0 was stalled" << endl;
+			errors++;
+		}
+	}
+
+	errors += reuseTest();
+
+	cout << (errors ? "FAILED" : "PASSED") << endl;
+	return errors;
+}
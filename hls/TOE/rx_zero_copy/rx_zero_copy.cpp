@@ -0,0 +1,384 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "rx_zero_copy.hpp"
+
+using namespace hls;
+
+/**
+ * @brief      Keeps the receive buffers posted by the application in a queue per session
+ *             and places every segment notified by the TOE in the buffer at the head of
+ *             the queue of its session. A segment that does not fit in what is left of that
+ *             buffer is split, the rest goes to the next buffer. For every part a write 
+ *             command goes to the data mover, its length to the data splitter and its 
+ *             completion to the completion handler. A buffer that cannot be posted because 
+ *             the queue is full or it is empty is returned with an error completion.
+ *             If a segment arrives for a session without posted buffers the payload waits
+ *             in the RX FIFO, so the application has to keep at least the receive window
+ *             of every session posted. With RX_SESSION_QUEUES the payload is requested 
+ *             from the queue of the session when the segment is placed, so it waits in 
+ *             that queue and the window of the session closes until buffers are posted.
+ *
+ * @param      appPostBuffer      Receive buffers posted by the application
+ * @param      rxAppNotification  Notifications of the TOE
+ * @param      rxAppReadRequest   Read requests to the TOE
+ * @param      writeCmd           Write commands to the data mover
+ * @param      pieceLength        Length of every write to the data splitter
+ * @param      pending            Completions waiting for their write
+ */
+void rzc_buffer_manager(
+			stream<rxPostedBuffer>&		appPostBuffer,
+			stream<appNotification>&	rxAppNotification,
+#if (RX_SESSION_QUEUES)
+			stream<appReadRequest>&		rxAppReadRequest,
+#endif
+			stream<mmCmd>&				writeCmd,
+			stream<ap_uint<16> >&		pieceLength,
+			stream<rzcPending>&			pending) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static rxPostedBuffer 				bufferQueue[MAX_SESSIONS * RZC_QUEUE_DEPTH];
+	#pragma HLS DATA_PACK variable=bufferQueue
+	#pragma HLS RESOURCE variable=bufferQueue core=RAM_2P_BRAM
+	#pragma HLS DEPENDENCE variable=bufferQueue inter false
+
+	static ap_uint<RZC_QUEUE_BITS> 		queueHead[MAX_SESSIONS];
+	static ap_uint<RZC_QUEUE_BITS> 		queueTail[MAX_SESSIONS];
+	static ap_uint<RZC_QUEUE_BITS+1> 	queueCount[MAX_SESSIONS];
+	static ap_uint<23> 					headFill[MAX_SESSIONS];
+	#pragma HLS DEPENDENCE variable=queueHead inter false
+	#pragma HLS DEPENDENCE variable=queueTail inter false
+	#pragma HLS DEPENDENCE variable=queueCount inter false
+	#pragma HLS DEPENDENCE variable=headFill inter false
+
+	enum rzcBmStates {READ_NOTIFICATION, PLACE_SEGMENT};
+	static rzcBmStates 		bm_state = READ_NOTIFICATION;
+	static appNotification 	bm_notification;
+	static ap_uint<16> 		bm_remaining;
+
+	rxPostedBuffer 			post;
+	rxPostedBuffer 			buffer;
+	rxCompletion 			completion;
+	ap_uint<16> 			id;
+	ap_uint<23> 			space;
+	ap_uint<16> 			piece;
+	ap_uint<23> 			fill;
+	bool 					full;
+
+	if (!appPostBuffer.empty()) {
+		appPostBuffer.read(post);
+		id = post.sessionID;
+		if (queueCount[id] == RZC_QUEUE_DEPTH || post.length == 0) {
+			completion = rxCompletion(id, post.id, 0, 0, false);
+			completion.error = true;
+			pending.write(rzcPending(completion, 0, false));
+		}
+		else {
+			bufferQueue[id * RZC_QUEUE_DEPTH + queueTail[id]] = post;
+			queueTail[id]++;
+			queueCount[id]++;
+		}
+	}
+	else {
+		switch (bm_state) {
+			case READ_NOTIFICATION:
+				if (!rxAppNotification.empty()) {
+					rxAppNotification.read(bm_notification);
+					if (bm_notification.length == 0) { 		// The session was opened or closed
+						pending.write(rzcPending(rxCompletion(bm_notification.sessionID, bm_notification.closed, false), 0, false));
+					}
+					else {
+						bm_remaining = bm_notification.length;
+						bm_state = PLACE_SEGMENT;
+					}
+				}
+				break;
+			case PLACE_SEGMENT:
+				id = bm_notification.sessionID;
+				if (queueCount[id] != 0) {
+					buffer 	= bufferQueue[id * RZC_QUEUE_DEPTH + queueHead[id]];
+					fill 	= headFill[id];
+					space 	= buffer.length - fill;
+					full 	= (space <= bm_remaining);
+					piece 	= full ? (ap_uint<16>) space : bm_remaining;
+#if (RX_SESSION_QUEUES)
+					if (bm_remaining == bm_notification.length)
+						rxAppReadRequest.write(appReadRequest(id, bm_notification.length));
+#endif
+
+					writeCmd.write(mmCmd(buffer.addr + fill, piece));
+					pieceLength.write(piece);
+					bm_remaining -= piece;
+					pending.write(rzcPending(rxCompletion(id, buffer.id, fill, piece, full), 
+									(bm_remaining == 0) ? bm_notification.length : (ap_uint<16>) 0, true));
+
+					if (full) {
+						queueHead[id]++;
+						queueCount[id]--;
+						headFill[id] = 0;
+					}
+					else {
+						headFill[id] = fill + piece;
+					}
+					if (bm_remaining == 0)
+						bm_state = READ_NOTIFICATION;
+				}
+				break;
+		}
+	}
+}
+
+/**
+ * @brief      Cuts the payload coming from the TOE in the writes decided by the buffer 
+ *             manager. Every write starts at the first byte of a word, so the bytes that 
+ *             follow a cut in the middle of a word are shifted down. The data mover places
+ *             them at any address of the buffer.
+ *
+ * @param      rxDataIn     Payload of the TOE, every segment ends with last
+ * @param      pieceLength  Length of every write
+ * @param      writeData    Data of the writes, every write ends with last
+ */
+void rzc_data_splitter(
+			stream<axiWord>&			rxDataIn,
+			stream<ap_uint<16> >&		pieceLength,
+			stream<axiWord>&			writeData) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static axiWord 			ds_current;
+	static bool 			ds_currentValid = false;
+	static ap_uint<7> 		ds_currentBytes;
+	static ap_uint<7> 		ds_offset;
+	static ap_uint<16> 		ds_pieceLeft = 0;
+
+	axiWord 				nextWord = axiWord(0, 0, 0);
+	axiWord 				sendWord;
+	ap_uint<7> 				need;
+	ap_uint<7> 				available;
+	ap_uint<7> 				nextBytes;
+	bool 					needWord;
+
+	if (ds_pieceLeft == 0) {
+		if (!pieceLength.empty())
+			pieceLength.read(ds_pieceLeft);
+	}
+	else {
+		need 		= (ds_pieceLeft > 64) ? (ap_uint<7>) 64 : (ap_uint<7>) ds_pieceLeft;
+		available 	= ds_currentBytes - ds_offset;
+		// The last word of a segment holds all it has left, any other word is full
+		needWord 	= !ds_currentValid || (available < need);
+
+		if (!needWord || !rxDataIn.empty()) {
+			if (needWord) {
+				rxDataIn.read(nextWord);
+				nextBytes = keep2len(nextWord.keep);
+			}
+			if (!ds_currentValid) {
+				ds_current 		= nextWord;
+				ds_currentBytes = nextBytes;
+				ds_offset 		= 0;
+				available 		= nextBytes;
+				needWord 		= false;
+			}
+
+			sendWord.data = elementFunnelRight<8, 64>(nextWord.data, ds_current.data, ds_offset(5, 0));
+			sendWord.keep = lowMask<64>(need);
+			sendWord.last = (ds_pieceLeft == need);
+			writeData.write(sendWord);
+
+			if (needWord) {
+				ds_current 		= nextWord;
+				ds_currentBytes = nextBytes;
+				ds_offset 		= need - available;
+			}
+			else {
+				ds_offset 		+= need;
+			}
+			ds_currentValid = (ds_offset != ds_currentBytes);
+
+			ds_pieceLeft -= need;
+			if (ds_pieceLeft == 0 && !pieceLength.empty())
+				pieceLength.read(ds_pieceLeft);
+		}
+	}
+}
+
+/**
+ * @brief      Hands the completions to the application in order, the ones of a write once 
+ *             its status is back. When the last write of a segment is done its bytes are 
+ *             given back to the receive window with a read request to the TOE, which does 
+ *             not move any data under RX_DDR_BYPASS. With RX_SESSION_QUEUES the window is
+ *             opened by the queue of the session when the data leaves it. The session ID 
+ *             that the TOE returns for every request is dropped.
+ *
+ * @param      pending             Completions waiting for their write
+ * @param      writeStatus         Status of the data mover, one per write in order
+ * @param      appCompletion       Completions to the application
+ * @param      rxAppReadRequest    Read requests to the TOE
+ * @param      rxDataRspIDsession  Session ID of every read request
+ */
+void rzc_completion_handler(
+			stream<rzcPending>&			pending,
+			stream<mmStatus>&			writeStatus,
+			stream<rxCompletion>&		appCompletion,
+#if (!RX_SESSION_QUEUES)
+			stream<appReadRequest>&		rxAppReadRequest,
+#endif
+			stream<ap_uint<16> >&		rxDataRspIDsession) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static rzcPending 		ch_pending;
+	static bool 			ch_pendingValid = false;
+
+	mmStatus 				status;
+	rxCompletion 			completion;
+
+	if (!rxDataRspIDsession.empty())
+		rxDataRspIDsession.read();
+
+	if (!ch_pendingValid && !pending.empty()) {
+		pending.read(ch_pending);
+		ch_pendingValid = true;
+	}
+
+	if (ch_pendingValid) {
+		if (!ch_pending.write) {
+			appCompletion.write(ch_pending.completion);
+			ch_pendingValid = false;
+		}
+		else if (!writeStatus.empty()) {
+			writeStatus.read(status);
+			completion 			= ch_pending.completion;
+			completion.error 	= !status.okay;
+			appCompletion.write(completion);
+#if (!RX_SESSION_QUEUES)
+			// The window is given back even if the write failed, the application sees the error
+			if (ch_pending.release != 0)
+				rxAppReadRequest.write(appReadRequest(completion.sessionID, ch_pending.release));
+#endif
+			ch_pendingValid = false;
+		}
+	}
+}
+
+/**
+ * @brief      Zero copy delivery of the received payload. Instead of reading the payload 
+ *             from the TOE the application posts receive buffers to each session, like the
+ *             receive queues of RDMA. The payload is written straight into them through the
+ *             data mover in order and the application gets a completion for every write.
+ *             A buffer is handed back with the completion that fills it. The module sits 
+ *             on the application side of the TOE, which has to be built with RX_DDR_BYPASS.
+ *
+ * @param      appPostBuffer       Receive buffers posted by the application
+ * @param      appCompletion       Completions to the application
+ * @param      rxAppNotification   Notifications of the TOE
+ * @param      rxDataIn            Payload of the TOE
+ * @param      rxAppReadRequest    Read requests to the TOE, they open the receive window
+ *                                 or with RX_SESSION_QUEUES get the payload of a segment
+ * @param      rxDataRspIDsession  Session ID of every read request
+ * @param      writeCmd            Write commands to the data mover
+ * @param      writeData           Write data to the data mover
+ * @param      writeStatus         Write status of the data mover
+ */
+void rx_zero_copy(
+					stream<rxPostedBuffer>&		appPostBuffer,
+					stream<rxCompletion>&		appCompletion,
+
+					stream<appNotification>&	rxAppNotification,
+					stream<axiWord>&			rxDataIn,
+					stream<appReadRequest>&		rxAppReadRequest,
+					stream<ap_uint<16> >&		rxDataRspIDsession,
+
+					stream<mmCmd>&				writeCmd,
+					stream<axiWord>&			writeData,
+					stream<mmStatus>&			writeStatus) {
+
+#pragma HLS INTERFACE ap_ctrl_none port=return
+#pragma HLS DATAFLOW
+
+#pragma HLS INTERFACE axis register both port=appPostBuffer name=s_axis_post_buffer
+#pragma HLS INTERFACE axis register both port=appCompletion name=m_axis_completion
+#pragma HLS INTERFACE axis register both port=rxAppNotification name=s_axis_notifications
+#pragma HLS INTERFACE axis register both port=rxDataIn name=s_axis_rx_data_rsp
+#pragma HLS INTERFACE axis register both port=rxAppReadRequest name=m_axis_rx_data_req
+#pragma HLS INTERFACE axis register both port=rxDataRspIDsession name=s_axis_rx_data_rsp_metadata
+#pragma HLS INTERFACE axis register both port=writeCmd name=m_axis_write_cmd
+#pragma HLS INTERFACE axis register both port=writeData name=m_axis_write_data
+#pragma HLS INTERFACE axis register both port=writeStatus name=s_axis_write_sts
+
+#pragma HLS DATA_PACK variable=appPostBuffer
+#pragma HLS DATA_PACK variable=appCompletion
+#pragma HLS DATA_PACK variable=rxAppNotification
+#pragma HLS DATA_PACK variable=rxAppReadRequest
+#pragma HLS DATA_PACK variable=writeCmd
+#pragma HLS DATA_PACK variable=writeStatus
+
+	static stream<ap_uint<16> >		rzcPieceLength("rzcPieceLength");
+	#pragma HLS STREAM variable=rzcPieceLength depth=16
+
+	// Holds the completions of the writes in flight
+	static stream<rzcPending>		rzcPendingFifo("rzcPendingFifo");
+	#pragma HLS STREAM variable=rzcPendingFifo depth=64
+	#pragma HLS DATA_PACK variable=rzcPendingFifo
+
+	rzc_buffer_manager(
+			appPostBuffer,
+			rxAppNotification,
+#if (RX_SESSION_QUEUES)
+			rxAppReadRequest,
+#endif
+			writeCmd,
+			rzcPieceLength,
+			rzcPendingFifo);
+
+	rzc_data_splitter(
+			rxDataIn,
+			rzcPieceLength,
+			writeData);
+
+	rzc_completion_handler(
+			rzcPendingFifo,
+			writeStatus,
+			appCompletion,
+#if (!RX_SESSION_QUEUES)
+			rxAppReadRequest,
+#endif
+			rxDataRspIDsession);
+}
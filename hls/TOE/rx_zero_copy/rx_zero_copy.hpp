@@ -0,0 +1,116 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _RX_ZERO_COPY_HPP_
+#define _RX_ZERO_COPY_HPP_
+
+#include "../toe.hpp"
+#include "../common_utilities/common_utilities.hpp"
+
+using namespace hls;
+
+#if (!RX_DDR_BYPASS)
+#error "rx_zero_copy takes the payload from the RX FIFO, it requires RX_DDR_BYPASS"
+#endif
+
+// Receive buffers that can be posted to each session and not completed yet
+static const uint8_t  RZC_QUEUE_BITS = 3;
+static const uint16_t RZC_QUEUE_DEPTH = (1 << RZC_QUEUE_BITS);
+
+/**
+ * Receive buffer posted by the application. The TOE fills it with the in order
+ * payload of the session, id is returned in the completions of the buffer
+ */
+struct rxPostedBuffer
+{
+	ap_uint<16>			sessionID;
+	ap_uint<32>			addr;
+	ap_uint<23>			length;
+	ap_uint<16>			id;
+	rxPostedBuffer() {}
+	rxPostedBuffer(ap_uint<16> sessionID, ap_uint<32> addr, ap_uint<23> length, ap_uint<16> id)
+			:sessionID(sessionID), addr(addr), length(length), id(id) {}
+};
+
+/**
+ * Completion descriptor. length bytes of payload were written at offset of the buffer id,
+ * full is set when the buffer is handed back to the application. A completion with closed
+ * set reports the end of the session and error set a failed write or a buffer that could 
+ * not be posted.
+ */
+struct rxCompletion
+{
+	ap_uint<16>			sessionID;
+	ap_uint<16>			id;
+	ap_uint<23>			offset;
+	ap_uint<16>			length;
+	bool				full;
+	bool				closed;
+	bool				error;
+	rxCompletion() {}
+	rxCompletion(ap_uint<16> sessionID, ap_uint<16> id, ap_uint<23> offset, ap_uint<16> length, bool full)
+			:sessionID(sessionID), id(id), offset(offset), length(length), full(full), closed(false), error(false) {}
+	rxCompletion(ap_uint<16> sessionID, bool closed, bool error)
+			:sessionID(sessionID), id(0), offset(0), length(0), full(false), closed(closed), error(error) {}
+};
+
+/**
+ * Completion waiting for its write, release is the amount of bytes that are given back
+ * to the receive window of the session once it is written
+ */
+struct rzcPending
+{
+	rxCompletion		completion;
+	ap_uint<16>			release;
+	bool				write;
+	rzcPending() {}
+	rzcPending(rxCompletion completion, ap_uint<16> release, bool write)
+			:completion(completion), release(release), write(write) {}
+};
+
+void rx_zero_copy(
+					stream<rxPostedBuffer>&		appPostBuffer,
+					stream<rxCompletion>&		appCompletion,
+
+					stream<appNotification>&	rxAppNotification,
+					stream<axiWord>&			rxDataIn,
+					stream<appReadRequest>&		rxAppReadRequest,
+					stream<ap_uint<16> >&		rxDataRspIDsession,
+
+					stream<mmCmd>&				writeCmd,
+					stream<axiWord>&			writeData,
+					stream<mmStatus>&			writeStatus);
+
+#endif
@@ -0,0 +1,451 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "rx_zero_copy.hpp"
+#include "../rx_app_stream_if/rx_app_stream_if.hpp"
+#include "../rx_session_queues/rx_session_queues.hpp"
+#include <vector>
+#include <deque>
+#include <cstdlib>
+#include <iomanip>
+
+using namespace std;
+
+#define MEM_WRITE_LATENCY 		40 			// Cycles from the last word of a write to its status
+#define APP_REGION_BITS 		19 			// Memory of the application for every session
+#define APP_BUFFER_BYTES 		33007 		// Odd size, the segments are cut at any byte
+
+/*
+ * Memory of the application behind a data mover. The writes are served in order at one 
+ * word per cycle, the status comes back MEM_WRITE_LATENCY cycles after the last word. 
+ * Every byte written is counted.
+ */
+class appMemory {
+public:
+	appMemory() :cycle(0), bytesWritten(0), active(false) {
+		storage.resize(MAX_SESSIONS << APP_REGION_BITS);
+	}
+
+	void step(stream<mmCmd>& writeCmd, stream<axiWord>& writeData, stream<mmStatus>& writeStatus) {
+		axiWord word;
+
+		cycle++;
+		while (!statusOut.empty() && statusOut.front() <= cycle){
+			mmStatus status;
+			status.tag 		= 0;
+			status.interr 	= 0;
+			status.decerr 	= 0;
+			status.slverr 	= 0;
+			status.okay 	= 1;
+			writeStatus.write(status);
+			statusOut.pop_front();
+		}
+		if (!active){
+			if (writeCmd.empty())
+				return;
+			writeCmd.read(current);
+			addr 	= current.saddr;
+			left 	= current.bbt;
+			active 	= true;
+		}
+		if (writeData.empty())
+			return;
+		writeData.read(word);
+		for (int b = 0; b < 64 && word.keep.bit(b); b++){
+			storage[addr++] = word.data(b*8+7, b*8);
+			left--;
+			bytesWritten++;
+		}
+		if (word.last){
+			if (left != 0)
+				cout << "Write of " << current.bbt << " bytes ended " << left << " bytes early" << endl;
+			statusOut.push_back(cycle + MEM_WRITE_LATENCY);
+			active = false;
+		}
+	}
+
+	bool idle() {
+		return !active && statusOut.empty();
+	}
+
+	vector<uint8_t> 	storage;
+	uint64_t 			cycle;
+	uint64_t 			bytesWritten;
+
+private:
+	deque<uint64_t> 	statusOut;
+	mmCmd 				current;
+	bool 				active;
+	uint32_t 			addr;
+	int 				left;
+};
+
+/*
+ * Receive side of the TOE built with RX_DDR_BYPASS. In order segments of random length 
+ * are spread over the sessions, one word per cycle, as long as the receive window of the
+ * session allows it. The window is opened by the read requests that go through 
+ * rx_app_stream_if, this model holds the application pointers of the RX SAR table.
+ * With RX_SESSION_QUEUES the payload goes through rx_session_queues on its way.
+ * The sessions go from first on, so every run uses sessions the previous ones did not.
+ */
+class toeRxModel {
+public:
+	toeRxModel(int first, int sessions, int segments, unsigned seed)
+		:first(first), sessions(sessions), bytes(0), segmentsLeft(segments), wordsLeft(0), length(0) {
+		srand(seed);
+		for (int s = 0; s < MAX_SESSIONS; s++){
+			recvd.push_back(0);
+#if (RX_SESSION_QUEUES)
+			appd.push_back(RX_QUEUE_WINDOW);
+#else
+			appd.push_back(0);
+#endif
+			segmentStarts.push_back(deque<pair<uint32_t, uint64_t> >());
+		}
+	}
+
+	static uint8_t payload(int session, uint32_t byte) {
+		return (byte * 7 + (byte >> 8) + session * 13) & 0xFF;
+	}
+
+	void step(uint64_t cycle, stream<appNotification>& notification, stream<axiWord>& rxData,
+			stream<rxSarAppd>& rxApp2rxSar, stream<rxSarAppd>& rxSar2rxApp) {
+		rxSarAppd 	req;
+
+		if (!rxApp2rxSar.empty()){
+			rxApp2rxSar.read(req);
+			if (req.write)
+				appd[req.sessionID] = req.appd;
+			else
+				rxSar2rxApp.write(rxSarAppd(req.sessionID, appd[req.sessionID]));
+		}
+
+		if (wordsLeft == 0){
+			if (segmentsLeft == 0)
+				return;
+			if (length == 0){ 		// The next segment is drawn once, it waits for the window
+				session = first + rand() % sessions;
+				length 	= 1 + rand() % MSS.to_int();
+			}
+			if (((appd[session] - recvd[session] - 1) & (BUFFER_SIZE - 1)) <= (uint32_t) length) 	// The segment would be dropped
+				return;
+			notification.write(appNotification(ap_uint<16>(session), ap_uint<16>(length), ap_uint<32>(0x0A010101), ap_uint<16>(5001)));
+			segmentStarts[session].push_back(make_pair(recvd[session] + length, cycle));
+			wordsLeft = (length + 63) / 64;
+			segmentLength = length;
+			length = 0;
+			offset = 0;
+			segmentsLeft--;
+			bytes += segmentLength;
+		}
+		axiWord word(0, 0, wordsLeft == 1);
+		for (int b = 0; b < 64 && offset < segmentLength; b++, offset++){
+			word.data(b*8+7, b*8) = payload(session, recvd[session] + offset);
+			word.keep.bit(b) = 1;
+		}
+		rxData.write(word);
+		if (--wordsLeft == 0)
+			recvd[session] += segmentLength;
+	}
+
+	bool done() {
+		return segmentsLeft == 0 && wordsLeft == 0;
+	}
+
+	int 										first;
+	int 										sessions;
+	uint64_t 									bytes;
+	vector<deque<pair<uint32_t, uint64_t> > > 	segmentStarts;
+
+private:
+	int 										segmentsLeft;
+	int 										wordsLeft;
+	int 										session;
+	int 										length;
+	int 										segmentLength;
+	int 										offset;
+	vector<uint32_t> 							recvd;
+	vector<uint32_t> 							appd;
+};
+
+/*
+ * Delivery statistics, the latency of a segment goes from the cycle its first word leaves 
+ * the TOE until the application knows that the whole segment is in its memory
+ */
+struct deliveryStats {
+	uint64_t 			segments;
+	uint64_t 			latencySum;
+	uint64_t 			latencyMax;
+	uint64_t 			appBytesMoved;
+	int 				errors;
+	deliveryStats() :segments(0), latencySum(0), latencyMax(0), appBytesMoved(0), errors(0) {}
+
+	void delivered(toeRxModel& toe, int session, uint32_t upTo, uint64_t cycle) {
+		deque<pair<uint32_t, uint64_t> >& starts = toe.segmentStarts[session];
+		while (!starts.empty() && (int32_t) (upTo - starts.front().first) >= 0){
+			uint64_t latency = cycle - starts.front().second;
+			latencySum += latency;
+			latencyMax = max(latencyMax, latency);
+			segments++;
+			starts.pop_front();
+		}
+	}
+};
+
+/*
+ * Application using the zero copy interface. It keeps RZC_QUEUE_DEPTH buffers posted to 
+ * every session, which covers the receive window, and posts a buffer again once it is 
+ * handed back. Every completion is checked against the payload sent by the TOE.
+ */
+class zeroCopyApp {
+public:
+	zeroCopyApp(int first, int sessions) {
+		received.resize(MAX_SESSIONS);
+		for (int s = first; s < first + sessions; s++){
+			for (int k = 0; k < RZC_QUEUE_DEPTH; k++)
+				toPost.push_back(rxPostedBuffer(s, bufferAddr(s, k), APP_BUFFER_BYTES, k));
+		}
+	}
+
+	static uint32_t bufferAddr(int session, int k) {
+		return (session << APP_REGION_BITS) + k * APP_BUFFER_BYTES + 5;
+	}
+
+	void step(uint64_t cycle, toeRxModel& toe, appMemory& memory, deliveryStats& stats,
+			stream<rxPostedBuffer>& post, stream<rxCompletion>& completions) {
+		rxCompletion 	comp;
+
+		if (!toPost.empty()){
+			post.write(toPost.front());
+			toPost.pop_front();
+		}
+		if (completions.empty())
+			return;
+		completions.read(comp);
+		if (comp.error || comp.closed){
+			cout << "Unexpected completion session " << comp.sessionID << endl;
+			stats.errors++;
+			return;
+		}
+		int s = comp.sessionID;
+		uint32_t addr = bufferAddr(s, comp.id) + comp.offset;
+		for (int i = 0; i < comp.length.to_int(); i++){
+			if (memory.storage[addr + i] != toeRxModel::payload(s, received[s] + i)){
+				cout << "Session " << s << " byte " << (received[s] + i) << " wrong" << endl;
+				stats.errors++;
+				break;
+			}
+		}
+		received[s] += comp.length;
+		stats.delivered(toe, s, received[s], cycle);
+		if (comp.full)
+			toPost.push_back(rxPostedBuffer(s, bufferAddr(s, comp.id), APP_BUFFER_BYTES, comp.id));
+	}
+
+private:
+	vector<uint32_t> 		received;
+	deque<rxPostedBuffer> 	toPost;
+};
+
+/*
+ * Application using the stream interface. For every notification it requests the data,
+ * waits for the response, moves the payload from the stream to its own buffer and waits
+ * for the write to complete. The payload goes through the application once.
+ */
+class streamApp {
+public:
+	streamApp() :state(IDLE) {
+		received.resize(MAX_SESSIONS);
+		offset.resize(MAX_SESSIONS);
+	}
+
+	void step(uint64_t cycle, toeRxModel& toe, deliveryStats& stats, stream<appNotification>& notification,
+			stream<appReadRequest>& request, stream<ap_uint<16> >& response, stream<axiWord>& rxData,
+			stream<mmCmd>& writeCmd, stream<axiWord>& writeData, stream<mmStatus>& writeStatus) {
+		axiWord 	word;
+
+		if (!writeStatus.empty()){
+			writeStatus.read();
+			received[writes.front().first] += writes.front().second;
+			stats.delivered(toe, writes.front().first, received[writes.front().first], cycle);
+			writes.pop_front();
+		}
+		switch (state){
+			case IDLE:
+				if (!notification.empty()){
+					notification.read(current);
+					request.write(appReadRequest(current.sessionID, current.length));
+					state = WAIT_RESPONSE;
+				}
+				break;
+			case WAIT_RESPONSE:
+				if (!response.empty()){
+					response.read();
+					int s = current.sessionID;
+					if (offset[s] + current.length > (1 << APP_REGION_BITS))
+						offset[s] = 0;
+					writeCmd.write(mmCmd((s << APP_REGION_BITS) + offset[s], current.length));
+					offset[s] += current.length;
+					position = 0;
+					state = MOVE_DATA;
+				}
+				break;
+			case MOVE_DATA:
+				if (!rxData.empty()){
+					rxData.read(word);
+					int s = current.sessionID;
+					for (int b = 0; b < 64 && word.keep.bit(b); b++, position++){
+						if (word.data(b*8+7, b*8) != toeRxModel::payload(s, received[s] + pendingBytes(s) + position)){
+							stats.errors++;
+							break;
+						}
+					}
+					stats.appBytesMoved += keep2len(word.keep);
+					writeData.write(word);
+					if (word.last){
+						writes.push_back(make_pair(s, current.length));
+						state = IDLE;
+					}
+				}
+				break;
+		}
+	}
+
+private:
+	uint32_t pendingBytes(int session) {
+		uint32_t bytes = 0;
+		for (size_t i = 0; i < writes.size(); i++){
+			if (writes[i].first == session)
+				bytes += writes[i].second;
+		}
+		return bytes;
+	}
+
+	enum streamAppStates {IDLE, WAIT_RESPONSE, MOVE_DATA};
+	streamAppStates 			state;
+	appNotification 			current;
+	int 						position;
+	vector<uint32_t> 			received;
+	vector<uint32_t> 			offset;
+	deque<pair<int, int> > 		writes;
+};
+
+/*
+ * Delivers the same segments to the stream interface and to the zero copy interface. 
+ * Reported are the delivery latency, the bytes written to the memory of the application
+ * and the bytes the application had to move itself, per byte of payload.
+ */
+int runDelivery(bool zeroCopy, int first, int sessions, int segments) {
+	static stream<appNotification> 	notification;
+	static stream<axiWord> 			rxData;
+	static stream<appReadRequest> 	readRequest;
+	static stream<ap_uint<16> > 	readResponse;
+	static stream<rxSarAppd> 		rxApp2rxSar;
+	static stream<rxSarAppd> 		rxSar2rxApp;
+	static stream<rxPostedBuffer> 	post;
+	static stream<rxCompletion> 	completions;
+	static stream<mmCmd> 			writeCmd;
+	static stream<axiWord> 			writeData;
+	static stream<mmStatus> 		writeStatus;
+#if (RX_SESSION_QUEUES)
+	static stream<appNotification> 	toeNotification;
+	static stream<axiWord> 			toeData;
+	static stream<appReadRequest> 	queueReadCmd;
+	static stream<appReadRequest> 	queueDrained;
+	static stream<ap_uint<16> > 	queueReset; 		// The sessions are never reused
+#endif
+
+	toeRxModel 		toe(first, sessions, segments, 11);
+	appMemory 		memory;
+	deliveryStats 	stats;
+	zeroCopyApp 	zcApp(first, sessions);
+	streamApp 		stApp;
+	uint64_t 		cycle = 0;
+
+	while ((!toe.done() || stats.segments < (uint64_t) segments) && cycle < 10000000){
+#if (RX_SESSION_QUEUES)
+		toe.step(cycle, toeNotification, toeData, rxApp2rxSar, rxSar2rxApp);
+		rx_session_queues(toeNotification, queueReset, toeData, queueReadCmd, notification, readResponse, rxData, queueDrained);
+		rx_app_stream_if(readRequest, rxSar2rxApp, queueReadCmd, queueDrained, rxApp2rxSar);
+#else
+		toe.step(cycle, notification, rxData, rxApp2rxSar, rxSar2rxApp);
+		rx_app_stream_if(readRequest, rxSar2rxApp, readResponse, rxApp2rxSar);
+#endif
+		if (zeroCopy){
+			rx_zero_copy(post, completions, notification, rxData, readRequest, readResponse,
+						writeCmd, writeData, writeStatus);
+			zcApp.step(cycle, toe, memory, stats, post, completions);
+		}
+		else {
+			stApp.step(cycle, toe, stats, notification, readRequest, readResponse, rxData,
+						writeCmd, writeData, writeStatus);
+		}
+		memory.step(writeCmd, writeData, writeStatus);
+		cycle++;
+	}
+	if (stats.segments != (uint64_t) segments){
+		cout << "Only " << stats.segments << " of " << segments << " segments delivered" << endl;
+		stats.errors++;
+	}
+
+	cout << setw(12) << (zeroCopy ? "zero copy" : "stream") << setw(10) << sessions << setw(10) << cycle
+		 << setw(10) << fixed << setprecision(1) << ((double) stats.latencySum / stats.segments)
+		 << setw(10) << stats.latencyMax
+		 << setw(10) << setprecision(2) << ((double) memory.bytesWritten / toe.bytes)
+		 << setw(10) << ((double) stats.appBytesMoved / toe.bytes)
+		 << setw(10) << (toe.bytes / (cycle * 3.1)) << endl;
+
+	if (stats.errors)
+		cout << stats.errors << " errors" << endl;
+	return stats.errors;
+}
+
+int main(int argc, char **argv) {
+
+	int errors = 0;
+	int segments = 10000;
+
+	cout << setw(12) << "" << setw(10) << "sessions" << setw(10) << "cycles" << setw(10) << "avg lat" << setw(10) 
+		 << "max lat" << setw(10) << "mem wr/B" << setw(10) << "app cp/B" << setw(10) << "GB/s" << endl;
+	errors += runDelivery(false, 0, 1, segments);
+	errors += runDelivery(true, 0, 1, segments);
+	errors += runDelivery(false, 1, 8, segments);
+	errors += runDelivery(true, 1, 8, segments);
+	errors += runDelivery(false, 9, 32, segments);
+	errors += runDelivery(true, 9, 32, segments);
+
+	cout << (errors ? "FAILED" : "PASSED") << endl;
+	return errors;
+}
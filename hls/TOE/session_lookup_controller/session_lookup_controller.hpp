@@ -125,9 +125,9 @@ struct rtlSessionLookupReply
 	lookupSource		source;
 	rtlSessionLookupReply() {}
 	rtlSessionLookupReply(bool hit, lookupSource src)
-			:hit(hit), sessionID(0), source(src) {}
+			:sessionID(0), hit(hit), source(src) {}
 	rtlSessionLookupReply(bool hit, ap_uint<16> id, lookupSource src)
-			:hit(hit), sessionID(id), source(src) {}
+			:sessionID(id), hit(hit), source(src) {}
 };
 
 /** @ingroup session_lookup_controller
@@ -142,7 +142,7 @@ struct rtlSessionUpdateRequest // todo
 
 	rtlSessionUpdateRequest() {}
 	rtlSessionUpdateRequest(threeTuple key, ap_uint<16> value, lookupOp op, lookupSource src)
-			:key(key), value(value), op(op), source(src) {}
+			:value(value), key(key), op(op), source(src) {}
 };
 
 
@@ -35,12 +35,12 @@ void sessionLookupStub(stream<rtlSessionLookupRequest>& lup_req, stream<rtlSessi
 						stream<rtlSessionUpdateRequest>& upd_req, stream<rtlSessionUpdateReply>& upd_rsp)
 						//stream<ap_uint<14> >& new_id, stream<ap_uint<14> >& fin_id)
 {
-	static std::map<fourTupleInternal, ap_uint<14> > lookupTable;
+	static std::map<threeTuple, ap_uint<14> > lookupTable;
 
 	rtlSessionLookupRequest request;
 	rtlSessionUpdateRequest update;
 
-	std::map<fourTupleInternal, ap_uint<14> >::const_iterator findPos;
+	std::map<threeTuple, ap_uint<14> >::const_iterator findPos;
 
 	if (!lup_req.empty())
 	{
@@ -125,7 +125,7 @@ int main()
 	stream<sessionLookupReply>			sLookup2rxEng_rsp("sLookup2rxEng_rsp");
 	stream<ap_uint<16> >				stateTable2sLookup_releaseSession;
 	stream<ap_uint<16> >				sLookup2portTable_releasePort;
-	stream<fourTuple>					txApp2sLookup_req;
+	stream<threeTuple>					txApp2sLookup_req;
 	stream<sessionLookupReply>			sLookup2txApp_rsp;
 	stream<ap_uint<16> >				txEng2sLookup_rev_req;
 	stream<fourTuple>					sLookup2txEng_rev_rsp;
@@ -142,6 +142,7 @@ int main()
 	//stream<sessionLookupQueryInternal> lookups("lookups");
 
 	ap_uint<16> regSessionCount;
+	ap_uint<32> myIpAddress = 0x01010101;
 
 	int count = 0;
 	fourTuple tuple;
@@ -170,7 +171,7 @@ int main()
 
 		if (count == 90)
 		{
-			txApp2sLookup_req.write(tuple);
+			txApp2sLookup_req.write(threeTuple(tuple.dstPort, tuple.srcPort, tuple.srcIp));
 		}
 		session_lookup_controller(	//lookups,
 									rxEng2sLookup_req,
@@ -187,10 +188,11 @@ int main()
 									//sessionInsert_req,
 									//sessionDelete_req,
 									sessionUpdate_rsp,
-									regSessionCount);
+									regSessionCount,
+									myIpAddress);
 		//lookupRequestMerger(rxEng2sLookup_req, txApp2sLookup_req, sessionLookup_req, lookups);
 		//updateRequestMerger(sessionInsert_req, sessionDelete_req, sessionUpdate_req);
-		if ( lastSessionCount != regSessionCount)
+		if ( lastSessionCount != regSessionCount.to_int())
 		{
 			std::cout << "SessionCount\t" << regSessionCount << std::endl;
 			lastSessionCount = regSessionCount;
@@ -31,12 +31,27 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 
 using namespace hls;
 
+/** @ingroup state_table
+ *  True if @p valid and both IDs are the same session
+ */
+bool stt_sameSession(bool valid, ap_uint<16> sessionID, ap_uint<16> otherID)
+{
+#pragma HLS INLINE
+	return valid && (sessionID == otherID);
+}
+
 /** @ingroup state_table
  *  Stores the TCP connection state of each session. It is accessed
  *  from the @ref rx_engine, @ref tx_app_if and from @ref tx_engine.
  *  It also receives Session-IDs from the @ref close_timer, those sessions
  *  are closed and the IDs forwarded to the @ref session_lookup_controller which
  *  releases this ID.
+ *  The table is a true dual-port RAM, port A serves the RX engine and port B the
+ *  TX app. A read of them locks the session until their write, an access to a
+ *  session locked by the other one waits in its register. The state reads of
+ *  @ref tx_app_stream_if and the releases of the timers take a port left free.
+ *  A release of a locked session waits in one of STT_RELEASE_SLOTS slots, the
+ *  following releases go ahead.
  *  @param[in]		rxEng2stateTable_upd_req
  *  @param[in]		txApp2stateTable_upd_req
  *  @param[in]		txApp2stateTable_req
@@ -58,7 +73,7 @@ void state_table(	stream<stateQuery>&			rxEng2stateTable_upd_req,
 #pragma HLS PIPELINE II=1
 
 	static sessionState state_table[MAX_SESSIONS];
-	#pragma HLS RESOURCE variable=state_table core=RAM_2P_BRAM
+	#pragma HLS RESOURCE variable=state_table core=RAM_T2P_BRAM
 	#pragma HLS DEPENDENCE variable=state_table inter false
 
 	static ap_uint<16> stt_txSessionID;
@@ -68,134 +83,151 @@ void state_table(	stream<stateQuery>&			rxEng2stateTable_upd_req,
 
 	static stateQuery stt_txAccess;
 	static stateQuery stt_rxAccess;
-	static bool stt_txWait = false;
-	static bool stt_rxWait = false;
+	static bool stt_txPending = false;
+	static bool stt_rxPending = false;
 
-	static ap_uint<16> stt_closeSessionID;
-	static bool stt_closeWait = false;
+	static ap_uint<16> stt_releaseID[STT_RELEASE_SLOTS];
+	#pragma HLS ARRAY_PARTITION variable=stt_releaseID complete
+	static ap_uint<STT_RELEASE_SLOTS> stt_releaseValid = 0;
 
-	ap_uint<16> sessionID;
+	const int RL = ceilLog2<STT_RELEASE_SLOTS>::value;
+	ap_uint<STT_RELEASE_SLOTS> releaseReady;
+	ap_uint<RL+1> releasePick;
+	ap_uint<RL+1> releaseFree;
+	ap_uint<16> releaseID;
+	ap_uint<16> readID;
+	bool rxGo, txGo, rxCloses, readGo, releasePortFree;
+	bool releaseGo = false;
 
+	ap_uint<16> portA_ID, portB_ID;
+	sessionState portA_state, portB_state;
+	sessionState portA_rsp = CLOSED, portB_rsp = CLOSED;
+	bool portA_en, portA_write, portB_en, portB_write;
 
-	// TX App If
-	if(!txApp2stateTable_upd_req.empty() && !stt_txWait)
-	{
+	// A new access of the RX engine and of the TX app waits in its register until it goes
+	if (!stt_rxPending && !rxEng2stateTable_upd_req.empty()) {
+		rxEng2stateTable_upd_req.read(stt_rxAccess);
+		stt_rxPending = true;
+	}
+	if (!stt_txPending && !txApp2stateTable_upd_req.empty()) {
 		txApp2stateTable_upd_req.read(stt_txAccess);
-		if ((stt_txAccess.sessionID == stt_rxSessionID) && stt_rxSessionLocked) //delay
-		{
-			stt_txWait = true;
-		}
-		else
-		{
-			if (stt_txAccess.write)
-			{
-				state_table[stt_txAccess.sessionID] = stt_txAccess.state;
-				stt_txSessionLocked = false;
-			}
-			else
-			{
-				stateTable2TxApp_upd_rsp.write(state_table[stt_txAccess.sessionID]);
-				//lock on every read
-				stt_txSessionID = stt_txAccess.sessionID;
-				stt_txSessionLocked = true;
-			}
-		}
+		stt_txPending = true;
 	}
-	// TX App Stream If
-	else if (!txApp2stateTable_req.empty())
-	{
-		txApp2stateTable_req.read(sessionID);
-		stateTable2txApp_rsp.write(state_table[sessionID]);
+
+	// Both go unless the other one has locked the session, RX first if they access the same one
+	rxGo = stt_rxPending && !stt_sameSession(stt_txSessionLocked, stt_txSessionID, stt_rxAccess.sessionID);
+	txGo = stt_txPending && !stt_sameSession(stt_rxSessionLocked, stt_rxSessionID, stt_txAccess.sessionID)
+						 && !stt_sameSession(rxGo, stt_rxAccess.sessionID, stt_txAccess.sessionID);
+	rxCloses = rxGo && stt_rxAccess.write && (stt_rxAccess.state == CLOSED);
+
+	// Reads of TX App Stream If, on any port left
+	readGo = !txApp2stateTable_req.empty() && (!rxGo || !txGo);
+	releasePortFree = readGo ? (!rxGo && !txGo) : (!rxGo || !txGo);
+
+	// Timer release, first the ones waiting for a session that is free by now
+	for (int i = 0; i < STT_RELEASE_SLOTS; i++) {
+	#pragma HLS UNROLL
+		releaseReady.bit(i) = stt_releaseValid.bit(i) &&
+								!stt_sameSession(stt_rxSessionLocked, stt_rxSessionID, stt_releaseID[i]) &&
+								!stt_sameSession(stt_txSessionLocked, stt_txSessionID, stt_releaseID[i]) &&
+								!stt_sameSession(rxGo, stt_rxAccess.sessionID, stt_releaseID[i]) &&
+								!stt_sameSession(txGo, stt_txAccess.sessionID, stt_releaseID[i]);
 	}
-	// RX Engine
-	else if(!rxEng2stateTable_upd_req.empty() && !stt_rxWait)
-	{
-		rxEng2stateTable_upd_req.read(stt_rxAccess);
-		if ((stt_rxAccess.sessionID == stt_txSessionID) && stt_txSessionLocked)
-		{
-			stt_rxWait = true;
-		}
-		else
-		{
-			if (stt_rxAccess.write)
-			{
-				if (stt_rxAccess.state == CLOSED)// && state_table[stt_rxAccess.sessionID] != CLOSED) // We check if it was not closed before, not sure if necessary
-				{
-					stateTable2sLookup_releaseSession.write(stt_rxAccess.sessionID);
-				}
-				state_table[stt_rxAccess.sessionID] = stt_rxAccess.state;
-				stt_rxSessionLocked = false;
-			}
-			else
-			{
-				stateTable2rxEng_upd_rsp.write(state_table[stt_rxAccess.sessionID]);
-				stt_rxSessionID = stt_rxAccess.sessionID;
-				stt_rxSessionLocked = true;
-			}
-		}
+	releasePick = leadingOne<STT_RELEASE_SLOTS>(releaseReady);
+	releaseFree = leadingOne<STT_RELEASE_SLOTS>(~stt_releaseValid);
+
+	if (releasePortFree && !rxCloses && releasePick.bit(RL)) {
+		releaseID = stt_releaseID[releasePick(RL-1, 0)];
+		stt_releaseValid.bit(releasePick(RL-1, 0)) = 0;
+		releaseGo = true;
 	}
-	// Timer release
-	else if (!timer2stateTable_releaseState.empty() && !stt_closeWait) //can only be a close
+	else if (!timer2stateTable_releaseState.empty() && releaseFree.bit(RL)) //can only be a close
 	{
-		timer2stateTable_releaseState.read(stt_closeSessionID);
+		timer2stateTable_releaseState.read(releaseID);
 		// Check if locked
-		if (((stt_closeSessionID == stt_rxSessionID) && stt_rxSessionLocked) ||  ((stt_closeSessionID == stt_txSessionID) && stt_txSessionLocked))
+		if (releasePortFree && !rxCloses &&
+				!stt_sameSession(stt_rxSessionLocked, stt_rxSessionID, releaseID) &&
+				!stt_sameSession(stt_txSessionLocked, stt_txSessionID, releaseID) &&
+				!stt_sameSession(rxGo, stt_rxAccess.sessionID, releaseID) &&
+				!stt_sameSession(txGo, stt_txAccess.sessionID, releaseID))
 		{
-			stt_closeWait = true;
+			releaseGo = true;
 		}
 		else
 		{
-			state_table[stt_closeSessionID] = CLOSED;
-			stateTable2sLookup_releaseSession.write(stt_closeSessionID);
+			stt_releaseID[releaseFree(RL-1, 0)] = releaseID;
+			stt_releaseValid.bit(releaseFree(RL-1, 0)) = 1;
 		}
 	}
-	else if (stt_txWait)
-	{
-		if ((stt_txAccess.sessionID != stt_rxSessionID) || !stt_rxSessionLocked)
-		{
-			if (stt_txAccess.write)
-			{
-				state_table[stt_txAccess.sessionID] = stt_txAccess.state;
-				stt_txSessionLocked = false;
-			}
-			else
-			{
-				stateTable2TxApp_upd_rsp.write(state_table[stt_txAccess.sessionID]);
-				stt_txSessionID = stt_txAccess.sessionID;
-				stt_txSessionLocked = true;
-			}
-			stt_txWait = false;
-		}
+	if (readGo) {
+		txApp2stateTable_req.read(readID);
 	}
-	else if (stt_rxWait)
-	{
-		if ((stt_rxAccess.sessionID != stt_txSessionID) || !stt_txSessionLocked)
-		{
-			if (stt_rxAccess.write)
-			{
-				if (stt_rxAccess.state == CLOSED)
-				{
-					stateTable2sLookup_releaseSession.write(stt_rxAccess.sessionID);
-				}
-				state_table[stt_rxAccess.sessionID] = stt_rxAccess.state;
-				stt_rxSessionLocked = false;
-			}
-			else
-			{
-				stateTable2rxEng_upd_rsp.write(state_table[stt_rxAccess.sessionID]);
-				stt_rxSessionID = stt_rxAccess.sessionID;
-				stt_rxSessionLocked = true;
+
+	// Port A: RX engine, else the read, else the release
+	portA_en 	= rxGo || readGo || releaseGo;
+	portA_write = rxGo ? bool(stt_rxAccess.write) : !readGo;
+	portA_ID 	= rxGo ? stt_rxAccess.sessionID : (readGo ? readID : releaseID);
+	portA_state = rxGo ? stt_rxAccess.state : CLOSED;
+	// Port B: TX app, else what port A had no room for
+	portB_en 	= txGo || (rxGo && (readGo || releaseGo)) || (readGo && releaseGo);
+	portB_write = txGo ? bool(stt_txAccess.write) : !(readGo && rxGo);
+	portB_ID 	= txGo ? stt_txAccess.sessionID : ((readGo && rxGo) ? readID : releaseID);
+	portB_state = txGo ? stt_txAccess.state : CLOSED;
+
+	if (portA_en) {
+		if (portA_write)
+			state_table[portA_ID] = portA_state;
+		else
+			portA_rsp = state_table[portA_ID];
+	}
+	if (portB_en) {
+		if (portB_write)
+			state_table[portB_ID] = portB_state;
+		else
+			portB_rsp = state_table[portB_ID];
+	}
+
+	// RX Engine
+	if (rxGo) {
+		if (stt_rxAccess.write) {
+			if (rxCloses) {
+				stateTable2sLookup_releaseSession.write(stt_rxAccess.sessionID);
 			}
-			stt_rxWait = false;
+			stt_rxSessionLocked = false;
+		}
+		else {
+			stateTable2rxEng_upd_rsp.write(portA_rsp);
+			stt_rxSessionID = stt_rxAccess.sessionID;
+			stt_rxSessionLocked = true;
 		}
+		stt_rxPending = false;
 	}
-	else if (stt_closeWait)
-	{
-		if (((stt_closeSessionID != stt_rxSessionID) || !stt_rxSessionLocked) && ((stt_closeSessionID != stt_txSessionID) || !stt_txSessionLocked))
-		{
-			state_table[stt_closeSessionID] = CLOSED;
-			stateTable2sLookup_releaseSession.write(stt_closeSessionID);
-			stt_closeWait = false;
+	// TX App If
+	if (txGo) {
+		if (stt_txAccess.write) {
+			stt_txSessionLocked = false;
+		}
+		else {
+			stateTable2TxApp_upd_rsp.write(portB_rsp);
+			//lock on every read
+			stt_txSessionID = stt_txAccess.sessionID;
+			stt_txSessionLocked = true;
 		}
+		stt_txPending = false;
+	}
+	// TX App Stream If, a write to the same session in this cycle is forwarded
+	if (readGo) {
+		sessionState readState = rxGo ? portB_rsp : portA_rsp;
+		if (stt_sameSession(rxGo && stt_rxAccess.write, stt_rxAccess.sessionID, readID))
+			readState = stt_rxAccess.state;
+		if (stt_sameSession(txGo && stt_txAccess.write, stt_txAccess.sessionID, readID))
+			readState = stt_txAccess.state;
+		if (stt_sameSession(releaseGo, releaseID, readID))
+			readState = CLOSED;
+		stateTable2txApp_rsp.write(readState);
+	}
+	// Timer release
+	if (releaseGo) {
+		stateTable2sLookup_releaseSession.write(releaseID);
 	}
 }
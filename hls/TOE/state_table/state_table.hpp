@@ -27,9 +27,13 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
 EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx, Inc.
 ************************************************/
 #include "../toe.hpp"
+#include "../common_utilities/bit_utilities.hpp"
 
 using namespace hls;
 
+// Release requests of the timers that wait for a locked session while the following ones go ahead
+static const uint8_t STT_RELEASE_SLOTS = 4;
+
 /** @defgroup state_table State Table
  *  @ingroup tcp_module
  */
@@ -28,423 +28,362 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 ************************************************/
 
 #include "state_table.hpp"
-
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <deque>
+#include <vector>
 
 using namespace hls;
 
-struct readVerify
-{
-	int id;
-	char fifo;
-	int exp;
-};
-
-void emptyFifos(std::ofstream& out, stream<sessionState>& rxFifoOut, stream<sessionState>& appFifoOut, stream<sessionState>& app2FifoOut, stream<ap_uint<16> >& slupOut, int iter)
-{
-	sessionState outData;
-	ap_uint<16> outDataId;
-	while (!(rxFifoOut.empty()))
-	{
-		rxFifoOut.read(outData);
-		out << "Step " << std::dec << iter << ": RX Fifo\t\t";
-		out << outData << std::endl;
-	}
-
-	while (!(appFifoOut.empty()))
-	{
-		appFifoOut.read(outData);
-		out << "Step " << std::dec << iter << ": App Fifo\t\t";
-		out << outData << std::endl;
+/*
+ * Directed tests of the locking, a randomized no-lost-update test and a contention
+ * benchmark. The RX engine and the TX app are modelled as read-modify-write
+ * transactions: read the state, wait a few cycles, write the next state. A
+ * transaction never writes CLOSED, so the only releases are the ones of the timers.
+ */
+
+static const int NUM_STATES = 9;	// CLOSED to LAST_ACK
+
+struct stateTableIf {
+	stream<stateQuery> 		rxIn;
+	stream<sessionState> 	rxOut;
+	stream<stateQuery> 		txAppIn;
+	stream<sessionState> 	txAppOut;
+	stream<ap_uint<16> > 	txApp2In;
+	stream<sessionState> 	txApp2Out;
+	stream<ap_uint<16> > 	timerIn;
+	stream<ap_uint<16> > 	slupOut;
+
+	void run() {
+		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
 	}
-
-	while (!(app2FifoOut.empty()))
-	{
-		app2FifoOut.read(outData);
-		out << "Step " << std::dec << iter << ": App2 Fifo\t\t";
-		out << outData << std::endl;
+	// Runs until every response is out, the table keeps its content between tests
+	void drain() {
+		for (int i = 0; i < 50; i++) {
+			run();
+		}
 	}
+};
 
-	while (!(slupOut.empty()))
-	{
-		slupOut.read(outDataId);
-		out << "Step " << std::dec << iter << ": Slup Fifo\t\t";
-		out << std::hex;
-		out << std::setfill('0');
-		out << std::setw(4) << outDataId;
-		out << std::endl;
-	}
+sessionState nextState(sessionState state)
+{
+	return (sessionState) ((state % (NUM_STATES - 1)) + 1);
 }
 
-int main()
+sessionState readState(stateTableIf& stt, ap_uint<16> id)
 {
-	stream<stateQuery> rxIn;
-	stream<sessionState> rxOut;
-	stream<stateQuery> txAppIn;
-	stream<sessionState> txAppOut;
-	stream<stateQuery> txApp2In;
-	stream<sessionState> txApp2Out;
-	stream<ap_uint<16> > timerIn;
-	stream<ap_uint<16> > slupOut;
-
-	stateQuery inData;
-	sessionState outData;
-
-	std::ifstream inputFile;
-	std::ofstream outputFile;
-
-	/*inputFile.open("/home/dasidler/toe/hls/toe/state_table/in.dat");
-	if (!inputFile)
-	{
-		std::cout << "Error: could not open test input file." << std::endl;
-		return -1;
-	}*/
-	outputFile.open("/home/dasidler/toe/hls/toe/state_table/out.dat");
-	if (!outputFile)
-	{
-		std::cout << "Error: could not open test output file." << std::endl;
+	stt.txApp2In.write(id);
+	for (int i = 0; i < 10 && stt.txApp2Out.empty(); i++) {
+		stt.run();
 	}
+	return stt.txApp2Out.read();
+}
 
-	int count = 0;
-
-	/*
-	 * Test 1: rx(x, ESTA); timer(x), rx(x, FIN_WAIT)
-	 */
-	//ap_uint<16> id = rand() % 100;
-	ap_uint<16> id = 0x57;
-	outputFile << "Test 1" << std::endl;
-	outputFile << "ID: " << id << std::endl;
-	while (count < 20)
-	{
-		switch (count)
-		{
-		case 1:
-			rxIn.write(stateQuery(id, ESTABLISHED, 1));
-			break;
-		case 2:
-			timerIn.write(id);
-			break;
-		case 3:
-			rxIn.write(stateQuery(id, FIN_WAIT_1, 1));
-			break;
-		default:
-			break;
+#define CHECK(cond, msg) if (!(cond)) { std::cout << "ERROR " << msg << std::endl; errors++; }
 
-		}
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		emptyFifos(outputFile, rxOut, txAppOut, txApp2Out, slupOut, count);
-		count++;
+/*
+ * Returns the number of errors
+ */
+int directedTests(stateTableIf& stt)
+{
+	int errors = 0;
+
+	// rx(x, ESTABLISHED); timer(x); rx(x, FIN_WAIT_1)
+	stt.rxIn.write(stateQuery(0x17, ESTABLISHED, 1));
+	stt.run();
+	stt.timerIn.write(0x17);
+	stt.run();
+	CHECK(!stt.slupOut.empty() && (stt.slupOut.read() == 0x17), "release of an unlocked session");
+	stt.rxIn.write(stateQuery(0x17, FIN_WAIT_1, 1));
+	stt.drain();
+	CHECK(readState(stt, 0x17) == FIN_WAIT_1, "write after release");
+
+	// rx(x) locks x: txApp(x) waits for rx(x, ESTABLISHED) and reads its state
+	stt.rxIn.write(stateQuery(0x21));
+	stt.txAppIn.write(stateQuery(0x21));
+	stt.run();
+	CHECK(!stt.rxOut.empty() && stt.txAppOut.empty(), "read of the RX engine goes first");
+	stt.rxOut.read();
+	for (int i = 0; i < 5; i++) {
+		stt.run();
 	}
-	outputFile << "------------------------------------------------" << std::endl;
-
-	//BREAK
-	count = 0;
-	while (count < 200)
-	{
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		count++;
+	CHECK(stt.txAppOut.empty(), "TX app read of a session locked by the RX engine");
+	stt.rxIn.write(stateQuery(0x21, ESTABLISHED, 1));
+	stt.run();
+	stt.run();
+	CHECK(!stt.txAppOut.empty() && (stt.txAppOut.read() == ESTABLISHED), "TX app reads the state written by the RX engine");
+	stt.txAppIn.write(stateQuery(0x21, FIN_WAIT_1, 1));
+	stt.drain();
+
+	// Different sessions: both reads are answered in the same cycle, the stream read too
+	stt.rxIn.write(stateQuery(0x30));
+	stt.txAppIn.write(stateQuery(0x31));
+	stt.run();
+	CHECK(!stt.rxOut.empty() && !stt.txAppOut.empty(), "RX engine and TX app in the same cycle");
+	stt.rxOut.read();
+	stt.txAppOut.read();
+	stt.rxIn.write(stateQuery(0x30, ESTABLISHED, 1));
+	stt.txApp2In.write(0x30);
+	stt.run();
+	CHECK(!stt.txApp2Out.empty() && (stt.txApp2Out.read() == ESTABLISHED), "stream read forwards the write of the same cycle");
+	stt.txAppIn.write(stateQuery(0x31, SYN_SENT, 1));
+	stt.drain();
+
+	// A release of a locked session waits, the release after it goes ahead
+	stt.txAppIn.write(stateQuery(0x40));
+	stt.run();
+	stt.txAppOut.read();
+	stt.timerIn.write(0x40);
+	stt.timerIn.write(0x41);
+	for (int i = 0; i < 5; i++) {
+		stt.run();
 	}
+	CHECK(!stt.slupOut.empty() && (stt.slupOut.read() == 0x41), "release behind a locked session");
+	CHECK(stt.slupOut.empty(), "release of a locked session");
+	stt.txAppIn.write(stateQuery(0x40, ESTABLISHED, 1));
+	stt.drain();
+	CHECK(!stt.slupOut.empty() && (stt.slupOut.read() == 0x40), "release once the session is unlocked");
+	CHECK(readState(stt, 0x40) == CLOSED, "state after the release");
+
+	// rx(x); timer(x); rx(x, ESTABLISHED): the release comes after the write
+	stt.rxIn.write(stateQuery(0x50));
+	stt.run();
+	stt.rxOut.read();
+	stt.timerIn.write(0x50);
+	stt.run();
+	stt.rxIn.write(stateQuery(0x50, ESTABLISHED, 1));
+	stt.drain();
+	CHECK(!stt.slupOut.empty() && (stt.slupOut.read() == 0x50), "release of the RX session");
+	CHECK(readState(stt, 0x50) == CLOSED, "release is not lost");
+
+	// rx(x, CLOSED) releases the session
+	stt.rxIn.write(stateQuery(0x60));
+	stt.run();
+	stt.rxOut.read();
+	stt.rxIn.write(stateQuery(0x60, CLOSED, 1));
+	stt.timerIn.write(0x61);
+	stt.drain();
+	CHECK(!stt.slupOut.empty() && (stt.slupOut.read() == 0x60), "close by the RX engine");
+	CHECK(!stt.slupOut.empty() && (stt.slupOut.read() == 0x61), "release in the cycle of a close");
+
+	std::cout << "directed tests: " << (errors ? "FAILED" : "passed") << std::endl;
+	return errors;
+}
 
-	/*
-	 * Test 2: rx(x, ESTA); rx(y, ESTA); timer(x), time(y)
-	 */
-	//ap_uint<16> id = rand() % 100;
-	count = 0;
-	id = 0x6f;
-	ap_uint<16> id2 = 0x3a;
-	outputFile << "Test 2" << std::endl;
-	outputFile << "ID: " << id << " ID2: " << id2 << std::endl;
-	while (count < 20)
-	{
-		switch (count)
-		{
-		case 1:
-			rxIn.write(stateQuery(id, ESTABLISHED, 1));
-			break;
-		case 2:
-			rxIn.write(stateQuery(id2, ESTABLISHED, 1));
-			break;
-		case 3:
-			timerIn.write(id2);
-			break;
-		case 4:
-			timerIn.write(id);
-			break;
-		case 5:
-			timerIn.write(id);
-			break;
-		default:
-			break;
+/*
+ * Read-modify-write transactions of the RX engine or the TX app
+ */
+struct transactionAgent {
+	enum agentState {IDLE, WAIT_READ, WAIT_WRITE};
+	agentState			state;
+	ap_uint<16>			sessionID;
+	sessionState		value;
+	int					delay;
+	uint64_t			readCycle;
+	uint64_t			transactions;
+	uint64_t			waitCycles;
+
+	transactionAgent() : state(IDLE), delay(0), transactions(0), waitCycles(0) {}
+};
 
-		}
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		emptyFifos(outputFile, rxOut, txAppOut, txApp2Out, slupOut, count);
-		count++;
-	}
-	outputFile << "------------------------------------------------" << std::endl;
-	//BREAK
-	count = 0;
-	while (count < 200)
-	{
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		count++;
-	}
+struct workload {
+	const char*		name;
+	int				sessions;		// accessed sessions, 0 to sessions-1
+	int				rxGap;			// cycles between response and write
+	int				txAppRate;		// percent of cycles a TX app transaction starts
+	int				streamRate;		// percent of cycles with a stream read
+	int				releaseRate;	// releases per 1000 cycles
+	int				cycles;
+};
 
-	/*
-	 * Test 3: rx(x); timer(x), rx(x, ESTABLISHED)
-	 * Pause then: rx(y), txApp(y), rx(y, ESTABLISHED), txApp(y, value)
-	 */
-	//ap_uint<16> id = rand() % 100;
-	count = 0;
-	id = 0x6f;
-	id2 = 0x3a;
-	outputFile << "Test 3" << std::endl;
-	outputFile << "ID: " << id << " ID2: " << id2 << std::endl;
-	while (count < 40)
-	{
-		switch (count)
-		{
-		case 1:
-			rxIn.write(stateQuery(id));
-			break;
-		case 2:
-			timerIn.write(id);
-			break;
-		case 5:
-			rxIn.write(stateQuery(id, ESTABLISHED, 1));
-			break;
-		case 8:
-			rxIn.write(stateQuery(id));
-			break;
-		case 10:
-			rxIn.write(stateQuery(id2));
-			break;
-		case 11:
-			txAppIn.write(stateQuery(id2));
-			break;
-		case 14:
-			rxIn.write(stateQuery(id2, CLOSING, 1));
-			break;
-		case 15:
-			txAppIn.write(stateQuery(id2, SYN_SENT, 1));
-			break;
-		case 19:
-			txApp2In.write(id2);
-			break;
-		default:
-			break;
+struct workloadResult {
+	uint64_t		rxTransactions;
+	uint64_t		txAppTransactions;
+	uint64_t		streamReads;
+	uint64_t		streamLatency;
+	uint64_t		releases;
+	uint64_t		releaseLatency;
+	uint64_t		maxReleaseLatency;
+	int				errors;
+};
 
+/*
+ * Step of a transaction agent. On the read response it checks that nobody else holds
+ * the session and that the state is the last one written or released (no lost update).
+ */
+int stepAgent(transactionAgent& agent, const char* name, int gap, bool start, int sessions, uint64_t cycle,
+				stream<stateQuery>& request, stream<sessionState>& response,
+				std::vector<sessionState>& model, std::vector<int>& holder, int agentID)
+{
+	int errors = 0;
+
+	switch (agent.state) {
+	case transactionAgent::IDLE:
+		if (start) {
+			agent.sessionID = rand() % sessions;
+			request.write(stateQuery(agent.sessionID));
+			agent.readCycle = cycle;
+			agent.state = transactionAgent::WAIT_READ;
 		}
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		emptyFifos(outputFile, rxOut, txAppOut, txApp2Out, slupOut, count);
-		count++;
-	}
-	outputFile << "------------------------------------------------" << std::endl;
-	//BREAK
-	count = 0;
-	while (count < 200)
-	{
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		count++;
-	}
-
-
-	/*
-	 * Test 4: txApp(x); rx(x), txApp(x, SYN_SENT), rx(x, ESTABLISHED), txApp2(x)
-	 */
-	//ap_uint<16> id = rand() % 100;
-	count = 0;
-	id = 0x7f3;
-	outputFile << "Test 4" << std::endl;
-	outputFile << "ID: " << id << std::endl;
-	while (count < 40)
-	{
-		switch (count)
-		{
-		case 1:
-			txAppIn.write(stateQuery(id));
-			break;
-		case 2:
-			rxIn.write(stateQuery(id));
-			break;
-		case 5:
-			txAppIn.write(stateQuery(id, SYN_SENT, 1));
-			break;
-		case 7:
-			rxIn.write(stateQuery(id, ESTABLISHED, 1));
-			break;
-		case 19:
-			txApp2In.write(id);
-			break;
-		default:
-			break;
-
+		break;
+	case transactionAgent::WAIT_READ:
+		if (!response.empty()) {
+			response.read(agent.value);
+			if (holder[agent.sessionID] != -1) {
+				std::cout << "ERROR " << name << " got session " << agent.sessionID << " held by agent " << holder[agent.sessionID] << std::endl;
+				errors++;
+			}
+			if (agent.value != model[agent.sessionID]) {
+				std::cout << "ERROR " << name << " read " << agent.value << " from session " << agent.sessionID;
+				std::cout << " instead of " << model[agent.sessionID] << std::endl;
+				errors++;
+			}
+			holder[agent.sessionID] = agentID;
+			agent.waitCycles += cycle - agent.readCycle;
+			agent.delay = gap;
+			agent.state = transactionAgent::WAIT_WRITE;
 		}
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		emptyFifos(outputFile, rxOut, txAppOut, txApp2Out, slupOut, count);
-		count++;
-	}
-	outputFile << "------------------------------------------------" << std::endl;
-	//BREAK
-	count = 0;
-	while (count < 200)
-	{
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		count++;
-	}
-
-	/*
-	 * Test 5: rxEng(x, ESTABLISED), timer(x), rxEng(x)
-	 */
-	//ap_uint<16> id = rand() % 100;
-	count = 0;
-	id = 0x783;
-	outputFile << "Test 5" << std::endl;
-	outputFile << "ID: " << id << std::endl;
-	while (count < 40)
-	{
-		switch (count)
-		{
-		case 1:
-			rxIn.write(stateQuery(id, ESTABLISHED, 1));
-			break;
-		case 5:
-			timerIn.write(id);
-			break;
-		case 6:
-			rxIn.write(stateQuery(id));
-			break;
-		default:
-			break;
-
+		break;
+	case transactionAgent::WAIT_WRITE:
+		if (agent.delay-- == 0) {
+			model[agent.sessionID] = nextState(agent.value);
+			holder[agent.sessionID] = -1;
+			request.write(stateQuery(agent.sessionID, model[agent.sessionID], 1));
+			agent.transactions++;
+			agent.state = transactionAgent::IDLE;
 		}
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		emptyFifos(outputFile, rxOut, txAppOut, txApp2Out, slupOut, count);
-		count++;
+		break;
 	}
-
-	return 0;
+	return errors;
 }
 
-/*int main()
+workloadResult runWorkload(stateTableIf& stt, const workload& wl, bool randomGap)
 {
-	stream<stateQuery> rxIn;
-	stream<sessionState> rxOut;
-	stream<stateQuery> txAppIn;
-	stream<sessionState> txAppOut;
-	stream<stateQuery> txApp2In;
-	stream<sessionState> txApp2Out;
-	stream<ap_uint<16> > timerIn;
-	stream<ap_uint<16> > slupOut;
-
-	stateQuery inData;
-	sessionState outData;
-
-	std::ifstream inputFile;
-	std::ofstream outputFile;
-
-	inputFile.open("/home/dasidler/toe/hls/toe/state_table/in.dat");
-	if (!inputFile)
-	{
-		std::cout << "Error: could not open test input file." << std::endl;
-		return -1;
-	}
-	outputFile.open("/home/dasidler/toe/hls/toe/state_table/out.dat");
-	if (!outputFile)
-	{
-		std::cout << "Error: could not open test output file." << std::endl;
+	workloadResult				result = {0, 0, 0, 0, 0, 0, 0, 0};
+	std::vector<sessionState>	model(MAX_SESSIONS);
+	std::vector<int>			holder(MAX_SESSIONS, -1);
+	std::vector<int>			releasesAsked(MAX_SESSIONS, 0);
+	std::vector<int>			releasesDone(MAX_SESSIONS, 0);
+	std::deque<uint64_t>		streamIssue;
+	std::deque<std::pair<ap_uint<16>, uint64_t> >	releaseIssue;
+	transactionAgent			rx;
+	transactionAgent			txApp;
+	uint64_t					cycle = 0;
+
+	// Known state to start from
+	for (int i = 0; i < MAX_SESSIONS; i++) {
+		stt.rxIn.write(stateQuery(i, ESTABLISHED, 1));
+		model[i] = ESTABLISHED;
 	}
+	stt.drain();
 
+	for (cycle = 0; cycle < (uint64_t) wl.cycles + 200; cycle++) {
+		bool running = (cycle < (uint64_t) wl.cycles);
+		int gap = randomGap ? (rand() % 4) : wl.rxGap;
 
+		if (running && ((rand() % 100) < wl.streamRate)) {
+			stt.txApp2In.write(rand() % wl.sessions);
+			streamIssue.push_back(cycle);
+		}
+		if (running && ((rand() % 1000) < wl.releaseRate)) {
+			ap_uint<16> id = rand() % wl.sessions;
+			stt.timerIn.write(id);
+			releasesAsked[id]++;
+			releaseIssue.push_back(std::make_pair(id, cycle));
+		}
 
+		stt.run();
 
-	std::string fifoTemp;
-	int sessionIDTemp;
-	char opTemp;
-	int valueTemp;
-	int exp_valueTemp;
-	sessionState response;
-	int errCount = 0;
-
-	std::vector<readVerify> reads;
-
-	int count = 0;
-	while (count < 500)
-	{
-		if ((count % 10) == 0)
-		{
-			if (inputFile >> fifoTemp >> sessionIDTemp >> opTemp >> valueTemp >> exp_valueTemp)
-			{
-				inData.sessionID = sessionIDTemp;
-				inData.state = (sessionState)valueTemp;
-				inData.write = (opTemp == 'W');
-				if (fifoTemp == "TX")
-				{
-					txAppIn.write(inData);
-					if (opTemp == 'R')
-					{
-						reads.push_back( (readVerify){sessionIDTemp, fifoTemp[0], exp_valueTemp});
-					}
-				}
-				else // RX
-				{
-					rxIn.write(inData);
-					if (opTemp == 'R')
-					{
-						reads.push_back((readVerify) {sessionIDTemp, fifoTemp[0], exp_valueTemp});
-					}
+		// Releases first, a read answered in the same cycle was granted after them
+		while (!stt.slupOut.empty()) {
+			ap_uint<16> id = stt.slupOut.read();
+			if (holder[id] != -1) {
+				std::cout << "ERROR session " << id << " released while held by agent " << holder[id] << std::endl;
+				result.errors++;
+			}
+			model[id] = CLOSED;
+			releasesDone[id]++;
+			for (std::deque<std::pair<ap_uint<16>, uint64_t> >::iterator it = releaseIssue.begin(); it != releaseIssue.end(); it++) {
+				if (it->first == id) {
+					uint64_t latency = cycle - it->second;
+					result.releaseLatency += latency;
+					result.maxReleaseLatency = (latency > result.maxReleaseLatency) ? latency : result.maxReleaseLatency;
+					releaseIssue.erase(it);
+					break;
 				}
 			}
+			result.releases++;
 		}
-		state_table(rxIn, txAppIn, txApp2In, timerIn, rxOut, txAppOut, txApp2Out, slupOut);
-		count++;
+		while (!stt.txApp2Out.empty()) {
+			stt.txApp2Out.read();
+			result.streamLatency += cycle - streamIssue.front();
+			streamIssue.pop_front();
+			result.streamReads++;
+		}
+		result.errors += stepAgent(rx, "RX engine", gap, running, wl.sessions, cycle,
+									stt.rxIn, stt.rxOut, model, holder, 0);
+		result.errors += stepAgent(txApp, "TX app", gap, running && ((rand() % 100) < wl.txAppRate), wl.sessions, cycle,
+									stt.txAppIn, stt.txAppOut, model, holder, 1);
 	}
 
-	std::vector<readVerify>::const_iterator it;
-	it = reads.begin();
-	bool readData = false;
-	while (it != reads.end())
-	{
-		readData = false;
-		if (it->fifo == 'T')
-		{
-			if (!txAppOut.empty())
-			{
-				txAppOut.read(response);
-				readData = true;
-			}
+	for (int i = 0; i < MAX_SESSIONS; i++) {
+		if (releasesAsked[i] != releasesDone[i]) {
+			std::cout << "ERROR session " << i << " " << releasesAsked[i] << " releases asked, " << releasesDone[i] << " done" << std::endl;
+			result.errors++;
 		}
-		else
-		{
-			if (!rxOut.empty())
-			{
-				rxOut.read(response);
-				readData = true;
-			}
-		}
-
-		if (readData)
-		{
-			if (((int)response) != it->exp)
-			{
-				outputFile << "Error at ID " << it->id << " on fifo ";
-				outputFile << it->fifo << " response value was " << response << " instead of " << it->exp << std::endl;
-				errCount ++;
-			}
-			else
-			{
-				outputFile << "Success at ID " << it->id << " on fifo ";
-				outputFile << it->fifo << " response value was " << response << " instead of " << it->exp << std::endl;
-			}
-			it++;
+		sessionState state = readState(stt, i);
+		if (state != model[i]) {
+			std::cout << "ERROR session " << i << " ends in " << state << " instead of " << model[i] << std::endl;
+			result.errors++;
 		}
 	}
-
-	if (errCount == 0)
-	{
-		outputFile << "No errors coccured." << std::endl;
+	if ((rx.state != transactionAgent::IDLE) || (txApp.state != transactionAgent::IDLE) || !streamIssue.empty()) {
+		std::cout << "ERROR requests not answered" << std::endl;
+		result.errors++;
 	}
-	else
-	{
-		outputFile << errCount << " errors coccured." << std::endl;
+	result.rxTransactions = rx.transactions;
+	result.txAppTransactions = txApp.transactions;
+	return result;
+}
+
+int main()
+{
+	stateTableIf stt;
+	int errors = 0;
+
+	errors += directedTests(stt);
+
+	// No lost update: every agent on the same few sessions, random gaps
+	srand(1);
+	const workload contention = {"contention", 3, 0, 50, 50, 50, 200000};
+	workloadResult result = runWorkload(stt, contention, true);
+	std::cout << "no lost update: " << result.rxTransactions + result.txAppTransactions << " transactions, ";
+	std::cout << result.releases << " releases: " << (result.errors ? "FAILED" : "passed") << std::endl;
+	errors += result.errors;
+
+	// Benchmark: name, sessions, RX gap, TX app %, stream read %, releases per 1000 cycles, cycles
+	const workload workloads[] = {
+		{"spread",		MAX_SESSIONS,	2,	10,	50,	10,		100000},
+		{"stream",		MAX_SESSIONS,	2,	0,	100, 0,		100000},
+		{"hot",			2,				2,	50,	50,	10,		100000},
+		{"releases",	MAX_SESSIONS,	2,	10,	50,	200,	100000},
+	};
+	std::cout << "workload     rx/cycle  txApp/cycle  stream/cycle  stream latency  release latency (max)" << std::endl;
+	for (int i = 0; i < (int) (sizeof(workloads) / sizeof(workloads[0])); i++) {
+		const workload& wl = workloads[i];
+		srand(i + 2);
+		result = runWorkload(stt, wl, false);
+		errors += result.errors;
+		std::cout << std::left << std::setw(12) << wl.name << std::right << std::fixed << std::setprecision(3);
+		std::cout << std::setw(9) << (double) result.rxTransactions / wl.cycles;
+		std::cout << std::setw(13) << (double) result.txAppTransactions / wl.cycles;
+		std::cout << std::setw(14) << (double) result.streamReads / wl.cycles;
+		std::cout << std::setw(16) << (result.streamReads ? (double) result.streamLatency / result.streamReads : 0.0);
+		std::cout << std::setw(16) << (result.releases ? (double) result.releaseLatency / result.releases : 0.0);
+		std::cout << " (" << result.maxReleaseLatency << ")" << std::endl;
 	}
-}*/
+
+	std::cout << (errors ? "FAILED" : "PASSED") << std::endl;
+	return (errors != 0);
+}
@@ -35,23 +35,103 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "statistics.hpp"
 
+/**
+ * @brief      Builds the first word of a snapshot
+ *
+ * @param      number  The snapshot number
+ * @param      cycle   The cycle the snapshot starts
+ */
+axiWord statsHeaderWord(ap_uint<32> number, ap_uint<64> cycle){
+#pragma HLS INLINE
+    axiWord word;
 
+    word.data            = 0;
+    word.data( 31,  0)   = number;
+    word.data( 47, 32)   = MAX_SESSIONS;
+    word.data(127, 64)   = cycle;
+    word.keep            = 0xFFFFFFFFFFFFFFFF;
+    word.last            = 0;
+    return word;
+}
+
+/**
+ * @brief      Builds the word of the global counters of a snapshot
+ *
+ * @param      global  The global counters
+ */
+axiWord statsGlobalWord(statsGlobal global){
+#pragma HLS INLINE
+    axiWord word;
+
+    word.data            = 0;
+    word.data( 63,   0)  = global.rxBytes;
+    word.data(127,  64)  = global.rxPackets;
+    word.data(191, 128)  = global.txBytes;
+    word.data(255, 192)  = global.txPackets;
+    word.data(287, 256)  = global.rxDrops;
+    word.data(319, 288)  = global.txReTx;
+    word.data(351, 320)  = global.rxSyn;
+    word.data(383, 352)  = global.txSyn;
+    word.data(415, 384)  = global.rxRst;
+    word.data(447, 416)  = global.txRst;
+    word.keep            = 0xFFFFFFFFFFFFFFFF;
+    word.last            = 0;
+    return word;
+}
+
+/**
+ * @brief      Builds the word of one session of a snapshot
+ *
+ * @param      id    The session id
+ * @param      rx    The RX counters of the session
+ * @param      tx    The TX counters of the session
+ * @param      rtt   The smoothed RTT of the session
+ */
+axiWord statsSessionWord(ap_uint<16> id, statsRxEntry rx, statsTxEntry tx, ap_uint<32> rtt){
+#pragma HLS INLINE
+    axiWord word;
+
+    word.data            = 0;
+    word.data( 63,   0)  = rx.rxBytes;
+    word.data(127,  64)  = rx.rxPackets;
+    word.data(191, 128)  = tx.txBytes;
+    word.data(255, 192)  = tx.txPackets;
+    word.data(287, 256)  = rx.rxDrops;
+    word.data(319, 288)  = tx.ReTx(31, 0);
+    word.data(351, 320)  = rtt;
+    word.data(463, 448)  = id;
+    word.keep            = 0xFFFFFFFFFFFFFFFF;
+    word.last            = (id == MAX_SESSIONS-1);
+    return word;
+}
 
 /**
  * @brief      This function provides a mechanism to monitorise
  *             the RX and TX path.
  *
- * @param      userID             The user id
- * @param      txBytes            The transmit bytes
- * @param      txPackets          The transmit packets
- * @param      txRetransmissions  The transmit retransmissions
- * @param      rxBytes            The receive bytes
- * @param      rxPackets          The receive packets
- * @param      connectionRTT      The connection rtt
+ *             The RX and TX engines send one update per segment, the RX and TX
+ *             counters of the session and the global counters are updated in the
+ *             same cycle. A SYN or SYN-ACK, not retransmitted, starts the counters
+ *             of a session again. Every other cycle the tables can be read, for the
+ *             AXI4-Lite registers or for the next session of a snapshot, and the
+ *             updates wait. Each table is written by its update and read by the next
+ *             update, the write of the previous cycle is forwarded to the read.
+ *             With LATENCY_HISTOGRAM the smoothed RTT of every session is kept
+ *             as the latency histogram measures it, otherwise it reads 0.
+ *
+ * @param      rxStatsUpd     Updates of the RX engine
+ * @param      txStatsUpd     Updates of the TX engine
+ * @param      statsSnapshot  Snapshots of all sessions, see statistics.hpp
+ * @param      rttStatsUpd    Smoothed RTT of a session, from the latency histogram
+ * @param      stat_regs      The AXI4-Lite registers
  */
 void toeStatistics (
     stream<rxStatsUpdate>&  rxStatsUpd,
     stream<txStatsUpdate>&  txStatsUpd,
+    stream<axiWord>&        statsSnapshot,
+#if (LATENCY_HISTOGRAM)
+    stream<latRttUpdate>&   rttStatsUpd,
+#endif
     statsRegs&              stat_regs){
 #pragma HLS INLINE off
 #pragma HLS pipeline II=1   
@@ -62,90 +142,234 @@ void toeStatistics (
     #pragma HLS RESOURCE variable=stats_tx_table core=RAM_T2P_BRAM
     #pragma HLS DEPENDENCE variable=stats_rx_table inter false
     #pragma HLS DEPENDENCE variable=stats_tx_table inter false
+#if (LATENCY_HISTOGRAM)
+    static ap_uint<32>  stats_rtt_table[MAX_SESSIONS];
+    #pragma HLS RESOURCE variable=stats_rtt_table core=RAM_T2P_BRAM
+    #pragma HLS DEPENDENCE variable=stats_rtt_table inter false
+#endif
+    static statsGlobal  stats_global;
 
     static ap_uint<64>  cycle_counter = 0;
-    bool                readEnable_r = 0;
-    rxStatsUpdate   rxInfo;
-    txStatsUpdate   txInfo;
-    static ap_uint<16> tx_id_r = 0xFFFF;
-    static ap_uint<16> rx_id_r = 0xFFFF;
+    static bool         readEnable_r = false;
+    static bool         readPending = false;
+    static bool         readSlot = false;
+
+    // Writes of the previous cycle
+    static bool         rx_id_valid = false;
+    static ap_uint<16>  rx_id_r;
     static statsRxEntry stats_rx_table_r;
+    static bool         tx_id_valid = false;
+    static ap_uint<16>  tx_id_r;
     static statsTxEntry stats_tx_table_r;
-    statsRxEntry stats_rx_table_a;
-    statsTxEntry stats_tx_table_a;
+#if (LATENCY_HISTOGRAM)
+    static bool         rtt_id_valid = false;
+    static ap_uint<16>  rtt_id_r;
+    static ap_uint<32>  stats_rtt_table_r;
+#endif
+
+    enum snapshotStateType {SNAP_IDLE, SNAP_HEADER, SNAP_GLOBAL, SNAP_SESSIONS};
+    static snapshotStateType snap_state = SNAP_IDLE;
+    static ap_uint<32>  snap_timer = 0;
+    static bool         snap_due = false;
+    static ap_uint<32>  snap_number = 0;
+    static ap_uint<16>  snap_id = 0;
+
+    rxStatsUpdate   rxInfo;
+    txStatsUpdate   txInfo;
+    statsRxEntry    stats_rx_table_a;
+    statsTxEntry    stats_tx_table_a;
+    ap_uint<32>     stats_rtt_table_a = 0;
+    bool            tableRead = false;
+    bool            rxWrite = false;
+    bool            txWrite = false;
+#if (LATENCY_HISTOGRAM)
+    latRttUpdate    rttInfo;
+    bool            rttWrite = false;
+#endif
+    bool            snapSessions = (snap_state == SNAP_SESSIONS);
 
     if (stat_regs.readEnable && !readEnable_r){   // Only update user output with a rising edge
-        stat_regs.txBytes             = stats_tx_table[stat_regs.userID].txBytes; 
-        stat_regs.txPackets           = stats_tx_table[stat_regs.userID].txPackets;
-        stat_regs.txRetransmissions   = stats_tx_table[stat_regs.userID].ReTx;
-        stat_regs.rxBytes             = stats_rx_table[stat_regs.userID].rxBytes;
-        stat_regs.rxPackets           = stats_rx_table[stat_regs.userID].rxPackets;
-        stat_regs.connectionRTT       = 0;
+        readPending = true;
+    }
+
+    if (stat_regs.snapshotInterval == 0){
+        snap_timer = 0;
+        snap_due = false;
+    }
+    else if (snap_timer >= stat_regs.snapshotInterval - 1){
+        snap_timer = 0;
+        snap_due = true;
+    }
+    else {
+        snap_timer++;
     }
-    else{
-        if (!rxStatsUpd.empty()){
-            rxStatsUpd.read(rxInfo);
 
-            if (rxInfo.syn || rxInfo.syn_ack){
-                stats_rx_table_a.rxBytes   = 0;
-                stats_rx_table_a.rxPackets = 0;
+    switch (snap_state){
+        case SNAP_IDLE:
+            if (snap_due){
+                snap_due = false;
+                snap_id = 0;
+                snap_state = SNAP_HEADER;
+            }
+            break;
+        case SNAP_HEADER:
+            if (!statsSnapshot.full()){
+                statsSnapshot.write(statsHeaderWord(snap_number, cycle_counter));
+                snap_state = SNAP_GLOBAL;
+            }
+            break;
+        case SNAP_GLOBAL:
+            if (!statsSnapshot.full()){
+                statsSnapshot.write(statsGlobalWord(stats_global));
+                snap_state = SNAP_SESSIONS;
+            }
+            break;
+        case SNAP_SESSIONS:
+            break;
+    }
+
+    // Read slot
+    if (readSlot && (readPending || (snapSessions && !statsSnapshot.full()))){
+        ap_uint<16> id = readPending ? stat_regs.userID : snap_id;
+
+        stats_rx_table_a = stats_rx_table[id];
+        stats_tx_table_a = stats_tx_table[id];
+        if (rx_id_valid && (rx_id_r == id)){
+            stats_rx_table_a = stats_rx_table_r;
+        }
+        if (tx_id_valid && (tx_id_r == id)){
+            stats_tx_table_a = stats_tx_table_r;
+        }
+#if (LATENCY_HISTOGRAM)
+        stats_rtt_table_a = stats_rtt_table[id];
+        if (rtt_id_valid && (rtt_id_r == id)){
+            stats_rtt_table_a = stats_rtt_table_r;
+        }
+#endif
+
+        if (readPending){
+            stat_regs.txBytes             = stats_tx_table_a.txBytes; 
+            stat_regs.txPackets           = stats_tx_table_a.txPackets;
+            stat_regs.txRetransmissions   = stats_tx_table_a.ReTx;
+            stat_regs.rxBytes             = stats_rx_table_a.rxBytes;
+            stat_regs.rxPackets           = stats_rx_table_a.rxPackets;
+            stat_regs.rxDrops             = stats_rx_table_a.rxDrops;
+            stat_regs.connectionRTT       = stats_rtt_table_a;
+            readPending = false;
+        }
+        else {
+            statsSnapshot.write(statsSessionWord(snap_id, stats_rx_table_a, stats_tx_table_a, stats_rtt_table_a));
+            if (snap_id == MAX_SESSIONS-1){
+                snap_number++;
+                snap_state = SNAP_IDLE;
+            }
+            snap_id++;
+        }
+        tableRead = true;
+    }
+    readSlot = !readSlot;
+
+    if (!tableRead && !rxStatsUpd.empty()){
+        rxStatsUpd.read(rxInfo);
+
+        if (rx_id_valid && (rx_id_r == rxInfo.id)){  // If the ID is the same as previous do not read memory
+            stats_rx_table_a = stats_rx_table_r;
+        }
+        else {
+            stats_rx_table_a = stats_rx_table[rxInfo.id];
+        }
+        if (rxInfo.syn || rxInfo.syn_ack){
+            stats_rx_table_a.rxBytes   = 0;
+            stats_rx_table_a.rxPackets = 0;
+            stats_rx_table_a.rxDrops   = 0;
+        }
+        stats_rx_table_a.rxPackets++;
+        if (rxInfo.drop){
+            stats_rx_table_a.rxDrops++;
+        }
+        else {
+            stats_rx_table_a.rxBytes += rxInfo.length;
+        }
+        stats_rx_table[rxInfo.id] = stats_rx_table_a;
+        stats_rx_table_r = stats_rx_table_a;
+        rx_id_r = rxInfo.id;
+        rxWrite = true;
+
+        stats_global.rxPackets++;
+        if (rxInfo.drop){
+            stats_global.rxDrops++;
+        }
+        else {
+            stats_global.rxBytes += rxInfo.length;
+        }
+        if (rxInfo.syn || rxInfo.syn_ack){
+            stats_global.rxSyn++;
+        }
+        if (rxInfo.rst){
+            stats_global.rxRst++;
+        }
+    }
+
+    if (!tableRead && !txStatsUpd.empty()){
+        txStatsUpd.read(txInfo);
+
+        if (txInfo.session){
+            if (tx_id_valid && (tx_id_r == txInfo.id)){  // If the ID is the same as previous do not read memory
+                stats_tx_table_a = stats_tx_table_r;
             }
             else {
-                if (tx_id_r == rxInfo.id){  // If the ID is the same as previous do not read memory
-                    stats_rx_table_a.rxBytes   =stats_rx_table_r.rxBytes + rxInfo.length;
-                    stats_rx_table_a.rxPackets =stats_rx_table_r.rxPackets + 1;
-                }   
-                else {
-                    stats_rx_table_a.rxBytes   = stats_rx_table[rxInfo.id].rxBytes + rxInfo.length;
-                    stats_rx_table_a.rxPackets = stats_rx_table[rxInfo.id].rxPackets++;
-                }
+                stats_tx_table_a = stats_tx_table[txInfo.id];
             }
-            stats_rx_table[rxInfo.id] = stats_rx_table_a;
-            stats_rx_table_r = stats_rx_table_a;
-
-            //std::cout << "Rx statistics " << std::dec <<  std::endl;
-            //std::cout << "id " << rxInfo.id;
-            //std::cout << "\tlength " << rxInfo.length;
-            //std::cout << "\tsyn " << rxInfo.syn;
-            //std::cout << "\tsyn_ack " << rxInfo.syn_ack;
-            //std::cout << "\tfin " << rxInfo.fin <<  std::endl;
-            //
-            rx_id_r = rxInfo.id;
-        }
-        else if (!txStatsUpd.empty()){
-            txStatsUpd.read(txInfo);
-
-            if (txInfo.syn || txInfo.syn_ack){
+            if ((txInfo.syn || txInfo.syn_ack) && !txInfo.reTx){
                 stats_tx_table_a.txBytes   = 0;
                 stats_tx_table_a.txPackets = 0;
-                stats_tx_table_a.ReTx = 0;
-            }
-            else {
-                if (tx_id_r == txInfo.id){  // If the ID is the same as previous do not read memory
-                    stats_tx_table_a.txBytes   =stats_tx_table_r.txBytes + txInfo.length;
-                    stats_tx_table_a.txPackets =stats_tx_table_r.txPackets + 1;
-                    stats_tx_table_a.ReTx      =stats_tx_table_r.ReTx + txInfo.reTx;
-                }   
-                else {
-                    stats_tx_table_a.txBytes   = stats_tx_table[txInfo.id].txBytes + txInfo.length;
-                    stats_tx_table_a.txPackets = stats_tx_table[txInfo.id].txPackets++;
-                    stats_tx_table_a.ReTx      = stats_tx_table[txInfo.id].ReTx + txInfo.reTx;
-                }
+                stats_tx_table_a.ReTx      = 0;
             }
+            stats_tx_table_a.txBytes   += txInfo.length;
+            stats_tx_table_a.txPackets++;
+            stats_tx_table_a.ReTx      += txInfo.reTx;
             stats_tx_table[txInfo.id] = stats_tx_table_a;
             stats_tx_table_r = stats_tx_table_a;
-
-            //std::cout << "Tx statistics " << std::dec <<  std::endl;
-            //std::cout << "id " << txInfo.id;
-            //std::cout << "\tlength " << txInfo.length;
-            //std::cout << "\tsyn " << txInfo.syn;
-            //std::cout << "\tsyn_ack " << txInfo.syn_ack;
-            //std::cout << "\tfin " << txInfo.fin;
-            //std::cout << "\treTx " << txInfo.reTx <<  std::endl;
             tx_id_r = txInfo.id;
+            txWrite = true;
+        }
+
+        stats_global.txBytes += txInfo.length;
+        stats_global.txPackets++;
+        stats_global.txReTx += txInfo.reTx;
+        if (txInfo.syn || txInfo.syn_ack){
+            stats_global.txSyn++;
+        }
+        if (txInfo.rst){
+            stats_global.txRst++;
         }
-    } 
+    }
+#if (LATENCY_HISTOGRAM)
+    if (!tableRead && !rttStatsUpd.empty()){
+        rttStatsUpd.read(rttInfo);
+        stats_rtt_table[rttInfo.sessionID] = rttInfo.srtt;
+        stats_rtt_table_r = rttInfo.srtt;
+        rtt_id_r = rttInfo.sessionID;
+        rttWrite = true;
+    }
+#endif
+    rx_id_valid = rxWrite;
+    tx_id_valid = txWrite;
+#if (LATENCY_HISTOGRAM)
+    rtt_id_valid = rttWrite;
+#endif
 
+    stat_regs.snapshotCount             = snap_number;
+    stat_regs.globalTxBytes             = stats_global.txBytes;
+    stat_regs.globalTxPackets           = stats_global.txPackets;
+    stat_regs.globalTxRetransmissions   = stats_global.txReTx;
+    stat_regs.globalTxSyn               = stats_global.txSyn;
+    stat_regs.globalTxRst               = stats_global.txRst;
+    stat_regs.globalRxBytes             = stats_global.rxBytes;
+    stat_regs.globalRxPackets           = stats_global.rxPackets;
+    stat_regs.globalRxDrops             = stats_global.rxDrops;
+    stat_regs.globalRxSyn               = stats_global.rxSyn;
+    stat_regs.globalRxRst               = stats_global.rxRst;
 
     readEnable_r = stat_regs.readEnable;
     cycle_counter++;    // Increment cycle counter every cycle
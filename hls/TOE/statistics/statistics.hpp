@@ -41,6 +41,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 struct statsRxEntry {
 	ap_uint<64>		rxBytes;
 	ap_uint<54>		rxPackets;
+	ap_uint<32>		rxDrops;
 };
 
 struct statsTxEntry {
@@ -49,10 +50,41 @@ struct statsTxEntry {
 	ap_uint<54>		ReTx;
 };
 
+struct statsGlobal {
+	ap_uint<64>		rxBytes;
+	ap_uint<54>		rxPackets;
+	ap_uint<32>		rxDrops;
+	ap_uint<32>		rxSyn;
+	ap_uint<32>		rxRst;
+	ap_uint<64>		txBytes;
+	ap_uint<54>		txPackets;
+	ap_uint<32>		txReTx;
+	ap_uint<32>		txSyn;
+	ap_uint<32>		txRst;
+};
+
+/**
+ * A snapshot is a header word, a word of global counters and one word per session, the
+ * counters sit in 64 bit lanes:
+ *   header   lane 0 [31:0] snapshot number, [47:32] number of session words, lane 1 cycle
+ *   global   lane 0 rxBytes, 1 rxPackets, 2 txBytes, 3 txPackets, 4 rxDrops | txReTx << 32,
+ *            5 rxSyn | txSyn << 32, 6 rxRst | txRst << 32
+ *   session  lane 0 rxBytes, 1 rxPackets, 2 txBytes, 3 txPackets, 4 rxDrops | ReTx << 32,
+ *            5 [31:0] smoothed RTT in cycles, 7 [15:0] session ID
+ */
+static const uint16_t STATS_SNAPSHOT_WORDS = MAX_SESSIONS + 2;
+
+axiWord statsHeaderWord(ap_uint<32> number, ap_uint<64> cycle);
+axiWord statsGlobalWord(statsGlobal global);
+axiWord statsSessionWord(ap_uint<16> id, statsRxEntry rx, statsTxEntry tx, ap_uint<32> rtt);
 
 void toeStatistics (
     stream<rxStatsUpdate>&  rxStatsUpd,
     stream<txStatsUpdate>&  txStatsUpd,
+    stream<axiWord>&        statsSnapshot,
+#if (LATENCY_HISTOGRAM)
+    stream<latRttUpdate>&   rttStatsUpd,
+#endif
     statsRegs&              stat_regs);
 
 #endif
\ No newline at end of file
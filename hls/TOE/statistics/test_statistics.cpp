@@ -0,0 +1,405 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "statistics.hpp"
+#include "../testbench/pcap2stream.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+
+using namespace hls;
+
+/*
+ * Replays the TCP segments of pcap files as the updates the RX and TX engines send for them,
+ * the segments to the TOE address are received and the ones from it are sent. Every connection
+ * of the files is a session, the capture is replayed several times on other sessions. Every
+ * fifth received segment with payload is dropped, a sent segment that does not go past the
+ * highest sequence number of its connection is a retransmission. The counters read through
+ * AXI4-Lite and the snapshots have to match a model of the replay.
+ */
+
+static const ap_uint<32> TOE_IP_ADDRESS = 0xC0A80005;		// 192.168.0.5
+static const int REPLAY_ROUNDS = 40;
+static const int STATS_FIFO_DEPTH = 8;
+
+struct segment {
+	int			flow;
+	bool		rx;
+	bool		syn;
+	bool		ack;
+	bool		fin;
+	bool		rst;
+	ap_uint<32>	seqNumb;
+	ap_uint<16>	length;
+};
+
+struct sessionCounters {
+	uint64_t	rxBytes;
+	uint64_t	rxPackets;
+	uint64_t	rxDrops;
+	uint64_t	txBytes;
+	uint64_t	txPackets;
+	uint64_t	reTx;
+	sessionCounters() : rxBytes(0), rxPackets(0), rxDrops(0), txBytes(0), txPackets(0), reTx(0) {}
+};
+
+struct globalCounters {
+	uint64_t	rxBytes, rxPackets, rxDrops, rxSyn, rxRst;
+	uint64_t	txBytes, txPackets, txReTx, txSyn, txRst;
+	globalCounters() : rxBytes(0), rxPackets(0), rxDrops(0), rxSyn(0), rxRst(0),
+						txBytes(0), txPackets(0), txReTx(0), txSyn(0), txRst(0) {}
+};
+
+#define CHECK(cond, msg) if (!(cond)) { std::cout << "ERROR " << msg << std::endl; errors++; }
+
+/*
+ * Reads the IPv4/TCP packets of a pcap file without Ethernet header
+ */
+void loadPcap(char* file, std::map<uint64_t, int>& flows, std::vector<segment>& segments)
+{
+	stream<axiWord> packets("packets");
+	axiWord word;
+	std::vector<uint8_t> bytes;
+
+	pcap2stream(file, false, packets);
+	while (!packets.empty()) {
+		packets.read(word);
+		for (int i = 0; i < ETH_INTERFACE_WIDTH/8; i++) {
+			if (word.keep.bit(i)) {
+				bytes.push_back(word.data(8*i+7, 8*i));
+			}
+		}
+		if (!word.last) {
+			continue;
+		}
+		if (((bytes[0] >> 4) == 4) && (bytes[9] == 6)) {
+			int ihl = (bytes[0] & 0xF) * 4;
+			int totalLength = (bytes[2] << 8) | bytes[3];
+			uint32_t src = (bytes[12] << 24) | (bytes[13] << 16) | (bytes[14] << 8) | bytes[15];
+			uint32_t dst = (bytes[16] << 24) | (bytes[17] << 16) | (bytes[18] << 8) | bytes[19];
+			uint8_t* tcp = &bytes[ihl];
+			uint16_t srcPort = (tcp[0] << 8) | tcp[1];
+			uint16_t dstPort = (tcp[2] << 8) | tcp[3];
+			segment seg;
+
+			seg.rx = (dst == TOE_IP_ADDRESS);
+			if (seg.rx || (src == TOE_IP_ADDRESS)) {
+				// Connection of the TOE port with the remote address and port
+				uint64_t key = seg.rx ? ((uint64_t(src) << 32) | (uint64_t(srcPort) << 16) | dstPort)
+										: ((uint64_t(dst) << 32) | (uint64_t(dstPort) << 16) | srcPort);
+				if (flows.find(key) == flows.end()) {
+					int id = flows.size();
+					flows[key] = id;
+				}
+				seg.flow 	= flows[key];
+				seg.seqNumb = (tcp[4] << 24) | (tcp[5] << 16) | (tcp[6] << 8) | tcp[7];
+				seg.length 	= totalLength - ihl - (tcp[12] >> 4) * 4;
+				seg.fin 	= tcp[13] & 0x01;
+				seg.syn 	= tcp[13] & 0x02;
+				seg.rst 	= tcp[13] & 0x04;
+				seg.ack 	= tcp[13] & 0x10;
+				segments.push_back(seg);
+			}
+		}
+		bytes.clear();
+	}
+}
+
+struct statsIf {
+	stream<rxStatsUpdate>	rxIn;
+	stream<txStatsUpdate>	txIn;
+	stream<axiWord>			snapshotOut;
+#if (LATENCY_HISTOGRAM)
+	stream<latRttUpdate>	rttIn;
+#endif
+	statsRegs				regs;
+	uint64_t				cycle;
+	// Snapshot checker
+	int						word;
+	uint32_t				snapshots;
+	std::vector<axiWord>	current;
+	std::vector<axiWord>	last;
+	int						errors;
+
+	statsIf() : cycle(0), word(0), snapshots(0), errors(0) {
+		regs.readEnable = false;
+		regs.userID = 0;
+		regs.snapshotInterval = 0;
+	}
+	void run() {
+#if (LATENCY_HISTOGRAM)
+		toeStatistics(rxIn, txIn, snapshotOut, rttIn, regs);
+#else
+		toeStatistics(rxIn, txIn, snapshotOut, regs);
+#endif
+		while (!snapshotOut.empty()) {
+			axiWord w = snapshotOut.read();
+			if (word == 0) {
+				CHECK(w.data(31, 0) == snapshots, "snapshot " << w.data(31, 0) << " instead of " << snapshots);
+				CHECK(w.data(47, 32) == MAX_SESSIONS, "snapshot of " << w.data(47, 32) << " sessions");
+			}
+			else if (word >= 2) {
+				CHECK(w.data(463, 448).to_int() == word - 2, "snapshot word of session " << w.data(463, 448) << " instead of " << word - 2);
+			}
+			CHECK(w.last == (word == STATS_SNAPSHOT_WORDS - 1), "last of snapshot word " << word);
+			current.push_back(w);
+			if (++word == STATS_SNAPSHOT_WORDS) {
+				last = current;
+				current.clear();
+				word = 0;
+				snapshots++;
+			}
+		}
+		cycle++;
+	}
+	void run(int cycles) {
+		for (int i = 0; i < cycles; i++) {
+			run();
+		}
+	}
+};
+
+int checkSession(ap_uint<16> id, const sessionCounters& c, axiWord w)
+{
+	int errors = 0;
+	CHECK((w.data(63, 0) == c.rxBytes) && (w.data(127, 64) == c.rxPackets) && (w.data(287, 256) == c.rxDrops),
+			"snapshot RX of session " << id << ": " << w.data(63, 0) << " bytes " << w.data(127, 64) << " packets " << w.data(287, 256) << " drops, expected "
+			<< c.rxBytes << " " << c.rxPackets << " " << c.rxDrops);
+	CHECK((w.data(191, 128) == c.txBytes) && (w.data(255, 192) == c.txPackets) && (w.data(319, 288) == c.reTx),
+			"snapshot TX of session " << id << ": " << w.data(191, 128) << " bytes " << w.data(255, 192) << " packets " << w.data(319, 288) << " retransmissions, expected "
+			<< c.txBytes << " " << c.txPackets << " " << c.reTx);
+	return errors;
+}
+
+int checkGlobal(const globalCounters& g, axiWord w)
+{
+	int errors = 0;
+	CHECK((w.data(63, 0) == g.rxBytes) && (w.data(127, 64) == g.rxPackets) && (w.data(287, 256) == g.rxDrops)
+			&& (w.data(351, 320) == g.rxSyn) && (w.data(415, 384) == g.rxRst), "snapshot RX global counters");
+	CHECK((w.data(191, 128) == g.txBytes) && (w.data(255, 192) == g.txPackets) && (w.data(319, 288) == g.txReTx)
+			&& (w.data(383, 352) == g.txSyn) && (w.data(447, 416) == g.txRst), "snapshot TX global counters");
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	std::map<uint64_t, int> flows;
+	std::vector<segment> segments;
+	std::deque<rxStatsUpdate> rxUpdates;
+	std::deque<txStatsUpdate> txUpdates;
+	sessionCounters sessions[MAX_SESSIONS];
+	globalCounters global;
+	statsIf stats;
+	int errors = 0;
+
+	if (argc < 2) {
+		std::cerr << "[ERROR] missing arguments " __FILE__ << " <INPUT_PCAP_FILE> [<INPUT_PCAP_FILE> ...]" << std::endl;
+		return -1;
+	}
+	for (int i = 1; i < argc; i++) {
+		loadPcap(argv[i], flows, segments);
+	}
+	std::cout << "Replaying " << segments.size() << " segments of " << flows.size() << " connections " << REPLAY_ROUNDS << " times" << std::endl;
+
+	// Updates of the RX and TX engines, and the model
+	int dataSegments = 0;
+	for (int round = 0; round < REPLAY_ROUNDS; round++) {
+		std::vector<uint64_t> highestSeq(flows.size(), 0);
+		std::vector<bool> synSent(flows.size(), false);
+		std::vector<ap_uint<32> > synSeq(flows.size());
+
+		for (unsigned i = 0; i < segments.size(); i++) {
+			const segment& seg = segments[i];
+			ap_uint<16> id = (round * flows.size() + seg.flow) % MAX_SESSIONS;
+			sessionCounters& s = sessions[id];
+			if (seg.rx) {
+				bool drop = (seg.length != 0) && ((++dataSegments % 5) == 0);
+				rxUpdates.push_back(rxStatsUpdate(id, seg.length, seg.syn && !seg.ack, seg.syn && seg.ack, seg.fin, seg.rst, drop));
+				if (seg.syn) {
+					s.rxBytes = s.rxPackets = s.rxDrops = 0;
+					global.rxSyn++;
+				}
+				s.rxPackets++;
+				global.rxPackets++;
+				if (drop) {
+					s.rxDrops++;
+					global.rxDrops++;
+				}
+				else {
+					s.rxBytes += seg.length;
+					global.rxBytes += seg.length;
+				}
+				global.rxRst += seg.rst;
+			}
+			else {
+				bool reTx;
+				if (seg.syn) {
+					reTx = synSent[seg.flow] && (synSeq[seg.flow] == seg.seqNumb);
+					synSent[seg.flow] = true;
+					synSeq[seg.flow] = seg.seqNumb;
+				}
+				else {
+					reTx = (seg.length != 0) && (highestSeq[seg.flow] != 0) && (uint64_t(seg.seqNumb) + seg.length <= highestSeq[seg.flow]);
+					if (seg.length != 0) {
+						highestSeq[seg.flow] = std::max<uint64_t>(highestSeq[seg.flow], uint64_t(seg.seqNumb) + seg.length);
+					}
+				}
+				txStatsUpdate upd(id, seg.syn ? 0 : seg.length.to_uint(), seg.syn && !seg.ack, seg.syn && seg.ack, seg.fin, reTx);
+				upd.rst = seg.rst;
+				txUpdates.push_back(upd);
+				if (seg.syn && !reTx) {
+					s.txBytes = s.txPackets = s.reTx = 0;
+				}
+				global.txSyn += seg.syn;
+				s.txPackets++;
+				s.txBytes += upd.length;
+				s.reTx += reTx;
+				global.txPackets++;
+				global.txBytes += upd.length;
+				global.txReTx += reTx;
+				global.txRst += seg.rst;
+			}
+		}
+	}
+	// A RST without session only counts globally
+	txStatsUpdate rst(0);
+	rst.rst = true;
+	rst.session = false;
+	txUpdates.push_back(rst);
+	global.txPackets++;
+	global.txRst++;
+
+	// Replay at random pace with snapshots on
+	uint64_t updates = rxUpdates.size() + txUpdates.size();
+	stats.regs.snapshotInterval = 300;
+	srand(7);
+	while (!rxUpdates.empty() || !txUpdates.empty() || !stats.rxIn.empty() || !stats.txIn.empty()) {
+		if (!rxUpdates.empty() && (stats.rxIn.size() < STATS_FIFO_DEPTH) && (rand() % 4 != 0)) {
+			stats.rxIn.write(rxUpdates.front());
+			rxUpdates.pop_front();
+		}
+		if (!txUpdates.empty() && (stats.txIn.size() < STATS_FIFO_DEPTH) && (rand() % 4 != 0)) {
+			stats.txIn.write(txUpdates.front());
+			txUpdates.pop_front();
+		}
+		stats.run();
+	}
+	uint64_t replayCycles = stats.cycle;
+	uint32_t snapshotsDuringReplay = stats.snapshots;
+
+	// The next complete snapshot holds the end of the replay
+	uint32_t first = stats.snapshots + 1;
+	while ((stats.snapshots <= first) && (stats.cycle < replayCycles + 10 * stats.regs.snapshotInterval)) {
+		stats.run();
+	}
+	CHECK(stats.snapshots > first, "no snapshot after the replay");
+	if (stats.last.size() == STATS_SNAPSHOT_WORDS) {
+		errors += checkGlobal(global, stats.last[1]);
+		for (int i = 0; i < MAX_SESSIONS; i++) {
+			errors += checkSession(i, sessions[i], stats.last[i + 2]);
+		}
+	}
+	CHECK(stats.regs.snapshotCount == stats.snapshots, "snapshot count " << stats.regs.snapshotCount);
+
+	// AXI4-Lite read of every session and the global counters
+	for (int i = 0; i < MAX_SESSIONS; i++) {
+		const sessionCounters& c = sessions[i];
+		stats.regs.userID = i;
+		stats.regs.readEnable = true;
+		stats.run();
+		stats.regs.readEnable = false;
+		stats.run(2);
+		CHECK((stats.regs.rxBytes == c.rxBytes) && (stats.regs.rxPackets == c.rxPackets) && (stats.regs.rxDrops == c.rxDrops)
+				&& (stats.regs.txBytes == c.txBytes) && (stats.regs.txPackets == c.txPackets) && (stats.regs.txRetransmissions == c.reTx),
+				"register read of session " << i);
+	}
+	CHECK((stats.regs.globalRxBytes == global.rxBytes) && (stats.regs.globalRxPackets == global.rxPackets) && (stats.regs.globalRxDrops == global.rxDrops)
+			&& (stats.regs.globalRxSyn == global.rxSyn) && (stats.regs.globalRxRst == global.rxRst), "RX global registers");
+	CHECK((stats.regs.globalTxBytes == global.txBytes) && (stats.regs.globalTxPackets == global.txPackets) && (stats.regs.globalTxRetransmissions == global.txReTx)
+			&& (stats.regs.globalTxSyn == global.txSyn) && (stats.regs.globalTxRst == global.txRst), "TX global registers");
+
+#if (LATENCY_HISTOGRAM)
+	// Smoothed RTTs, written back to back while the next session is read
+	for (int i = 0; i < MAX_SESSIONS; i++) {
+		stats.rttIn.write(latRttUpdate(i, 1000 + i));
+	}
+	stats.run(2);
+	for (int i = 0; i < MAX_SESSIONS; i++) {
+		stats.regs.userID = i;
+		stats.regs.readEnable = true;
+		stats.run();
+		stats.regs.readEnable = false;
+		stats.run(2);
+		CHECK(stats.regs.connectionRTT.to_uint() == 1000U + i, "RTT of session " << i << ": " << stats.regs.connectionRTT);
+	}
+#endif
+
+	// No snapshot once the interval is 0
+	stats.regs.snapshotInterval = 0;
+	stats.run(2 * STATS_SNAPSHOT_WORDS);
+	uint32_t stopped = stats.snapshots;
+	stats.run(2000);
+	CHECK((stats.snapshots == stopped) && (stats.word == 0), "snapshot with interval 0");
+
+	std::cout << "rx: " << global.rxPackets << " segments " << global.rxBytes << " bytes " << global.rxDrops << " drops " << global.rxSyn << " SYN " << global.rxRst << " RST" << std::endl;
+	std::cout << "tx: " << global.txPackets << " segments " << global.txBytes << " bytes " << global.txReTx << " retransmissions " << global.txSyn << " SYN " << global.txRst << " RST" << std::endl;
+	std::cout << updates << " updates in " << replayCycles << " cycles, " << snapshotsDuringReplay << " snapshots" << std::endl;
+
+	// Both engines send an update every cycle while snapshots are taken back to back
+	statsIf load;
+	load.regs.snapshotInterval = 1;
+	load.snapshots = stats.regs.snapshotCount;
+	uint64_t taken = 0;
+	for (int i = 0; i < 10000; i++) {
+		while (load.rxIn.size() < STATS_FIFO_DEPTH) {
+			load.rxIn.write(rxStatsUpdate(i % MAX_SESSIONS, 64));
+		}
+		while (load.txIn.size() < STATS_FIFO_DEPTH) {
+			load.txIn.write(txStatsUpdate(i % MAX_SESSIONS, 64));
+		}
+		size_t before = load.rxIn.size() + load.txIn.size();
+		load.run();
+		taken += before - load.rxIn.size() - load.txIn.size();
+	}
+	errors += load.errors;
+	std::cout << "load: " << (double) taken / load.cycle << " updates per cycle with " << load.snapshots << " snapshots back to back" << std::endl;
+
+	errors += stats.errors;
+	std::cout << (errors ? "FAILED" : "PASSED") << std::endl;
+	return (errors != 0);
+}
@@ -27,86 +27,329 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
 EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx, Inc.
 ************************************************/
 #include "dummy_memory.hpp"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 
-/*dummyMemory::dummyMemory(const dummyMemory& another)
+static const uint64_t 	REGION_BYTES 	= 1ULL << 32;		// every mmCmd.saddr
+static const unsigned 	BUFFERS 		= REGION_BYTES / BUFFER_SIZE;
+static const unsigned 	WORD_BYTES 		= ETH_INTERFACE_WIDTH / 8;
+
+/* keep of the first bytes of a word */
+static ap_uint<ETH_INTERFACE_WIDTH/8> keepOf(unsigned bytes)
+{
+	ap_uint<ETH_INTERFACE_WIDTH/8> 	keep;
+
+	for (unsigned s = 0; s < WORD_BYTES; s += 64) {
+		unsigned 	bits 	= std::min(64U, WORD_BYTES - s);
+		unsigned 	valid 	= (bytes > s) ? std::min(bits, bytes - s) : 0;
+		keep(s + bits - 1, s) = (valid == 64) ? ~0ULL : ((1ULL << valid) - 1);
+	}
+	return keep;
+}
+
+/* Bytes up to the first one without keep */
+static unsigned keepBytes(const ap_uint<ETH_INTERFACE_WIDTH/8>& keep)
 {
+	unsigned 	length = 0;
 
-}*/
+	for (unsigned s = 0; s < WORD_BYTES; s += 64) {
+		unsigned 	bits 	= std::min(64U, WORD_BYTES - s);
+		uint64_t 	segment = keep(s + bits - 1, s).to_uint64();
+		uint64_t 	full 	= (bits == 64) ? ~0ULL : ((1ULL << bits) - 1);
+
+		if (segment != full)
+			return length + __builtin_ctzll(~segment);
+		length += bits;
+	}
+	return length;
+}
+
+dummyMemory::dummyMemory()
+	:used(BUFFERS / 64 + 1, 0), readBase(0), readAddr(0), readLen(0), writeBase(0), writeAddr(0),
+	 timingEnabled(false), active(false), lastWrite(false), penalty(0), credit(0), moved(0)
+{
+	allocate();
+	statistics = memStats();
+}
+
+/* A copy takes the buffers that have been used */
+dummyMemory::dummyMemory(const dummyMemory& other)
+	:region(NULL)
+{
+	*this = other;
+}
+
+dummyMemory& dummyMemory::operator=(const dummyMemory& other)
+{
+	if (this == &other)
+		return *this;
+	if (region != NULL)
+		munmap(region, REGION_BYTES);
+	allocate();
+	for (unsigned b = 0; b < BUFFERS; b++) {
+		if ((other.used[b / 64] >> (b % 64)) & 1)
+			memcpy(region + (uint64_t) b * BUFFER_SIZE, other.region + (uint64_t) b * BUFFER_SIZE, BUFFER_SIZE);
+	}
+	used 			= other.used;
+	readBase 		= other.readBase;
+	readAddr 		= other.readAddr;
+	readLen 		= other.readLen;
+	writeBase 		= other.writeBase;
+	writeAddr 		= other.writeAddr;
+	timingEnabled 	= other.timingEnabled;
+	timing 			= other.timing;
+	statistics 		= other.statistics;
+	requests 		= other.requests;
+	readOut 		= other.readOut;
+	statusOut 		= other.statusOut;
+	rows 			= other.rows;
+	current 		= other.current;
+	active 			= other.active;
+	lastWrite 		= other.lastWrite;
+	penalty 		= other.penalty;
+	credit 			= other.credit;
+	moved 			= other.moved;
+	return *this;
+}
+
+dummyMemory::~dummyMemory()
+{
+	munmap(region, REGION_BYTES);
+}
+
+/* Only the address space is reserved, the pages are zero until they are written */
+void dummyMemory::allocate()
+{
+	void* 	map = mmap(NULL, REGION_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (map == MAP_FAILED) {
+		std::cerr << "ERROR dummyMemory can not reserve " << std::dec << (REGION_BYTES >> 20) << " MB of address space" << std::endl;
+		exit(-1);
+	}
+	region = (uint8_t *) map;
+}
+
+uint8_t* dummyMemory::buffer(uint32_t base)
+{
+	uint32_t 	b = base / BUFFER_SIZE;
+
+	used[b / 64] |= 1ULL << (b % 64);
+	return region + base;
+}
+
+/* offset wraps around at the end of the buffer */
+void dummyMemory::copyIn(uint32_t base, uint32_t offset, const uint8_t* data, unsigned length)
+{
+	uint8_t* 	buf 	= buffer(base);
+	unsigned 	first 	= std::min(length, BUFFER_SIZE - offset);
+
+	memcpy(buf + offset, data, first);
+	memcpy(buf, data + first, length - first);
+}
+
+void dummyMemory::copyOut(uint32_t base, uint32_t offset, uint8_t* data, unsigned length)
+{
+	uint8_t* 	buf 	= buffer(base);
+	unsigned 	first 	= std::min(length, BUFFER_SIZE - offset);
+
+	memcpy(data, buf + offset, first);
+	memcpy(data + first, buf, length - first);
+}
 
 void dummyMemory::setReadCmd(mmCmd cmd)
 {
-//	readAddr = cmd.saddr(7, 0);
-	readAddr = cmd.saddr(WINDOW_BITS-1, 0);
-	readId   = cmd.saddr(31, WINDOW_BITS);
-	uint16_t tempLen = (uint16_t) cmd.bbt(15, 0);
-	readLen = (int) tempLen;
-	//std::cout << readLen << std::endl;
+	uint32_t 	saddr 	= cmd.saddr.to_uint();
+	uint16_t 	tempLen = (uint16_t) cmd.bbt(15, 0);
+
+	readBase = saddr & ~(BUFFER_SIZE - 1);
+	readAddr = saddr & (BUFFER_SIZE - 1);
+	readLen  = (int) tempLen;
 }
 
 void dummyMemory::setWriteCmd(mmCmd cmd)
 {
-//	writeAddr = cmd.saddr(7, 0);
-	writeAddr = cmd.saddr(WINDOW_BITS-1, 0);
-	writeId   = cmd.saddr(31, WINDOW_BITS);
-}
+	uint32_t 	saddr 	= cmd.saddr.to_uint();
 
+	writeBase = saddr & ~(BUFFER_SIZE - 1);
+	writeAddr = saddr & (BUFFER_SIZE - 1);
+}
 
 void dummyMemory::readWord(axiWord& word)
 {
-	readStorageIt = storage.find(readId);
-	if (readStorageIt == storage.end()) {
-		readStorageIt = createBuffer(readId);
-		// check it?
+	uint64_t 	chunks[WORD_BYTES / 8];
+	unsigned 	bytes = std::min(readLen, (int) WORD_BYTES);
+
+	memset(chunks, 0, sizeof(chunks));
+	copyOut(readBase, readAddr, (uint8_t *) chunks, bytes);
+	for (unsigned c = 0; c < WORD_BYTES / 8; c++)
+		word.data(c * 64 + 63, c * 64) = chunks[c];
+	word.keep = keepOf(bytes);
+	readLen -= bytes;
+	readAddr = (readAddr + bytes) & (BUFFER_SIZE - 1);
+	word.last = (readLen == 0);
+}
+
+void dummyMemory::writeWord(axiWord& word)
+{
+	uint64_t 	chunks[WORD_BYTES / 8];
+	unsigned 	bytes = keepBytes(word.keep);
+
+	if (bytes == 0){
+		std::cout << std::endl << std::endl << "ERROR YOU ARE TRYING TO WRITE A NON VALID AXI4-STREAM WORD" << std::endl;
+		std::cout << "DATA: " << std::hex << std::setw(130) << word.data << "\tKEEP: " << std::setw(18) << word.keep << "\tLAST: " << word.last << std::endl << std::endl;
 	}
-	int i = 0;
-	word.data = 0;
-	word.keep = 0;
-	while (readLen > 0 && i < (ETH_INTERFACE_WIDTH/8)) {
-		word.data((i*8)+7, i*8) = (readStorageIt->second)[readAddr];
-		word.keep.bit(i) = 1;
-		readLen--;
-		readAddr++;
-		i++;
+	for (unsigned c = 0; c * 8 < bytes; c++)
+		chunks[c] = word.data(c * 64 + 63, c * 64).to_uint64();
+	copyIn(writeBase, writeAddr, (uint8_t *) chunks, bytes);
+	writeAddr = (writeAddr + bytes) & (BUFFER_SIZE - 1);
+}
+
+/*********************************** Timing ***********************************/
+
+void dummyMemory::setTiming(const memTiming& t)
+{
+	timing 			= t;
+	timingEnabled 	= true;
+	statistics 		= memStats();
+	requests.clear();
+	readOut.clear();
+	statusOut.clear();
+	rows.assign(1 << timing.bankBits, -1);
+	active 			= false;
+	lastWrite 		= false;
+	penalty 		= 0;
+	credit 			= 0;
+}
+
+void dummyMemory::clearTiming()
+{
+	timingEnabled = false;
+}
+
+bool dummyMemory::idle() const
+{
+	return !active && requests.empty() && readOut.empty() && statusOut.empty();
+}
+
+/* Opens the row of address if it is not open, returns true if it had to */
+bool dummyMemory::openRow(uint32_t address)
+{
+	unsigned 	bank 	= (address >> timing.colBits) & ((1 << timing.bankBits) - 1);
+	int64_t 	row 	= address >> (timing.colBits + timing.bankBits);
+
+	if (rows[bank] == row)
+		return false;
+	rows[bank] = row;
+	penalty += timing.rowMissCycles;
+	statistics.rowMisses++;
+	return true;
+}
+
+void dummyMemory::startCommand()
+{
+	current = requests.front();
+	requests.pop_front();
+	active 	= true;
+	penalty = timing.commandCycles;
+	if (statistics.commands != 0 && current.write != lastWrite) {
+		penalty += timing.turnaroundCycles;
+		statistics.turnarounds++;
 	}
-	if (readLen == 0) {
-		word.last = 1;
+	lastWrite = current.write;
+	statistics.commands++;
+	if (current.write) {
+		setWriteCmd(current.cmd);
+		moved = 0;
 	}
 	else {
-		word.last = 0;
+		setReadCmd(current.cmd);
 	}
 }
 
-void dummyMemory::writeWord(axiWord& word)
+/*
+ * The commands are served one at a time in arrival order, a write waits for its data.
+ * Every word costs WORD_BYTES of bandwidth, the credit of the idle cycles is not kept
+ */
+void dummyMemory::step(
+		stream<mmCmd>& 		writeCmd,
+		stream<mmStatus>& 	writeStatus,
+		stream<mmCmd>& 		readCmd,
+		stream<axiWord>& 	writeData,
+		stream<axiWord>& 	readData)
 {
-	writeStorageIt = storage.find(writeId);
-	if (writeStorageIt == storage.end()) {
-		writeStorageIt = createBuffer(writeId);
-		// check it?
+	request 	req;
+	axiWord 	word;
+	uint64_t 	now = ++statistics.cycles;
+
+	if (!readCmd.empty()) {
+		req.write = false;
+		readCmd.read(req.cmd);
+		requests.push_back(req);
 	}
-	if (word.keep.or_reduce() == 0){
-		std::cout << std::endl << std::endl << "ERROR YOU ARE TRYING TO WRITE A NON VALID AXI4-STREAM WORD" << std::endl;
-		std::cout << "DATA: " << std::hex << std::setw(130) << word.data << "\tKEEP: " << std::setw(18) << word.keep << "\tLAST: " << word.last << std::endl << std::endl;
+	if (!writeCmd.empty()) {
+		req.write = true;
+		writeCmd.read(req.cmd);
+		requests.push_back(req);
+	}
+	while (!readOut.empty() && readOut.front().first <= now) {
+		readData.write(readOut.front().second);
+		readOut.pop_front();
+	}
+	while (!statusOut.empty() && statusOut.front().first <= now) {
+		writeStatus.write(statusOut.front().second);
+		statusOut.pop_front();
 	}
 
-	for (int i = 0; i < (ETH_INTERFACE_WIDTH/8); i++) {
-		if (word.keep.bit(i)) {
-			(writeStorageIt->second)[writeAddr] = word.data((i*8)+7, i*8);
-			writeAddr++;
-		}
-		else {
-			break;
+	credit = std::min(credit + timing.bytesPerCycle, WORD_BYTES + timing.bytesPerCycle);
+	if (!active) {
+		if (!requests.empty())
+			startCommand();
+		return;
+	}
+	if (penalty == 0 && credit >= WORD_BYTES && !(current.write && writeData.empty()))
+		openRow(current.write ? (writeBase | writeAddr) : (readBase | readAddr));
+	if (penalty > 0 || credit < WORD_BYTES || (current.write && writeData.empty())) {
+		if (penalty > 0)
+			penalty--;
+		statistics.stallCycles++;
+		return;
+	}
+
+	credit -= WORD_BYTES;
+	if (current.write) {
+		uint32_t 	offset 	= current.cmd.saddr.to_uint() & (BUFFER_SIZE - 1);
+		uint32_t 	length 	= current.cmd.bbt.to_uint();
+		unsigned 	bytes;
+		mmStatus 	status;
+
+		writeData.read(word);
+		bytes = keepBytes(word.keep);
+		writeWord(word);
+		moved += bytes;
+		statistics.writeBytes += bytes;
+		if (word.last) {
+			status.tag 		= current.cmd.tag;
+			status.interr 	= 0;
+			status.decerr 	= (length == 0) || (offset + length > BUFFER_SIZE);
+			status.slverr 	= (moved != length);
+			status.okay 	= !status.decerr && !status.slverr;
+			if (!status.okay)
+				statistics.errors++;
+			statusOut.push_back(std::make_pair(now + timing.writeLatency, status));
+			active = false;
 		}
 	}
-}
+	else {
+		int 	left = readLen;
 
-std::map<ap_uint<WINDOW_BITS>, ap_uint<8>*>::iterator dummyMemory::createBuffer(ap_uint<16> id)
-{
-	ap_uint<8>* array = new ap_uint<8>[BUFFER_SIZE]; // [255] default
-	std::pair<std::map<ap_uint<WINDOW_BITS>, ap_uint<8>*>::iterator, bool> ret;
-	ret = storage.insert(std::make_pair(id, array));
-	if (ret.second)	{
-		return ret.first;
+		readWord(word);
+		statistics.readBytes += left - readLen;
+		readOut.push_back(std::make_pair(now + timing.readLatency, word));
+		if (word.last)
+			active = false;
 	}
-	return storage.end();
 }
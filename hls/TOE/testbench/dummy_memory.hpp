@@ -30,24 +30,111 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 #define MEM_H_
 
 #include "../toe.hpp"
-#include <map>
+#include <deque>
+#include <vector>
 
+/*
+ * Timing of the memory behind a dummyMemory, in cycles of the TOE clock. A command waits
+ * commandCycles, plus turnaroundCycles when it changes between reads and writes, then
+ * moves one word per cycle while the bandwidth allows it. Touching a row of a bank other
+ * than the open one costs rowMissCycles. The banks are interleaved every 2^colBits bytes
+ */
+struct memTiming {
+	unsigned	readLatency;		// from a word read in the array to the word out
+	unsigned	writeLatency;		// from the last word of a write to its status
+	unsigned	commandCycles;		// address phase and controller
+	unsigned	bytesPerCycle;		// peak bandwidth, shared by reads and writes
+	unsigned	bankBits;
+	unsigned	colBits;
+	unsigned	rowMissCycles;		// precharge and activate, tRP + tRCD
+	unsigned	turnaroundCycles;	// read to write or write to read
+};
+
+/* One DDR4-2400 x64 channel, 19.2 GB/s, 8 KB rows in 16 banks */
+static const memTiming DDR4_TIMING = {24, 8, 4, 60, 4, 13, 9, 4};
+/* One HBM2 pseudo channel of the U280, 14.4 GB/s, 1 KB rows in 16 banks */
+static const memTiming HBM_TIMING = {36, 12, 4, 45, 4, 10, 9, 6};
+
+struct memStats {
+	uint64_t	cycles;
+	uint64_t	commands;
+	uint64_t	readBytes;
+	uint64_t	writeBytes;
+	uint64_t	rowMisses;
+	uint64_t	turnarounds;
+	uint64_t	stallCycles;		// a command is active and no word moves
+	uint64_t	errors;				// statuses without okay
+};
+
+/*
+ * Buffers of the TOE in external memory. The 32-bit address space of mmCmd is a flat
+ * region reserved with mmap() and committed by the kernel page by page when it is
+ * touched, the data is copied 64 bits at a time. As in the TOE, the address of a command
+ * wraps around at the end of its BUFFER_SIZE buffer.
+ *
+ * setReadCmd(), readWord(), setWriteCmd() and writeWord() answer at once. With a timing
+ * step() is the data mover in front of the memory, one call per cycle
+ */
 class dummyMemory {
 public:
+	dummyMemory();
+	dummyMemory(const dummyMemory& other);
+	dummyMemory& operator=(const dummyMemory& other);
+	~dummyMemory();
+
 	void setReadCmd(mmCmd cmd);
 	void setWriteCmd(mmCmd cmd);
 	void readWord(axiWord& word);
 	void writeWord(axiWord& word);
+
+	void setTiming(const memTiming& timing);
+	void clearTiming();
+	bool timed() const { return timingEnabled; }
+	/* Same streams and order as simulateRx() and simulateTx() */
+	void step(
+			stream<mmCmd>& 		writeCmd,
+			stream<mmStatus>& 	writeStatus,
+			stream<mmCmd>& 		readCmd,
+			stream<axiWord>& 	writeData,
+			stream<axiWord>& 	readData);
+	/* No command queued or active and nothing in flight */
+	bool idle() const;
+	const memStats& stats() const { return statistics; }
+
 private:
-	std::map<ap_uint<WINDOW_BITS>, ap_uint<8>*>::iterator createBuffer(ap_uint<16> id);
-	ap_uint<WINDOW_BITS> 	readAddr; //<8>
-	ap_uint<16> 			readId;
+	struct request {
+		bool 		write;
+		mmCmd 		cmd;
+	};
+
+	void allocate();
+	uint8_t* buffer(uint32_t base);
+	void copyIn(uint32_t base, uint32_t offset, const uint8_t* data, unsigned length);
+	void copyOut(uint32_t base, uint32_t offset, uint8_t* data, unsigned length);
+	bool openRow(uint32_t address);
+	void startCommand();
+
+	uint8_t* 				region;
+	std::vector<uint64_t> 	used;			// one bit per buffer, the ones a copy has to take
+	uint32_t 				readBase;
+	uint32_t 				readAddr;
 	int 					readLen;
-	ap_uint<WINDOW_BITS> 	writeAddr; //<8>
-	ap_uint<16> 			writeId;
-	//ap_uint<16> writeLen;
-	std::map<ap_uint<WINDOW_BITS>, ap_uint<8>*> storage;
-	std::map<ap_uint<WINDOW_BITS>, ap_uint<8>*>::iterator readStorageIt;
-	std::map<ap_uint<WINDOW_BITS>, ap_uint<8>*>::iterator writeStorageIt;
+	uint32_t 				writeBase;
+	uint32_t 				writeAddr;
+
+	bool 					timingEnabled;
+	memTiming 				timing;
+	memStats 				statistics;
+	std::deque<request> 	requests;
+	std::deque<std::pair<uint64_t, axiWord> > 	readOut;
+	std::deque<std::pair<uint64_t, mmStatus> > 	statusOut;
+	std::vector<int64_t> 	rows;			// open row of every bank, -1 if none
+	request 				current;
+	bool 					active;
+	bool 					lastWrite;
+	unsigned 				penalty;
+	unsigned 				credit;
+	uint32_t 				address;		// next byte of the active command
+	uint32_t 				moved;			// bytes of the active write
 };
 #endif
@@ -34,12 +34,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include "pcap.h"
 #include "pcap2stream.hpp"
-
-stream<axiWord> input_data("Data_Read_from_pcap");
-stream<axiWord> packet_without_ethernet("packet_without_ethernet");
-axiWord transaction;
+#include "pcap_file.hpp"
 
 using namespace std;
 using namespace hls;
@@ -47,63 +45,6 @@ using namespace hls;
 #define DEBUG
 //#define DEBUG1
 
-void pcapPacketHandler (unsigned char *userData,  struct pcap_pkthdr* pkthdr, unsigned char *packet) {
-
-	ap_uint<16> bytes_sent=0, bytes2send,last_trans;
-	ap_uint<ETH_INTERFACE_WIDTH/8> aux_keep;
-	ap_uint<ETH_INTERFACE_WIDTH> data_value;
-	static ap_uint<16> pkt=0;
-
-	for (int h=0 ; h< ETH_INTERFACE_WIDTH/8 ; h++){
-		transaction.keep[h]=1;
-	}
-	transaction.last=0;
-
-	bytes2send = (pkthdr->len);
-#ifdef DEBUG1
-	cout << "Bytes to send " << bytes2send << endl;
-#endif
-	for (int h=0; h < bytes2send ; h+= ETH_INTERFACE_WIDTH/8){
-		bytes_sent += ETH_INTERFACE_WIDTH/8;
-		if (bytes_sent < bytes2send){
-			data_value= *((ap_uint<ETH_INTERFACE_WIDTH> *)packet);
-			packet+=ETH_INTERFACE_WIDTH/8;
-		}
-		else if (bytes_sent < (bytes2send + ETH_INTERFACE_WIDTH/8)){
-			last_trans= ETH_INTERFACE_WIDTH/8 - bytes_sent + bytes2send;
-
-			for (int s=0 ; s< ETH_INTERFACE_WIDTH/8; s++){
-				if (s < last_trans)
-					aux_keep[s]=1;
-				else
-					aux_keep[s]=0;
-			}
-			transaction.last=1;
-			transaction.keep=aux_keep;
-			data_value=0;
-			for (int s=0; s < last_trans*8 ; s+=8){
-				data_value.range(s+7,s)= *((ap_uint<8> *)packet);
-				packet++;
-			}
-		}
-#ifdef CHANGE_ENDIANESS
-		for (int s=0; s< ETH_INTERFACE_WIDTH; s+=8){
-			transaction.data.range(ETH_INTERFACE_WIDTH-1-s,ETH_INTERFACE_WIDTH-s-8)=data_value.range(s+7,s);
-		}
-#else
-		transaction.data = data_value;
-#endif
-#ifdef DEBUG1
-		cout << "Test Data [" << dec << pkt << "] Transaction [" << dec << h/(ETH_INTERFACE_WIDTH/8) << "]";
-		cout	<< "\tComplete Data " << hex << transaction.data << "\t\tkeep " << transaction.keep << "\tlast " << transaction.last << endl;
-		pkt = pkt + transaction.last;
-#endif
-
-		input_data.write(transaction);
-	}
-}
-
-
 void remove_ethernet (
 						stream<axiWord>&			dataIn,
 					  	stream<axiWord>&			dataOut)
@@ -114,7 +55,6 @@ void remove_ethernet (
 	axiWord sendWord = axiWord(0,0,0);;
 
 	static int pkt_count = 0;
-	int wordCount = 0;
 
 	bool first_word = true;
 
@@ -173,50 +113,19 @@ void remove_ethernet (
 }
 
 
-int open_file (
-				char 								*file2load,
-				bool 								ethernet) {
-
-
-	//cout << "File 2 load " << file2load << endl;
-
-	/* Read packets from pcapfile */
-	if(pcap_open (file2load,ethernet)) {
-		cout << "Error opening the input file with name: " << file2load << endl;
-		return -1;
-	}
-	//else
-	//	cout <<"File open correct" << endl << endl;
-
-	if (pcap_loop (0,                  /* Iterate over all the packets */
-	                 pcapPacketHandler,  /* Routine invoked */
-	                 NULL) < 0) {        /* Argument passed to the handler function (the buffer) */
-
-
-	    pcap_close();
-	    cout << "Error opening the input file"<< endl;
-	    return -1;
-  	}
-
-	pcap_close();
-	return 0;
-}
-
-
 void pcap2stream(
 				char 								*file2load, 		// pcapfilename
 				bool 								ethernet,			// 0: No ethernet in the packet, 1: ethernet include
 				stream<axiWord>&					output_data			// output data
 ) {
 
-	axiWord 	currWord;
+	pcapReader 	reader;
 
-	if (open_file(file2load,ethernet)==0){
-		while(!input_data.empty()){
-			input_data.read(currWord);
-			output_data.write(currWord);
-		}
+	if (!reader.open(file2load, ethernet)) {
+		cout << "Error opening the input file with name: " << file2load << endl;
+		return;
 	}
+	while (reader.read(output_data));
 }
 
 /* It returns one complete packet each time is called
@@ -230,33 +139,19 @@ void pcap2stream_step(
 				stream<axiWord>&					output_data			// output data
 	){
 
-	static bool error_opening_file = false;
-	static bool file_open = false;
-
-	stream<axiWord> currWord_Stream("data_to_remove_ethernet");
-
-	axiWord 	currWord;
+	static pcapReader 	reader;
+	static bool 		error_opening_file = false;
+	static bool 		file_open = false;
 
 	if (!file_open) {
 		file_open = true;
-		if (open_file(file2load,ethernet)!=0){
+		if (!reader.open(file2load, ethernet)) {
+			cout << "Error opening the input file with name: " << file2load << endl;
 			error_opening_file = true;
 		}
 	}
 
-
-	if (!error_opening_file) {
-		if (!input_data.empty()){
-			do {
-				input_data.read(currWord);
-				output_data.write(currWord);
-			} while (!currWord.last);
-			end_of_data = false;
-		}
-		else {
-			end_of_data = true;
-		}
-	}
+	end_of_data = error_opening_file || !reader.read(output_data);
 
 }
 
@@ -286,45 +181,30 @@ int stream2pcap(
 				bool 								close_file
 ) {
 
-	static bool file_open = false;
-	static int 	pcap_open_write_return=0;
-
-	axiWord 	currWord;
+	static pcapWriter 	writer;
+	static bool 		file_open = false;
+	static uint64_t 	timestamp;
 
-	static uint8_t packet [65536]={0x4A,0xFD,0x4B,0xE0,0x87,0xBD,0x0,0x0A,0x35,0x02,0x9D,0xE5,0x08,0x00}; // Include the Ethernet header
-	static int pointer = 14;
-	
-	if (ethernet){
-		pointer = 0;
-	}
+	static const uint8_t ethernet_header[14]={0x4A,0xFD,0x4B,0xE0,0x87,0xBD,0x0,0x0A,0x35,0x02,0x9D,0xE5,0x08,0x00}; // Include the Ethernet header
 
 	if (!file_open){
-		pcap_open_write_return = pcap_open_write(file2load,microseconds);
 		file_open = true;
+		if (writer.open(file2load, microseconds ? PCAP_MICROSECONDS : PCAP_NANOSECONDS)) {
+			writer.setPrefix(ethernet_header, ethernet ? 0 : sizeof(ethernet_header));
+		}
+		timestamp = (uint64_t) time(NULL) * 1000000000ULL; 	// every packet has the time of the first one
 	}
 
-	if (pcap_open_write_return !=0){
+	if (!writer.isOpen()){
 		return -1;
 	}
 
 	if (!input_data.empty()){
-		input_data.read(currWord);
-		//cout << "Stream to pcap: " << hex << currWord.data << "\tkeep: " << currWord.keep << "\tlast: " << dec << currWord.last << endl;
-		for (int i =0 ; i<64 ; i++){
-			if (currWord.keep.bit(i)){
-				packet[pointer] = currWord.data(i*8+7,i*8);
-				pointer++;
-			}
-		}
-		if (currWord.last){
-			//call write function
-			pcap_WriteData(&packet[0],pointer);
-			pointer = (ethernet) ? 0 : 14;
-		}
+		writer.write(input_data.read(), timestamp);
 	}
 
 	if (close_file){
-		pcap_close_write();
+		writer.close();
 		file_open = false;
 	}
 
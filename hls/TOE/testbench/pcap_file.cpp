@@ -0,0 +1,610 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "pcap_file.hpp"
+#include "pcap.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#ifdef _WIN32
+#include "mmap.h"
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+static const unsigned 	WORD_BYTES 			= ETH_INTERFACE_WIDTH / 8;
+static const size_t 	PREFETCH_WINDOW 	= 8 << 20;
+static const uint64_t 	NS_PER_SECOND 		= 1000000000ULL;
+
+static const uint32_t 	PCAP_MAGIC_US 		= 0xa1b2c3d4;
+static const uint32_t 	PCAP_MAGIC_NS 		= 0xa1b23c4d;
+static const uint32_t 	PCAPNG_SHB 			= 0x0A0D0D0A;
+static const uint32_t 	PCAPNG_IDB 			= 0x00000001;
+static const uint32_t 	PCAPNG_OPB 			= 0x00000002;
+static const uint32_t 	PCAPNG_SPB 			= 0x00000003;
+static const uint32_t 	PCAPNG_EPB 			= 0x00000006;
+static const uint32_t 	PCAPNG_BYTE_ORDER 	= 0x1A2B3C4D;
+static const uint16_t 	PCAPNG_IF_TSRESOL 	= 9;
+
+unsigned packWords(const uint8_t* data, unsigned length, stream<axiWord>& output)
+{
+	axiWord 	word;
+	uint64_t 	chunks[WORD_BYTES / 8];
+	unsigned 	words = 0;
+
+	for (unsigned offset = 0; offset < length; offset += WORD_BYTES) {
+		unsigned 	bytes = min(WORD_BYTES, length - offset);
+
+		if (bytes < WORD_BYTES)
+			memset(chunks, 0, sizeof(chunks));
+		memcpy(chunks, data + offset, bytes);
+#ifdef CHANGE_ENDIANESS
+		reverse((uint8_t *) chunks, (uint8_t *) chunks + WORD_BYTES);
+#endif
+		for (unsigned c = 0; c < WORD_BYTES / 8; c++)
+			word.data(c * 64 + 63, c * 64) = chunks[c];
+		for (unsigned s = 0; s < WORD_BYTES; s += 64) {
+			unsigned 	bits 	= min(64U, WORD_BYTES - s);
+			unsigned 	valid 	= (bytes > s) ? min(bits, bytes - s) : 0;
+			word.keep(s + bits - 1, s) = (valid == 64) ? ~0ULL : ((1ULL << valid) - 1);
+		}
+		word.last = (offset + bytes == length);
+		output.write(word);
+		words++;
+	}
+	return words;
+}
+
+/* The keep of the interfaces is contiguous from the first byte */
+unsigned unpackWord(const axiWord& word, uint8_t* dst)
+{
+	unsigned 	length = 0;
+
+	for (unsigned s = 0; s < WORD_BYTES; s += 64) {
+		unsigned 	bits 	= min(64U, WORD_BYTES - s);
+		uint64_t 	keep 	= word.keep(s + bits - 1, s).to_uint64();
+		uint64_t 	full 	= (bits == 64) ? ~0ULL : ((1ULL << bits) - 1);
+
+		if (keep != full) {
+			length += __builtin_ctzll(~keep);
+			break;
+		}
+		length += bits;
+	}
+	for (unsigned c = 0; c * 8 < length; c++) {
+		uint64_t 	chunk = word.data(c * 64 + 63, c * 64).to_uint64();
+		memcpy(dst + c * 8, &chunk, min(8U, length - c * 8));
+	}
+	return length;
+}
+
+/************************************** pcapReader **************************************/
+
+pcapReader::pcapReader()
+	: _fd(-1), _map(NULL), _size(0), _offset(0), _start(0), _prefetched(0), _ethernet(true),
+	  _pcapng(false), _swap(false), _headerSwap(false), _packets(0), _end(true), _pending(false), _replayStarted(false),
+	  _firstTimestamp(0), _firstCycle(0) {}
+
+pcapReader::~pcapReader()
+{
+	close();
+}
+
+uint32_t pcapReader::get32(size_t offset) const
+{
+	uint32_t 	value;
+
+	memcpy(&value, _map + offset, sizeof(value));
+	return _swap ? __builtin_bswap32(value) : value;
+}
+
+uint16_t pcapReader::get16(size_t offset) const
+{
+	uint16_t 	value;
+
+	memcpy(&value, _map + offset, sizeof(value));
+	return _swap ? __builtin_bswap16(value) : value;
+}
+
+bool pcapReader::open(const char* path, bool ethernet)
+{
+	struct stat 	st;
+	uint32_t 		magic;
+
+	close();
+	_fd = ::open(path, O_RDONLY);
+	if (_fd < 0 || fstat(_fd, &st) != 0 || st.st_size < 24) {
+		cerr << "ERROR: can not read the capture " << path << endl;
+		close();
+		return false;
+	}
+	_size 	= st.st_size;
+	_map 	= (const uint8_t *) mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (_map == MAP_FAILED) {
+		_map = NULL;
+		perror("ERROR: mmap of the capture");
+		close();
+		return false;
+	}
+#ifndef _WIN32
+	madvise((void *) _map, _size, MADV_SEQUENTIAL);
+#endif
+	_path 		= path;
+	_ethernet 	= ethernet;
+	_interfaces.clear();
+
+	memcpy(&magic, _map, sizeof(magic));
+	_pcapng = (magic == PCAPNG_SHB);
+	if (_pcapng) {
+		// The section header and the interfaces in front of the first packet
+		pcapPacket 	packet;
+
+		_offset = 0;
+		nextPcapng(packet, true);
+		_start = _offset;
+		_headerInterfaces 	= _interfaces;
+		_headerSwap 		= _swap;
+	}
+	else {
+		interface 	iface;
+
+		_swap = (magic == __builtin_bswap32(PCAP_MAGIC_US)) || (magic == __builtin_bswap32(PCAP_MAGIC_NS));
+		magic = get32(0);
+		if (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS) {
+			cerr << "ERROR: " << path << " is not a pcap or pcapng file" << endl;
+			close();
+			return false;
+		}
+		iface.linkType 		= get32(20);
+		iface.snapLength 	= get32(16);
+		iface.mul 			= (magic == PCAP_MAGIC_US) ? 1000 : 1;
+		iface.div 			= 1;
+		_interfaces.push_back(iface);
+		_start = sizeof(pcap_hdr_t);
+	}
+	rewind();
+	return true;
+}
+
+void pcapReader::close()
+{
+	if (_map != NULL)
+		munmap((void *) _map, _size);
+	if (_fd >= 0)
+		::close(_fd);
+	_map 		= NULL;
+	_fd 		= -1;
+	_size 		= 0;
+	_offset 	= 0;
+	_end 		= true;
+	_pending 	= false;
+}
+
+void pcapReader::rewind()
+{
+	_offset 		= _start;
+	_prefetched 	= 0;
+	_packets 		= 0;
+	_end 			= (_map == NULL);
+	_pending 		= false;
+	_replayStarted 	= false;
+	if (_pcapng) {
+		_interfaces 	= _headerInterfaces;
+		_swap 			= _headerSwap;
+	}
+}
+
+/* Asks for the window ahead of the read offset */
+void pcapReader::prefetch()
+{
+#ifndef _WIN32
+	while (_prefetched < _size && _offset + PREFETCH_WINDOW > _prefetched) {
+		madvise((void *) (_map + _prefetched), min(PREFETCH_WINDOW, _size - _prefetched), MADV_WILLNEED);
+		_prefetched += PREFETCH_WINDOW;
+	}
+#endif
+}
+
+bool pcapReader::next(pcapPacket& packet)
+{
+	bool 	found;
+
+	if (_end)
+		return false;
+	prefetch();
+	found = _pcapng ? nextPcapng(packet, false) : nextPcap(packet);
+	if (!found) {
+		_end = true;
+		return false;
+	}
+	if (!_ethernet) {
+		unsigned 	skip = min(14U, packet.length);
+		packet.data 		+= skip;
+		packet.length 		-= skip;
+		packet.origLength 	-= min(14U, packet.origLength);
+	}
+	_packets++;
+	return true;
+}
+
+bool pcapReader::nextPcap(pcapPacket& packet)
+{
+	uint64_t 	seconds;
+	uint64_t 	fraction;
+	uint32_t 	length;
+
+	if (_offset + sizeof(pcaprec_hdr_t) > _size)
+		return false;
+	seconds 	= get32(_offset);
+	fraction 	= get32(_offset + 4);
+	length 		= get32(_offset + 8);
+	if (_offset + sizeof(pcaprec_hdr_t) + length > _size) {
+		cerr << "WARNING: " << _path << " ends in the middle of a packet" << endl;
+		return false;
+	}
+	packet.timestamp 	= seconds * NS_PER_SECOND + fraction * _interfaces[0].mul;
+	packet.length 		= length;
+	packet.origLength 	= get32(_offset + 12);
+	packet.data 		= _map + _offset + sizeof(pcaprec_hdr_t);
+	_offset += sizeof(pcaprec_hdr_t) + length;
+	return true;
+}
+
+/* Interface description block, the link type, the snap length and if_tsresol */
+void pcapReader::readInterface(size_t block, uint32_t blockLength)
+{
+	interface 	iface;
+	size_t 		option 	= block + 16;
+	size_t 		end 	= block + blockLength - 4;
+
+	iface.linkType 		= get16(block + 8);
+	iface.snapLength 	= get32(block + 12);
+	iface.mul 			= 1000;						// microseconds unless told otherwise
+	iface.div 			= 1;
+	while (option + 4 <= end) {
+		uint16_t 	code 	= get16(option);
+		uint16_t 	length 	= get16(option + 2);
+
+		if (code == 0)
+			break;
+		if (code == PCAPNG_IF_TSRESOL && length >= 1) {
+			uint8_t 	resolution 	= _map[option + 4];
+			uint8_t 	exponent 	= resolution & 0x7f;
+
+			iface.mul = 1;
+			iface.div = 1;
+			if (resolution & 0x80) {				// 2^-exponent seconds
+				iface.mul = NS_PER_SECOND;
+				iface.div = (exponent < 64) ? (1ULL << exponent) : 1;
+			}
+			else {									// 10^-exponent seconds
+				for (int e = exponent; e < 9; e++)
+					iface.mul *= 10;
+				for (int e = 9; e < exponent && e < 28; e++)
+					iface.div *= 10;
+			}
+		}
+		option += 4 + ((length + 3) & ~3);
+	}
+	_interfaces.push_back(iface);
+}
+
+bool pcapReader::nextPcapng(pcapPacket& packet, bool header)
+{
+	while (_offset + 12 <= _size) {
+		size_t 		block 	= _offset;
+		uint32_t 	type;
+		uint32_t 	length;
+
+		// The type of the section header reads the same in both byte orders
+		if (get32(block) == PCAPNG_SHB) {
+			uint32_t 	byteOrder;
+			memcpy(&byteOrder, _map + block + 8, sizeof(byteOrder));
+			_swap = (byteOrder != PCAPNG_BYTE_ORDER);
+			_interfaces.clear();					// a new section has its own interfaces
+		}
+		type 	= get32(block);
+		length 	= get32(block + 4);
+		if (length < 12 || block + length > _size) {
+			cerr << "WARNING: " << _path << " ends in the middle of a block" << endl;
+			return false;
+		}
+		if (header && type != PCAPNG_SHB && type != PCAPNG_IDB)
+			return false;
+		_offset += length;
+
+		if (type == PCAPNG_IDB) {
+			readInterface(block, length);
+		}
+		else if (type == PCAPNG_EPB || type == PCAPNG_OPB) {
+			uint32_t 	id 			= (type == PCAPNG_EPB) ? get32(block + 8) : get16(block + 8);
+			uint64_t 	units 		= ((uint64_t) get32(block + 12) << 32) | get32(block + 16);
+			uint32_t 	captured 	= get32(block + 20);
+
+			if (id >= _interfaces.size() || 28 + captured > length) {
+				cerr << "WARNING: " << _path << " has a malformed packet block" << endl;
+				continue;
+			}
+			packet.timestamp 	= (uint64_t) ((unsigned __int128) units * _interfaces[id].mul / _interfaces[id].div);
+			packet.length 		= captured;
+			packet.origLength 	= get32(block + 24);
+			packet.data 		= _map + block + 28;
+			return true;
+		}
+		else if (type == PCAPNG_SPB) {
+			uint32_t 	original 	= get32(block + 8);
+			uint32_t 	captured 	= min(original, length - 16);
+
+			if (_interfaces.empty())
+				continue;
+			if (_interfaces[0].snapLength != 0)
+				captured = min(captured, _interfaces[0].snapLength);
+			packet.timestamp 	= 0;				// simple blocks have no timestamp
+			packet.length 		= captured;
+			packet.origLength 	= original;
+			packet.data 		= _map + block + 12;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool pcapReader::read(stream<axiWord>& output)
+{
+	pcapPacket 	packet;
+
+	if (_pending) {
+		_pending = false;
+		packWords(_next.data, _next.length, output);
+		return true;
+	}
+	if (!next(packet))
+		return false;
+	packWords(packet.data, packet.length, output);
+	return true;
+}
+
+unsigned pcapReader::replay(stream<axiWord>& output, uint64_t cycle, double speedup)
+{
+	unsigned 	written = 0;
+
+	if (!_pending)
+		_pending = next(_next);
+	if (_pending && !_replayStarted) {
+		_replayStarted 	= true;
+		_firstTimestamp = _next.timestamp;
+		_firstCycle 	= cycle;
+	}
+	while (_pending) {
+		// A timestamp that goes back is due right away
+		uint64_t 	elapsed = (_next.timestamp > _firstTimestamp) ? _next.timestamp - _firstTimestamp : 0;
+		uint64_t 	due 	= _firstCycle + (uint64_t) (elapsed / speedup / (CLOCK_PERIOD * 1000));
+
+		if (due > cycle)
+			break;
+		packWords(_next.data, _next.length, output);
+		written++;
+		_pending = next(_next);
+	}
+	return written;
+}
+
+/************************************** pcapWriter **************************************/
+
+pcapWriter::pcapWriter()
+	: _file(NULL), _format(PCAP_MICROSECONDS), _prefixLength(0), _packets(0), _async(false),
+	  _busy(false), _stop(false) {}
+
+pcapWriter::~pcapWriter()
+{
+	close();
+}
+
+bool pcapWriter::open(const char* path, pcapFormat format, bool async, uint32_t linkType)
+{
+	close();
+	if ((_file = fopen(path, "wb")) == NULL) {
+		cerr << "ERROR: can not write the capture " << path << endl;
+		return false;
+	}
+	_format 	= format;
+	_packets 	= 0;
+	_async 		= async && PCAP_ASYNC_WRITER;
+	_busy 		= false;
+	_stop 		= false;
+	_buffer.clear();
+	_buffer.reserve(BUFFER_BYTES + (64 << 10));
+
+	if (format == PCAPNG) {
+		// Section header, then one interface with nanosecond timestamps
+		const uint32_t 	shb[7] 	= {PCAPNG_SHB, 28, PCAPNG_BYTE_ORDER, 0x00000001, 0xffffffff, 0xffffffff, 28};
+		const uint32_t 	idb[2] 	= {PCAPNG_IDB, 32};
+		const uint16_t 	link[2] = {(uint16_t) linkType, 0};
+		const uint32_t 	snap 	= 65535;
+		const uint8_t 	tsresol[8] = {PCAPNG_IF_TSRESOL, 0, 1, 0, 9, 0, 0, 0};
+		const uint32_t 	tail[2] = {0, 32};				// end of options, block length
+
+		append(shb, sizeof(shb));
+		append(idb, sizeof(idb));
+		append(link, sizeof(link));
+		append(&snap, sizeof(snap));
+		append(tsresol, sizeof(tsresol));
+		append(tail, sizeof(tail));
+	}
+	else {
+		pcap_hdr_t 		header;
+
+		header.magic_number 	= (format == PCAP_MICROSECONDS) ? PCAP_MAGIC_US : PCAP_MAGIC_NS;
+		header.version_major 	= 2;
+		header.version_minor 	= 4;
+		header.thiszone 		= 0;
+		header.sigfigs 			= 0;
+		header.snaplen 			= 65535;
+		header.network 			= linkType;
+		append(&header, sizeof(header));
+	}
+#if (PCAP_ASYNC_WRITER)
+	if (_async)
+		_thread = thread(&pcapWriter::writerThread, this);
+#endif
+	return true;
+}
+
+void pcapWriter::append(const void* data, size_t length)
+{
+	const uint8_t* 	bytes = (const uint8_t *) data;
+
+	_buffer.insert(_buffer.end(), bytes, bytes + length);
+}
+
+void pcapWriter::write(const uint8_t* data, uint32_t length, uint64_t timestamp)
+{
+	if (_file == NULL)
+		return;
+
+	if (_format == PCAPNG) {
+		uint32_t 	padded 		= (length + 3) & ~3U;
+		uint32_t 	total 		= 32 + padded;
+		uint32_t 	header[7] 	= {PCAPNG_EPB, total, 0, (uint32_t) (timestamp >> 32), (uint32_t) timestamp, length, length};
+		uint32_t 	zero 		= 0;
+
+		append(header, sizeof(header));
+		append(data, length);
+		append(&zero, padded - length);
+		append(&total, sizeof(total));
+	}
+	else {
+		pcaprec_hdr_t 	header;
+
+		header.ts_sec 		= timestamp / NS_PER_SECOND;
+		header.ts_usec 		= (_format == PCAP_MICROSECONDS) ? (timestamp % NS_PER_SECOND) / 1000 : timestamp % NS_PER_SECOND;
+		header.incl_len 	= length;
+		header.orig_len 	= length;
+		append(&header, sizeof(header));
+		append(data, length);
+	}
+	_packets++;
+	if (_buffer.size() >= BUFFER_BYTES)
+		flush();
+}
+
+void pcapWriter::write(const axiWord& word, uint64_t timestamp)
+{
+	size_t 		used = _packet.size();
+
+	_packet.resize(used + WORD_BYTES);
+	_packet.resize(used + unpackWord(word, &_packet[used]));
+	if (word.last) {
+		write(_packet.data(), _packet.size(), timestamp);
+		_packet.resize(_prefixLength);
+	}
+}
+
+void pcapWriter::setPrefix(const uint8_t* prefix, unsigned length)
+{
+	_packet.assign(prefix, prefix + length);
+	_prefixLength = length;
+}
+
+void pcapWriter::writeBlock(vector<uint8_t>& block)
+{
+	if (!block.empty() && fwrite(block.data(), 1, block.size(), _file) != block.size())
+		perror("ERROR: writing the capture");
+	block.clear();
+}
+
+void pcapWriter::flush()
+{
+	if (_file == NULL)
+		return;
+	if (!_async) {
+		writeBlock(_buffer);
+		return;
+	}
+#if (PCAP_ASYNC_WRITER)
+	// The thread gets the full buffer and the empty one it wrote last is filled next
+	unique_lock<mutex> 	lock(_mutex);
+	_cond.wait(lock, [this] { return !_busy; });
+	_buffer.swap(_writing);
+	_buffer.reserve(BUFFER_BYTES + (64 << 10));
+	_busy = true;
+	_cond.notify_all();
+#endif
+}
+
+#if (PCAP_ASYNC_WRITER)
+void pcapWriter::writerThread()
+{
+	unique_lock<mutex> 	lock(_mutex);
+
+	while (true) {
+		_cond.wait(lock, [this] { return _busy || _stop; });
+		if (_busy) {
+			lock.unlock();
+			writeBlock(_writing);
+			lock.lock();
+			_busy = false;
+			_cond.notify_all();
+		}
+		else if (_stop) {
+			break;
+		}
+	}
+}
+#endif
+
+void pcapWriter::close()
+{
+	if (_file == NULL)
+		return;
+	flush();
+#if (PCAP_ASYNC_WRITER)
+	if (_async) {
+		{
+			unique_lock<mutex> 	lock(_mutex);
+			_cond.wait(lock, [this] { return !_busy; });
+			_stop = true;
+			_cond.notify_all();
+		}
+		_thread.join();
+	}
+#endif
+	fclose(_file);
+	_file = NULL;
+}
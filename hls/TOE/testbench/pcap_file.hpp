@@ -0,0 +1,201 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _PCAP_FILE_H_
+#define _PCAP_FILE_H_
+
+#include "../toe.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// PCAP_ASYNC_WRITER flag, pcapWriter can write from a thread of its own. It needs C++11 and
+// -pthread, so it is off for the -std=c++98 testbenches of the tcl scripts, build with
+// -DPCAP_ASYNC_WRITER=1. Without it an async writer writes from the calling thread
+#ifndef PCAP_ASYNC_WRITER
+#define PCAP_ASYNC_WRITER 0
+#endif
+
+#if (PCAP_ASYNC_WRITER)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+/*
+ * Capture files of the testbenches. Every reader and writer keeps its own state, any
+ * number of them can be open at the same time.
+ *
+ * pcapReader maps the file read-only and walks the packets in place, pcap with micro or
+ * nanosecond timestamps in either byte order and pcapng (enhanced and simple packet
+ * blocks, the timestamp resolution of each interface). The kernel is told the access is
+ * sequential and the next window is prefetched, so captures of several GB are replayed
+ * at the speed of the page cache. Packets go to a stream as fast as they are asked for,
+ * or paced at the cycles their timestamps give at CLOCK_PERIOD.
+ *
+ * pcapWriter buffers whole records and writes them in large blocks, optionally from a
+ * thread of its own with PCAP_ASYNC_WRITER (the binary needs -pthread then), as pcap or pcapng.
+ */
+
+/* A packet of the capture, data points into the mapped file */
+struct pcapPacket {
+	const uint8_t*		data;
+	uint32_t			length;			// captured bytes
+	uint32_t			origLength;		// bytes on the wire
+	uint64_t			timestamp;		// ns
+};
+
+/* Packs length bytes into words of the interface, 8 bytes per range operation.
+ * Returns the number of words */
+unsigned packWords(const uint8_t* data, unsigned length, stream<axiWord>& output);
+
+/* Copies the bytes of a word selected by keep to dst, returns how many */
+unsigned unpackWord(const axiWord& word, uint8_t* dst);
+
+class pcapReader {
+	public:
+		pcapReader();
+		~pcapReader();
+
+		/* ethernet false skips the first 14 bytes of every packet */
+		bool open(const char* path, bool ethernet = true);
+		void close();
+		bool isOpen() const { return _map != NULL; }
+
+		/* Next packet in place, false at the end of the file */
+		bool next(pcapPacket& packet);
+		/* Next packet to a stream, false at the end of the file */
+		bool read(stream<axiWord>& output);
+		/* Writes every packet due at cycle, the first packet is due at the first call and
+		 * the rest keep the distance of their timestamps, divided by speedup. Returns the
+		 * number of packets written */
+		unsigned replay(stream<axiWord>& output, uint64_t cycle, double speedup = 1.0);
+		bool eof() const { return _end && !_pending; }
+		void rewind();
+
+		uint64_t packets() const { return _packets; }
+		uint32_t linkType() const { return _interfaces.empty() ? 0 : _interfaces[0].linkType; }
+
+	private:
+		/* Timestamp units of an interface, ns = units * mul / div */
+		struct interface {
+			uint32_t		linkType;
+			uint32_t		snapLength;
+			uint64_t		mul;
+			uint64_t		div;
+		};
+
+		std::string 			_path;
+		int 					_fd;
+		const uint8_t* 			_map;
+		size_t 					_size;
+		size_t 					_offset;
+		size_t 					_start;			// first packet or block after the file header
+		size_t 					_prefetched;	// end of the window already advised
+		bool 					_ethernet;
+		bool 					_pcapng;
+		bool 					_swap;			// the file is in the other byte order
+		std::vector<interface> 	_interfaces;
+		std::vector<interface> 	_headerInterfaces;	// the ones before the first packet
+		bool 					_headerSwap;
+		uint64_t 				_packets;
+		bool 					_end;
+		// replay
+		pcapPacket 				_next;
+		bool 					_pending;
+		bool 					_replayStarted;
+		uint64_t 				_firstTimestamp;
+		uint64_t 				_firstCycle;
+
+		uint32_t get32(size_t offset) const;
+		uint16_t get16(size_t offset) const;
+		bool nextPcap(pcapPacket& packet);
+		/* header stops in front of the first block that is not a section or an interface */
+		bool nextPcapng(pcapPacket& packet, bool header);
+		void readInterface(size_t block, uint32_t blockLength);
+		void prefetch();
+};
+
+enum pcapFormat {PCAP_MICROSECONDS, PCAP_NANOSECONDS, PCAPNG};
+
+class pcapWriter {
+	public:
+		pcapWriter();
+		~pcapWriter();
+
+		bool open(const char* path, pcapFormat format = PCAP_MICROSECONDS, bool async = false, uint32_t linkType = 1);
+		void close();
+		bool isOpen() const { return _file != NULL; }
+
+		/* One packet, timestamp in ns */
+		void write(const uint8_t* data, uint32_t length, uint64_t timestamp);
+		/* Collects the words of a packet behind the prefix, the packet is written with
+		 * the last word */
+		void write(const axiWord& word, uint64_t timestamp);
+		/* Bytes in front of every packet collected from words, e.g. an Ethernet header */
+		void setPrefix(const uint8_t* prefix, unsigned length);
+		/* Hands the buffered records to the file */
+		void flush();
+
+		uint64_t packets() const { return _packets; }
+
+	private:
+		static const size_t 	BUFFER_BYTES = 1 << 20;
+
+		FILE* 					_file;
+		pcapFormat 				_format;
+		std::vector<uint8_t> 	_buffer;
+		std::vector<uint8_t> 	_packet;
+		unsigned 				_prefixLength;
+		uint64_t 				_packets;
+		// async, _writing is handed to the thread and written while _buffer fills
+		bool 					_async;
+#if (PCAP_ASYNC_WRITER)
+		std::thread 			_thread;
+		std::mutex 				_mutex;
+		std::condition_variable _cond;
+#endif
+		std::vector<uint8_t> 	_writing;
+		bool 					_busy;
+		bool 					_stop;
+
+		void append(const void* data, size_t length);
+		void writeBlock(std::vector<uint8_t>& block);
+#if (PCAP_ASYNC_WRITER)
+		void writerThread();
+#endif
+};
+
+#endif
@@ -0,0 +1,422 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "dummy_memory.hpp"
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define CHECK(cond, msg) do { if (!(cond)) { std::cout << "ERROR " << msg << std::endl; errors++; } } while (0)
+
+/*
+ * Checks dummyMemory against the map of byte arrays it had before: random writes and reads
+ * in many buffers, some of them wrapping around the end of the buffer, and copies of a
+ * memory. With a timing, the latency, the bandwidth, the cost of the row misses and the
+ * statuses of the writes.
+ *
+ *   test_dummy_memory                   checks
+ *   test_dummy_memory --bench [words]   words/s of the map model and of dummyMemory
+ */
+
+static int 				errors 		= 0;
+static const unsigned 	WORD_BYTES 	= ETH_INTERFACE_WIDTH / 8;
+
+/* dummyMemory before the flat region, a map lookup and a range operation per byte */
+class mapMemory {
+public:
+	~mapMemory() {
+		for (map<uint32_t, ap_uint<8>*>::iterator it = storage.begin(); it != storage.end(); it++)
+			delete[] it->second;
+	}
+	void setReadCmd(mmCmd cmd) {
+		readAddr = cmd.saddr(WINDOW_BITS-1, 0);
+		readId   = cmd.saddr(31, WINDOW_BITS);
+		readLen  = (uint16_t) cmd.bbt(15, 0);
+	}
+	void setWriteCmd(mmCmd cmd) {
+		writeAddr = cmd.saddr(WINDOW_BITS-1, 0);
+		writeId   = cmd.saddr(31, WINDOW_BITS);
+	}
+	void readWord(axiWord& word) {
+		ap_uint<8>* 	buf = find(readId);
+		int 			i = 0;
+
+		word.data = 0;
+		word.keep = 0;
+		while (readLen > 0 && i < (ETH_INTERFACE_WIDTH/8)) {
+			word.data((i*8)+7, i*8) = buf[readAddr];
+			word.keep.bit(i) = 1;
+			readLen--;
+			readAddr++;
+			i++;
+		}
+		word.last = (readLen == 0);
+	}
+	void writeWord(axiWord& word) {
+		ap_uint<8>* 	buf = find(writeId);
+
+		for (int i = 0; i < (ETH_INTERFACE_WIDTH/8); i++) {
+			if (!word.keep.bit(i))
+				break;
+			buf[writeAddr] = word.data((i*8)+7, i*8);
+			writeAddr++;
+		}
+	}
+
+private:
+	ap_uint<8>* find(uint32_t id) {
+		map<uint32_t, ap_uint<8>*>::iterator 	it = storage.find(id);
+
+		if (it == storage.end())
+			it = storage.insert(make_pair(id, new ap_uint<8>[BUFFER_SIZE]())).first;
+		return it->second;
+	}
+
+	ap_uint<WINDOW_BITS> 			readAddr;
+	uint32_t 						readId;
+	int 							readLen;
+	ap_uint<WINDOW_BITS> 			writeAddr;
+	uint32_t 						writeId;
+	map<uint32_t, ap_uint<8>*> 		storage;
+};
+
+void toWords(const vector<uint8_t>& data, vector<axiWord>& words)
+{
+	words.clear();
+	for (unsigned offset = 0; offset < data.size(); offset += WORD_BYTES) {
+		axiWord word(0, 0, 0);
+		for (unsigned b = 0; b < WORD_BYTES && offset + b < data.size(); b++) {
+			word.data(b*8+7, b*8) = data[offset + b];
+			word.keep.bit(b) = 1;
+		}
+		word.last = (offset + WORD_BYTES >= data.size());
+		words.push_back(word);
+	}
+}
+
+bool sameWord(const axiWord& a, const axiWord& b)
+{
+	return (a.data == b.data) && (a.keep == b.keep) && (a.last == b.last);
+}
+
+/* A command in one of a few buffers spread over the address space */
+mmCmd randomCmd(mt19937& random, unsigned maxLength)
+{
+	static const uint32_t 	ids[] = {0, 1, 2, 63, 1000, (1u << (32 - WINDOW_BITS)) - 1};
+	uint32_t 				id 		= ids[random() % (sizeof(ids) / sizeof(ids[0]))];
+	uint32_t 				offset 	= (random() % 4) ? random() % BUFFER_SIZE : BUFFER_SIZE - 1 - random() % 200;
+
+	return mmCmd((id << WINDOW_BITS) | offset, 1 + random() % maxLength);
+}
+
+void testData()
+{
+	mt19937 			random(7);
+	dummyMemory 		memory;
+	mapMemory 			reference;
+	vector<uint8_t> 	data;
+	vector<axiWord> 	words;
+
+	for (int c = 0; c < 3000; c++) {
+		mmCmd 	cmd = randomCmd(random, 3000);
+
+		if (random() % 2) {
+			data.resize(cmd.bbt);
+			for (unsigned b = 0; b < data.size(); b++)
+				data[b] = random();
+			toWords(data, words);
+			memory.setWriteCmd(cmd);
+			reference.setWriteCmd(cmd);
+			for (unsigned w = 0; w < words.size(); w++) {
+				memory.writeWord(words[w]);
+				reference.writeWord(words[w]);
+			}
+		}
+		else {
+			bool 	same = true;
+			axiWord mine;
+			axiWord theirs;
+
+			memory.setReadCmd(cmd);
+			reference.setReadCmd(cmd);
+			do {
+				memory.readWord(mine);
+				reference.readWord(theirs);
+				same = same && sameWord(mine, theirs);
+			} while (!theirs.last);
+			CHECK(same, "read of " << cmd.bbt << " bytes at " << hex << cmd.saddr << dec << " differs from the map model");
+		}
+	}
+
+	// A copy keeps the data and is independent from then on
+	dummyMemory 	copy(memory);
+	axiWord 		a;
+	axiWord 		b;
+	axiWord 		zero(0, ~0ULL, 0);
+
+	memory.setWriteCmd(mmCmd(5 << WINDOW_BITS, WORD_BYTES));
+	memory.writeWord(zero);
+	for (int c = 0; c < 200; c++) {
+		mmCmd 	cmd = randomCmd(random, 3000);
+		bool 	same = true;
+
+		if ((cmd.saddr >> WINDOW_BITS) == 5)
+			continue;
+		copy.setReadCmd(cmd);
+		reference.setReadCmd(cmd);
+		do {
+			copy.readWord(a);
+			reference.readWord(b);
+			same = same && sameWord(a, b);
+		} while (!b.last);
+		CHECK(same, "copy differs at " << hex << cmd.saddr << dec);
+	}
+	copy.setReadCmd(mmCmd(5 << WINDOW_BITS, 8));
+	copy.readWord(a);
+	CHECK(a.data(63, 0) == 0 && a.keep == 0xFF, "a write to the memory changed its copy");
+}
+
+/* Steps the memory until it is idle, returns the cycle of every word and status out */
+struct timedRun {
+	stream<mmCmd> 		writeCmd;
+	stream<mmStatus> 	writeStatus;
+	stream<mmCmd> 		readCmd;
+	stream<axiWord> 	writeData;
+	stream<axiWord> 	readData;
+	vector<uint64_t> 	wordCycles;
+	vector<mmStatus> 	statuses;
+
+	void run(dummyMemory& memory) {
+		uint64_t 	cycle = 0;
+
+		do {
+			memory.step(writeCmd, writeStatus, readCmd, writeData, readData);
+			cycle++;
+			while (!readData.empty()) {
+				readData.read();
+				wordCycles.push_back(cycle);
+			}
+			while (!writeStatus.empty())
+				statuses.push_back(writeStatus.read());
+		} while (!memory.idle() || !writeCmd.empty() || !readCmd.empty());
+	}
+};
+
+void testTiming()
+{
+	const memTiming& 	t 		= DDR4_TIMING;
+	const unsigned 		rowSize = 1 << t.colBits;
+
+	// Latency of one word, the command, the row miss, the word and the read latency
+	{
+		dummyMemory 	memory;
+		timedRun 		io;
+
+		memory.setTiming(t);
+		io.readCmd.write(mmCmd(0, WORD_BYTES));
+		io.run(memory);
+		CHECK(io.wordCycles.size() == 1, "one word read gives " << io.wordCycles.size());
+		CHECK(io.wordCycles.size() == 1 && io.wordCycles[0] == 1 + t.commandCycles + t.rowMissCycles + 1 + t.readLatency,
+				"latency of a word is " << (io.wordCycles.empty() ? 0 : io.wordCycles[0]) << " cycles");
+	}
+	// Bandwidth of a long read inside one row
+	{
+		dummyMemory 	memory;
+		timedRun 		io;
+		unsigned 		words 	= rowSize / WORD_BYTES;
+		double 			rate;
+
+		memory.setTiming(t);
+		io.readCmd.write(mmCmd(0, rowSize));
+		io.run(memory);
+		CHECK(io.wordCycles.size() == words, "a read of a row gives " << io.wordCycles.size() << " words");
+		rate = (double) (words - 1) * WORD_BYTES / (io.wordCycles.back() - io.wordCycles.front());
+		CHECK(rate < t.bytesPerCycle * 1.02 && rate > t.bytesPerCycle * 0.95, "read bandwidth " << rate << " bytes per cycle");
+		CHECK(memory.stats().rowMisses == 1, memory.stats().rowMisses << " row misses in one row");
+	}
+	// Two rows of the same bank close each other, two banks keep both open
+	{
+		dummyMemory 	conflict;
+		dummyMemory 	banks;
+		timedRun 		ioConflict;
+		timedRun 		ioBanks;
+		uint32_t 		sameBank 	= rowSize << t.bankBits;
+
+		conflict.setTiming(t);
+		banks.setTiming(t);
+		for (int i = 0; i < 16; i++) {
+			ioConflict.readCmd.write(mmCmd((i % 2) * sameBank, WORD_BYTES));
+			ioBanks.readCmd.write(mmCmd((i % 2) * rowSize, WORD_BYTES));
+		}
+		ioConflict.run(conflict);
+		ioBanks.run(banks);
+		CHECK(conflict.stats().rowMisses == 16 && banks.stats().rowMisses == 2,
+				"row misses " << conflict.stats().rowMisses << " in one bank and " << banks.stats().rowMisses << " in two");
+		CHECK(ioConflict.wordCycles.back() == ioBanks.wordCycles.back() + 14 * t.rowMissCycles,
+				"bank conflicts cost " << ioConflict.wordCycles.back() - ioBanks.wordCycles.back() << " cycles");
+	}
+	// Statuses in order with their tag, a short write and a write past the end of the buffer fail
+	{
+		dummyMemory 	memory;
+		timedRun 		io;
+		vector<uint8_t> data(300, 0xA5);
+		vector<axiWord> words;
+		mmCmd 			cmd;
+		axiWord 		word;
+
+		memory.setTiming(t);
+		toWords(data, words);
+		for (int c = 0; c < 3; c++) {
+			cmd 	= mmCmd((c == 2) ? BUFFER_SIZE - 100 : c * 1000, (c == 1) ? 400 : 300);
+			cmd.tag = c + 1;
+			io.writeCmd.write(cmd);
+			for (unsigned w = 0; w < words.size(); w++)
+				io.writeData.write(words[w]);
+		}
+		io.readCmd.write(mmCmd(0, 300));
+		io.run(memory);
+		CHECK(io.statuses.size() == 3, io.statuses.size() << " statuses of 3 writes");
+		if (io.statuses.size() == 3) {
+			CHECK(io.statuses[0].okay && io.statuses[0].tag == 1, "status of a good write");
+			CHECK(!io.statuses[1].okay && io.statuses[1].slverr && io.statuses[1].tag == 2, "status of a short write");
+			CHECK(!io.statuses[2].okay && io.statuses[2].decerr && io.statuses[2].tag == 3, "status of a write past the end of the buffer");
+		}
+		CHECK(memory.stats().turnarounds == 1 && memory.stats().errors == 2,
+				memory.stats().turnarounds << " turnarounds and " << memory.stats().errors << " errors");
+		// The write past the end wrapped around as the untimed memory does
+		memory.clearTiming();
+		memory.setReadCmd(mmCmd(0, 200));
+		memory.readWord(word);
+		CHECK(word.data(7, 0) == 0xA5 && word.keep.bit(WORD_BYTES - 1), "untimed read after the timed writes");
+	}
+}
+
+/* Words per second through the map model and dummyMemory, packets of 1460 bytes in 64 buffers */
+int bench(unsigned count)
+{
+	typedef chrono::steady_clock 	clock;
+	mt19937 						random(1);
+	vector<uint8_t> 				data(1460);
+	vector<axiWord> 				words;
+	vector<mmCmd> 					cmds;
+	unsigned 						packets;
+	axiWord 						word;
+	clock::time_point 				start;
+	double 							seconds[2];
+
+	for (unsigned b = 0; b < data.size(); b++)
+		data[b] = random();
+	toWords(data, words);
+	packets = count / words.size() + 1;
+	for (unsigned p = 0; p < 4096; p++)
+		cmds.push_back(mmCmd(((p % 64) << WINDOW_BITS) | (random() % BUFFER_SIZE), data.size()));
+	cout << "  " << packets * words.size() << " words written and read back, " << data.size() << " byte commands" << endl;
+	cout << fixed;
+	cout.precision(0);
+
+	for (int model = 0; model < 2; model++) {
+		mapMemory* 		reference 	= new mapMemory();
+		dummyMemory* 	memory 		= new dummyMemory();
+
+		start = clock::now();
+		for (unsigned p = 0; p < packets; p++) {
+			const mmCmd& 	cmd = cmds[p % cmds.size()];
+
+			if (model == 0) {
+				reference->setWriteCmd(cmd);
+				for (unsigned w = 0; w < words.size(); w++)
+					reference->writeWord(words[w]);
+				reference->setReadCmd(cmd);
+				do reference->readWord(word); while (!word.last);
+			}
+			else {
+				memory->setWriteCmd(cmd);
+				for (unsigned w = 0; w < words.size(); w++)
+					memory->writeWord(words[w]);
+				memory->setReadCmd(cmd);
+				do memory->readWord(word); while (!word.last);
+			}
+		}
+		seconds[model] = chrono::duration<double>(clock::now() - start).count();
+		cout << ((model == 0) ? "  map model          " : "  dummyMemory        ") << 2 * packets * words.size() / seconds[model] << " words/s" << endl;
+		delete reference;
+		delete memory;
+	}
+	cout.precision(1);
+	cout << "  speedup            " << seconds[0] / seconds[1] << endl;
+
+	// The cost of the timing on top, cycles of the memory per second of simulation
+	dummyMemory 		memory;
+	stream<mmCmd> 		writeCmd;
+	stream<mmStatus> 	writeStatus;
+	stream<mmCmd> 		readCmd;
+	stream<axiWord> 	writeData;
+	stream<axiWord> 	readData;
+
+	memory.setTiming(DDR4_TIMING);
+	start = clock::now();
+	for (unsigned p = 0; p < packets; p++) {
+		writeCmd.write(cmds[p % cmds.size()]);
+		for (unsigned w = 0; w < words.size(); w++)
+			writeData.write(words[w]);
+		readCmd.write(cmds[p % cmds.size()]);
+		do {
+			memory.step(writeCmd, writeStatus, readCmd, writeData, readData);
+			while (!readData.empty()) readData.read();
+			while (!writeStatus.empty()) writeStatus.read();
+		} while (!memory.idle() || !writeCmd.empty() || !readCmd.empty());
+	}
+	seconds[0] = chrono::duration<double>(clock::now() - start).count();
+	cout.precision(0);
+	cout << "  DDR4 timing        " << memory.stats().cycles / seconds[0] << " cycles/s, ";
+	cout << 2 * packets * words.size() * 100 / memory.stats().cycles << " % of the cycles move a word" << endl;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 2 && string(argv[1]) == "--bench")
+		return bench((argc >= 3) ? strtoul(argv[2], NULL, 0) : 1000000);
+
+	testData();
+	testTiming();
+
+	cout << (errors ? "FAILED" : "PASSED") << endl;
+	return (errors != 0);
+}
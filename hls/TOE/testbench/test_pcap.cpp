@@ -0,0 +1,378 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "pcap_file.hpp"
+#include "pcap2stream.hpp"
+#include "pcap.h"
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define CHECK(cond, msg) do { if (!(cond)) { std::cout << "ERROR " << msg << std::endl; errors++; } } while (0)
+
+/*
+ * Writes synthetic packets as pcap with micro and nanoseconds and as pcapng, from the caller
+ * and from the writer thread, and reads all of them back at the same time. Checks the word
+ * packing against the byte by byte reference, the paced replay, and that a capture goes
+ * through pcap2stream, stream2pcap and the legacy pcap_loop unchanged.
+ *
+ *   test_pcap capture.pcap              checks
+ *   test_pcap --bench [packets]         packets/s of writing, reading and packing
+ */
+
+static int errors = 0;
+
+struct testPacket {
+	vector<uint8_t>		data;
+	uint64_t			timestamp;
+};
+
+/* Sizes around the word boundaries plus random ones, increasing timestamps */
+void makePackets(vector<testPacket>& packets, unsigned count, uint32_t seed)
+{
+	static const unsigned 	sizes[] = {1, 14, 54, 60, 63, 64, 65, 127, 128, 129, 1514, 9000};
+	mt19937 				random(seed);
+	uint64_t 				timestamp = 1600000000ULL * 1000000000ULL + 123456789;
+
+	packets.resize(count);
+	for (unsigned i = 0; i < count; i++) {
+		unsigned length = (i < sizeof(sizes) / sizeof(sizes[0])) ? sizes[i] : 60 + random() % 1455;
+
+		packets[i].data.resize(length);
+		for (unsigned b = 0; b < length; b++)
+			packets[i].data[b] = random();
+		timestamp += random() % 10000;
+		packets[i].timestamp = timestamp;
+	}
+}
+
+/* The packing of pcap2stream before pcapReader, one range operation per byte */
+void packReference(const uint8_t* data, unsigned length, stream<axiWord>& output)
+{
+	axiWord 	word;
+
+	for (unsigned offset = 0; offset < length; offset += ETH_INTERFACE_WIDTH/8) {
+		word.data = 0;
+		word.keep = 0;
+		for (unsigned b = 0; b < ETH_INTERFACE_WIDTH/8 && offset + b < length; b++) {
+			word.data(b*8+7, b*8) = data[offset + b];
+			word.keep.bit(b) = 1;
+		}
+		word.last = (offset + ETH_INTERFACE_WIDTH/8 >= length);
+		output.write(word);
+	}
+}
+
+bool sameWords(stream<axiWord>& a, stream<axiWord>& b)
+{
+	bool 	same = (a.size() == b.size());
+
+	while (!a.empty() && !b.empty()) {
+		axiWord wa = a.read();
+		axiWord wb = b.read();
+		same = same && (wa.data == wb.data) && (wa.keep == wb.keep) && (wa.last == wb.last);
+	}
+	while (!a.empty()) a.read();
+	while (!b.empty()) b.read();
+	return same;
+}
+
+void testPacking()
+{
+	stream<axiWord> 	fast("fast");
+	stream<axiWord> 	reference("reference");
+	vector<uint8_t> 	data(9000);
+	vector<uint8_t> 	back(9000 + 64);
+
+	for (unsigned i = 0; i < data.size(); i++)
+		data[i] = i * 7 + 3;
+	for (unsigned length = 1; length <= 9000; length += (length < 200) ? 1 : 97) {
+		unsigned 	words 	= packWords(data.data(), length, fast);
+		unsigned 	bytes 	= 0;
+
+		packReference(data.data(), length, reference);
+		CHECK(words == reference.size(), "packWords of " << length << " bytes gives " << words << " words");
+		// Back to bytes from a copy of the words
+		for (unsigned w = 0; w < words; w++) {
+			axiWord word = fast.read();
+			bytes += unpackWord(word, &back[bytes]);
+			fast.write(word);
+		}
+		CHECK(bytes == length && equal(data.begin(), data.begin() + length, back.begin()), "unpackWord of " << length << " bytes");
+		CHECK(sameWords(fast, reference), "packWords of " << length << " bytes differs from the reference");
+	}
+}
+
+void testFormats(const vector<testPacket>& packets)
+{
+	const pcapFormat 	formats[3] 	= {PCAP_MICROSECONDS, PCAP_NANOSECONDS, PCAPNG};
+	const char* 		names[3] 	= {"pcap us", "pcap ns", "pcapng"};
+	pcapWriter 			writers[6];
+	pcapReader 			readers[6];
+	string 				files[6];
+
+	// Six writers open at the same time, the second three write from their thread
+	for (int f = 0; f < 6; f++) {
+		files[f] = string("test_pcap_") + to_string(f) + ((formats[f % 3] == PCAPNG) ? ".pcapng" : ".pcap");
+		CHECK(writers[f].open(files[f].c_str(), formats[f % 3], f >= 3), "open " << files[f]);
+	}
+	for (size_t p = 0; p < packets.size(); p++) {
+		for (int f = 0; f < 6; f++)
+			writers[f].write(packets[p].data.data(), packets[p].data.size(), packets[p].timestamp);
+	}
+	for (int f = 0; f < 6; f++) {
+		CHECK(writers[f].packets() == packets.size(), names[f % 3] << " wrote " << writers[f].packets() << " packets");
+		writers[f].close();
+		CHECK(readers[f].open(files[f].c_str()), "open " << files[f] << " to read");
+		CHECK(readers[f].linkType() == 1, names[f % 3] << " link type " << readers[f].linkType());
+	}
+
+	// And read back in lockstep
+	for (size_t p = 0; p < packets.size(); p++) {
+		for (int f = 0; f < 6; f++) {
+			pcapPacket 	packet;
+			uint64_t 	timestamp = packets[p].timestamp;
+
+			if (formats[f % 3] == PCAP_MICROSECONDS)
+				timestamp -= timestamp % 1000;
+			if (!readers[f].next(packet)) {
+				CHECK(false, names[f % 3] << " ends at packet " << p);
+				continue;
+			}
+			CHECK(packet.length == packets[p].data.size() && equal(packets[p].data.begin(), packets[p].data.end(), packet.data),
+					names[f % 3] << " packet " << p << " has other data");
+			CHECK(packet.timestamp == timestamp, names[f % 3] << " packet " << p << " timestamp " << packet.timestamp << " instead of " << timestamp);
+		}
+	}
+	for (int f = 0; f < 6; f++) {
+		pcapPacket 	packet;
+		CHECK(!readers[f].next(packet) && readers[f].eof(), names[f % 3] << " has more packets");
+		readers[f].close();
+		unlink(files[f].c_str());
+	}
+}
+
+void testReplay()
+{
+	const uint64_t 		offsets[4] = {0, 1000, 1000, 5000};
+	const char* 		file = "test_pcap_replay.pcap";
+	pcapWriter 			writer;
+	pcapReader 			reader;
+	stream<axiWord> 	output("replay");
+	uint8_t 			data[100] = {0};
+
+	writer.open(file, PCAP_NANOSECONDS);
+	for (int p = 0; p < 4; p++)
+		writer.write(data, sizeof(data), 1000000000ULL + offsets[p]);
+	writer.close();
+
+	// 1000 ns are 322.3 cycles of CLOCK_PERIOD, 5000 ns 1611.3
+	reader.open(file);
+	CHECK(reader.replay(output, 100) == 1, "the first packet is due at the first call");
+	CHECK(reader.replay(output, 100 + 321) == 0, "the second packet is early");
+	CHECK(reader.replay(output, 100 + 322) == 2, "two packets with the same timestamp");
+	CHECK(reader.replay(output, 100 + 1610) == 0, "the last packet is early");
+	CHECK(reader.replay(output, 100 + 1611) == 1 && reader.eof(), "the last packet");
+	CHECK(output.size() == 4 * 2, "replay wrote " << output.size() << " words");
+
+	// Twice as fast
+	reader.rewind();
+	CHECK(reader.replay(output, 0, 2.0) == 1 && reader.replay(output, 161, 2.0) == 2, "replay at twice the speed");
+	reader.close();
+	unlink(file);
+}
+
+void testCapture(char* capture)
+{
+	char 				outFile[] 	= "test_pcap_stream2pcap.pcap";
+	char 				ngFile[] 	= "test_pcap_capture.pcapng";
+	stream<axiWord> 	legacy("legacy");
+	stream<axiWord> 	copy("copy");
+	stream<axiWord> 	reference("reference");
+	stream<axiWord> 	back("back");
+	pcapReader 			reader;
+	pcapWriter 			writer;
+	pcapPacket 			packet;
+	uint64_t 			packets = 0;
+
+	// pcap2stream gives the words of the old byte by byte packing
+	pcap2stream(capture, false, legacy);
+	CHECK(reader.open(capture, false), "open " << capture);
+	while (reader.next(packet)) {
+		packReference(packet.data, packet.length, reference);
+		packets++;
+	}
+	CHECK(packets != 0, capture << " has no packets");
+	for (size_t w = 0; w < legacy.size(); w++) {
+		axiWord word = legacy.read();
+		copy.write(word);
+		legacy.write(word);
+	}
+	CHECK(sameWords(legacy, reference), "pcap2stream of " << capture << " differs from the reference");
+
+	// stream2pcap adds the Ethernet header pcap2stream takes away
+	while (!copy.empty()) {
+		legacy.write(copy.read());
+		stream2pcap(outFile, false, true, legacy, false);
+	}
+	stream2pcap(outFile, false, true, legacy, true);
+	pcap2stream(outFile, false, back);
+	reader.rewind();
+	while (reader.read(reference));
+	CHECK(sameWords(back, reference), "stream2pcap then pcap2stream changes " << capture);
+
+	// The same packets as pcapng
+	reader.open(capture, true);
+	writer.open(ngFile, PCAPNG);
+	while (reader.next(packet))
+		writer.write(packet.data, packet.length, packet.timestamp);
+	writer.close();
+	reader.open(capture, false);
+	pcap2stream(ngFile, false, back);
+	reader.rewind();
+	while (reader.read(reference));
+	CHECK(sameWords(back, reference), "pcapng copy of " << capture << " differs");
+
+	// The legacy loop sees every packet
+	CHECK(pcap_open(capture, true) == 0, "pcap_open " << capture);
+	CHECK(pcap_open(capture, true) != 0, "pcap_open opens a second file");
+	CHECK(pcap_loop(0, [](unsigned char*, struct pcap_pkthdr*, unsigned char*) {}, NULL) == (int) packets,
+			"pcap_loop does not see " << packets << " packets");
+	pcap_close();
+	unlink(outFile);
+	unlink(ngFile);
+}
+
+/* Packets per second of every path, on a file of the given number of packets */
+int bench(unsigned count)
+{
+	typedef chrono::steady_clock 	clock;
+	const char* 					file 	= "test_pcap_bench.pcap";
+	vector<testPacket> 				packets;
+	stream<axiWord> 				words("words");
+	pcapReader 						reader;
+	pcapWriter 						writer;
+	pcapPacket 						packet;
+	uint64_t 						bytes 	= 0;
+	axiWord 						word;
+	clock::time_point 				start;
+	double 							seconds;
+
+	// A few thousand different packets, repeated
+	makePackets(packets, min(count, 4096U), 1);
+	for (unsigned p = 0; p < count; p++)
+		bytes += packets[p % packets.size()].data.size();
+	cout << "  " << count << " packets, " << bytes / count << " bytes on average" << endl;
+	cout << fixed;
+	cout.precision(0);
+
+	for (int async = 0; async < 2; async++) {
+		start = clock::now();
+		writer.open(file, PCAP_NANOSECONDS, async);
+		for (unsigned p = 0; p < count; p++)
+			writer.write(packets[p % packets.size()].data.data(), packets[p % packets.size()].data.size(), p);
+		writer.close();
+		seconds = chrono::duration<double>(clock::now() - start).count();
+		cout << "  write" << (async ? ", async      " : "             ") << count / seconds << " packets/s" << endl;
+	}
+
+	start = clock::now();
+	reader.open(file);
+	while (reader.next(packet));
+	seconds = chrono::duration<double>(clock::now() - start).count();
+	cout << "  read in place      " << count / seconds << " packets/s" << endl;
+
+	start = clock::now();
+	reader.rewind();
+	while (reader.read(words)) {
+		while (!words.empty())
+			words.read();
+	}
+	seconds = chrono::duration<double>(clock::now() - start).count();
+	cout << "  read to words      " << count / seconds << " packets/s" << endl;
+
+	start = clock::now();
+	reader.rewind();
+	while (reader.next(packet)) {
+		packReference(packet.data, packet.length, words);
+		while (!words.empty())
+			words.read();
+	}
+	seconds = chrono::duration<double>(clock::now() - start).count();
+	cout << "  byte by byte       " << count / seconds << " packets/s" << endl;
+
+	start = clock::now();
+	reader.rewind();
+	writer.open("test_pcap_bench_copy.pcap", PCAP_NANOSECONDS, true);
+	while (reader.read(words)) {
+		while (!words.empty()) {
+			words.read(word);
+			writer.write(word, 0);
+		}
+	}
+	writer.close();
+	seconds = chrono::duration<double>(clock::now() - start).count();
+	cout << "  words to words     " << count / seconds << " packets/s" << endl;
+
+	reader.close();
+	unlink(file);
+	unlink("test_pcap_bench_copy.pcap");
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	vector<testPacket> 	packets;
+
+	if (argc >= 2 && string(argv[1]) == "--bench")
+		return bench((argc >= 3) ? strtoul(argv[2], NULL, 0) : 1000000);
+	if (argc < 2) {
+		cout << "[ERROR] missing arguments." << endl;
+		return -1;
+	}
+
+	makePackets(packets, 3000, 1);
+	testPacking();
+	testFormats(packets);
+	testReplay();
+	testCapture(argv[1]);
+
+	cout << (errors ? "FAILED" : "PASSED") << endl;
+	return (errors != 0);
+}
@@ -111,6 +111,18 @@ void simTxSar(stream<rxTxSarQuery>& req, stream<rxTxSarReply>& rsp)
 
 }
 
+/* Every segment passes the checksum, the TOE offloads the sum to the top level */
+void simChecksum(stream<axiWord>& pseudoPacket, stream<ap_uint<16> >& result)
+{
+	if (!pseudoPacket.empty())
+	{
+		if (pseudoPacket.read().last)
+		{
+			result.write(0);
+		}
+	}
+}
+
 int main(int argc, char** argv)
 {
 
@@ -134,6 +146,21 @@ int main(int argc, char** argv)
 	stream<extendedEvent>				rxEng2eventEng_setEvent("rxEng2eventEng_setEvent");
 	stream<mmCmd>						rxBufferWriteCmd;
 	stream<appNotification>				rxEng2rxApp_notification;
+	stream<txApp_client_status>			rxEng2txApp_client_notification;
+#if (STATISTICS_MODULE)
+	stream<rxStatsUpdate>				rxEngStatsUpdate;
+#endif
+#if (LATENCY_HISTOGRAM)
+	stream<latAck>						rxEng2latency_ack;
+#endif
+#if (DROP_REPORTS)
+	stream<dropReport>					dropReportOut;
+#if (DROP_CAPTURE)
+	stream<axiWord>						dropCaptureOut;
+#endif
+#endif
+	stream<axiWord>						rxEng_pseudo_packet_to_checksum;
+	stream<ap_uint<16> >				rxEng_pseudo_packet_res_checksum;
 
 	int 								count = 0;
 
@@ -148,12 +175,8 @@ int main(int argc, char** argv)
 	}
 	
 
-	uint16_t strbTemp;
-	uint64_t dataTemp;
-	uint16_t lastTemp;
-
 	/* Read pcap file and convert to stream */
-	pcap2stream_no_eth(argv[1], ipRxData);
+	pcap2stream(argv[1], false, ipRxData);
 
 
 	while(!ipRxData.empty()) {
@@ -164,7 +187,7 @@ int main(int argc, char** argv)
 					portTable2rxEng_rsp,
 					rxSar2rxEng_upd_rsp,
 					txSar2rxEng_upd_rsp,
-#if !(RX_DDR_BYPASS)
+#if (!RX_DDR_BYPASS)
 					rxBufferWriteStatus,
 					rxBufferWriteCmd,
 #endif
@@ -179,13 +202,29 @@ int main(int argc, char** argv)
 					rxEng2timer_setCloseTimer,
 					openConStatusOut, //TODO remove
 					rxEng2eventEng_setEvent,
-					rxEng2rxApp_notification);
+					rxEng2rxApp_notification,
+					rxEng2txApp_client_notification,
+#if (STATISTICS_MODULE)
+					rxEngStatsUpdate,
+#endif
+#if (LATENCY_HISTOGRAM)
+					rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+					dropReportOut,
+#if (DROP_CAPTURE)
+					dropCaptureOut,
+#endif
+#endif
+					rxEng_pseudo_packet_to_checksum,
+					rxEng_pseudo_packet_res_checksum);
 
 		simPortTable(rxEng2portTable_req, portTable2rxEng_rsp);
 		simSlookup(rxEng2sLookup_req, sLookup2rxEng_rsp);
 		simStateTable(rxEng2stateTable_upd_req, stateTable2rxEng_upd_rsp);
 		simRxSar(rxEng2rxSar_upd_req, rxSar2rxEng_upd_rsp);
 		simTxSar(rxEng2txSar_upd_req, txSar2rxEng_upd_rsp);
+		simChecksum(rxEng_pseudo_packet_to_checksum, rxEng_pseudo_packet_res_checksum);
 	}
 
 	count = 0;
@@ -213,13 +252,29 @@ int main(int argc, char** argv)
 					rxEng2timer_setCloseTimer,
 					openConStatusOut, //TODO remove
 					rxEng2eventEng_setEvent,
-					rxEng2rxApp_notification);
+					rxEng2rxApp_notification,
+					rxEng2txApp_client_notification,
+#if (STATISTICS_MODULE)
+					rxEngStatsUpdate,
+#endif
+#if (LATENCY_HISTOGRAM)
+					rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+					dropReportOut,
+#if (DROP_CAPTURE)
+					dropCaptureOut,
+#endif
+#endif
+					rxEng_pseudo_packet_to_checksum,
+					rxEng_pseudo_packet_res_checksum);
 
 		simPortTable(rxEng2portTable_req, portTable2rxEng_rsp);
 		simSlookup(rxEng2sLookup_req, sLookup2rxEng_rsp);
 		simStateTable(rxEng2stateTable_upd_req, stateTable2rxEng_upd_rsp);
 		simRxSar(rxEng2rxSar_upd_req, rxSar2rxEng_upd_rsp);
 		simTxSar(rxEng2txSar_upd_req, txSar2rxEng_upd_rsp);
+		simChecksum(rxEng_pseudo_packet_to_checksum, rxEng_pseudo_packet_res_checksum);
 		count++;
 	}
 
@@ -28,6 +28,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 ************************************************/
 #include "../toe.hpp"
 #include "dummy_memory.hpp"
+#include "toe_models.hpp"
 #include "../session_lookup_controller/session_lookup_controller.hpp"
 #include <map>
 #include <string>
@@ -35,7 +36,10 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 #include "../common_utilities/common_utilities.hpp"
 #include "../../echo_replay/echo_server_application.hpp"
 #include "../../iperf2_tcp/iperf_client.hpp"
+#include "../instrumentation/instrumentation.hpp"
 #include <iomanip>
+#include <vector>
+#include <chrono>
 
 #define ECHO_REPLAY 0
 
@@ -45,86 +49,60 @@ using namespace std;
 
 unsigned int	simCycleCounter		= 0;
 
-
-void compute_pseudo_tcp_checksum(	
-									stream<axiWord>&			dataIn,
-									stream<ap_uint<16> >&		pseudo_tcp_checksum,
-									ap_uint<1>					source)
+/*
+ * Counts the TCP segments and their payload in a pcap file, the Ethernet header is skipped
+ */
+void countSegments(char *file, uint64_t& packets, uint64_t& bytes, uint64_t& syn, uint64_t& rst)
 {
-
-	static ap_uint<1> 	compute_checksum[2] = {0 , 0};
-	static ap_uint<16> 	word_sum[32][2]={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-	
-	ap_uint<17> 		ip_sums_L1[16];
-	ap_uint<18> 		ip_sums_L2[8];
-	ap_uint<19> 		ip_sums_L3[4];
-	ap_uint<20> 		ip_sums_L4[2];
-	ap_uint<21> 		ip_sums_L5;
-	ap_uint<16> 		tmp;
-	ap_uint<17> 		tmp1;
-	ap_uint<17> 		tmp2;
-	ap_uint<17> 		final_sum_r; 							// real add
-	ap_uint<17> 		final_sum_o; 							// overflowed add
-	ap_uint<16> 		res_checksum;
-	axiWord 			currWord;
-
-	if (!dataIn.empty() && !compute_checksum[source]){
-		dataIn.read(currWord);
-
-		first_level_sum : for (int i=0 ; i < 32 ; i++ ){
-			if (currWord.keep.bit((i*2)+1))
-				tmp(7,0) 	= currWord.data((((i*2)+1)*8)+7,((i*2)+1)*8);
-			else
-				tmp(7,0) 	= 0;	
-
-			if (currWord.keep.bit(i*2))
-				tmp(15,8) 	= currWord.data(((i*2)*8)+7,(i*2)*8);
-			else 
-				tmp(15,8) 	= 0;
-
-			tmp1 		= word_sum[i][source] + tmp;
-			tmp2 		= word_sum[i][source] + tmp + 1;
-			if (tmp1.bit(16)) 				// one's complement adder
-				word_sum[i][source] = tmp2(15,0);
-			else
-				word_sum[i][source] = tmp1(15,0);
+	stream<axiWord> 		packetData("countSegments");
+	axiWord 				currWord;
+	std::vector<uint8_t> 	bytesIn;
+
+	packets = bytes = syn = rst = 0;
+	pcap2stream(file, false, packetData);
+	while (!packetData.empty()) {
+		packetData.read(currWord);
+		for (int i = 0; i < ETH_INTERFACE_WIDTH/8; i++) {
+			if (currWord.keep.bit(i)) {
+				bytesIn.push_back(currWord.data(i*8+7, i*8));
+			}
 		}
-
-		if(currWord.last){
-			compute_checksum[source] = 1;
+		if (currWord.last) {
+			if (bytesIn[9] == 6) {
+				int ihl = (bytesIn[0] & 0xF) * 4;
+				int totalLength = (bytesIn[2] << 8) | bytesIn[3];
+				uint8_t flags = bytesIn[ihl + 13];
+				packets++;
+				syn += ((flags & 0x02) != 0);
+				rst += ((flags & 0x04) != 0);
+				if (!(flags & 0x02)) {		// SYN options are no payload
+					bytes += totalLength - ihl - (bytesIn[ihl + 12] >> 4) * 4;
+				}
+			}
+			bytesIn.clear();
 		}
 	}
-	else if(compute_checksum[source]) {
-		//adder tree
-		second_level_sum : for (int i = 0; i < 16; i++) {
-			ip_sums_L1[i]= word_sum[i*2][source] + word_sum[i*2+1][source];
-			word_sum[i*2][source]   = 0; // clear adder variable
-			word_sum[i*2+1][source] = 0;
-		}
-		//adder tree L2
-		third_level_sum : for (int i = 0; i < 8; i++) {
-			ip_sums_L2[i] = ip_sums_L1[i*2+1] + ip_sums_L1[i*2];
-		}
-		//adder tree L3
-		fourth_level_sum : for (int i = 0; i < 4; i++) {
-			ip_sums_L3[i] = ip_sums_L2[i*2+1] + ip_sums_L2[i*2];
-		}
-
-		ip_sums_L4[0] = ip_sums_L3[1] + ip_sums_L3[0];
-		ip_sums_L4[1] = ip_sums_L3[3] + ip_sums_L3[2];
-		ip_sums_L5 = ip_sums_L4[1] + ip_sums_L4[0];
-
-		final_sum_r = ip_sums_L5.range(15,0) + ip_sums_L5.range(20,16);
-		final_sum_o = ip_sums_L5.range(15,0) + ip_sums_L5.range(20,16) + 1;
-
-		if (final_sum_r.bit(16))
-			res_checksum = ~(final_sum_o.range(15,0));
-		else
-			res_checksum = ~(final_sum_r.range(15,0));
+}
 
-		compute_checksum[source] = 0;
-		pseudo_tcp_checksum.write(res_checksum);
+/*
+ * FNV-1a hash of the segments in a pcap file, the capture timestamps are wall-clock time and left out
+ */
+uint64_t segmentsDigest(char *file)
+{
+	stream<axiWord> 		packetData("segmentsDigest");
+	axiWord 				currWord;
+	uint64_t 				digest = 0xcbf29ce484222325ULL;
+
+	pcap2stream(file, false, packetData);
+	while (!packetData.empty()) {
+		packetData.read(currWord);
+		for (int i = 0; i < ETH_INTERFACE_WIDTH/8; i++) {
+			if (currWord.keep.bit(i)) {
+				digest = (digest ^ (uint8_t) currWord.data(i*8+7, i*8)) * 0x100000001b3ULL;
+			}
+		}
 	}
+	return digest;
 }
 
 
@@ -155,8 +133,6 @@ void rxApp_sim (
 	openStatus 			connection_status;
 	appNotification 	rx_app_notification;
 	axiWord 			currWord;
-	static int 			packet=0;
-	static int 			transaction=0;
 
 	if (test_RX){			// Only do things if client is enable
 		switch (rx_app_fsm) {
@@ -219,6 +195,8 @@ void rxApp_sim (
 					}
 				}
 
+				break;
+			case IDLE:
 				break;
 		}
 
@@ -236,8 +214,6 @@ void rxApp_sim (
 					//cout << "RX APP [" << dec << packet << "][" << dec << transaction++ << "]";
 					//cout << "\tData " << hex << currWord.data << "\tkeep " << currWord.keep << "\tlast " << currWord.last << endl;
 					if (currWord.last){
-						packet ++;
-						transaction = 0;
 						rx_read_data_fsm = WAIT_DATA;
 					}
 				}
@@ -283,7 +259,6 @@ void txApp_sim(
 	appTxMeta 					write_request;
 	axiWord 					sendWord=axiWord(0,0,0);
 	appTxRsp 					write_request_response;
-	int 						transfer;
 
 	if (test_TX){
 		if (!listenDone) { 				// Open Port 15000
@@ -323,7 +298,7 @@ void txApp_sim(
 	
 				fsm_state = WAIT_RESPONSE;
 				if (rx_client_notification.tcp_nodelay){
-					if (bytes2send > rx_client_notification.max_transfer_size){
+					if (bytes2send > rx_client_notification.max_transfer_size.to_int()){
 						write_request.length 	= rx_client_notification.max_transfer_size;
 						bytes_sent				= rx_client_notification.max_transfer_size;
 					}
@@ -371,10 +346,9 @@ void txApp_sim(
 				break;
 			case SEND_DATA:
 				for (int i=0 ; i < 64 ; i++){
-					if (i < bytes_sent){
+					if (i < bytes_sent.to_int()){
 						sendWord.data((i*8)+7,i*8) = tmp(((i%2)*8)+7,(i%2)*8);
 						sendWord.keep.bit(i)=1;
-						transfer = i;
 						if ((i%2) !=0 )
 							tmp++;
 					}
@@ -411,210 +385,6 @@ void txApp_sim(
 	}
 }
 
-void sessionLookupStub(
-		stream<rtlSessionLookupRequest>& 	lup_req, 
-		stream<rtlSessionLookupReply>& 		lup_rsp,
-		stream<rtlSessionUpdateRequest>& 	upd_req, 
-		stream<rtlSessionUpdateReply>& 		upd_rsp) {
-						//stream<ap_uint<14> >& new_id, stream<ap_uint<14> >& fin_id)
-	static map<threeTuple, ap_uint<14> > lookupTable;
-
-	rtlSessionLookupRequest request;
-	rtlSessionUpdateRequest update;
-
-	map<threeTuple, ap_uint<14> >::const_iterator findPos;
-
-	if (!lup_req.empty()) {
-		lup_req.read(request);
-		//cout << "TABLE lookup req " << (!request.source ? "RX" : "TX_APP") << "\t";
-		//cout << hex  << byteSwap32(request.key.theirIp) << ":" << dec << byteSwap16(request.key.theirPort) << ":" << byteSwap16(request.key.myPort);
-		findPos = lookupTable.find(request.key);
-		if (findPos != lookupTable.end()){ //hit
-			lup_rsp.write(rtlSessionLookupReply(true, findPos->second, request.source));
-			//cout << "\tHIT! ID: " << dec <<findPos->second; 
-		}
-		else {
-			lup_rsp.write(rtlSessionLookupReply(false, request.source));
-			//cout << "\tNO HIT! "; 
-		}
-
-		//cout << "\ttime: " << simCycleCounter << endl;
-	}
-
-	if (!upd_req.empty()) {	//TODO what if element does not exist
-		upd_req.read(update);
-		//cout << "TABLE update " << (!update.source ? "RX" : "TX_APP") << " " <<(!update.op ? "INSERT" : "DELETE") << " ID: " << dec << update.value;
-		//cout << "\t" << hex  << byteSwap32(update.key.theirIp) << ":"<< dec << byteSwap16(update.key.theirPort) << ":" << byteSwap16(update.key.myPort);
-		if (update.op == INSERT) {	//Is there a check if it already exists?
-			// Read free id
-			//new_id.read(update.value);
-			lookupTable[update.key] = update.value;
-			upd_rsp.write(rtlSessionUpdateReply(update.value, INSERT, update.source));
-
-		}
-		else {	// DELETE
-			//fin_id.write(update.value);
-			lookupTable.erase(update.key);
-			upd_rsp.write(rtlSessionUpdateReply(update.value, DELETE, update.source));
-		}
-		//cout << "\ttime: " << simCycleCounter << endl;
-	}
-}
-
-// Use Dummy Memory
-void simulateRx(
-				dummyMemory* 		memory, 
-				stream<mmCmd>& 		WriteCmdFifo,  
-				stream<mmStatus>& 	WriteStatusFifo, 
-				stream<mmCmd>& 		ReadCmdFifo,
-				stream<axiWord>& 	BufferIn, 
-				stream<axiWord>& 	BufferOut) {
-
-	mmCmd cmd;
-	mmStatus status;
-	axiWord inWord = axiWord(0, 0, 0);
-	axiWord outWord = axiWord(0, 0, 0);
-	static uint32_t rxMemCounter = 0;
-	static uint32_t rxMemCounterRd = 0;
-
-	static bool stx_write = false;
-	static bool stx_read = false;
-
-	static bool stx_readCmd = false;
-	static ap_uint<16> wrBufferWriteCounter = 0;
-	static ap_uint<16> wrBufferReadCounter = 0;
-	static int write_command_number = 0;
-	static int read_command_number = 0;
-	static int write_packet_number = 0;
-	static int write_transaction_number = 0;
-	static int read_packet_number = 0;
-	static int read_transaction_number = 0;
-
-	ap_uint<WINDOW_BITS+1> address_comparator;	
-
-	if (!WriteCmdFifo.empty() && !stx_write) {
-		WriteCmdFifo.read(cmd);
-		memory->setWriteCmd(cmd);
-		wrBufferWriteCounter = cmd.bbt;
-		stx_write = true;
-		//cout << "Rx WRITE command [" << setw(3) << write_command_number++<< "] address: " << hex << cmd.saddr << "\tlength: " << dec << cmd.bbt << "\ttime: " << simCycleCounter << endl;
-		address_comparator = cmd.saddr + cmd.bbt;
-		if (address_comparator > BUFFER_SIZE){
-			cout << endl << endl << "Rx WRITE ERROR memory write overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
-		}
-	}
-	else if (!BufferIn.empty() && stx_write) {
-		BufferIn.read(inWord);
-
-		//cout << "Rx WRITE [" << dec << setw(3) << write_packet_number << "][" << setw(2) << write_transaction_number++ << "]";
-		//cout <<"\tdata: " << setw(130) << hex << inWord.data << "\tkeep: " << setw(18) << inWord.keep; 
-		//cout << "\tlast: " << inWord.last << "\ttime: " << dec << simCycleCounter << endl;
-
-		memory->writeWord(inWord);
-		if (wrBufferWriteCounter < (ETH_INTERFACE_WIDTH/8) + 1) {
-			stx_write = false;
-			write_packet_number++;
-			write_transaction_number = 0;
-			status.okay = 1;
-			WriteStatusFifo.write(status);
-		}
-		else
-			wrBufferWriteCounter -= (ETH_INTERFACE_WIDTH/8);
-	}
-	if (!ReadCmdFifo.empty() && !stx_read) {
-		ReadCmdFifo.read(cmd);
-		memory->setReadCmd(cmd);
-		wrBufferReadCounter = cmd.bbt;
-		stx_read = true;
-		//cout << "Rx  READ command [" << setw(3) << read_command_number++<< "] address: " << hex << cmd.saddr << "\tlength: " << dec << cmd.bbt << "\ttime: " << simCycleCounter << endl;
-		address_comparator = cmd.saddr + cmd.bbt;
-		if (address_comparator > BUFFER_SIZE){
-			cout << endl << endl << "Rx READ ERROR memory read overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
-		}
-	}
-	else if(stx_read) {
-		memory->readWord(outWord);
-		BufferOut.write(outWord);
-
-		//cout << "Rx READ [" << dec << setw(3) << read_packet_number << "][" << setw(2) << read_transaction_number++ << "]";
-		//cout <<"\tdata: " << setw(130) << hex << outWord.data << "\tkeep: " << setw(18) << outWord.keep; 
-		//cout << "\tlast: " << outWord.last << "\ttime: " << dec << simCycleCounter << endl;
-
-		if (wrBufferReadCounter < (ETH_INTERFACE_WIDTH/8)+1) {
-			stx_read = false;
-			read_packet_number++;
-			read_transaction_number = 0;
-		}
-		else
-			wrBufferReadCounter -= (ETH_INTERFACE_WIDTH/8);
-	}
-}
-
-
-void simulateTx(
-		dummyMemory* 		memory, 
-		stream<mmCmd>& 		WriteCmdFifo, 
-		stream<mmStatus>& 	WriteStatusFifo, 
-		stream<mmCmd>& 		ReadCmdFifo,
-		stream<axiWord>& 	BufferIn, 
-		stream<axiWord>& 	BufferOut) {
-
-	mmCmd cmd;
-	mmStatus status;
-	axiWord inWord;
-	axiWord outWord;
-	static int write_command_number = 0;
-
-	static bool stx_write 	= false;
-	static bool stx_read 	= false;
-	static bool stx_readCmd = false;
-
-	static int app2mem_word=0;
-	static int mem2tx_word=0;
-	ap_uint<WINDOW_BITS+1> address_comparator;	
-
-	if (!WriteCmdFifo.empty() && !stx_write) {
-		WriteCmdFifo.read(cmd);
-		memory->setWriteCmd(cmd);
-		stx_write = true;
-		//cout << endl << "Tx WRITE command [" << setw(3) << write_command_number++ << "] address: " << hex << cmd.saddr << "\tlength: " << dec << cmd.bbt << "\ttime: " << simCycleCounter << endl;
-		address_comparator = cmd.saddr + cmd.bbt;
-		if (address_comparator > BUFFER_SIZE){
-			cout << endl << endl << "Tx WRITE ERROR memory write overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
-		}
-	}
-	else if (!BufferIn.empty() && stx_write) {
-		BufferIn.read(inWord);
-		memory->writeWord(inWord);
-		//cout << "Tx WRITE app2mem[" << dec << setw(3) << app2mem_word++ << "] data: " << hex << setw(130) << inWord.data << "\tkeep: " << hex << setw(18) << inWord.keep << "\tlast: " << inWord.last << "\ttime: " << dec << simCycleCounter << endl;
-		if (inWord.last) {
-			//fake_txBuffer.write(inWord); // RT hack
-			stx_write = false;
-			status.okay = 1;
-			WriteStatusFifo.write(status);
-			app2mem_word = 0;
-		}
-	}
-	if (!ReadCmdFifo.empty() && !stx_read) {
-		ReadCmdFifo.read(cmd);
-		memory->setReadCmd(cmd);
-		stx_read = true;
-		//cout << endl << "Tx READ command address: " << hex << cmd.saddr << "\tlength: " << dec << cmd.bbt << "\ttime: " << simCycleCounter << endl << endl;
-		address_comparator = cmd.saddr + cmd.bbt;
-		if (address_comparator > BUFFER_SIZE){
-			cout << endl << endl << "Tx READ ERROR memory read overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
-		}
-	}
-	else if(stx_read) {
-		memory->readWord(outWord);
-		BufferOut.write(outWord);
-		if (outWord.last)
-			stx_read = false;
-		//cout << "Tx  READ app2mem[" << dec << setw(3) << mem2tx_word++ << "] data: " << hex << setw(130) << outWord.data << "\tkeep: " << setw(18) << outWord.keep << "\tlast: " << outWord.last << "\ttime: " << dec << simCycleCounter << endl;
-	}
-}
-
-
 int main(int argc, char **argv) {
 
   	stream<axiWord>						ipRxData("ipRxData");
@@ -646,6 +416,9 @@ int main(int argc, char **argv) {
 	stream<axiWord>						rxData_to_rxApp("rxData_to_rxApp");
 	stream<openStatus>					openConnRsp("openConnRsp");
 	stream<appTxRsp>					txApp_data_write_response("txApp_data_write_response");
+#if (TX_APP_WRITABLE_NOTIFICATION)
+	stream<appTxWritable>				txApp_writable("txApp_writable");
+#endif
 	ap_uint<16>							regSessionCount;
 	ap_uint<32>							myIP_address=0x0500A8C0;
 	stream<axiWord> 					rxDataOut("rxDataOut");						// This stream contains the data output from the Rx App I/F
@@ -657,23 +430,55 @@ int main(int argc, char **argv) {
 
    	
 	statsRegs 							stat_registers;
+	rtPolicyRegs						rt_policy_registers;
+
+	// Retransmit policy not written, every connection has the default profile
+	rt_policy_registers.profileWrite = 0;
+	rt_policy_registers.portWrite = 0;
+	rt_policy_registers.sessionWrite = 0;
 
    	bool                     			readEnable = false;
 	ap_uint<16>             			userID = 0;
-	ap_uint<64>             			txBytes;
-	ap_uint<54>             			txPackets;
-	ap_uint<54>             			txRetransmissions;
-	ap_uint<64>             			rxBytes;
-	ap_uint<54>             			rxPackets;
-	ap_uint<32>             			connectionRTT;
+#if (STATISTICS_MODULE)
+	stream<axiWord>						statsSnapshot("statsSnapshot");
+	int									snapshotWords = 0;
+
+	stat_registers.snapshotInterval = 10000;
+#endif
+#if (DROP_REPORTS)
+	stream<dropReport>					dropReports("dropReports");
+	stream<axiWord>						dropCapture("dropCapture");
+	uint64_t							dropsPerReason[NUM_DROP_REASONS] = {0};
+	int									dropCaptureWords = 0;
+#endif
+#if (INSTRUMENTATION)
+	instrRegs							instr_registers;
+	uint64_t							latencyHistogram[INSTR_LATENCY_BUCKETS] = {0};
+	uint64_t							latencyPercentiles[3] = {0};
+	const double						percentiles[3] = {0.5, 0.99, 0.999};
+	uint64_t							latencyCumulative = 0;
+	int									nextPercentile = 0;
+#endif
+#if (LATENCY_HISTOGRAM)
+	latencyRegs							latency_registers;
+	uint32_t							latHistogram[2][LAT_BUCKETS] = {{0}};
+	uint32_t							latBucketLows[LAT_BUCKETS] = {0};
+	const char*							latKindNames[2] = {"write to wire", "round trip"};
+
+	// Every connection in group 0, the buckets of group 0 are polled
+	latency_registers.readEnable = 0;
+	latency_registers.group = 0;
+	latency_registers.sessionID = 0;
+	latency_registers.clear = 0;
+	latency_registers.portWrite = 0;
+	latency_registers.sessionWrite = 0;
+#endif
 
 
 	dummyMemory rxMemory;
 	dummyMemory txMemory;
 	
 	axiWord currOutWord;
-	int 	packet=0;
-	int		transaction=0;
 
 	simCycleCounter		= 0;
 
@@ -698,9 +503,6 @@ int main(int argc, char **argv) {
 
 
 	ap_uint<32> 						iperf_ipAddress0 		= 0xC0A80008;
-	ap_uint<32> 						iperf_ipAddress1 		= 0xC0A80009;
-	ap_uint<32> 						iperf_ipAddress2 		= 0xC0A8000A;
-	ap_uint<32> 						iperf_ipAddress3 		= 0xC0A8000B;
 
 	iperf_regs  						iperf_settings;
 
@@ -716,7 +518,6 @@ int main(int argc, char **argv) {
 	char 								*input_file;
 	char 								*output_file;
 	bool 								end_of_data=false;
-	int 								packet_in_counter = 0;
 
 	if (argc < 4) {
 		cerr << "[ERROR] missing arguments " __FILE__  << " <MODE 0: RX 1: TX><INPUT_PCAP_FILE> <OUTPUT_PCAP_FILE> " << endl;;
@@ -749,6 +550,7 @@ int main(int argc, char **argv) {
 	input_file 	= argv[2];
 	output_file = argv[3];
 
+	std::chrono::steady_clock::time_point simStart = std::chrono::steady_clock::now();
 	do  {
 
 
@@ -808,6 +610,15 @@ int main(int argc, char **argv) {
 
 		stat_registers.readEnable 	= readEnable;
 		stat_registers.userID 		= userID;
+#if (INSTRUMENTATION)
+		instr_registers.latencyBucket = simCycleCounter % INSTR_LATENCY_BUCKETS;		// Poll one bucket per cycle
+#endif
+#if (LATENCY_HISTOGRAM)
+		// Poll one bucket every other cycle, a read needs a rising edge
+		latency_registers.readEnable 	= simCycleCounter % 2;
+		latency_registers.kind 			= (simCycleCounter / 2) / LAT_BUCKETS % 2;
+		latency_registers.bucket 		= (simCycleCounter / 2) % LAT_BUCKETS;
+#endif
 
 		toe(
 			ipRxData,
@@ -845,10 +656,29 @@ int main(int argc, char **argv) {
 			rxData_to_rxApp, 		
 			openConnRsp, 
 			txApp_data_write_response, 	
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			txApp_writable,
+#endif
 
-#ifdef STATISTICS_MODULE
+#if (STATISTICS_MODULE)
 			stat_registers,
+			statsSnapshot,
 #endif	
+#if (RT_POLICY_TABLE)
+			rt_policy_registers,
+#endif
+#if (DROP_REPORTS)
+			dropReports,
+#if (DROP_CAPTURE)
+			dropCapture,
+#endif
+#endif
+#if (INSTRUMENTATION)
+			instr_registers,
+#endif
+#if (LATENCY_HISTOGRAM)
+			latency_registers,
+#endif
 
 			myIP_address, 						// 192.168.0.5
 			regSessionCount,
@@ -873,6 +703,9 @@ int main(int argc, char **argv) {
 
             txApp_write_request,
             txApp_data_write_response,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+            txApp_writable,
+#endif
             txApp_write_Data,
             rxEng2txApp_client_notification,
 
@@ -920,6 +753,9 @@ int main(int argc, char **argv) {
 			txApp_write_request,
 			txApp_write_Data,
 			txApp_data_write_response,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			txApp_writable,
+#endif
 			rxEng2txApp_client_notification);
 #endif		
 		simulateRx(
@@ -956,26 +792,135 @@ int main(int argc, char **argv) {
 
 
 		stream2pcap(output_file, false, true, ipTxData, false);
+#if (STATISTICS_MODULE)
+		while (!statsSnapshot.empty()) {
+			statsSnapshot.read();
+			snapshotWords++;
+		}
+#endif
+#if (DROP_REPORTS)
+		while (!dropReports.empty()) {
+			dropsPerReason[dropReports.read().reason]++;
+		}
+		while (!dropCapture.empty()) {
+			dropCapture.read();
+			dropCaptureWords++;
+		}
+#endif
+#if (INSTRUMENTATION)
+		latencyHistogram[instr_registers.latencyBucket] = instr_registers.latencyCount;
+#endif
+#if (LATENCY_HISTOGRAM)
+		if (latency_registers.readEnable) {
+			latHistogram[latency_registers.kind][latency_registers.bucket] 	= latency_registers.bucketCount;
+			latBucketLows[latency_registers.bucket] 						= latency_registers.bucketLow;
+		}
+#endif
 
 	} while (simCycleCounter++ < totalSimCycles);
 
+#if defined(CSIM_DATAFLOW_THREADS)
+	// Completes the last cycle in the workers, the streams are read sequentially from here on
+	csim::dataflow::stop();
+	csim::dataflow::report(cout);
+#endif
+	std::chrono::duration<double> simSeconds = std::chrono::steady_clock::now() - simStart;
+	cout << "Simulated " << dec << totalSimCycles << " cycles in " << simSeconds.count() << " s, "
+		 << (uint64_t) (totalSimCycles / simSeconds.count()) << " cycles/s" << endl;
+
 	stream2pcap(output_file,false,true,ipTxData,true);
+	cout << "Output digest " << hex << segmentsDigest(output_file) << dec << endl;
 
 	cout << "regSessionCount " << dec << regSessionCount << endl; 
 
 #if (STATISTICS_MODULE)
+	uint64_t wirePackets, wireBytes, wireSyn, wireRst;
+	countSegments(output_file, wirePackets, wireBytes, wireSyn, wireRst);
+
     cout << "  ------- Statistics ------- " << dec << endl;
-	cout << "           txBytes -> " << txBytes << endl; 
-	cout << "         txPackets -> " << txPackets << endl; 
-	cout << " txRetransmissions -> " << txRetransmissions << endl; 
-	cout << "           rxBytes -> " << rxBytes << endl; 
-	cout << "         rxPackets -> " << rxPackets << endl; 
-	cout << "     connectionRTT -> " << connectionRTT << endl; 
+	cout << "           txBytes -> " << stat_registers.txBytes << endl; 
+	cout << "         txPackets -> " << stat_registers.txPackets << endl; 
+	cout << " txRetransmissions -> " << stat_registers.txRetransmissions << endl; 
+	cout << "           rxBytes -> " << stat_registers.rxBytes << endl; 
+	cout << "         rxPackets -> " << stat_registers.rxPackets << endl; 
+	cout << "           rxDrops -> " << stat_registers.rxDrops << endl; 
+	cout << "     connectionRTT -> " << stat_registers.connectionRTT << endl; 
+	cout << "  ------- Global ------- " << endl;
+	cout << "     globalTxBytes -> " << stat_registers.globalTxBytes << "\ton the wire " << wireBytes << endl; 
+	cout << "   globalTxPackets -> " << stat_registers.globalTxPackets << "\ton the wire " << wirePackets << endl; 
+	cout << "       globalTxSyn -> " << stat_registers.globalTxSyn << "\ton the wire " << wireSyn << endl; 
+	cout << "       globalTxRst -> " << stat_registers.globalTxRst << "\ton the wire " << wireRst << endl; 
+	cout << "  globalTxReTx     -> " << stat_registers.globalTxRetransmissions << endl; 
+	cout << "     globalRxBytes -> " << stat_registers.globalRxBytes << endl; 
+	cout << "   globalRxPackets -> " << stat_registers.globalRxPackets << endl; 
+	cout << "     globalRxDrops -> " << stat_registers.globalRxDrops << endl; 
+	cout << "       globalRxSyn -> " << stat_registers.globalRxSyn << endl; 
+	cout << "       globalRxRst -> " << stat_registers.globalRxRst << endl; 
+	cout << "         snapshots -> " << stat_registers.snapshotCount << " (" << snapshotWords << " words)" << endl; 
+
+	if ((stat_registers.globalTxPackets != wirePackets) || (stat_registers.globalTxBytes != wireBytes) ||
+		(stat_registers.globalTxSyn != wireSyn) || (stat_registers.globalTxRst != wireRst)) {
+		cout << "ERROR the statistics do not match the segments on the wire" << endl;
+		return 1;
+	}
 #endif	
+#if (DROP_REPORTS)
+    cout << "  ------- Drops ------- " << dec << endl;
+	for (int r = 0; r < NUM_DROP_REASONS; r++) {
+		if (dropsPerReason[r] != 0)
+			cout << "        reason " << setw(2) << r << " -> " << dropsPerReason[r] << endl;
+	}
+	cout << "     captured words -> " << dropCaptureWords << endl;
+#endif
+
+#if (INSTRUMENTATION)
+	// Percentiles are the upper bound of the bucket they fall in
+	for (int b = 0; b < INSTR_LATENCY_BUCKETS && nextPercentile < 3; b++) {
+		latencyCumulative += latencyHistogram[b];
+		while (nextPercentile < 3 && instr_registers.latencySamples != 0 &&
+				latencyCumulative >= percentiles[nextPercentile] * instr_registers.latencySamples) {
+			latencyPercentiles[nextPercentile++] = (1ULL << b) - 1;
+		}
+	}
+	cout << "  ------- Instrumentation ------- " << endl;
+	cout << "   rxPackets -> " << instr_registers.rxPackets << "\tstall cycles " << instr_registers.rxStallCycles << endl;
+	cout << "   txPackets -> " << instr_registers.txPackets << "\tstall cycles " << instr_registers.txStallCycles << endl;
+	cout << "  rx to tx latency in cycles, " << instr_registers.latencySamples << " samples";
+	if (instr_registers.latencySamples != 0) {
+		cout << ", mean " << (instr_registers.latencySum / instr_registers.latencySamples) << " max " << instr_registers.latencyMax;
+		cout << " p50 <= " << latencyPercentiles[0] << " p99 <= " << latencyPercentiles[1] << " p999 <= " << latencyPercentiles[2];
+	}
+	cout << endl;
+	for (int b = 0; b < INSTR_LATENCY_BUCKETS; b++) {
+		if (latencyHistogram[b] != 0)
+			cout << "    < " << setw(8) << (1ULL << b) << " -> " << latencyHistogram[b] << endl;
+	}
+	instrBottleneckReport(cout, 10);
+#endif
+#if (LATENCY_HISTOGRAM)
+	cout << "  ------- Latency histogram ------- " << endl;
+	for (int k = 0; k < 2; k++) {
+		uint64_t samples = 0;
+		uint64_t cumulative = 0;
+		const double latPercentiles[3] = {0.5, 0.99, 0.999};
+		int next = 0;
+
+		for (int b = 0; b < LAT_BUCKETS; b++)
+			samples += latHistogram[k][b];
+		cout << "  " << latKindNames[k] << " in cycles, " << samples << " samples";
+		// Percentiles are the lower bound of the bucket they fall in
+		for (int b = 0; b < LAT_BUCKETS && next < 3 && samples != 0; b++) {
+			cumulative += latHistogram[k][b];
+			while (next < 3 && cumulative >= latPercentiles[next] * samples) {
+				cout << " p" << (next == 0 ? "50" : (next == 1 ? "99" : "999")) << " >= " << latBucketLows[b];
+				next++;
+			}
+		}
+		cout << endl;
+	}
+	cout << "   session 0 smoothed RTT -> " << latency_registers.sessionRTT << endl;
+#endif
 
-	packet=0;
-	transaction=0;
-		
 	return 0;
 
 }
@@ -0,0 +1,297 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "../session_lookup_controller/session_lookup_controller.hpp"
+#include "toe_models.hpp"
+#include <map>
+#include <iostream>
+
+using namespace std;
+
+void compute_pseudo_tcp_checksum(	
+									stream<axiWord>&			dataIn,
+									stream<ap_uint<16> >&		pseudo_tcp_checksum,
+									ap_uint<1>					source)
+{
+
+	static ap_uint<1> 	compute_checksum[2] = {0 , 0};
+	static ap_uint<16> 	word_sum[32][2]={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+	
+	ap_uint<17> 		ip_sums_L1[16];
+	ap_uint<18> 		ip_sums_L2[8];
+	ap_uint<19> 		ip_sums_L3[4];
+	ap_uint<20> 		ip_sums_L4[2];
+	ap_uint<21> 		ip_sums_L5;
+	ap_uint<16> 		tmp;
+	ap_uint<17> 		tmp1;
+	ap_uint<17> 		tmp2;
+	ap_uint<17> 		final_sum_r; 							// real add
+	ap_uint<17> 		final_sum_o; 							// overflowed add
+	ap_uint<16> 		res_checksum;
+	axiWord 			currWord;
+
+	if (!dataIn.empty() && !compute_checksum[source]){
+		dataIn.read(currWord);
+
+		first_level_sum : for (int i=0 ; i < 32 ; i++ ){
+			if (currWord.keep.bit((i*2)+1))
+				tmp(7,0) 	= currWord.data((((i*2)+1)*8)+7,((i*2)+1)*8);
+			else
+				tmp(7,0) 	= 0;	
+
+			if (currWord.keep.bit(i*2))
+				tmp(15,8) 	= currWord.data(((i*2)*8)+7,(i*2)*8);
+			else 
+				tmp(15,8) 	= 0;
+
+			tmp1 		= word_sum[i][source] + tmp;
+			tmp2 		= word_sum[i][source] + tmp + 1;
+			if (tmp1.bit(16)) 				// one's complement adder
+				word_sum[i][source] = tmp2(15,0);
+			else
+				word_sum[i][source] = tmp1(15,0);
+		}
+
+		if(currWord.last){
+			compute_checksum[source] = 1;
+		}
+	}
+	else if(compute_checksum[source]) {
+		//adder tree
+		second_level_sum : for (int i = 0; i < 16; i++) {
+			ip_sums_L1[i]= word_sum[i*2][source] + word_sum[i*2+1][source];
+			word_sum[i*2][source]   = 0; // clear adder variable
+			word_sum[i*2+1][source] = 0;
+		}
+		//adder tree L2
+		third_level_sum : for (int i = 0; i < 8; i++) {
+			ip_sums_L2[i] = ip_sums_L1[i*2+1] + ip_sums_L1[i*2];
+		}
+		//adder tree L3
+		fourth_level_sum : for (int i = 0; i < 4; i++) {
+			ip_sums_L3[i] = ip_sums_L2[i*2+1] + ip_sums_L2[i*2];
+		}
+
+		ip_sums_L4[0] = ip_sums_L3[1] + ip_sums_L3[0];
+		ip_sums_L4[1] = ip_sums_L3[3] + ip_sums_L3[2];
+		ip_sums_L5 = ip_sums_L4[1] + ip_sums_L4[0];
+
+		final_sum_r = ip_sums_L5.range(15,0) + ip_sums_L5.range(20,16);
+		final_sum_o = ip_sums_L5.range(15,0) + ip_sums_L5.range(20,16) + 1;
+
+		if (final_sum_r.bit(16))
+			res_checksum = ~(final_sum_o.range(15,0));
+		else
+			res_checksum = ~(final_sum_r.range(15,0));
+
+		compute_checksum[source] = 0;
+		pseudo_tcp_checksum.write(res_checksum);
+	}
+}
+
+void sessionLookupStub(
+		stream<rtlSessionLookupRequest>& 	lup_req, 
+		stream<rtlSessionLookupReply>& 		lup_rsp,
+		stream<rtlSessionUpdateRequest>& 	upd_req, 
+		stream<rtlSessionUpdateReply>& 		upd_rsp) {
+						//stream<ap_uint<14> >& new_id, stream<ap_uint<14> >& fin_id)
+	static map<threeTuple, ap_uint<14> > lookupTable;
+
+	rtlSessionLookupRequest request;
+	rtlSessionUpdateRequest update;
+
+	map<threeTuple, ap_uint<14> >::const_iterator findPos;
+
+	if (!lup_req.empty()) {
+		lup_req.read(request);
+		//cout << "TABLE lookup req " << (!request.source ? "RX" : "TX_APP") << "\t";
+		//cout << hex  << byteSwap32(request.key.theirIp) << ":" << dec << byteSwap16(request.key.theirPort) << ":" << byteSwap16(request.key.myPort);
+		findPos = lookupTable.find(request.key);
+		if (findPos != lookupTable.end()){ //hit
+			lup_rsp.write(rtlSessionLookupReply(true, findPos->second, request.source));
+			//cout << "\tHIT! ID: " << dec <<findPos->second; 
+		}
+		else {
+			lup_rsp.write(rtlSessionLookupReply(false, request.source));
+			//cout << "\tNO HIT! "; 
+		}
+
+		//cout << "\ttime: " << simCycleCounter << endl;
+	}
+
+	if (!upd_req.empty()) {	//TODO what if element does not exist
+		upd_req.read(update);
+		//cout << "TABLE update " << (!update.source ? "RX" : "TX_APP") << " " <<(!update.op ? "INSERT" : "DELETE") << " ID: " << dec << update.value;
+		//cout << "\t" << hex  << byteSwap32(update.key.theirIp) << ":"<< dec << byteSwap16(update.key.theirPort) << ":" << byteSwap16(update.key.myPort);
+		if (update.op == INSERT) {	//Is there a check if it already exists?
+			// Read free id
+			//new_id.read(update.value);
+			lookupTable[update.key] = update.value;
+			upd_rsp.write(rtlSessionUpdateReply(update.value, INSERT, update.source));
+
+		}
+		else {	// DELETE
+			//fin_id.write(update.value);
+			lookupTable.erase(update.key);
+			upd_rsp.write(rtlSessionUpdateReply(update.value, DELETE, update.source));
+		}
+		//cout << "\ttime: " << simCycleCounter << endl;
+	}
+}
+
+// Use Dummy Memory, the memory answers at once unless it has a timing
+void simulateRx(
+				dummyMemory* 		memory, 
+				stream<mmCmd>& 		WriteCmdFifo,  
+				stream<mmStatus>& 	WriteStatusFifo, 
+				stream<mmCmd>& 		ReadCmdFifo,
+				stream<axiWord>& 	BufferIn, 
+				stream<axiWord>& 	BufferOut) {
+
+	if (memory->timed()) {
+		memory->step(WriteCmdFifo, WriteStatusFifo, ReadCmdFifo, BufferIn, BufferOut);
+		return;
+	}
+
+	mmCmd cmd;
+	mmStatus status;
+	axiWord inWord = axiWord(0, 0, 0);
+	axiWord outWord = axiWord(0, 0, 0);
+	static bool stx_write = false;
+	static bool stx_read = false;
+	static ap_uint<16> wrBufferWriteCounter = 0;
+	static ap_uint<16> wrBufferReadCounter = 0;
+
+	ap_uint<WINDOW_BITS+1> address_comparator;	
+
+	if (!WriteCmdFifo.empty() && !stx_write) {
+		WriteCmdFifo.read(cmd);
+		memory->setWriteCmd(cmd);
+		wrBufferWriteCounter = cmd.bbt;
+		stx_write = true;
+		address_comparator = cmd.saddr + cmd.bbt;
+		if (address_comparator > BUFFER_SIZE){
+			cout << endl << endl << "Rx WRITE ERROR memory write overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
+		}
+	}
+	else if (!BufferIn.empty() && stx_write) {
+		BufferIn.read(inWord);
+
+		memory->writeWord(inWord);
+		if (wrBufferWriteCounter < (ETH_INTERFACE_WIDTH/8) + 1) {
+			stx_write = false;
+			status.okay = 1;
+			WriteStatusFifo.write(status);
+		}
+		else
+			wrBufferWriteCounter -= (ETH_INTERFACE_WIDTH/8);
+	}
+	if (!ReadCmdFifo.empty() && !stx_read) {
+		ReadCmdFifo.read(cmd);
+		memory->setReadCmd(cmd);
+		wrBufferReadCounter = cmd.bbt;
+		stx_read = true;
+		address_comparator = cmd.saddr + cmd.bbt;
+		if (address_comparator > BUFFER_SIZE){
+			cout << endl << endl << "Rx READ ERROR memory read overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
+		}
+	}
+	else if(stx_read) {
+		memory->readWord(outWord);
+		BufferOut.write(outWord);
+
+		if (wrBufferReadCounter < (ETH_INTERFACE_WIDTH/8)+1) {
+			stx_read = false;
+		}
+		else
+			wrBufferReadCounter -= (ETH_INTERFACE_WIDTH/8);
+	}
+}
+
+
+void simulateTx(
+		dummyMemory* 		memory, 
+		stream<mmCmd>& 		WriteCmdFifo, 
+		stream<mmStatus>& 	WriteStatusFifo, 
+		stream<mmCmd>& 		ReadCmdFifo,
+		stream<axiWord>& 	BufferIn, 
+		stream<axiWord>& 	BufferOut) {
+
+	if (memory->timed()) {
+		memory->step(WriteCmdFifo, WriteStatusFifo, ReadCmdFifo, BufferIn, BufferOut);
+		return;
+	}
+
+	mmCmd cmd;
+	mmStatus status;
+	axiWord inWord;
+	axiWord outWord;
+	static bool stx_write 	= false;
+	static bool stx_read 	= false;
+	ap_uint<WINDOW_BITS+1> address_comparator;	
+
+	if (!WriteCmdFifo.empty() && !stx_write) {
+		WriteCmdFifo.read(cmd);
+		memory->setWriteCmd(cmd);
+		stx_write = true;
+		address_comparator = cmd.saddr + cmd.bbt;
+		if (address_comparator > BUFFER_SIZE){
+			cout << endl << endl << "Tx WRITE ERROR memory write overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
+		}
+	}
+	else if (!BufferIn.empty() && stx_write) {
+		BufferIn.read(inWord);
+		memory->writeWord(inWord);
+		if (inWord.last) {
+			stx_write = false;
+			status.okay = 1;
+			WriteStatusFifo.write(status);
+		}
+	}
+	if (!ReadCmdFifo.empty() && !stx_read) {
+		ReadCmdFifo.read(cmd);
+		memory->setReadCmd(cmd);
+		stx_read = true;
+		address_comparator = cmd.saddr + cmd.bbt;
+		if (address_comparator > BUFFER_SIZE){
+			cout << endl << endl << "Tx READ ERROR memory read overflow!!!!!!! Trying to read from " << hex << address_comparator << endl << endl ;
+		}
+	}
+	else if(stx_read) {
+		memory->readWord(outWord);
+		BufferOut.write(outWord);
+		if (outWord.last)
+			stx_read = false;
+	}
+}
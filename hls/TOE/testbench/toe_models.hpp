@@ -0,0 +1,76 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _TOE_MODELS_H_
+#define _TOE_MODELS_H_
+
+#include "../toe.hpp"
+#include "dummy_memory.hpp"
+
+/*
+ * Models of the blocks around the TOE in a testbench: the checksum of the pseudo TCP packets,
+ * the RTL session lookup table and the RX/TX buffers in external memory. Their state is static,
+ * one instance per process
+ */
+
+/* source selects the state of the TX (0) or RX (1) checksum */
+void compute_pseudo_tcp_checksum(	
+									stream<axiWord>&			dataIn,
+									stream<ap_uint<16> >&		pseudo_tcp_checksum,
+									ap_uint<1>					source);
+
+void sessionLookupStub(
+		stream<rtlSessionLookupRequest>& 	lup_req, 
+		stream<rtlSessionLookupReply>& 		lup_rsp,
+		stream<rtlSessionUpdateRequest>& 	upd_req, 
+		stream<rtlSessionUpdateReply>& 		upd_rsp);
+
+void simulateRx(
+				dummyMemory* 		memory, 
+				stream<mmCmd>& 		WriteCmdFifo,  
+				stream<mmStatus>& 	WriteStatusFifo, 
+				stream<mmCmd>& 		ReadCmdFifo,
+				stream<axiWord>& 	BufferIn, 
+				stream<axiWord>& 	BufferOut);
+
+void simulateTx(
+		dummyMemory* 		memory, 
+		stream<mmCmd>& 		WriteCmdFifo, 
+		stream<mmStatus>& 	WriteStatusFifo, 
+		stream<mmCmd>& 		ReadCmdFifo,
+		stream<axiWord>& 	BufferIn, 
+		stream<axiWord>& 	BufferOut);
+
+#endif
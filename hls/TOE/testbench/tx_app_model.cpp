@@ -0,0 +1,150 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "tx_app_model.hpp"
+
+// Cycles between a write request and its answer, about a state and TX SAR lookup
+static const int RESPONSE_LATENCY = 4;
+
+txAppModel::txAppModel(int window, int ackLatency)
+	: cycles(0), requests(0), refused(0), notifications(0), bytesAccepted(0), bytesReceived(0),
+	  window(window), ackLatency(ackLatency), sessions(MAX_SESSIONS), bytesInWord(0)
+{
+	for (int i = 0; i < MAX_SESSIONS; i++) {
+		sessions[i].open = false;
+	}
+}
+
+void txAppModel::openSession(ap_uint<16> id)
+{
+	sessions[id].open 		= true;
+	sessions[id].written 	= 0;
+	sessions[id].acked 		= 0;
+	sessions[id].lowWater 	= 0;
+	sessions[id].parked 	= 0;
+}
+
+int txAppModel::space(ap_uint<16> id)
+{
+	return window - (int) (sessions[id].written - sessions[id].acked);
+}
+
+void txAppModel::request(ap_uint<16> id, int length)
+{
+	delayed rsp;
+
+	rsp.cycle = cycles + RESPONSE_LATENCY;
+	if (!sessions[id].open) {
+		rsp.response = appTxRsp(length, 0, ERROR_NOCONNECTION, id);
+	}
+	else if (length <= space(id)) {
+		rsp.response = appTxRsp(length, space(id), NO_ERROR, id);
+		sessions[id].written += length;
+		bytesAccepted += length;
+		write wr = {id, length};
+		writes.push_back(wr);
+	}
+	else {
+#if (TX_APP_WAIT_FOR_SPACE)
+		if (length <= window) {
+			sessions[id].parked = length;
+			return;
+		}
+#endif
+		rsp.response = appTxRsp(length, space(id), ERROR_WINDOW, id);
+		refused++;
+#if (TX_APP_WRITABLE_NOTIFICATION)
+		sessions[id].lowWater = length;
+#endif
+	}
+	responses.push_back(rsp);
+}
+
+void txAppModel::run(	stream<appTxMeta>&			txAppDataReqMeta,
+						stream<axiWord>&			txAppData,
+						stream<appTxRsp>&			txAppDataRsp,
+						stream<appTxWritable>&		txAppWritable)
+{
+	appTxMeta 	meta;
+	axiWord 	word;
+
+	// The other end ACKs
+	while (!acks.empty() && (acks.front().cycle <= cycles)) {
+		sessions[acks.front().sessionID].acked += acks.front().length;
+		acks.pop_front();
+	}
+	for (int i = 0; i < MAX_SESSIONS; i++) {
+		if (sessions[i].parked && (sessions[i].parked <= space(i))) {
+			int length = sessions[i].parked;
+			sessions[i].parked = 0;
+			request(i, length);
+		}
+		if (sessions[i].lowWater && (sessions[i].lowWater <= space(i))) {
+			txAppWritable.write(appTxWritable(i, space(i)));
+			sessions[i].lowWater = 0;
+			notifications++;
+		}
+	}
+
+	if (!txAppDataReqMeta.empty()) {
+		txAppDataReqMeta.read(meta);
+		requests++;
+		request(meta.sessionID, meta.length);
+	}
+	if (!responses.empty() && (responses.front().cycle <= cycles)) {
+		txAppDataRsp.write(responses.front().response);
+		responses.pop_front();
+	}
+
+	// One word of the payload per cycle, the ACK timer of a write starts with its last word
+	if (!txAppData.empty()) {
+		txAppData.read(word);
+		for (int i = 0; i < 64; i++) {
+			bytesInWord += word.keep.bit(i);
+		}
+		if (word.last) {
+			if (writes.empty() || (writes.front().length != bytesInWord)) {
+				std::cout << "ERROR txAppModel payload of " << bytesInWord << " bytes does not match a write" << std::endl;
+			}
+			else {
+				ack ak = {cycles + ackLatency, writes.front().sessionID, writes.front().length};
+				acks.push_back(ak);
+				writes.pop_front();
+			}
+			bytesReceived += bytesInWord;
+			bytesInWord = 0;
+		}
+	}
+	cycles++;
+}
@@ -0,0 +1,98 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#ifndef TX_APP_MODEL_H_
+#define TX_APP_MODEL_H_
+
+#include "../toe.hpp"
+#include <deque>
+#include <vector>
+#include <iostream>
+
+/*
+ * Model of the TX application interface of the TOE for the application test benches.
+ * Every session has the window of the other end, which ACKs the bytes written after
+ * ackLatency cycles. A write request is answered after a few cycles: it is accepted
+ * when it fits, parked with TX_APP_WAIT_FOR_SPACE, or refused with ERROR_WINDOW. With
+ * TX_APP_WRITABLE_NOTIFICATION a refusal arms the writable notification of the session.
+ */
+class txAppModel {
+public:
+	txAppModel(int window, int ackLatency);
+	void openSession(ap_uint<16> id);
+	// One clock cycle
+	void run(	stream<appTxMeta>&			txAppDataReqMeta,
+				stream<axiWord>&			txAppData,
+				stream<appTxRsp>&			txAppDataRsp,
+				stream<appTxWritable>&		txAppWritable);
+
+	uint64_t				cycles;
+	uint64_t				requests;
+	uint64_t				refused;
+	uint64_t				notifications;
+	uint64_t				bytesAccepted;
+	uint64_t				bytesReceived;
+private:
+	struct session {
+		bool				open;
+		uint64_t			written;
+		uint64_t			acked;
+		int					lowWater;
+		int					parked;
+	};
+	struct delayed {
+		uint64_t			cycle;
+		appTxRsp			response;
+	};
+	struct write {
+		ap_uint<16>			sessionID;
+		int					length;
+	};
+	struct ack {
+		uint64_t			cycle;
+		ap_uint<16>			sessionID;
+		int					length;
+	};
+	int space(ap_uint<16> id);
+	void request(ap_uint<16> id, int length);
+
+	int						window;
+	int						ackLatency;
+	std::vector<session>	sessions;
+	std::deque<delayed>		responses;
+	std::deque<write>		writes;
+	std::deque<ack>			acks;
+	int						bytesInWord;
+};
+#endif
@@ -42,9 +42,12 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 #include "rx_engine/rx_engine.hpp"
 #include "tx_engine/tx_engine.hpp"
 #include "rx_app_stream_if/rx_app_stream_if.hpp"
+#include "rx_session_queues/rx_session_queues.hpp"
 #include "tx_app_interface/tx_app_interface.hpp"
 #include "memory_access/memory_access.hpp"
 #include "statistics/statistics.hpp"
+#include "instrumentation/instrumentation.hpp"
+#include "latency_histogram/latency_histogram.hpp"
 
 /** @ingroup timer
  *
@@ -89,6 +92,8 @@ void stream_merger (stream<T>& in1, stream<T>& in2, stream<T>& out) {
  *  @param[out]		timer2stateTable_releaseState
  *  @param[out]		timer2eventEng_setEvent
  *  @param[out]		rtTimer2rxApp_notification
+ *  @param[out]		rtTimer2txApp_notification
+ *  @param[in]		rt_policy_regs
  */
 void timerWrapper(	stream<rxRetransmitTimerUpdate>&	rxEng2timer_clearRetransmitTimer,
 					stream<txRetransmitTimerSet>&		txEng2timer_setRetransmitTimer,
@@ -98,7 +103,12 @@ void timerWrapper(	stream<rxRetransmitTimerUpdate>&	rxEng2timer_clearRetransmitT
 					stream<ap_uint<16> >&				timer2stateTable_releaseState,
 					stream<event>&						timer2eventEng_setEvent,
 					stream<appNotification>&			rtTimer2rxApp_notification,
+#if (RT_POLICY_TABLE)
+					stream<openStatus>&					rtTimer2txApp_notification,
+					rtPolicyRegs&						rt_policy_regs)
+#else
 					stream<openStatus>&					rtTimer2txApp_notification)
+#endif
 {
 #pragma HLS DATAFLOW
 #pragma HLS INLINE off
@@ -130,7 +140,12 @@ void timerWrapper(	stream<rxRetransmitTimerUpdate>&	rxEng2timer_clearRetransmitT
 				rtTimer2eventEng_setEvent,
 				rtTimer2stateTable_releaseState,
 				rtTimer2rxApp_notification,
+#if (RT_POLICY_TABLE)
+				rtTimer2txApp_notification,
+				rt_policy_regs);
+#else
 				rtTimer2txApp_notification);
+#endif
 
 	probe_timer(
 				rxEng2timer_clearProbeTimer,
@@ -152,14 +167,20 @@ void rxAppWrapper(	stream<appReadRequest>&			appRxDataReq,
 					stream<rxSarAppd>&				rxSar2rxApp_upd_rsp,
 					stream<appNotification>&		rxEng2rxApp_notification,
 					stream<appNotification>&		timer2rxApp_notification,
+#if (RX_SESSION_QUEUES)
+					stream<ap_uint<16> >&			rxSar2rxQueues_reset,
+#endif
 					stream<ap_uint<16> >&			appRxDataRspIDsession,
 					stream<rxSarAppd>&				rxApp2rxSar_upd_req,
 #if (!RX_DDR_BYPASS)
 					stream<mmCmd>&					rxBufferReadCmd,
 					stream<axiWord>& 				rxBufferReadData,
 					stream<axiWord>& 				rxDataRsp,
+#elif (RX_SESSION_QUEUES)
+					stream<axiWord>& 				rxEngData,
+					stream<axiWord>& 				rxDataRsp,
 #endif
-					stream<appNotification>&		appNotification)
+					stream<appNotification>&		appNotificationOut)
 {
 	#pragma HLS INLINE
 	#pragma HLS PIPELINE II=1
@@ -191,6 +212,36 @@ void rxAppWrapper(	stream<appReadRequest>&			appRxDataReq,
 					rxBufferReadData, 
 					rxAppDoubleAccess,
 					rxDataRsp);
+#elif (RX_SESSION_QUEUES)
+
+	static stream<appReadRequest>		rxAppStreamIf2rxQueues_readCmd("rxAppStreamIf2rxQueues_readCmd");
+	#pragma HLS STREAM variable=rxAppStreamIf2rxQueues_readCmd		depth=16
+	#pragma HLS DATA_PACK variable=rxAppStreamIf2rxQueues_readCmd
+
+	static stream<appReadRequest>		rxQueues2rxAppStreamIf_drained("rxQueues2rxAppStreamIf_drained");
+	#pragma HLS STREAM variable=rxQueues2rxAppStreamIf_drained		depth=16
+	#pragma HLS DATA_PACK variable=rxQueues2rxAppStreamIf_drained
+
+	static stream<appNotification>		rxQueues2rxApp_notification("rxQueues2rxApp_notification");
+	#pragma HLS STREAM variable=rxQueues2rxApp_notification			depth=8
+	#pragma HLS DATA_PACK variable=rxQueues2rxApp_notification
+
+	rx_app_stream_if(
+					appRxDataReq,
+					rxSar2rxApp_upd_rsp,
+					rxAppStreamIf2rxQueues_readCmd,
+					rxQueues2rxAppStreamIf_drained,
+					rxApp2rxSar_upd_req);
+
+	rx_session_queues(
+					rxEng2rxApp_notification,
+					rxSar2rxQueues_reset,
+					rxEngData,
+					rxAppStreamIf2rxQueues_readCmd,
+					rxQueues2rxApp_notification,
+					appRxDataRspIDsession,
+					rxDataRsp,
+					rxQueues2rxAppStreamIf_drained);
 #else
 	rx_app_stream_if(
 					appRxDataReq,
@@ -201,9 +252,13 @@ void rxAppWrapper(	stream<appReadRequest>&			appRxDataReq,
 #endif
 
 	stream_merger(
+#if (RX_SESSION_QUEUES)
+					rxQueues2rxApp_notification,
+#else
 					rxEng2rxApp_notification,
+#endif
 					timer2rxApp_notification,
-					appNotification);
+					appNotificationOut);
 }
 
 /** @defgroup tcp_module TCP Module
@@ -238,6 +293,11 @@ void rxAppWrapper(	stream<appReadRequest>&			appRxDataReq,
  *  @param[out]		rxDataRsp
  *  @param[out]		openConnRsp
  *  @param[out]		txAppDataRsp
+ *  @param[out]		txAppWritable						: The space of a session which refused a write is available
+ *  @param[out]		dropReportOut						: Reason of every segment the RX engine drops
+ *  @param[out]		dropCaptureOut						: Sampled dropped payloads
+ *  @param[in,out]	instr_regs							: Packet latency histogram and stall cycles
+ *  @param[in,out]	latency_regs						: Write to wire and round trip histograms per session group
  *  @param[in]		myIpAddress							: FPGA IP address
  *  @param[out]		regSessionCount						: Number of connections
  *  @param[out]		tx_pseudo_packet_to_checksum		: TX pseudo TCP packet
@@ -282,10 +342,29 @@ void toe(
 			stream<axiWord>&						rxDataRsp,							
 			stream<openStatus>&						openConnRsp,
 			stream<appTxRsp>&						txAppDataRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			stream<appTxWritable>&					txAppWritable,
+#endif
 
 #if (STATISTICS_MODULE)
 		   	statsRegs& 								stat_regs,			
+			stream<axiWord>&						statsSnapshot,
+#endif
+#if (RT_POLICY_TABLE)
+			rtPolicyRegs&							rt_policy_regs,
+#endif
+#if (DROP_REPORTS)
+			stream<dropReport>&						dropReportOut,
+#if (DROP_CAPTURE)
+			stream<axiWord>&						dropCaptureOut,
+#endif
+#endif
+#if (INSTRUMENTATION)
+			instrRegs&								instr_regs,
 #endif	
+#if (LATENCY_HISTOGRAM)
+			latencyRegs&							latency_regs,
+#endif
 
 			//IP Address Input
 			ap_uint<32>&							myIpAddress,
@@ -342,6 +421,10 @@ void toe(
 #pragma HLS INTERFACE axis register both port=txDataReqMeta name=s_TxDataRequest
 #pragma HLS INTERFACE axis register both port=txApp_Data2send name=s_TxPayload 
 #pragma HLS INTERFACE axis register both port=txAppDataRsp name=m_TxDataResponse 
+#if (TX_APP_WRITABLE_NOTIFICATION)
+#pragma HLS INTERFACE axis register both port=txAppWritable name=m_TxWritableNoty
+#pragma HLS DATA_PACK variable=txAppWritable
+#endif
 
 
 	// SmartCam Interface
@@ -418,7 +501,7 @@ void toe(
 	#pragma HLS STREAM variable=txApp2stateTable_req				depth=2
 
 	static stream<sessionState>			stateTable2txApp_rsp("stateTable2txApp_rsp");
-	#pragma HLS STREAM variable=stateTable2txApp_rsp				depth=2
+	#pragma HLS STREAM variable=stateTable2txApp_rsp				depth=TASI_MAX_INFLIGHT
 	#pragma HLS DATA_PACK variable=stateTable2txApp_rsp
 
 	static stream<ap_uint<16> >			stateTable2sLookup_releaseSession("stateTable2sLookup_releaseSession");
@@ -524,6 +607,15 @@ void toe(
 	#pragma HLS STREAM variable=rxEng2rxApp_notification		depth=4
 	#pragma HLS DATA_PACK variable=rxEng2rxApp_notification
 
+#if (RX_SESSION_QUEUES)
+	static stream<axiWord>					rxEng2rxQueues_data("rxEng2rxQueues_data");
+	#pragma HLS STREAM variable=rxEng2rxQueues_data				depth=16
+	#pragma HLS DATA_PACK variable=rxEng2rxQueues_data
+
+	static stream<ap_uint<16> >				rxSar2rxQueues_reset("rxSar2rxQueues_reset");
+	#pragma HLS STREAM variable=rxSar2rxQueues_reset			depth=4
+#endif
+
 	static stream<appNotification>			timer2rxApp_notification("timer2rxApp_notification");
 	#pragma HLS STREAM variable=timer2rxApp_notification		depth=4
 	#pragma HLS DATA_PACK variable=timer2rxApp_notification
@@ -574,12 +666,68 @@ void toe(
 	#pragma HLS DATA_PACK variable=txEngStatsUpdate
 
 	#pragma HLS INTERFACE s_axilite port=stat_regs bundle=toe_stats
+	#pragma HLS INTERFACE axis register both port=statsSnapshot name=m_axis_stats_snapshot
 
 #endif
+#if (RT_POLICY_TABLE)
+	#pragma HLS INTERFACE s_axilite port=rt_policy_regs bundle=toe_rt_policy
+#endif
+#if (DROP_REPORTS)
+	#pragma HLS INTERFACE axis register both port=dropReportOut name=m_axis_drop_report
+	#pragma HLS DATA_PACK variable=dropReportOut
+#if (DROP_CAPTURE)
+	#pragma HLS INTERFACE axis register both port=dropCaptureOut name=m_axis_drop_capture
+#endif
+#endif
+#if (LATENCY_HISTOGRAM)
+	#pragma HLS INTERFACE s_axilite port=latency_regs bundle=toe_latency
+
+	static stream<latAppWrite>		txApp2latency_write("txApp2latency_write");
+	#pragma HLS STREAM variable=txApp2latency_write		depth=16
+	#pragma HLS DATA_PACK variable=txApp2latency_write
+
+	static stream<latTxSegment>		txEng2latency_segment("txEng2latency_segment");
+	#pragma HLS STREAM variable=txEng2latency_segment	depth=64
+	#pragma HLS DATA_PACK variable=txEng2latency_segment
+
+	static stream<ap_uint<32> >		txEng2latency_wireSeq("txEng2latency_wireSeq");
+	#pragma HLS STREAM variable=txEng2latency_wireSeq	depth=64
+
+	static stream<latAck>			rxEng2latency_ack("rxEng2latency_ack");
+	#pragma HLS STREAM variable=rxEng2latency_ack		depth=16
+	#pragma HLS DATA_PACK variable=rxEng2latency_ack
+
+#if (STATISTICS_MODULE)
+	static stream<latRttUpdate>		latency2stats_rtt("latency2stats_rtt");
+	#pragma HLS STREAM variable=latency2stats_rtt		depth=8
+	#pragma HLS DATA_PACK variable=latency2stats_rtt
+#endif
+#endif
+#if (INSTRUMENTATION)
+	#pragma HLS INTERFACE s_axilite port=instr_regs bundle=toe_instr
+
+	static stream<axiWord>		instrRxProbe2rxEng("instrRxProbe2rxEng");
+	#pragma HLS STREAM variable=instrRxProbe2rxEng		depth=4
+	#pragma HLS DATA_PACK variable=instrRxProbe2rxEng
+
+	static stream<axiWord>		txEng2instrTxProbe("txEng2instrTxProbe");
+	#pragma HLS STREAM variable=txEng2instrTxProbe		depth=4
+	#pragma HLS DATA_PACK variable=txEng2instrTxProbe
+
+	static stream<instrStamp>	instrRxStamp("instrRxStamp");
+	#pragma HLS STREAM variable=instrRxStamp			depth=16
+	#pragma HLS DATA_PACK variable=instrRxStamp
+
+	static stream<instrStamp>	instrTxStamp("instrTxStamp");
+	#pragma HLS STREAM variable=instrTxStamp			depth=16
+	#pragma HLS DATA_PACK variable=instrTxStamp
+#endif
+	DATAFLOW_CYCLE();
 	/*
 	 * Data Structures
 	 */
 	// Session Lookup Controller
+	DATAFLOW_PROCESS_BEGIN("session_lookup_controller")
 	session_lookup_controller(	
 					rxEng2sLookup_req,
 					sLookup2rxEng_rsp,
@@ -595,7 +743,9 @@ void toe(
 					sessionUpdate_rsp,
 					regSessionCount,
 					myIpAddress);
+	DATAFLOW_PROCESS_END
 	// State Table
+	DATAFLOW_PROCESS_BEGIN("state_table")
 	state_table(	rxEng2stateTable_upd_req,
 					txApp2stateTable_upd_req,
 					txApp2stateTable_req,
@@ -604,30 +754,41 @@ void toe(
 					stateTable2txApp_upd_rsp,
 					stateTable2txApp_rsp,
 					stateTable2sLookup_releaseSession);
+	DATAFLOW_PROCESS_END
 	// RX Sar Table
+	DATAFLOW_PROCESS_BEGIN("rx_sar_table")
 	rx_sar_table(	rxEng2rxSar_upd_req,
 					rxApp2rxSar_upd_req,
 					txEng2rxSar_req,
 					rxSar2rxEng_upd_rsp,
 					rxSar2rxApp_upd_rsp,
+#if (RX_SESSION_QUEUES)
+					rxSar2rxQueues_reset,
+#endif
 					rxSar2txEng_rsp);
+	DATAFLOW_PROCESS_END
 
 	// TX Sar Table
+	DATAFLOW_PROCESS_BEGIN("tx_sar_table")
 	tx_sar_table(	rxEng2txSar_upd_req,
 					txEng2txSar_upd_req,
 					txApp2txSar_push,
 					txSar2rxEng_upd_rsp,
 					txSar2txEng_upd_rsp,
 					txSar2txApp_ack_push);
+	DATAFLOW_PROCESS_END
 	// Port Table
+	DATAFLOW_PROCESS_BEGIN("port_table")
 	port_table(		rxEng2portTable_req,
 					listenPortRequest,
 					sLookup2portTable_releasePort,
 					portTable2rxEng_rsp,
 					listenPortResponse,
 					portTable2txApp_free_port);
+	DATAFLOW_PROCESS_END
 
 	// Timers
+	DATAFLOW_PROCESS_BEGIN("timers")
 	timerWrapper(	rxEng2timer_clearRetransmitTimer,
 					txEng2timer_setRetransmitTimer,
 					rxEng2timer_clearProbeTimer,
@@ -636,8 +797,15 @@ void toe(
 					timer2stateTable_releaseState,
 					timer2eventEng_setEvent,
 					timer2rxApp_notification,
+#if (RT_POLICY_TABLE)
+					timer2txApp_notification,
+					rt_policy_regs);
+#else
 					timer2txApp_notification);
+#endif
+	DATAFLOW_PROCESS_END
 
+	DATAFLOW_PROCESS_BEGIN("event_engine")
 	event_engine(   txApp2eventEng_setEvent, 
 					rxEng2eventEng_setEvent, 
 					timer2eventEng_setEvent, 
@@ -645,16 +813,31 @@ void toe(
 					ackDelayFifoReadCount, 
 					ackDelayFifoWriteCount, 
 					txEngFifoReadCount);
+	DATAFLOW_PROCESS_END
 
+	DATAFLOW_PROCESS_BEGIN("ack_delay")
 	ack_delay(      eventEng2ackDelay_event, 
 					eventEng2txEng_event, 
 					ackDelayFifoReadCount, 
 					ackDelayFifoWriteCount);
+	DATAFLOW_PROCESS_END
 	/*
 	 * Engines
 	 */
 	// RX Engine
+#if (INSTRUMENTATION)
+	DATAFLOW_PROCESS_BEGIN("rx_probe")
+	instrProbe<0>(	ipRxData,
+					instrRxProbe2rxEng,
+					instrRxStamp);
+	DATAFLOW_PROCESS_END
+
+	DATAFLOW_PROCESS_BEGIN("rx_engine")
+	rx_engine(		instrRxProbe2rxEng,
+#else
+	DATAFLOW_PROCESS_BEGIN("rx_engine")
 	rx_engine(		ipRxData,
+#endif
 					sLookup2rxEng_rsp,
 					stateTable2rxEng_upd_rsp,
 					portTable2rxEng_rsp,
@@ -664,6 +847,8 @@ void toe(
 					rxBufferWriteStatus,
 					rxBufferWriteCmd,
 					rxBufferWriteData,
+#elif (RX_SESSION_QUEUES)
+					rxEng2rxQueues_data,
 #else					
 					rxDataRsp,
 #endif
@@ -682,9 +867,20 @@ void toe(
 #if (STATISTICS_MODULE)
 					rxEngStatsUpdate,
 #endif						
+#if (LATENCY_HISTOGRAM)
+					rxEng2latency_ack,
+#endif
+#if (DROP_REPORTS)
+					dropReportOut,
+#if (DROP_CAPTURE)
+					dropCaptureOut,
+#endif
+#endif
 					rxEng_pseudo_packet_to_checksum,
 					rxEng_pseudo_packet_res_checksum);
+	DATAFLOW_PROCESS_END
 	// TX Engine
+	DATAFLOW_PROCESS_BEGIN("tx_engine")
 	tx_engine(		eventEng2txEng_event,
 					rxSar2txEng_rsp,
 					txSar2txEng_upd_rsp,
@@ -695,6 +891,10 @@ void toe(
 #if (STATISTICS_MODULE)
 					txEngStatsUpdate,
 #endif	            		
+#if (LATENCY_HISTOGRAM)
+					txEng2latency_segment,
+					txEng2latency_wireSeq,
+#endif
 					sLookup2txEng_rev_rsp,
 					txEng2rxSar_req,
 					txEng2txSar_upd_req,
@@ -702,34 +902,64 @@ void toe(
 					txEng2timer_setProbeTimer,
 					txBufferReadCmd,
 					txEng2sLookup_rev_req,
+#if (INSTRUMENTATION)
+					txEng2instrTxProbe,
+#else
 					ipTxData,
+#endif
 					txEngFifoReadCount,
 					tx_pseudo_packet_to_checksum,
 					tx_pseudo_packet_res_checksum);
+	DATAFLOW_PROCESS_END
+
+#if (INSTRUMENTATION)
+	DATAFLOW_PROCESS_BEGIN("tx_probe")
+	instrProbe<1>(	txEng2instrTxProbe,
+					ipTxData,
+					instrTxStamp);
+	DATAFLOW_PROCESS_END
+
+	DATAFLOW_PROCESS_BEGIN("instr_collector")
+	instrCollector(	instrRxStamp,
+					instrTxStamp,
+					instr_regs);
+	DATAFLOW_PROCESS_END
+#endif
 
 	/*
 	 * Application Interfaces
 	 */
+	DATAFLOW_PROCESS_BEGIN("rx_app")
 	 rxAppWrapper(	rxApp_readRequest,
 			 	 	rxSar2rxApp_upd_rsp,
 			 	 	rxEng2rxApp_notification,
 			 	 	timer2rxApp_notification,
+#if (RX_SESSION_QUEUES)
+			 	 	rxSar2rxQueues_reset,
+#endif
 			 	 	rxApp_readRequest_RspID,
 			 	 	rxApp2rxSar_upd_req,
 #if !(RX_DDR_BYPASS)
 			 	 	rxBufferReadCmd,
 			 	 	rxBufferReadData,
+#elif (RX_SESSION_QUEUES)
+			 	 	rxEng2rxQueues_data,
+			 	 	rxDataRsp,
 #endif
 			 	 	rxAppNotification);
+	DATAFLOW_PROCESS_END
 
 
 #if (TCP_NODELAY)
+	DATAFLOW_PROCESS_BEGIN("data_broadcast")
 	 DataBroadcast(
 					txApp_Data2send,
 					txApp2ExtMemory,
 					txApp2txEng2PseudoHeader);
+	DATAFLOW_PROCESS_END
 #endif
 
+	DATAFLOW_PROCESS_BEGIN("tx_app_interface")
 	tx_app_interface(
 					txDataReqMeta,
 #if (TCP_NODELAY)				
@@ -749,6 +979,9 @@ void toe(
 					conEstablishedFifo,
 					
 					txAppDataRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+					txAppWritable,
+#endif
 					txApp2stateTable_req,
 					txBufferWriteCmd,
 					txBufferWriteData,
@@ -757,16 +990,110 @@ void toe(
 					txApp2sLookup_req,
 					txApp2stateTable_upd_req,
 					txApp2eventEng_setEvent,
+#if (LATENCY_HISTOGRAM)
+					txApp2latency_write,
+#endif
 					timer2txApp_notification,
 					myIpAddress);
+	DATAFLOW_PROCESS_END
 
 #if (STATISTICS_MODULE)
+	DATAFLOW_PROCESS_BEGIN("statistics")
 	toeStatistics (
 				    rxEngStatsUpdate,
 				    txEngStatsUpdate,
+				    statsSnapshot,
+#if (LATENCY_HISTOGRAM)
+				    latency2stats_rtt,
+#endif
 				   	stat_regs);
+	DATAFLOW_PROCESS_END
 #endif	
 
+#if (LATENCY_HISTOGRAM)
+	DATAFLOW_PROCESS_BEGIN("latency_histogram")
+	latency_histogram(
+					txApp2latency_write,
+					txEng2latency_segment,
+					txEng2latency_wireSeq,
+					rxEng2latency_ack,
+#if (STATISTICS_MODULE)
+					latency2stats_rtt,
+#endif
+					latency_regs);
+	DATAFLOW_PROCESS_END
+#endif
+
+#if (INSTRUMENTATION)
+	INSTR_FIFO(rxEng2sLookup_req,					4,		"rx_engine",			"session_lookup");
+	INSTR_FIFO(sLookup2rxEng_rsp,					4,		"session_lookup",		"rx_engine");
+	INSTR_FIFO(txApp2sLookup_req,					4,		"tx_app_interface",		"session_lookup");
+	INSTR_FIFO(sLookup2txApp_rsp,					4,		"session_lookup",		"tx_app_interface");
+	INSTR_FIFO(txEng2sLookup_rev_req,				32,		"tx_engine",			"session_lookup");
+	INSTR_FIFO(sLookup2txEng_rev_rsp,				4,		"session_lookup",		"tx_engine");
+	INSTR_FIFO(rxEng2stateTable_upd_req,			2,		"rx_engine",			"state_table");
+	INSTR_FIFO(stateTable2rxEng_upd_rsp,			4,		"state_table",			"rx_engine");
+	INSTR_FIFO(txApp2stateTable_upd_req,			2,		"tx_app_interface",		"state_table");
+	INSTR_FIFO(stateTable2txApp_upd_rsp,			2,		"state_table",			"tx_app_interface");
+	INSTR_FIFO(txApp2stateTable_req,				2,		"tx_app_interface",		"state_table");
+	INSTR_FIFO(stateTable2txApp_rsp,				TASI_MAX_INFLIGHT, "state_table",	"tx_app_interface");
+	INSTR_FIFO(stateTable2sLookup_releaseSession,	2,		"state_table",			"session_lookup");
+	INSTR_FIFO(rxEng2rxSar_upd_req,					2,		"rx_engine",			"rx_sar_table");
+	INSTR_FIFO(rxSar2rxEng_upd_rsp,					2,		"rx_sar_table",			"rx_engine");
+	INSTR_FIFO(rxApp2rxSar_upd_req,					2,		"rx_app",				"rx_sar_table");
+	INSTR_FIFO(rxSar2rxApp_upd_rsp,					2,		"rx_sar_table",			"rx_app");
+	INSTR_FIFO(txEng2rxSar_req,						2,		"tx_engine",			"rx_sar_table");
+	INSTR_FIFO(rxSar2txEng_rsp,						2,		"rx_sar_table",			"tx_engine");
+	INSTR_FIFO(txEng2txSar_upd_req,					2,		"tx_engine",			"tx_sar_table");
+	INSTR_FIFO(txSar2txEng_upd_rsp,					2,		"tx_sar_table",			"tx_engine");
+	INSTR_FIFO(rxEng2txSar_upd_req,					2,		"rx_engine",			"tx_sar_table");
+	INSTR_FIFO(txSar2rxEng_upd_rsp,					2,		"tx_sar_table",			"rx_engine");
+	INSTR_FIFO(txSar2txApp_ack_push,				2,		"tx_sar_table",			"tx_app_interface");
+	INSTR_FIFO(txApp2txSar_push,					2,		"tx_app_interface",		"tx_sar_table");
+	INSTR_FIFO(rxEng2timer_clearRetransmitTimer,	2,		"rx_engine",			"timers");
+	INSTR_FIFO(txEng2timer_setRetransmitTimer,		2,		"tx_engine",			"timers");
+	INSTR_FIFO(rxEng2timer_clearProbeTimer,			2,		"rx_engine",			"timers");
+	INSTR_FIFO(txEng2timer_setProbeTimer,			2,		"tx_engine",			"timers");
+	INSTR_FIFO(rxEng2timer_setCloseTimer,			2,		"rx_engine",			"timers");
+	INSTR_FIFO(timer2stateTable_releaseState,		2,		"timers",				"state_table");
+	INSTR_FIFO(rxEng2eventEng_setEvent,				512,	"rx_engine",			"event_engine");
+	INSTR_FIFO(txApp2eventEng_setEvent,				4,		"tx_app_interface",		"event_engine");
+	INSTR_FIFO(timer2eventEng_setEvent,				4,		"timers",				"event_engine");
+	INSTR_FIFO(eventEng2ackDelay_event,				4,		"event_engine",			"ack_delay");
+	INSTR_FIFO(eventEng2txEng_event,				16,		"ack_delay",			"tx_engine");
+	INSTR_FIFO(conEstablishedFifo,					4,		"rx_engine",			"tx_app_interface");
+	INSTR_FIFO(rxEng2rxApp_notification,			4,		"rx_engine",			"rx_app");
+#if (RX_SESSION_QUEUES)
+	INSTR_FIFO(rxEng2rxQueues_data,					16,		"rx_engine",			"rx_app");
+	INSTR_FIFO(rxSar2rxQueues_reset,				4,		"rx_sar_table",			"rx_app");
+#endif
+	INSTR_FIFO(timer2rxApp_notification,			4,		"timers",				"rx_app");
+	INSTR_FIFO(timer2txApp_notification,			4,		"timers",				"tx_app_interface");
+	INSTR_FIFO(rxEng2portTable_req,					8,		"rx_engine",			"port_table");
+	INSTR_FIFO(portTable2rxEng_rsp,					32,		"port_table",			"rx_engine");
+	// portTable2txApp_free_port is filled ahead while it is not full, which never holds in C simulation
+	INSTR_FIFO(sLookup2portTable_releasePort,		4,		"session_lookup",		"port_table");
+	INSTR_FIFO(ackDelayFifoReadCount,				2,		"ack_delay",			"event_engine");
+	INSTR_FIFO(ackDelayFifoWriteCount,				2,		"ack_delay",			"event_engine");
+	INSTR_FIFO(txEngFifoReadCount,					2,		"tx_engine",			"event_engine");
+#if (TCP_NODELAY)
+	INSTR_FIFO(txApp2txEng2PseudoHeader,			512,	"data_broadcast",		"tx_engine");
+	INSTR_FIFO(txApp2ExtMemory,						512,	"data_broadcast",		"tx_app_interface");
+#endif
+#if (STATISTICS_MODULE)
+	INSTR_FIFO(rxEngStatsUpdate,					8,		"rx_engine",			"statistics");
+	INSTR_FIFO(txEngStatsUpdate,					8,		"tx_engine",			"statistics");
+#endif
+	INSTR_FIFO(instrRxProbe2rxEng,					4,		"rx_probe",				"rx_engine");
+	INSTR_FIFO(txEng2instrTxProbe,					4,		"tx_engine",			"tx_probe");
+#if (LATENCY_HISTOGRAM)
+	INSTR_FIFO(txApp2latency_write,					16,		"tx_app_interface",		"latency_histogram");
+	INSTR_FIFO(txEng2latency_segment,				64,		"tx_engine",			"latency_histogram");
+	INSTR_FIFO(txEng2latency_wireSeq,				64,		"tx_engine",			"latency_histogram");
+	INSTR_FIFO(rxEng2latency_ack,					16,		"rx_engine",			"latency_histogram");
+#endif
+#endif
+
 
 }
 
@@ -39,6 +39,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 #include "ap_int.h"
 #include <stdint.h>
 #include <vector>
+#include "common_utilities/drop_report.hpp"
 
 #define ETH_INTERFACE_WIDTH 512
 
@@ -48,6 +49,33 @@ static const ap_uint<16> MSS=4096; //536
 // TCP_NODELAY flag, to disable Nagle's Algorithm
 #define TCP_NODELAY 1
 
+// TX_RETRANSMIT_RING flag, the last bytes sent of each session are kept on chip
+// so retransmissions of recent segments do not read the TX buffer. First transmissions
+// already bypass the TX buffer with TCP_NODELAY, which this flag requires. The ring
+// takes BRAM for every session, off by default, build with -DTX_RETRANSMIT_RING=1
+#ifndef TX_RETRANSMIT_RING
+#define TX_RETRANSMIT_RING 0
+#endif
+
+#if (TX_RETRANSMIT_RING && !TCP_NODELAY)
+#error "TX_RETRANSMIT_RING requires TCP_NODELAY"
+#endif
+
+// TX_APP_WAIT_FOR_SPACE flag, a write request that does not fit in the window or in the
+// TX buffer waits inside the TOE until ACKs free enough space, instead of being answered
+// with ERROR_WINDOW or ERROR_NOSPACE. Off by default, build with -DTX_APP_WAIT_FOR_SPACE=1
+#ifndef TX_APP_WAIT_FOR_SPACE
+#define TX_APP_WAIT_FOR_SPACE 0
+#endif
+
+// TX_APP_WRITABLE_NOTIFICATION flag, a write request refused for lack of space arms a
+// notification of its session. Once the ACKs make room for the refused length the TOE
+// sends the session and its available space to the application, which then writes again.
+// It adds a port to the TOE, off by default, build with -DTX_APP_WRITABLE_NOTIFICATION=1
+#ifndef TX_APP_WRITABLE_NOTIFICATION
+#define TX_APP_WRITABLE_NOTIFICATION 0
+#endif
+
 // RX_DDR_BYPASS flag, to enable DDR bypass on RX path
 // This MACRO also modifies the buffer address for the TX path
 // When DDR is not bypassed the RX buffers have the first 2 GB of the memory
@@ -55,6 +83,18 @@ static const ap_uint<16> MSS=4096; //536
 // However, when the DDR is bypassed the TX buffers have the 4 GB
 #define RX_DDR_BYPASS 1
 
+// RX_SESSION_QUEUES flag, with the DDR bypassed the payload of every session waits in its 
+// own on chip queue, so the application reads the sessions in any order. The receive window
+// of a session is the free space of its queue. The queues take 64 KB of URAM per session, 
+// off by default, build with -DRX_SESSION_QUEUES=1
+#ifndef RX_SESSION_QUEUES
+#define RX_SESSION_QUEUES 0
+#endif
+
+#if (RX_SESSION_QUEUES && !RX_DDR_BYPASS)
+#error "RX_SESSION_QUEUES requires RX_DDR_BYPASS"
+#endif
+
 // FAST_RETRANSMIT flag, to enable TCP fast recovery/retransmit mechanism
 #define FAST_RETRANSMIT 1
 
@@ -65,8 +105,71 @@ static const ap_uint<16> MSS=4096; //536
 // It is used to extend the window size, increasing the throughput.
 static const uint8_t WINDOW_SCALE_BITS = 2;
 
-// Statistics such as number of packets, bytes and retransmissions are implemented
-#define STATISTICS_MODULE 0
+// Statistics such as number of packets, bytes and retransmissions are implemented, per session
+// and for the whole TOE. A snapshot of all sessions is streamed out at a programmable interval
+#define STATISTICS_MODULE 1
+
+// RT_POLICY_TABLE flag, the retransmission time-out, its backoff and the number of retries
+// come from a table of profiles written through AXI4-Lite. A connection takes the profile
+// of its listen port or the one written for it, otherwise profile 0. It adds an AXI4-Lite
+// port, off by default, build with -DRT_POLICY_TABLE=1
+#ifndef RT_POLICY_TABLE
+#define RT_POLICY_TABLE 0
+#endif
+
+// Number of retransmit profiles is (1 << RT_PROFILE_BITS), a listen port selects its
+// profile through one of RT_PORT_RULES rules
+static const uint8_t RT_PROFILE_BITS = 2;
+static const uint8_t RT_PORT_RULES = 4;
+
+// DROP_REPORTS flag, every segment the RX engine discards is reported with its reason on
+// m_axis_drop_report, to be counted by the drop_counters block. Shared with packet_handler and
+// icmp_server, see common_utilities/drop_report.hpp. Off by default, build with -DDROP_REPORTS=1
+
+// DROP_CAPTURE flag, one in DROP_CAPTURE_RATE dropped payloads is copied to m_axis_drop_capture,
+// preceded by a word that carries the reason. Only used with DROP_REPORTS. It adds a port to the TOE,
+// off by default, build with -DDROP_CAPTURE=1
+#ifndef DROP_CAPTURE
+#define DROP_CAPTURE 0
+#endif
+static const uint16_t DROP_CAPTURE_RATE = 16;
+
+// INSTRUMENTATION flag, builds probes at ipRxData and ipTxData that time every packet and count
+// the cycles the data path is stalled, read through AXI4-Lite. In C simulation the occupancy
+// of the internal FIFOs is also tracked. Off by default, build with -DINSTRUMENTATION=1
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION 0
+#endif
+// Latency bucket b counts the latencies of b bits, the last bucket also the longer ones
+static const uint8_t INSTR_LATENCY_BUCKETS = 24;
+
+// LATENCY_HISTOGRAM flag, one application write and one segment per session at a time are followed
+// from the write accepted to the segment on the wire, and from the segment to the ACK that covers it.
+// The cycles are counted in log-linear histograms per session group, read through AXI4-Lite.
+// Off by default, build with -DLATENCY_HISTOGRAM=1
+#ifndef LATENCY_HISTOGRAM
+#define LATENCY_HISTOGRAM 0
+#endif
+// Sessions are in one of (1 << LAT_GROUP_BITS) groups, a listen port selects the group of its
+// connections through one of LAT_PORT_RULES rules, otherwise group 0
+static const uint8_t LAT_GROUP_BITS = 2;
+static const uint8_t LAT_PORT_RULES = 4;
+// Four buckets per power of two of a 32-bit latency
+static const uint8_t LAT_SUB_BUCKET_BITS = 2;
+static const uint8_t LAT_BUCKETS = 128;
+
+// C simulation only, built with -DCSIM_DATAFLOW_THREADS every process of toe() runs in a worker
+// thread of hls/csim/include/csim_dataflow.h and each call of toe() is one cycle of the testbench.
+// Otherwise the processes are plain calls
+#if defined(CSIM_DATAFLOW_THREADS) && !defined(__SYNTHESIS__)
+#define DATAFLOW_CYCLE()				csim::dataflow::cycle()
+#define DATAFLOW_PROCESS_BEGIN(name)	csim::dataflow::process(name, [&]() {
+#define DATAFLOW_PROCESS_END			});
+#else
+#define DATAFLOW_CYCLE()
+#define DATAFLOW_PROCESS_BEGIN(name)
+#define DATAFLOW_PROCESS_END
+#endif
 
 // If the window scale option is enable the the MAX session have to be computed
 #if (WINDOW_SCALE)
@@ -86,6 +189,16 @@ static const uint8_t  WINDOW_BITS=16;
 static const uint16_t MAX_SESSIONS = 64;
 
 static const uint32_t BUFFER_SIZE=(1<<WINDOW_BITS);
+
+// Size of the on chip queue of every session with RX_SESSION_QUEUES, a read request with
+// RX_QUEUE_ANY_SESSION reads the next session that has data
+static const uint8_t  RX_QUEUE_BITS = 16;
+static const uint32_t RX_QUEUE_BYTES = (1 << RX_QUEUE_BITS);
+static const uint16_t RX_QUEUE_ROWS = (RX_QUEUE_BYTES / 64);
+// One row is never given to the window, the row written at the tail of the queue is
+// never the one at its head
+static const uint32_t RX_QUEUE_WINDOW = (RX_QUEUE_BYTES - 64);
+#define RX_QUEUE_ANY_SESSION 0xFFFF
 static const ap_uint<WINDOW_BITS> CONGESTION_WINDOW_MAX = (BUFFER_SIZE-2048);
 
 #define CLOCK_PERIOD 0.003103
@@ -342,17 +455,17 @@ struct rxTxSarQuery
 	rxTxSarQuery(ap_uint<16> id)
 				:sessionID(id), ackd(0), recv_window(0), count(0), fastRetransmitted(false), write(0) {}
 	rxTxSarQuery(ap_uint<16> id, ap_uint<32> ackd, ap_uint<WINDOW_BITS> recv_win, ap_uint<WINDOW_BITS> cong_win, ap_uint<2> count, bool fastRetransmitted)
-				:sessionID(id), ackd(ackd), recv_window(recv_win), cong_window(cong_win), count(count), fastRetransmitted(fastRetransmitted), write(1) {}
+				:sessionID(id), ackd(ackd), recv_window(recv_win), count(count), fastRetransmitted(fastRetransmitted), write(1), cong_window(cong_win) {}
 #if (WINDOW_SCALE)
 	rxTxSarQuery(ap_uint<16> id, ap_uint<32> ackd, ap_uint<16> recv_win, ap_uint<WINDOW_BITS> cong_win, ap_uint<2> count, bool fastRetransmitted, 
 				 ap_uint<4> ws)
-				:sessionID(id), ackd(ackd), recv_window(recv_win), cong_window(cong_win), count(count), fastRetransmitted(fastRetransmitted), write(1),
-				 tx_win_shift_write(0),  tx_win_shift(ws) {}
+				:sessionID(id), ackd(ackd), recv_window(recv_win), count(count), fastRetransmitted(fastRetransmitted), write(1),
+				 tx_win_shift(ws), tx_win_shift_write(0), cong_window(cong_win) {}
 
 	rxTxSarQuery(ap_uint<16> id, ap_uint<32> ackd, ap_uint<16> recv_win, ap_uint<WINDOW_BITS> cong_win, ap_uint<2> count, bool fastRetransmitted, 
 				 bool tx_win_shift_write, ap_uint<4> ws)
-				:sessionID(id), ackd(ackd), recv_window(recv_win), cong_window(cong_win), count(count), fastRetransmitted(fastRetransmitted), write(1),
-				 tx_win_shift_write(tx_win_shift_write),  tx_win_shift(ws) {}
+				:sessionID(id), ackd(ackd), recv_window(recv_win), count(count), fastRetransmitted(fastRetransmitted), write(1),
+				 tx_win_shift(ws), tx_win_shift_write(tx_win_shift_write), cong_window(cong_win) {}
 #endif				
 };
 
@@ -397,11 +510,19 @@ struct txAppTxSarQuery
 	//ap_uint<16> ackd;
 	ap_uint<WINDOW_BITS> 	mempt;
 	bool					write;
+	// A pointer update can carry the lookup of another session, it is applied after the update
+	ap_uint<16> 			lookupID;
+	bool					lookup;
+	// Instead of a lookup, arms the writable notification of lookupID for lowWater bytes
+	bool					arm;
+	ap_uint<16>				lowWater;
 	txAppTxSarQuery() {}
 	txAppTxSarQuery(ap_uint<16> id)
-				:sessionID(id), mempt(0), write(false) {}
+				:sessionID(id), mempt(0), write(false), lookupID(id), lookup(true), arm(false), lowWater(0) {}
 	txAppTxSarQuery(ap_uint<16> id, ap_uint<WINDOW_BITS> pt)
-			:sessionID(id), mempt(pt), write(true) {}
+			:sessionID(id), mempt(pt), write(true), lookupID(0), lookup(false), arm(false), lowWater(0) {}
+	txAppTxSarQuery(ap_uint<16> id, ap_uint<WINDOW_BITS> pt, ap_uint<16> lookupID)
+			:sessionID(id), mempt(pt), write(true), lookupID(lookupID), lookup(true), arm(false), lowWater(0) {}
 };
 
 struct rxTxSarReply
@@ -417,10 +538,10 @@ struct rxTxSarReply
 	ap_uint<WINDOW_BITS> 	slowstart_threshold;
 	rxTxSarReply() {}
 	rxTxSarReply(ap_uint<32> ack, ap_uint<32> next, ap_uint<WINDOW_BITS> cong_win, ap_uint<WINDOW_BITS> sstresh, ap_uint<2> count, bool fastRetransmitted)
-			:prevAck(ack), nextByte(next), cong_window(cong_win), slowstart_threshold(sstresh), count(count), fastRetransmitted(fastRetransmitted) {}
+			:prevAck(ack), nextByte(next), count(count), fastRetransmitted(fastRetransmitted), cong_window(cong_win), slowstart_threshold(sstresh) {}
 #if (WINDOW_SCALE)
 	rxTxSarReply(ap_uint<32> ack, ap_uint<32> next, ap_uint<WINDOW_BITS> cong_win, ap_uint<WINDOW_BITS> sstresh, ap_uint<2> count, bool fastRetransmitted, ap_uint<4> txws)
-		:prevAck(ack), nextByte(next), cong_window(cong_win), slowstart_threshold(sstresh), count(count), fastRetransmitted(fastRetransmitted), tx_win_shift(txws) {}		
+		:prevAck(ack), nextByte(next), count(count), fastRetransmitted(fastRetransmitted), tx_win_shift(txws), cong_window(cong_win), slowstart_threshold(sstresh) {}		
 #endif			
 };
 
@@ -502,11 +623,15 @@ struct txTxSarReply
 struct rxRetransmitTimerUpdate {
 	ap_uint<16> sessionID;
 	bool		stop;
+	bool		open;		// Passive open on listen port, picks the retransmit profile
+	ap_uint<16>	port;
 	rxRetransmitTimerUpdate() {}
 	rxRetransmitTimerUpdate(ap_uint<16> id)
-				:sessionID(id), stop(0) {}
+				:sessionID(id), stop(0), open(false), port(0) {}
 	rxRetransmitTimerUpdate(ap_uint<16> id, bool stop)
-				:sessionID(id), stop(stop) {}
+				:sessionID(id), stop(stop), open(false), port(0) {}
+	rxRetransmitTimerUpdate(ap_uint<16> id, ap_uint<16> port, bool open)
+				:sessionID(id), stop(true), open(open), port(port) {}
 };
 
 struct txRetransmitTimerSet {
@@ -597,7 +722,7 @@ struct cmd_internal {
 
 	cmd_internal() {}
 	cmd_internal(ap_uint<32>	addr, ap_uint<16> length)
-		:addr(addr), length(length), next_addr(addr + length) {}
+		:length(length), addr(addr), next_addr(addr(WINDOW_BITS-1, 0) + length) {}
 
 //	ap_uint<WINDOW_BITS+1> compute_next_address (){
 //		return addr(WINDOW_BITS-1,0) + length;
@@ -688,9 +813,21 @@ struct appTxRsp
 	ap_uint<16> 				length;
 	txApp_error_msg				error;
 	ap_uint<WINDOW_BITS> 		remaining_space;
+	ap_uint<16>					sessionID;
 	appTxRsp() {}
 	appTxRsp(ap_uint<16> len, ap_uint<WINDOW_BITS> rem_space, txApp_error_msg err)
-		:length(len), remaining_space(rem_space), error(err) {}
+		:length(len), error(err), remaining_space(rem_space), sessionID(0) {}
+	appTxRsp(ap_uint<16> len, ap_uint<WINDOW_BITS> rem_space, txApp_error_msg err, ap_uint<16> id)
+		:length(len), error(err), remaining_space(rem_space), sessionID(id) {}
+};
+
+struct appTxWritable
+{
+	ap_uint<16>					sessionID;
+	ap_uint<WINDOW_BITS> 		space;
+	appTxWritable() {}
+	appTxWritable(ap_uint<16> id, ap_uint<WINDOW_BITS> space)
+		:sessionID(id), space(space) {}
 };
 
 struct memDoubleAccess
@@ -718,14 +855,18 @@ struct rxStatsUpdate {
 	bool 			syn;
 	bool 			syn_ack;
 	bool 			fin;
+	bool			rst;
+	bool			drop;			// The payload was dropped
 
 	rxStatsUpdate(){}
 	rxStatsUpdate(ap_uint<16> id)
-		: id(id), length(0), syn(0), syn_ack(0), fin(0){}
+		: id(id), length(0), syn(0), syn_ack(0), fin(0), rst(0), drop(0) {}
 	rxStatsUpdate(ap_uint<16> id, ap_uint<16> length)
-		: id(id), length(length), syn(0), syn_ack(0), fin(0){}		
+		: id(id), length(length), syn(0), syn_ack(0), fin(0), rst(0), drop(0) {}
 	rxStatsUpdate(ap_uint<16> id, ap_uint<16> length, bool syn, bool syn_ack, bool fin)
-		: id(id), length(length), syn(syn), syn_ack(syn_ack), fin(fin) {}		
+		: id(id), length(length), syn(syn), syn_ack(syn_ack), fin(fin), rst(0), drop(0) {}
+	rxStatsUpdate(ap_uint<16> id, ap_uint<16> length, bool syn, bool syn_ack, bool fin, bool rst, bool drop)
+		: id(id), length(length), syn(syn), syn_ack(syn_ack), fin(fin), rst(rst), drop(drop) {}
 
 };
 
@@ -736,19 +877,78 @@ struct txStatsUpdate {
 	bool 			syn_ack;
 	bool 			fin;
 	bool 			reTx;
+	bool			rst;
+	bool			session;		// False for a RST sent without session, only the global counters change
 
 	txStatsUpdate(){}
 	txStatsUpdate(ap_uint<16> id)
-		: id(id), length(0), syn(0), syn_ack(0), fin(0), reTx(0) {}
+		: id(id), length(0), syn(0), syn_ack(0), fin(0), reTx(0), rst(0), session(true) {}
 	txStatsUpdate(ap_uint<16> id, ap_uint<16> length)
-		: id(id), length(length), syn(0), syn_ack(0), fin(0), reTx(0) {}
+		: id(id), length(length), syn(0), syn_ack(0), fin(0), reTx(0), rst(0), session(true) {}
 	txStatsUpdate(ap_uint<16> id, ap_uint<16> length, bool reTx)
-		: id(id), length(length), syn(0), syn_ack(0), fin(0), reTx(reTx) {}	
+		: id(id), length(length), syn(0), syn_ack(0), fin(0), reTx(reTx), rst(0), session(true) {}	
 	txStatsUpdate(ap_uint<16> id, ap_uint<16> length, bool syn, bool syn_ack, bool fin, bool reTx)
-		: id(id), length(length), syn(syn), syn_ack(syn_ack), fin(fin), reTx(reTx) {}		
+		: id(id), length(length), syn(syn), syn_ack(syn_ack), fin(fin), reTx(reTx), rst(0), session(true) {}		
 
 };
 
+/** @ingroup latency_histogram
+ *  Write accepted by the TX application interface, address is the buffer pointer of its first byte
+ */
+struct latAppWrite {
+	ap_uint<16>				sessionID;
+	ap_uint<WINDOW_BITS>	address;
+	latAppWrite() {}
+	latAppWrite(ap_uint<16> id, ap_uint<WINDOW_BITS> address)
+			:sessionID(id), address(address) {}
+};
+
+/** @ingroup latency_histogram
+ *  Segment with payload generated by the TX engine, in the order they go on the wire
+ */
+struct latTxSegment {
+	ap_uint<16>		sessionID;
+	ap_uint<32>		seqNumb;
+	ap_uint<16>		length;
+	bool			retransmit;
+	latTxSegment() {}
+	latTxSegment(ap_uint<16> id, ap_uint<32> seq, ap_uint<16> length, bool retransmit)
+			:sessionID(id), seqNumb(seq), length(length), retransmit(retransmit) {}
+};
+
+/** @ingroup latency_histogram
+ *  ACK number received in a synchronized state. An open is sent when a connection starts,
+ *  with the listen port if it was a passive open
+ */
+struct latAck {
+	ap_uint<16>		sessionID;
+	ap_uint<32>		ackNumb;
+	bool			open;
+	bool			passive;
+	ap_uint<16>		port;
+	latAck() {}
+	latAck(ap_uint<16> id, ap_uint<32> ack)
+			:sessionID(id), ackNumb(ack), open(false), passive(false), port(0) {}
+	latAck(ap_uint<16> id, bool passive, ap_uint<16> port)
+			:sessionID(id), ackNumb(0), open(true), passive(passive), port(port) {}
+};
+
+/** @ingroup latency_histogram
+ *  Smoothed RTT of a session, for the statistics
+ */
+struct latRttUpdate {
+	ap_uint<16>		sessionID;
+	ap_uint<32>		srtt;
+	latRttUpdate() {}
+	latRttUpdate(ap_uint<16> id, ap_uint<32> srtt)
+			:sessionID(id), srtt(srtt) {}
+};
+
+/** @ingroup statistics
+ *  A rising edge of readEnable reads the counters of session userID. The global counters are
+ *  updated every cycle, snapshotInterval is the number of cycles between two snapshots of all
+ *  sessions on the snapshot stream, 0 turns the snapshots off.
+ */
 struct statsRegs {
 	bool 			readEnable;
     ap_uint<16> 	userID;
@@ -757,7 +957,89 @@ struct statsRegs {
     ap_uint<54> 	txRetransmissions;
     ap_uint<64> 	rxBytes;
     ap_uint<54> 	rxPackets;
+    ap_uint<32> 	rxDrops;
     ap_uint<32> 	connectionRTT;
+    ap_uint<32> 	snapshotInterval;
+    ap_uint<32> 	snapshotCount;
+    ap_uint<64> 	globalTxBytes;
+    ap_uint<54> 	globalTxPackets;
+    ap_uint<32> 	globalTxRetransmissions;
+    ap_uint<32> 	globalTxSyn;
+    ap_uint<32> 	globalTxRst;
+    ap_uint<64> 	globalRxBytes;
+    ap_uint<54> 	globalRxPackets;
+    ap_uint<32> 	globalRxDrops;
+    ap_uint<32> 	globalRxSyn;
+    ap_uint<32> 	globalRxRst;
+};
+
+/** @ingroup instrumentation
+ *  Instrumentation registers. latencyCount is the bucket selected by latencyBucket of the
+ *  histogram of the cycles between a packet entering at ipRxData and the next packet leaving
+ *  at ipTxData. The stall cycles count the cycles a probe could not forward a word
+ */
+struct instrRegs {
+	ap_uint<5>		latencyBucket;
+	ap_uint<32>		latencyCount;
+	ap_uint<32>		latencySamples;
+	ap_uint<32>		latencyMax;
+	ap_uint<64>		latencySum;
+	ap_uint<32>		rxPackets;
+	ap_uint<32>		txPackets;
+	ap_uint<32>		rxStallCycles;
+	ap_uint<32>		txStallCycles;
+};
+
+/** @ingroup latency_histogram
+ *  Latency histogram registers. A rising edge of readEnable reads bucket of the histogram
+ *  selected by kind (0 application write to wire, 1 round trip) and group into bucketCount,
+ *  and the smoothed RTT of sessionID. A rising edge of clear empties both histograms of group.
+ *  portWrite and sessionWrite assign groups, like the retransmit policy
+ */
+struct latencyRegs {
+	ap_uint<1>					readEnable;
+	ap_uint<1>					kind;
+	ap_uint<LAT_GROUP_BITS>		group;
+	ap_uint<7>					bucket;
+	ap_uint<32>					bucketCount;
+	ap_uint<32>					bucketLow;
+	ap_uint<16>					sessionID;
+	ap_uint<32>					sessionRTT;
+	ap_uint<1>					clear;
+	ap_uint<1>					clearBusy;
+	ap_uint<1>					portWrite;
+	ap_uint<2>					portRuleID;
+	ap_uint<1>					portRuleValid;
+	ap_uint<16>					listenPort;
+	ap_uint<LAT_GROUP_BITS>		portGroup;
+	ap_uint<1>					sessionWrite;
+	ap_uint<LAT_GROUP_BITS>		sessionGroup;
+	ap_uint<32>					appSamples;
+	ap_uint<32>					rttSamples;
+};
+
+/** @ingroup retransmit_timer
+ *  Retransmit policy, a rising edge of profileWrite stores the profile fields under profileID,
+ *  of portWrite the rule portRuleID which gives listenPort the profile portProfile and of
+ *  sessionWrite the profile of sessionID. rtoMin and rtoMax count table scans of MAX_SESSIONS
+ *  cycles, every time-out shifts the interval left by backoffShift.
+ */
+struct rtPolicyRegs {
+	ap_uint<1>					profileWrite;
+	ap_uint<RT_PROFILE_BITS>	profileID;
+	ap_uint<32>					rtoMin;
+	ap_uint<32>					rtoMax;
+	ap_uint<2>					backoffShift;
+	ap_uint<3>					maxRetries;
+	ap_uint<3>					synMaxRetries;
+	ap_uint<1>					portWrite;
+	ap_uint<2>					portRuleID;
+	ap_uint<1>					portRuleValid;
+	ap_uint<16>					listenPort;
+	ap_uint<RT_PROFILE_BITS>	portProfile;
+	ap_uint<1>					sessionWrite;
+	ap_uint<16>					sessionID;
+	ap_uint<RT_PROFILE_BITS>	sessionProfile;
 };
 
 struct iperf_regs {
@@ -812,10 +1094,29 @@ void toe(
 			stream<axiWord>&						rxDataRsp,							
 			stream<openStatus>&						openConnRsp,
 			stream<appTxRsp>&						txAppDataRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			stream<appTxWritable>&					txAppWritable,
+#endif
 
 #if (STATISTICS_MODULE)
 		   	statsRegs& 								stat_regs,			
+			stream<axiWord>&						statsSnapshot,
+#endif
+#if (RT_POLICY_TABLE)
+			rtPolicyRegs&							rt_policy_regs,
 #endif	
+#if (DROP_REPORTS)
+			stream<dropReport>&						dropReportOut,
+#if (DROP_CAPTURE)
+			stream<axiWord>&						dropCaptureOut,
+#endif
+#endif
+#if (INSTRUMENTATION)
+			instrRegs&								instr_regs,
+#endif
+#if (LATENCY_HISTOGRAM)
+			latencyRegs&							latency_regs,
+#endif
 
 			//IP Address Input
 			ap_uint<32>&							myIpAddress,
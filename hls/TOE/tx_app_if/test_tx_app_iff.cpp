@@ -44,6 +44,8 @@ int main()
 	//stream<ap_uint<1> >&			txApp2portTable_port_req;
 	stream<stateQuery>				txApp2stateTable_upd_req;
 	stream<event>					txApp2eventEng_setEvent;
+	stream<openStatus>				rtTimer2txApp_notification;
+	ap_uint<32>						myIpAddress = 0x0101010a;
 
 	portTable2txApp_port_rsp.write(32768);
 	stateQuery query;
@@ -70,7 +72,9 @@ int main()
 					txApp2sLookup_req,
 					//stream<ap_uint<1> >&			txApp2portTable_port_req,
 					txApp2stateTable_upd_req,
-					txApp2eventEng_setEvent);
+					txApp2eventEng_setEvent,
+					rtTimer2txApp_notification,
+					myIpAddress);
 		if (!txApp2sLookup_req.empty())
 		{
 			txApp2sLookup_req.read();
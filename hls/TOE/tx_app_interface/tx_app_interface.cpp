@@ -128,25 +128,133 @@ void txAppStatusHandler(stream<mmStatus>&				txBufferWriteStatus,
 	}
 }
 
+#if (TX_APP_WRITABLE_NOTIFICATION)
+/** @ingroup tx_app_interface
+ *  Space a write request of the session can use, the smallest of the free TX buffer
+ *  and, with TCP_NODELAY, of the unused window of the other end
+ */
+ap_uint<WINDOW_BITS> tat_writableSpace(
+#if (TCP_NODELAY)
+										ap_uint<WINDOW_BITS>	min_window,
+#endif
+										ap_uint<WINDOW_BITS>	ackd,
+										ap_uint<WINDOW_BITS>	mempt)
+{
+#pragma HLS INLINE
+	ap_uint<WINDOW_BITS> space = (ackd - mempt) - 1;
+#if (TCP_NODELAY)
+	ap_uint<WINDOW_BITS> usedLength = mempt - ackd;
+	ap_uint<WINDOW_BITS> usableWindow = 0;
+
+	if (min_window > usedLength) {
+		usableWindow = min_window - usedLength;
+	}
+	if (usableWindow < space) {
+		space = usableWindow;
+	}
+#endif
+	return space;
+}
+
+/** @ingroup tx_app_interface
+ *  Merges the notifications raised by ACKs and the ones raised when a notification is armed
+ */
+void txAppWritableMerger(	stream<appTxWritable>&	txApp_ackWritable,
+							stream<appTxWritable>&	txApp_armWritable,
+							stream<appTxWritable>&	appTxWritableOut)
+{
+#pragma HLS PIPELINE II=1
+
+	if (!txApp_ackWritable.empty()) {
+		appTxWritableOut.write(txApp_ackWritable.read());
+	}
+	else if (!txApp_armWritable.empty()) {
+		appTxWritableOut.write(txApp_armWritable.read());
+	}
+}
+#endif
+
+/** @ingroup tx_app_interface
+ *  Keeps the ACK and app pointers of every session for tx_app_stream_if.
+ *  With TX_APP_WRITABLE_NOTIFICATION it also keeps the armed notifications, an ACK
+ *  which gives a session at least its low water mark of space fires and disarms it.
+ *  A notification armed when the space is already there fires right away.
+ */
 void tx_app_table(	stream<txSarAckPush>&		txSar2txApp_ack_push,
 					stream<txAppTxSarQuery>&	txApp_upd_req,
+#if (TX_APP_WAIT_FOR_SPACE)
+					stream<txSarAckPush>&		txApp2txAppStream_wakeup,
+#endif
+#if (TX_APP_WRITABLE_NOTIFICATION)
+					stream<appTxWritable>&		txApp_ackWritable,
+					stream<appTxWritable>&		txApp_armWritable,
+#endif
 					stream<txAppTxSarReply>&	txApp_upd_rsp)
 {
 #pragma HLS PIPELINE II=1
 
 	static txAppTableEntry app_table[MAX_SESSIONS];
 	#pragma HLS RESOURCE variable=app_table core=RAM_T2P_BRAM
+	#pragma HLS DEPENDENCE variable=app_table inter false
+
+#if (TX_APP_WRITABLE_NOTIFICATION)
+	// The app pointer is kept when the notification is armed, a write of the session disarms it
+	static ap_uint<MAX_SESSIONS>	tat_armed = 0;
+	static ap_uint<16>				tat_lowWater[MAX_SESSIONS];
+	static ap_uint<WINDOW_BITS>		tat_armMempt[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=tat_lowWater core=RAM_2P_BRAM
+	#pragma HLS RESOURCE variable=tat_armMempt core=RAM_2P_BRAM
+	#pragma HLS DEPENDENCE variable=tat_lowWater inter false
+	#pragma HLS DEPENDENCE variable=tat_armMempt inter false
+	ap_uint<WINDOW_BITS>			space;
+	ap_uint<16>						ackLowWater;
+	ap_uint<WINDOW_BITS>			ackArmMempt;
+	bool							ackArmed = false;
+#endif
 
 	txSarAckPush	ackPush;
 	txAppTxSarQuery txAppUpdate;
+	txAppTableEntry	entry;
+	bool			ackPushValid = false;
+	bool			queryValid = false;
 
+	// An ACK and a query are served in the same cycle, except the init of a session which
+	// also writes the app pointer
 	if (!txSar2txApp_ack_push.empty()) {
 		txSar2txApp_ack_push.read(ackPush);
+		ackPushValid = true;
+	}
+	if ((!ackPushValid || !ackPush.init) && !txApp_upd_req.empty()) {
+		txApp_upd_req.read(txAppUpdate);
+		queryValid = true;
+		entry = app_table[txAppUpdate.lookupID];
+	}
+
+	if (ackPushValid) {
+#if (TX_APP_WAIT_FOR_SPACE)
+		txApp2txAppStream_wakeup.write(ackPush);
+#endif
+#if (TX_APP_WRITABLE_NOTIFICATION)
+		ackArmed 	= tat_armed.bit(ackPush.sessionID) && !ackPush.init;
+		ackLowWater = tat_lowWater[ackPush.sessionID];
+		ackArmMempt = tat_armMempt[ackPush.sessionID];
+#if (TCP_NODELAY)
+		space 		= tat_writableSpace(ackPush.min_window, ackPush.ackd, ackArmMempt);
+#else
+		space 		= tat_writableSpace(ackPush.ackd, ackArmMempt);
+#endif
+		if (ackPush.init || (ackArmed && (space >= ackLowWater))) {
+			tat_armed.bit(ackPush.sessionID) = 0;
+		}
+		if (ackArmed && (space >= ackLowWater)) {
+			txApp_ackWritable.write(appTxWritable(ackPush.sessionID, space));
+		}
+#endif
 		if (ackPush.init) {
 			// At init this is actually not_ackd
 			app_table[ackPush.sessionID].ackd = ackPush.ackd-1;
 			app_table[ackPush.sessionID].mempt = ackPush.ackd;
-			std::cout << "tx_app_table  .ackd " << std::hex << app_table[ackPush.sessionID].ackd << "\t.mempt " << app_table[ackPush.sessionID].mempt << std::endl;
+			std::cout << "tx_app_table  .ackd " << std::hex << app_table[ackPush.sessionID].ackd << "\t.mempt " << app_table[ackPush.sessionID].mempt << std::dec << std::endl;
 #if (TCP_NODELAY)
 			app_table[ackPush.sessionID].min_window = ackPush.min_window;
 #endif			
@@ -156,20 +264,49 @@ void tx_app_table(	stream<txSarAckPush>&		txSar2txApp_ack_push,
 #if (TCP_NODELAY)
 			app_table[ackPush.sessionID].min_window = ackPush.min_window;
 #endif			
+			if (queryValid && (ackPush.sessionID == txAppUpdate.lookupID)) {
+				entry.ackd = ackPush.ackd;
+#if (TCP_NODELAY)
+				entry.min_window = ackPush.min_window;
+#endif
+			}
 		}
 	}
-	else if (!txApp_upd_req.empty()) {
-		txApp_upd_req.read(txAppUpdate);
-		// Write
+
+	if (queryValid) {
+		// A write and a read of two sessions share the access, the write goes first
 		if(txAppUpdate.write) {
 			app_table[txAppUpdate.sessionID].mempt = txAppUpdate.mempt;
+			if (txAppUpdate.sessionID == txAppUpdate.lookupID) {
+				entry.mempt = txAppUpdate.mempt;
+			}
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			tat_armed.bit(txAppUpdate.sessionID) = 0;
+#endif
 		}
-		else { // Read
-		
+#if (TX_APP_WRITABLE_NOTIFICATION)
+		if (txAppUpdate.arm) {
+#if (TCP_NODELAY)
+			space = tat_writableSpace(entry.min_window, entry.ackd, entry.mempt);
+#else
+			space = tat_writableSpace(entry.ackd, entry.mempt);
+#endif
+			if (space >= txAppUpdate.lowWater) {
+				// An ACK arrived since the request was refused
+				txApp_armWritable.write(appTxWritable(txAppUpdate.lookupID, space));
+			}
+			else {
+				tat_armed.bit(txAppUpdate.lookupID) = 1;
+				tat_lowWater[txAppUpdate.lookupID] 	= txAppUpdate.lowWater;
+				tat_armMempt[txAppUpdate.lookupID] 	= entry.mempt;
+			}
+		}
+#endif
+		if (txAppUpdate.lookup) {
 #if !(TCP_NODELAY)
-			txApp_upd_rsp.write(txAppTxSarReply(txAppUpdate.sessionID, app_table[txAppUpdate.sessionID].ackd, app_table[txAppUpdate.sessionID].mempt));
+			txApp_upd_rsp.write(txAppTxSarReply(txAppUpdate.lookupID, entry.ackd, entry.mempt));
 #else
-			txApp_upd_rsp.write(txAppTxSarReply(txAppUpdate.sessionID, app_table[txAppUpdate.sessionID].ackd, app_table[txAppUpdate.sessionID].mempt, app_table[txAppUpdate.sessionID].min_window));
+			txApp_upd_rsp.write(txAppTxSarReply(txAppUpdate.lookupID, entry.ackd, entry.mempt, entry.min_window));
 #endif
 		}
 	}
@@ -191,6 +328,9 @@ void tx_app_interface(
 					stream<openStatus>&				conEstablishedFifo,
 
 					stream<appTxRsp>&				appTxDataRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+					stream<appTxWritable>&			appTxWritableOut,
+#endif
 					stream<ap_uint<16> >&			txApp2stateTable_req,
 					stream<mmCmd>&					txBufferWriteCmd,
 					stream<axiWord>&				txBufferWriteData,
@@ -201,6 +341,9 @@ void tx_app_interface(
 					//stream<ap_uint<1> >&			txApp2portTable_port_req,
 					stream<stateQuery>&				txApp2stateTable_upd_req,
 					stream<event>&					txApp2eventEng_setEvent,
+#if (LATENCY_HISTOGRAM)
+					stream<latAppWrite>&			txApp2latency_write,
+#endif
 					stream<openStatus>&				rtTimer2txApp_notification,
 					ap_uint<32>&					myIpAddress)
 {
@@ -225,10 +368,25 @@ void tx_app_interface(
 	static stream<txAppTxSarQuery>		txApp2txSar_upd_req("txApp2txSar_upd_req");
 	static stream<txAppTxSarReply>		txSar2txApp_upd_rsp("txSar2txApp_upd_rsp");
 	#pragma HLS stream variable=txApp2txSar_upd_req		depth=2
-	#pragma HLS stream variable=txSar2txApp_upd_rsp		depth=2
+	#pragma HLS stream variable=txSar2txApp_upd_rsp		depth=TASI_MAX_INFLIGHT
 	#pragma HLS DATA_PACK variable=txApp2txSar_upd_req
 	#pragma HLS DATA_PACK variable=txSar2txApp_upd_rsp
 
+#if (TX_APP_WAIT_FOR_SPACE)
+	static stream<txSarAckPush>			txApp2txAppStream_wakeup("txApp2txAppStream_wakeup");
+	#pragma HLS stream variable=txApp2txAppStream_wakeup	depth=4
+	#pragma HLS DATA_PACK variable=txApp2txAppStream_wakeup
+#endif
+
+#if (TX_APP_WRITABLE_NOTIFICATION)
+	static stream<appTxWritable>		txApp_ackWritable("txApp_ackWritable");
+	static stream<appTxWritable>		txApp_armWritable("txApp_armWritable");
+	#pragma HLS stream variable=txApp_ackWritable	depth=4
+	#pragma HLS stream variable=txApp_armWritable	depth=4
+	#pragma HLS DATA_PACK variable=txApp_ackWritable
+	#pragma HLS DATA_PACK variable=txApp_armWritable
+#endif
+
 	// Before merging, check status for TX
 	//txAppEvSplitter(txAppStream2event_mergeEvent, tasi_txSplit2mergeFifo, txApp_txEventCache);
 	//txAppStatusHandler(txBufferWriteStatus, txApp_txEventCache, txApp2txSar_push);
@@ -256,11 +414,17 @@ void tx_app_interface(
 						appTxDataReq,
 						stateTable2txApp_rsp,
 						txSar2txApp_upd_rsp,
+#if (TX_APP_WAIT_FOR_SPACE)
+						txApp2txAppStream_wakeup,
+#endif
 						appTxDataRsp,
 						txApp2stateTable_req,
 						txApp2txSar_upd_req,
 						txBufferWriteCmd,
 						txBufferWriteData,
+#if (LATENCY_HISTOGRAM)
+						txApp2latency_write,
+#endif
 						txAppStream2event_mergeEvent);
 
 	// TX Application Interface
@@ -281,5 +445,18 @@ void tx_app_interface(
 	// TX App Meta Table
 	tx_app_table(	txSar2txApp_ack_push,
 					txApp2txSar_upd_req,
+#if (TX_APP_WAIT_FOR_SPACE)
+					txApp2txAppStream_wakeup,
+#endif
+#if (TX_APP_WRITABLE_NOTIFICATION)
+					txApp_ackWritable,
+					txApp_armWritable,
+#endif
 					txSar2txApp_upd_rsp);
+
+#if (TX_APP_WRITABLE_NOTIFICATION)
+	txAppWritableMerger(	txApp_ackWritable,
+							txApp_armWritable,
+							appTxWritableOut);
+#endif
 }
@@ -42,6 +42,23 @@ struct txAppTableEntry
 #endif	
 };
 
+void tx_app_table(	stream<txSarAckPush>&		txSar2txApp_ack_push,
+					stream<txAppTxSarQuery>&	txApp_upd_req,
+#if (TX_APP_WAIT_FOR_SPACE)
+					stream<txSarAckPush>&		txApp2txAppStream_wakeup,
+#endif
+#if (TX_APP_WRITABLE_NOTIFICATION)
+					stream<appTxWritable>&		txApp_ackWritable,
+					stream<appTxWritable>&		txApp_armWritable,
+#endif
+					stream<txAppTxSarReply>&	txApp_upd_rsp);
+
+#if (TX_APP_WRITABLE_NOTIFICATION)
+void txAppWritableMerger(	stream<appTxWritable>&	txApp_ackWritable,
+							stream<appTxWritable>&	txApp_armWritable,
+							stream<appTxWritable>&	appTxWritableOut);
+#endif
+
 void tx_app_interface(						
 					stream<appTxMeta>&			 	appTxDataReqMetadata,
 					stream<axiWord>&				appTxDataReq,
@@ -57,6 +74,9 @@ void tx_app_interface(
 					stream<openStatus>&				conEstablishedFifo,
 
 					stream<appTxRsp>&				appTxDataRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+					stream<appTxWritable>&			appTxWritableOut,
+#endif
 					stream<ap_uint<16> >&			txApp2stateTable_req,
 					stream<mmCmd>&					txBufferWriteCmd,
 					stream<axiWord>&				txBufferWriteData,
@@ -67,5 +87,8 @@ void tx_app_interface(
 					//stream<ap_uint<1> >&			txApp2portTable_port_req,
 					stream<stateQuery>&				txApp2stateTable_upd_req,
 					stream<event>&					txApp2eventEng_setEvent,
+#if (LATENCY_HISTOGRAM)
+					stream<latAppWrite>&			txApp2latency_write,
+#endif
 					stream<openStatus>&				rtTimer2txApp_notification,
 					ap_uint<32>&					myIpAddress);
\ No newline at end of file
@@ -26,119 +26,401 @@ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABI
 OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
 EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx, Inc.
 ************************************************/
-#include "tx_app_stream_if.hpp"
+#include "../tx_app_interface/tx_app_interface.hpp"
 #include <iostream>
-
+#include <iomanip>
+#include <deque>
+#include <vector>
 
 using namespace hls;
 
-void simStateTable(stream<stateQuery>& req, stream<sessionState>& rsp)
+/*
+ * Benchmark of the write requests of tx_app_stream_if. The interface runs with the
+ * tx_app_table, 64 sessions write to the TOE and a model of the TX SAR table ACKs every
+ * write after a fixed amount of cycles. The application keeps one request per session,
+ * it sends the data as soon as a request is accepted and retries a refused request after
+ * 100 cycles, or with TX_APP_WRITABLE_NOTIFICATION when the session is notified writable. Besides the requests per cycle the benchmark checks
+ * that the writes of every session are placed one after the other in the TX buffer.
+ */
+
+static const int NUM_SESSIONS 	= 64;
+static const int RETRY_CYCLES 	= 100;
+
+struct benchConfig {
+	const char*			name;
+	int					length;
+	int					ackLatency;
+	int					window;
+	int					cycles;
+};
+
+struct pendingAck {
+	uint64_t				cycle;
+	ap_uint<16>				sessionID;
+	ap_uint<WINDOW_BITS>	ackd;
+};
+
+void simStateTable(stream<ap_uint<16> >& req, stream<sessionState>& rsp)
 {
-	if (!req.empty())
-	{
+	if (!req.empty()) {
 		req.read();
 		rsp.write(ESTABLISHED);
 	}
 }
 
-void simTxSar(stream<txAppTxSarQuery>& req, stream<txAppTxSarPush>& push, stream<txAppTxSarReply>& rsp)
+/*
+ * Returns the number of errors
+ */
+int runBenchmark(const benchConfig& cfg, ap_uint<WINDOW_BITS> memptBase)
 {
-	txAppTxSarQuery query;
-	if (!req.empty())
-	{
-		req.read(query);
-		if (!query.write)
-		{
-			rsp.write(txAppTxSarReply(query.sessionID, 0xad01, 0x2911));
-		}
-	}
+	stream<appTxMeta>				appTxDataReqMetaData("appTxDataReqMetaData");
+	stream<axiWord>					appTxDataReq("appTxDataReq");
+	stream<sessionState>			stateTable2txApp_rsp("stateTable2txApp_rsp");
+	stream<txAppTxSarReply>			txSar2txApp_upd_rsp("txSar2txApp_upd_rsp");
+	stream<appTxRsp>				appTxDataRsp("appTxDataRsp");
+	stream<ap_uint<16> >			txApp2stateTable_req("txApp2stateTable_req");
+	stream<txAppTxSarQuery>			txApp2txSar_upd_req("txApp2txSar_upd_req");
+	stream<mmCmd>					txBufferWriteCmd("txBufferWriteCmd");
+	stream<axiWord>					txBufferWriteData("txBufferWriteData");
+	stream<event>					txAppStream2eventEng_setEvent("txAppStream2eventEng_setEvent");
+#if (LATENCY_HISTOGRAM)
+	stream<latAppWrite>				txAppStream2latency_write("txAppStream2latency_write");
+#endif
+	stream<txSarAckPush>			txSar2txApp_ack_push("txSar2txApp_ack_push");
+	stream<txSarAckPush>			txApp2txAppStream_wakeup("txApp2txAppStream_wakeup");
+	stream<appTxWritable>			txApp_ackWritable("txApp_ackWritable");
+	stream<appTxWritable>			txApp_armWritable("txApp_armWritable");
+	stream<appTxWritable>			appTxWritableOut("appTxWritableOut");
 
-	if (!push.empty())
-	{
-		push.read();
-	}
-}
+	std::vector<bool>					outstanding(NUM_SESSIONS, false);
+	std::vector<uint64_t>				retryCycle(NUM_SESSIONS, 0);
+	std::vector<ap_uint<WINDOW_BITS> >	expectedMempt(NUM_SESSIONS, memptBase);
+	std::deque<int>						sendQueue;
+	std::deque<pendingAck>				acks;
+	int 		wordsLeft 	= 0;
+	int 		drainCycles = 0;
+	int 		nextSession = 0;
+	int 		errors 		= 0;
+	uint64_t 	requests 	= 0;
+	uint64_t 	accepted 	= 0;
+	uint64_t 	refused 	= 0;
+	uint64_t 	notifications = 0;
+	uint64_t 	acceptedInRun = 0;
+	uint64_t 	bufferBytes = 0;
+	uint64_t 	cycle 		= 0;
+	const int 	wordsPerWrite = (cfg.length + 63) / 64;
 
+	for (int i = 0; i < NUM_SESSIONS; i++) {
+		txSar2txApp_ack_push.write(txSarAckPush(i, memptBase, cfg.window, 1));
+	}
 
-int main(int argc, char* argv[])
-{
-	stream<ap_uint<16> >			appTxDataReqMetaData;
-	stream<axiWord>					appTxDataReq("appTxDataReq");
-	stream<sessionState>			stateTable2txApp_rsp;
-	stream<txAppTxSarReply>			txSar2txApp_upd_rsp; //TODO rename
-	stream<mmStatus>				txBufferWriteStatus;
-	stream<ap_int<17> >				appTxDataRsp;
-	stream<stateQuery>				txApp2stateTable_req; //make ap_uint<16>
-	stream<txAppTxSarQuery>			txApp2txSar_upd_req; //TODO rename
-	stream<mmCmd>					txBufferWriteCmd;
-	stream<axiWord>					txBufferWriteData;
-	stream<txAppTxSarPush>			txApp2txSar_app_push;
-	stream<event>					txAppStream2eventEng_setEvent;
+	// Requests are issued during cfg.cycles, then every request has to be answered
+	while (cycle < (uint64_t) cfg.cycles + 200000) {
+		bool running = (cycle < (uint64_t) cfg.cycles);
+		bool idle = true;
+		for (int i = 0; i < NUM_SESSIONS; i++) {
+			idle &= !outstanding[i];
+		}
+		if (!running && idle && sendQueue.empty() && (wordsLeft == 0) && appTxDataReq.empty()) {
+			if (drainCycles++ == 100) {
+				break;
+			}
+		}
 
+		// Application, one request per cycle round robin over the sessions. It stops asking
+		// while the data of the accepted requests is waiting to be sent
+		if (running && (cycle >= NUM_SESSIONS) && (sendQueue.size() < 4)) {
+			for (int i = 0; i < NUM_SESSIONS; i++) {
+				int id = (nextSession + i) % NUM_SESSIONS;
+				if (!outstanding[id] && (retryCycle[id] <= cycle)) {
+					appTxDataReqMetaData.write(appTxMeta(id, cfg.length));
+					outstanding[id] = true;
+					nextSession = id + 1;
+					requests++;
+					break;
+				}
+			}
+		}
+		if (!appTxDataRsp.empty()) {
+			appTxRsp response = appTxDataRsp.read();
+			int id = response.sessionID;
+			outstanding[id] = false;
+			if (response.error == NO_ERROR) {
+				sendQueue.push_back(id);
+				accepted++;
+				if (running) {
+					acceptedInRun++;
+				}
+			}
+			else {
+#if (TX_APP_WRITABLE_NOTIFICATION)
+				retryCycle[id] = ~0ULL;
+#else
+				retryCycle[id] = cycle + RETRY_CYCLES;
+#endif
+				refused++;
+			}
+		}
+		if (!appTxWritableOut.empty()) {
+			retryCycle[appTxWritableOut.read().sessionID] = 0;
+			notifications++;
+		}
+		if ((wordsLeft == 0) && !sendQueue.empty()) {
+			sendQueue.pop_front();
+			wordsLeft = wordsPerWrite;
+		}
+		if ((wordsLeft != 0) && (appTxDataReq.size() < 4)) {
+			axiWord word(0, 0, 0);
+			int bytes = (wordsLeft == 1) ? cfg.length - (wordsPerWrite - 1) * 64 : 64;
+			word.keep = lowMask<64>(bytes);
+			word.last = (wordsLeft == 1);
+			appTxDataReq.write(word);
+			wordsLeft--;
+		}
 
-	axiWord input;
-	axiWord output;
-
-	//initial
-	ap_uint<16> sessionID = 3;
-	appTxDataReqMetaData.write(sessionID);
-	input.data = 2353456;
-	input.keep = 0xff;
-	input.last = 0;
-	appTxDataReq.write(input);
-	input.data = 908348249;
-	input.keep = 0x3f;
-	input.last = 1;
-	appTxDataReq.write(input);
-
-	event ev;
-	ap_int<17>  returnCode;
-	int count = 0;
-	int replyCount;
-	while (count < 500)
-	{
 		tx_app_stream_if(	appTxDataReqMetaData,
 							appTxDataReq,
 							stateTable2txApp_rsp,
 							txSar2txApp_upd_rsp,
-							txBufferWriteStatus,
+#if (TX_APP_WAIT_FOR_SPACE)
+							txApp2txAppStream_wakeup,
+#endif
 							appTxDataRsp,
 							txApp2stateTable_req,
 							txApp2txSar_upd_req,
 							txBufferWriteCmd,
 							txBufferWriteData,
-							txApp2txSar_app_push,
+#if (LATENCY_HISTOGRAM)
+							txAppStream2latency_write,
+#endif
 							txAppStream2eventEng_setEvent);
 		simStateTable(txApp2stateTable_req, stateTable2txApp_rsp);
-		simTxSar(txApp2txSar_upd_req, txApp2txSar_app_push, txSar2txApp_upd_rsp);
+		tx_app_table(	txSar2txApp_ack_push,
+						txApp2txSar_upd_req,
+#if (TX_APP_WAIT_FOR_SPACE)
+						txApp2txAppStream_wakeup,
+#endif
+#if (TX_APP_WRITABLE_NOTIFICATION)
+						txApp_ackWritable,
+						txApp_armWritable,
+#endif
+						txSar2txApp_upd_rsp);
+#if (TX_APP_WRITABLE_NOTIFICATION)
+		txAppWritableMerger(txApp_ackWritable, txApp_armWritable, appTxWritableOut);
+#endif
 
-		if (!txBufferWriteCmd.empty())
-		{
-			txBufferWriteCmd.read();
-			replyCount = count + 200;
+#if (LATENCY_HISTOGRAM)
+		while (!txAppStream2latency_write.empty()) {
+			txAppStream2latency_write.read();
 		}
-		if (!txBufferWriteData.empty())
-		{
-			txBufferWriteData.read(output);
-			std::cout << output.data << "\t" << output.keep << "\t" << output.last << std::endl;
+#endif
+
+		// TX SAR model, the other end ACKs every write after a while
+		if (!txAppStream2eventEng_setEvent.empty()) {
+			event ev = txAppStream2eventEng_setEvent.read();
+			if (ev.address != expectedMempt[ev.sessionID]) {
+				std::cout << "ERROR session " << ev.sessionID << " writes at " << std::hex << ev.address;
+				std::cout << " instead of " << expectedMempt[ev.sessionID] << std::dec << std::endl;
+				errors++;
+			}
+			expectedMempt[ev.sessionID] = ev.address + ev.length;
+			pendingAck ack = {cycle + cfg.ackLatency, ev.sessionID, ev.address + ev.length};
+			acks.push_back(ack);
 		}
-		if (!txAppStream2eventEng_setEvent.empty())
-		{
-			txAppStream2eventEng_setEvent.read(ev);
-			std::cout << "Event: " << ev.sessionID << " " <<  ev.type <<  std::endl;
+		if (!acks.empty() && (acks.front().cycle <= cycle) && txSar2txApp_ack_push.empty()) {
+			txSar2txApp_ack_push.write(txSarAckPush(acks.front().sessionID, acks.front().ackd, cfg.window, 0));
+			acks.pop_front();
 		}
-		if (!appTxDataRsp.empty())
-		{
-			appTxDataRsp.read(returnCode);
-			std::cout << "Return: " << returnCode <<  std::endl;
+
+		// TX buffer
+		if (!txBufferWriteCmd.empty()) {
+			bufferBytes += txBufferWriteCmd.read().bbt;
 		}
-		if (count == replyCount)
-		{
-			txBufferWriteStatus.write(mmStatus({0, 0, 0, 0, 1}));
+		if (!txBufferWriteData.empty()) {
+			txBufferWriteData.read();
 		}
-		count++;
+		cycle++;
 	}
 
+	if (bufferBytes != accepted * cfg.length) {
+		std::cout << "ERROR " << bufferBytes << " bytes written to the TX buffer, expected " << accepted * cfg.length << std::endl;
+		errors++;
+	}
+	for (int i = 0; i < NUM_SESSIONS; i++) {
+		if (outstanding[i]) {
+			std::cout << "ERROR request of session " << i << " never answered" << std::endl;
+			errors++;
+		}
+	}
+
+	std::cout << std::left << std::setw(10) << cfg.name << std::right << std::fixed << std::setprecision(3);
+	std::cout << "  writes/cycle " << std::setw(6) << (double) acceptedInRun / (cfg.cycles - NUM_SESSIONS);
+	std::cout << "  bytes/cycle " << std::setw(8) << (double) acceptedInRun * cfg.length / (cfg.cycles - NUM_SESSIONS);
+	std::cout << "  requests " << std::setw(7) << requests << "  refused " << std::setw(7) << refused;
+	std::cout << "  notifications " << std::setw(6) << notifications;
+	std::cout << "  requests per write " << (double) requests / accepted << std::endl;
+
+	return errors;
+}
+
+#if (TX_APP_WAIT_FOR_SPACE)
+/*
+ * tx_app_stream_if with the tx_app_table, the test plays the application and the ACKs
+ */
+struct tasiBench {
+	stream<appTxMeta>				appTxDataReqMetaData;
+	stream<axiWord>					appTxDataReq;
+	stream<sessionState>			stateTable2txApp_rsp;
+	stream<txAppTxSarReply>			txSar2txApp_upd_rsp;
+	stream<appTxRsp>				appTxDataRsp;
+	stream<ap_uint<16> >			txApp2stateTable_req;
+	stream<txAppTxSarQuery>			txApp2txSar_upd_req;
+	stream<mmCmd>					txBufferWriteCmd;
+	stream<axiWord>					txBufferWriteData;
+	stream<event>					txAppStream2eventEng_setEvent;
+#if (LATENCY_HISTOGRAM)
+	stream<latAppWrite>				txAppStream2latency_write;
+#endif
+	stream<txSarAckPush>			txSar2txApp_ack_push;
+	stream<txSarAckPush>			txApp2txAppStream_wakeup;
+	stream<appTxWritable>			txApp_ackWritable;
+	stream<appTxWritable>			txApp_armWritable;
+	std::deque<appTxRsp>			responses;
+
+	// Runs the interface, the data of every accepted request is sent right away
+	void run(int cycles) {
+		for (int i = 0; i < cycles; i++) {
+			tx_app_stream_if(	appTxDataReqMetaData,
+								appTxDataReq,
+								stateTable2txApp_rsp,
+								txSar2txApp_upd_rsp,
+								txApp2txAppStream_wakeup,
+								appTxDataRsp,
+								txApp2stateTable_req,
+								txApp2txSar_upd_req,
+								txBufferWriteCmd,
+								txBufferWriteData,
+#if (LATENCY_HISTOGRAM)
+								txAppStream2latency_write,
+#endif
+								txAppStream2eventEng_setEvent);
+			simStateTable(txApp2stateTable_req, stateTable2txApp_rsp);
+			tx_app_table(	txSar2txApp_ack_push,
+							txApp2txSar_upd_req,
+							txApp2txAppStream_wakeup,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+							txApp_ackWritable,
+							txApp_armWritable,
+#endif
+							txSar2txApp_upd_rsp);
+			if (!appTxDataRsp.empty()) {
+				appTxRsp response = appTxDataRsp.read();
+				responses.push_back(response);
+				for (int b = 0; (response.error == NO_ERROR) && (b < response.length.to_int()); b += 64) {
+					axiWord word(0, lowMask<64>((response.length.to_int() - b > 64) ? 64 : response.length.to_int() - b), b + 64 >= response.length.to_int());
+					appTxDataReq.write(word);
+				}
+			}
+			while (!txAppStream2eventEng_setEvent.empty()) {
+				txAppStream2eventEng_setEvent.read();
+			}
+			while (!txBufferWriteCmd.empty()) {
+				txBufferWriteCmd.read();
+			}
+			while (!txBufferWriteData.empty()) {
+				txBufferWriteData.read();
+			}
+#if (LATENCY_HISTOGRAM)
+			while (!txAppStream2latency_write.empty()) {
+				txAppStream2latency_write.read();
+			}
+#endif
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			while (!txApp_ackWritable.empty()) {
+				txApp_ackWritable.read();
+			}
+			while (!txApp_armWritable.empty()) {
+				txApp_armWritable.read();
+			}
+#endif
+		}
+	}
+
+	bool expect(int sessionID, int length, txApp_error_msg error) {
+		if (responses.empty()) {
+			std::cout << "ERROR no answer for session " << sessionID << " length " << length << std::endl;
+			return false;
+		}
+		appTxRsp response = responses.front();
+		responses.pop_front();
+		if ((response.sessionID.to_int() != sessionID) || (response.length.to_int() != length) || (response.error != error)) {
+			std::cout << "ERROR session " << response.sessionID << " length " << response.length << " error " << response.error;
+			std::cout << " instead of session " << sessionID << " length " << length << " error " << error << std::endl;
+			return false;
+		}
+		return true;
+	}
+};
+
+/*
+ * A session has a parked request and the application writes to it again. The new request
+ * waits aside, the request of another session is answered right away and the requests
+ * of the parked session are answered in order once the ACK makes room.
+ */
+int followUpTest()
+{
+	static tasiBench 	bench;
+	const int 			window = 2000;
+	int 				errors = 0;
+
+	bench.txSar2txApp_ack_push.write(txSarAckPush(1, 0x100, window, 1));
+	bench.txSar2txApp_ack_push.write(txSarAckPush(2, 0x100, window, 1));
+	bench.run(10);
+
+	bench.appTxDataReqMetaData.write(appTxMeta(1, 1000));
+	bench.run(30);
+	errors += !bench.expect(1, 1000, NO_ERROR);
+	bench.appTxDataReqMetaData.write(appTxMeta(1, 1500)); 		// Parked, 1000 bytes of window left
+	bench.run(30);
+	bench.appTxDataReqMetaData.write(appTxMeta(1, 100));
+	bench.appTxDataReqMetaData.write(appTxMeta(2, 200));
+	bench.run(30);
+	errors += !bench.expect(2, 200, NO_ERROR);
+	if (!bench.responses.empty()) {
+		std::cout << "ERROR the parked session was answered before its ACK" << std::endl;
+		errors++;
+	}
+
+	bench.txSar2txApp_ack_push.write(txSarAckPush(1, 0x100 + 1000, window, 0));
+	bench.run(50);
+	errors += !bench.expect(1, 1500, NO_ERROR);
+	errors += !bench.expect(1, 100, NO_ERROR);
+
+	std::cout << "follow up requests of a parked session " << (errors ? "failed" : "passed") << std::endl;
+	return errors;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+	// name, write length, ACK latency in cycles, window of the other end, cycles
+	const benchConfig configs[] = {
+		{"small",		64,		500,	0x30000,	50000},
+		{"mss",			1460,	500,	0x30000,	50000},
+		{"window",		1460,	8000,	4 * 1460,	100000},
+	};
+	int errors = 0;
+
+	std::cout << "tx_app_stream_if, " << NUM_SESSIONS << " sessions, " << (int) TASI_MAX_INFLIGHT << " requests in flight, ";
+	std::cout << "wait for space " << (TX_APP_WAIT_FOR_SPACE ? "on" : "off");
+	std::cout << ", writable notification " << (TX_APP_WRITABLE_NOTIFICATION ? "on" : "off") << std::endl;
+	for (int i = 0; i < (int) (sizeof(configs) / sizeof(configs[0])); i++) {
+		errors += runBenchmark(configs[i], 0x1000 * (i + 1));
+	}
+#if (TX_APP_WAIT_FOR_SPACE)
+	errors += followUpTest();
+#endif
 
-	return 0;
+	std::cout << (errors ? "FAILED" : "PASSED") << std::endl;
+	return (errors != 0);
 }
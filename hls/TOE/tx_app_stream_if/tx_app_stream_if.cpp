@@ -32,83 +32,373 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 using namespace hls;
 
 /** @ingroup tx_app_stream_if
- *  Reads the request from the application and loads the necessary metadata,
- *  the FSM decides if the packet is written to the TX buffer or discarded.
+ *  Reads the requests from the application and loads the necessary metadata, it
+ *  decides if the packet is written to the TX buffer or discarded. Up to TASI_MAX_INFLIGHT
+ *  requests have their lookups in flight, the requests are answered in the order they are
+ *  issued. A request is only issued when no other request of its session is in flight, so
+ *  the lookup always sees the app pointer written by the previous request of the session.
+ *  The app pointer update of the answered request and the lookup of the issued request
+ *  share one access to the TX SAR table.
+ *  With TX_APP_WAIT_FOR_SPACE a request that does not fit is parked, one per session, and
+ *  issued again when @p txApp2txAppStream_wakeup reports an ACK of its session. A request
+ *  that can never fit in the window of the other end is still answered with ERROR_WINDOW.
+ *  A new request of a session which has a parked request is set aside, so it does not
+ *  hold up the requests of other sessions. Set aside requests are issued in order once 
+ *  their session has nothing parked or in flight. When the TASI_MAX_DEFERRED places are
+ *  taken the next request waits for one.
+ *  With TX_APP_WRITABLE_NOTIFICATION a refused request arms the writable notification of
+ *  its session for the refused length, no request is issued in that cycle.
  */
 void tasi_metaLoader(	stream<appTxMeta>&				appTxDataReqMetaData,
 						stream<sessionState>&			stateTable2txApp_rsp,
 						stream<txAppTxSarReply>&		txSar2txApp_upd_rsp,
+#if (TX_APP_WAIT_FOR_SPACE)
+						stream<txSarAckPush>&			txApp2txAppStream_wakeup,
+#endif
 						stream<appTxRsp>&				appTxDataRsp,
 						stream<ap_uint<16> >&			txApp2stateTable_req,
 						stream<txAppTxSarQuery>&		txApp2txSar_upd_req,
 						stream<mmCmd>&					txBufferWriteCmd,
+#if (LATENCY_HISTOGRAM)
+						stream<latAppWrite>&			txAppStream2latency_write,
+#endif
 						stream<event>&					txAppStream2eventEng_setEvent)
 {
 #pragma HLS pipeline II=1
 
-	enum tai_states {READ_REQUEST, READ_META};
-	static tai_states tai_state = READ_REQUEST;
+	// Requests in flight, a ring which is answered from the head
+	static ap_uint<16>						tasi_slotID[TASI_MAX_INFLIGHT];
+	static ap_uint<16>						tasi_slotLength[TASI_MAX_INFLIGHT];
+	static bool								tasi_slotValid[TASI_MAX_INFLIGHT];
+	static bool								tasi_slotLookup[TASI_MAX_INFLIGHT];
+	#pragma HLS ARRAY_PARTITION variable=tasi_slotID complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=tasi_slotLength complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=tasi_slotValid complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=tasi_slotLookup complete dim=1
+	static ap_uint<TASI_INFLIGHT_BITS>		tasi_head = 0;
+	static ap_uint<TASI_INFLIGHT_BITS>		tasi_tail = 0;
+
+	static appTxMeta 						tasi_writeMeta;
+	static bool								tasi_writeMetaValid = false;
+
+#if (TX_APP_WAIT_FOR_SPACE)
+	static bool								tasi_slotWoken[TASI_MAX_INFLIGHT];
+	#pragma HLS ARRAY_PARTITION variable=tasi_slotWoken complete dim=1
+	static ap_uint<MAX_SESSIONS>			tasi_parked = 0;
+	static ap_uint<MAX_SESSIONS>			tasi_woken = 0;
+	static ap_uint<MAX_SESSIONS>			tasi_closed = 0;
+	static ap_uint<16>						tasi_parkedLength[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=tasi_parkedLength core=RAM_2P_BRAM
+	#pragma HLS DEPENDENCE variable=tasi_parkedLength inter false
+
+	const int 								SESSION_BITS = ceilLog2<MAX_SESSIONS>::value;
+	ap_uint<SESSION_BITS+1>					wokenSession;
+	txSarAckPush							wakeup;
+
+	// Set aside requests, ready when their session has nothing parked or in flight
+	static ap_uint<16>						tasi_deferID[TASI_MAX_DEFERRED];
+	static ap_uint<16>						tasi_deferLength[TASI_MAX_DEFERRED];
+	static ap_uint<8>						tasi_deferSeq[TASI_MAX_DEFERRED];
+	static bool								tasi_deferValid[TASI_MAX_DEFERRED];
+	static bool								tasi_deferReady[TASI_MAX_DEFERRED];
+	#pragma HLS ARRAY_PARTITION variable=tasi_deferID complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=tasi_deferLength complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=tasi_deferSeq complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=tasi_deferValid complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=tasi_deferReady complete dim=1
+	static ap_uint<8>						tasi_deferNext = 0;
+
+	bool									sessionDeferred = false;
+	bool									sessionWaits;
+	bool									deferFree = false;
+	ap_uint<TASI_DEFERRED_BITS>				deferSlot = 0;
+	bool									deferPick = false;
+	ap_uint<TASI_DEFERRED_BITS>				deferBest = 0;
+	bool									deferOlder;
+	bool									answered = false;
+	bool									answeredParked = false;
+	ap_uint<16>								answeredID;
+	bool									fromDefer = false;
+#endif
 
-	static appTxMeta 		tasi_writeMeta;
 	txAppTxSarReply 		writeSar;
 	ap_uint<WINDOW_BITS>	maxWriteLength;
 	ap_uint<WINDOW_BITS>	usedLength;
 	ap_uint<WINDOW_BITS>	usableWindow;
+	ap_uint<WINDOW_BITS>	space;
+	txApp_error_msg			spaceError;
+	bool					parkRequest = false;
 	ap_uint<32> 			pkgAddr;
 	sessionState 			state;
+	ap_uint<16>				sessionID;
+	ap_uint<16>				length;
+
+	bool					sarWrite = false;
+	bool					sarLookup = false;
+	ap_uint<16>				sarWriteID;
+	ap_uint<WINDOW_BITS>	sarWriteMempt;
+	ap_uint<16>				sarLookupID;
+	bool					sarArm = false;
+	ap_uint<16>				sarArmLength;
+	txAppTxSarQuery			armQuery;
+
+	bool					issue = false;
+	bool					issueLookup = true;
+	ap_uint<16>				issueID;
+	ap_uint<16>				issueLength;
 
-	// FSM requests metadata, decides if packet goes to buffer or not
-	switch(tai_state) {
-		case READ_REQUEST:
-			if (!appTxDataReqMetaData.empty()) {
-				appTxDataReqMetaData.read(tasi_writeMeta); 								// Read sessionID
-				txApp2stateTable_req.write(tasi_writeMeta.sessionID); 					// Get session state
-				txApp2txSar_upd_req.write(txAppTxSarQuery(tasi_writeMeta.sessionID));	// Get Ack pointer
-				tai_state = READ_META;
+	if (!tasi_writeMetaValid && !appTxDataReqMetaData.empty()) {
+		appTxDataReqMetaData.read(tasi_writeMeta);
+		tasi_writeMetaValid = true;
+	}
+
+	// Sampled before the updates of this cycle
+	bool 					slotFree = !tasi_slotValid[tasi_tail];
+	bool 					sessionInFlight = false;
+	for (int i = 0; i < TASI_MAX_INFLIGHT; i++) {
+	#pragma HLS UNROLL
+		if (tasi_slotValid[i] && tasi_writeMetaValid && (tasi_slotID[i] == tasi_writeMeta.sessionID)) {
+			sessionInFlight = true;
+		}
+	}
+#if (TX_APP_WAIT_FOR_SPACE)
+	wokenSession = leadingOne<MAX_SESSIONS>(tasi_woken);
+
+	defer_scan: for (int i = 0; i < TASI_MAX_DEFERRED; i++) {
+	#pragma HLS UNROLL
+		if (tasi_deferValid[i] && tasi_writeMetaValid && (tasi_deferID[i] == tasi_writeMeta.sessionID)) {
+			sessionDeferred = true;
+		}
+		if (!deferFree && !tasi_deferValid[i]) {
+			deferSlot 	= i;
+			deferFree 	= true;
+		}
+		// The oldest ready request which has no older request of its session set aside
+		deferOlder = false;
+		for (int j = 0; j < TASI_MAX_DEFERRED; j++) {
+			if (tasi_deferValid[j] && (tasi_deferID[j] == tasi_deferID[i]) && ((ap_int<8>) (tasi_deferSeq[j] - tasi_deferSeq[i]) < 0)) {
+				deferOlder = true;
 			}
-			break;
-		case READ_META:
-			if (!txSar2txApp_upd_rsp.empty() && !stateTable2txApp_rsp.empty()) {
-				stateTable2txApp_rsp.read(state);
-				txSar2txApp_upd_rsp.read(writeSar);
-				maxWriteLength = (writeSar.ackd - writeSar.mempt) - 1;
-#if (TCP_NODELAY)
-				usedLength 		= writeSar.mempt - writeSar.ackd;
-				if (writeSar.min_window > usedLength) {
-					usableWindow = writeSar.min_window - usedLength;
-				}
-				else {
-					usableWindow 	= 0;
-				}
+		}
+		if (tasi_deferValid[i] && tasi_deferReady[i] && !deferOlder &&
+				(!deferPick || ((ap_int<8>) (tasi_deferSeq[i] - tasi_deferSeq[deferBest]) < 0))) {
+			deferBest 	= i;
+			deferPick 	= true;
+		}
+	}
+	sessionWaits = tasi_writeMetaValid && (tasi_parked.bit(tasi_writeMeta.sessionID) || tasi_woken.bit(tasi_writeMeta.sessionID) || sessionDeferred);
 #endif
 
-				if (state != ESTABLISHED) {
-					appTxDataRsp.write(appTxRsp(tasi_writeMeta.length, maxWriteLength, ERROR_NOCONNECTION)); // Notify app about fail
-				}
+	// Answer the oldest request
+	if (tasi_slotValid[tasi_head]) {
+		sessionID 	= tasi_slotID[tasi_head];
+		length 		= tasi_slotLength[tasi_head];
+		if (!tasi_slotLookup[tasi_head]) {
+			// The session was closed while the request was parked
+			appTxDataRsp.write(appTxRsp(length, 0, ERROR_NOCONNECTION, sessionID));
+			tasi_slotValid[tasi_head] = false;
+			tasi_head++;
+#if (TX_APP_WAIT_FOR_SPACE)
+			answered 	= true;
+			answeredID 	= sessionID;
+#endif
+		}
+		else if (!txSar2txApp_upd_rsp.empty() && !stateTable2txApp_rsp.empty()) {
+			stateTable2txApp_rsp.read(state);
+			txSar2txApp_upd_rsp.read(writeSar);
+			maxWriteLength = (writeSar.ackd - writeSar.mempt) - 1;
+			space 		= maxWriteLength;
+			spaceError 	= NO_ERROR;
 #if (TCP_NODELAY)
-				else if (usableWindow < tasi_writeMeta.length){
-					// Notify app about fail
-					appTxDataRsp.write(appTxRsp(tasi_writeMeta.length, usableWindow, ERROR_WINDOW));					
+			usedLength 		= writeSar.mempt - writeSar.ackd;
+			if (writeSar.min_window > usedLength) {
+				usableWindow = writeSar.min_window - usedLength;
+			}
+			else {
+				usableWindow 	= 0;
+			}
+			if (usableWindow < length) {
+				space 		= usableWindow;
+				spaceError 	= ERROR_WINDOW;
+			}
+			else
+#endif
+			if (length > maxWriteLength) {
+				spaceError 	= ERROR_NOSPACE;
+			}
+#if (TX_APP_WAIT_FOR_SPACE)
+			parkRequest 	= (spaceError != NO_ERROR);
+#if (TCP_NODELAY)
+			// It can never fit in the window of the other end
+			if (length > writeSar.min_window) {
+				parkRequest = false;
+			}
+#endif
+#endif
+
+			if (state != ESTABLISHED) {
+				appTxDataRsp.write(appTxRsp(length, maxWriteLength, ERROR_NOCONNECTION, sessionID)); // Notify app about fail
+			}
+			else if (spaceError == NO_ERROR) {
+				// TODO there seems some redundancy
+				pkgAddr(31, 30) 			= (!RX_DDR_BYPASS);					// If DDR is not used in the RX start from the beginning of the memory
+				pkgAddr(29, WINDOW_BITS) 	= sessionID(13, 0);
+				pkgAddr(WINDOW_BITS-1, 0)  	= writeSar.mempt;
+				txBufferWriteCmd.write(mmCmd( pkgAddr, length));
+				appTxDataRsp.write(appTxRsp(length, maxWriteLength, NO_ERROR, sessionID));
+				txAppStream2eventEng_setEvent.write(event(TX, sessionID, writeSar.mempt, length));
+#if (LATENCY_HISTOGRAM)
+				if (!txAppStream2latency_write.full()) {
+					txAppStream2latency_write.write(latAppWrite(sessionID, writeSar.mempt));
 				}
 #endif
-				else if(tasi_writeMeta.length > maxWriteLength) {
-					// Notify app about fail
-					appTxDataRsp.write(appTxRsp(tasi_writeMeta.length, maxWriteLength, ERROR_NOSPACE));
-				}	
+				sarWrite 		= true;
+				sarWriteID 		= sessionID;
+				sarWriteMempt 	= writeSar.mempt + length;
+			}
+			else if (parkRequest) {
+#if (TX_APP_WAIT_FOR_SPACE)
+				// Park it, if an ACK arrived since the lookup it is issued again right away
+				tasi_parkedLength[sessionID] = length;
+				answeredParked 	= true;
+				if (tasi_slotWoken[tasi_head]) {
+					tasi_woken.bit(sessionID) = 1;
+				}
 				else {
-					// TODO there seems some redundancy
-					pkgAddr(31, 30) 			= (!RX_DDR_BYPASS);					// If DDR is not used in the RX start from the beginning of the memory
-					pkgAddr(29, WINDOW_BITS) 	= tasi_writeMeta.sessionID(13, 0);
-					pkgAddr(WINDOW_BITS-1, 0)  	= writeSar.mempt;
-					txBufferWriteCmd.write(mmCmd( pkgAddr, tasi_writeMeta.length));
-					appTxDataRsp.write(appTxRsp(tasi_writeMeta.length, maxWriteLength, NO_ERROR));
-					txAppStream2eventEng_setEvent.write(event(TX, tasi_writeMeta.sessionID, writeSar.mempt, tasi_writeMeta.length));
-					txApp2txSar_upd_req.write(txAppTxSarQuery(tasi_writeMeta.sessionID, writeSar.mempt+tasi_writeMeta.length));
+					tasi_parked.bit(sessionID) = 1;
 				}
-				tai_state = READ_REQUEST;
+#endif
 			}
-			break;
-	} //switch
+			else {
+				// Notify app about fail
+				appTxDataRsp.write(appTxRsp(length, space, spaceError, sessionID));
+#if (TX_APP_WRITABLE_NOTIFICATION)
+				sarArm 			= true;
+				sarArmLength 	= length;
+#endif
+			}
+			tasi_slotValid[tasi_head] = false;
+			tasi_head++;
+#if (TX_APP_WAIT_FOR_SPACE)
+			answered 	= true;
+			answeredID 	= sessionID;
+#endif
+		}
+	}
+
+#if (TX_APP_WAIT_FOR_SPACE)
+	// The set aside requests of the answered session can go unless it was parked again
+	if (answered) {
+		for (int i = 0; i < TASI_MAX_DEFERRED; i++) {
+		#pragma HLS UNROLL
+			if (tasi_deferID[i] == answeredID) {
+				tasi_deferReady[i] = !answeredParked;
+			}
+		}
+	}
+#endif
+
+#if (TX_APP_WAIT_FOR_SPACE)
+	// ACKs wake the parked request of their session
+	if (!txApp2txAppStream_wakeup.empty()) {
+		txApp2txAppStream_wakeup.read(wakeup);
+		if (tasi_parked.bit(wakeup.sessionID)) {
+			tasi_parked.bit(wakeup.sessionID) = 0;
+			tasi_woken.bit(wakeup.sessionID) = 1;
+			// A new connection reuses the session
+			tasi_closed.bit(wakeup.sessionID) = wakeup.init;
+		}
+		for (int i = 0; i < TASI_MAX_INFLIGHT; i++) {
+		#pragma HLS UNROLL
+			if (tasi_slotValid[i] && (tasi_slotID[i] == wakeup.sessionID)) {
+				tasi_slotWoken[i] = true;
+			}
+		}
+	}
+#endif
+
+	// Issue a woken request or the next request of the application
+	if (slotFree && !sarArm) {
+#if (TX_APP_WAIT_FOR_SPACE)
+		if (wokenSession.bit(SESSION_BITS)) {
+			issueID 		= wokenSession(SESSION_BITS-1, 0);
+			issueLength 	= tasi_parkedLength[issueID];
+			issueLookup 	= !tasi_closed.bit(issueID);
+			tasi_woken.bit(issueID) 	= 0;
+			tasi_closed.bit(issueID) 	= 0;
+			issue 			= true;
+		}
+		else if (deferPick) {
+			issueID 		= tasi_deferID[deferBest];
+			issueLength 	= tasi_deferLength[deferBest];
+			tasi_deferValid[deferBest] = false;
+			fromDefer 		= true;
+			issue 			= true;
+		}
+		else if (tasi_writeMetaValid && !sessionInFlight && !sessionWaits) {
+#else
+		if (tasi_writeMetaValid && !sessionInFlight) {
+#endif
+			issueID 		= tasi_writeMeta.sessionID;
+			issueLength 	= tasi_writeMeta.length;
+			tasi_writeMetaValid = false;
+			issue 			= true;
+		}
+	}
+#if (TX_APP_WAIT_FOR_SPACE)
+	// Set the request of a session that waits aside, not in the cycle its session is answered
+	if (tasi_writeMetaValid && sessionWaits && deferFree && !(answered && answeredID == tasi_writeMeta.sessionID)) {
+		tasi_deferID[deferSlot] 	= tasi_writeMeta.sessionID;
+		tasi_deferLength[deferSlot] = tasi_writeMeta.length;
+		tasi_deferSeq[deferSlot] 	= tasi_deferNext;
+		tasi_deferValid[deferSlot] 	= true;
+		tasi_deferReady[deferSlot] 	= !(tasi_parked.bit(tasi_writeMeta.sessionID) || tasi_woken.bit(tasi_writeMeta.sessionID) || sessionInFlight);
+		tasi_deferNext++;
+		tasi_writeMetaValid = false;
+	}
+	// The other set aside requests of an issued session wait for its answer
+	if (fromDefer) {
+		for (int i = 0; i < TASI_MAX_DEFERRED; i++) {
+		#pragma HLS UNROLL
+			if (tasi_deferID[i] == issueID) {
+				tasi_deferReady[i] = false;
+			}
+		}
+	}
+#endif
+	if (issue) {
+		tasi_slotID[tasi_tail] 		= issueID;
+		tasi_slotLength[tasi_tail] 	= issueLength;
+		tasi_slotLookup[tasi_tail] 	= issueLookup;
+		tasi_slotValid[tasi_tail] 	= true;
+#if (TX_APP_WAIT_FOR_SPACE)
+		tasi_slotWoken[tasi_tail] 	= false;
+#endif
+		tasi_tail++;
+		if (issueLookup) {
+			txApp2stateTable_req.write(issueID); 		// Get session state
+			sarLookup 		= true;						// Get Ack pointer
+			sarLookupID 	= issueID;
+		}
+	}
+
+	if (sarWrite && sarLookup) {
+		txApp2txSar_upd_req.write(txAppTxSarQuery(sarWriteID, sarWriteMempt, sarLookupID));
+	}
+	else if (sarWrite) {
+		txApp2txSar_upd_req.write(txAppTxSarQuery(sarWriteID, sarWriteMempt));
+	}
+	else if (sarLookup) {
+		txApp2txSar_upd_req.write(txAppTxSarQuery(sarLookupID));
+	}
+	else if (sarArm) {
+		// Arm the writable notification of the refused session, it takes the lookup of the cycle
+		armQuery 			= txAppTxSarQuery(sessionID);
+		armQuery.lookup 	= false;
+		armQuery.arm 		= true;
+		armQuery.lowWater 	= sarArmLength;
+		txApp2txSar_upd_req.write(armQuery);
+	}
 }
 
 
@@ -124,22 +414,30 @@ void tasi_metaLoader(	stream<appTxMeta>&				appTxDataReqMetaData,
  *  @param[in]		appTxDataReq
  *  @param[in]		stateTable2txApp_rsp
  *  @param[in]		txSar2txApp_upd_rsp
+ *  @param[in]		txApp2txAppStream_wakeup
  *  @param[out]		appTxDataRsp
  *  @param[out]		txApp2stateTable_req
  *  @param[out]		txApp2txSar_upd_req
  *  @param[out]		txBufferWriteCmd
  *  @param[out]		txBufferWriteData
+ *  @param[out]		txAppStream2latency_write
  *  @param[out]		txAppStream2eventEng_setEvent
  */
 void tx_app_stream_if(	stream<appTxMeta>&				appTxDataReqMetaData,
 						stream<axiWord>&				appTxDataReq,
 						stream<sessionState>&			stateTable2txApp_rsp,
 						stream<txAppTxSarReply>&		txSar2txApp_upd_rsp, //TODO rename
+#if (TX_APP_WAIT_FOR_SPACE)
+						stream<txSarAckPush>&			txApp2txAppStream_wakeup,
+#endif
 						stream<appTxRsp>&				appTxDataRsp,
 						stream<ap_uint<16> >&			txApp2stateTable_req,
 						stream<txAppTxSarQuery>&		txApp2txSar_upd_req, //TODO rename
 						stream<mmCmd>&					txBufferWriteCmd,
 						stream<axiWord>&				txBufferWriteData,
+#if (LATENCY_HISTOGRAM)
+						stream<latAppWrite>&			txAppStream2latency_write,
+#endif
 						stream<event>&					txAppStream2eventEng_setEvent)
 {
 #pragma HLS INLINE
@@ -153,10 +451,16 @@ void tx_app_stream_if(	stream<appTxMeta>&				appTxDataReqMetaData,
 			appTxDataReqMetaData,
 			stateTable2txApp_rsp,
 			txSar2txApp_upd_rsp,
+#if (TX_APP_WAIT_FOR_SPACE)
+			txApp2txAppStream_wakeup,
+#endif
 			appTxDataRsp,
 			txApp2stateTable_req,
 			txApp2txSar_upd_req,
 			tasiMetaLoaderCmd,
+#if (LATENCY_HISTOGRAM)
+			txAppStream2latency_write,
+#endif
 			txAppStream2eventEng_setEvent);
 
 	tx_Data_to_Memory(
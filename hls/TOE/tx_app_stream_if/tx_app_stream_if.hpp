@@ -33,6 +33,14 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 
 using namespace hls;
 
+// Write requests whose state and TX SAR lookups are in flight at the same time
+static const uint8_t TASI_INFLIGHT_BITS = 3;
+static const uint8_t TASI_MAX_INFLIGHT = (1 << TASI_INFLIGHT_BITS);
+
+// Requests of sessions with a parked request that are set aside with TX_APP_WAIT_FOR_SPACE
+static const uint8_t TASI_DEFERRED_BITS = 3;
+static const uint8_t TASI_MAX_DEFERRED = (1 << TASI_DEFERRED_BITS);
+
 /** @ingroup tx_app_stream_if
  *
  */
@@ -44,9 +52,15 @@ void tx_app_stream_if(	stream<appTxMeta>&				appTxDataReqMetaData,
 						stream<axiWord>&				appTxDataReq,
 						stream<sessionState>&			stateTable2txApp_rsp,
 						stream<txAppTxSarReply>&		txSar2txApp_upd_rsp, //TODO rename
+#if (TX_APP_WAIT_FOR_SPACE)
+						stream<txSarAckPush>&			txApp2txAppStream_wakeup,
+#endif
 						stream<appTxRsp>&				appTxDataRsp,
 						stream<ap_uint<16> >&			txApp2stateTable_req,
 						stream<txAppTxSarQuery>&		txApp2txSar_upd_req, //TODO rename
 						stream<mmCmd>&					txBufferWriteCmd,
 						stream<axiWord>&				txBufferWriteData,
+#if (LATENCY_HISTOGRAM)
+						stream<latAppWrite>&			txAppStream2latency_write,
+#endif
 						stream<event>&					txAppStream2eventEng_setEvent);
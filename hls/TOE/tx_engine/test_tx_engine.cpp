@@ -27,264 +27,451 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
 EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx, Inc.
 ************************************************/
 #include "tx_engine.hpp"
-#include "../testbench/pcap2stream.hpp"
+#include "../testbench/dummy_memory.hpp"
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstdlib>
+#include <iomanip>
 
 using namespace hls;
 using namespace std;
 
-void simulateSARtables(	stream<rxSarEntry>&				rxSar2txEng_upd_rsp,
-						stream<txTxSarReply>&			txSar2txEng_upd_rsp,
-						stream<ap_uint<16> >&			txEng2rxSar_upd_req,
-						stream<txTxSarQuery>&			txEng2txSar_upd_req)
-{
-	ap_uint<16> addr;
-	txTxSarQuery in_txaccess;
-
-	if (!txEng2rxSar_upd_req.empty())
-	{
-		txEng2rxSar_upd_req.read(addr);
-		rxSar2txEng_upd_rsp.write((rxSarEntry) {0x0023, 0xadbd});
+unsigned int	simCycleCounter = 0;
+
+#define MEM_READ_LATENCY 	100			// Cycles from read command to first word of the TX buffer
+
+/*
+ * Per session state of the SAR tables as seen by the TX engine. Retransmissions
+ * are requested by setting rtSeq and rtLength before the RT event.
+ */
+struct sessionModel {
+	ap_uint<32> 	not_ackd;
+	ap_uint<32> 	rtSeq;
+	ap_uint<16> 	rtLength;
+	sessionModel() :not_ackd(0x1000), rtSeq(0), rtLength(0) {}
+};
+
+struct txEngineBench {
+	stream<extendedEvent>			eventEng2txEng_event;
+	stream<rxSarEntry_rsp>			rxSar2txEng_rsp;
+	stream<txTxSarReply>			txSar2txEng_upd_rsp;
+	stream<axiWord>					txBufferReadData;
+	stream<axiWord>					txApp2txEng_data_stream;
+	stream<fourTuple>				sLookup2txEng_rev_rsp;
+	stream<ap_uint<16> >			txEng2rxSar_req;
+	stream<txTxSarQuery>			txEng2txSar_upd_req;
+	stream<txRetransmitTimerSet>	txEng2timer_setRetransmitTimer;
+	stream<ap_uint<16> >			txEng2timer_setProbeTimer;
+	stream<mmCmd>					txBufferReadCmd;
+	stream<ap_uint<16> >			txEng2sLookup_rev_req;
+	stream<axiWord>					ipTxData;
+	stream<ap_uint<1> >				readCountFifo;
+	stream<axiWord>					tx_pseudo_packet_to_checksum;
+	stream<ap_uint<16> >			tx_pseudo_packet_res_checksum;
+#if (STATISTICS_MODULE)
+	stream<txStatsUpdate>			txEngStatsUpdate;
+#endif
+#if (LATENCY_HISTOGRAM)
+	stream<latTxSegment>			txEng2latency_segment;
+	stream<ap_uint<32> >			txEng2latency_wireSeq;
+#endif
+
+	dummyMemory 					txMemory;
+	map<int, sessionModel> 			sessions;
+	deque<pair<mmCmd, unsigned> > 	readCmds;
+	bool 							reading;
+	vector<axiWord> 				checksumPacket;
+	int 							checksumPackets;			// Packets that went through the checksum pipeline
+	vector<uint8_t> 				outPacket;
+	vector<vector<uint8_t> > 		packets;
+	vector<unsigned> 				lastWordCycle;
+	vector<unsigned> 				firstWordCycle;
+	bool 							firstWord;
+	int 							latencyMismatches;
+
+	txEngineBench() :reading(false), checksumPackets(0), firstWord(true), latencyMismatches(0) {}
+
+	void step() {
+		tx_engine(	eventEng2txEng_event,
+					rxSar2txEng_rsp,
+					txSar2txEng_upd_rsp,
+					txBufferReadData,
+#if (TCP_NODELAY)
+					txApp2txEng_data_stream,
+#endif
+#if (STATISTICS_MODULE)
+					txEngStatsUpdate,
+#endif
+#if (LATENCY_HISTOGRAM)
+					txEng2latency_segment,
+					txEng2latency_wireSeq,
+#endif
+					sLookup2txEng_rev_rsp,
+					txEng2rxSar_req,
+					txEng2txSar_upd_req,
+					txEng2timer_setRetransmitTimer,
+					txEng2timer_setProbeTimer,
+					txBufferReadCmd,
+					txEng2sLookup_rev_req,
+					ipTxData,
+					readCountFifo,
+					tx_pseudo_packet_to_checksum,
+					tx_pseudo_packet_res_checksum);
+		simulateSarTables();
+		simulateTxBuffer();
+		simulateChecksum();
+		simulateReverseLookup();
+		collectOutput();
+		simCycleCounter++;
 	}
-	if (!txEng2txSar_upd_req.empty())
-	{
-		txEng2txSar_upd_req.read(in_txaccess);
-		if (in_txaccess.write == 0)
-		{
-			txSar2txEng_upd_rsp.write(((txTxSarReply) {64700, 65156, 0xffff, 1100, false,false}));
-			//txSar2txEng_upd_rsp.write(((txTxSarReply) {64700, 65156, 0xffff, 1100, false,false}));
+
+	void simulateSarTables() {
+		ap_uint<16> 	sessionID;
+		txTxSarQuery 	query;
+		rxSarEntry_rsp 	rxSar;
+		txTxSarReply 	txSar;
+
+		if (!txEng2rxSar_req.empty()) {
+			txEng2rxSar_req.read(sessionID);
+			rxSar.recvd 		= 0xabcd0000;
+			rxSar.windowSize 	= 0xffff;
+#if (WINDOW_SCALE)
+			rxSar.rx_win_shift 	= 0;
+#endif
+			rxSar2txEng_rsp.write(rxSar);
+		}
+		if (!txEng2txSar_upd_req.empty()) {
+			txEng2txSar_upd_req.read(query);
+			sessionModel& session = sessions[query.sessionID];
+			if (query.write) {
+				if (!query.isRtQuery)
+					session.not_ackd = query.not_ackd;
+			}
+			else {
+				txSar 					= txTxSarReply(session.rtSeq, session.not_ackd, 0xffff, 0, false, false);
+				txSar.UsableWindow 		= 0xffff;
+				txSar.usedLength 		= session.not_ackd - session.rtSeq;
+				txSar.usedLength_rst 	= session.rtLength;
+				txSar.ackd_eq_not_ackd 	= false;
+#if (WINDOW_SCALE)
+				txSar.tx_win_shift 		= 0;
+#endif
+				txSar2txEng_upd_rsp.write(txSar);
+			}
 		}
-		//omit write
 	}
-}
 
-void simulateTxBuffer(stream<mmCmd>&	command,
-						stream<axiWord>& dataOut)
-{
-	static mmCmd cmd;
-	static ap_uint<1> fsmState = 0;
-	static ap_uint<16> wordCount = 0;
-
-	static ap_uint<4> 	bcd_l=0;
-	static ap_uint<4> 	bcd_h=0;
-
-	static int packet = 0;
-	static int transaction = 0;
-	ap_uint<7> bytes;
-	static int byte_count = 0;
-
-	axiWord memWord;
-
-	switch (fsmState) {
-		case 0:
-			if (!command.empty()) {
-				command.read(cmd);
-				//cout << "CMD address: " << hex << cmd.saddr <<"\t bytes to transfer: " << dec <<  cmd.bbt << endl;
-				fsmState = 1;
-			}
-			break;
-		case 1:
-
-			memWord.last = 0x0;
-			for (int i=0 ; i < 64 ; i++){
-				if (wordCount < cmd.bbt){
-					memWord.data(i*8+7,i*8) = (bcd_h,bcd_l);
-					memWord.keep.bit(i) = 1;
-
-					bcd_l++;
-					if (bcd_l==10){
-						bcd_h++;
-						bcd_l=0;
-						if (bcd_h==10){
-							bcd_h=0;
-						}
+	void simulateTxBuffer() {
+		axiWord 	word;
+
+		if (!txBufferReadCmd.empty())
+			readCmds.push_back(make_pair(txBufferReadCmd.read(), simCycleCounter + MEM_READ_LATENCY));
+		if (!reading && !readCmds.empty() && readCmds.front().second <= simCycleCounter) {
+			txMemory.setReadCmd(readCmds.front().first);
+			readCmds.pop_front();
+			reading = true;
+		}
+		if (reading) {
+			txMemory.readWord(word);
+			txBufferReadData.write(word);
+			reading = !word.last;
+		}
+	}
+
+	void simulateChecksum() {
+		axiWord 	word;
+		uint32_t 	sum = 0;
+
+		if (!tx_pseudo_packet_to_checksum.empty()) {
+			tx_pseudo_packet_to_checksum.read(word);
+			checksumPacket.push_back(word);
+			if (word.last) {
+				for (size_t w = 0; w < checksumPacket.size(); w++) {
+					for (int i = 0; i < 32; i++) {
+						uint32_t high 	= checksumPacket[w].keep.bit(2*i) 	? (uint32_t) checksumPacket[w].data(16*i+7, 16*i) : 0;
+						uint32_t low 	= checksumPacket[w].keep.bit(2*i+1) ? (uint32_t) checksumPacket[w].data(16*i+15, 16*i+8) : 0;
+						sum += (high << 8) | low;
 					}
 				}
-				else{
-					memWord.data(i*8+7,i*8)=0;
-					memWord.keep.bit(i) = 0;
-				}
-				wordCount++;
+				while (sum >> 16)
+					sum = (sum & 0xffff) + (sum >> 16);
+				tx_pseudo_packet_res_checksum.write(~sum & 0xffff);
+				checksumPacket.clear();
+				checksumPackets++;
 			}
+		}
+	}
 
-			if (wordCount >= cmd.bbt) {
-				memWord.last = 0x1;
-				fsmState = 0;
-				wordCount = 0;
-			}
-
-			//cout << "Data[" << dec << packet << "]["<< transaction <<"] " << hex << memWord.data << "\tkeep: " << memWord.keep << "\tlast: " << dec << memWord.last << endl << endl;;
-
-			bytes = keep2len (memWord.keep);
-			byte_count += bytes;
+	void simulateReverseLookup() {
+		if (!txEng2sLookup_rev_req.empty()) {
+			txEng2sLookup_rev_req.read();
+			sLookup2txEng_rev_rsp.write(fourTuple(0x0800A8C0, 0x0500A8C0, 0x8913, 0x5000));
+		}
+	}
 
-			if (memWord.last){
-				packet++;
-				transaction = 0;
-				//cout << "bytes count: " << byte_count << endl;
-				byte_count = 0;
+	void collectOutput() {
+		axiWord 	word;
+
+		if (!ipTxData.empty()) {
+			ipTxData.read(word);
+			if (firstWord)
+				firstWordCycle.push_back(simCycleCounter);
+			firstWord = false;
+			for (int b = 0; b < 64; b++) {
+				if (word.keep.bit(b))
+					outPacket.push_back(word.data(b*8+7, b*8));
 			}
-			else{
-				transaction++;
+			if (word.last) {
+				packets.push_back(outPacket);
+				lastWordCycle.push_back(simCycleCounter);
+				outPacket.clear();
+				firstWord = true;
 			}
-
-			dataOut.write(memWord);
-			break;
+		}
+		while (!readCountFifo.empty())
+			readCountFifo.read();
+		while (!txEng2timer_setRetransmitTimer.empty())
+			txEng2timer_setRetransmitTimer.read();
+		while (!txEng2timer_setProbeTimer.empty())
+			txEng2timer_setProbeTimer.read();
+#if (LATENCY_HISTOGRAM)
+		// Every packet with payload on the wire pairs with the next segment of the meta loader
+		while (!txEng2latency_wireSeq.empty()) {
+			ap_uint<32> wireSeq = txEng2latency_wireSeq.read();
+			if (txEng2latency_segment.empty() || (txEng2latency_segment.read().seqNumb != wireSeq))
+				latencyMismatches++;
+		}
+#endif
 	}
-}
 
-void simulateRevSLUP(stream<ap_uint<16> >&			txEng2sLookup_rev_req,
-					stream<fourTuple>&				sLookup2txEng_rev_rsp)
-{
-	fourTuple tuple;
-	tuple.dstIp = 0xC0A80005;
-	tuple.dstPort = 5001;
-	tuple.srcIp = 0xC0A80008;
-	tuple.srcPort = 60000;
-	if (!txEng2sLookup_rev_req.empty())
-	{
-		txEng2sLookup_rev_req.read();
-		sLookup2txEng_rev_rsp.write(tuple);
+	/*
+	 * Application write with TCP_NODELAY, the payload is written to the TX buffer and
+	 * offered to the engine at the same time, as the data broadcast in the TOE does.
+	 */
+	void appWrite(int sessionID, vector<uint8_t>& payload) {
+		sessionModel& 	session = sessions[sessionID];
+		ap_uint<32> 	addr;
+		axiWord 		word;
+
+		addr(31, 30) 			= (!RX_DDR_BYPASS);
+		addr(30, WINDOW_BITS) 	= sessionID;
+		addr(WINDOW_BITS-1, 0) 	= session.not_ackd(WINDOW_BITS-1, 0);
+		txMemory.setWriteCmd(mmCmd(addr, payload.size()));
+		for (size_t offset = 0; offset < payload.size(); offset += 64) {
+			word = axiWord(0, 0, (offset + 64 >= payload.size()));
+			for (int b = 0; b < 64 && offset + b < payload.size(); b++) {
+				word.data(b*8+7, b*8) 	= payload[offset + b];
+				word.keep.bit(b) 		= 1;
+			}
+			txMemory.writeWord(word);
+			txApp2txEng_data_stream.write(word);
+		}
+		eventEng2txEng_event.write(event(TX, sessionID, session.not_ackd(WINDOW_BITS-1, 0), payload.size()));
 	}
-}
-
-int main(int argc, char **argv)
-{
-	ap_uint<16> sessionID;
-	stream<extendedEvent>			eventEng2txEng_event("eventEng2txEng_event");
-	stream<rxSarEntry>				rxSar2txEng_upd_rsp("rxSar2txEng_upd_rsp");
-	stream<txTxSarReply>			txSar2txEng_upd_rsp("txSar2txEng_upd_rsp");
-	stream<axiWord>					txBufferReadData("txBufferReadData");
-	stream<fourTuple>				sLookup2txEng_rev_rsp("sLookup2txEng_rev_rsp");
-	stream<ap_uint<16> >			txEng2rxSar_upd_req("txEng2rxSar_upd_req");
-	stream<txTxSarQuery>			txEng2txSar_upd_req("txEng2txSar_upd_req");
-	stream<txRetransmitTimerSet>	txEng2timer_setRetransmitTimer("txEng2timer_setRetransmitTimer");
-	stream<ap_uint<16> >			txEng2timer_setProbeTimer("txEng2timer_setProbeTimer");
-	stream<mmCmd>					txBufferReadCmd("txBufferReadCmd");
-	stream<ap_uint<16> >			txEng2sLookup_rev_req("txEng2sLookup_rev_req");
-	stream<axiWord>					ipTxData;
-	stream<ap_uint<1> > 			readCountFifo("readCountFifo");
-
-	vector<int> values;
-	vector<int> lengths;
 
-	ap_uint<1> 						read_count_fifo;
-
-	ofstream outputFile;
+	void retransmit(int sessionID, ap_uint<32> seq, int length) {
+		sessions[sessionID].rtSeq 		= seq;
+		sessions[sessionID].rtLength 	= length;
+		eventEng2txEng_event.write(event(RT, sessionID, 0));
+	}
 
+	/*
+	 * Runs until the next packet is out, returns the cycles from now to its last word
+	 */
+	int runPacket() {
+		size_t 		expected = packets.size() + 1;
+		unsigned 	start = simCycleCounter;
 
+		while (packets.size() < expected && simCycleCounter - start < 100000)
+			step();
+		return (packets.size() == expected) ? (int) (lastWordCycle.back() - start) : -1;
+	}
 
-	outputFile.open("/home/mario/Documents/cmac_100g/submodules/tcp_ip_cores/TOE/src/tx_engine/out.dat");
-	if (!outputFile) {
-		cout << "Error: could not open test output file." << endl;
-		return -1;
+	void drain(int cycles) {
+		for (int i = 0; i < cycles; i++)
+			step();
 	}
+};
+
+/*
+ * Full TCP checksum of a packet on the wire, pseudo header and options included
+ */
+bool tcpChecksumOk(vector<uint8_t>& packet) {
+	uint32_t 	sum = 0;
+	size_t 		tcpLength = packet.size() - 20;
+
+	for (int i = 12; i < 20; i += 2) 						// Addresses
+		sum += (packet[i] << 8) | packet[i+1];
+	sum += 6 + tcpLength;
+	for (size_t i = 20; i < packet.size(); i += 2)
+		sum += (packet[i] << 8) | ((i + 1 < packet.size()) ? packet[i+1] : 0);
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return sum == 0xffff;
+}
 
-	axiWord outData;
-
-	uint16_t strbTemp;
-	uint64_t dataTemp;
-	uint16_t lastTemp;
-	int count = 0;
-	while (count < 1000) {
-		int v = rand() % 100;
-		int v1 = rand() % 32000;
-		int len = rand() % 10;
-
-		/*event ev;
-		ev.type = TX;
-		ev.address = v1;
-		ev.length = len+2;
-		ev.sessionID = v;
-		values.push_back(v);
-		lengths.push_back(len+2);*/
-
-		if ((count % 90) == 0){
-		//if (count  == 9) {
-			eventEng2txEng_event.write(event(TX, 3, 100, 536));
-			values.push_back(3);
-			lengths.push_back(536);
+/*
+ * Checks that a packet carries the expected sequence number and payload and that the
+ * TCP checksum is right
+ */
+int checkPacket(vector<uint8_t>& packet, ap_uint<32> seq, vector<uint8_t>& payload, uint8_t* expected) {
+	int 		errors = 0;
+	uint32_t 	pktSeq;
+
+	if (packet.size() != 40 + payload.size()) {
+		cout << "Packet length " << packet.size() << " expected " << 40 + payload.size() << endl;
+		return 1;
+	}
+	pktSeq = (packet[24] << 24) | (packet[25] << 16) | (packet[26] << 8) | packet[27];
+	if (pktSeq != seq) {
+		cout << "SEQ " << hex << pktSeq << " expected " << seq << dec << endl;
+		errors++;
+	}
+	for (size_t i = 0; i < payload.size(); i++) {
+		if (packet[40 + i] != expected[i]) {
+			errors++;
+			break;
 		}
+	}
+	if (!tcpChecksumOk(packet)) {
+		cout << "Wrong TCP checksum" << endl;
+		errors++;
+	}
+	return errors;
+}
 
+/*
+ * Segments without payload and retransmissions of the last segment of a session get their
+ * checksum from txEng_checksum_cache and skip the checksum pipeline. Their checksum is checked
+ * against the full one, and so is a retransmission after a SYN-ACK invalidated the cache.
+ */
+int checksumCacheTest(txEngineBench& bench) {
+	int 			sessionID = 7;
+	int 			errors = 0;
+	int 			pipelined;
+	vector<uint8_t> message(1000);
+	ap_uint<32> 	seq;
+	extendedEvent 	headerOnly[] = {event(ACK, sessionID), event(SYN, sessionID), event(SYN_ACK, sessionID),
+									event(FIN, sessionID), rstEvent(sessionID, 0x12345678)};
+	const char* 	names[] = {"ACK", "SYN", "SYN-ACK", "FIN", "RST"};
+
+	for (int e = 0; e < 5; e++) {
+		pipelined = bench.checksumPackets;
+		bench.eventEng2txEng_event.write(headerOnly[e]);
+		if (bench.runPacket() < 0 || !tcpChecksumOk(bench.packets.back())) {
+			cout << "Checksum cache: wrong checksum of a " << names[e] << " segment" << endl;
+			errors++;
+		}
+		if (bench.checksumPackets != pipelined) {
+			cout << "Checksum cache: " << names[e] << " segment went through the checksum pipeline" << endl;
+			errors++;
+		}
+		bench.drain(100);
+	}
 
-		tx_engine(	eventEng2txEng_event,
-					rxSar2txEng_upd_rsp,
-					txSar2txEng_upd_rsp,
-					txBufferReadData,
-					sLookup2txEng_rev_rsp,
-					txEng2rxSar_upd_req,
-					txEng2txSar_upd_req,
-					txEng2timer_setRetransmitTimer,
-					txEng2timer_setProbeTimer,
-					txBufferReadCmd,
-					txEng2sLookup_rev_req,
-					ipTxData,
-					readCountFifo);
-		simulateSARtables(rxSar2txEng_upd_rsp, txSar2txEng_upd_rsp, txEng2rxSar_upd_req, txEng2txSar_upd_req);
-		simulateTxBuffer(txBufferReadCmd, txBufferReadData);
-		simulateRevSLUP(txEng2sLookup_rev_req, sLookup2txEng_rev_rsp);
-
-		count++;
+	for (size_t i = 0; i < message.size(); i++)
+		message[i] = rand();
+	seq = bench.sessions[sessionID].not_ackd;
+	bench.appWrite(sessionID, message);
+	errors += (bench.runPacket() < 0) || checkPacket(bench.packets.back(), seq, message, message.data());
+	bench.drain(100);
+
+	for (int r = 0; r < 3; r++) { 							// The same segment, cached
+		pipelined = bench.checksumPackets;
+		bench.retransmit(sessionID, seq, message.size());
+		errors += (bench.runPacket() < 0) || checkPacket(bench.packets.back(), seq, message, message.data());
+		if (bench.checksumPackets != pipelined) {
+			cout << "Checksum cache: retransmission " << r << " missed the cache" << endl;
+			errors++;
+		}
+		bench.drain(100);
 	}
-	count = 0;
-	while (count < 1000) {
-		tx_engine(	eventEng2txEng_event,
-					rxSar2txEng_upd_rsp,
-					txSar2txEng_upd_rsp,
-					txBufferReadData,
-					sLookup2txEng_rev_rsp,
-					txEng2rxSar_upd_req,
-					txEng2txSar_upd_req,
-					txEng2timer_setRetransmitTimer,
-					txEng2timer_setProbeTimer,
-					txBufferReadCmd,
-					txEng2sLookup_rev_req,
-					ipTxData,
-					readCountFifo);
-		simulateSARtables(rxSar2txEng_upd_rsp, txSar2txEng_upd_rsp, txEng2rxSar_upd_req, txEng2txSar_upd_req);
-		simulateTxBuffer(txBufferReadCmd, txBufferReadData);
-		simulateRevSLUP(txEng2sLookup_rev_req, sLookup2txEng_rev_rsp);
-		count++;
+
+	bench.eventEng2txEng_event.write(event(SYN_ACK, sessionID));
+	errors += (bench.runPacket() < 0) || !tcpChecksumOk(bench.packets.back());
+	bench.drain(100);
+	pipelined = bench.checksumPackets;
+	bench.retransmit(sessionID, seq, message.size());
+	errors += (bench.runPacket() < 0) || checkPacket(bench.packets.back(), seq, message, message.data());
+	if (bench.checksumPackets != pipelined + 1) {
+		cout << "Checksum cache: retransmission after a SYN-ACK was not checksummed again" << endl;
+		errors++;
 	}
+	bench.drain(100);
 
-	count = 0;
+	cout << "Checksum cache: " << errors << " errors" << endl;
+	return errors;
+}
 
-	//char  *output_pcap="/home/mario/Documents/cmac_100g/submodules/tcp_ip_cores/TOE/src/tx_engine/out_pcap.pcap";
+/*
+ * Cycles from the application write (or the retransmission event) to the last
+ * byte on the wire. The first transmission is cut-through, then two full segments
+ * are sent so the message is replayed from the TX buffer while the tail of the
+ * last segment is replayed from the ring.
+ */
+int main(int argc, char **argv) {
+
+	txEngineBench 	bench;
+	int 			errors = 0;
+	int 			sizes[] = {64, 256, 1024, 4096};
+	int 			latency;
+
+	srand(11);
+
+	cout << setw(10) << "bytes" << setw(14) << "first tx" << setw(14) << "rt (ring)" << setw(18) << "rt (tx buffer)" << "   cycles, app write to last byte" << endl;
+	for (int s = 0; s < 4; s++) {
+		int 			sessionID = s + 1;
+		int 			length = sizes[s];
+		vector<uint8_t> message(length);
+		vector<uint8_t> filler(MSS);
+		ap_uint<32> 	seq;
+		ap_uint<32> 	fillerSeq;
+		int 			txLatency, ringLatency, memLatency;
+
+		for (int i = 0; i < length; i++)
+			message[i] = rand();
+
+		seq = bench.sessions[sessionID].not_ackd;
+		bench.appWrite(sessionID, message);
+		txLatency = bench.runPacket();
+		errors += (txLatency < 0) || checkPacket(bench.packets.back(), seq, message, message.data());
+
+		bench.drain(100);
+		bench.retransmit(sessionID, seq, length);
+		ringLatency = bench.runPacket();
+		errors += (ringLatency < 0) || checkPacket(bench.packets.back(), seq, message, message.data());
+
+		for (int f = 0; f < 2; f++) { 							// Push the message out of the ring
+			for (int i = 0; i < MSS.to_int(); i++)
+				filler[i] = rand();
+			fillerSeq = bench.sessions[sessionID].not_ackd;
+			bench.appWrite(sessionID, filler);
+			errors += (bench.runPacket() < 0) || checkPacket(bench.packets.back(), fillerSeq, filler, filler.data());
+		}
 
-	stream2pcap(argv[1],false,true,ipTxData);
-	
-	outputFile << endl;
-	while (!readCountFifo.empty()) {
-		readCountFifo.read(read_count_fifo);
-		outputFile << dec << "readCountFifo: " << hex << read_count_fifo << endl;
-	}
-	
-	outputFile << endl;
-	count = 0;
-	txRetransmitTimerSet set;
-	while (!(txEng2timer_setRetransmitTimer.empty()))
-	{
-		txEng2timer_setRetransmitTimer.read(set);
-		outputFile  << "rtTimer ID: " << set.sessionID << " " << ((set.sessionID == values[count]) ? "match" : "no match") << endl;
-		//outputFile ;
-		count++;
-	}
+		bench.drain(100);
+		bench.retransmit(sessionID, seq, length);
+		memLatency = bench.runPacket();
+		errors += (memLatency < 0) || checkPacket(bench.packets.back(), seq, message, message.data());
 
-	count = 0;
-	while (!(txEng2timer_setProbeTimer.empty())) {
-		txEng2timer_setProbeTimer.read(sessionID);
+		bench.drain(100); 										// Unaligned tail of the last segment, still in the ring
+		vector<uint8_t> tail(filler.end() - length + 7, filler.end());
+		bench.retransmit(sessionID, fillerSeq + MSS - length + 7, length - 7);
+		latency = bench.runPacket();
+		errors += (latency < 0) || checkPacket(bench.packets.back(), fillerSeq + MSS - length + 7, tail, tail.data());
 
-		outputFile  << "timer2 ID: " << sessionID << " " << ((sessionID == values[count]) ? "match" : "no match") << endl;
-		count++;
+		cout << setw(10) << length << setw(14) << txLatency << setw(14) << ringLatency << setw(18) << memLatency << endl;
+		bench.drain(100);
 	}
 
+	errors += checksumCacheTest(bench);
 
+	if (bench.latencyMismatches != 0) {
+		cout << "ERROR " << bench.latencyMismatches << " packets on the wire do not match the latency segments" << endl;
+		errors++;
+	}
+	cout << "TX buffer read latency " << MEM_READ_LATENCY << " cycles, " << bench.packets.size() << " packets, " << errors << " errors" << endl;
 
-	values.clear();
-	lengths.clear();
-/*	values2.clear();
-	values3.clear();
-*/
-	//should return comparison
-
-	return 0;
+	return errors;
 }
@@ -53,6 +53,7 @@ using namespace std;
  *  @param[out]		txBufferReadCmd
  *  @param[out]		txEng2sLookup_rev_req
  *  @param[out]		txEng_isLookUpFifoOut
+ *  @param[out]		txEng2latency_segment, every segment with payload for the latency histogram
  *  @param[out]		txEng_tupleShortCutFifoOut
  */
 void txEng_metaLoader(
@@ -74,6 +75,9 @@ void txEng_metaLoader(
 #if (STATISTICS_MODULE)
 				stream<txStatsUpdate>&  			txEngStatsUpdate,
 #endif				
+#if (LATENCY_HISTOGRAM)
+				stream<latTxSegment>&				txEng2latency_segment,
+#endif
 				stream<fourTuple>&					txEng_tupleShortCutFifoOut,
 				stream<ap_uint<1> >&				readCountFifo)
 {
@@ -98,7 +102,6 @@ void txEng_metaLoader(
 	static ap_uint<WINDOW_BITS> 	currLength;
 	static ap_uint<WINDOW_BITS> 	usedLength;
 	static ap_uint<WINDOW_BITS> 	usableWindow;
-	static bool     				ackd_eq_not_ackd;
 	ap_uint<WINDOW_BITS> 			usableWindow_w;
 	
 
@@ -160,6 +163,7 @@ void txEng_metaLoader(
 			ml_segmentCount = 0;
 			break;
 		case 1:
+			meta.sessionID = ml_curEvent.sessionID;
 			switch(ml_curEvent.type)
 			{
 			// When Nagle's algorithm disabled
@@ -197,6 +201,12 @@ void txEng_metaLoader(
 
 					meta.length = ml_curEvent.length;
 
+#if (TX_RETRANSMIT_RING)
+					// The address tells the retransmission ring where the payload goes
+					pkgAddr(31, 30) 			= (!RX_DDR_BYPASS);
+					pkgAddr(30, WINDOW_BITS)  	= ml_curEvent.sessionID(13, 0);
+					pkgAddr(WINDOW_BITS-1, 0) 	= txSar.not_ackd(WINDOW_BITS-1, 0);
+#endif
 					//TODO some checking
 					txSar.not_ackd += ml_curEvent.length;
 
@@ -208,17 +218,23 @@ void txEng_metaLoader(
 					
 						txEng_ipMetaFifoOut.write(meta.length);
 						txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+						txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID, meta.length));
+#endif
+#if (LATENCY_HISTOGRAM)
+						txEng2latency_segment.write(latTxSegment(ml_curEvent.sessionID, meta.seqNumb, meta.length, false));
+#endif
 						txEng_isLookUpFifoOut.write(true);
 						txEng_isDDRbypass.write(true);
+#if (TX_RETRANSMIT_RING)
+						txBufferReadCmd.write(cmd_internal(pkgAddr, meta.length));
+#endif
 						txEng2sLookup_rev_req.write(ml_curEvent.sessionID);
 
 						// Only set RT timer if we actually send sth, TODO only set if we change state and sent sth
 						txEng2timer_setRetransmitTimer.write(txRetransmitTimerSet(ml_curEvent.sessionID));
 					}//TODO if probe send msg length 1
 					ml_sarLoaded = true;
-#if (STATISTICS_MODULE)					
-					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID,meta.length)); // Update Statistics
-#endif
 				}
 
 				break;
@@ -233,7 +249,6 @@ void txEng_metaLoader(
 						currLength 			= txSar.currLength;
 						usedLength 			= txSar.usedLength;
 						usableWindow_w 		= txSar.UsableWindow;
-						ackd_eq_not_ackd 	= txSar.ackd_eq_not_ackd;
 
 						meta.window_size 	= rxSar.windowSize;	//Get our space, Advertise at least a quarter/half, otherwise 0
 						meta.rst 			= 0;
@@ -325,6 +340,12 @@ void txEng_metaLoader(
 					// Send a packet only if there is data or we want to send an empty probing message
 						txEng_ipMetaFifoOut.write(meta.length);
 						txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+						txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID, meta.length));
+#endif
+#if (LATENCY_HISTOGRAM)
+						txEng2latency_segment.write(latTxSegment(ml_curEvent.sessionID, meta.seqNumb, meta.length, false));
+#endif
 						txEng_isLookUpFifoOut.write(true);
 						txEng2sLookup_rev_req.write(ml_curEvent.sessionID);
 						// Only set RT timer if we actually send sth, TODO only set if we change state and sent sth
@@ -337,12 +358,8 @@ void txEng_metaLoader(
 					currLength 		= next_currLength;		// Update next iteration variables
 					usedLength 		= next_usedLength;
 					txSar.not_ackd  = txSar_not_ackd_w;
-					ackd_eq_not_ackd = (txSar.ackd == txSar_not_ackd_w) ? true : false;
 					txSar_r = txSar;
 					ml_sarLoaded = true;
-#if (STATISTICS_MODULE)						
-					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID,meta.length)); // Update Statistics
-#endif
 
 				}
 				break;
@@ -412,6 +429,12 @@ void txEng_metaLoader(
 						txBufferReadCmd.write(cmd_internal(pkgAddr, meta.length));
 						txEng_ipMetaFifoOut.write(meta.length);
 						txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+						txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID, meta.length, true));				// Retransmission
+#endif
+#if (LATENCY_HISTOGRAM)
+						txEng2latency_segment.write(latTxSegment(ml_curEvent.sessionID, meta.seqNumb, meta.length, true));
+#endif
 						txEng_isLookUpFifoOut.write(true);
 #if (TCP_NODELAY)
 						txEng_isDDRbypass.write(false);
@@ -422,9 +445,6 @@ void txEng_metaLoader(
 					}
 					ml_sarLoaded = true;
 					txSar_r = txSar;
-#if (STATISTICS_MODULE)						
-					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID,0,true)); // Update Statistics retransmission
-#endif				
 				}
 				break;
 
@@ -489,6 +509,12 @@ void txEng_metaLoader(
 					txBufferReadCmd.write(cmd_internal(pkgAddr, meta.length));
 					txEng_ipMetaFifoOut.write(meta.length);
 					txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID, meta.length, true));				// Retransmission
+#endif
+#if (LATENCY_HISTOGRAM)
+					txEng2latency_segment.write(latTxSegment(ml_curEvent.sessionID, meta.seqNumb, meta.length, true));
+#endif
 					txEng_isLookUpFifoOut.write(true);
 #if (TCP_NODELAY)
 					txEng_isDDRbypass.write(false);
@@ -498,9 +524,6 @@ void txEng_metaLoader(
 					txEng2timer_setRetransmitTimer.write(txRetransmitTimerSet(ml_curEvent.sessionID));
 				}
 
-#if (STATISTICS_MODULE)						
-				txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID,0,true)); // Update Statistics retransmission
-#endif				
 
 				break;
 
@@ -521,12 +544,12 @@ void txEng_metaLoader(
 					meta.fin = 0;
 					txEng_ipMetaFifoOut.write(meta.length);
 					txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID));
+#endif
 					txEng_isLookUpFifoOut.write(true);
 					txEng2sLookup_rev_req.write(ml_curEvent.sessionID);
 					ml_FsmState = 0;
-#if (STATISTICS_MODULE)						
-					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID)); // Update Statistics ACK number of packets
-#endif				
 				}
 				break;
 			case SYN:
@@ -558,15 +581,15 @@ void txEng_metaLoader(
 #endif						
 					txEng_ipMetaFifoOut.write(meta.length); 		//length
 					txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID, 0, true, false, false, ml_curEvent.rt_count != 0));	// Options are no payload
+#endif
 					txEng_isLookUpFifoOut.write(true);
 					txEng2sLookup_rev_req.write(ml_curEvent.sessionID);
 					// set retransmit timer
 					txEng2timer_setRetransmitTimer.write(txRetransmitTimerSet(ml_curEvent.sessionID, SYN));
 					//txSar_r = txSar ;
 					ml_FsmState = 0;
-#if (STATISTICS_MODULE)						
-					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID,0,true,false,false,false)); // Initialize Statistics SYN
-#endif				
 				}
 				break;
 			case SYN_ACK:
@@ -599,15 +622,15 @@ void txEng_metaLoader(
 #endif						
 					txEng_ipMetaFifoOut.write(meta.length); 		//length
 					txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID, 0, false, true, false, ml_curEvent.rt_count != 0));	// Options are no payload
+#endif
 					txEng_isLookUpFifoOut.write(true);
 					txEng2sLookup_rev_req.write(ml_curEvent.sessionID);
 
 					// set retransmit timer
 					txEng2timer_setRetransmitTimer.write(txRetransmitTimerSet(ml_curEvent.sessionID, SYN_ACK));
 					ml_FsmState = 0;
-#if (STATISTICS_MODULE)						
-					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID,0,false,true,false,false)); // Initialize Statistics SYN-ACK
-#endif				
 				}
 				break;
 			case FIN:
@@ -657,6 +680,9 @@ void txEng_metaLoader(
 					{
 						txEng_ipMetaFifoOut.write(meta.length);
 						txEng_tcpMetaFifoOut.write(meta);
+#if (STATISTICS_MODULE)
+						txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID, 0, false, false, true, ml_curEvent.rt_count != 0));
+#endif
 						txEng_isLookUpFifoOut.write(true);
 						txEng2sLookup_rev_req.write(ml_curEvent.sessionID);
 						// set retransmit timer
@@ -666,9 +692,6 @@ void txEng_metaLoader(
 
 //					txSar_r = txSar ;
 					ml_FsmState = 0;
-#if (STATISTICS_MODULE)						
-					txEngStatsUpdate.write(txStatsUpdate(ml_curEvent.sessionID,0,false,false,true,false)); // Update Statistics FIN
-#endif				
 				}
 				break;
 			case RST:
@@ -679,6 +702,12 @@ void txEng_metaLoader(
 					txEng_tcpMetaFifoOut.write(tx_engine_meta(0, resetEvent.getAckNumb(), 1, 1, 0, 0));
 					txEng_isLookUpFifoOut.write(false);
 					txEng_tupleShortCutFifoOut.write(ml_curEvent.tuple);
+#if (STATISTICS_MODULE)
+					txStatsUpdate rstStats(0);
+					rstStats.rst = true;
+					rstStats.session = false;
+					txEngStatsUpdate.write(rstStats);
+#endif
 					//ml_FsmState = 0;
 				}
 				else if (!txSar2txEng_upd_rsp.empty()) {
@@ -689,6 +718,11 @@ void txEng_metaLoader(
 					//if (resetEvent.getAckNumb() != 0)
 					//{
 						txEng_tcpMetaFifoOut.write(tx_engine_meta(txSar.not_ackd, resetEvent.getAckNumb(), 1, 1, 0, 0));
+#if (STATISTICS_MODULE)
+						txStatsUpdate rstStats(resetEvent.sessionID);
+						rstStats.rst = true;
+						txEngStatsUpdate.write(rstStats);
+#endif
 					/*}
 					/else
 					{
@@ -814,18 +848,54 @@ void txEng_ipHeader_Const(
 
 }
 
+/** @ingroup tx_engine
+ *  One's complement addition, the carry out is added back in
+ */
+ap_uint<16> txEng_onesComplementAdd(ap_uint<16> a, ap_uint<16> b) {
+#pragma HLS INLINE
+
+	ap_uint<17> sum = a + b;
+	return sum(15,0) + sum.bit(16);
+}
+
+/** @ingroup tx_engine
+ *  One's complement sum of the pseudo header and TCP header, including options.
+ *  Fields are taken in network order, the same way the checksum pipeline does
+ *  @param[in]		header, first 40 bytes of the pseudo header word
+ *  @return			16-bit folded sum
+ */
+ap_uint<16> txEng_tcpHeaderSum(ap_uint<320> header) {
+#pragma HLS INLINE
+
+	ap_uint<21> sum = 0;
+	ap_uint<17> final_sum;
+
+	tcp_header_sum: for (int i = 0; i < 20; i++){
+	#pragma HLS UNROLL
+		sum += byteSwap16(header(i*16+15, i*16));
+	}
+
+	final_sum = sum(15,0) + sum(20,16);
+	final_sum = final_sum(15,0) + final_sum.bit(16);
+	return final_sum(15,0);
+}
+
 /** @ingroup tx_engine
  * 	Reads the TCP header metadata and the IP tuples. From this data it generates the TCP pseudo header and streams it out.
+ *  The header sum is computed here and sent to @ref txEng_checksum_cache
  *  @param[in]		tcpMetaDataFifoIn
  *  @param[in]		tcpTupleFifoIn
  *  @param[out]		dataOut
+ *  @param[out]		txEng_packet_with_payload
+ *  @param[out]		txEng_checksumMetaOut
  */
 
 void txEng_pseudoHeader_Const(
 								stream<tx_engine_meta>&		tcpMetaDataFifoIn,
 								stream<fourTuple>&			tcpTupleFifoIn,
 								stream<axiWord>&			dataOut,
-								stream<bool>& 				txEng_packet_with_payload)
+								stream<bool>& 				txEng_packet_with_payload,
+								stream<txChecksumMeta>&		txEng_checksumMetaOut)
 {
 #pragma HLS INLINE off
 #pragma HLS pipeline II=1
@@ -924,18 +994,23 @@ void txEng_pseudoHeader_Const(
 		sendWord.last=1;
 		dataOut.write(sendWord);
 		txEng_packet_with_payload.write(packet_has_payload);
+		txEng_checksumMetaOut.write(txChecksumMeta(phc_meta.sessionID, phc_meta.seqNumb, phc_meta.length, 
+			txEng_tcpHeaderSum(sendWord.data(319, 0)), packet_has_payload, phc_meta.syn));
 	}
 }
 
 /** @ingroup tx_engine
  *  It appends the pseudo TCP header with the corresponding payload stream.
+ *  The packet is only copied to the checksum pipeline when its checksum cannot be computed locally
  *	@param[in]		txEng_pseudo_tcpHeader, incoming TCP pseudo header stream
+ *	@param[in]		txEng_fullChecksum, whether the packet goes to the checksum pipeline
  *	@param[in]		txBufferReadData, incoming payload stream
  *	@param[out]		dataOut, outgoing data stream
  */
 void txEng_payload_stitcher(
 					stream<axiWord>&		txEng_pseudo_tcpHeader,
 					stream<bool>& 			txEng_packet_with_payload,
+					stream<bool>& 			txEng_fullChecksum,
 					stream<axiWord>&		txBufferReadData,
 					stream<axiWord>&		txEngTcpSegOut,
 					stream<axiWord>&		txEng2cksum)
@@ -945,6 +1020,7 @@ void txEng_payload_stitcher(
 #pragma HLS pipeline II=1
 	
 	static axiWord 		prevWord;
+	static bool 		full_checksum;
 	axiWord 			payload_word;
 	axiWord 			sendWord = axiWord(0, 0, 0);
 	bool 				packet_has_payload;
@@ -955,13 +1031,15 @@ void txEng_payload_stitcher(
 
 	switch (teps_fsm_state) {
 		case READ_PSEUDO: 
-			if (!txEng_pseudo_tcpHeader.empty() && !txEng_packet_with_payload.empty()){
+			if (!txEng_pseudo_tcpHeader.empty() && !txEng_packet_with_payload.empty() && !txEng_fullChecksum.empty()){
 				txEng_pseudo_tcpHeader.read(prevWord);
 				txEng_packet_with_payload.read(packet_has_payload);
+				txEng_fullChecksum.read(full_checksum);
 
 				if (!packet_has_payload){ 				// Payload is not needed because length==0 or is a SYN packet, send it immediately 
 					txEngTcpSegOut.write(prevWord);
-					txEng2cksum.write(prevWord);
+					if (full_checksum)
+						txEng2cksum.write(prevWord);
 				}
 				else {
 					teps_fsm_state = READ_PAYLOAD;
@@ -990,7 +1068,8 @@ void txEng_payload_stitcher(
 				}
 
 				txEngTcpSegOut.write(sendWord);
-				txEng2cksum.write(sendWord);
+				if (full_checksum)
+					txEng2cksum.write(sendWord);
 				
 				prevWord.data(255,  0) 	= 	payload_word.data(511,256);
 				prevWord.keep( 31,  0) 	= 	payload_word.keep( 63, 32);
@@ -1004,13 +1083,98 @@ void txEng_payload_stitcher(
 			sendWord.last 		   	= 1;
 			//cout << "pseudo 3: " << hex << sendWord.data << "\tkeep: " << sendWord.keep << "\tlast: " << dec << sendWord.last << endl;
 			txEngTcpSegOut.write(sendWord);
-			txEng2cksum.write(sendWord);
+			if (full_checksum)
+				txEng2cksum.write(sendWord);
 			teps_fsm_state = READ_PSEUDO;
 			break;
 	}
 
 }
 
+/** @ingroup tx_engine
+ *  Decides where the TCP checksum of each segment is computed and returns the checksums in order.
+ *  Segments without payload (ACK, SYN, FIN, RST) only need the header sum, so their checksum is 
+ *  computed here and they skip the checksum pipeline.
+ *  For every segment that goes through the checksum pipeline the payload sum is recovered from
+ *  the result, RFC 1624: payload = ~checksum - header. It is kept per session together with
+ *  the sequence number and length of the segment. A retransmission of the same segment only
+ *  differs in the header, its checksum is then the combination of the new header sum and the 
+ *  cached payload sum. SYN and SYN-ACK invalidate the entry of the session.
+ *  @param[in]		txEng_checksumMetaIn, header sum and segment information
+ *  @param[in]		txEng_checksumResultIn, checksum of the segments sent to the checksum pipeline
+ *  @param[out]		txEng_fullChecksum, tells @ref txEng_payload_stitcher to send the segment to the checksum pipeline
+ *  @param[out]		txEng_tcpChecksumOut, checksum of every segment in transmission order
+ */
+void txEng_checksum_cache(
+					stream<txChecksumMeta>&		txEng_checksumMetaIn,
+					stream<ap_uint<16> >&		txEng_checksumResultIn,
+					stream<bool>&				txEng_fullChecksum,
+					stream<ap_uint<16> >&		txEng_tcpChecksumOut)
+{
+#pragma HLS INLINE off
+#pragma HLS pipeline II=1
+
+	static txChecksumEntry	checksumCache[MAX_SESSIONS];
+	#pragma HLS RESOURCE variable=checksumCache core=RAM_2P_BRAM
+	#pragma HLS DATA_PACK variable=checksumCache
+	#pragma HLS DEPENDENCE variable=checksumCache inter false
+
+	static stream<txChecksumPending>	pendingFifo("pendingFifo");
+	#pragma HLS stream variable=pendingFifo depth=32
+	#pragma HLS DATA_PACK variable=pendingFifo
+
+	static txChecksumPending	pending;
+	static bool 				pendingLoaded = false;
+
+	txChecksumMeta 		meta;
+	txChecksumEntry 	entry;
+	ap_uint<16> 		checksum;
+	ap_uint<16> 		payloadSum;
+
+	// Lookup side
+	if (!txEng_checksumMetaIn.empty() && !pendingFifo.full()){
+		txEng_checksumMetaIn.read(meta);
+		entry = checksumCache[meta.sessionID];
+
+		if (!meta.hasPayload){
+			pendingFifo.write(txChecksumPending(meta.sessionID, meta.seqNumb, meta.length, ~meta.headerSum, true, meta.syn));
+			txEng_fullChecksum.write(false);
+		}
+		else if (entry.valid && entry.seqNumb == meta.seqNumb && entry.length == meta.length){
+			checksum = ~txEng_onesComplementAdd(meta.headerSum, entry.payloadSum);
+			pendingFifo.write(txChecksumPending(meta.sessionID, meta.seqNumb, meta.length, checksum, true, false));
+			txEng_fullChecksum.write(false);
+		}
+		else {
+			pendingFifo.write(txChecksumPending(meta.sessionID, meta.seqNumb, meta.length, meta.headerSum, false, false));
+			txEng_fullChecksum.write(true);
+		}
+	}
+
+	// Result side, segments leave in the same order they came in
+	if (!pendingLoaded && !pendingFifo.empty()){
+		pendingFifo.read(pending);
+		pendingLoaded = true;
+	}
+
+	if (pendingLoaded){
+		if (pending.local){
+			if (pending.invalidate){
+				checksumCache[pending.sessionID] = txChecksumEntry(false, 0, 0, 0);
+			}
+			txEng_tcpChecksumOut.write(pending.value);
+			pendingLoaded = false;
+		}
+		else if (!txEng_checksumResultIn.empty()){
+			txEng_checksumResultIn.read(checksum);
+			payloadSum = txEng_onesComplementAdd(~checksum, ~pending.value);
+			checksumCache[pending.sessionID] = txChecksumEntry(true, pending.seqNumb, pending.length, payloadSum);
+			txEng_tcpChecksumOut.write(checksum);
+			pendingLoaded = false;
+		}
+	}
+}
+
 /** @ingroup tx_engine
  *  Reads the IP header stream and the payload stream. It also inserts TCP checksum
  *  The complete packet is then streamed out of the TCP engine. 
@@ -1025,6 +1189,9 @@ void txEng_ip_pkt_stitcher(
 					stream<axiWord>& 		txEng_ipHeaderBufferIn,
 					stream<axiWord>& 		txEng_tcp_level_packet,
 					stream<ap_uint<16> >& 	txEng_tcpChecksumFifoIn,
+#if (LATENCY_HISTOGRAM)
+					stream<ap_uint<32> >&	txEng2latency_wireSeq,
+#endif
 					stream<axiWord>& 		DataOut)
 {
 #pragma HLS INLINE off
@@ -1036,6 +1203,8 @@ void txEng_ip_pkt_stitcher(
 	static axiWord prevWord;
 	
 	ap_uint<16> tcp_checksum;
+	ap_uint<16> ipTotalLength;
+	ap_uint<16> tcpHeaderLength;
 	enum teips_states {READ_FIRST, READ_PAYLOAD, EXTRA_WORD};
 	static teips_states teips_fsm_state = READ_FIRST;
 
@@ -1063,6 +1232,14 @@ void txEng_ip_pkt_stitcher(
 				else
 					teips_fsm_state = READ_PAYLOAD;
 
+#if (LATENCY_HISTOGRAM)
+				// The sequence number of every packet with payload, when it goes on the wire
+				ipTotalLength 	= (sendWord.data(23, 16), sendWord.data(31, 24));
+				tcpHeaderLength = sendWord.data(263, 260) * 4;
+				if (ipTotalLength != 20 + tcpHeaderLength) {
+					txEng2latency_wireSeq.write((sendWord.data(199, 192), sendWord.data(207, 200), sendWord.data(215, 208), sendWord.data(223, 216)));
+				}
+#endif
 				prevWord = payload;
 				//cout << "IP Stitcher 0: " << hex << sendWord.data << "\tkeep: " << sendWord.keep << "\tlast: " << dec << sendWord.last << endl;
 				DataOut.write(sendWord);				
@@ -1169,6 +1346,177 @@ void txEng_PseudoHeader_Remover(
 
 }
 
+#if (TX_RETRANSMIT_RING)
+/** @ingroup tx_engine
+ *  Keeps track of which bytes of each session are in the retransmission ring and decides where
+ *  the payload of every segment comes from. The ring of a session holds the last bytes sent
+ *  for the first time, as long as they were contiguous. A retransmission that falls completely 
+ *  inside them is replayed from the ring, otherwise the TX buffer is read
+ *  @param[in]		txEng_isDDRbypass, true for first transmissions
+ *  @param[in]		txBufferReadCmd, address and length of every segment with payload
+ *  @param[out]		txMemReadCmd, segments that have to be read from the TX buffer
+ *  @param[out]		txEng_ringOp, source of the payload of every segment
+ */
+void txEng_retransmit_ring_lookup(
+					stream<bool>&				txEng_isDDRbypass,
+					stream<cmd_internal>&		txBufferReadCmd,
+					stream<cmd_internal>&		txMemReadCmd,
+					stream<txRingOp>&			txEng_ringOp)
+{
+#pragma HLS INLINE off
+#pragma HLS pipeline II=1
+
+	static ap_uint<WINDOW_BITS> 	ringEnd[MAX_SESSIONS];
+	static ap_uint<TX_RING_BITS+1> 	ringFill[MAX_SESSIONS];
+
+	bool 							is_bypass;
+	cmd_internal 					cmd;
+	ap_uint<16> 					sessionID;
+	ap_uint<WINDOW_BITS> 			offset;
+	ap_uint<WINDOW_BITS> 			distance;
+	ap_uint<WINDOW_BITS+1> 			fill;
+
+	if (!txEng_isDDRbypass.empty() && !txBufferReadCmd.empty()){
+		txEng_isDDRbypass.read(is_bypass);
+		txBufferReadCmd.read(cmd);
+		sessionID 	= cmd.addr(WINDOW_BITS + 13, WINDOW_BITS);
+		offset 		= cmd.addr(WINDOW_BITS - 1, 0);
+
+		if (is_bypass){
+			fill = (offset == ringEnd[sessionID]) ? ringFill[sessionID] : (ap_uint<TX_RING_BITS+1>) 0; 	// A gap invalidates what was in the ring
+			fill += cmd.length;
+			if (fill > (1 << TX_RING_BITS))
+				fill = (1 << TX_RING_BITS);
+			ringFill[sessionID] = fill;
+			ringEnd[sessionID] 	= offset + cmd.length;
+			txEng_ringOp.write(txRingOp(sessionID, offset(TX_RING_BITS - 1, 0), cmd.length, TX_RING_CAPTURE));
+		}
+		else {
+			distance = ringEnd[sessionID] - offset;
+			if (distance <= ringFill[sessionID] && cmd.length <= distance){
+				txEng_ringOp.write(txRingOp(sessionID, offset(TX_RING_BITS - 1, 0), cmd.length, TX_RING_REPLAY));
+			}
+			else {
+				txMemReadCmd.write(cmd);
+				txEng_ringOp.write(txRingOp(sessionID, offset(TX_RING_BITS - 1, 0), cmd.length, TX_RING_MEMORY));
+			}
+		}
+	}
+}
+
+/** @ingroup tx_engine
+ *  Delivers the payload of every segment from its source. First transmissions come straight from
+ *  the application and are copied to the ring, retransmissions come from the ring or the TX buffer.
+ *  The ring is split in 64 byte-wide banks so a segment is written or read at one word per cycle
+ *  whatever its offset
+ *  @param[in]		txEng_ringOp, source of the payload of every segment
+ *  @param[in]		txAppDataIn, payload of first transmissions
+ *  @param[in]		txMemDataIn, payload read from the TX buffer
+ *  @param[out]		DataOut, payload to the stitcher
+ */
+void txEng_retransmit_ring(
+					stream<txRingOp>&			txEng_ringOp,
+					stream<axiWord>&			txAppDataIn,
+					stream<axiWord>&			txMemDataIn,
+					stream<axiWord>&			DataOut)
+{
+#pragma HLS INLINE off
+#pragma HLS pipeline II=1
+
+	static ap_uint<8> 	ringBuffer[64][MAX_SESSIONS * TX_RING_ROWS];
+	#pragma HLS ARRAY_PARTITION variable=ringBuffer complete dim=1
+	#pragma HLS DEPENDENCE variable=ringBuffer inter false
+
+	enum ter_states {READ_OP, CAPTURE, REPLAY, MEMORY};
+	static ter_states ter_fsm_state = READ_OP;
+
+	static txRingOp 						op;
+	static ap_uint<TX_RING_BITS-6> 			word_count;
+	static ap_uint<16> 						remaining;
+
+	axiWord 								currWord;
+	axiWord 								sendWord;
+	ap_uint<6> 								shift = op.addr(5, 0);
+	ap_uint<TX_RING_BITS-6> 				row;
+	ap_uint<512> 							rotData;
+	ap_uint<64> 							rotKeep;
+	ap_uint<512> 							bankData;
+
+	switch (ter_fsm_state){
+		case READ_OP:
+			if (!txEng_ringOp.empty()){
+				txEng_ringOp.read(op);
+				word_count 	= 0;
+				remaining 	= op.length;
+				if (op.type == TX_RING_CAPTURE)
+					ter_fsm_state = CAPTURE;
+				else if (op.type == TX_RING_REPLAY)
+					ter_fsm_state = REPLAY;
+				else
+					ter_fsm_state = MEMORY;
+			}
+			break;
+		case CAPTURE:
+			if (!txAppDataIn.empty() && !DataOut.full()){
+				txAppDataIn.read(currWord);
+				DataOut.write(currWord);
+
+				// Byte i of the word goes to bank (shift + i) % 64
+				if (shift == 0){
+					rotData = currWord.data;
+					rotKeep = currWord.keep;
+				}
+				else {
+					rotData = elementFunnelRight<8,64>(currWord.data, currWord.data, 64 - shift);
+					rotKeep = elementFunnelRight<1,64>(currWord.keep, currWord.keep, 64 - shift);
+				}
+				ring_capture: for (int b = 0; b < 64; b++){
+				#pragma HLS UNROLL
+					row = op.addr(TX_RING_BITS - 1, 6) + word_count + (b < shift.to_int());
+					if (rotKeep.bit(b))
+						ringBuffer[b][op.sessionID * TX_RING_ROWS + row] = rotData(b*8+7, b*8);
+				}
+				word_count++;
+
+				if (currWord.last)
+					ter_fsm_state = READ_OP;
+			}
+			break;
+		case REPLAY:
+			if (!DataOut.full()){
+				ring_replay: for (int b = 0; b < 64; b++){
+				#pragma HLS UNROLL
+					row = op.addr(TX_RING_BITS - 1, 6) + word_count + (b < shift.to_int());
+					bankData(b*8+7, b*8) = ringBuffer[b][op.sessionID * TX_RING_ROWS + row];
+				}
+				// Output byte i comes from bank (shift + i) % 64
+				sendWord.data = (shift == 0) ? bankData : elementFunnelRight<8,64>(bankData, bankData, shift);
+				if (remaining > 64){
+					sendWord.keep 	= 0xFFFFFFFFFFFFFFFF;
+					sendWord.last 	= 0;
+					remaining 		-= 64;
+				}
+				else {
+					sendWord.keep 	= lowMask<64>(remaining);
+					sendWord.last 	= 1;
+					ter_fsm_state 	= READ_OP;
+				}
+				DataOut.write(sendWord);
+				word_count++;
+			}
+			break;
+		case MEMORY:
+			if (!txMemDataIn.empty() && !DataOut.full()){
+				txMemDataIn.read(currWord);
+				DataOut.write(currWord);
+				if (currWord.last)
+					ter_fsm_state = READ_OP;
+			}
+			break;
+	}
+}
+#endif
+
 /** @ingroup tx_engine
  *  @param[in]		eventEng2txEng_event
  *  @param[in]		rxSar2txEng_upd_rsp
@@ -1181,6 +1529,8 @@ void txEng_PseudoHeader_Remover(
  *  @param[out]		txEng2timer_setProbeTimer
  *  @param[out]		txBufferReadCmd
  *  @param[out]		txEng2sLookup_rev_req
+ *  @param[out]		txEng2latency_segment
+ *  @param[out]		txEng2latency_wireSeq
  *  @param[out]		ipTxData
  */
 void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
@@ -1193,6 +1543,10 @@ void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
 #if (STATISTICS_MODULE)
 				stream<txStatsUpdate>&  		txEngStatsUpdate,
 #endif					
+#if (LATENCY_HISTOGRAM)
+				stream<latTxSegment>&			txEng2latency_segment,
+				stream<ap_uint<32> >&			txEng2latency_wireSeq,
+#endif
 				stream<fourTuple>&				sLookup2txEng_rev_rsp,
 				stream<ap_uint<16> >&			txEng2rxSar_req,
 				stream<txTxSarQuery>&			txEng2txSar_upd_req,
@@ -1267,10 +1621,34 @@ void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
 	#pragma HLS stream variable=txBufferReadData_aligned depth=512  
 	#pragma HLS DATA_PACK variable=txBufferReadData_aligned
 
+#if (TX_RETRANSMIT_RING)
+	static stream<cmd_internal> txRingLookup2memAccessBreakdown("txRingLookup2memAccessBreakdown");
+	#pragma HLS stream variable=txRingLookup2memAccessBreakdown depth=32
+	#pragma HLS DATA_PACK variable=txRingLookup2memAccessBreakdown
+
+	static stream<txRingOp>		txEng_ringOp("txEng_ringOp");
+	#pragma HLS stream variable=txEng_ringOp depth=32
+	#pragma HLS DATA_PACK variable=txEng_ringOp
+
+	static stream<axiWord>		txBufferReadData_memory("txBufferReadData_memory");
+	#pragma HLS stream variable=txBufferReadData_memory depth=512  
+	#pragma HLS DATA_PACK variable=txBufferReadData_memory
+#endif
+
 	static stream<bool>				txEng_packet_with_payload("txEng_packet_with_payload");
 	#pragma HLS stream variable=txEng_packet_with_payload depth=32
 	#pragma HLS DATA_PACK variable=txEng_packet_with_payload
 
+	static stream<txChecksumMeta>	txEng_checksumMeta("txEng_checksumMeta");
+	#pragma HLS stream variable=txEng_checksumMeta depth=32
+	#pragma HLS DATA_PACK variable=txEng_checksumMeta
+
+	static stream<bool>				txEng_fullChecksum("txEng_fullChecksum");
+	#pragma HLS stream variable=txEng_fullChecksum depth=32
+
+	static stream<ap_uint<16> >		txEng_tcpChecksumFifo("txEng_tcpChecksumFifo");
+	#pragma HLS stream variable=txEng_tcpChecksumFifo depth=32
+
 	txEng_metaLoader(	
 				eventEng2txEng_event,
 				rxSar2txEng_rsp,
@@ -1290,12 +1668,28 @@ void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
 #if (STATISTICS_MODULE)
 				txEngStatsUpdate,
 #endif						
+#if (LATENCY_HISTOGRAM)
+				txEng2latency_segment,
+#endif
 				txEng_tupleShortCutFifo,
 				readCountFifo);
+#if (TX_RETRANSMIT_RING)
+	txEng_retransmit_ring_lookup(
+				txEng_isDDRbypass,
+				txMetaloader2memAccessBreakdown,
+				txRingLookup2memAccessBreakdown,
+				txEng_ringOp);
+
+	tx_ReadMemAccessBreakdown(
+				txRingLookup2memAccessBreakdown, 
+				txBufferReadCmd, 
+				memAccessBreakdown);
+#else
 	tx_ReadMemAccessBreakdown(
 				txMetaloader2memAccessBreakdown, 
 				txBufferReadCmd, 
 				memAccessBreakdown);
+#endif
 
 	txEng_tupleSplitter(	
 				sLookup2txEng_rev_rsp,
@@ -1313,8 +1707,21 @@ void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
 				txEng_tcpMetaFifo, 
 				txEng_tcpTupleFifo, 
 				txEng_pseudo_tcpHeader,
-				txEng_packet_with_payload);
+				txEng_packet_with_payload,
+				txEng_checksumMeta);
 
+#if (TX_RETRANSMIT_RING)
+	tx_MemDataRead_aligner(
+				txBufferReadData_unaligned,
+				memAccessBreakdown,
+				txBufferReadData_memory);
+
+	txEng_retransmit_ring(
+				txEng_ringOp,
+				txApp2txEng2PseudoHeader,
+				txBufferReadData_memory,
+				txBufferReadData_aligned);
+#else
 	tx_MemDataRead_aligner(
 				txBufferReadData_unaligned,
 				memAccessBreakdown,
@@ -1323,14 +1730,22 @@ void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
 				txApp2txEng2PseudoHeader,
 	#endif
 				txBufferReadData_aligned);
+#endif
 
 	txEng_payload_stitcher(	
 				txEng_pseudo_tcpHeader,
 				txEng_packet_with_payload,
+				txEng_fullChecksum,
 				txBufferReadData_aligned,
 				tx_Eng_pseudo_pkt,
 				tx_pseudo_packet_to_checksum);
 
+	txEng_checksum_cache(
+				txEng_checksumMeta,
+				tx_pseudo_packet_res_checksum,
+				txEng_fullChecksum,
+				txEng_tcpChecksumFifo);
+
 	txEng_PseudoHeader_Remover(
 				tx_Eng_pseudo_pkt,
 				txEng_tcp_level_packet);
@@ -1338,6 +1753,37 @@ void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
 	txEng_ip_pkt_stitcher(
 				txEng_ipHeaderBuffer, 
 				txEng_tcp_level_packet, 
-				tx_pseudo_packet_res_checksum, 
+				txEng_tcpChecksumFifo, 
+#if (LATENCY_HISTOGRAM)
+				txEng2latency_wireSeq,
+#endif
 				ipTxData);
+
+#if (INSTRUMENTATION)
+	INSTR_FIFO(txEng_ipMetaFifo,				16,		"txEng_metaLoader",			"txEng_ipHeader_Const");
+	INSTR_FIFO(txEng_tcpMetaFifo,				16,		"txEng_metaLoader",			"txEng_pseudoHeader_Const");
+	INSTR_FIFO(txMetaloader2memAccessBreakdown,	32,		"txEng_metaLoader",			TX_RETRANSMIT_RING ? "txEng_retransmit_ring_lookup" : "tx_ReadMemAccessBreakdown");
+	INSTR_FIFO(txEng_isLookUpFifo,				32,		"txEng_metaLoader",			"txEng_tupleSplitter");
+#if (TCP_NODELAY)
+	INSTR_FIFO(txEng_isDDRbypass,				32,		"txEng_metaLoader",			TX_RETRANSMIT_RING ? "txEng_retransmit_ring_lookup" : "tx_MemDataRead_aligner");
+#endif
+	INSTR_FIFO(txEng_tupleShortCutFifo,			4,		"txEng_metaLoader",			"txEng_tupleSplitter");
+	INSTR_FIFO(txEng_ipTupleFifo,				4,		"txEng_tupleSplitter",		"txEng_ipHeader_Const");
+	INSTR_FIFO(txEng_tcpTupleFifo,				4,		"txEng_tupleSplitter",		"txEng_pseudoHeader_Const");
+	INSTR_FIFO(memAccessBreakdown,				32,		"tx_ReadMemAccessBreakdown","tx_MemDataRead_aligner");
+#if (TX_RETRANSMIT_RING)
+	INSTR_FIFO(txRingLookup2memAccessBreakdown,	32,		"txEng_retransmit_ring_lookup", "tx_ReadMemAccessBreakdown");
+	INSTR_FIFO(txEng_ringOp,					32,		"txEng_retransmit_ring_lookup", "txEng_retransmit_ring");
+	INSTR_FIFO(txBufferReadData_memory,			512,	"tx_MemDataRead_aligner",	"txEng_retransmit_ring");
+#endif
+	INSTR_FIFO(txBufferReadData_aligned,		512,	TX_RETRANSMIT_RING ? "txEng_retransmit_ring" : "tx_MemDataRead_aligner", "txEng_payload_stitcher");
+	INSTR_FIFO(txEng_ipHeaderBuffer,			512,	"txEng_ipHeader_Const",		"txEng_ip_pkt_stitcher");
+	INSTR_FIFO(txEng_pseudo_tcpHeader,			512,	"txEng_pseudoHeader_Const",	"txEng_payload_stitcher");
+	INSTR_FIFO(txEng_packet_with_payload,		32,		"txEng_pseudoHeader_Const",	"txEng_payload_stitcher");
+	INSTR_FIFO(txEng_checksumMeta,				32,		"txEng_pseudoHeader_Const",	"txEng_checksum_cache");
+	INSTR_FIFO(txEng_fullChecksum,				32,		"txEng_payload_stitcher",	"txEng_checksum_cache");
+	INSTR_FIFO(tx_Eng_pseudo_pkt,				512,	"txEng_payload_stitcher",	"txEng_PseudoHeader_Remover");
+	INSTR_FIFO(txEng_tcp_level_packet,			512,	"txEng_PseudoHeader_Remover", "txEng_ip_pkt_stitcher");
+	INSTR_FIFO(txEng_tcpChecksumFifo,			32,		"txEng_checksum_cache",		"txEng_ip_pkt_stitcher");
+#endif
 }
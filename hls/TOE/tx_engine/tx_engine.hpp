@@ -30,6 +30,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 #include "../toe.hpp"
 #include "../common_utilities/common_utilities.hpp"
 #include "../memory_access/memory_access.hpp"
+#include "../instrumentation/instrumentation.hpp"
 
 using namespace hls;
 
@@ -38,6 +39,7 @@ using namespace hls;
  */
 struct tx_engine_meta //same as rxEngine
 {
+	ap_uint<16>				sessionID;
 	ap_uint<32> 			seqNumb;
 	ap_uint<32> 			ackNumb;
 	ap_uint<16> 			window_size;
@@ -51,9 +53,9 @@ struct tx_engine_meta //same as rxEngine
 	ap_uint<1>				fin;
 	tx_engine_meta() {}
 	tx_engine_meta(ap_uint<1> ack, ap_uint<1> rst, ap_uint<1> syn, ap_uint<1> fin)
-			:seqNumb(0), ackNumb(0), window_size(0), length(0), ack(ack), rst(rst), syn(syn), fin(fin) {}
+			:sessionID(0), seqNumb(0), ackNumb(0), window_size(0), length(0), ack(ack), rst(rst), syn(syn), fin(fin) {}
 	tx_engine_meta(ap_uint<32> seqNumb, ap_uint<32> ackNumb, ap_uint<1> ack, ap_uint<1> rst, ap_uint<1> syn, ap_uint<1> fin)
-			:seqNumb(seqNumb), ackNumb(ackNumb), window_size(0), length(0), ack(ack), rst(rst), syn(syn), fin(fin) {}
+			:sessionID(0), seqNumb(seqNumb), ackNumb(ackNumb), window_size(0), length(0), ack(ack), rst(rst), syn(syn), fin(fin) {}
 };
 
 
@@ -70,6 +72,80 @@ struct twoTuple
 				:srcIp(srcIp), dstIp(dstIp) {}
 };
 
+/** @ingroup tx_engine
+ *  Per segment information used to decide where the TCP checksum is computed
+ *  headerSum is the one's complement sum of the pseudo header and TCP header
+ *  with the checksum field set to zero
+ */
+struct txChecksumMeta
+{
+	ap_uint<16>				sessionID;
+	ap_uint<32>				seqNumb;
+	ap_uint<16>				length;
+	ap_uint<16>				headerSum;
+	bool					hasPayload;
+	bool					syn;
+	txChecksumMeta() {}
+	txChecksumMeta(ap_uint<16> sessionID, ap_uint<32> seqNumb, ap_uint<16> length, ap_uint<16> headerSum, bool hasPayload, bool syn)
+			:sessionID(sessionID), seqNumb(seqNumb), length(length), headerSum(headerSum), hasPayload(hasPayload), syn(syn) {}
+};
+
+/** @ingroup tx_engine
+ *  Payload sum of the last segment that went through the full checksum 
+ */
+struct txChecksumEntry
+{
+	bool					valid;
+	ap_uint<32>				seqNumb;
+	ap_uint<16>				length;
+	ap_uint<16>				payloadSum;
+	txChecksumEntry() {}
+	txChecksumEntry(bool valid, ap_uint<32> seqNumb, ap_uint<16> length, ap_uint<16> payloadSum)
+			:valid(valid), seqNumb(seqNumb), length(length), payloadSum(payloadSum) {}
+};
+
+/** @ingroup tx_engine
+ *  Segment waiting for its checksum, in transmission order. When local is set value 
+ *  is already the checksum, otherwise it is the header sum and the checksum comes from
+ *  the full checksum pipeline
+ */
+struct txChecksumPending
+{
+	ap_uint<16>				sessionID;
+	ap_uint<32>				seqNumb;
+	ap_uint<16>				length;
+	ap_uint<16>				value;
+	bool					local;
+	bool					invalidate;
+	txChecksumPending() {}
+	txChecksumPending(ap_uint<16> sessionID, ap_uint<32> seqNumb, ap_uint<16> length, ap_uint<16> value, bool local, bool invalidate)
+			:sessionID(sessionID), seqNumb(seqNumb), length(length), value(value), local(local), invalidate(invalidate) {}
+};
+
+#if (TX_RETRANSMIT_RING)
+// On chip retransmission ring of 2^TX_RING_BITS bytes per session
+static const uint8_t  TX_RING_BITS = 13;
+static const uint16_t TX_RING_ROWS = (1 << TX_RING_BITS) / 64;
+
+enum txRingOpType {TX_RING_CAPTURE, TX_RING_REPLAY, TX_RING_MEMORY};
+
+/** @ingroup tx_engine
+ *  Source of the payload of a segment. TX_RING_CAPTURE, payload comes from the application 
+ *  and is copied to the ring. TX_RING_REPLAY, payload is read from the ring. 
+ *  TX_RING_MEMORY, payload is read from the TX buffer
+ */
+struct txRingOp
+{
+	ap_uint<16>				sessionID;
+	ap_uint<TX_RING_BITS>	addr;
+	ap_uint<16>				length;
+	txRingOpType			type;
+	txRingOp() {}
+	txRingOp(ap_uint<16> sessionID, ap_uint<TX_RING_BITS> addr, ap_uint<16> length, txRingOpType type)
+			:sessionID(sessionID), addr(addr), length(length), type(type) {}
+};
+#endif
+
 /** @defgroup tx_engine TX Engine
  *  @ingroup tcp_module
  *  @image html tx_engine.png
@@ -89,6 +165,10 @@ void tx_engine(	stream<extendedEvent>&			eventEng2txEng_event,
 #if (STATISTICS_MODULE)
 				stream<txStatsUpdate>&  		txEngStatsUpdate,
 #endif					
+#if (LATENCY_HISTOGRAM)
+				stream<latTxSegment>&			txEng2latency_segment,
+				stream<ap_uint<32> >&			txEng2latency_wireSeq,
+#endif
 				stream<fourTuple>&				sLookup2txEng_rev_rsp,
 				stream<ap_uint<16> >&			txEng2rxSar_req,
 				stream<txTxSarQuery>&			txEng2txSar_upd_req,
@@ -40,17 +40,15 @@ struct readVerify
 
 int main()
 {
-	stream<txAppTxSarQuery> txAppReqFifo;
-	stream<txAppTxSarReply> txAppRspFifo;
 	stream<txAppTxSarPush> txAppPushFifo;
+	stream<txSarAckPush> txAppAckPushFifo;
 	stream<txTxSarQuery> txReqFifo;
-	stream<txSarEntry> txRspFifo;
+	stream<txTxSarReply> txRspFifo;
 	stream<rxTxSarQuery> rxQueryFifo;
-	stream<ap_uint<32> > rxRespFifo;
+	stream<rxTxSarReply> rxRespFifo;
 
 	txTxSarQuery txInData;
 	rxTxSarQuery rxInData;
-	sessionState outData;
 
 	std::ifstream inputFile;
 	std::ofstream outputFile;
@@ -86,8 +84,7 @@ int main()
 				if (fifoTemp == "TX")
 				{
 					txInData.sessionID = sessionIDTemp;
-					//txInData.recv_window = valueTemp;
-					txInData.lock = 1;
+					txInData.not_ackd = valueTemp;
 					txInData.write = (opTemp == 'W');;
 					txReqFifo.write(txInData);
 					if (opTemp == 'R')
@@ -109,14 +106,14 @@ int main()
 			}
 		}
 		//tx_sar_table(txReqFifo, txRspFifo, txAppReqFifo, txAppRspFifo, rxQueryFifo);
-		tx_sar_table(rxQueryFifo, txAppReqFifo, txReqFifo, txAppPushFifo, rxRespFifo, txAppRspFifo, txRspFifo);
+		tx_sar_table(rxQueryFifo, txReqFifo, txAppPushFifo, rxRespFifo, txRspFifo, txAppAckPushFifo);
 		count++;
 	}
 
 	std::vector<readVerify>::const_iterator it;
 	it = reads.begin();
 	bool readData = false;
-	txSarEntry response;
+	txTxSarReply response;
 	while (it != reads.end())
 	{
 		readData = false;
@@ -131,10 +128,10 @@ int main()
 
 		if (readData)
 		{
-			if (((int)response.recv_window) != it->exp)
+			if (((int)response.not_ackd) != it->exp)
 			{
 				outputFile << "Error at ID " << it->id << " on fifo ";
-				outputFile << it->fifo << " response value was " << response.recv_window << " instead of " << it->exp << std::endl;
+				outputFile << it->fifo << " response value was " << response.not_ackd << " instead of " << it->exp << std::endl;
 				errCount ++;
 			}
 			/*else
@@ -28,14 +28,96 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2015 Xilinx,
 ************************************************/
 
 #include "arp_server.hpp"
+
+/**
+ * @brief      Interface that owns an IP address, the global configuration or a valid
+ *             entry of the VLAN table
+ *
+ * @return     true if the address is one of ours
+ */
+bool arp_own_interface(
+		ap_uint<32>					ipAddress,
+		ap_uint<48>&				myMacAddress,
+		ap_uint<32>&				myIpAddress,
+		vlanInterface				vlanTable[NUM_VLAN_INTERFACES],
+		arpInterface&				iface) {
+#pragma HLS INLINE
+
+	bool own = (ipAddress == myIpAddress);
+	iface = arpInterface(myMacAddress, myIpAddress, 0, false);
+
+	own_lookup: for (int m = 0; m < NUM_VLAN_INTERFACES; m++){
+	#pragma HLS UNROLL
+		if (vlanTable[m].valid && (vlanTable[m].ipAddress == ipAddress)){
+			iface = arpInterface(vlanTable[m].macAddress, vlanTable[m].ipAddress, vlanTable[m].vlanID, true);
+			own = true;
+		}
+	}
+	return own;
+}
+
+/**
+ * @brief      Interface a host is reached through and the address to resolve for it. A VLAN
+ *             interface is used when the host is in its subnet, this is the case for the next
+ *             hops the ethernet_header_inserter asks for. Otherwise the global configuration
+ *             is used and hosts outside its subnet are reached through its gateway.
+ *
+ * @return     The interface, nextHop is the address to resolve
+ */
+arpInterface arp_route(
+		ap_uint<32>					ipAddress,
+		ap_uint<48>&				myMacAddress,
+		ap_uint<32>&				myIpAddress,
+		ap_uint<32>&				gatewayIP,
+		ap_uint<32>&				networkMask,
+		vlanInterface				vlanTable[NUM_VLAN_INTERFACES],
+		ap_uint<32>&				nextHop) {
+#pragma HLS INLINE
+
+	arpInterface iface(myMacAddress, myIpAddress, 0, false);
+	bool onLink = ((ipAddress & networkMask) == (myIpAddress & networkMask));
+
+	route_lookup: for (int m = 0; m < NUM_VLAN_INTERFACES; m++){
+	#pragma HLS UNROLL
+		if (vlanTable[m].valid && ((ipAddress & vlanTable[m].subNetMask) == (vlanTable[m].ipAddress & vlanTable[m].subNetMask))){
+			iface = arpInterface(vlanTable[m].macAddress, vlanTable[m].ipAddress, vlanTable[m].vlanID, true);
+			onLink = true;
+		}
+	}
+	nextHop = onLink ? ipAddress : gatewayIP;
+	return iface;
+}
+
+/**
+ * @brief      Inserts the 802.1Q tag of a VLAN interface after the source MAC address of
+ *             a single word ARP packet
+ */
+void arp_insert_tag(
+		axiWord&					word,
+		ap_uint<12>					vlanID) {
+#pragma HLS INLINE
+
+	word.data(511,128) = word.data(479, 96);
+	word.data(111, 96) = 0x0081;					// TPID
+	word.data(115,112) = vlanID(11,8);				// PCP and DEI are 0
+	word.data(119,116) = 0;
+	word.data(127,120) = vlanID( 7,0);
+	word.keep = 0xFFFFFFFFFFFFFFFF;
+}
+
 /** @ingroup arp_server
  *
+ *  Requests and replies for the address of a VLAN interface are answered and learnt as
+ *  the ones for myIpAddress. The packet_handler removes the tag of ARP frames, the
+ *  interface is found by the target protocol address.
  */
 void arp_pkg_receiver(
 	  	stream<axiWord>&			arpDataIn,
       	stream<arpReplyMeta>& 		arpReplyMetaFifo,
       	stream<arpTableEntry>& 		arpTableInsertFifo,
-      	ap_uint<32>&             	myIpAddress) {
+      	ap_uint<48>&				myMacAddress,
+      	ap_uint<32>&             	myIpAddress,
+      	vlanInterface				vlanTable[NUM_VLAN_INTERFACES]) {
 
 #pragma HLS PIPELINE II=1
 #pragma HLS INLINE off
@@ -66,10 +148,11 @@ void arp_pkg_receiver(
 			protoAddrDst 		= currWord.data(335, 304);
 
 			if (currWord.last == 1) {
-				if ((opCode == REQUEST) && (protoAddrDst == myIpAddress))
+				bool ownAddress = arp_own_interface(protoAddrDst, myMacAddress, myIpAddress, vlanTable, meta.iface);
+				if ((opCode == REQUEST) && ownAddress)
 				  arpReplyMetaFifo.write(meta);
 				else {
-					if ((opCode == REPLY) && (protoAddrDst == myIpAddress))
+					if ((opCode == REPLY) && ownAddress)
 						arpTableInsertFifo.write(arpTableEntry(meta.hwAddrSrc, meta.protoAddrSrc, true));
 				}
 				wordCount = 0;
@@ -82,6 +165,8 @@ void arp_pkg_receiver(
 
 /** @ingroup arp_server
  *
+ *  Replies go out from the interface that was asked, requests from the interface that
+ *  reaches the host. Both carry the 802.1Q tag of a VLAN interface.
  */
 void arp_pkg_sender(
 		stream<arpReplyMeta>&     arpReplyMetaFifo,
@@ -90,7 +175,8 @@ void arp_pkg_sender(
         ap_uint<48>&			  myMacAddress,
         ap_uint<32>&              myIpAddress,
         ap_uint<32>&              gatewayIP,
-        ap_uint<32>&              networkMask) {
+        ap_uint<32>&              networkMask,
+        vlanInterface             vlanTable[NUM_VLAN_INTERFACES]) {
 
 #pragma HLS PIPELINE II=1
 #pragma HLS INLINE off
@@ -103,6 +189,7 @@ void arp_pkg_sender(
   
   	axiWord sendWord;
   	ap_uint<32>             auxQueryIP;
+  	arpInterface            iface;
   	switch (aps_fsmState) {
    		case ARP_IDLE:
 	    	if (!arpReplyMetaFifo.empty()){
@@ -116,15 +203,10 @@ void arp_pkg_sender(
     		break;
   		case ARP_SENTRQ:
 
-            if((inputIP & networkMask) == (myIpAddress & networkMask)){
-                auxQueryIP = inputIP;
-            }
-            else{
-                auxQueryIP = gatewayIP;
-            }
+            iface = arp_route(inputIP, myMacAddress, myIpAddress, gatewayIP, networkMask, vlanTable, auxQueryIP);
 
 			sendWord.data(47, 0)  	= BROADCAST_MAC;
-			sendWord.data(95, 48) 	= myMacAddress;			// Sorce MAC
+			sendWord.data(95, 48) 	= iface.macAddress;		// Sorce MAC
 			sendWord.data(111, 96) 	= 0x0608;				// Ethertype
 
 			sendWord.data(127, 112) = 0x0100;				// Hardware type
@@ -132,8 +214,8 @@ void arp_pkg_sender(
 			sendWord.data(151, 144) = 6;					// HW Address Length
 			sendWord.data(159, 152) = 4;					// Protocol Address Length
 			sendWord.data(175, 160) = REQUEST;
-			sendWord.data(223, 176) = myMacAddress;
-			sendWord.data(255, 224) = myIpAddress;			// MY_IP_ADDR;
+			sendWord.data(223, 176) = iface.macAddress;
+			sendWord.data(255, 224) = iface.ipAddress;		// MY_IP_ADDR;
 			sendWord.data(303, 256) = 0;					// Sought-after MAC pt.1
 			sendWord.data(335, 304) = auxQueryIP;
 			sendWord.data(383, 336) = 0;					// Sought-after MAC pt.1
@@ -141,6 +223,8 @@ void arp_pkg_sender(
 
 			sendWord.keep = 0x0FFFFFFFFFFFFFFF;
 			sendWord.last = 1;
+			if (iface.tagged)
+				arp_insert_tag(sendWord, iface.vlanID);
 			aps_fsmState = ARP_IDLE;
 
 			arpDataOut.write(sendWord);
@@ -148,7 +232,7 @@ void arp_pkg_sender(
   		case ARP_REPLY:
 
 			sendWord.data(47, 0)  	= replyMeta.srcMac;
-			sendWord.data(95, 48) 	= myMacAddress;				// Sorce MAC
+			sendWord.data(95, 48) 	= replyMeta.iface.macAddress;	// Sorce MAC
 			sendWord.data(111, 96) 	= replyMeta.ethType;		// Ethertype
 
 			sendWord.data(127, 112) = replyMeta.hwType;			// Hardware type
@@ -156,8 +240,8 @@ void arp_pkg_sender(
 			sendWord.data(151, 144) = replyMeta.hwLen;			// HW Address Length
 			sendWord.data(159, 152) = replyMeta.protoLen;		// Protocol Address Length
 			sendWord.data(175, 160) = REPLY;
-			sendWord.data(223, 176) = myMacAddress;
-			sendWord.data(255, 224) = myIpAddress;				//MY_IP_ADDR;
+			sendWord.data(223, 176) = replyMeta.iface.macAddress;
+			sendWord.data(255, 224) = replyMeta.iface.ipAddress;	//MY_IP_ADDR;
 			sendWord.data(303, 256) = replyMeta.hwAddrSrc;		// Sought-after MAC pt.1
 			sendWord.data(335, 304) = replyMeta.protoAddrSrc;
 			sendWord.data(383, 336) = 0;						// Sought-after MAC pt.1
@@ -165,6 +249,8 @@ void arp_pkg_sender(
 
 			sendWord.keep = 0x0FFFFFFFFFFFFFFF;
 			sendWord.last = 1;
+			if (replyMeta.iface.tagged)
+				arp_insert_tag(sendWord, replyMeta.iface.vlanID);
 			aps_fsmState = ARP_IDLE;
 
 			arpDataOut.write(sendWord);		  		
@@ -174,15 +260,20 @@ void arp_pkg_sender(
 
 /** @ingroup arp_server
  *
+ *  The table is indexed by the last byte of the address, hosts of different interfaces
+ *  with the same last byte share an entry. A lookup only hits if the entry holds the
+ *  address that is looked up, otherwise the host is asked again.
  */
 void arp_table( 
 		stream<arpTableEntry>& 		arpTableInsertFifo,
         stream<ap_uint<32> >& 		macIpEncode_req,
         stream<arpTableReply>& 		macIpEncode_rsp,
         stream<ap_uint<32> >& 		arpRequestMetaFifo,
+        ap_uint<48>&                myMacAddress,
         ap_uint<32>&                myIpAddress,
         ap_uint<32>&                gatewayIP,
-        ap_uint<32>&                networkMask){
+        ap_uint<32>&                networkMask,
+        vlanInterface               vlanTable[NUM_VLAN_INTERFACES]){
 
 #pragma HLS PIPELINE II=1
 #pragma HLS INLINE off
@@ -194,6 +285,7 @@ void arp_table(
 	ap_uint<32>			query_ip;
 	ap_uint<32>         auxIP;
 	arpTableEntry		currEntry;
+	bool				hit;
 
 
 	if (!arpTableInsertFifo.empty()) {
@@ -203,18 +295,15 @@ void arp_table(
 	else if (!macIpEncode_req.empty()) {
 		macIpEncode_req.read(query_ip);
 
-        /*Check whether the current IP belongs to the FPGA subnet, otherwise use gateway's IP*/
-        if((query_ip & networkMask) == (myIpAddress & networkMask))
-            auxIP = query_ip;
-        else
-            auxIP = gatewayIP;
-
+        /*Check whether the current IP belongs to the subnet of an interface, otherwise use gateway's IP*/
+        arp_route(query_ip, myMacAddress, myIpAddress, gatewayIP, networkMask, vlanTable, auxIP);
 
 		currEntry = arpTable[auxIP(31,24)];
-		if (!currEntry.valid) {
+		hit = currEntry.valid && (currEntry.ipAddress == auxIP);
+		if (!hit) {
 			arpRequestMetaFifo.write(query_ip);	// send ARP request
 		}
-		macIpEncode_rsp.write(arpTableReply(currEntry.macAddress, currEntry.valid));
+		macIpEncode_rsp.write(arpTableReply(currEntry.macAddress, hit));
 	}
 
 }
@@ -318,7 +407,8 @@ void arp_server(
 		ap_uint<48>& 					myMacAddress,
 		ap_uint<32>& 					myIpAddress,
         ap_uint<32>&                    gatewayIP,
-        ap_uint<32>&                    networkMask)	{
+        ap_uint<32>&                    networkMask,
+        vlanInterface                   vlanTable[NUM_VLAN_INTERFACES])	{
 
 
 #pragma HLS INTERFACE ap_ctrl_none port=return
@@ -328,6 +418,9 @@ void arp_server(
 #pragma HLS INTERFACE ap_none register port=myIpAddress
 #pragma HLS INTERFACE ap_none register port=gatewayIP
 #pragma HLS INTERFACE ap_none register port=networkMask
+#pragma HLS INTERFACE ap_stable port=vlanTable
+#pragma HLS ARRAY_PARTITION variable=vlanTable complete dim=1
+#pragma HLS DATA_PACK variable=vlanTable
 
 
 #pragma HLS INTERFACE axis register both port=arpDataIn
@@ -369,7 +462,9 @@ void arp_server(
   		arpDataIn, 
   		arpReplyMetaFifo, 
   		arpTableInsertFifo, 
-  		myIpAddress);
+  		myMacAddress,
+  		myIpAddress,
+  		vlanTable);
   
   	arp_pkg_sender(
   		arpReplyMetaFifo, 
@@ -378,7 +473,8 @@ void arp_server(
   		myMacAddress, 
   		myIpAddress,
   		gatewayIP,
-        networkMask);
+        networkMask,
+        vlanTable);
 
   	arp_table(
   		arpTableInsertFifo, 
@@ -390,7 +486,9 @@ void arp_server(
   		macIpEncode_rsp, 
 #endif  		
   		arpRequestMetaFifo,
+  		myMacAddress,
   		myIpAddress,
   		gatewayIP,
-        networkMask);
+        networkMask,
+        vlanTable);
 }
@@ -35,6 +35,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2018 Xilinx,
 #include "ap_int.h"
 #include <stdint.h>
 #include "../TOE/toe.hpp"
+#include "../TOE/common_utilities/vlan_interface.hpp"
 
 #ifndef _ARP_SERVER_HPP_
 #define _ARP_SERVER_HPP_
@@ -73,6 +74,21 @@ struct arpTableEntry {
 				 : macAddress(newMac), ipAddress(newIp), valid(newValid) {}
 };
 
+/**
+ * L3 interface an ARP packet is sent from, the global configuration or an entry of the
+ * VLAN table. The packets of a VLAN interface carry its 802.1Q tag.
+ */
+struct arpInterface
+{
+  ap_uint<48>   macAddress;
+  ap_uint<32>   ipAddress;
+  ap_uint<12>   vlanID;
+  bool          tagged;
+  arpInterface() {}
+  arpInterface(ap_uint<48> mac, ap_uint<32> ip, ap_uint<12> id, bool tagged)
+          :macAddress(mac), ipAddress(ip), vlanID(id), tagged(tagged) {}
+};
+
 struct arpReplyMeta
 {
   ap_uint<48>   srcMac; //rename
@@ -83,6 +99,7 @@ struct arpReplyMeta
   ap_uint<8>    protoLen;
   ap_uint<48>   hwAddrSrc;
   ap_uint<32>   protoAddrSrc;
+  arpInterface  iface;          // Interface whose address was requested, the reply goes out from it
   arpReplyMeta() {}
 };
 
@@ -132,6 +149,9 @@ void arp_server(
 		stream<axiWord>&          		arpDataOut,
 		stream<arpTableReply>&    		macIpEncode_rsp,
 		ap_uint<48>& 					myMacAddress,
-		ap_uint<32>& 					myIpAddress);
+		ap_uint<32>& 					myIpAddress,
+		ap_uint<32>&					gatewayIP,
+		ap_uint<32>&					networkMask,
+		vlanInterface					vlanTable[NUM_VLAN_INTERFACES]);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,272 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+/*
+ * Multithreaded execution of a DATAFLOW region in C simulation, enabled with
+ * CSIM_DATAFLOW_THREADS. Every process registered with DATAFLOW_PROCESS_BEGIN/END
+ * runs in a worker thread, the testbench that calls the top function is one more
+ * process, the driver, and each call of the top function is one cycle of it.
+ *
+ * Processes are kept in step by their clocks instead of a global barrier. A
+ * process at cycle c sees the items another process wrote up to cycle c-1 (every
+ * FIFO between two processes has one cycle of latency) and it waits only when it
+ * polls a stream whose producer has not finished cycle c-1 yet. Streams inside a
+ * process keep the sequential semantics of the plain C simulation. The outcome is
+ * therefore the same for any number of threads and any scheduling, workers never
+ * run more than one cycle ahead of the driver.
+ *
+ * The number of worker threads defaults to the hardware threads minus the driver
+ * and can be set with the CSIM_DATAFLOW_THREADS environment variable, processes
+ * are assigned round-robin in registration order.
+ */
+
+#ifndef _CSIM_DATAFLOW_H_
+#define _CSIM_DATAFLOW_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace csim {
+
+/* Execution context of a dataflow process, the clock is the cycle it is executing */
+struct process_ctx {
+	std::atomic<uint64_t>	clock;
+	char					_pad[64];		// keep the clocks of different processes in different cache lines
+	const char*				name;
+	std::function<void()>	body;
+	uint64_t				othersMin;		// lower bound of the other clocks, owned by the thread running the process
+
+	process_ctx(const char* name, const std::function<void()>& body)
+		: clock(0), name(name), body(body), othersMin(0) {}
+};
+
+class dataflow
+{
+	public:
+		enum state_t {IDLE, REGISTERING, RUNNING, STOPPED};
+
+		/* Called at the beginning of every call of the top function, from the testbench thread */
+		static void cycle() {
+			dataflow& df = get();
+
+			switch (df._state) {
+				case IDLE:
+					df._driver = new process_ctx("testbench", std::function<void()>());
+					df._all.push_back(df._driver);
+					current() = df._driver;
+					df._state = REGISTERING;
+					break;
+				case REGISTERING:
+					df.start();
+					break;
+				case RUNNING:
+					df._driver->clock.store(df._driver->clock.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+					df._limit.store(df._driver->clock.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+					break;
+				case STOPPED:
+					std::cerr << "ERROR: the dataflow simulation was stopped, the top function can not be called again" << std::endl;
+					std::abort();
+			}
+		}
+
+		/* Registers the body of a process during the first call, later calls are ignored */
+		template<typename F>
+		static void process(const char* name, F body) {
+			dataflow& df = get();
+			if (df._state == REGISTERING) {
+				process_ctx* ctx = new process_ctx(name, std::function<void()>(body));
+				ctx->clock.store(1, std::memory_order_relaxed);
+				df._procs.push_back(ctx);
+				df._all.push_back(ctx);
+			}
+		}
+
+		/*
+		 * Lets the workers complete the cycle after the last call of the top function and joins
+		 * them. Streams have the plain C simulation semantics afterwards, the testbench calls this
+		 * before it drains the outputs and destroys its streams.
+		 */
+		static void stop() {
+			dataflow& df = get();
+			if (df._state != RUNNING) {
+				df._state = STOPPED;
+				return;
+			}
+			uint64_t last = df._driver->clock.load(std::memory_order_relaxed);
+			df._driver->clock.store(last + 1, std::memory_order_release);
+			for (size_t p = 0; p < df._procs.size(); p++) {
+				unsigned spins = 0;
+				while (df._procs[p]->clock.load(std::memory_order_acquire) < last + 2)
+					backoff(spins);
+			}
+			df._stopping.store(true, std::memory_order_release);
+			for (size_t t = 0; t < df._threads.size(); t++)
+				df._threads[t].join();
+			df._threads.clear();
+			df._elapsed = std::chrono::steady_clock::now() - df._start;
+			df._cycles = last;
+			df._state = STOPPED;
+		}
+
+		static void report(std::ostream& out) {
+			dataflow& df = get();
+			double seconds = df._elapsed.count();
+			out << "  ------- Dataflow simulation ------- " << std::endl;
+			out << "   " << df._procs.size() << " processes in " << df._workers << " worker threads" << std::endl;
+			out << "   " << df._cycles << " cycles in " << seconds << " s";
+			if (seconds > 0)
+				out << ", " << (uint64_t) (df._cycles / seconds) << " cycles/s";
+			out << std::endl;
+		}
+
+		/* Context of the calling thread, null outside the dataflow simulation */
+		static process_ctx*& current() {
+			static thread_local process_ctx* ctx = nullptr;
+			return ctx;
+		}
+
+		static bool running() {
+			return get()._state == RUNNING;
+		}
+
+		static bool stopping() {
+			return get()._stopping.load(std::memory_order_acquire);
+		}
+
+		/* Every other process has finished the cycles before c */
+		static bool othersReached(process_ctx* self, uint64_t c) {
+			if (self->othersMin >= c)
+				return true;
+			dataflow& df = get();
+			uint64_t min = UINT64_MAX;
+			for (size_t p = 0; p < df._all.size(); p++) {
+				if (df._all[p] != self) {
+					uint64_t clock = df._all[p]->clock.load(std::memory_order_acquire);
+					if (clock < min)
+						min = clock;
+				}
+			}
+			self->othersMin = min;
+			return min >= c;
+		}
+
+		static void backoff(unsigned& spins) {
+			if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+				__builtin_ia32_pause();
+#endif
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+
+	private:
+		state_t 								_state;
+		process_ctx*							_driver;
+		std::vector<process_ctx*>				_procs;
+		std::vector<process_ctx*>				_all;
+		std::vector<std::thread>				_threads;
+		unsigned								_workers;
+		std::atomic<uint64_t>					_limit;
+		std::atomic<bool>						_stopping;
+		std::chrono::steady_clock::time_point	_start;
+		std::chrono::duration<double>			_elapsed;
+		uint64_t								_cycles;
+
+		dataflow()
+			: _state(IDLE), _driver(nullptr), _workers(0), _limit(0), _stopping(false), _elapsed(0), _cycles(0) {}
+
+		static dataflow& get() {
+			static dataflow df;
+			return df;
+		}
+
+		static void stopAtExit() {
+			if (get()._state == RUNNING) {
+				std::cerr << "WARNING: the dataflow simulation was not stopped by the testbench" << std::endl;
+				stop();
+			}
+		}
+
+		void start() {
+			unsigned hw = std::thread::hardware_concurrency();
+			const char* env = std::getenv("CSIM_DATAFLOW_THREADS");
+
+			_workers = (env != nullptr) ? std::atoi(env) : (hw > 1 ? hw - 1 : 1);
+			if (_workers < 1)
+				_workers = 1;
+			if (_workers > _procs.size())
+				_workers = _procs.size();
+
+			_driver->clock.store(1, std::memory_order_release);
+			_limit.store(2, std::memory_order_release);
+			_state = RUNNING;
+			_start = std::chrono::steady_clock::now();
+			std::atexit(stopAtExit);
+			for (unsigned t = 0; t < _workers; t++)
+				_threads.push_back(std::thread(&dataflow::worker, this, t));
+		}
+
+		void worker(unsigned id) {
+			std::vector<process_ctx*> group;
+			for (size_t p = id; p < _procs.size(); p += _workers)
+				group.push_back(_procs[p]);
+
+			for (uint64_t c = 1; ; c++) {
+				unsigned spins = 0;
+				while (_limit.load(std::memory_order_acquire) < c) {
+					if (_stopping.load(std::memory_order_acquire))
+						return;
+					backoff(spins);
+				}
+				for (size_t p = 0; p < group.size(); p++) {
+					current() = group[p];
+					group[p]->body();
+					group[p]->clock.store(c + 1, std::memory_order_release);
+				}
+			}
+		}
+};
+
+} // namespace csim
+
+#endif
@@ -0,0 +1,327 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+/*
+ * Stand-in for the Vivado HLS hls_stream.h used by the vendor-free C-simulation
+ * build (Makefile.csim). It models what csim needs of hls::stream: an unbounded
+ * FIFO that never reports full, with the blocking and non-blocking accessors the
+ * cores use. Reading an empty stream prints the same warning as Vivado HLS and
+ * returns a default constructed value, when CSIM_STRICT_STREAMS is defined the
+ * simulation aborts instead so that a testbench cannot silently run past it.
+ *
+ * With CSIM_DATAFLOW_THREADS the FIFO is a lock-free single producer single
+ * consumer queue made of fixed size blocks, the producer links a new block when
+ * one fills, so it still never reports full. Every item carries the cycle of its
+ * producer and the consumer only sees the items csim_dataflow.h makes visible.
+ */
+
+#ifndef _CSIM_HLS_STREAM_H_
+#define _CSIM_HLS_STREAM_H_
+
+#include <deque>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#ifdef CSIM_DATAFLOW_THREADS
+#include "csim_dataflow.h"
+#endif
+
+namespace hls {
+
+#ifndef CSIM_DATAFLOW_THREADS
+
+template<typename __STREAM_T__>
+class stream
+{
+	protected:
+		std::deque<__STREAM_T__>	_data;
+		std::string 				_name;
+		bool 						_warned;
+
+	public:
+		stream()
+			: _name("hls::stream"), _warned(false) {}
+
+		stream(const char* name)
+			: _name(name), _warned(false) {}
+
+		/* Streams are channels, they can not be copied or assigned */
+	private:
+		stream(const stream< __STREAM_T__ >& chn);
+		stream& operator= (const stream< __STREAM_T__ >& chn);
+
+	public:
+		bool empty() const {
+			return _data.empty();
+		}
+
+		bool full() const {
+			return false;
+		}
+
+		size_t size() const {
+			return _data.size();
+		}
+
+		void read(__STREAM_T__& head) {
+			head = read();
+		}
+
+		__STREAM_T__ read() {
+			__STREAM_T__ head;
+			if (_data.empty()) {
+				if (!_warned) {
+					std::cerr << "WARNING: Hls::stream '" << _name << "' is read while empty,"
+							  << " which may result in RTL simulation hanging." << std::endl;
+					_warned = true;
+				}
+#ifdef CSIM_STRICT_STREAMS
+				std::abort();
+#endif
+				return __STREAM_T__();
+			}
+			head = _data.front();
+			_data.pop_front();
+			return head;
+		}
+
+		bool read_nb(__STREAM_T__& head) {
+			if (_data.empty())
+				return false;
+			head = _data.front();
+			_data.pop_front();
+			return true;
+		}
+
+		void write(const __STREAM_T__& tail) {
+			_data.push_back(tail);
+		}
+
+		bool write_nb(const __STREAM_T__& tail) {
+			write(tail);
+			return true;
+		}
+
+		void operator >> (__STREAM_T__& rdata) {
+			read(rdata);
+		}
+
+		void operator << (const __STREAM_T__& wdata) {
+			write(wdata);
+		}
+};
+#else
+
+template<typename __STREAM_T__>
+class stream
+{
+	protected:
+		static const unsigned BLOCK_SLOTS = 64;
+
+		struct block {
+			__STREAM_T__				data[BLOCK_SLOTS];
+			uint64_t					stamp[BLOCK_SLOTS];
+			block*						next;
+		};
+
+		// Consumer side
+		block*							_head;
+		std::atomic<uint64_t>			_popped;
+		char							_pad0[64];
+		// Producer side
+		block*							_tail;
+		std::atomic<uint64_t>			_pushed;
+		std::atomic<csim::process_ctx*>	_producer;
+		char							_pad1[64];
+		// A consumed block handed back to the producer
+		std::atomic<block*>				_spare;
+		std::string 					_name;
+		bool 							_warned;
+
+		void init() {
+			_head = _tail = new block();
+			_head->next = nullptr;
+			_popped.store(0, std::memory_order_relaxed);
+			_pushed.store(0, std::memory_order_relaxed);
+			_producer.store(nullptr, std::memory_order_relaxed);
+			_spare.store(nullptr, std::memory_order_relaxed);
+		}
+
+		/* Visibility of the head for the consumer, waits for the producer when it is behind */
+		bool nothing_visible() {
+			csim::process_ctx* self = csim::dataflow::current();
+			uint64_t popped = _popped.load(std::memory_order_relaxed);
+
+			if (self == nullptr || !csim::dataflow::running())
+				return popped == _pushed.load(std::memory_order_acquire);
+
+			uint64_t 	cycle 	= self->clock.load(std::memory_order_relaxed);
+			bool 		synced 	= false;
+			unsigned 	spins 	= 0;
+			for (;;) {
+				if (popped != _pushed.load(std::memory_order_acquire)) {
+					block* head = _head;
+					if (popped % BLOCK_SLOTS == 0 && popped != 0)
+						head = head->next;
+					return !(_producer.load(std::memory_order_relaxed) == self || head->stamp[popped % BLOCK_SLOTS] < cycle);
+				}
+				if (synced)
+					return true;
+				csim::process_ctx* producer = _producer.load(std::memory_order_acquire);
+				if (producer == self)
+					return true;
+				synced = (producer != nullptr) ? producer->clock.load(std::memory_order_acquire) >= cycle :
+												 csim::dataflow::othersReached(self, cycle);
+				if (!synced) {
+					if (csim::dataflow::stopping())
+						return true;
+					csim::dataflow::backoff(spins);
+				}
+			}
+		}
+
+		__STREAM_T__ pop() {
+			uint64_t popped = _popped.load(std::memory_order_relaxed);
+			unsigned slot = popped % BLOCK_SLOTS;
+
+			if (slot == 0 && popped != 0) {
+				block* done = _head;
+				_head = _head->next;
+				delete _spare.exchange(done, std::memory_order_acq_rel);
+			}
+			__STREAM_T__ head = _head->data[slot];
+			_popped.store(popped + 1, std::memory_order_release);
+			return head;
+		}
+
+	public:
+		stream()
+			: _name("hls::stream"), _warned(false) { init(); }
+
+		stream(const char* name)
+			: _name(name), _warned(false) { init(); }
+
+		~stream() {
+			while (_head != nullptr) {
+				block* next = _head->next;
+				delete _head;
+				_head = next;
+			}
+			delete _spare.load(std::memory_order_relaxed);
+		}
+
+		/* Streams are channels, they can not be copied or assigned */
+	private:
+		stream(const stream< __STREAM_T__ >& chn);
+		stream& operator= (const stream< __STREAM_T__ >& chn);
+
+	public:
+		bool empty() {
+			return nothing_visible();
+		}
+
+		bool full() const {
+			return false;
+		}
+
+		size_t size() const {
+			return _pushed.load(std::memory_order_acquire) - _popped.load(std::memory_order_acquire);
+		}
+
+		void read(__STREAM_T__& head) {
+			head = read();
+		}
+
+		__STREAM_T__ read() {
+			if (nothing_visible()) {
+				if (!_warned) {
+					std::cerr << "WARNING: Hls::stream '" << _name << "' is read while empty,"
+							  << " which may result in RTL simulation hanging." << std::endl;
+					_warned = true;
+				}
+#ifdef CSIM_STRICT_STREAMS
+				std::abort();
+#endif
+				return __STREAM_T__();
+			}
+			return pop();
+		}
+
+		bool read_nb(__STREAM_T__& head) {
+			if (nothing_visible())
+				return false;
+			head = pop();
+			return true;
+		}
+
+		void write(const __STREAM_T__& tail) {
+			csim::process_ctx* self = csim::dataflow::current();
+			uint64_t pushed = _pushed.load(std::memory_order_relaxed);
+			unsigned slot = pushed % BLOCK_SLOTS;
+
+			if (slot == 0 && pushed != 0) {
+				block* next = _spare.exchange(nullptr, std::memory_order_acq_rel);
+				if (next == nullptr)
+					next = new block();
+				next->next = nullptr;
+				_tail->next = next;
+				_tail = next;
+			}
+			_tail->data[slot] 	= tail;
+			_tail->stamp[slot] 	= (self != nullptr) ? self->clock.load(std::memory_order_relaxed) : 0;
+			if (self != nullptr && _producer.load(std::memory_order_relaxed) != self)
+				_producer.store(self, std::memory_order_relaxed);
+			_pushed.store(pushed + 1, std::memory_order_release);
+		}
+
+		bool write_nb(const __STREAM_T__& tail) {
+			write(tail);
+			return true;
+		}
+
+		void operator >> (__STREAM_T__& rdata) {
+			read(rdata);
+		}
+
+		void operator << (const __STREAM_T__& wdata) {
+			write(wdata);
+		}
+};
+
+#endif
+
+} // namespace hls
+
+#endif
@@ -0,0 +1,183 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "drop_counters.hpp"
+
+/**
+ * @brief      Lane of the per-session counters a reason is counted in
+ */
+ap_uint<2> dc_session_lane(dropReason reason) {
+#pragma HLS INLINE
+
+	if (reason == DROP_RX_OUT_OF_WINDOW)
+		return 0;
+	else if (reason == DROP_RX_NO_SPACE)
+		return 1;
+	else if (reason == DROP_RX_INVALID_STATE)
+		return 2;
+	else
+		return 3;
+}
+
+/**
+ * @brief      Aggregates the drop reports of the whole stack. Every source can deliver
+ *             one report per cycle, they are all counted in the same cycle in the per-reason
+ *             totals. Reports that carry a session also update the counters of that session,
+ *             which live in a BRAM, so only one of them is taken per cycle and the others
+ *             wait in their input register. The cycle after a rising edge of readEnable the
+ *             BRAM serves the read of the session counters instead.
+ *
+ * @param      reportIn  Drop reports, one stream per IP
+ * @param      regs      AXI4-Lite registers
+ */
+void drop_counters(
+			stream<dropReport>		reportIn[DROP_SOURCES],
+			dropCounterRegs&		regs) {
+
+#pragma HLS INTERFACE ap_ctrl_none port=return
+#pragma HLS PIPELINE II=1
+
+#pragma HLS INTERFACE axis register both port=reportIn name=s_axis_drop_report
+#pragma HLS DATA_PACK variable=reportIn
+#pragma HLS INTERFACE s_axilite port=regs bundle=drop_counters
+
+	static ap_uint<32>		dc_reasonTotal[NUM_DROP_REASONS];
+	#pragma HLS ARRAY_PARTITION variable=dc_reasonTotal complete dim=1
+	static ap_uint<48>		dc_total = 0;
+
+	static dropReport		dc_pending[DROP_SOURCES];
+	static bool				dc_pendingValid[DROP_SOURCES];
+	#pragma HLS ARRAY_PARTITION variable=dc_pending complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=dc_pendingValid complete dim=1
+
+#if (DROP_SESSION_COUNTERS)
+	static ap_uint<128>		dc_sessionTable[MAX_SESSIONS];			// Four 32-bit lanes per session
+	#pragma HLS RESOURCE variable=dc_sessionTable core=RAM_T2P_BRAM
+	#pragma HLS DEPENDENCE variable=dc_sessionTable inter false
+
+	static bool				dc_readEnable_r = false;
+	static bool				dc_lastValid = false;
+	static ap_uint<16>		dc_lastID;
+	static ap_uint<128>		dc_lastRow;
+	ap_uint<128>			row;
+	ap_uint<2>				lane;
+	bool					tableBusy = false;
+	bool					sessionUpdate = false;
+	ap_uint<16>				updateID;
+	dropReason				updateReason;
+#endif
+
+	bool					counted[DROP_SOURCES];
+	#pragma HLS ARRAY_PARTITION variable=counted complete dim=1
+	ap_uint<2>				hits;
+	ap_uint<2>				cycleDrops = 0;
+
+#if (DROP_SESSION_COUNTERS)
+	if (regs.readEnable && !dc_readEnable_r) {						// Only with a rising edge
+		if (dc_lastValid && dc_lastID == regs.sessionID)
+			row = dc_lastRow;
+		else
+			row = dc_sessionTable[regs.sessionID];
+		regs.sessionOutOfWindow 	= row( 31,  0);
+		regs.sessionNoSpace 		= row( 63, 32);
+		regs.sessionInvalidState 	= row( 95, 64);
+		regs.sessionOther 			= row(127, 96);
+		tableBusy = true;
+	}
+	dc_readEnable_r = regs.readEnable;
+#endif
+
+	take_reports: for (int i = 0; i < DROP_SOURCES; i++) {
+	#pragma HLS UNROLL
+		counted[i] = false;
+		if (dc_pendingValid[i]) {
+#if (DROP_SESSION_COUNTERS)
+			if (!dc_pending[i].sessionValid) {
+				counted[i] = true;
+			}
+			else if (!tableBusy) {
+				counted[i] 		= true;
+				tableBusy 		= true;
+				sessionUpdate 	= true;
+				updateID 		= dc_pending[i].sessionID;
+				updateReason 	= dc_pending[i].reason;
+			}
+#else
+			counted[i] = true;
+#endif
+		}
+	}
+
+	reason_totals: for (int r = 0; r < NUM_DROP_REASONS; r++) {
+	#pragma HLS UNROLL
+		hits = 0;
+		for (int i = 0; i < DROP_SOURCES; i++) {
+		#pragma HLS UNROLL
+			if (counted[i] && dc_pending[i].reason.to_int() == r)
+				hits++;
+		}
+		dc_reasonTotal[r] += hits;
+	}
+
+	for (int i = 0; i < DROP_SOURCES; i++) {
+	#pragma HLS UNROLL
+		if (counted[i]) {
+			cycleDrops++;
+			dc_pendingValid[i] = false;
+		}
+		if (!dc_pendingValid[i] && !reportIn[i].empty()) {
+			reportIn[i].read(dc_pending[i]);
+			dc_pendingValid[i] = true;
+		}
+	}
+	dc_total += cycleDrops;
+
+#if (DROP_SESSION_COUNTERS)
+	if (sessionUpdate) {
+		if (dc_lastValid && dc_lastID == updateID)					// Written the cycle before, not in the BRAM yet
+			row = dc_lastRow;
+		else
+			row = dc_sessionTable[updateID];
+		lane = dc_session_lane(updateReason);
+		row(lane * 32 + 31, lane * 32) = row(lane * 32 + 31, lane * 32) + 1;
+		dc_sessionTable[updateID] = row;
+		dc_lastID 	= updateID;
+		dc_lastRow 	= row;
+	}
+	dc_lastValid = sessionUpdate;
+#endif
+
+	regs.reasonDrops 	= dc_reasonTotal[regs.reason(3, 0)];
+	regs.totalDrops 	= dc_total;
+}
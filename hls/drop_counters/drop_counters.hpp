@@ -0,0 +1,74 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _DROP_COUNTERS_HPP_
+#define _DROP_COUNTERS_HPP_
+
+#include "../TOE/toe.hpp"
+
+using namespace hls;
+
+// Number of report streams, one per IP: TOE, packet_handler and icmp_server
+#define DROP_SOURCES 3
+
+// DROP_SESSION_COUNTERS flag, the drops that carry a session are also counted per session.
+// Each session has a counter for out-of-window, no-space and invalid-state drops, and one
+// for any other reason. It adds a BRAM, off by default, build with -DDROP_SESSION_COUNTERS=1
+#ifndef DROP_SESSION_COUNTERS
+#define DROP_SESSION_COUNTERS 0
+#endif
+
+/**
+ * Registers of the drop counters.
+ * reasonDrops is the total of the reason selected by reason, totalDrops the sum of all reasons.
+ * A rising edge of readEnable reads the counters of sessionID into the session* registers.
+ */
+struct dropCounterRegs {
+	ap_uint<8>		reason;
+	ap_uint<32>		reasonDrops;
+	ap_uint<48>		totalDrops;
+	bool			readEnable;
+	ap_uint<16>		sessionID;
+	ap_uint<32>		sessionOutOfWindow;
+	ap_uint<32>		sessionNoSpace;
+	ap_uint<32>		sessionInvalidState;
+	ap_uint<32>		sessionOther;
+};
+
+void drop_counters(
+			stream<dropReport>		reportIn[DROP_SOURCES],
+			dropCounterRegs&		regs);
+
+#endif
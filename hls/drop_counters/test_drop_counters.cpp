@@ -0,0 +1,140 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "drop_counters.hpp"
+#include <map>
+#include <cstdlib>
+
+/*
+ * Random reports on every source, counted by a software model. Checks the
+ * per-reason and total counters, the session counters (DROP_SESSION_COUNTERS) read through the
+ * register interface and that the block keeps up with the offered load.
+ */
+int main(int argc, char **argv) {
+
+	stream<dropReport> 		reportIn[DROP_SOURCES];
+	dropCounterRegs 		regs;
+	uint64_t 				modelReason[NUM_DROP_REASONS] = {0};
+	uint64_t 				modelTotal = 0;
+	std::map<int, uint64_t>	modelSession[4];
+	const int 				sessions = 8;
+	const int 				reportCycles = 20000;
+	int 					cycles = 0;
+	int 					errors = 0;
+	dropReason 				reason;
+	int 					lane;
+
+	regs.readEnable = false;
+	regs.reason = 0;
+	srand(42);
+
+	for (cycles = 0; cycles < reportCycles; cycles++) {
+		for (int i = 0; i < DROP_SOURCES; i++) {
+			if (rand() % 4 == 0) {
+				reason = 1 + rand() % (NUM_DROP_REASONS - 2);
+				modelReason[reason]++;
+				modelTotal++;
+				if (i == 0 && reason >= DROP_RX_OUT_OF_WINDOW && reason <= DROP_RX_INVALID_STATE + 1) {	// Only the TOE reports sessions
+					int id = rand() % sessions;
+					lane = (reason == DROP_RX_OUT_OF_WINDOW) ? 0 : (reason == DROP_RX_NO_SPACE) ? 1 : (reason == DROP_RX_INVALID_STATE) ? 2 : 3;
+					modelSession[lane][id]++;
+					reportIn[i].write(dropReport(reason, id));
+				}
+				else
+					reportIn[i].write(dropReport(reason));
+			}
+		}
+		drop_counters(reportIn, regs);
+	}
+
+	for (int i = 0; i < 16; i++)
+		drop_counters(reportIn, regs);
+
+	for (int i = 0; i < DROP_SOURCES; i++) {
+		if (!reportIn[i].empty()) {
+			std::cout << "Source " << i << " has " << reportIn[i].size() << " reports not taken" << std::endl;
+			errors++;
+		}
+	}
+
+	if (regs.totalDrops != modelTotal) {
+		std::cout << "Total drops " << regs.totalDrops << " expected " << modelTotal << std::endl;
+		errors++;
+	}
+	for (int r = 0; r < NUM_DROP_REASONS; r++) {
+		regs.reason = r;
+		drop_counters(reportIn, regs);
+		if (regs.reasonDrops != modelReason[r]) {
+			std::cout << "Reason " << r << " drops " << regs.reasonDrops << " expected " << modelReason[r] << std::endl;
+			errors++;
+		}
+	}
+
+#if (DROP_SESSION_COUNTERS)
+	for (int id = 0; id < sessions; id++) {
+		regs.sessionID = id;
+		regs.readEnable = true;
+		drop_counters(reportIn, regs);
+		regs.readEnable = false;
+		drop_counters(reportIn, regs);
+		if (regs.sessionOutOfWindow != modelSession[0][id] || regs.sessionNoSpace != modelSession[1][id] ||
+				regs.sessionInvalidState != modelSession[2][id] || regs.sessionOther != modelSession[3][id]) {
+			std::cout << "Session " << id << " counters " << regs.sessionOutOfWindow << " " << regs.sessionNoSpace << " ";
+			std::cout << regs.sessionInvalidState << " " << regs.sessionOther << " expected " << modelSession[0][id] << " ";
+			std::cout << modelSession[1][id] << " " << modelSession[2][id] << " " << modelSession[3][id] << std::endl;
+			errors++;
+		}
+	}
+
+	// Back to back reports of the same session on every source
+	for (int i = 0; i < 64; i++) {
+		for (int s = 0; s < DROP_SOURCES; s++)
+			reportIn[s].write(dropReport(DROP_RX_NO_SPACE, 3));
+		drop_counters(reportIn, regs);
+	}
+	for (int i = 0; i < 256; i++)
+		drop_counters(reportIn, regs);
+	regs.sessionID = 3;
+	regs.readEnable = true;
+	drop_counters(reportIn, regs);
+	regs.readEnable = false;
+	if (regs.sessionNoSpace != modelSession[1][3] + 64 * DROP_SOURCES) {
+		std::cout << "Session 3 no space " << regs.sessionNoSpace << " expected " << modelSession[1][3] + 64 * DROP_SOURCES << std::endl;
+		errors++;
+	}
+#endif
+
+	std::cout << "Drop counters: " << modelTotal << " reports in " << reportCycles << " cycles " << (errors ? "FAILED" : "PASSED") << std::endl;
+	return errors;
+}
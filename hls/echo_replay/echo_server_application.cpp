@@ -116,13 +116,16 @@ void replyData(
 		stream<es_metaData>& 		transferMetaData,
 		stream<axiWord>& 			DataIn,
 		stream<appTxRsp>& 			txAppDataReqStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+		stream<appTxWritable>& 		txAppWritable,
+#endif
 		stream<appTxMeta>& 			txAppDataReqMeta, 
 		stream<axiWord>& 			DataOut)
 {
 #pragma HLS INLINE off
 #pragma HLS PIPELINE II=1
 
-	enum esrd_states {READ_META , WAIT_RESPONSE, FORWARD_DATA, WAIT_CYCLES};
+	enum esrd_states {READ_META , WAIT_RESPONSE, FORWARD_DATA, WAIT_CYCLES, WAIT_WRITABLE};
 	static esrd_states 		rd_fsm_state = READ_META;
 	static ap_uint<8>		cycle_counter;
 
@@ -146,6 +149,13 @@ void replyData(
 				//cout << "\tremaining space: " << write_request_response.remaining_space << "\terror: " <<  write_request_response.error;
 				//cout << "\ttime: "  << simCycleCounter << endl << endl;
 
+#if (TX_APP_WRITABLE_NOTIFICATION)
+				// The TOE tells when the space is there
+				if ((write_request_response.error == ERROR_WINDOW) || (write_request_response.error == ERROR_NOSPACE)){
+					rd_fsm_state 	= WAIT_WRITABLE;
+				}
+				else
+#endif
 				if (write_request_response.error != 0){
 					cycle_counter 	= 0;
 					rd_fsm_state 	= WAIT_CYCLES;
@@ -173,6 +183,16 @@ void replyData(
 				rd_fsm_state = WAIT_RESPONSE;
 			}
 			break;	
+		case WAIT_WRITABLE:
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			if (!txAppWritable.empty()){
+				if (txAppWritable.read().sessionID == metaData.sessionID){
+					txAppDataReqMeta.write(appTxMeta(metaData.sessionID, metaData.length));	// issue writing command again and wait for response
+					rd_fsm_state = WAIT_RESPONSE;
+				}
+			}
+#endif
+			break;
 	}
 }
 
@@ -347,6 +367,7 @@ void sinker(
  * @param      txAppDataReqMeta             The transmit meta data
  * @param      txAppData_to_TOE             The transmit data
  * @param      txAppDataReqStatus           The transmit status
+ * @param      txAppWritable                Space available again for a refused write
  */
 void echo_server_application(	
 			stream<ap_uint<16> >& 			listenPortReq, 
@@ -361,6 +382,9 @@ void echo_server_application(
 			stream<appTxMeta>& 				txAppDataReqMeta,
 			stream<axiWord> & 				txAppData_to_TOE,
 			stream<appTxRsp>& 				txAppDataReqStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			stream<appTxWritable>& 			txAppWritable,
+#endif
 			stream<txApp_client_status>& 	txAppNewClientNoty)
 {
 //#pragma HLS INTERFACE ap_ctrl_none register port=return
@@ -381,6 +405,10 @@ void echo_server_application(
 #pragma HLS INTERFACE axis register both port=txAppData_to_TOE name=m_TxPayload
 #pragma HLS INTERFACE axis register both port=txAppDataReqStatus name=s_TxDataResponse
 #pragma HLS INTERFACE axis register both port=txAppNewClientNoty name=s_NewClientNoty
+#if (TX_APP_WRITABLE_NOTIFICATION)
+#pragma HLS INTERFACE axis register both port=txAppWritable name=s_TxWritableNoty
+#pragma HLS DATA_PACK variable=txAppWritable
+#endif
 
 #pragma HLS DATA_PACK variable=listenPortRes
 #pragma HLS DATA_PACK variable=rxAppNotification
@@ -409,6 +437,9 @@ void echo_server_application(
 		transferMetaData, 
 		esa_dataFifo,
 		txAppDataReqStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+		txAppWritable,
+#endif
 		txAppDataReqMeta, 
 		txAppData_to_TOE);
 	
@@ -62,6 +62,9 @@ void echo_server_application(
 			stream<appTxMeta>& 				txAppDataReqMeta,
 			stream<axiWord> & 				txAppData_to_TOE,
 			stream<appTxRsp>& 				txAppDataReqStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			stream<appTxWritable>& 			txAppWritable,
+#endif
 			stream<txApp_client_status>& 	txAppNewClientNoty);
 
 #endif
@@ -34,17 +34,31 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************/
 
 #include "echo_server_application.hpp"
+#include "../TOE/testbench/tx_app_model.hpp"
+#include "../TOE/common_utilities/bit_utilities.hpp"
 #include <iostream>
+#include <iomanip>
+#include <deque>
 
 using namespace hls;
 
-
+/*
+ * After opening the listen port the echo server answers segments of 8 sessions. The TX
+ * side is txAppModel, the window of the other end is smaller than what the sessions send
+ * while their ACKs are on the way, so the server gets refused writes. The test reports the
+ * echoed bytes per cycle, the write requests and how many of them were refused.
+ */
+static const int NUM_SESSIONS 	= 8;
+static const int SEGMENT_LENGTH	= 1460;
+static const int WINDOW 		= 4 * SEGMENT_LENGTH;
+static const int ACK_LATENCY 	= 3000;
+static const int RUN_CYCLES 	= 200000;
 
 int main()
 {
 
 	stream<ap_uint<16> > 			listenPort("listenPort");
-	stream<bool> 					listenPortStatus("listenPortStatus");
+	stream<listenPortStatus> 		listenPortRsp("listenPortRsp");
 	stream<appNotification> 		notifications;
 	stream<appReadRequest> 			readRequest;
 	stream<ap_uint<16> > 			rxMetaData;
@@ -55,14 +69,25 @@ int main()
 	stream<appTxMeta> 				txMetaData;
 	stream<axiWord> 				txData;
 	stream<appTxRsp>				txStatus;
+	stream<appTxWritable>			txWritable;
 	stream<txApp_client_status>		txApp_client_notification;
 
-	int end_loop=0;
+	txAppModel						toeTx(WINDOW, ACK_LATENCY);
+	std::deque<axiWord>				rxWords;
+	listenPortStatus				listenRsp;
+	appReadRequest					request;
+	uint64_t 						rxBytes = 0;
+	int 							nextSession = 0;
+	int 							errors = 0;
+
+	for (int i = 0; i < NUM_SESSIONS; i++) {
+		toeTx.openSession(i);
+	}
 
-	do {
+	for (int cycle = 0; cycle < RUN_CYCLES + 50000; cycle++) {
 		echo_server_application(	
 			listenPort, 
-			listenPortStatus,
+			listenPortRsp,
 			notifications, 
 			readRequest,
 			rxMetaData, 
@@ -73,19 +98,50 @@ int main()
 			txMetaData, 
 			txData,
 			txStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			txWritable,
+#endif
 			txApp_client_notification);
 
-		if (end_loop !=0){
-			end_loop++;
-		}
-
 		if (!listenPort.empty()) {
-			listenPort.read();
-			end_loop = 1;
-			listenPortStatus.write(true);
+			listenRsp.port_number 		= listenPort.read();
+			listenRsp.open_successfully = true;
+			listenRsp.wrong_port_number = false;
+			listenRsp.already_open 		= false;
+			listenPortRsp.write(listenRsp);
 		}
 
+		// RX side, new segments while the server has room for them
+		if ((cycle < RUN_CYCLES) && notifications.empty() && (rxBytes - toeTx.bytesReceived < 16384)) {
+			notifications.write(appNotification(ap_uint<16>(nextSession), ap_uint<16>(SEGMENT_LENGTH), ap_uint<32>(0x0A010101), ap_uint<16>(15000)));
+			nextSession = (nextSession + 1) % NUM_SESSIONS;
+			rxBytes += SEGMENT_LENGTH;
+		}
+		if (!readRequest.empty()) {
+			readRequest.read(request);
+			rxMetaData.write(request.sessionID);
+			for (int bytes = request.length; bytes > 0; bytes -= 64) {
+				axiWord word(0, lowMask<64>(bytes > 64 ? 64 : bytes), (bytes <= 64));
+				rxWords.push_back(word);
+			}
+		}
+		if (!rxWords.empty()) {
+			rxData.write(rxWords.front());
+			rxWords.pop_front();
+		}
 
-	} while (end_loop < 4);
-	return 0;
+		toeTx.run(txMetaData, txData, txStatus, txWritable);
+	}
+
+	if (toeTx.bytesReceived != rxBytes) {
+		std::cout << "ERROR " << rxBytes << " bytes received, " << toeTx.bytesReceived << " echoed" << std::endl;
+		errors++;
+	}
+	std::cout << "echo server, writable notification " << (TX_APP_WRITABLE_NOTIFICATION ? "on" : "off");
+	std::cout << ", wait for space " << (TX_APP_WAIT_FOR_SPACE ? "on" : "off") << std::endl;
+	std::cout << std::fixed << std::setprecision(3) << "bytes/cycle " << (double) toeTx.bytesAccepted / RUN_CYCLES;
+	std::cout << "  requests " << toeTx.requests << "  refused " << toeTx.refused;
+	std::cout << "  requests per write " << (double) toeTx.requests / (toeTx.requests - toeTx.refused) << std::endl;
+	std::cout << (errors ? "FAILED" : "PASSED") << std::endl;
+	return (errors != 0);
 }
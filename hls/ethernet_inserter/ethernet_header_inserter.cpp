@@ -35,8 +35,11 @@ void broadcaster_and_mac_request(
 						stream<ap_uint<32> >&			arpTableRequest,				
 						stream<axiWord>&				ip_header_out,
 						stream<axiWord>&				no_ip_header_out,
+						stream<ethHeaderMeta>&			headerMeta,
+						ap_uint<48>&					myMacAddress,
 						ap_uint<32>&					regSubNetMask,
-						ap_uint<32>&					regDefaultGateway)
+						ap_uint<32>&					regDefaultGateway,
+						vlanInterface					vlanTable[NUM_VLAN_INTERFACES])
 {
 #pragma HLS INLINE off
 #pragma HLS pipeline II=1
@@ -47,18 +50,35 @@ void broadcaster_and_mac_request(
 //	static int 		word_count = 0;
 	axiWord 		currWord;
 	ap_uint<32> 	dst_ip_addr;
+	ap_uint<32> 	src_ip_addr;
+	ethHeaderMeta 	meta(myMacAddress, 0, false);
+	ap_uint<32> 	subNetMask 		= regSubNetMask;
+	ap_uint<32> 	defaultGateway 	= regDefaultGateway;
 
 	switch (bmr_fsm_state){
 		case FIRST_WORD : 
 			if (!dataIn.empty()){							// There are data in the input stream
 				dataIn.read(currWord);						// Reading input data
 				dst_ip_addr = currWord.data(159,128);		// getting the IP address
+				src_ip_addr = currWord.data(127, 96);
+
+				vlan_lookup: for (int m = 0; m < NUM_VLAN_INTERFACES; m++){		// The source IP address selects the L3 interface
+				#pragma HLS UNROLL
+					if (vlanTable[m].valid && (vlanTable[m].ipAddress == src_ip_addr)){
+						meta.srcMacAddress 	= vlanTable[m].macAddress;
+						meta.vlanID 		= vlanTable[m].vlanID;
+						meta.tagged 		= true;
+						subNetMask 			= vlanTable[m].subNetMask;
+						defaultGateway 		= vlanTable[m].defaultGateway;
+					}
+				}
 
-				if ((dst_ip_addr & regSubNetMask) == (regDefaultGateway & regSubNetMask))		// Check if the destination address is in the server subnetwork and asks for dst_ip_addr MAC if not asks for default gateway MAC address
+				if ((dst_ip_addr & subNetMask) == (defaultGateway & subNetMask))		// Check if the destination address is in the server subnetwork and asks for dst_ip_addr MAC if not asks for default gateway MAC address
 					arpTableRequest.write(dst_ip_addr);
 				else
-					arpTableRequest.write(regDefaultGateway);
+					arpTableRequest.write(defaultGateway);
 
+				headerMeta.write(meta);
 				ip_header_out.write(currWord); 				// Writing out first transaction 
 				if (!currWord.last)
 					bmr_fsm_state = REMAINING;
@@ -75,13 +95,16 @@ void broadcaster_and_mac_request(
 	}
 }
 
+/**
+ * Inserts the Ethernet header in front of the IP packet. When the packet belongs to a
+ * VLAN interface the header is 18 bytes long, an 802.1Q tag goes before the EtherType.
+ */
 void handle_output(
 						stream<arpTableReply>& 			arpTableReplay,
+						stream<ethHeaderMeta>&			headerMeta,
 						stream<axiWord>&				ip_header_checksum,
 						stream<axiWord>&				no_ip_header_out,
 
-						ap_uint<48>&					myMacAddress,
-
 						stream<axiWord>&				dataOut
 						
 						){
@@ -89,27 +112,40 @@ void handle_output(
 #pragma HLS pipeline II=1
 
 	enum mwState {WAIT_LOOKUP, DROP_IP, DROP_NO_IP, WRITE_FIRST_TRANSACTION, WRITE_REMAINING , WRITE_EXTRA_LAST_WORD};
-	typedef my_axis<112> axiremaining;
+	typedef my_axis<144> axiremaining;
 
 	static mwState mw_state = WAIT_LOOKUP;
 	static axiremaining previous_word;
+	static bool tagged;
 	
 	axiWord sendWord;
 	axiWord current_ip_checksum;
 	axiWord current_no_ip;
 	arpTableReply reply;
+	ethHeaderMeta meta;
 
 	switch (mw_state){
 		case WAIT_LOOKUP:
-			if (!arpTableReplay.empty()) {		// A valid response has been arrived
+			if (!arpTableReplay.empty() && !headerMeta.empty()) {		// A valid response has been arrived
 				arpTableReplay.read(reply);
+				headerMeta.read(meta);
 
 				if (reply.hit){										// The MAC address related to IP destination address has been found
 					previous_word.data( 47, 0) = reply.macAddress;		
-					previous_word.data( 95,48) = myMacAddress;
-					previous_word.data(111,96) = 0x0008;
-
-					previous_word.keep(13,0) = 0x3FFF;
+					previous_word.data( 95,48) = meta.srcMacAddress;
+					if (meta.tagged){
+						previous_word.data(111, 96) = 0x0081;					// TPID
+						previous_word.data(115,112) = meta.vlanID(11,8);		// PCP and DEI are 0
+						previous_word.data(119,116) = 0;
+						previous_word.data(127,120) = meta.vlanID( 7,0);
+						previous_word.data(143,128) = 0x0008;
+						previous_word.keep( 17,  0) = 0x3FFFF;
+					}
+					else {
+						previous_word.data(111,96) = 0x0008;
+						previous_word.keep(13,0) = 0x3FFF;
+					}
+					tagged = meta.tagged;
 
 					mw_state = WRITE_FIRST_TRANSACTION;
 				}
@@ -141,21 +177,33 @@ void handle_output(
 			if (!ip_header_checksum.empty()) {
 				ip_header_checksum.read(current_ip_checksum);
 
-				sendWord.data( 111,   0) 	= previous_word.data;					// Insert Ethernet header
-				sendWord.keep(  13,   0) 	= previous_word.keep;
+				if (tagged){
+					sendWord.data( 143,   0) 	= previous_word.data;					// Insert Ethernet header and 802.1Q tag
+					sendWord.keep(  17,   0) 	= previous_word.keep;
+
+					sendWord.data( 511, 144) 	= current_ip_checksum.data(367,0);		// Compose output word
+					sendWord.keep(  63,  18) 	= current_ip_checksum.keep( 45,0);
+
+					previous_word.data(143,0) 	= current_ip_checksum.data(511,368);
+					previous_word.keep( 17,0) 	= current_ip_checksum.keep(63,46);
+				}
+				else {
+					sendWord.data( 111,   0) 	= previous_word.data(111,0);			// Insert Ethernet header
+					sendWord.keep(  13,   0) 	= previous_word.keep( 13,0);
 
-				sendWord.data( 511, 112) 	= current_ip_checksum.data(399,0);		// Compose output word
-				sendWord.keep(  63,  14) 	= current_ip_checksum.keep( 49,0);
+					sendWord.data( 511, 112) 	= current_ip_checksum.data(399,0);		// Compose output word
+					sendWord.keep(  63,  14) 	= current_ip_checksum.keep( 49,0);
 
-				previous_word.data 			= current_ip_checksum.data(511,400);
-				previous_word.keep 			= current_ip_checksum.keep(63,50);
+					previous_word.data(111,0) 	= current_ip_checksum.data(511,400);
+					previous_word.keep( 13,0) 	= current_ip_checksum.keep(63,50);
+				}
 				sendWord.last 				= 0;
 
 				if (current_ip_checksum.last == 1){
-					if (current_ip_checksum.keep[50]){
+					if ((!tagged && current_ip_checksum.keep[50]) || (tagged && current_ip_checksum.keep[46])){
 
 						mw_state = WRITE_EXTRA_LAST_WORD;
-					}									// If the current word has more than 50 bytes a extra transaction for remaining data is needed
+					}									// If the current word has more than 50 (46) bytes a extra transaction for remaining data is needed
 					else{
 						sendWord.last 	= 1;
 						mw_state = WAIT_LOOKUP;
@@ -173,21 +221,33 @@ void handle_output(
 			if (!no_ip_header_out.empty()) {
 				no_ip_header_out.read(current_no_ip);
 
-				sendWord.data( 111,   0) 	= previous_word.data;
-				sendWord.keep(  13,   0) 	= previous_word.keep;
+				if (tagged){
+					sendWord.data( 143,   0) 	= previous_word.data;
+					sendWord.keep(  17,   0) 	= previous_word.keep;
 
-				sendWord.data( 511, 112) 	= current_no_ip.data(399,0);		// Compose output word
-				sendWord.keep(  63,  14) 	= current_no_ip.keep( 49,0);
+					sendWord.data( 511, 144) 	= current_no_ip.data(367,0);		// Compose output word
+					sendWord.keep(  63,  18) 	= current_no_ip.keep( 45,0);
+
+					previous_word.data(143,0) 	= current_no_ip.data(511,368);
+					previous_word.keep( 17,0) 	= current_no_ip.keep(63,46);
+				}
+				else {
+					sendWord.data( 111,   0) 	= previous_word.data(111,0);
+					sendWord.keep(  13,   0) 	= previous_word.keep( 13,0);
 
-				previous_word.data 			= current_no_ip.data(511,400);
-				previous_word.keep 			= current_no_ip.keep(63,50);
+					sendWord.data( 511, 112) 	= current_no_ip.data(399,0);		// Compose output word
+					sendWord.keep(  63,  14) 	= current_no_ip.keep( 49,0);
+
+					previous_word.data(111,0) 	= current_no_ip.data(511,400);
+					previous_word.keep( 13,0) 	= current_no_ip.keep(63,50);
+				}
 				sendWord.last 				= 0;
 				
 				if (current_no_ip.last == 1){
-					if (current_no_ip.keep.bit(50)){
+					if ((!tagged && current_no_ip.keep.bit(50)) || (tagged && current_no_ip.keep.bit(46))){
 
 						mw_state = WRITE_EXTRA_LAST_WORD;
-					}									// If the current word has more than 50 bytes a extra transaction for remaining data is needed
+					}									// If the current word has more than 50 (46) bytes a extra transaction for remaining data is needed
 					else{
 						sendWord.last 	= 1;
 						mw_state = WAIT_LOOKUP;
@@ -199,10 +259,18 @@ void handle_output(
 		break;
 
 		case WRITE_EXTRA_LAST_WORD:
-			sendWord.data( 111,   0) 	= previous_word.data;
-			sendWord.keep(  13,   0) 	= previous_word.keep;
-			sendWord.data( 511, 112) 	= 0;
-			sendWord.keep(  63,  14) 	= 0;
+			if (tagged){
+				sendWord.data( 143,   0) 	= previous_word.data;
+				sendWord.keep(  17,   0) 	= previous_word.keep;
+				sendWord.data( 511, 144) 	= 0;
+				sendWord.keep(  63,  18) 	= 0;
+			}
+			else {
+				sendWord.data( 111,   0) 	= previous_word.data(111,0);
+				sendWord.keep(  13,   0) 	= previous_word.keep( 13,0);
+				sendWord.data( 511, 112) 	= 0;
+				sendWord.keep(  63,  14) 	= 0;
+			}
 			sendWord.last 				= 1;
 			dataOut.write(sendWord);
 			mw_state = WAIT_LOOKUP;
@@ -250,7 +318,7 @@ void compute_and_insert_ip_checksum (
 		#pragma HLS unroll
 			temp(7, 0) = currWord.data(i*16+15, i*16+8);
 			temp(15, 8) = currWord.data(i*16+7, i*16);
-			if (i < ipHeaderLen*2)
+			if (i < ipHeaderLen.to_int()*2)
 				ip_ops[i] = temp;
 			else
 				ip_ops[i] = 0;
@@ -297,6 +365,7 @@ void compute_and_insert_ip_checksum (
 
 /** @ingroup mac_ip_encode
  *  This module requests the MAC address of the destination IP address and inserts the Ethener header to the IP packet
+ *  Packets sourced from the IP address of a VLAN interface are tagged (802.1Q) and use that interface configuration
  */
 void ethernet_header_inserter(
 
@@ -308,7 +377,8 @@ void ethernet_header_inserter(
 					
 					ap_uint<48>&				myMacAddress,				// Server MAC address
 					ap_uint<32>&				regSubNetMask,				// Server subnet mask
-					ap_uint<32>&				regDefaultGateway)			// Server default gateway
+					ap_uint<32>&				regDefaultGateway,			// Server default gateway
+					vlanInterface				vlanTable[NUM_VLAN_INTERFACES])	// VLAN interfaces, untagged if none matches
 {
 
 #pragma HLS DATAFLOW
@@ -325,6 +395,9 @@ void ethernet_header_inserter(
 #pragma HLS INTERFACE ap_stable register port=myMacAddress name=myMacAddress
 #pragma HLS INTERFACE ap_stable register port=regSubNetMask name=regSubNetMask
 #pragma HLS INTERFACE ap_stable register port=regDefaultGateway name=regDefaultGateway
+#pragma HLS INTERFACE ap_stable port=vlanTable
+#pragma HLS ARRAY_PARTITION variable=vlanTable complete dim=1
+#pragma HLS DATA_PACK variable=vlanTable
 
 	// FIFOs
 	static stream<axiWord> ip_header_out;
@@ -339,14 +412,21 @@ void ethernet_header_inserter(
 	#pragma HLS stream variable=ip_header_checksum depth=16 
 	#pragma HLS DATA_PACK variable=ip_header_checksum
 
+	static stream<ethHeaderMeta> header_meta;
+	#pragma HLS stream variable=header_meta depth=16 
+	#pragma HLS DATA_PACK variable=header_meta
+
 
 	broadcaster_and_mac_request (
 			dataIn, 
 			arpTableRequest, 
 			ip_header_out, 
 			no_ip_header_out,
+			header_meta,
+			myMacAddress,
 			regSubNetMask, 
-			regDefaultGateway);
+			regDefaultGateway,
+			vlanTable);
 
 	compute_and_insert_ip_checksum(
 			ip_header_out,
@@ -354,8 +434,8 @@ void ethernet_header_inserter(
 
 	handle_output (
 			arpTableReplay, 
+			header_meta,
 			ip_header_checksum, 
 			no_ip_header_out, 
-			myMacAddress, 
 			dataOut);
 }
@@ -39,6 +39,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.// Copyright (c) 2015 Xilinx,
 #include <hls_stream.h>
 #include "ap_int.h"
 #include <stdint.h>
+#include "../TOE/common_utilities/vlan_interface.hpp"
 
 using namespace hls;
 using namespace std;
@@ -64,6 +65,20 @@ struct arpTableReply
 			:macAddress(macAdd), hit(hit) {}
 };
 
+struct ethHeaderMeta
+{
+	ap_uint<48>	srcMacAddress;
+	ap_uint<12>	vlanID;
+	bool		tagged;
+	ethHeaderMeta() {}
+	ethHeaderMeta(ap_uint<48> mac, ap_uint<12> id, bool tagged)
+			:srcMacAddress(mac), vlanID(id), tagged(tagged) {}
+};
+
+
+void compute_and_insert_ip_checksum (
+						stream<axiWord>&			dataIn,
+					  	stream<axiWord>&			dataOut);
 
 /** @defgroup mac_ip_encode MAC-IP encode
  *
@@ -76,8 +91,9 @@ void ethernet_header_inserter(
 					stream<arpTableReply>&		arpTableReplay,					// ARP cache replay
 					stream<ap_uint<32> >&		arpTableRequest,				// ARP cache request
 					
-					ap_uint<48>					myMacAddress,				// Server MAC address
-					ap_uint<32>					regSubNetMask,				// Server subnet mask
-					ap_uint<32>					regDefaultGateway);			// Server default gateway
+					ap_uint<48>&				myMacAddress,				// Server MAC address
+					ap_uint<32>&				regSubNetMask,				// Server subnet mask
+					ap_uint<32>&				regDefaultGateway,			// Server default gateway
+					vlanInterface				vlanTable[NUM_VLAN_INTERFACES]);	// VLAN interfaces, untagged if none matches
 
 #endif
\ No newline at end of file
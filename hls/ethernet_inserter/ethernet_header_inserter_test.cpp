@@ -36,7 +36,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ethernet_header_inserter.hpp"
 #include <stdio.h>
 #include <stdlib.h>
-#include "pcap.h"
+#include <vector>
+#include "../TOE/testbench/pcap.h"
 
 stream<axiWord> input_data;
 axiWord transaction;
@@ -47,11 +48,11 @@ axiWord transaction;
 void pcapPacketHandler (unsigned char *userData,  struct pcap_pkthdr* pkthdr, unsigned char *packet) {
 
 	ap_uint<16> bytes_sent=0, bytes2send,last_trans;
-	ap_uint<ETH_INTERFACE_WIDTH/8> aux_strb;
+	ap_uint<ETH_INTERFACE_WIDTH/8> aux_keep;
 	ap_uint<ETH_INTERFACE_WIDTH> data_value;
 
 	for (int h=0 ; h< ETH_INTERFACE_WIDTH/8 ; h++){
-		transaction.strb[h]=1;
+		transaction.keep[h]=1;
 	}
 	transaction.last=0;
 
@@ -59,7 +60,7 @@ void pcapPacketHandler (unsigned char *userData,  struct pcap_pkthdr* pkthdr, un
 #ifdef DEBUG
 	cout << "Bytes to send " << bytes2send << endl;
 #endif
-	for (int h=0; h < bytes2send ; h+= ETH_INTERFACE_WIDTH/8){
+	for (int h=0; h < bytes2send.to_int() ; h+= ETH_INTERFACE_WIDTH/8){
 		bytes_sent += ETH_INTERFACE_WIDTH/8;
 		if (bytes_sent < bytes2send){
 			data_value= *((ap_uint<ETH_INTERFACE_WIDTH> *)packet);
@@ -69,15 +70,15 @@ void pcapPacketHandler (unsigned char *userData,  struct pcap_pkthdr* pkthdr, un
 			last_trans= ETH_INTERFACE_WIDTH/8 - bytes_sent + bytes2send;
 
 			for (int s=0 ; s< ETH_INTERFACE_WIDTH/8; s++){
-				if (s < last_trans)
-					aux_strb[s]=1;
+				if (s < last_trans.to_int())
+					aux_keep[s]=1;
 				else
-					aux_strb[s]=0;
+					aux_keep[s]=0;
 			}
 			transaction.last=1;
-			transaction.strb=aux_strb;
+			transaction.keep=aux_keep;
 			data_value=0;
-			for (int s=0; s < last_trans*8 ; s+=8){
+			for (int s=0; s < last_trans.to_int()*8 ; s+=8){
 				data_value.range(s+7,s)= *((ap_uint<8> *)packet);
 				packet++;
 			}
@@ -91,7 +92,7 @@ void pcapPacketHandler (unsigned char *userData,  struct pcap_pkthdr* pkthdr, un
 #endif
 #ifdef DEBUG1
 		cout << "Test Data Transaction [" << dec << h/(ETH_INTERFACE_WIDTH/8) << "]";
-		cout	<< "\tComplete Data " << hex << transaction.data << "\t\tstrb " << transaction.strb << "\tlast " << transaction.last << endl;
+		cout	<< "\tComplete Data " << hex << transaction.data << "\t\tstrb " << transaction.keep << "\tlast " << transaction.last << endl;
 #endif
 
 		input_data.write(transaction);
@@ -123,14 +124,14 @@ void remove_ethernet (
 						dataIn.read(currWord);
 						prevWord = {0,0,0};									// initialize
 						prevWord.data(399,0) = currWord.data(511 , 112);
-						prevWord.strb(49 ,0) = currWord.strb( 63 ,  14);
+						prevWord.keep(49 ,0) = currWord.keep( 63 ,  14);
 						prevWord.last = currWord.last;
 						if (currWord.last == 1){
 							sendWord = prevWord;
 							dataOut.write(sendWord);
 #ifdef DEBUG1
 		cout << "Test Data Transaction [" << dec << wordCount/(ETH_INTERFACE_WIDTH/8) << "]";
-		cout	<< "\tShaved off Data " << hex << sendWord.data << "\t\tstrb " << sendWord.strb << "\tlast " << sendWord.last << endl;
+		cout	<< "\tShaved off Data " << hex << sendWord.data << "\t\tstrb " << sendWord.keep << "\tlast " << sendWord.last << endl;
 #endif							
 						}
 						else{
@@ -146,19 +147,19 @@ void remove_ethernet (
 	
 	
 						sendWord.data(399,0) 	= prevWord.data(399,0);
-						sendWord.strb(49 ,0) 	= prevWord.strb(49 ,0);
+						sendWord.keep(49 ,0) 	= prevWord.keep(49 ,0);
 						sendWord.data(511,400) 	= currWord.data(111 ,  0);
-						sendWord.strb( 63 ,50) 	= currWord.strb( 13 ,  0);
+						sendWord.keep( 63 ,50) 	= currWord.keep( 13 ,  0);
 	
 						prevWord = {0,0,0};									// initialize
 						prevWord.data(399,0) 	= currWord.data(511 , 112);
-						prevWord.strb(49 ,0) 	= currWord.strb( 63 ,  14);
+						prevWord.keep(49 ,0) 	= currWord.keep( 63 ,  14);
 						prevWord.last 		 	= currWord.last;
 
 						sendWord.last 			= 0;
 	
 						if (currWord.last == 1) {
-							if (currWord.strb.bit(14)){
+							if (currWord.keep.bit(14)){
 								mw_state = WRITE_EXTRA_LAST_WORD;
 							}
 							else{
@@ -171,7 +172,7 @@ void remove_ethernet (
 						dataOut.write(sendWord);
 #ifdef DEBUG1
 		cout << "Test Data Transaction [" << dec << wordCount/(ETH_INTERFACE_WIDTH/8) << "]";
-		cout	<< "\tShaved off Data " << hex << sendWord.data << "\t\tstrb " << sendWord.strb << "\tlast " << sendWord.last << endl;
+		cout	<< "\tShaved off Data " << hex << sendWord.data << "\t\tstrb " << sendWord.keep << "\tlast " << sendWord.last << endl;
 #endif
 					}
 				break;
@@ -183,7 +184,7 @@ void remove_ethernet (
 					mw_state = WAIT_PKT;
 #ifdef DEBUG1
 		cout << "Test Data Transaction [" << dec << wordCount/(ETH_INTERFACE_WIDTH/8) << "]";
-		cout	<< "\tShaved off Data " << hex << sendWord.data << "\t\tstrb " << sendWord.strb << "\tlast " << sendWord.last << endl;
+		cout	<< "\tShaved off Data " << hex << sendWord.data << "\t\tstrb " << sendWord.keep << "\tlast " << sendWord.last << endl;
 #endif
 				break;
 	
@@ -198,12 +199,165 @@ void remove_ethernet (
 }
 
 
+/*
+ * VLAN insertion test. IP packets sourced from the default address and from the
+ * address of each VLAN interface are interleaved. Every output frame must carry
+ * the MAC address of its interface, an 802.1Q tag only when it belongs to a VLAN
+ * and the next hop MAC given by the ARP table for its subnet configuration.
+ */
+ap_uint<48> arp_mac(ap_uint<32> ipAddress){
+	return (ap_uint<48>(0x0000BEEF) << 32) | ipAddress;
+}
+
+ap_uint<16> ip_checksum(std::vector<uint8_t>& ip){
+	ap_uint<32> sum = 0;
+
+	for (int i = 0; i < 20; i += 2){
+		if (i != 10)
+			sum += (ip[i] << 8) | ip[i+1];
+	}
+	sum = sum(15,0) + sum(31,16);
+	sum = sum(15,0) + sum(31,16);
+	return ~sum(15,0);
+}
+
+int vlan_tx_test(){
+
+	stream<axiWord>					dataIn("dataIn");
+	stream<axiWord>					dataOut("dataOut");
+	stream<arpTableReply>			arpTableReplay("arpTableReplay");
+	stream<ap_uint<32> >			arpTableRequest("arpTableRequest");
+	ap_uint<48>						myMacAddress 		= 0x0000E0D0C0B0A0;
+	ap_uint<32>						regSubNetMask 		= 0x00FFFFFF;
+	ap_uint<32>						regDefaultGateway 	= 0x0100a8c0;		// 192.168.0.1
+	ap_uint<32>						myIpAddress 		= 0x0500a8c0;		// 192.168.0.5
+	vlanInterface					vlanTable[NUM_VLAN_INTERFACES];
+	std::vector<std::vector<uint8_t> > golden;
+	std::vector<uint8_t>			received;
+	axiWord							currWord;
+	unsigned int 					inputWords = 0;
+	unsigned int 					packets = 0;
+	int 							errors = 0;
+
+	srand(3);
+
+	for (int m = 0; m < NUM_VLAN_INTERFACES; m++){
+		vlanTable[m].valid 			= (m % 2) == 0;
+		vlanTable[m].vlanID 		= 200 + m;
+		vlanTable[m].ipAddress 		= 0x0500000a + (m << 8);		// 10.0.m.5
+		vlanTable[m].macAddress 	= 0x0000CAFE0000 + m;
+		vlanTable[m].subNetMask 	= 0x00FFFFFF;
+		vlanTable[m].defaultGateway = 0x0100000a + (m << 8);		// 10.0.m.1
+	}
+
+	for (int p = 0; p < 1000; p++){
+		int 			vlan 		= rand() % NUM_VLAN_INTERFACES;
+		bool 			useVlan 	= (rand() % 3) != 0;
+		int 			length 		= 20 + (rand() % 1480);
+		ap_uint<32> 	srcIp 		= useVlan ? vlanTable[vlan].ipAddress : myIpAddress;
+		bool 			tagged 		= useVlan && vlanTable[vlan].valid;
+		ap_uint<32> 	mask 		= tagged ? vlanTable[vlan].subNetMask : regSubNetMask;
+		ap_uint<32> 	gateway 	= tagged ? vlanTable[vlan].defaultGateway : regDefaultGateway;
+		ap_uint<48> 	srcMac 		= tagged ? vlanTable[vlan].macAddress : myMacAddress;
+		ap_uint<32> 	dstIp;
+		ap_uint<32> 	nextHop;
+		std::vector<uint8_t> ip(length);
+		std::vector<uint8_t> frame;
+
+		dstIp 	= (rand() % 2) ? ap_uint<32>((gateway & mask) | (ap_uint<32>(rand() % 250 + 2) << 24)) : ap_uint<32>(rand());
+		nextHop = ((dstIp & mask) == (gateway & mask)) ? dstIp : gateway;
+
+		for (int i = 0; i < length; i++)
+			ip[i] = rand();
+		ip[0] = 0x45;
+		ip[2] = length >> 8;
+		ip[3] = length & 0xFF;
+		for (int b = 0; b < 4; b++){
+			ip[12+b] = srcIp(b*8+7, b*8);
+			ip[16+b] = dstIp(b*8+7, b*8);
+		}
+		ip[10] = 0;													// The module computes the checksum
+		ip[11] = 0;
+
+		for (size_t i = 0; i < ip.size(); i += 64){
+			currWord.data = 0;
+			currWord.keep = 0;
+			for (size_t b = 0; b < 64 && (i + b) < ip.size(); b++){
+				currWord.data(b*8+7, b*8) = ip[i+b];
+				currWord.keep.bit(b) = 1;
+			}
+			currWord.last = (i + 64) >= ip.size();
+			dataIn.write(currWord);
+			inputWords++;
+		}
+
+		ap_uint<16> checksum = ip_checksum(ip);
+		ip[10] = checksum(15,8);
+		ip[11] = checksum( 7,0);
+		for (int b = 0; b < 6; b++)
+			frame.push_back(arp_mac(nextHop)(b*8+7, b*8));
+		for (int b = 0; b < 6; b++)
+			frame.push_back(srcMac(b*8+7, b*8));
+		if (tagged){
+			frame.push_back(0x81);
+			frame.push_back(0x00);
+			frame.push_back(vlanTable[vlan].vlanID(11,8));
+			frame.push_back(vlanTable[vlan].vlanID( 7,0));
+		}
+		frame.push_back(0x08);
+		frame.push_back(0x00);
+		frame.insert(frame.end(), ip.begin(), ip.end());
+		golden.push_back(frame);
+	}
+
+	for (unsigned int cycle = 0; cycle < inputWords + 2 * golden.size() + 100; cycle++){	// handle_output spends one cycle per packet waiting the lookup
+		ethernet_header_inserter(
+					dataIn,
+					dataOut,
+					arpTableReplay,
+					arpTableRequest,
+					myMacAddress,
+					regSubNetMask,
+					regDefaultGateway,
+					vlanTable);
+
+		while (!arpTableRequest.empty()){							// ARP table always hits
+			ap_uint<32> query = arpTableRequest.read();
+			arpTableReplay.write(arpTableReply(arp_mac(query), true));
+		}
+
+		while (!dataOut.empty()){
+			dataOut.read(currWord);
+			for (int b = 0; b < 64; b++){
+				if (currWord.keep.bit(b))
+					received.push_back(currWord.data(b*8+7, b*8));
+			}
+			if (currWord.last){
+				if (packets >= golden.size() || received != golden[packets]){
+					cout << "VLAN test packet [" << dec << packets << "] does not match" << endl;
+					errors++;
+				}
+				received.clear();
+				packets++;
+			}
+		}
+	}
+
+	if (packets != golden.size()){
+		cout << "VLAN test received " << dec << packets << " packets, expected " << golden.size() << endl;
+		errors++;
+	}
+
+	cout << "VLAN test packets " << dec << packets << " errors " << errors << endl;
+	return errors;
+}
+
+
 int main(int argc, char **argv){
 
 	stream<axiWord> output_data;
 	axiWord value_out;
 	ap_uint<32> pkt_rx;
-	ap_uint<16> h=0;
 
 	stream<axiWord> without_ethernet;
 
@@ -218,7 +372,6 @@ int main(int argc, char **argv){
 
 	char file2load[500]="/home/mario/Documents/cmac_100g/submodules/tcp_ip_cores/mac_ip_encode/";
 	char default_file[50]="prueba2.pcap";
-	char file[100];
 
 	if (argc == 2){
 		strcat(file2load,argv[1]);
@@ -227,10 +380,13 @@ int main(int argc, char **argv){
 		strcat(file2load,default_file);
 	}
 
+	if (vlan_tx_test() != 0)
+		return -1;
+
 	cout << "File 2 load " << file2load << endl;
 
 	/* Read packets from pcapfile */
-	if(pcap_open (file2load)) {
+	if(pcap_open (file2load, true)) {
 		cout << "Error opening the input file"<< endl;
 		return -1;
 	}
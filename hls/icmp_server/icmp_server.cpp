@@ -114,11 +114,15 @@ ap_uint<16> computeCheckSum20B(ap_uint<160> ipHeader){
 /** @ingroup icmp_server
  *  Main function
  *  @param[in]      dataIn
+ *  @param[out]     dropReportOut   Reason of every packet that is not answered, never waited for
  *  @param[out]     dataOut
  */
 void icmp_server(
             stream<axiWord>&            dataIn,
             ap_uint<32>&                myIpAddress,
+#if (DROP_REPORTS)
+            stream<dropReport>&         dropReportOut,
+#endif
             stream<axiWord>&            dataOut) {
 
 #pragma HLS INTERFACE ap_ctrl_none port=return
@@ -126,6 +130,10 @@ void icmp_server(
 
 #pragma HLS INTERFACE axis register both port=dataIn name=s_axis_icmp
 #pragma HLS INTERFACE axis register both port=dataOut name=m_axis_icmp
+#if (DROP_REPORTS)
+#pragma HLS INTERFACE axis register both port=dropReportOut name=m_axis_drop_report
+#pragma HLS DATA_PACK variable=dropReportOut
+#endif
 #pragma HLS INTERFACE ap_stable register port=myIpAddress name=myIpAddress
 
 #pragma HLS pipeline II=1
@@ -144,6 +152,10 @@ void icmp_server(
     ap_uint< 16>    auxInchecksum;
     axiWord         currWord;
     ap_uint<160>    auxIPheader;
+    dropReason      drop = DROP_NONE;
+#if (DROP_REPORTS)
+    static ap_uint<16>     lostReports = 0;
+#endif
 
     switch(aiFSMState){
         case READ_PACKET:
@@ -167,11 +179,20 @@ void icmp_server(
             break;
 
         case EVALUATE_CONDITIONS:
-            if ((ipDestination == myIpAddress) && (icmpType == ECHO_REQUEST && (icmpCode == 0)) && auxInchecksum_r == 0){
+            if (auxInchecksum_r != 0)
+                drop = DROP_ICMP_BAD_CHECKSUM;
+            else if (ipDestination != myIpAddress)
+                drop = DROP_ICMP_NOT_FOR_US;
+            else if (icmpType != ECHO_REQUEST || icmpCode != 0)
+                drop = DROP_ICMP_NOT_ECHO;
+            else
+                drop = DROP_NONE;
+
+            if (drop == DROP_NONE){
                 aiFSMState = SEND_FIRST_WORD;
             }
             else {
-                if (!currWord.last){
+                if (!prevWord.last){
                     aiFSMState = DROP_PACKET;
                 }
                 else{
@@ -223,5 +244,8 @@ void icmp_server(
             }
             break;
     }
+#if (DROP_REPORTS)
+    reportDrop(dropReportOut, dropReport(drop), lostReports);
+#endif
 
 }
@@ -56,4 +56,7 @@ struct ipMetaData {
 void icmp_server(
             stream<axiWord>&            dataIn,
             ap_uint<32>&                myIpAddress,
+#if (DROP_REPORTS)
+            stream<dropReport>&         dropReportOut,
+#endif
             stream<axiWord>&            dataOut);
\ No newline at end of file
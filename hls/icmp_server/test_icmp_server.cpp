@@ -39,12 +39,87 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 using namespace hls;
 using namespace std;
 
+/*
+ * Echo request of 60 bytes, the IP header checksum is right unless badChecksum
+ */
+axiWord icmp_packet(ap_uint<32> dstIp, uint8_t type, bool badChecksum){
+	uint8_t 	ip[60] = {0};
+	uint32_t 	sum = 0;
+	axiWord 	word(0, 0, 1);
+
+	ip[0] 	= 0x45;
+	ip[3] 	= 60;
+	ip[8] 	= 64;
+	ip[9] 	= ICMP_PROTOCOL;
+	for (int b = 0; b < 4; b++){
+		ip[12 + b] = 10 + b;
+		ip[16 + b] = dstIp(b*8+7, b*8);
+	}
+	for (int i = 0; i < 20; i += 2)
+		sum += (ip[i] << 8) | ip[i+1];
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = ~sum + (badChecksum ? 1 : 0);
+	ip[10] 	= (sum >> 8) & 0xFF;
+	ip[11] 	= sum & 0xFF;
+	ip[20] 	= type;
+
+	for (int b = 0; b < 60; b++){
+		word.data(b*8+7, b*8) 	= ip[b];
+		word.keep.bit(b) 		= 1;
+	}
+	return word;
+}
+
+#if (DROP_REPORTS)
+/*
+ * A packet for every reason not to answer, each one gives a single drop report
+ */
+int drop_reason_test(ap_uint<32> myIpAddress){
+	stream<axiWord>		dataIn("dropIn");
+	stream<axiWord>		dataOut("dropOut");
+	stream<dropReport>	dropReports("dropReports");
+	int 				errors = 0;
+
+	const char* names[] = {"bad checksum", "another address", "timestamp request", "echo request"};
+	dropReason expected[] = {DROP_ICMP_BAD_CHECKSUM, DROP_ICMP_NOT_FOR_US, DROP_ICMP_NOT_ECHO, DROP_NONE};
+	axiWord packets[] = {icmp_packet(myIpAddress, ECHO_REQUEST, true), icmp_packet(0x0600a8c0, ECHO_REQUEST, false),
+						 icmp_packet(myIpAddress, 13, false), icmp_packet(myIpAddress, ECHO_REQUEST, false)};
+
+	for (int c = 0; c < 4; c++){
+		dataIn.write(packets[c]);
+		for (int m = 0; m < 10; m++)
+			icmp_server(dataIn, myIpAddress, dropReports, dataOut);
+
+		if (expected[c] == DROP_NONE){
+			if (dataOut.empty() || !dropReports.empty()){
+				cout << "Drop reason: " << names[c] << " was not answered" << endl;
+				errors++;
+			}
+		}
+		else if (dropReports.empty() || dropReports.read().reason != expected[c] || !dataOut.empty()){
+			cout << "Drop reason: " << names[c] << " was not reported as " << dec << expected[c] << endl;
+			errors++;
+		}
+		while (!dataOut.empty())
+			dataOut.read();
+		while (!dropReports.empty())
+			dropReports.read();
+	}
+	cout << "Drop reasons: 4 packets checked" << endl;
+	return errors;
+}
+#endif
+
 int main(int argc, char **argv) {
 
 
 	stream<axiWord>						ipRxData("ipRxData");
 	stream<axiWord>						ipTxData("ipTxData");
 	stream<axiWord>						goldenData("goldenData");
+#if (DROP_REPORTS)
+	stream<dropReport>					dropReports("dropReports");
+#endif
 	ap_uint<32>							myIpAddress = 0x0500a8c0;
 
 
@@ -66,6 +141,9 @@ int main(int argc, char **argv) {
 		icmp_server(
 	            ipRxData,
 	            myIpAddress,
+#if (DROP_REPORTS)
+	            dropReports,
+#endif
 	            ipTxData);
 	}
 
@@ -105,7 +183,13 @@ int main(int argc, char **argv) {
 			wordCount++;
 	}
 
+#if (DROP_REPORTS)
+	cout << "Processed packets " << dec << packets << " dropped " << dropReports.size() << endl;
+
+	return drop_reason_test(myIpAddress);
+#else
 	cout << "Processed packets " << dec << packets << endl;
 
 	return 0;
+#endif
 }
@@ -390,6 +390,9 @@ void client(
                 stream<ap_uint<16> >&       closeConnection,
                 stream<appTxMeta>&          txMetaData,
                 stream<appTxRsp>&           txStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+                stream<appTxWritable>&      txWritable,
+#endif
                 stream<axiWord>&            txData,
                 stream<ap_uint<64> >&       stopWatchStart,
                 stream<bool >&              stopWatchStop,
@@ -410,6 +413,8 @@ void client(
     static ap_uint<16>          packet_mss_r;
     static ap_uint<16>          dstPort_r;
     static ap_uint<16>          transaction_length;
+    static bool                 nextRequested = false;
+    static ap_uint<MAX_SESSIONS> sessionWaiting = 0;    // Refused connections, until their writable notification
     static ap_uint<16>          waitCounter = 0;
     static ap_uint<14>          numConnections_r;
     static ap_uint<14>          sessionIt       = 0;
@@ -455,6 +460,7 @@ void client(
                     packet_mss_r        = settings_regs.packet_mss;       // Register input variables
                     errorOpeningConnection = 0;
                     stopWatchEnd        = 0;
+                    sessionWaiting      = 0;
                     if (settings_regs.useTimer) {
                         stopWatchStart.write(settings_regs.runTime);        // Start stopwatch
                     }
@@ -514,12 +520,11 @@ void client(
                 meta_i.length    = 24;
             }
             txMetaData.write(meta_i);
-            sessionIt++;
             if (stopWatchEnd) {
+                sessionIt = 0;
                 iperfFsmState = CLOSE_CONN;
             }
-            else if (sessionIt == numConnections_r) {    // Request space for every connection
-                sessionIt = 0;
+            else {                                      // INIT_RUN sends the first packet and moves to the next connection
                 iperfFsmState = INIT_RUN;
             }
             break; 
@@ -648,6 +653,13 @@ void client(
                     iperfFsmState = SEND_PACKET;
                     bytes_already_sent = bytes_already_sent + transaction_length;
                 }
+#if (TX_APP_WRITABLE_NOTIFICATION)
+                else if ((spaceReplay.error == ERROR_WINDOW) || (spaceReplay.error == ERROR_NOSPACE)) {
+                    sessionWaiting.bit(spaceReplay.sessionID) = 1;  // Ask again when the TOE tells the space is there
+                    waitCounter = 0;
+                    iperfFsmState = REQUEST_SPACE;
+                }
+#endif
                 else {
                     waitCounter = 0;
                     iperfFsmState = REQUEST_SPACE;
@@ -670,7 +682,12 @@ void client(
             if (wordSentCount==1 && useTimer_r){
                 meta_i.sessionID = experimentID[sessionIt];
                 meta_i.length    = transaction_length;
-                if (!stopWatchEnd){
+#if (TX_APP_WRITABLE_NOTIFICATION)
+                nextRequested    = !stopWatchEnd && !sessionWaiting.bit(meta_i.sessionID);
+#else
+                nextRequested    = !stopWatchEnd;
+#endif
+                if (nextRequested){
                     txMetaData.write(meta_i);
                 }
                 sessionIt++;
@@ -687,12 +704,15 @@ void client(
                 }
 
                 if (useTimer_r){
-                    if (stopWatchEnd){
+                    if (nextRequested){                     // A request already issued still needs its payload
+                        iperfFsmState = SPACE_RESPONSE;
+                    }
+                    else if (stopWatchEnd){
                         iperfFsmState = CLOSE_CONN;
                         sessionIt=0;
                     }
-                    else {
-                        iperfFsmState = SPACE_RESPONSE;
+                    else {                                  // The next connection waits for space
+                        iperfFsmState = REQUEST_SPACE;
                     }
                 }
                 else {
@@ -714,6 +734,11 @@ void client(
                 sessionIt=0;
                 iperfFsmState = CLOSE_CONN;
             }
+#if (TX_APP_WRITABLE_NOTIFICATION)
+            else if (sessionWaiting.bit(experimentID[sessionIt])) { // Try the next connection
+                sessionIt = (sessionIt == (numConnections_r-1)) ? ap_uint<14>(0) : ap_uint<14>(sessionIt + 1);
+            }
+#endif
             else {
                 meta_i.sessionID = experimentID[sessionIt];
                 meta_i.length    = transaction_length;
@@ -722,6 +747,7 @@ void client(
             }
             break;
 
+
         case CLOSE_CONN:
             if (waitCounter == 10000){
                 iperfFsmState = CLOSE_CONN1;
@@ -751,6 +777,12 @@ void client(
 
     runExperiment_r = settings_regs.runExperiment;                // Register run Experiment
 
+#if (TX_APP_WRITABLE_NOTIFICATION)
+    if (!txWritable.empty()) {
+        sessionWaiting.bit(txWritable.read().sessionID) = 0;
+    }
+#endif
+
 
     if(!stopWatchStop.empty()){
         stopWatchStop.read();
@@ -904,6 +936,7 @@ void server(
  * @param      closeConnection          Close a connection
  * @param      txAppDataReqMeta         Request to send data
  * @param      txAppDataReqStatus       Response for transmission request
+ * @param      txAppWritable            Space available again for a refused request
  * @param      txAppData_to_TOE         Data from the app to TOE
  * @param      txAppNewClientNoty       Notification of new client
  * @param[in]  runExperiment            Running the experiment
@@ -925,6 +958,9 @@ void iperf2_client(
                     stream<ap_uint<16> >&           closeConnection,
                     stream<appTxMeta>&              txAppDataReqMeta, 
                     stream<appTxRsp>&               txAppDataReqStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+                    stream<appTxWritable>&          txAppWritable,
+#endif
                     stream<axiWord>&                txAppData_to_TOE,
                     stream<txApp_client_status>&    txAppNewClientNoty, 
 
@@ -947,6 +983,10 @@ void iperf2_client(
 #pragma HLS INTERFACE axis register both port=txAppDataReqStatus name=s_TxDataResponse
 #pragma HLS INTERFACE axis register both port=txAppData_to_TOE name=m_TxPayload
 #pragma HLS INTERFACE axis register both port=txAppNewClientNoty name=s_NewClientNoty
+#if (TX_APP_WRITABLE_NOTIFICATION)
+#pragma HLS INTERFACE axis register both port=txAppWritable name=s_TxWritableNoty
+#pragma HLS DATA_PACK variable=txAppWritable
+#endif
 
 #pragma HLS DATA_PACK variable=listenPortRes
 #pragma HLS DATA_PACK variable=rxAppNotification
@@ -975,6 +1015,9 @@ void iperf2_client(
             closeConnection,
             txAppDataReqMeta,
             txAppDataReqStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+            txAppWritable,
+#endif
             txAppData_to_TOE,
             stopWatchStart,
             stopWatchStop,
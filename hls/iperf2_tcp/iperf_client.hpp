@@ -54,6 +54,9 @@ void iperf2_client(
                     stream<ap_uint<16> >&           closeConnection,
                     stream<appTxMeta>&              txAppDataReqMeta, 
                     stream<appTxRsp>&               txAppDataReqStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+                    stream<appTxWritable>&          txAppWritable,
+#endif
                     stream<axiWord>&                txAppData_to_TOE,
                     stream<txApp_client_status>&    txAppNewClientNoty, 
 
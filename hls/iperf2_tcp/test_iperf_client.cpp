@@ -34,12 +34,25 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ************************************************/
 
 #include "iperf_client.hpp"
+#include "../TOE/testbench/tx_app_model.hpp"
 #include <iostream>
+#include <iomanip>
 
 using namespace hls;
 
 unsigned int simCycleCounter=0;
 
+/*
+ * The client runs a timed experiment over 8 connections against txAppModel, whose
+ * window is smaller than what a connection sends while its ACKs are on the way. The
+ * test reports the bytes per cycle, the write requests and how many were refused.
+ */
+static const int NUM_CONNECTIONS	= 8;
+static const int PACKET_MSS			= 1460;
+static const int WINDOW 			= 4 * PACKET_MSS;
+static const int ACK_LATENCY 		= 3000;
+static const int RUN_CYCLES			= 200000;
+
 int main()
 {
     stream<ap_uint<16> > listenPortReq("listenPortReq");
@@ -54,29 +67,28 @@ int main()
     stream<appTxMeta> txMetaData("txMetaData");
     stream<axiWord> txData("txData");
     stream<appTxRsp> txStatus("txStatus");
+    stream<appTxWritable> txWritable("txWritable");
     stream<txApp_client_status> newClientNoty("newClientNoty");
 
     iperf_regs  settings_regs;
-
-    ap_uint<8> pkgWordCount;
+    txAppModel  toeTx(WINDOW, ACK_LATENCY);
 
     ap_uint<16> sessionID;
-    appTxMeta txMetaDataReq;
-    axiWord currWord;
+    ap_uint<16> nextSession = 0;
+    int closed = 0;
     int count = 0;
-    pkgWordCount = 8;
  
     settings_regs.dualModeEn    = 0;
-    settings_regs.useTimer      = 0; 
-    settings_regs.runTime       = 0;
-    settings_regs.transfer_size = 1000;
-    settings_regs.packet_mss    = 1460;
+    settings_regs.useTimer      = 1; 
+    settings_regs.runTime       = RUN_CYCLES;
+    settings_regs.transfer_size = 0;
+    settings_regs.packet_mss    = PACKET_MSS;
     settings_regs.ipDestination = 0x01010101;
     settings_regs.dstPort       = 5001;
 
-    while (count < 10000)
+    while (count < RUN_CYCLES + 50000)
     {
-        settings_regs.numConnections = 2;
+        settings_regs.numConnections = NUM_CONNECTIONS;
         settings_regs.runExperiment = 0;
         if (count == 20)
         {
@@ -93,6 +105,9 @@ int main()
                         closeConnection,
                         txMetaData,
                         txStatus,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+                        txWritable,
+#endif
                         txData,
                         newClientNoty,
                         // registers
@@ -101,30 +116,27 @@ int main()
 
         if (!openConnection.empty()) {
             openConnection.read();
-            std::cout << "Opening connection.. at cycle" << count << std::endl;
-            openConStatus.write(openStatus(123+count, true));
-        }
-        if (!txMetaData.empty()) {
-            txMetaData.read(txMetaDataReq);
-            std::cout << "New Pkg: " << std::dec << txMetaDataReq.sessionID << std::endl;
-            sessionID = txMetaDataReq.sessionID;
-        }
-        while (!txData.empty())
-        {
-            txData.read(currWord);
-            std::cout << std::hex << std::noshowbase;
-            std::cout << std::setfill('0');
-            std::cout << std::setw(8) << ((uint32_t) currWord.data(63, 32));
-            std::cout << std::setw(8) << ((uint32_t) currWord.data(31, 0));
-            std::cout << " " << std::setw(2) << ((uint32_t) currWord.keep) << " ";
-            std::cout << std::setw(1) << ((uint32_t) currWord.last) << std::endl;
+            toeTx.openSession(nextSession);
+            openConStatus.write(openStatus(nextSession, true));
+            nextSession++;
         }
+        toeTx.run(txMetaData, txData, txStatus, txWritable);
         if (!closeConnection.empty()) {
             closeConnection.read(sessionID);
-            std::cout << "Closing connection: " << std::dec << sessionID << std::endl;
+            closed++;
         }
         count++;
     }
+
+    std::cout << "iperf client, writable notification " << (TX_APP_WRITABLE_NOTIFICATION ? "on" : "off");
+    std::cout << ", wait for space " << (TX_APP_WAIT_FOR_SPACE ? "on" : "off") << std::endl;
+    std::cout << std::fixed << std::setprecision(3) << "bytes/cycle " << (double) toeTx.bytesAccepted / RUN_CYCLES;
+    std::cout << "  requests " << toeTx.requests << "  refused " << toeTx.refused;
+    std::cout << "  requests per write " << (double) toeTx.requests / (toeTx.requests - toeTx.refused) << std::endl;
+    if ((closed != NUM_CONNECTIONS) || (toeTx.bytesReceived != toeTx.bytesAccepted)) {
+        std::cout << "FAILED, " << closed << " connections closed, " << toeTx.bytesReceived << " of " << toeTx.bytesAccepted << " bytes received" << std::endl;
+        return 1;
+    }
+    std::cout << "PASSED" << std::endl;
     return 0;
 }
-
@@ -0,0 +1,513 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "memory_interleaver.hpp"
+
+/**
+ * @brief      Channel and channel address of a buffer address. The stripe bits
+ *             that select the channel are removed from the address. With
+ *             MEM_CHANNEL_HASH the higher bits, which stay in the channel address,
+ *             are folded into the channel, so the mapping is still one to one.
+ */
+void mi_map_address(
+			ap_uint<32>					addr,
+			ap_uint<MEM_CHANNEL_BITS>&	channel,
+			ap_uint<32>&				channelAddr) {
+#pragma HLS INLINE
+
+	channel 	= addr(MEM_STRIPE_BITS + MEM_CHANNEL_BITS - 1, MEM_STRIPE_BITS);
+#if (MEM_CHANNEL_HASH)
+	hash_fold: for (int b = MEM_STRIPE_BITS + MEM_CHANNEL_BITS; b < 32; b++){
+	#pragma HLS UNROLL
+		if (addr.bit(b))
+			channel.bit((b - MEM_STRIPE_BITS) % MEM_CHANNEL_BITS) = !channel.bit((b - MEM_STRIPE_BITS) % MEM_CHANNEL_BITS);
+	}
+#endif
+	channelAddr = 0;
+	channelAddr(31 - MEM_CHANNEL_BITS, MEM_STRIPE_BITS) = addr(31, MEM_STRIPE_BITS + MEM_CHANNEL_BITS);
+	channelAddr(MEM_STRIPE_BITS - 1, 0) = addr(MEM_STRIPE_BITS - 1, 0);
+}
+
+/**
+ * @brief      Concatenates the held bytes of the previous word with the current word.
+ *             The held bytes are at the bottom of resWord, low gets the first 64 bytes
+ *             and high the bytes of currWord that did not fit.
+ */
+void mi_join_words(
+			axiWord 		resWord,
+			ap_uint<7>		held,
+			axiWord 		currWord,
+			axiWord& 		low,
+			axiWord& 		high) {
+#pragma HLS INLINE
+
+	ap_uint<64> resMask = lowMask<64>(held);
+
+	low.data = elementShiftLeft<8,64>(currWord.data, held(5,0)) | (resWord.data & keep2mask<64>(resMask));
+	low.keep = elementShiftLeft<1,64>(currWord.keep, held(5,0)) | (resWord.keep & resMask);
+
+	if (held == 0){
+		high.data = 0;
+		high.keep = 0;
+	}
+	else {
+		high.data = elementFunnelRight<8,64>(0, currWord.data, 64 - held);
+		high.keep = elementFunnelRight<1,64>(0, currWord.keep, 64 - held);
+	}
+}
+
+/**
+ * @brief      Splits a read command at the stripe boundaries. Each piece goes to the
+ *             command stream of its channel, and the channel is recorded so the
+ *             data can be merged back in order.
+ */
+void mi_read_cmd_splitter(
+			stream<mmCmd>&			readCmdIn,
+			stream<mmCmd>			readCmdOut[MEM_CHANNELS],
+			stream<memOrder>&		readOrder) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static mmCmd 				cmd;
+	static ap_uint<32> 			addr;
+	static ap_uint<23> 			remaining;
+	static bool 				splitting = false;
+	
+	ap_uint<MEM_STRIPE_BITS+1>	stripe_left;
+	ap_uint<23> 				length;
+	ap_uint<MEM_CHANNEL_BITS>	channel;
+	ap_uint<32> 				channelAddr;
+	mmCmd 						pieceCmd;
+
+	if (!splitting && !readCmdIn.empty()){
+		readCmdIn.read(cmd);
+		addr 		= cmd.saddr;
+		remaining 	= cmd.bbt;
+		splitting 	= true;
+	}
+
+	if (splitting){
+		stripe_left = (1 << MEM_STRIPE_BITS) - addr(MEM_STRIPE_BITS - 1, 0);
+		length 		= (remaining > stripe_left) ? (ap_uint<23>) stripe_left : remaining;
+		mi_map_address(addr, channel, channelAddr);
+
+		pieceCmd 		= cmd;
+		pieceCmd.saddr 	= channelAddr;
+		pieceCmd.bbt 	= length;
+
+		read_cmd_out: for (int i = 0; i < MEM_CHANNELS; i++){
+		#pragma HLS UNROLL
+			if (i == channel.to_int())
+				readCmdOut[i].write(pieceCmd);
+		}
+		readOrder.write(memOrder(channel, length == remaining));
+
+		addr 		+= length;
+		remaining 	-= length;
+		if (remaining == 0)
+			splitting = false;
+	}
+}
+
+/**
+ * @brief      Merges the data of the read pieces in command order. Every piece comes
+ *             from its channel packed from byte 0, the bytes of a piece that do not
+ *             fill the last word are held and the next piece is appended to them. Only
+ *             the last word of the last piece is marked as last.
+ */
+void mi_read_data_merger(
+			stream<axiWord>			readDataIn[MEM_CHANNELS],
+			stream<memOrder>&		readOrder,
+			stream<axiWord>&		readDataOut) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static memOrder 	order;
+	static bool 		orderLoaded = false;
+	static axiWord 		resWord = axiWord(0, 0, 0);
+	static ap_uint<7> 	held = 0;
+	static bool 		flush = false;
+
+	axiWord 			currWord;
+	axiWord 			low;
+	axiWord 			high;
+	axiWord 			sendWord;
+	bool 				wordRead = false;
+	bool 				endCmd;
+	ap_uint<8> 			total;
+
+	if (flush){
+		sendWord.data = resWord.data;
+		sendWord.keep = lowMask<64>(held);
+		sendWord.last = 1;
+		readDataOut.write(sendWord);
+		held 	= 0;
+		flush 	= false;
+	}
+	else {
+		if (!orderLoaded && !readOrder.empty()){
+			readOrder.read(order);
+			orderLoaded = true;
+		}
+
+		if (orderLoaded){
+			read_data_in: for (int i = 0; i < MEM_CHANNELS; i++){
+			#pragma HLS UNROLL
+				if (i == order.channel.to_int() && !readDataIn[i].empty()){
+					readDataIn[i].read(currWord);
+					wordRead = true;
+				}
+			}
+		}
+
+		if (wordRead){
+			mi_join_words(resWord, held, currWord, low, high);
+			total 	= held + keep2len(currWord.keep);
+			endCmd 	= currWord.last && order.lastPiece;
+
+			if (total >= 64){
+				sendWord.data 	= low.data;
+				sendWord.keep 	= 0xFFFFFFFFFFFFFFFF;
+				sendWord.last 	= endCmd && (total == 64);
+				readDataOut.write(sendWord);
+				resWord 		= high;
+				held 			= total - 64;
+				flush 			= endCmd && (total != 64);
+			}
+			else if (endCmd){
+				sendWord.data 	= low.data;
+				sendWord.keep 	= lowMask<64>(total);
+				sendWord.last 	= 1;
+				readDataOut.write(sendWord);
+				held 			= 0;
+			}
+			else {
+				resWord 		= low;
+				held 			= total;
+			}
+
+			if (currWord.last)
+				orderLoaded = false;
+		}
+	}
+}
+
+/**
+ * @brief      Splits a write command at the stripe boundaries. Each piece goes to the
+ *             command stream of its channel, its length to the data splitter and its
+ *             channel to the status merger.
+ */
+void mi_write_cmd_splitter(
+			stream<mmCmd>&			writeCmdIn,
+			stream<mmCmd>			writeCmdOut[MEM_CHANNELS],
+			stream<memPiece>&		writePieces,
+			stream<memOrder>&		writeOrder) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static mmCmd 				cmd;
+	static ap_uint<32> 			addr;
+	static ap_uint<23> 			remaining;
+	static bool 				splitting = false;
+	
+	ap_uint<MEM_STRIPE_BITS+1>	stripe_left;
+	ap_uint<23> 				length;
+	ap_uint<MEM_CHANNEL_BITS>	channel;
+	ap_uint<32> 				channelAddr;
+	mmCmd 						pieceCmd;
+
+	if (!splitting && !writeCmdIn.empty()){
+		writeCmdIn.read(cmd);
+		addr 		= cmd.saddr;
+		remaining 	= cmd.bbt;
+		splitting 	= true;
+	}
+
+	if (splitting){
+		stripe_left = (1 << MEM_STRIPE_BITS) - addr(MEM_STRIPE_BITS - 1, 0);
+		length 		= (remaining > stripe_left) ? (ap_uint<23>) stripe_left : remaining;
+		mi_map_address(addr, channel, channelAddr);
+
+		pieceCmd 		= cmd;
+		pieceCmd.saddr 	= channelAddr;
+		pieceCmd.bbt 	= length;
+
+		write_cmd_out: for (int i = 0; i < MEM_CHANNELS; i++){
+		#pragma HLS UNROLL
+			if (i == channel.to_int())
+				writeCmdOut[i].write(pieceCmd);
+		}
+		writePieces.write(memPiece(channel, length, length == remaining));
+		writeOrder.write(memOrder(channel, length == remaining));
+
+		addr 		+= length;
+		remaining 	-= length;
+		if (remaining == 0)
+			splitting = false;
+	}
+}
+
+/**
+ * @brief      Cuts the write data in pieces and sends each one to its channel packed
+ *             from byte 0. The bytes of an input word that belong to the next piece
+ *             are held and the following words are appended to them.
+ */
+void mi_write_data_splitter(
+			stream<axiWord>&		writeDataIn,
+			stream<memPiece>&		writePieces,
+			stream<axiWord>			writeDataOut[MEM_CHANNELS]) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static memPiece 	piece;
+	static bool 		pieceLoaded = false;
+	static ap_uint<23> 	remaining;
+	static axiWord 		resWord = axiWord(0, 0, 0);
+	static ap_uint<7> 	held = 0;
+
+	axiWord 			currWord;
+	axiWord 			low;
+	axiWord 			high;
+	axiWord 			sendWord;
+	ap_uint<7> 			need;
+	ap_uint<8> 			total;
+	bool 				wordReady = false;
+
+	if (!pieceLoaded && !writePieces.empty()){
+		writePieces.read(piece);
+		remaining 	= piece.length;
+		pieceLoaded = true;
+	}
+
+	if (pieceLoaded){
+		need = (remaining > 64) ? (ap_uint<7>) 64 : (ap_uint<7>) remaining;
+
+		if (held >= need){ 										// The held bytes complete the piece
+			sendWord.data 	= resWord.data;
+			sendWord.keep 	= lowMask<64>(need);
+			resWord.data 	= elementFunnelRight<8,64>(0, resWord.data, need(5,0));
+			resWord.keep 	= elementFunnelRight<1,64>(0, resWord.keep, need(5,0));
+			held 			-= need;
+			wordReady 		= true;
+		}
+		else if (!writeDataIn.empty()){
+			writeDataIn.read(currWord);
+			mi_join_words(resWord, held, currWord, low, high);
+			total 			= held + keep2len(currWord.keep);
+
+			sendWord.data 	= low.data;
+			sendWord.keep 	= low.keep & lowMask<64>(need);
+			if (need == 64){
+				resWord 	= high;
+			}
+			else {
+				resWord.data = elementFunnelRight<8,64>(high.data, low.data, need(5,0));
+				resWord.keep = elementFunnelRight<1,64>(high.keep, low.keep, need(5,0));
+			}
+			held 			= (total > need) ? (ap_uint<7>) (total - need) : (ap_uint<7>) 0;
+			wordReady 		= true;
+		}
+
+		if (wordReady){
+			sendWord.last = (need == remaining);
+			write_data_out: for (int i = 0; i < MEM_CHANNELS; i++){
+			#pragma HLS UNROLL
+				if (i == piece.channel.to_int())
+					writeDataOut[i].write(sendWord);
+			}
+			remaining -= need;
+			if (remaining == 0)
+				pieceLoaded = false;
+		}
+	}
+}
+
+/**
+ * @brief      Collects the status of every piece of a write command and returns a 
+ *             single status per command. The command is okay only if all its pieces 
+ *             are, the error flags of the pieces are combined.
+ */
+void mi_write_status_merger(
+			stream<mmStatus>		writeStatusIn[MEM_CHANNELS],
+			stream<memOrder>&		writeOrder,
+			stream<mmStatus>&		writeStatusOut) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static memOrder 	order;
+	static bool 		orderLoaded = false;
+	static mmStatus 	cmdStatus;
+	static bool 		firstPiece = true;
+
+	mmStatus 			status;
+	bool 				statusRead = false;
+
+	if (!orderLoaded && !writeOrder.empty()){
+		writeOrder.read(order);
+		orderLoaded = true;
+	}
+
+	if (orderLoaded){
+		read_status_in: for (int i = 0; i < MEM_CHANNELS; i++){
+		#pragma HLS UNROLL
+			if (i == order.channel.to_int() && !writeStatusIn[i].empty()){
+				writeStatusIn[i].read(status);
+				statusRead = true;
+			}
+		}
+	}
+
+	if (statusRead){
+		if (firstPiece){
+			cmdStatus = status;
+		}
+		else {
+			cmdStatus.interr 	= cmdStatus.interr | status.interr;
+			cmdStatus.decerr 	= cmdStatus.decerr | status.decerr;
+			cmdStatus.slverr 	= cmdStatus.slverr | status.slverr;
+			cmdStatus.okay 		= cmdStatus.okay & status.okay;
+		}
+
+		if (order.lastPiece){
+			writeStatusOut.write(cmdStatus);
+			firstPiece = true;
+		}
+		else {
+			firstPiece = false;
+		}
+		orderLoaded = false;
+	}
+}
+
+/**
+ * @brief      Stripes a TOE buffer across MEM_CHANNELS memory channels, e.g. HBM 
+ *             pseudo-channels. Consecutive 2^MEM_STRIPE_BITS byte stripes of the
+ *             address space go to consecutive channels, so a single session uses
+ *             the bandwidth of all of them. A command that crosses a stripe boundary
+ *             is split, and the read data and write status are returned in command
+ *             order as if there was a single data mover.
+ *             One instance is needed for the TX buffer and another for the RX buffer.
+ *             The channel address does not include the channel bits, the base address
+ *             of each channel is given by the AXI interconnect.
+ *
+ * @param      readCmdIn       Read commands from the TOE
+ * @param      readDataOut     Read data to the TOE
+ * @param      writeCmdIn      Write commands from the TOE
+ * @param      writeDataIn     Write data from the TOE
+ * @param      writeStatusOut  Write status to the TOE
+ * @param      readCmdOut      Read commands to each channel data mover
+ * @param      readDataIn      Read data from each channel data mover
+ * @param      writeCmdOut     Write commands to each channel data mover
+ * @param      writeDataOut    Write data to each channel data mover
+ * @param      writeStatusIn   Write status from each channel data mover
+ */
+void memory_interleaver(
+					stream<mmCmd>&			readCmdIn,
+					stream<axiWord>&		readDataOut,
+					stream<mmCmd>&			writeCmdIn,
+					stream<axiWord>&		writeDataIn,
+					stream<mmStatus>&		writeStatusOut,
+
+					stream<mmCmd>			readCmdOut[MEM_CHANNELS],
+					stream<axiWord>			readDataIn[MEM_CHANNELS],
+					stream<mmCmd>			writeCmdOut[MEM_CHANNELS],
+					stream<axiWord>			writeDataOut[MEM_CHANNELS],
+					stream<mmStatus>		writeStatusIn[MEM_CHANNELS]) {
+
+#pragma HLS INTERFACE ap_ctrl_none port=return
+#pragma HLS DATAFLOW
+
+#pragma HLS INTERFACE axis register both port=readCmdIn name=s_axis_read_cmd
+#pragma HLS INTERFACE axis register both port=readDataOut name=m_axis_read_data
+#pragma HLS INTERFACE axis register both port=writeCmdIn name=s_axis_write_cmd
+#pragma HLS INTERFACE axis register both port=writeDataIn name=s_axis_write_data
+#pragma HLS INTERFACE axis register both port=writeStatusOut name=m_axis_write_sts
+
+#pragma HLS INTERFACE axis register both port=readCmdOut name=m_axis_ch_read_cmd
+#pragma HLS INTERFACE axis register both port=readDataIn name=s_axis_ch_read_data
+#pragma HLS INTERFACE axis register both port=writeCmdOut name=m_axis_ch_write_cmd
+#pragma HLS INTERFACE axis register both port=writeDataOut name=m_axis_ch_write_data
+#pragma HLS INTERFACE axis register both port=writeStatusIn name=s_axis_ch_write_sts
+
+#pragma HLS DATA_PACK variable=readCmdIn
+#pragma HLS DATA_PACK variable=writeCmdIn
+#pragma HLS DATA_PACK variable=writeStatusOut
+#pragma HLS DATA_PACK variable=readCmdOut
+#pragma HLS DATA_PACK variable=writeCmdOut
+#pragma HLS DATA_PACK variable=writeStatusIn
+
+	static stream<memOrder>		readOrder("readOrder");
+	#pragma HLS STREAM variable=readOrder depth=64
+	#pragma HLS DATA_PACK variable=readOrder
+
+	static stream<memPiece>		writePieces("writePieces");
+	#pragma HLS STREAM variable=writePieces depth=16
+	#pragma HLS DATA_PACK variable=writePieces
+
+	static stream<memOrder>		writeOrder("writeOrder");
+	#pragma HLS STREAM variable=writeOrder depth=64
+	#pragma HLS DATA_PACK variable=writeOrder
+
+	mi_read_cmd_splitter(
+			readCmdIn,
+			readCmdOut,
+			readOrder);
+
+	mi_read_data_merger(
+			readDataIn,
+			readOrder,
+			readDataOut);
+
+	mi_write_cmd_splitter(
+			writeCmdIn,
+			writeCmdOut,
+			writePieces,
+			writeOrder);
+
+	mi_write_data_splitter(
+			writeDataIn,
+			writePieces,
+			writeDataOut);
+
+	mi_write_status_merger(
+			writeStatusIn,
+			writeOrder,
+			writeStatusOut);
+}
@@ -0,0 +1,98 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _MEMORY_INTERLEAVER_HPP_
+#define _MEMORY_INTERLEAVER_HPP_
+
+#include "../TOE/toe.hpp"
+#include "../TOE/common_utilities/common_utilities.hpp"
+
+using namespace hls;
+
+// Number of memory channels the buffer is striped across, it has to be a power of two
+#define MEM_CHANNELS 4
+static const uint8_t MEM_CHANNEL_BITS = 2;
+
+// Consecutive stripes of 2^MEM_STRIPE_BITS bytes go to different channels
+// With MEM_STRIPE_BITS=WINDOW_BITS each session buffer lives in a single channel
+static const uint8_t MEM_STRIPE_BITS = 12;
+
+// MEM_CHANNEL_HASH flag, the channel of a stripe is its stripe index XORed with the higher
+// address bits folded to MEM_CHANNEL_BITS. Consecutive stripes still go to different channels,
+// but the session buffers, which all start at the same offset, do not all start in channel 0.
+// With MEM_STRIPE_BITS=WINDOW_BITS the channel of a session is a hash of its session ID,
+// without it the low bits of the session ID
+#define MEM_CHANNEL_HASH 1
+
+/**
+ * Part of a memory command that falls in a single channel. The pieces of a command
+ * are issued in address order, lastPiece marks the final one.
+ */
+struct memPiece
+{
+	ap_uint<MEM_CHANNEL_BITS>	channel;
+	ap_uint<23>					length;
+	bool						lastPiece;
+	memPiece() {}
+	memPiece(ap_uint<MEM_CHANNEL_BITS> channel, ap_uint<23> length, bool lastPiece)
+			:channel(channel), length(length), lastPiece(lastPiece) {}
+};
+
+/**
+ * Channel the piece of a command goes to
+ */
+struct memOrder
+{
+	ap_uint<MEM_CHANNEL_BITS>	channel;
+	bool						lastPiece;
+	memOrder() {}
+	memOrder(ap_uint<MEM_CHANNEL_BITS> channel, bool lastPiece)
+			:channel(channel), lastPiece(lastPiece) {}
+};
+
+void memory_interleaver(
+					stream<mmCmd>&			readCmdIn,
+					stream<axiWord>&		readDataOut,
+					stream<mmCmd>&			writeCmdIn,
+					stream<axiWord>&		writeDataIn,
+					stream<mmStatus>&		writeStatusOut,
+
+					stream<mmCmd>			readCmdOut[MEM_CHANNELS],
+					stream<axiWord>			readDataIn[MEM_CHANNELS],
+					stream<mmCmd>			writeCmdOut[MEM_CHANNELS],
+					stream<axiWord>			writeDataOut[MEM_CHANNELS],
+					stream<mmStatus>		writeStatusIn[MEM_CHANNELS]);
+
+#endif
@@ -0,0 +1,391 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#include "memory_interleaver.hpp"
+#include "../TOE/testbench/dummy_memory.hpp"
+#include <vector>
+#include <deque>
+#include <cstdlib>
+
+/*
+ * Memory channel model on top of dummyMemory. The channel moves at most
+ * bytesPerCycle on average, shared between reads and writes, and the read
+ * data of a command starts latency cycles after the command is accepted.
+ */
+class memChannel {
+public:
+	memChannel(double bytesPerCycle, int latency)
+		:bytesPerCycle(bytesPerCycle), latency(latency), credit(0), cycle(0), reading(false), writing(false), reads(0) {}
+
+	int readCommands() const { return reads; }
+
+	void step(	stream<mmCmd>& 		readCmd,
+				stream<axiWord>& 	readData,
+				stream<mmCmd>& 		writeCmd,
+				stream<axiWord>& 	writeData,
+				stream<mmStatus>& 	writeStatus) {
+		mmCmd 		cmd;
+		axiWord 	word;
+		mmStatus 	status;
+
+		cycle++;
+		credit += bytesPerCycle;
+		if (credit > 128)
+			credit = 128;
+
+		if (!readCmd.empty()){
+			readQueue.push_back(std::make_pair(readCmd.read(), cycle + latency));
+			reads++;
+		}
+		if (!writing && !writeCmd.empty()){
+			memory.setWriteCmd(writeCmd.read());
+			writing = true;
+		}
+		if (!reading && !readQueue.empty() && readQueue.front().second <= cycle){
+			memory.setReadCmd(readQueue.front().first);
+			readQueue.pop_front();
+			reading = true;
+		}
+
+		if (credit < 64)
+			return;
+
+		if (writing && !writeData.empty()){
+			writeData.read(word);
+			memory.writeWord(word);
+			credit -= 64;
+			if (word.last){
+				status.tag 		= 0;
+				status.interr 	= 0;
+				status.decerr 	= 0;
+				status.slverr 	= 0;
+				status.okay 	= 1;
+				writeStatus.write(status);
+				writing = false;
+			}
+		}
+		else if (reading){
+			memory.readWord(word);
+			readData.write(word);
+			credit -= 64;
+			if (word.last)
+				reading = false;
+		}
+	}
+
+private:
+	dummyMemory 	memory;
+	double 			bytesPerCycle;
+	int 			latency;
+	double 			credit;
+	uint64_t 		cycle;
+	bool 			reading;
+	bool 			writing;
+	int 			reads;
+	std::deque<std::pair<mmCmd, uint64_t> > readQueue;
+};
+
+struct memSystem {
+	stream<mmCmd>		readCmd;
+	stream<axiWord>		readData;
+	stream<mmCmd>		writeCmd;
+	stream<axiWord>		writeData;
+	stream<mmStatus>	writeStatus;
+
+	stream<mmCmd>		chReadCmd[MEM_CHANNELS];
+	stream<axiWord>		chReadData[MEM_CHANNELS];
+	stream<mmCmd>		chWriteCmd[MEM_CHANNELS];
+	stream<axiWord>		chWriteData[MEM_CHANNELS];
+	stream<mmStatus>	chWriteStatus[MEM_CHANNELS];
+
+	std::vector<memChannel> channels;
+
+	memSystem(double bytesPerCycle, int latency) {
+		for (int i = 0; i < MEM_CHANNELS; i++)
+			channels.push_back(memChannel(bytesPerCycle, latency + 13 * i));	// Different latencies to mix up the arrival order
+	}
+
+	void step() {
+		memory_interleaver(readCmd, readData, writeCmd, writeData, writeStatus,
+				chReadCmd, chReadData, chWriteCmd, chWriteData, chWriteStatus);
+		for (int i = 0; i < MEM_CHANNELS; i++)
+			channels[i].step(chReadCmd[i], chReadData[i], chWriteCmd[i], chWriteData[i], chWriteStatus[i]);
+	}
+};
+
+std::vector<axiWord> bytes2words(std::vector<uint8_t>& bytes) {
+	std::vector<axiWord> words;
+	for (size_t offset = 0; offset < bytes.size(); offset += 64) {
+		axiWord word(0, 0, 0);
+		for (int b = 0; b < 64 && offset + b < bytes.size(); b++) {
+			word.data(b*8+7, b*8) = bytes[offset + b];
+			word.keep.bit(b) = 1;
+		}
+		word.last = (offset + 64 >= bytes.size());
+		words.push_back(word);
+	}
+	return words;
+}
+
+/*
+ * Random writes and reads through the interleaver, checked against a single
+ * dummyMemory. Commands stay inside a session buffer, as the TOE ones do, but
+ * start and end anywhere, so they cross one or several stripe boundaries.
+ */
+int functional_test() {
+
+	memSystem 					mem(64, 20);
+	dummyMemory 				reference;
+	int 						errors = 0;
+	int 						reads = 0;
+	int 						writes = 0;
+	int 						statuses = 0;
+
+	srand(7);
+	for (int round = 0; round < 300; round++) {
+		bool 					isWrite = (round < 40) || (rand() % 2);
+		ap_uint<32> 			session = rand() % 4;
+		ap_uint<WINDOW_BITS> 	offset = rand() % BUFFER_SIZE;
+		int 					length = 1 + rand() % 20000;
+		if (round < 40){ 										// Fill the buffers first
+			offset = (round % 10) * (BUFFER_SIZE / 10);
+			session = round / 10;
+			length = BUFFER_SIZE / 10 + 1;
+		}
+		if (offset + length > BUFFER_SIZE)
+			length = BUFFER_SIZE - offset;
+		mmCmd cmd((session << WINDOW_BITS) + offset, length);
+
+		if (isWrite) {
+			std::vector<uint8_t> bytes(length);
+			for (int i = 0; i < length; i++)
+				bytes[i] = rand();
+			std::vector<axiWord> words = bytes2words(bytes);
+
+			reference.setWriteCmd(cmd);
+			for (size_t i = 0; i < words.size(); i++)
+				reference.writeWord(words[i]);
+
+			mem.writeCmd.write(cmd);
+			size_t sent = 0;
+			int cycles = 0;
+			while (mem.writeStatus.empty() && cycles < 100000) {
+				if (sent < words.size())
+					mem.writeData.write(words[sent++]);
+				mem.step();
+				cycles++;
+			}
+			if (mem.writeStatus.empty()) {
+				std::cout << "Write " << round << " got no status" << std::endl;
+				errors++;
+			}
+			else {
+				statuses++;
+				if (mem.writeStatus.read().okay != 1)
+					errors++;
+			}
+			writes++;
+		}
+		else { 													// Several reads in flight, each channel answers at its own pace
+			std::vector<axiWord> expected;
+			axiWord word;
+			int inFlight = 1 + rand() % 4;
+			for (int r = 0; r < inFlight; r++) {
+				if (r > 0) {
+					offset = rand() % BUFFER_SIZE;
+					length = 1 + rand() % 20000;
+					if (offset + length > BUFFER_SIZE)
+						length = BUFFER_SIZE - offset;
+					cmd = mmCmd((session << WINDOW_BITS) + offset, length);
+				}
+				reference.setReadCmd(cmd);
+				do {
+					reference.readWord(word);
+					expected.push_back(word);
+				} while (!word.last);
+				mem.readCmd.write(cmd);
+			}
+
+			size_t received = 0;
+			int cycles = 0;
+			while (received < expected.size() && cycles < 100000) {
+				mem.step();
+				while (!mem.readData.empty()) {
+					mem.readData.read(word);
+					if (received >= expected.size() || word.data != expected[received].data ||
+							word.keep != expected[received].keep || word.last != expected[received].last) {
+						if (errors < 10)
+							std::cout << "Read " << round << " word " << received << " differs" << std::endl;
+						errors++;
+					}
+					received++;
+				}
+				cycles++;
+			}
+			if (received != expected.size()) {
+				std::cout << "Read " << round << " got " << received << " words, expected " << expected.size() << std::endl;
+				errors++;
+			}
+			reads += inFlight;
+		}
+	}
+	for (int i = 0; i < 1000; i++)
+		mem.step();
+	if (!mem.readData.empty() || !mem.writeStatus.empty()) {
+		std::cout << "Data left after the last command" << std::endl;
+		errors++;
+	}
+
+	std::cout << "Functional: " << writes << " writes (" << statuses << " status), " << reads << " reads, " << errors << " errors" << std::endl;
+	return errors;
+}
+
+/*
+ * TX buffer traffic at 100G: the application writes segments that are read
+ * back for transmission. Without the interleaver every command goes to the
+ * same channel. Both directions offer one word per cycle.
+ */
+double bandwidth_run(bool interleaved, double bytesPerCycle, int segments) {
+
+	memSystem 		mem(bytesPerCycle, 60);
+	memChannel 		single(bytesPerCycle, 60);
+	const int 		segmentLength = 4096;
+	int 			writeCmds = 0, readCmds = 0;
+	int 			writeWords = 0, readWords = 0;
+	int 			statuses = 0;
+	uint64_t 		cycles = 0;
+	axiWord 		word(0, 0xFFFFFFFFFFFFFFFF, 0);
+
+	stream<mmCmd>		&readCmd 	= interleaved ? mem.readCmd : mem.chReadCmd[0];
+	stream<axiWord>		&readData 	= interleaved ? mem.readData : mem.chReadData[0];
+	stream<mmCmd>		&writeCmd 	= interleaved ? mem.writeCmd : mem.chWriteCmd[0];
+	stream<axiWord>		&writeData 	= interleaved ? mem.writeData : mem.chWriteData[0];
+	stream<mmStatus>	&writeStatus= interleaved ? mem.writeStatus : mem.chWriteStatus[0];
+
+	while ((statuses < segments || readWords < segments * segmentLength / 64) && cycles < 10000000) {
+		if (writeCmds < segments && writeCmds - statuses < 8) {
+			writeCmd.write(mmCmd(writeCmds * segmentLength, segmentLength));
+			writeCmds++;
+		}
+		if (writeWords < writeCmds * segmentLength / 64 && writeData.size() < 4) {
+			word.last = ((writeWords + 1) % (segmentLength / 64)) == 0;
+			writeData.write(word);
+			writeWords++;
+		}
+		if (readCmds < statuses && readCmds * segmentLength / 64 - readWords < 256) {	// Read what has already been written
+			readCmd.write(mmCmd(readCmds * segmentLength, segmentLength));
+			readCmds++;
+		}
+
+		if (interleaved)
+			mem.step();
+		else
+			single.step(readCmd, readData, writeCmd, writeData, writeStatus);
+		cycles++;
+
+		if (!readData.empty()) {
+			readData.read();
+			readWords++;
+		}
+		if (!writeStatus.empty()) {
+			writeStatus.read();
+			statuses++;
+		}
+	}
+	// bytes written plus bytes read, in GB/s
+	return (2.0 * segments * segmentLength) / (cycles * CLOCK_PERIOD * 1000);
+}
+
+int bandwidth_test() {
+	const double 	channelGBps = 14;
+	double 			bytesPerCycle = channelGBps * CLOCK_PERIOD * 1000;
+	double 			single = bandwidth_run(false, bytesPerCycle, 512);
+	double 			interleaved = bandwidth_run(true, bytesPerCycle, 512);
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Bandwidth: one channel " << single << " GB/s, " << MEM_CHANNELS << " channels " << interleaved << " GB/s";
+	std::cout << " (channel " << channelGBps << " GB/s, " << (ETH_INTERFACE_WIDTH/8) / (CLOCK_PERIOD * 1000) << " GB/s per stream)" << std::endl;
+
+	if (MEM_CHANNELS > 1 && interleaved < 1.5 * single) {
+		std::cout << "The interleaver does not scale" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * The first stripe of every session buffer must not always be in the same channel.
+ * With MEM_CHANNEL_HASH consecutive sessions are spread evenly across the channels.
+ */
+int session_spread_test() {
+	memSystem 		mem(64, 10);
+	int 			sessions = 4 * MEM_CHANNELS;
+	int 			perChannel[MEM_CHANNELS] = {0};
+	int 			errors = 0;
+	ap_uint<32> 	addr;
+	axiWord 		word;
+
+	for (int s = 0; s < sessions; s++) {
+		addr = 0;
+		addr(30, WINDOW_BITS) = s;
+		mem.readCmd.write(mmCmd(addr, 64));
+	}
+	for (int c = 0; c < 4 * sessions; c++)
+		mem.step();
+	while (!mem.readData.empty())
+		mem.readData.read(word);
+
+	for (int i = 0; i < MEM_CHANNELS; i++) {
+		perChannel[i] = mem.channels[i].readCommands();
+		if (perChannel[i] != (MEM_CHANNEL_HASH ? sessions / MEM_CHANNELS : (i == 0 ? sessions : 0)))
+			errors++;
+	}
+	std::cout << "Session spread: first stripe of " << sessions << " sessions per channel";
+	for (int i = 0; i < MEM_CHANNELS; i++)
+		std::cout << " " << perChannel[i];
+	std::cout << (errors ? ", wrong" : "") << std::endl;
+	return errors;
+}
+
+int main(int argc, char **argv) {
+
+	int errors = 0;
+
+	errors += functional_test();
+	errors += bandwidth_test();
+	errors += session_spread_test();
+
+	return errors;
+}
@@ -44,31 +44,61 @@ ap_uint<16> byteSwap16(ap_uint<16> inputVector) {
 
 /**
  * @brief      Shave off the Ethernet when is needed. (IPv4) packets
+ *             For 802.1Q tagged frames the header is 18 bytes instead of 14.
+ *             Tagged ARP frames only get the tag removed, so the ARP server
+ *             always sees an untagged frame.
  *
- * @param      dataIn   The data in
- * @param      dataOut  The data out
+ * @param      dataIn      The data in
+ * @param      vlanTagged  One flag per packet, the packet carries an 802.1Q tag
+ * @param      dataOut     The data out
  */
 void ethernet_remover (			
 			stream<axiWordOut>&			dataIn,
+			stream<ap_uint<1> >&		vlanTagged,
 			stream<axiWordOut>&			dataOut) {
 
 #pragma HLS PIPELINE II=1
 
-	enum er_states {FIRST_WORD , FWD , REMOVING, EXTRA};
+	enum er_states {FIRST_WORD , FWD , REMOVING, EXTRA, DISCARD};
 	static er_states er_fsm_state = FIRST_WORD;
 
 	axiWordOut 			currWord;
 	axiWordOut 			sendWord;
 	static axiWordOut 	prevWord;
+	static ap_uint<1>	tagged_r;
+	ap_uint<1>			tagged;
 
 	switch (er_fsm_state){
 		case FIRST_WORD:
-			if (!dataIn.empty()){
+			if (!dataIn.empty() && !vlanTagged.empty()){
 				dataIn.read(currWord);
+				vlanTagged.read(tagged);
 				
 				if (currWord.dest == 0){			// ARP packets must remain intact
-					sendWord = currWord;
-					er_fsm_state 	= FWD;
+					if (tagged){					// Remove only the tag. ARP payload always fits in the first word
+						sendWord.data( 95,  0) 	=  currWord.data( 95,  0);
+						sendWord.keep( 11,  0) 	=  currWord.keep( 11,  0);
+						sendWord.data(479, 96) 	=  currWord.data(511,128);
+						sendWord.keep( 59, 12) 	=  currWord.keep( 63, 16);
+						sendWord.data(511,480) 	=  0;
+						sendWord.keep( 63, 60) 	=  0;
+						sendWord.dest 			=  currWord.dest;
+						sendWord.last 			=  1;
+						er_fsm_state 	= DISCARD;
+					}
+					else {
+						sendWord = currWord;
+						er_fsm_state 	= FWD;
+					}
+				}
+				else if (tagged){					// No ARP packet, Re arrange the order in the output word, 18-byte header
+					sendWord.data(511,368) 	=  0;
+					sendWord.keep( 63, 46) 	=  0;
+					sendWord.data(367,  0) 	=  currWord.data (511,144);
+					sendWord.keep( 45,  0) 	=  currWord.keep ( 63, 18);
+					sendWord.dest 			=  currWord.dest;
+					sendWord.last 			=  1;
+					er_fsm_state 	= REMOVING;
 				}
 				else{								// No ARP packet, Re arrange the order in the output word
 					sendWord.data(511,400) 	=  0;
@@ -89,6 +119,7 @@ void ethernet_remover (
 				}
 
 				prevWord = currWord;
+				tagged_r = tagged;
 			}
 			break;
 		case FWD:
@@ -104,14 +135,22 @@ void ethernet_remover (
 			if (!dataIn.empty()){
 				dataIn.read(currWord);
 
-				sendWord.data(399,  0) 	=  prevWord.data(511,112);
-				sendWord.keep( 49,  0) 	=  prevWord.keep( 63, 14);
-				sendWord.data(511,400) 	=  currWord.data(111,  0);
-				sendWord.keep( 63, 50) 	=  currWord.keep( 13,  0);
+				if (tagged_r){
+					sendWord.data(367,  0) 	=  prevWord.data(511,144);
+					sendWord.keep( 45,  0) 	=  prevWord.keep( 63, 18);
+					sendWord.data(511,368) 	=  currWord.data(143,  0);
+					sendWord.keep( 63, 46) 	=  currWord.keep( 17,  0);
+				}
+				else {
+					sendWord.data(399,  0) 	=  prevWord.data(511,112);
+					sendWord.keep( 49,  0) 	=  prevWord.keep( 63, 14);
+					sendWord.data(511,400) 	=  currWord.data(111,  0);
+					sendWord.keep( 63, 50) 	=  currWord.keep( 13,  0);
+				}
 				sendWord.dest 			=  prevWord.dest;
 
 				if (currWord.last){
-					if (currWord.keep.bit(14)){							// When the input packet ends we have to check if all the input data
+					if ((!tagged_r && currWord.keep.bit(14)) || (tagged_r && currWord.keep.bit(18))){	// When the input packet ends we have to check if all the input data
 						er_fsm_state = EXTRA;							// was sent, if not an extra transaction is needed, but for the current
 						sendWord.last 			=  0;					// transaction tlast must be 0
 					}
@@ -129,15 +168,31 @@ void ethernet_remover (
 			}
 			break;
 		case EXTRA:
-			sendWord.data(511,400) 	=  0;								// Send the remaining piece of information
-			sendWord.keep( 63, 50) 	=  0;
-			sendWord.data(399,  0) 	=  prevWord.data(511,112);
-			sendWord.keep( 49,  0) 	=  prevWord.keep( 63, 14);
+			if (tagged_r){
+				sendWord.data(511,368) 	=  0;							// Send the remaining piece of information
+				sendWord.keep( 63, 46) 	=  0;
+				sendWord.data(367,  0) 	=  prevWord.data(511,144);
+				sendWord.keep( 45,  0) 	=  prevWord.keep( 63, 18);
+			}
+			else {
+				sendWord.data(511,400) 	=  0;							// Send the remaining piece of information
+				sendWord.keep( 63, 50) 	=  0;
+				sendWord.data(399,  0) 	=  prevWord.data(511,112);
+				sendWord.keep( 49,  0) 	=  prevWord.keep( 63, 14);
+			}
 			sendWord.dest 			=  prevWord.dest;
 			sendWord.last 			=  1;
 			dataOut.write(sendWord);
 			er_fsm_state = FIRST_WORD;
 			break;
+		case DISCARD:							// Padding of a tagged ARP frame, it was already sent
+			if (!dataIn.empty()){
+				dataIn.read(currWord);
+				if (currWord.last){
+					er_fsm_state = FIRST_WORD;
+				}
+			}
+			break;
 	}
 
 }
@@ -154,13 +209,24 @@ void ethernet_remover (
  *                   : 1 ICMP
  *                   : 2 TCP
  *                   : 3 UDP  
+ *             802.1Q tagged frames are accepted if the VLAN ID belongs to a 
+ *             valid entry of the VLAN table and, for IPv4, if the destination
+ *             IP address is the one of that VLAN interface.
  *
- * @param      dataIn   The data in
- * @param      dataOut  The data out
+ * @param      dataIn      The data in
+ * @param      dataOut     The data out
+ * @param      vlanTagged  One flag per forwarded packet, the packet carries an 802.1Q tag
+ * @param      dropReportOut  Reason of every dropped packet
+ * @param      vlanTable   VLAN interfaces
  */
 void packet_identification(
 			stream<axiWordIn>&			dataIn,
-			stream<axiWordOut>&			dataOut) {
+			stream<axiWordOut>&			dataOut,
+			stream<ap_uint<1> >&		vlanTagged,
+#if (DROP_REPORTS)
+			stream<dropReport>&			dropReportOut,
+#endif
+			vlanInterface				vlanTable[NUM_VLAN_INTERFACES]) {
 
 
 #pragma HLS PIPELINE II=1
@@ -169,26 +235,58 @@ void packet_identification(
 	enum pi_states {FIRST_WORD , FWD ,DROP};
 	static pi_states pi_fsm_state = FIRST_WORD;
 	static dest_type tdest_r;
+#if (DROP_REPORTS)
+	static ap_uint<16> pi_lostReports = 0;
+#endif
 	
 	dest_type tdest;
 	axiWordIn 	currWord;
 	axiWordOut 	sendWord;
 	ap_uint<16>	ethernetType;
+	ap_uint<12>	vlanID;
+	ap_uint<32>	ipDestination;
 	ap_uint<4>	ipVersion;
 	ap_uint<8>	ipProtocol;
-	bool		forward = true;
+	bool		tagged;
+	bool		vlanHit = false;
+	bool		vlanIpHit = false;
+	dropReason	drop = DROP_NONE;
 
 	switch (pi_fsm_state) {
 		case FIRST_WORD :
 			if (!dataIn.empty()){
 				dataIn.read(currWord);
-				ethernetType = byteSwap16(currWord.data(111,96));		// Get Ethernet type
-				ipVersion    = currWord.data(119,116);					// Get IPv4
-				ipProtocol   = currWord.data(191,184);					// Get protocol for IPv4 packets
+				tagged = (byteSwap16(currWord.data(111,96)) == TYPE_VLAN);
+				vlanID = byteSwap16(currWord.data(127,112))(11,0);			// Get VLAN ID from the tag control information
+
+				if (tagged){												// Everything after the tag is shifted 4 bytes
+					ethernetType  = byteSwap16(currWord.data(143,128));
+					ipVersion     = currWord.data(151,148);
+					ipProtocol    = currWord.data(223,216);
+					ipDestination = currWord.data(303,272);
+				}
+				else {
+					ethernetType  = byteSwap16(currWord.data(111,96));		// Get Ethernet type
+					ipVersion     = currWord.data(119,116);					// Get IPv4
+					ipProtocol    = currWord.data(191,184);					// Get protocol for IPv4 packets
+					ipDestination = currWord.data(271,240);
+				}
+
+				vlan_lookup: for (int m = 0; m < NUM_VLAN_INTERFACES; m++){
+				#pragma HLS UNROLL
+					if (vlanTable[m].valid && (vlanTable[m].vlanID == vlanID)){
+						vlanHit = true;
+						if (vlanTable[m].ipAddress == ipDestination)
+							vlanIpHit = true;
+					}
+				}
 
 				if (ethernetType == TYPE_ARP){
 					tdest = 0;
 					sendWord.dest = 0;
+					if (tagged && !vlanHit){
+						drop = DROP_PH_VLAN;
+					}
 				}
 				else if (ethernetType == TYPE_IPV4){
 					if (ipVersion == 4){ 	// Double check
@@ -202,12 +300,18 @@ void packet_identification(
 							tdest = 3;
 						}
 						else {
-							forward = false;
+							drop = DROP_PH_PROTOCOL;
 						}
 					}
+					else {
+						drop = DROP_PH_PROTOCOL;
+					}
+					if (tagged && !vlanIpHit){								// Unknown VLAN or IP address of another VLAN
+						drop = DROP_PH_VLAN;
+					}
 				}
 				else {
-					forward = false;
+					drop = DROP_PH_ETHERTYPE;
 				}
 
 				sendWord.data = currWord.data;
@@ -217,8 +321,9 @@ void packet_identification(
 				
 				tdest_r 		= tdest;	// Save tdest
 
-				if (forward){												// Evaluate if the packet has to be send or dropped
+				if (drop == DROP_NONE){										// Evaluate if the packet has to be send or dropped
 					dataOut.write(sendWord);
+					vlanTagged.write(tagged);
 					pi_fsm_state = FWD;
 				}
 				else {
@@ -254,37 +359,547 @@ void packet_identification(
 			break;
 		}
 	}	
+#if (DROP_REPORTS)
+	reportDrop(dropReportOut, dropReport(drop), pi_lostReports);
+#endif
 }
 
 
 /**
- * @brief      packet_handler: wrapper for packet identification and Ethernet remover
+ * @brief      Computes the IPv4 header checksum. The checksum field is not taken into account
+ *
+ * @param      header  The IPv4 header as it is in the AXI word
+ * @param      ihl     Internet header length in 32-bit words
  *
- * @param      dataIn   Incoming data from the network interface, at Ethernet level
- * @param      dataOut  Output data. The tdest says which kind of packet it is.
- * 						The Ethernet header is shoved off for IPv4 packets
+ * @return     The checksum as it is in the packet
+ */
+ap_uint<16> compute_ip_checksum(ap_uint<480> header, ap_uint<4> ihl) {
+
+	ap_uint<16> ip_ops[30];
+	#pragma HLS ARRAY_PARTITION variable=ip_ops complete dim=1
+	ap_uint<21> sum = 0;
+	ap_uint<17> final_sum;
+	ap_uint<16> checksum;
+
+	ip_header_ops: for (int i = 0; i < 30; i++){
+	#pragma HLS UNROLL
+		if (i < ihl.to_int()*2 && i != 5)
+			ip_ops[i] = byteSwap16(header(i*16+15, i*16));
+		else
+			ip_ops[i] = 0;
+	}
+
+	ip_header_sum: for (int i = 0; i < 30; i++){
+	#pragma HLS UNROLL
+		sum += ip_ops[i];
+	}
+
+	final_sum = sum(15,0) + sum(20,16);
+	final_sum = final_sum(15,0) + final_sum.bit(16);
+	checksum = ~final_sum(15,0);
+	return byteSwap16(checksum);
+}
+
+
+/**
+ * @brief      IPv4 reassembly. Packets that are not fragments go straight to the 
+ *             bypass output. Fragments are looked up by (source, destination,
+ *             identification, protocol) among the in-progress datagrams, a new 
+ *             slot is allocated for the first fragment that arrives.
+ *             The payload buffer is split in 64 byte-wide banks, each byte of an
+ *             input word lands in a different bank, so a fragment is written at
+ *             one word per cycle whatever its offset. The same holds for the read
+ *             side, which in the same cycle shifts the payload behind the header of
+ *             the first fragment of a complete datagram.
+ *             Coverage is tracked in 8-byte blocks, overlapping fragments are allowed
+ *             and the last one written wins. The key of a datagram is kept for
+ *             REASSEMBLY_TIMEOUT cycles after it is sent, so late duplicates are dropped
+ *             instead of taking a slot until the timeout, and afterwards the same
+ *             identification starts a new datagram. At most one datagram is given up per cycle, and not in a cycle
+ *             a fragment is dropped, so there is one drop report per cycle at most.
+ *
+ * @param      dataIn        IP packets
+ * @param      bypassOut     Packets that are not fragments
+ * @param      dropReportOut Dropped fragments and datagrams given up
+ * @param      reassembled   Complete datagrams, with total length, flags and checksum updated
+ */
+void ip_reassembly(
+			stream<axiWordOut>&			dataIn,
+			stream<axiWordOut>&			bypassOut,
+#if (DROP_REPORTS)
+			stream<dropReport>&			dropReportOut,
+#endif
+			stream<axiWordOut>&			reassembled) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	enum ra_states {FIRST_WORD, FWD, FRAGMENT, DROP};
+	enum rd_states {RD_IDLE, RD_SEND};
+	enum slot_states {SLOT_FREE, SLOT_ASSEMBLING, SLOT_DRAINING};
+	static ra_states ra_fsm_state = FIRST_WORD;
+	static rd_states rd_fsm_state = RD_IDLE;
+
+	static ap_uint<8> 		buffer[64][REASSEMBLY_SLOTS*REASSEMBLY_ROWS];
+	#pragma HLS ARRAY_PARTITION variable=buffer complete dim=1
+	#pragma HLS DEPENDENCE variable=buffer inter false
+	#pragma HLS DEPENDENCE variable=buffer intra false
+
+	static ap_uint<2> 		slotState[REASSEMBLY_SLOTS];
+	static ap_uint<32> 		slotSrcIp[REASSEMBLY_SLOTS];
+	static ap_uint<32> 		slotDstIp[REASSEMBLY_SLOTS];
+	static ap_uint<16> 		slotId[REASSEMBLY_SLOTS];
+	static ap_uint<8> 		slotProtocol[REASSEMBLY_SLOTS];
+	static dest_type 		slotDest[REASSEMBLY_SLOTS];
+	static ap_uint<32> 		slotStart[REASSEMBLY_SLOTS];				// First fragment, or completion once sent
+	static ap_uint<REASSEMBLY_BLOCKS> slotCoverage[REASSEMBLY_SLOTS];
+	static ap_uint<1> 		slotLastSeen[REASSEMBLY_SLOTS];
+	static ap_uint<14> 		slotTotal[REASSEMBLY_SLOTS];				// Payload bytes
+	static ap_uint<1> 		slotHeaderValid[REASSEMBLY_SLOTS];
+	static ap_uint<480> 	slotHeader[REASSEMBLY_SLOTS];
+	static ap_uint<1> 		slotCompleted[REASSEMBLY_SLOTS];			// The key is kept after the datagram is sent
+	#pragma HLS ARRAY_PARTITION variable=slotState complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotSrcIp complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotDstIp complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotId complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotProtocol complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotDest complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotStart complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotCoverage complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotLastSeen complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotTotal complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotHeaderValid complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotHeader complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=slotCompleted complete dim=1
+
+	static stream<ap_uint<3> > completedSlots("completedSlots");			// From the write side to the read side
+	#pragma HLS STREAM variable=completedSlots depth=8
+
+	static ap_uint<32> 		cycleCounter = 0;
+#if (DROP_REPORTS)
+	static ap_uint<16> 		ra_lostReports = 0;
+#endif
+	static ap_uint<3> 		wr_slot;
+	static ap_int<16> 		wr_wordBase;									// Payload byte where the first byte of the current word goes
+	static ap_uint<14> 		wr_fragStart;
+	static ap_uint<14> 		wr_fragEnd;
+	static ap_uint<3> 		rd_slot;
+	static ap_uint<8> 		rd_word;
+	static ap_uint<14> 		rd_length;										// Bytes of the whole datagram
+	static ap_uint<6> 		rd_headerBytes;
+	static ap_uint<480> 	rd_header;
+	static dest_type 		rd_dest;
+
+	axiWordOut 				currWord;
+	axiWordOut 				sendWord;
+	ap_uint<4> 				ihl;
+	ap_uint<16> 			totalLength;
+	ap_uint<16> 			fragField;
+	ap_uint<13> 			fragOffset;
+	bool 					moreFragments;
+	ap_uint<32> 			srcIp;
+	ap_uint<32> 			dstIp;
+	ap_uint<16> 			ipId;
+	ap_uint<8> 				protocol;
+	ap_uint<14> 			payloadLength;
+	ap_uint<3> 				slot = 0;
+	ap_uint<3> 				freeSlot = 0;
+	bool 					slotHit = false;
+	bool 					slotAvailable = false;
+	bool 					cleanSlotAvailable = false;
+	bool 					lateFragment = false;
+	bool 					keyKept;
+	bool 					writeWord = false;
+	bool 					timedOut = false;
+	dropReason 				drop = DROP_NONE;
+	ap_uint<REASSEMBLY_BLOCKS> allOnes = ~ap_uint<REASSEMBLY_BLOCKS>(0);
+	ap_uint<REASSEMBLY_BLOCKS> coverage;
+	ap_uint<REASSEMBLY_BLOCKS> needed;
+	ap_uint<8> 				bankByte[64];
+	#pragma HLS ARRAY_PARTITION variable=bankByte complete dim=1
+	ap_uint<14> 			remaining;
+	ap_uint<16> 			checksum;
+
+	cycleCounter++;
+
+	/* Write side */
+	switch (ra_fsm_state) {
+		case FIRST_WORD :
+			if (!dataIn.empty()){
+				dataIn.read(currWord);
+				ihl 			= currWord.data(3,0);
+				totalLength 	= byteSwap16(currWord.data(31,16));
+				ipId 			= currWord.data(47,32);
+				fragField 		= byteSwap16(currWord.data(63,48));
+				protocol 		= currWord.data(79,72);
+				srcIp 			= currWord.data(127,96);
+				dstIp 			= currWord.data(159,128);
+				fragOffset 		= fragField(12,0);
+				moreFragments 	= fragField.bit(13);
+				payloadLength 	= totalLength - (ihl * 4);
+
+				if (currWord.dest == 0 || (!moreFragments && fragOffset == 0)){	// ARP or not a fragment
+					bypassOut.write(currWord);
+					if (!currWord.last)
+						ra_fsm_state = FWD;
+				}
+				else {
+					slot_lookup: for (int m = REASSEMBLY_SLOTS-1; m >= 0; m--){
+					#pragma HLS UNROLL
+						bool keyMatch = slotSrcIp[m] == srcIp && slotDstIp[m] == dstIp && slotId[m] == ipId && slotProtocol[m] == protocol;
+						if (slotState[m] == SLOT_ASSEMBLING && keyMatch){
+							slot 	= m;
+							slotHit = true;
+						}
+						keyKept = slotState[m] != SLOT_ASSEMBLING && slotCompleted[m] && ((cycleCounter - slotStart[m]) <= REASSEMBLY_TIMEOUT);
+						if (keyKept && keyMatch)
+							lateFragment = true;
+						if (slotState[m] == SLOT_FREE && !cleanSlotAvailable){		// Keep the keys of sent datagrams as long as possible
+							freeSlot 			= m;
+							slotAvailable 		= true;
+							cleanSlotAvailable 	= !keyKept;
+						}
+					}
+
+					if (((fragOffset * 8 + payloadLength) > REASSEMBLY_MAX_BYTES) || (!slotHit && !slotAvailable) || (ihl < 5) || (!slotHit && lateFragment)){
+						drop = DROP_PH_FRAGMENT;									// Too big, no room or the datagram was already sent, drop the fragment
+						if (!currWord.last)
+							ra_fsm_state = DROP;
+					}
+					else {
+						if (!slotHit){
+							slot 					= freeSlot;
+							slotState[slot] 		= SLOT_ASSEMBLING;
+							slotSrcIp[slot] 		= srcIp;
+							slotDstIp[slot] 		= dstIp;
+							slotId[slot] 			= ipId;
+							slotProtocol[slot] 		= protocol;
+							slotStart[slot] 		= cycleCounter;
+							slotCoverage[slot] 		= 0;
+							slotLastSeen[slot] 		= 0;
+							slotHeaderValid[slot] 	= 0;
+							slotCompleted[slot] 	= 0;
+						}
+						slotDest[slot] 		= currWord.dest;
+						if (fragOffset == 0){					// The header of the first fragment is the header of the datagram
+							slotHeader[slot] 		= currWord.data(479,0);
+							slotHeaderValid[slot] 	= 1;
+						}
+						if (!moreFragments){
+							slotTotal[slot] 	= fragOffset * 8 + payloadLength;
+							slotLastSeen[slot] 	= 1;
+						}
+						wr_slot 		= slot;
+						wr_fragStart 	= fragOffset * 8;
+						wr_fragEnd 		= fragOffset * 8 + payloadLength;
+						wr_wordBase 	= fragOffset * 8 - (ihl * 4);
+						writeWord 		= true;
+						ra_fsm_state 	= FRAGMENT;
+					}
+				}
+			}
+			break;
+		case FWD :
+			if (!dataIn.empty()){
+				dataIn.read(currWord);
+				bypassOut.write(currWord);
+				if (currWord.last)
+					ra_fsm_state = FIRST_WORD;
+			}
+			break;
+		case FRAGMENT :
+			if (!dataIn.empty()){
+				dataIn.read(currWord);
+				writeWord = true;
+			}
+			break;
+		case DROP :
+			if (!dataIn.empty()){
+				dataIn.read(currWord);
+				if (currWord.last)
+					ra_fsm_state = FIRST_WORD;
+			}
+			break;
+	}
+
+	if (writeWord){
+		bank_write: for (int b = 0; b < 64; b++){							// Byte i of the word goes to bank b
+		#pragma HLS UNROLL
+			ap_uint<6> 	i 			= b - wr_wordBase(5,0);
+			ap_int<17> 	payloadByte = wr_wordBase + i;
+			if (currWord.keep.bit(i) && (payloadByte >= wr_fragStart.to_int()) && (payloadByte < wr_fragEnd.to_int()))
+				buffer[b][wr_slot * REASSEMBLY_ROWS + payloadByte(16,6)] = currWord.data(i*8+7, i*8);
+		}
+		wr_wordBase += 64;
+
+		if (currWord.last){
+			coverage = slotCoverage[wr_slot] | ((allOnes << wr_fragStart(13,3)) & ~(allOnes << ((wr_fragEnd + 7) >> 3)));
+			slotCoverage[wr_slot] = coverage;
+			needed = ~(allOnes << ((slotTotal[wr_slot] + 7) >> 3));
+			if (slotLastSeen[wr_slot] && slotHeaderValid[wr_slot] && ((coverage & needed) == needed)){
+				slotState[wr_slot] 		= SLOT_DRAINING;
+				slotCompleted[wr_slot] 	= 1;
+				slotStart[wr_slot] 		= cycleCounter;					// The key is kept for REASSEMBLY_TIMEOUT from now on
+				completedSlots.write(wr_slot);
+			}
+			ra_fsm_state = FIRST_WORD;
+		}
+	}
+
+	timeout_check: for (int m = 0; m < REASSEMBLY_SLOTS; m++){				// Give up incomplete datagrams
+	#pragma HLS UNROLL
+		if (slotState[m] == SLOT_ASSEMBLING && !(ra_fsm_state == FRAGMENT && wr_slot.to_int() == m) &&
+				((cycleCounter - slotStart[m]) > REASSEMBLY_TIMEOUT) && !timedOut && drop == DROP_NONE){
+			slotState[m] = SLOT_FREE;
+			timedOut = true;
+		}
+	}
+	if (timedOut)
+		drop = DROP_PH_REASSEMBLY_TIMEOUT;
+#if (DROP_REPORTS)
+	reportDrop(dropReportOut, dropReport(drop), ra_lostReports);
+#endif
+
+	/* Read side */
+	switch (rd_fsm_state) {
+		case RD_IDLE :
+			if (!completedSlots.empty()){
+				completedSlots.read(rd_slot);
+				rd_header 			= slotHeader[rd_slot];
+				rd_headerBytes 		= rd_header(3,0) * 4;
+				rd_length 			= rd_header(3,0) * 4 + slotTotal[rd_slot];
+				rd_dest 			= slotDest[rd_slot];
+				rd_header(31,16) 	= byteSwap16(rd_length);			// Total length of the datagram
+				rd_header(63,48) 	= 0;								// No more fragments
+				checksum 			= compute_ip_checksum(rd_header, rd_header(3,0));
+				rd_header(95,80) 	= checksum;
+				rd_word 			= 0;
+				rd_fsm_state 		= RD_SEND;
+			}
+			break;
+		case RD_SEND :
+			bank_read: for (int b = 0; b < 64; b++){
+			#pragma HLS UNROLL
+				ap_uint<7> 	position = b + rd_headerBytes;
+				ap_int<9> 	row 	 = rd_word - (position.bit(6) ? 1 : 0);	// Bytes that wrap around belong to the previous row
+				if (row >= 0)
+					bankByte[b] = buffer[b][rd_slot * REASSEMBLY_ROWS + row];
+				else
+					bankByte[b] = 0;
+			}
+
+			remaining = rd_length - rd_word * 64;
+			compose_word: for (int p = 0; p < 64; p++){
+			#pragma HLS UNROLL
+				ap_uint<6> b = p - rd_headerBytes;
+				if (rd_word == 0 && p < rd_headerBytes.to_int())
+					sendWord.data(p*8+7, p*8) = rd_header(p*8+7, p*8);
+				else
+					sendWord.data(p*8+7, p*8) = bankByte[b];
+				sendWord.keep.bit(p) = (p < remaining.to_int()) ? 1 : 0;
+			}
+			sendWord.dest = rd_dest;
+			sendWord.last = (remaining <= 64) ? 1 : 0;
+			reassembled.write(sendWord);
+
+			if (remaining <= 64){
+				slotState[rd_slot] 	= SLOT_FREE;
+				rd_fsm_state 		= RD_IDLE;
+			}
+			rd_word++;
+			break;
+	}
+}
+
+
+/**
+ * @brief      Merges the packets that did not need reassembly with the reassembled
+ *             datagrams. Packets are never interleaved.
+ *
+ * @param      bypassIn       Packets that are not fragments
+ * @param      reassembledIn  Reassembled datagrams
+ * @param      dataOut        The data out
+ */
+void ip_reassembly_merger(
+			stream<axiWordOut>&			bypassIn,
+			stream<axiWordOut>&			reassembledIn,
+			stream<axiWordOut>&			dataOut) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	enum rm_states {IDLE, FWD_BYPASS, FWD_REASSEMBLED};
+	static rm_states rm_fsm_state = IDLE;
+
+	axiWordOut currWord;
+
+	switch (rm_fsm_state) {
+		case IDLE :
+			if (!bypassIn.empty()){
+				bypassIn.read(currWord);
+				dataOut.write(currWord);
+				if (!currWord.last)
+					rm_fsm_state = FWD_BYPASS;
+			}
+			else if (!reassembledIn.empty()){
+				reassembledIn.read(currWord);
+				dataOut.write(currWord);
+				if (!currWord.last)
+					rm_fsm_state = FWD_REASSEMBLED;
+			}
+			break;
+		case FWD_BYPASS :
+			if (!bypassIn.empty()){
+				bypassIn.read(currWord);
+				dataOut.write(currWord);
+				if (currWord.last)
+					rm_fsm_state = IDLE;
+			}
+			break;
+		case FWD_REASSEMBLED :
+			if (!reassembledIn.empty()){
+				reassembledIn.read(currWord);
+				dataOut.write(currWord);
+				if (currWord.last)
+					rm_fsm_state = IDLE;
+			}
+			break;
+	}
+}
+
+
+#if (DROP_REPORTS)
+/**
+ * @brief      Merges the drop reports of the packet identification and the reassembly.
+ *             It never waits for m_axis_drop_report, the reports stay in their FIFOs
+ *             while it is full. When both inputs have a report they take turns, so
+ *             a flood of identification drops does not starve the reassembly.
+ *
+ * @param      identificationDrop  The identification drop
+ * @param      reassemblyDrop      The reassembly drop
+ * @param      dropReportOut       The drop report out
+ */
+void drop_report_merger(
+			stream<dropReport>&			identificationDrop,
+			stream<dropReport>&			reassemblyDrop,
+			stream<dropReport>&			dropReportOut) {
+
+#pragma HLS PIPELINE II=1
+#pragma HLS INLINE off
+
+	static bool drm_reassemblyFirst = false;
+
+	if (!dropReportOut.full()){
+		if (!reassemblyDrop.empty() && (drm_reassemblyFirst || identificationDrop.empty())){
+			dropReportOut.write(reassemblyDrop.read());
+			drm_reassemblyFirst = false;
+		}
+		else if (!identificationDrop.empty()){
+			dropReportOut.write(identificationDrop.read());
+			drm_reassemblyFirst = true;
+		}
+	}
+}
+#endif
+
+
+/**
+ * @brief      packet_handler: dataflow of packet identification, Ethernet remover,
+ *             IPv4 reassembly and the merger of the reassembled datagrams with the
+ *             packets that are not fragments. With DROP_REPORTS the drops of the
+ *             identification and the reassembly are merged into m_axis_drop_report
+ *
+ * @param      dataIn     Incoming data from the network interface, at Ethernet level
+ * @param      dataOut    Output data. The tdest says which kind of packet it is.
+ * 						  The Ethernet header (and 802.1Q tag if any) is shoved off for IPv4 packets
+ * 						  and fragmented datagrams are delivered once reassembled
+ * @param      dropReportOut  Reason of every dropped packet, for the drop_counters block
+ * @param      vlanTable  VLAN interfaces. Tagged frames are only accepted for a valid VLAN ID
  *   
  */
 void packet_handler(
 			stream<axiWordIn>&			dataIn,
-			stream<axiWordOut>&			dataOut) {
+			stream<axiWordOut>&			dataOut,
+#if (DROP_REPORTS)
+			stream<dropReport>&			dropReportOut,
+#endif
+			vlanInterface				vlanTable[NUM_VLAN_INTERFACES]) {
 
 #pragma HLS INTERFACE ap_ctrl_none port=return
 #pragma HLS DATAFLOW
 
 #pragma HLS INTERFACE axis register both port=dataIn name=s_axis
 #pragma HLS INTERFACE axis register both port=dataOut name=m_axis
+#if (DROP_REPORTS)
+#pragma HLS INTERFACE axis register both port=dropReportOut name=m_axis_drop_report
+#pragma HLS DATA_PACK variable=dropReportOut
+#endif
+
+#pragma HLS INTERFACE ap_stable port=vlanTable
+#pragma HLS ARRAY_PARTITION variable=vlanTable complete dim=1
+#pragma HLS DATA_PACK variable=vlanTable
 
 	static stream<axiWordOut>     eth_level_pkt("eth_level_pkt");
 	#pragma HLS STREAM variable=eth_level_pkt depth=16
 	#pragma HLS DATA_PACK variable=eth_level_pkt
 
+	static stream<ap_uint<1> >    eth_vlan_tagged("eth_vlan_tagged");
+	#pragma HLS STREAM variable=eth_vlan_tagged depth=16
+
+	static stream<axiWordOut>     ip_level_pkt("ip_level_pkt");
+	#pragma HLS STREAM variable=ip_level_pkt depth=16
+	#pragma HLS DATA_PACK variable=ip_level_pkt
+
+	static stream<axiWordOut>     ip_bypass_pkt("ip_bypass_pkt");
+	#pragma HLS STREAM variable=ip_bypass_pkt depth=16
+	#pragma HLS DATA_PACK variable=ip_bypass_pkt
+
+	static stream<axiWordOut>     ip_reassembled_pkt("ip_reassembled_pkt");
+	#pragma HLS STREAM variable=ip_reassembled_pkt depth=16
+	#pragma HLS DATA_PACK variable=ip_reassembled_pkt
+
+#if (DROP_REPORTS)
+	static stream<dropReport>     identification_drop("identification_drop");
+	#pragma HLS STREAM variable=identification_drop depth=4
+	#pragma HLS DATA_PACK variable=identification_drop
+
+	static stream<dropReport>     reassembly_drop("reassembly_drop");
+	#pragma HLS STREAM variable=reassembly_drop depth=4
+	#pragma HLS DATA_PACK variable=reassembly_drop
+#endif
+
 	packet_identification(
 			dataIn,
-			eth_level_pkt); 
+			eth_level_pkt,
+			eth_vlan_tagged,
+#if (DROP_REPORTS)
+			identification_drop,
+#endif
+			vlanTable); 
 
 	ethernet_remover (			
 			eth_level_pkt,
+			eth_vlan_tagged,
+			ip_level_pkt);
+
+	ip_reassembly(
+			ip_level_pkt,
+			ip_bypass_pkt,
+#if (DROP_REPORTS)
+			reassembly_drop,
+#endif
+			ip_reassembled_pkt);
+
+	ip_reassembly_merger(
+			ip_bypass_pkt,
+			ip_reassembled_pkt,
 			dataOut);
 
+#if (DROP_REPORTS)
+	drop_report_merger(
+			identification_drop,
+			reassembly_drop,
+			dropReportOut);
+#endif
+
 }
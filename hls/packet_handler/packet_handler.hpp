@@ -41,6 +41,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ap_int.h"
 #include <stdint.h>
 #include <cstdlib>
+#include "../TOE/common_utilities/drop_report.hpp"
+#include "../TOE/common_utilities/vlan_interface.hpp"
 
 using namespace hls;
 using namespace std;
@@ -50,6 +52,7 @@ using namespace std;
 
 const ap_uint<16> TYPE_IPV4 	= 0x0800;
 const ap_uint<16> TYPE_ARP 		= 0x0806;
+const ap_uint<16> TYPE_VLAN 	= 0x8100;		// IEEE 802.1Q tag protocol identifier
 
 const ap_uint< 8> PROTO_ICMP	=  1;
 const ap_uint< 8> PROTO_TCP		=  6;
@@ -73,18 +76,40 @@ struct axiWordOut {
 	dest_type		dest;
 };
 
+/**
+ * IPv4 reassembly. A bounded number of datagrams can be in progress at the same
+ * time, each one has a buffer of REASSEMBLY_MAX_BYTES of payload. Fragments that
+ * do not fit, or that do not find a free slot, are dropped. Incomplete datagrams
+ * are discarded after REASSEMBLY_TIMEOUT cycles.
+ */
+#define REASSEMBLY_SLOTS 		8
+#define REASSEMBLY_MAX_BYTES 	9216
+#define REASSEMBLY_ROWS 		(REASSEMBLY_MAX_BYTES/64)
+#define REASSEMBLY_BLOCKS 		(REASSEMBLY_MAX_BYTES/8)			// Fragment offsets are in 8-byte blocks
 
+#ifndef __SYNTHESIS__
+static const ap_uint<32> REASSEMBLY_TIMEOUT = 5000;					// Shortened for simulation
+#else
+static const ap_uint<32> REASSEMBLY_TIMEOUT = 322580645;			// 1 s at 3.1 ns
+#endif
 
 /**
- * @brief      packet_handler: wrapper for packet identification and Ethernet remover
+ * @brief      packet_handler: wrapper for packet identification, Ethernet remover and IPv4 reassembly
  *
- * @param      dataIn   Incoming data from the network interface, at Ethernet level
- * @param      dataOut  Output data. The tdest says which kind of packet it is.
- * 						The Ethernet header is shoved off for IPv4 packets
+ * @param      dataIn     Incoming data from the network interface, at Ethernet level
+ * @param      dataOut    Output data. The tdest says which kind of packet it is.
+ * 						  The Ethernet header (and 802.1Q tag if any) is shoved off for IPv4 packets
+ * 						  and fragmented datagrams are delivered once reassembled
+ * @param      dropReportOut  Reason of every dropped packet, for the drop_counters block
+ * @param      vlanTable  VLAN interfaces. Tagged frames are only accepted for a valid VLAN ID
  *   
  */
 void packet_handler(
 			stream<axiWordIn>&			dataIn,
-			stream<axiWordOut>&			dataOut);
+			stream<axiWordOut>&			dataOut,
+#if (DROP_REPORTS)
+			stream<dropReport>&			dropReportOut,
+#endif
+			vlanInterface				vlanTable[NUM_VLAN_INTERFACES]);
 
 #endif
\ No newline at end of file
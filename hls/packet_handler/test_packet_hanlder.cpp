@@ -32,142 +32,536 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 ************************************************/
-#include "icmp_server.hpp"
-#include "/home/mario/Documents/cmac_100g/submodules/tcp_ip_cores/TOE/src/testbench/pcap2stream.hpp"
-
-using namespace hls;
-using namespace std;
-
-void compute_checksum(	
-									stream<axiWord>&			dataIn,
-									stream<ap_uint<16> >&		pseudo_tcp_checksum,
-									ap_uint<1>					source)
-{
-
-	static ap_uint<1> 	compute_checksum[2] = {0 , 0};
-	static ap_uint<16> 	word_sum[32][2]={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-	
-	ap_uint<17> 		ip_sums_L1[16];
-	ap_uint<18> 		ip_sums_L2[8];
-	ap_uint<19> 		ip_sums_L3[4];
-	ap_uint<20> 		ip_sums_L4[2];
-	ap_uint<21> 		ip_sums_L5;
-	ap_uint<16> 		tmp;
-	ap_uint<17> 		tmp1;
-	ap_uint<17> 		tmp2;
-	ap_uint<17> 		final_sum_r; 							// real add
-	ap_uint<17> 		final_sum_o; 							// overflowed add
-	ap_uint<16> 		res_checksum;
-	axiWord 			currWord;
-
-	if (!dataIn.empty() && !compute_checksum[source]){
-		dataIn.read(currWord);
-
-		first_level_sum : for (int i=0 ; i < 32 ; i++ ){
-			tmp(7,0) 	= currWord.data((((i*2)+1)*8)+7,((i*2)+1)*8);
-			tmp(15,8) 	= currWord.data(((i*2)*8)+7,(i*2)*8);
-			tmp1 		= word_sum[i][source] + tmp;
-			tmp2 		= word_sum[i][source] + tmp + 1;
-			if (tmp1.bit(16)) 				// one's complement adder
-				word_sum[i][source] = tmp2(15,0);
-			else
-				word_sum[i][source] = tmp1(15,0);
-		}
 
-		if(currWord.last){
-			compute_checksum[source] = 1;
+#include "packet_handler.hpp"
+#include <vector>
+#include <iomanip>
+
+/*
+ * Mixed 802.1Q tagged and untagged traffic at line rate. One input word is
+ * offered per call of packet_handler. Tagged frames for a configured VLAN
+ * must come out exactly like the untagged ones, frames for an unknown VLAN
+ * or for the IP address of another VLAN must be dropped.
+ */
+
+#define NUM_PACKETS 2000
+
+static stream<dropReport>		dropReports("dropReports");		// Stays empty without DROP_REPORTS
+
+void run_packet_handler(stream<axiWordIn>& dataIn, stream<axiWordOut>& dataOut, vlanInterface vlanTable[NUM_VLAN_INTERFACES]){
+	packet_handler(
+			dataIn,
+			dataOut,
+#if (DROP_REPORTS)
+			dropReports,
+#endif
+			vlanTable);
+}
+
+struct expectedPacket {
+	std::vector<uint8_t>	payload;		// What packet_handler must output
+	dest_type				dest;
+};
+
+void bytes2stream(std::vector<uint8_t>& bytes, stream<axiWordIn>& dataOut){
+	axiWordIn word;
+	size_t i;
+
+	for (i = 0; i < bytes.size(); i += 64){
+		word.data = 0;
+		word.keep = 0;
+		for (size_t b = 0; b < 64 && (i + b) < bytes.size(); b++){
+			word.data(b*8+7, b*8) = bytes[i+b];
+			word.keep.bit(b) = 1;
 		}
+		word.last = (i + 64) >= bytes.size();
+		dataOut.write(word);
+	}
+}
+
+void put32(std::vector<uint8_t>& v, int pos, ap_uint<32> value){		// value in network order as in the AXI word
+	for (int b = 0; b < 4; b++)
+		v[pos+b] = value(b*8+7, b*8);
+}
+
+/* IPv4 packet with protocol and random payload */
+std::vector<uint8_t> build_ip_packet(ap_uint<32> srcIp, ap_uint<32> dstIp, uint8_t protocol, int length){
+	std::vector<uint8_t> ip(length);
+
+	for (int i = 0; i < length; i++)
+		ip[i] = rand();
+	ip[0] = 0x45;
+	ip[6] = 0x40;													// Don't fragment
+	ip[7] = 0;
+	ip[2] = length >> 8;
+	ip[3] = length & 0xFF;
+	ip[9] = protocol;
+	put32(ip, 12, srcIp);
+	put32(ip, 16, dstIp);
+	return ip;
+}
+
+std::vector<uint8_t> build_frame(std::vector<uint8_t>& payload, uint16_t etherType, bool tagged, uint16_t vlanID){
+	std::vector<uint8_t> frame;
+
+	for (int i = 0; i < 12; i++)
+		frame.push_back(rand());
+	if (tagged){
+		frame.push_back(0x81);
+		frame.push_back(0x00);
+		frame.push_back((rand() & 0xE0) | ((vlanID >> 8) & 0xF));		// Random priority
+		frame.push_back(vlanID & 0xFF);
+	}
+	frame.push_back(etherType >> 8);
+	frame.push_back(etherType & 0xFF);
+	frame.insert(frame.end(), payload.begin(), payload.end());
+	while (frame.size() < 60)										// Minimum Ethernet frame without FCS
+		frame.push_back(0);
+	return frame;
+}
+
+int vlan_test() {
+
+	stream<axiWordIn>			inputStream("inputStream");
+	stream<axiWordOut>			outputStream("outputStream");
+	vlanInterface				vlanTable[NUM_VLAN_INTERFACES];
+	std::vector<expectedPacket>	golden;
+	ap_uint<32>					myIpAddress = 0x0500a8c0;			// 192.168.0.5
+	ap_uint<32>					peerIpAddress = 0x0a00a8c0;			// 192.168.0.10
+	axiWordOut					currWord;
+	unsigned int				inputWords = 0;
+	unsigned int				cycles = 0;
+	int 						errors = 0;
+	int 						dropped = 0;
+
+	srand(7);
+
+	for (int m = 0; m < NUM_VLAN_INTERFACES; m++){
+		vlanTable[m].valid 			= (m < 4);
+		vlanTable[m].vlanID 		= 100 + m;
+		vlanTable[m].ipAddress 		= 0x0500000a + (m << 8);		// 10.0.m.5
+		vlanTable[m].macAddress 	= 0x0000CAFE0000 + m;
+		vlanTable[m].subNetMask 	= 0x00FFFFFF;
+		vlanTable[m].defaultGateway = 0x0100000a + (m << 8);
 	}
-	else if(compute_checksum[source]) {
-		//adder tree
-		second_level_sum : for (int i = 0; i < 16; i++) {
-			ip_sums_L1[i]= word_sum[i*2][source] + word_sum[i*2+1][source];
-			word_sum[i*2][source]   = 0; // clear adder variable
-			word_sum[i*2+1][source] = 0;
+
+	for (int p = 0; p < NUM_PACKETS; p++){
+		int 		kind 	= rand() % 8;
+		int 		length 	= 20 + (rand() % 1480);
+		int 		vlan 	= rand() % NUM_VLAN_INTERFACES;
+		uint8_t 	proto 	= (rand() % 3 == 0) ? PROTO_UDP : PROTO_TCP;
+		bool 		tagged 	= (kind != 0 && kind != 1);
+		ap_uint<32> dstIp 	= tagged ? vlanTable[vlan].ipAddress : myIpAddress;
+		bool 		accept 	= !tagged || vlanTable[vlan].valid;
+		std::vector<uint8_t> ip;
+		std::vector<uint8_t> frame;
+		expectedPacket exp;
+
+		if (kind == 7 && tagged){								// Address of another VLAN, must be dropped
+			dstIp 	= vlanTable[(vlan + 1) % NUM_VLAN_INTERFACES].ipAddress;
+			accept 	= false;
 		}
-		//adder tree L2
-		third_level_sum : for (int i = 0; i < 8; i++) {
-			ip_sums_L2[i] = ip_sums_L1[i*2+1] + ip_sums_L1[i*2];
+
+		if (kind == 6){											// ARP, only the tag is removed
+			ip = std::vector<uint8_t>(28);
+			for (int i = 0; i < 28; i++)
+				ip[i] = rand();
+			frame = build_frame(ip, TYPE_ARP, tagged, vlanTable[vlan].vlanID);
+			exp.payload = frame;
+			if (tagged)
+				exp.payload.erase(exp.payload.begin() + 12, exp.payload.begin() + 16);
+			exp.dest = 0;
 		}
-		//adder tree L3
-		fourth_level_sum : for (int i = 0; i < 4; i++) {
-			ip_sums_L3[i] = ip_sums_L2[i*2+1] + ip_sums_L2[i*2];
+		else {
+			ip = build_ip_packet(peerIpAddress, dstIp, proto, length);
+			frame = build_frame(ip, TYPE_IPV4, tagged, vlanTable[vlan].vlanID);
+			exp.payload = std::vector<uint8_t>(frame.begin() + (tagged ? 18 : 14), frame.end());
+			exp.dest = (proto == PROTO_TCP) ? 2 : 3;
 		}
 
-		ip_sums_L4[0] = ip_sums_L3[1] + ip_sums_L3[0];
-		ip_sums_L4[1] = ip_sums_L3[3] + ip_sums_L3[2];
-		ip_sums_L5 = ip_sums_L4[1] + ip_sums_L4[0];
+		bytes2stream(frame, inputStream);
+		if (accept)
+			golden.push_back(exp);
+		else
+			dropped++;
+	}
 
-		final_sum_r = ip_sums_L5.range(15,0) + ip_sums_L5.range(20,16);
-		final_sum_o = ip_sums_L5.range(15,0) + ip_sums_L5.range(20,16) + 1;
+	inputWords = inputStream.size();
+
+	unsigned int packetCounter = 0;
+	unsigned int lastOutputCycle = 0;
+	std::vector<uint8_t> received;
+	dest_type dest = 0;
+
+	while (!inputStream.empty() || cycles < inputWords + 64){	// Drain the pipeline
+		run_packet_handler(inputStream, outputStream, vlanTable);
+		cycles++;
+
+		while(!outputStream.empty()){
+			outputStream.read(currWord);
+			lastOutputCycle = cycles;
+			if (received.size() == 0)
+				dest = currWord.dest;
+			for (int b = 0; b < 64; b++){
+				if (currWord.keep.bit(b))
+					received.push_back(currWord.data(b*8+7, b*8));
+			}
+			if (currWord.last){
+				if (packetCounter >= golden.size()){
+					cout << "Unexpected packet [" << dec << packetCounter << "]" << endl;
+					errors++;
+				}
+				else {
+					std::vector<uint8_t>& expected = golden[packetCounter].payload;
+					size_t compareLength = expected.size();
+					if (golden[packetCounter].dest == 0)			// ARP frames may be truncated to the first word
+						compareLength = std::min(expected.size(), received.size());
+					if ((received.size() < compareLength) || !std::equal(expected.begin(), expected.begin() + compareLength, received.begin()) ||
+							((golden[packetCounter].dest != 0) && (received.size() != expected.size()))){
+						cout << "Packet [" << dec << setw(5) << packetCounter << "] payload mismatch, length " << received.size() << " expected " << expected.size() << endl;
+						errors++;
+					}
+					if (dest != golden[packetCounter].dest){
+						cout << "Packet [" << dec << setw(5) << packetCounter << "] dest " << dest << " expected " << golden[packetCounter].dest << endl;
+						errors++;
+					}
+				}
+				received.clear();
+				packetCounter++;
+			}
+		}
+	}
 
-		if (final_sum_r.bit(16))
-			res_checksum = ~(final_sum_o.range(15,0));
-		else
-			res_checksum = ~(final_sum_r.range(15,0));
+	if (lastOutputCycle > inputWords + 2){						// One word per cycle, tagged or not
+		cout << "Line rate not sustained: " << dec << inputWords << " input words took " << lastOutputCycle << " cycles" << endl;
+		errors++;
+	}
 
-		compute_checksum[source] = 0;
-		pseudo_tcp_checksum.write(res_checksum);
+	if (packetCounter != golden.size()){
+		cout << "Received " << dec << packetCounter << " packets, expected " << golden.size() << endl;
+		errors++;
 	}
-}
 
+#if (DROP_REPORTS)
+	int vlanDrops = 0;
+	while (!dropReports.empty()){
+		vlanDrops += (dropReports.read().reason == DROP_PH_VLAN);
+	}
+	if (vlanDrops != dropped){
+		cout << "Drop reports: " << dec << vlanDrops << " for the VLAN, expected " << dropped << endl;
+		errors++;
+	}
+#endif
 
-int main(int argc, char **argv) {
+	cout << "Packets " << dec << NUM_PACKETS << " forwarded " << packetCounter << " dropped " << dropped;
+	cout << "\tInput words " << inputWords << " in " << lastOutputCycle << " cycles" << endl;
 
+	return errors;
+}
 
-	stream<axiWord>						ipRxData("ipRxData");
-	stream<axiWord>						in_packet_to_checksum("in_packet_to_checksum");
-	stream<axiWord>						out_packet_to_checksum("out_packet_to_checksum");
-	stream<axiWord>						ipTxData("ipTxData");
+/*
+ * IPv4 reassembly. Datagrams are cut in fragments which are shuffled and
+ * interleaved with the fragments of other datagrams and with packets that are
+ * not fragments. Some fragments are sent twice and some overlap with their
+ * neighbours. The reassembled datagram must be the original one with the
+ * fragment fields cleared and the checksum updated.
+ */
 
-	stream<ap_uint<16> >				in_checksum("in_checksum");
-	stream<ap_uint<16> >				out_checksum("out_checksum");
+uint16_t ip_checksum(std::vector<uint8_t>& ip){
+	uint32_t sum = 0;
 
-	char *input_file;
-	char *output_file;
+	for (int i = 0; i < (ip[0] & 0xF) * 4; i += 2){
+		if (i != 10)
+			sum += (ip[i] << 8) | ip[i+1];
+	}
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	return ~sum;
+}
 
-	int count = 0;
+std::vector<uint8_t> build_fragment(std::vector<uint8_t>& ip, int start, int end, bool more){
+	std::vector<uint8_t> fragment(ip.begin(), ip.begin() + 20);
+	int length = 20 + end - start;
 
+	fragment.insert(fragment.end(), ip.begin() + 20 + start, ip.begin() + 20 + end);
+	fragment[2] = length >> 8;
+	fragment[3] = length & 0xFF;
+	fragment[6] = (more ? 0x20 : 0) | ((start / 8) >> 8);
+	fragment[7] = (start / 8) & 0xFF;
+	return fragment;
+}
 
-	if (argc < 3) {
-		cerr << "[ERROR] missing arguments " __FILE__  << " <INPUT_PCAP_FILE> <OUTPUT_PCAP_FILE> " << endl;;
-		return -1;
-	}
+void send_frame(std::vector<uint8_t>& ip, stream<axiWordIn>& dataOut){
+	std::vector<uint8_t> frame = build_frame(ip, TYPE_IPV4, false, 0);
+	bytes2stream(frame, dataOut);
+}
 
-	input_file 	= argv[1];
-	output_file = argv[2];
+void run_until_empty(stream<axiWordIn>& inputStream, stream<axiWordOut>& outputStream, vlanInterface vlanTable[NUM_VLAN_INTERFACES],
+		std::vector<std::vector<uint8_t> >& output, unsigned int extraCycles){
+	std::vector<uint8_t> received;
+	axiWordOut currWord;
+	unsigned int idle = 0;
+
+	while (!inputStream.empty() || idle < extraCycles){
+		if (inputStream.empty())
+			idle++;
+		run_packet_handler(inputStream, outputStream, vlanTable);
+		while(!outputStream.empty()){
+			outputStream.read(currWord);
+			idle = 0;												// Wait until the datagrams are drained
+			for (int b = 0; b < 64; b++){
+				if (currWord.keep.bit(b))
+					received.push_back(currWord.data(b*8+7, b*8));
+			}
+			if (currWord.last){
+				output.push_back(received);
+				received.clear();
+			}
+		}
+	}
+}
 
+int reassembly_test() {
+
+	stream<axiWordIn>			inputStream("reassemblyInput");
+	stream<axiWordOut>			outputStream("reassemblyOutput");
+	vlanInterface				vlanTable[NUM_VLAN_INTERFACES];
+	ap_uint<32>					myIpAddress = 0x0500a8c0;			// 192.168.0.5
+	ap_uint<32>					peerIpAddress = 0x0a00a8c0;			// 192.168.0.10
+	std::vector<std::vector<uint8_t> > expected;
+	std::vector<std::vector<uint8_t> > output;
+	int 						errors = 0;
+
+	for (int m = 0; m < NUM_VLAN_INTERFACES; m++)
+		vlanTable[m].valid = 0;
+
+	for (int round = 0; round < 50; round++){
+		std::vector<std::vector<uint8_t> > fragments;
+		int datagrams = 1 + rand() % REASSEMBLY_SLOTS;
+
+		for (int d = 0; d < datagrams; d++){
+			int length = 20 + 8 + rand() % (REASSEMBLY_MAX_BYTES - 8);
+			std::vector<uint8_t> ip = build_ip_packet(peerIpAddress, myIpAddress, PROTO_UDP, length);
+			int payload = length - 20;
+			int start = 0;
+
+			ip[4] = round;
+			ip[5] = d;
+			ip[6] = 0;
+			while (start < payload){
+				int end = std::min(payload, start + 8 * (1 + rand() % 200));
+				if (start == 0 && end == payload)							// At least two fragments
+					end = 8 * ((payload - 1) / 8);
+				fragments.push_back(build_fragment(ip, start, end, end != payload));
+				if (rand() % 4 == 0 && start > 8){						// Overlaps the previous fragment
+					int overlapStart = start - 8 * (1 + rand() % (start / 8 - 1));
+					fragments.push_back(build_fragment(ip, overlapStart, end, end != payload));
+				}
+				if (rand() % 8 == 0)									// Duplicated
+					fragments.push_back(fragments.back());
+				start = end;
+			}
+
+			ip[6] = 0;
+			ip[7] = 0;
+			uint16_t checksum = ip_checksum(ip);
+			ip[10] = checksum >> 8;
+			ip[11] = checksum & 0xFF;
+			expected.push_back(ip);
+		}
 
+		if (round % 2 == 0){												// A packet that is not a fragment, no Ethernet padding
+			std::vector<uint8_t> ip = build_ip_packet(peerIpAddress, myIpAddress, PROTO_TCP, 46 + rand() % 1454);
+			ip[4] = round;
+			ip[5] = 0xFF;
+			fragments.push_back(ip);
+			expected.push_back(ip);
+		}
 
-	while (count < 500) {
+		for (int f = fragments.size() - 1; f > 0; f--)						// Out of order and interleaved
+			std::swap(fragments[f], fragments[rand() % (f + 1)]);
+		for (size_t f = 0; f < fragments.size(); f++)
+			send_frame(fragments[f], inputStream);
+		run_until_empty(inputStream, outputStream, vlanTable, output, 300);
+	}
 
-		pcap2stream_step(input_file, false ,ipRxData);
+	/* An incomplete datagram must be given up, a late fragment does not resurrect it */
+	std::vector<uint8_t> lost = build_ip_packet(peerIpAddress, myIpAddress, PROTO_UDP, 20 + 1600);
+	lost[4] = 0xEE;
+	lost[5] = 0xEE;
+	std::vector<uint8_t> firstHalf = build_fragment(lost, 0, 800, true);
+	std::vector<uint8_t> secondHalf = build_fragment(lost, 800, 1600, false);
+	send_frame(firstHalf, inputStream);
+	run_until_empty(inputStream, outputStream, vlanTable, output, REASSEMBLY_TIMEOUT + 10);
+	send_frame(secondHalf, inputStream);
+	run_until_empty(inputStream, outputStream, vlanTable, output, REASSEMBLY_TIMEOUT + 10);
+
+	/* A late duplicate of a sent datagram is dropped at once, the same identification
+	   is a new datagram once REASSEMBLY_TIMEOUT has passed */
+	std::vector<uint8_t> sent = build_ip_packet(peerIpAddress, myIpAddress, PROTO_UDP, 20 + 1600);
+	sent[4] = 0xDD;
+	sent[5] = 0xDD;
+	std::vector<uint8_t> sentFirst = build_fragment(sent, 0, 800, true);
+	std::vector<uint8_t> sentSecond = build_fragment(sent, 800, 1600, false);
+	send_frame(sentFirst, inputStream);
+	send_frame(sentSecond, inputStream);
+	run_until_empty(inputStream, outputStream, vlanTable, output, 300);
+	sent[6] = 0;
+	sent[7] = 0;
+	uint16_t sentChecksum = ip_checksum(sent);
+	sent[10] = sentChecksum >> 8;
+	sent[11] = sentChecksum & 0xFF;
+	expected.push_back(sent);
+
+	while (!dropReports.empty())
+		dropReports.read();
+	send_frame(sentSecond, inputStream);
+	run_until_empty(inputStream, outputStream, vlanTable, output, 64);
+#if (DROP_REPORTS)
+	if (dropReports.empty() || dropReports.read().reason != DROP_PH_FRAGMENT){
+		cout << "Reassembly: late duplicate not dropped" << endl;
+		errors++;
+	}
+#endif
+
+	run_until_empty(inputStream, outputStream, vlanTable, output, REASSEMBLY_TIMEOUT + 10);
+	std::vector<uint8_t> reused = build_ip_packet(peerIpAddress, myIpAddress, PROTO_UDP, 20 + 1000);
+	reused[4] = 0xDD;
+	reused[5] = 0xDD;
+	std::vector<uint8_t> reusedFirst = build_fragment(reused, 0, 504, true);
+	std::vector<uint8_t> reusedSecond = build_fragment(reused, 504, 1000, false);
+	send_frame(reusedSecond, inputStream);
+	send_frame(reusedFirst, inputStream);
+	run_until_empty(inputStream, outputStream, vlanTable, output, 300);
+	reused[6] = 0;
+	reused[7] = 0;
+	uint16_t reusedChecksum = ip_checksum(reused);
+	reused[10] = reusedChecksum >> 8;
+	reused[11] = reusedChecksum & 0xFF;
+	expected.push_back(reused);
+
+	if (output.size() != expected.size()){
+		cout << "Reassembly: received " << dec << output.size() << " packets, expected " << expected.size() << endl;
+		errors++;
+	}
 
-		icmp_server(
-			ipRxData,
-			in_checksum,
-			out_checksum,
-			in_packet_to_checksum,
-			out_packet_to_checksum,
-			ipTxData);
+	for (size_t o = 0; o < output.size(); o++){
+		bool found = false;
+		for (size_t e = 0; e < expected.size(); e++){
+			if (output[o].size() >= 20 && expected[e][4] == output[o][4] && expected[e][5] == output[o][5]){
+				found = true;
+				if (output[o] != expected[e]){
+					cout << "Reassembly: datagram " << dec << (int) output[o][4] << "." << (int) output[o][5];
+					cout << " mismatch, length " << output[o].size() << " expected " << expected[e].size() << endl;
+					errors++;
+				}
+				expected.erase(expected.begin() + e);
+				break;
+			}
+		}
+		if (!found){
+			cout << "Reassembly: unexpected packet " << dec << o << " id " << (int) output[o][4] << "." << (int) output[o][5] << " length " << output[o].size() << endl;
+			errors++;
+		}
+	}
 
-		compute_checksum(	
-			in_packet_to_checksum,
-			in_checksum,
-			0);
+	cout << "Reassembly: " << dec << output.size() << " datagrams checked" << endl;
+	return errors;
+}
 
-		compute_checksum(	
-			out_packet_to_checksum,
-			out_checksum,
-			1);
+/*
+ * One packet for each reason packet_handler drops for, every one of them
+ * must give a single report with its reason
+ */
+int drop_reason_test() {
+
+	stream<axiWordIn>			inputStream("dropInput");
+	stream<axiWordOut>			outputStream("dropOutput");
+	vlanInterface				vlanTable[NUM_VLAN_INTERFACES];
+	ap_uint<32>					myIpAddress = 0x0500a8c0;			// 192.168.0.5
+	ap_uint<32>					peerIpAddress = 0x0a00a8c0;			// 192.168.0.10
+	std::vector<std::vector<uint8_t> > output;
+	int 						errors = 0;
+
+	for (int m = 0; m < NUM_VLAN_INTERFACES; m++){
+		vlanTable[m].valid 		= (m == 0);
+		vlanTable[m].vlanID 	= 100 + m;
+		vlanTable[m].ipAddress 	= myIpAddress;
+	}
+	while (!dropReports.empty())
+		dropReports.read();
+
+	const char* names[] = {"unknown Ethernet type", "unknown IP protocol", "IP version 6", "unknown VLAN", "fragment too big", "incomplete datagram"};
+	dropReason expected[] = {DROP_PH_ETHERTYPE, DROP_PH_PROTOCOL, DROP_PH_PROTOCOL, DROP_PH_VLAN, DROP_PH_FRAGMENT, DROP_PH_REASSEMBLY_TIMEOUT};
+
+	for (int c = 0; c < 6; c++){
+		std::vector<uint8_t> ip = build_ip_packet(peerIpAddress, myIpAddress, PROTO_UDP, 200);
+		std::vector<uint8_t> frame;
+
+		switch (c){
+			case 0:
+				frame = build_frame(ip, 0x86DD, false, 0);
+				break;
+			case 1:
+				ip[9] = 47;												// GRE
+				frame = build_frame(ip, TYPE_IPV4, false, 0);
+				break;
+			case 2:
+				ip[0] = 0x65;
+				frame = build_frame(ip, TYPE_IPV4, false, 0);
+				break;
+			case 3:
+				frame = build_frame(ip, TYPE_IPV4, true, 105);
+				break;
+			case 4:
+				ip = build_fragment(ip, 0, 80, true);
+				ip[6] = 0x20 | ((REASSEMBLY_MAX_BYTES / 8) >> 8);		// Goes past the end of the buffer
+				ip[7] = (REASSEMBLY_MAX_BYTES / 8) & 0xFF;
+				frame = build_frame(ip, TYPE_IPV4, false, 0);
+				break;
+			case 5:
+				ip = build_fragment(ip, 0, 80, true);
+				frame = build_frame(ip, TYPE_IPV4, false, 0);
+				break;
+		}
+		bytes2stream(frame, inputStream);
+		run_until_empty(inputStream, outputStream, vlanTable, output, (c == 5) ? REASSEMBLY_TIMEOUT + 10 : 64);
 
+		if (dropReports.empty()){
+			cout << "Drop reason: " << names[c] << " was not reported" << endl;
+			errors++;
+			continue;
+		}
+		dropReport report = dropReports.read();
+		if (report.reason != expected[c] || report.sessionValid){
+			cout << "Drop reason: " << names[c] << " reported as " << dec << report.reason << " expected " << expected[c] << endl;
+			errors++;
+		}
+		if (!dropReports.empty()){
+			cout << "Drop reason: " << names[c] << " reported more than once" << endl;
+			errors++;
+		}
+	}
 
-			count++;
-		stream2pcap(output_file,false,true,ipTxData,false);
+	if (output.size() != 0){
+		cout << "Drop reason: " << dec << output.size() << " packets were forwarded" << endl;
+		errors++;
 	}
+	cout << "Drop reasons: 6 packets checked" << endl;
+	return errors;
+}
+
+int main(int argc, char **argv) {
 
-	stream2pcap(output_file,false,true,ipTxData,true);
+	int errors = 0;
 
+	errors += vlan_test();
+	errors += reassembly_test();
+#if (DROP_REPORTS)
+	errors += drop_reason_test();
+#else
+	cout << "DROP_REPORTS is disabled, drop reasons not tested" << endl;
+#endif
 
-	return 0;
+	return errors;
 }
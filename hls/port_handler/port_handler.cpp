@@ -34,19 +34,28 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "port_handler.hpp"
 
-template<unsigned int bitWidth>
-ap_uint<bitWidth> byteSwap(ap_uint<bitWidth> inputVector) {
-    ap_uint<bitWidth> aux = 0;
-    for (unsigned int m = 0 ; m < bitWidth ; m+= 8)
-        aux(bitWidth-m-1,bitWidth-m-8) = inputVector(m+7,m);
-    return aux;
-}
 
 
 
 
 /**
- * @brief      Enable the tuser signal when the source port is in the proper range.
+ * @brief      Expands a prefix length into a mask in network byte order
+ *
+ * @param      prefix  Number of most significant bits to compare
+ *
+ * @return     The mask as it is in the packet
+ */
+ap_uint<32> prefix2mask(ap_uint<6> prefix) {
+    ap_uint<32> mask = 0;
+    for (unsigned int m = 0 ; m < 32 ; m++)
+        mask.bit(31-m) = (m < prefix) ? 1 : 0;
+    return byteSwap<32>(mask);
+}
+
+/**
+ * @brief      Steers the packets to a destination given by the highest priority rule
+ *             that matches its IP addresses, protocol and ports. When no rule matches
+ *             the packet goes to the default destination.
  *             At this point the packets are at ip level
  *
  *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -74,17 +83,28 @@ ap_uint<bitWidth> byteSwap(ap_uint<bitWidth> inputVector) {
  * |                    Options                    |    Padding    |   320-351  |        
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+            -        
  *
+ *
  * @param      dataIn        The data in
- * @param      dataOut       The data out
- * @param      portRangeMin  The port range minimum
- * @param      portRangeMax  The port range maximum
+ * @param      dataOut       The data out, tdest is the destination of the packet
+ * @param      ruleIn        Rule to be written in the table
+ * @param      ruleIndex     Position (priority) of the rule to be written
+ * @param      ruleCommit    Every toggle writes ruleIn in the position ruleIndex
+ * @param      defaultDest   Destination when no rule matches
+ * @param      ruleHits      Number of packets that matched each rule. The counters live in registers
+ *                           and are copied here one entry per cycle, so an entry can be up to
+ *                           NUM_STEERING_RULES cycles old
+ * @param      missHits      Number of packets that did not match any rule
  */
 
 void port_handler(
             stream<axiWord>&            dataIn,
             stream<axiWordOut>&         dataOut,
-            ap_uint<16>&                portRangeMin,
-            ap_uint<16>&                portRangeMax) {
+            steeringRule&               ruleIn,
+            ap_uint<6>&                 ruleIndex,
+            ap_uint<1>&                 ruleCommit,
+            phDest&                     defaultDest,
+            ap_uint<32>                 ruleHits[NUM_STEERING_RULES],
+            ap_uint<32>&                missHits) {
 
 #pragma HLS INTERFACE ap_ctrl_none port=return
 #pragma HLS pipeline II=1
@@ -93,22 +113,105 @@ void port_handler(
 #pragma HLS INTERFACE axis register both port=dataOut name=m_axis
 
 
-#pragma HLS INTERFACE s_axilite port=portRangeMin bundle=portRange
-#pragma HLS INTERFACE s_axilite port=portRangeMax bundle=portRange
+#pragma HLS INTERFACE s_axilite port=ruleIn bundle=steering
+#pragma HLS INTERFACE s_axilite port=ruleIndex bundle=steering
+#pragma HLS INTERFACE s_axilite port=ruleCommit bundle=steering
+#pragma HLS INTERFACE s_axilite port=defaultDest bundle=steering
+#pragma HLS INTERFACE s_axilite port=ruleHits bundle=steering
+#pragma HLS INTERFACE s_axilite port=missHits bundle=steering
 
     enum ph_states {FIRST_WORD, REMAINING_WORDS};
     static ph_states ph_fsm_state = FIRST_WORD;
-    static ap_uint<1>  destination;
+    static phDest       destination;
+    static steeringEntry rules[NUM_STEERING_RULES];
+#pragma HLS ARRAY_PARTITION variable=rules complete dim=1
+    static ap_uint<32>  hitCounters[NUM_STEERING_RULES];
+#pragma HLS ARRAY_PARTITION variable=hitCounters complete dim=1
+    static ap_uint<32>  missCounter = 0;
+    static ap_uint<1>   ruleCommit_r = 0;
+    static ap_uint<6>   hitsCopyIndex = 0;
+
     axiWord     currWord;
     axiWordOut  sendWord;
+    ap_uint<4>  ipHeaderLength;
+    ap_uint<32> srcIpAddress;
+    ap_uint<32> dstIpAddress;
+    ap_uint<8>  protocol;
+    ap_uint<32> l4Ports;
     ap_uint<16> srcPort;
+    ap_uint<16> dstPort;
+    ap_uint<NUM_STEERING_RULES> ruleMatch;
+    ap_uint<6>  ruleHit = 0;
+    bool        hit = false;
+
+    if (ruleCommit != ruleCommit_r){            // A new rule has been written over AXI-Lite
+        rules[ruleIndex].valid          = ruleIn.valid;
+        rules[ruleIndex].srcIpAddress   = ruleIn.srcIpAddress;
+        rules[ruleIndex].srcIpMask      = prefix2mask(ruleIn.srcIpPrefix);
+        rules[ruleIndex].dstIpAddress   = ruleIn.dstIpAddress;
+        rules[ruleIndex].dstIpMask      = prefix2mask(ruleIn.dstIpPrefix);
+        rules[ruleIndex].srcPortMin     = ruleIn.srcPortMin;
+        rules[ruleIndex].srcPortMax     = ruleIn.srcPortMax;
+        rules[ruleIndex].dstPortMin     = ruleIn.dstPortMin;
+        rules[ruleIndex].dstPortMax     = ruleIn.dstPortMax;
+        rules[ruleIndex].protocol       = ruleIn.protocol;
+        rules[ruleIndex].anyProtocol    = ruleIn.anyProtocol;
+        rules[ruleIndex].dest           = ruleIn.dest;
+        hitCounters[ruleIndex]          = 0;
+        ruleCommit_r = ruleCommit;
+    }
 
     switch (ph_fsm_state){
         case FIRST_WORD :
             if (!dataIn.empty()){
                 dataIn.read(currWord);
-                srcPort = byteSwap<16>(currWord.data(175,160)); // Get destination port
-                destination = ((srcPort >= portRangeMin) && (srcPort <= portRangeMax)) ? 1 : 0;  // Check if the port falls into the range
+                ipHeaderLength  = currWord.data(3,0);
+                protocol        = currWord.data(79,72);
+                srcIpAddress    = currWord.data(127,96);
+                dstIpAddress    = currWord.data(159,128);
+                switch (ipHeaderLength) {                           // The ports are right after the IP header
+                    case 6 : l4Ports = currWord.data(223,192); break;
+                    case 7 : l4Ports = currWord.data(255,224); break;
+                    case 8 : l4Ports = currWord.data(287,256); break;
+                    case 9 : l4Ports = currWord.data(319,288); break;
+                    case 10: l4Ports = currWord.data(351,320); break;
+                    case 11: l4Ports = currWord.data(383,352); break;
+                    case 12: l4Ports = currWord.data(415,384); break;
+                    case 13: l4Ports = currWord.data(447,416); break;
+                    case 14: l4Ports = currWord.data(479,448); break;
+                    case 15: l4Ports = currWord.data(511,480); break;
+                    default: l4Ports = currWord.data(191,160); break;
+                }
+                srcPort = byteSwap<16>(l4Ports(15, 0));             // Get source port
+                dstPort = byteSwap<16>(l4Ports(31,16));             // Get destination port
+
+                rule_match: for (unsigned int m = 0 ; m < NUM_STEERING_RULES ; m++){
+                #pragma HLS UNROLL
+                    ruleMatch.bit(m) = rules[m].valid &&
+                            ((srcIpAddress & rules[m].srcIpMask) == (rules[m].srcIpAddress & rules[m].srcIpMask)) &&
+                            ((dstIpAddress & rules[m].dstIpMask) == (rules[m].dstIpAddress & rules[m].dstIpMask)) &&
+                            (rules[m].anyProtocol || (protocol == rules[m].protocol)) &&
+                            (srcPort >= rules[m].srcPortMin) && (srcPort <= rules[m].srcPortMax) &&
+                            (dstPort >= rules[m].dstPortMin) && (dstPort <= rules[m].dstPortMax);
+                }
+
+                rule_priority: for (int m = NUM_STEERING_RULES-1 ; m >= 0 ; m--){     // The lowest index wins
+                #pragma HLS UNROLL
+                    if (ruleMatch.bit(m)){
+                        ruleHit = m;
+                        hit = true;
+                    }
+                }
+
+                if (hit){
+                    destination = rules[ruleHit].dest;
+                    hitCounters[ruleHit]++;
+                }
+                else {
+                    destination = defaultDest;
+                    missCounter++;
+                }
+                missHits = missCounter;
                 //std::cout << "Port " << std::dec << srcPort << " dst " << destination << std::endl;
                 // Create the output word 
                 sendWord.data = currWord.data;
@@ -139,4 +242,6 @@ void port_handler(
             break;
     }
 
+    ruleHits[hitsCopyIndex] = hitCounters[hitsCopyIndex];       // A single write per cycle to the AXI-Lite RAM
+    hitsCopyIndex = (hitsCopyIndex == NUM_STEERING_RULES-1) ? 0 : hitsCopyIndex + 1;
 }
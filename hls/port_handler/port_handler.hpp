@@ -42,18 +42,75 @@ using namespace std;
 #define _PORT_HANDLER_HPP_
 
 
+template<unsigned int bitWidth>
+ap_uint<bitWidth> byteSwap(ap_uint<bitWidth> inputVector) {
+    ap_uint<bitWidth> aux = 0;
+    for (unsigned int m = 0 ; m < bitWidth ; m+= 8)
+        aux(bitWidth-m-1,bitWidth-m-8) = inputVector(m+7,m);
+    return aux;
+}
+
+#define NUM_STEERING_RULES  64
+#define PH_DEST_WIDTH       4
+
+typedef ap_uint<PH_DEST_WIDTH>  phDest;
+
 struct axiWordOut {
 	ap_uint<512>	data;
 	ap_uint<64>		keep;
 	ap_uint<1>		last;
-	ap_uint<1>		dest;
+	phDest			dest;
+};
+
+/**
+ * Flow-steering rule as it is written over AXI-Lite. A packet matches when all the
+ * fields match, the IP addresses are compared on the prefix length most significant
+ * bits (0 is a wildcard) and the ports on an inclusive range. Addresses are in
+ * network byte order as they are in the packet. Lower index means higher priority.
+ */
+struct steeringRule {
+	ap_uint<1>		valid;
+	ap_uint<32>		srcIpAddress;
+	ap_uint<6>		srcIpPrefix;
+	ap_uint<32>		dstIpAddress;
+	ap_uint<6>		dstIpPrefix;
+	ap_uint<16>		srcPortMin;
+	ap_uint<16>		srcPortMax;
+	ap_uint<16>		dstPortMin;
+	ap_uint<16>		dstPortMax;
+	ap_uint<8>		protocol;
+	ap_uint<1>		anyProtocol;
+	phDest			dest;
+};
+
+/**
+ * Rule in the internal table, the prefixes are already expanded to masks so the
+ * match logic is only comparators
+ */
+struct steeringEntry {
+	ap_uint<1>		valid;
+	ap_uint<32>		srcIpAddress;
+	ap_uint<32>		srcIpMask;
+	ap_uint<32>		dstIpAddress;
+	ap_uint<32>		dstIpMask;
+	ap_uint<16>		srcPortMin;
+	ap_uint<16>		srcPortMax;
+	ap_uint<16>		dstPortMin;
+	ap_uint<16>		dstPortMax;
+	ap_uint<8>		protocol;
+	ap_uint<1>		anyProtocol;
+	phDest			dest;
 };
 
 
 void port_handler(
             stream<axiWord>&            dataIn,
             stream<axiWordOut>&         dataOut,
-            ap_uint<16>&                portRangeMin,
-            ap_uint<16>&                portRangeMax);
+            steeringRule&               ruleIn,
+            ap_uint<6>&                 ruleIndex,
+            ap_uint<1>&                 ruleCommit,
+            phDest&                     defaultDest,
+            ap_uint<32>                 ruleHits[NUM_STEERING_RULES],
+            ap_uint<32>&                missHits);
 
 #endif
\ No newline at end of file
@@ -36,43 +36,232 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "port_handler.hpp"
 #include <map>
 #include <string>
+#include <vector>
+#include <sys/time.h>
 #include "../TOE/testbench/pcap2stream.hpp"
 
+struct ruleConfig {
+    steeringRule            ruleIn;
+    ap_uint<6>              ruleIndex;
+    ap_uint<1>              ruleCommit;
+    phDest                  defaultDest;
+    ap_uint<32>             ruleHits[NUM_STEERING_RULES];
+    ap_uint<32>             missHits;
+};
+
+/* Write one rule through the AXI-Lite registers, one call with no traffic */
+void write_rule(ruleConfig& cfg, unsigned int index, steeringRule rule, stream<axiWord>& dataIn, stream<axiWordOut>& dataOut){
+    cfg.ruleIn      = rule;
+    cfg.ruleIndex   = index;
+    cfg.ruleCommit  = !cfg.ruleCommit;
+    port_handler(dataIn, dataOut, cfg.ruleIn, cfg.ruleIndex, cfg.ruleCommit, cfg.defaultDest, cfg.ruleHits, cfg.missHits);
+}
+
+steeringRule wildcard_rule(){
+    steeringRule rule;
+    rule.valid          = 1;
+    rule.srcIpAddress   = 0;
+    rule.srcIpPrefix    = 0;
+    rule.dstIpAddress   = 0;
+    rule.dstIpPrefix    = 0;
+    rule.srcPortMin     = 0;
+    rule.srcPortMax     = 0xFFFF;
+    rule.dstPortMin     = 0;
+    rule.dstPortMax     = 0xFFFF;
+    rule.protocol       = 0;
+    rule.anyProtocol    = 1;
+    rule.dest           = 0;
+    return rule;
+}
+
+steeringRule random_rule(){
+    steeringRule rule = wildcard_rule();
+    ap_uint<16> a, b;
+
+    rule.srcIpAddress   = 0x0000000a | (ap_uint<32>(rand() % 4) << 8);      // 10.0.x.0
+    rule.srcIpPrefix    = (rand() % 2) ? 24 : 0;
+    rule.dstIpAddress   = 0x0000a8c0;                                       // 192.168.x.x
+    rule.dstIpPrefix    = (rand() % 2) ? 16 : 0;
+    a = rand() % 2048; b = rand() % 2048;
+    rule.srcPortMin     = (a < b) ? a : b;
+    rule.srcPortMax     = (a < b) ? b : a;
+    a = rand() % 2048; b = rand() % 2048;
+    rule.dstPortMin     = (a < b) ? a : b;
+    rule.dstPortMax     = (a < b) ? b : a;
+    rule.anyProtocol    = rand() % 2;
+    rule.protocol       = (rand() % 2) ? 6 : 17;
+    rule.dest           = rand() % (1 << PH_DEST_WIDTH);
+    return rule;
+}
+
+/* Software model, first rule that matches */
+int reference_match(std::vector<steeringRule>& rules, ap_uint<32> srcIp, ap_uint<32> dstIp, ap_uint<8> protocol, ap_uint<16> srcPort, ap_uint<16> dstPort){
+    for (unsigned int m = 0 ; m < rules.size() ; m++){
+        steeringRule& r = rules[m];
+        unsigned int srcMask = r.srcIpPrefix == 0 ? 0 : (0xFFFFFFFFu << (32 - r.srcIpPrefix));
+        unsigned int dstMask = r.dstIpPrefix == 0 ? 0 : (0xFFFFFFFFu << (32 - r.dstIpPrefix));
+        unsigned int srcHost = byteSwap<32>(srcIp);
+        unsigned int dstHost = byteSwap<32>(dstIp);
+        if (r.valid &&
+                ((srcHost & srcMask) == (byteSwap<32>(r.srcIpAddress) & srcMask)) &&
+                ((dstHost & dstMask) == (byteSwap<32>(r.dstIpAddress) & dstMask)) &&
+                (r.anyProtocol || protocol == r.protocol) &&
+                srcPort >= r.srcPortMin && srcPort <= r.srcPortMax &&
+                dstPort >= r.dstPortMin && dstPort <= r.dstPortMax)
+            return m;
+    }
+    return -1;
+}
+
+/* Minimum size TCP/UDP packet, optionally with IP options */
+void write_packet(stream<axiWord>& dataIn, ap_uint<32> srcIp, ap_uint<32> dstIp, ap_uint<8> protocol, ap_uint<16> srcPort, ap_uint<16> dstPort, int words){
+    axiWord     currWord;
+    ap_uint<4>  ihl = 5 + (rand() % 2) * (rand() % 11);
+    int         l4 = ihl * 32;
+
+    for (int w = 0 ; w < words ; w++){
+        currWord.data = 0;
+        if (w == 0){
+            currWord.data(3,0)      = ihl;
+            currWord.data(7,4)      = 4;
+            currWord.data(79,72)    = protocol;
+            currWord.data(127,96)   = srcIp;
+            currWord.data(159,128)  = dstIp;
+            currWord.data(l4+15,l4)     = byteSwap<16>(srcPort);
+            currWord.data(l4+31,l4+16)  = byteSwap<16>(dstPort);
+        }
+        currWord.keep = 0xFFFFFFFFFFFFFFFF;
+        currWord.last = (w == words-1);
+        dataIn.write(currWord);
+    }
+}
 
 int main(int argc, char **argv) {
 
     stream<axiWord>         inputStream("inputStream");
     stream<axiWordOut>      outputStream("outputStream");
-    ap_uint<16>             portRangeMin = 5030;
-    ap_uint<16>             portRangeMax = 5064;
+    ruleConfig              cfg;
     axiWordOut              currWord;
+    std::vector<steeringRule> rules;
+    std::vector<int>        expectedDest;
+    std::vector<unsigned int> expectedHits(NUM_STEERING_RULES, 0);
+    int                     errors = 0;
 
-    if (argc < 2) {
-        cerr << "[ERROR] missing arguments " __FILE__  << " <INPUT_PCAP_FILE>" << endl;;
-        return -1;
+    srand(11);
+    cfg.ruleCommit  = 0;
+    cfg.defaultDest = 0;
+    for (int m = 0 ; m < NUM_STEERING_RULES ; m++)
+        cfg.ruleHits[m] = 0;
+
+    /* Functional test: random rules against the software model */
+    for (int m = 0 ; m < NUM_STEERING_RULES ; m++){
+        steeringRule rule = random_rule();
+        rule.valid = (rand() % 8) != 0;
+        rules.push_back(rule);
+        write_rule(cfg, m, rule, inputStream, outputStream);
     }
-    char  *input_file;
-    input_file  = argv[1];
+    cfg.defaultDest = 0xF;
+
+    for (int p = 0 ; p < 20000 ; p++){
+        ap_uint<32> srcIp   = 0x0000000a | (ap_uint<32>(rand() % 5) << 8) | (ap_uint<32>(rand() % 256) << 24);
+        ap_uint<32> dstIp   = (rand() % 4) ? ap_uint<32>(0x0000a8c0 | (rand() << 16)) : ap_uint<32>(rand());
+        ap_uint<8>  proto   = (rand() % 2) ? 6 : 17;
+        ap_uint<16> srcPort = rand() % 2048;
+        ap_uint<16> dstPort = rand() % 2048;
+        int         match   = reference_match(rules, srcIp, dstIp, proto, srcPort, dstPort);
 
-    pcap2stream(input_file, 0, inputStream);    // Fill the inputStream with the packets in the pcap file
+        write_packet(inputStream, srcIp, dstIp, proto, srcPort, dstPort, 1 + rand() % 3);
+        expectedDest.push_back(match < 0 ? (int) cfg.defaultDest : (int) rules[match].dest);
+        if (match >= 0)
+            expectedHits[match]++;
+    }
 
+    unsigned int packetCounter = 0;
     while (!inputStream.empty()){
-        port_handler(
-                inputStream,
-                outputStream,
-                portRangeMin,
-                portRangeMax);
+        port_handler(inputStream, outputStream, cfg.ruleIn, cfg.ruleIndex, cfg.ruleCommit, cfg.defaultDest, cfg.ruleHits, cfg.missHits);
+        while (!outputStream.empty()){
+            outputStream.read(currWord);
+            if (currWord.dest.to_int() != expectedDest[packetCounter]){
+                cout << "Packet [" << setw(5) << dec << packetCounter << "] dest " << currWord.dest << " expected " << expectedDest[packetCounter] << endl;
+                errors++;
+            }
+            if (currWord.last)
+                packetCounter++;
+        }
     }
+    for (int m = 0 ; m < NUM_STEERING_RULES ; m++)         // ruleHits is refreshed one entry per call
+        port_handler(inputStream, outputStream, cfg.ruleIn, cfg.ruleIndex, cfg.ruleCommit, cfg.defaultDest, cfg.ruleHits, cfg.missHits);
 
+    for (int m = 0 ; m < NUM_STEERING_RULES ; m++){
+        if (cfg.ruleHits[m] != expectedHits[m]){
+            cout << "Rule [" << dec << m << "] hits " << cfg.ruleHits[m] << " expected " << expectedHits[m] << endl;
+            errors++;
+        }
+    }
+    cout << "Functional test packets " << dec << packetCounter << " misses " << cfg.missHits << " errors " << errors << endl;
 
-    unsigned int packetCounter = 0;
-    while(!outputStream.empty()){
-        outputStream.read(currWord);
-        //cout << "Packet [" << setw(5)  << dec << packetCounter << "] dest " << currWord.dest << endl;
-        if (currWord.last)
-            packetCounter++;
+    /* Benchmark: C-simulation time against the number of active rules. Every call takes one word, so
+       the cycles here always equal the words, the II=1 of the hardware is checked in the synthesis report */
+    cout << endl << "Rules\tPackets\tWords\tCycles\tWords/cycle\tus/packet (csim)" << endl;
+    for (int activeRules = 1 ; activeRules <= NUM_STEERING_RULES ; activeRules *= 2){
+        const int       benchPackets = 50000;
+        unsigned int    words = 0;
+        unsigned int    cycles = 0;
+        struct timeval  start, end;
+
+        for (int m = 0 ; m < NUM_STEERING_RULES ; m++){
+            steeringRule rule = random_rule();
+            rule.valid = m < activeRules;
+            write_rule(cfg, m, rule, inputStream, outputStream);
+        }
+        for (int p = 0 ; p < benchPackets ; p++){
+            int pktWords = 1 + rand() % 4;
+            write_packet(inputStream, rand(), rand(), 6, rand() % 2048, rand() % 2048, pktWords);
+            words += pktWords;
+        }
+
+        gettimeofday(&start, NULL);
+        while (!inputStream.empty()){
+            port_handler(inputStream, outputStream, cfg.ruleIn, cfg.ruleIndex, cfg.ruleCommit, cfg.defaultDest, cfg.ruleHits, cfg.missHits);
+            cycles++;
+            while (!outputStream.empty())
+                outputStream.read(currWord);
+        }
+        gettimeofday(&end, NULL);
+
+        double elapsed = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_usec - start.tv_usec);
+        cout << dec << activeRules << "\t" << benchPackets << "\t" << words << "\t" << cycles << "\t";
+        cout << fixed << setprecision(3) << (double) words / cycles << "\t\t" << elapsed / benchPackets << endl;
+    }
+
+    /* Optional capture, steer the iperf port range like the former single range configuration */
+    if (argc >= 2) {
+        char  *input_file = argv[1];
+        steeringRule rule = wildcard_rule();
+        rule.srcPortMin = 5030;
+        rule.srcPortMax = 5064;
+        rule.dest       = 1;
+        write_rule(cfg, 0, rule, inputStream, outputStream);
+        rule.valid      = 0;
+        for (int m = 1 ; m < NUM_STEERING_RULES ; m++)
+            write_rule(cfg, m, rule, inputStream, outputStream);
+        cfg.defaultDest = 0;
+
+        pcap2stream(input_file, 0, inputStream);    // Fill the inputStream with the packets in the pcap file
+
+        while (!inputStream.empty()){
+            port_handler(inputStream, outputStream, cfg.ruleIn, cfg.ruleIndex, cfg.ruleCommit, cfg.defaultDest, cfg.ruleHits, cfg.missHits);
+        }
+
+        packetCounter = 0;
+        while(!outputStream.empty()){
+            outputStream.read(currWord);
+            if (currWord.last)
+                packetCounter++;
+        }
+        cout << "Capture packets " << dec << packetCounter << " steered to 1: " << cfg.ruleHits[0] << endl;
     }
 
-    return 0;
+    return errors;
 
 }
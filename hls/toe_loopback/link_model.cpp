@@ -0,0 +1,136 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "link_model.hpp"
+#include "../TOE/common_utilities/common_utilities.hpp"
+
+linkModel::linkModel(const linkProfile& profile)
+	: _profile(profile), _random(profile.seed), _bufferBytes(0), _linkFree(0), _order(0), _outgoingWord(0)
+{
+	_incoming.bytes = 0;
+	_outgoing.bytes = 0;
+}
+
+bool linkModel::chance(double probability)
+{
+	if (probability <= 0)
+		return false;
+	return std::uniform_real_distribution<double>(0.0, 1.0)(_random) < probability;
+}
+
+/*
+ * Switch buffer and serialization. The bytes of a packet stay in the buffer until its
+ * last bit is on the wire, a packet that does not fit is dropped at the tail
+ */
+void linkModel::enqueue(packet& pkt, uint64_t cycle)
+{
+	double 		serialization;
+	uint64_t 	departure;
+	arrival 	first;
+
+	_stats.packetsIn++;
+	_stats.bytesIn += pkt.bytes;
+
+	while (!_buffer.empty() && _buffer.front().departure <= cycle) {
+		_bufferBytes -= _buffer.front().bytes;
+		_buffer.pop_front();
+	}
+	if (_profile.bufferBytes != 0 && (_bufferBytes + pkt.bytes) > _profile.bufferBytes) {
+		_stats.bufferDrops++;
+		return;
+	}
+
+	// Gb/s is bits per ns, CLOCK_PERIOD is in us
+	if (_profile.bandwidth > 0)
+		serialization = (pkt.bytes * 8) / _profile.bandwidth / (CLOCK_PERIOD * 1000);
+	else
+		serialization = pkt.words.size();
+	_linkFree 	= std::max(_linkFree, (double) cycle) + serialization;
+	departure 	= (uint64_t) _linkFree;
+
+	_buffer.push_back(queued{departure, pkt.bytes});
+	_bufferBytes += pkt.bytes;
+	_stats.maxBufferBytes = std::max(_stats.maxBufferBytes, _bufferBytes);
+
+	if (chance(_profile.loss)) {
+		_stats.lost++;
+		return;
+	}
+	first.cycle = departure + _profile.delay;
+	if (chance(_profile.reorder)) {
+		first.cycle += _profile.reorderDelay;
+		_stats.reordered++;
+	}
+	first.order = _order++;
+	first.pkt 	= pkt;
+	if (chance(_profile.duplicate)) {
+		arrival second = first;
+		second.order = _order++;
+		_inFlight.push(second);
+		_stats.duplicated++;
+	}
+	_inFlight.push(first);
+}
+
+void linkModel::step(stream<axiWord>& fromSender, stream<axiWord>& toReceiver, uint64_t cycle)
+{
+	axiWord currWord;
+
+	while (!fromSender.empty()) {
+		fromSender.read(currWord);
+		_incoming.words.push_back(currWord);
+		_incoming.bytes += keep2len(currWord.keep);
+		if (currWord.last) {
+			enqueue(_incoming, cycle);
+			_incoming.words.clear();
+			_incoming.bytes = 0;
+		}
+	}
+
+	if (_outgoingWord == _outgoing.words.size() && !_inFlight.empty() && _inFlight.top().cycle <= cycle) {
+		_outgoing 		= _inFlight.top().pkt;
+		_outgoingWord 	= 0;
+		_inFlight.pop();
+		_stats.packetsOut++;
+		_stats.bytesOut += _outgoing.bytes;
+	}
+	if (_outgoingWord < _outgoing.words.size()) {
+		toReceiver.write(_outgoing.words[_outgoingWord++]);
+	}
+}
+
+bool linkModel::idle() const
+{
+	return _incoming.words.empty() && _inFlight.empty() && (_outgoingWord == _outgoing.words.size());
+}
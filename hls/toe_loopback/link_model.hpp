@@ -0,0 +1,131 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _LINK_MODEL_H_
+#define _LINK_MODEL_H_
+
+#include "../TOE/toe.hpp"
+#include <deque>
+#include <queue>
+#include <random>
+#include <vector>
+
+/** Impairments of one direction of the link, the defaults are a perfect link */
+struct linkProfile {
+	double			bandwidth;			// Gb/s, 0 is the line rate of the interface: one word per cycle
+	uint64_t		delay;				// propagation delay in cycles
+	double			loss;				// probability of losing a packet
+	double			reorder;			// probability of delaying a packet by reorderDelay cycles
+	uint64_t		reorderDelay;
+	double			duplicate;			// probability of delivering a packet twice
+	uint64_t		bufferBytes;		// switch buffer in front of the link, 0 is unbounded
+	uint64_t		seed;
+
+	linkProfile()
+		: bandwidth(0), delay(0), loss(0), reorder(0), reorderDelay(0), duplicate(0), bufferBytes(0), seed(1) {}
+};
+
+struct linkStats {
+	uint64_t		packetsIn;
+	uint64_t		bytesIn;
+	uint64_t		packetsOut;
+	uint64_t		bytesOut;
+	uint64_t		bufferDrops;		// tail drops of the switch buffer
+	uint64_t		lost;
+	uint64_t		reordered;
+	uint64_t		duplicated;
+	uint64_t		maxBufferBytes;
+
+	linkStats()
+		: packetsIn(0), bytesIn(0), packetsOut(0), bytesOut(0), bufferDrops(0), lost(0), reordered(0),
+		  duplicated(0), maxBufferBytes(0) {}
+};
+
+/**
+ * One direction of the wire between two TOEs. Whole packets are taken from the sender,
+ * queued in the switch buffer, serialized at the bandwidth of the link, impaired, and
+ * after the propagation delay handed to the receiver one word per cycle. The random
+ * decisions come from a generator seeded by the profile, a run is reproducible
+ */
+class linkModel {
+	public:
+		linkModel(const linkProfile& profile);
+
+		/* One cycle, it takes every word the sender wrote and delivers at most one */
+		void step(stream<axiWord>& fromSender, stream<axiWord>& toReceiver, uint64_t cycle);
+
+		/* Nothing is in flight */
+		bool idle() const;
+
+		const linkStats& stats() const { return _stats; }
+
+	private:
+		struct packet {
+			std::vector<axiWord>	words;
+			uint64_t				bytes;
+		};
+
+		struct arrival {
+			uint64_t				cycle;
+			uint64_t				order;		// keeps the order of packets arriving in the same cycle
+			packet					pkt;
+
+			bool operator>(const arrival& other) const {
+				return (cycle != other.cycle) ? (cycle > other.cycle) : (order > other.order);
+			}
+		};
+
+		struct queued {
+			uint64_t				departure;	// cycle the last bit leaves the switch
+			uint64_t				bytes;
+		};
+
+		linkProfile 			_profile;
+		linkStats 				_stats;
+		std::mt19937_64 		_random;
+		packet 					_incoming;
+		std::deque<queued> 		_buffer;
+		uint64_t 				_bufferBytes;
+		double 					_linkFree;		// cycle the link finishes the packets already accepted
+		uint64_t 				_order;
+		std::priority_queue<arrival, std::vector<arrival>, std::greater<arrival> > _inFlight;
+		packet 					_outgoing;
+		size_t 					_outgoingWord;
+
+		bool chance(double probability);
+		void enqueue(packet& pkt, uint64_t cycle);
+};
+
+#endif
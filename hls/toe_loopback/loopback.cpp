@@ -0,0 +1,202 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "loopback.hpp"
+#include <dlfcn.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+
+using namespace std;
+
+loopbackScenario::loopbackScenario()
+{
+	client.ipAddress 		= 0xC0A80005;		// 192.168.0.5
+	client.app 				= NODE_IPERF;
+	client.runClient 		= true;
+	client.dstAddress 		= 0xC0A80008;		// 192.168.0.8
+	client.dstPort 			= 5001;
+	client.numConnections 	= 1;
+	client.mss 				= 1460;
+	client.transferSize 	= 1000000;
+	client.runTime 			= 0;
+	client.startCycle 		= 1000;				// the server has its ports open by then
+	client.rtoMin 			= 0;
+	client.memory 			= NODE_MEMORY_IDEAL;
+	profile.reorderDelay 	= 1000;
+	echo 					= false;
+	maxCycles 				= 20000000;
+}
+
+/*
+ * The cores keep their state in static variables, dlopen() of a private copy of the
+ * shared object gives every node its own state
+ */
+bool loadNode(const string& library, toeNode& node)
+{
+	char 			copyName[] = "/tmp/toe_node_XXXXXX";
+	int 			fd = mkstemp(copyName);
+	void* 			handle;
+
+	if (fd < 0) {
+		cerr << "ERROR: can not create a copy of " << library << endl;
+		return false;
+	}
+	close(fd);
+	{
+		ifstream 	src(library.c_str(), ios::binary);
+		ofstream 	dst(copyName, ios::binary);
+		if (!src) {
+			cerr << "ERROR: can not open " << library << endl;
+			unlink(copyName);
+			return false;
+		}
+		dst << src.rdbuf();
+	}
+	handle = dlopen(copyName, RTLD_NOW | RTLD_LOCAL);
+	unlink(copyName);
+	if (handle == NULL) {
+		cerr << "ERROR: " << dlerror() << endl;
+		return false;
+	}
+	node.init 	= (toeNodeInit_t) dlsym(handle, "toe_node_init");
+	node.step 	= (toeNodeStep_t) dlsym(handle, "toe_node_step");
+	node.stats 	= (toeNodeStats_t) dlsym(handle, "toe_node_stats");
+	if (node.init == NULL || node.step == NULL || node.stats == NULL) {
+		cerr << "ERROR: " << library << " is not a toe_node" << endl;
+		return false;
+	}
+	return true;
+}
+
+uint64_t defaultRtoMin(const linkProfile& profile)
+{
+	return 4 * profile.delay + ((profile.reorder > 0) ? profile.reorderDelay : 0) + 2000;
+}
+
+bool runLoopback(const string& library, const loopbackScenario& scenario, loopbackResult& result)
+{
+	toeNodeConfig 		configA = scenario.client;
+	toeNodeConfig 		configB;
+	toeNode 			nodeA;
+	toeNode 			nodeB;
+
+	if (configA.rtoMin == 0)
+		configA.rtoMin = defaultRtoMin(scenario.profile);
+	if (scenario.echo)
+		configA.dstPort = 15000;
+
+	// Node B only answers
+	configB 				= configA;
+	configB.ipAddress 		= configA.dstAddress;
+	configB.dstAddress 		= configA.ipAddress;
+	configB.runClient 		= false;
+	configB.app 			= scenario.echo ? NODE_ECHO : NODE_IPERF;
+
+	if (!loadNode(library, nodeA) || !loadNode(library, nodeB))
+		return false;
+	nodeA.init(&configA);
+	nodeB.init(&configB);
+
+	linkProfile 		profileBA = scenario.profile;
+	profileBA.seed 		= scenario.profile.seed + 1;		// independent impairments in each direction
+	linkModel 			linkAB(scenario.profile);
+	linkModel 			linkBA(profileBA);
+	stream<axiWord> 	txA("txA");
+	stream<axiWord> 	rxA("rxA");
+	stream<axiWord> 	txB("txB");
+	stream<axiWord> 	rxB("rxB");
+
+	uint64_t 			expected 	= (configA.runTime != 0) ? 0 : configA.transferSize;
+	uint64_t 			endCycle 	= (configA.runTime != 0) ? configA.startCycle + configA.runTime : scenario.maxCycles;
+	uint64_t 			tail 		= 0;
+	uint64_t 			cycle;
+	bool 				done 		= false;
+
+	chrono::steady_clock::time_point 	simStart = chrono::steady_clock::now();
+
+	// After the end every bucket of the histograms is polled once more
+	for (cycle = 0; cycle < scenario.maxCycles && tail < 4 * LAT_BUCKETS; cycle++) {
+		nodeA.step(&rxA, &txA, cycle);
+		nodeB.step(&rxB, &txB, cycle);
+		linkAB.step(txA, rxB, cycle);
+		linkBA.step(txB, rxA, cycle);
+
+		if (done) {
+			tail++;
+		}
+		else if (configA.runTime != 0) {
+			done = (cycle >= endCycle) && linkAB.idle() && linkBA.idle();
+		}
+		else if ((cycle % 64) == 0) {
+			nodeB.stats(&result.statsB);
+			nodeA.stats(&result.statsA);
+			done = (result.statsB.appRxBytes >= expected) && (!scenario.echo || result.statsA.appRxBytes >= expected);
+		}
+	}
+	result.simSeconds 	= chrono::duration<double>(chrono::steady_clock::now() - simStart).count();
+	nodeA.stats(&result.statsA);
+	nodeB.stats(&result.statsB);
+
+	uint64_t 			completion 	= max(result.statsB.appRxLastCycle, scenario.echo ? result.statsA.appRxLastCycle : 0);
+
+	result.completed 	= (configA.runTime == 0) ? done : (result.statsB.appRxBytes != 0);
+	result.cycles 		= cycle;
+	result.duration 	= (completion > configA.startCycle) ? completion - configA.startCycle : 0;
+	result.expected 	= expected;
+	result.rtoMin 		= configA.rtoMin;
+	result.linkAB 		= linkAB.stats();
+	result.linkBA 		= linkBA.stats();
+	return true;
+}
+
+double gbps(uint64_t bytes, uint64_t cycles)
+{
+	return (cycles == 0) ? 0 : (bytes * 8) / (cycles * CLOCK_PERIOD * 1000);
+}
+
+uint32_t latencyPercentile(const toeNodeStats& stats, int kind, double p)
+{
+	uint64_t 	samples 	= 0;
+	uint64_t 	cumulative 	= 0;
+
+	for (int b = 0; b < LAT_BUCKETS; b++)
+		samples += stats.latencyCount[kind][b];
+	for (int b = 0; b < LAT_BUCKETS && samples != 0; b++) {
+		cumulative += stats.latencyCount[kind][b];
+		if (cumulative >= p * samples)
+			return stats.latencyLow[b];
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _LOOPBACK_H_
+#define _LOOPBACK_H_
+
+#include "toe_node.hpp"
+#include "link_model.hpp"
+#include <string>
+
+/*
+ * Closed loop of two toe_node copies joined by a link model in each direction, shared by
+ * test_toe_loopback and toe_benchmark. Node A runs the iperf2 client, node B the iperf2
+ * server or the echo server
+ */
+
+struct loopbackScenario {
+	toeNodeConfig		client;				// node A, node B is derived from it
+	linkProfile			profile;			// A to B, B to A uses the next seed
+	bool				echo;				// node B runs the echo server
+	uint64_t			maxCycles;
+
+	loopbackScenario();
+};
+
+struct loopbackResult {
+	bool				completed;			// every byte delivered, or data delivered in a timed run
+	uint64_t			cycles;				// simulated cycles
+	uint64_t			duration;			// from the start of the client to the last delivered word
+	uint64_t			expected;			// bytes B has to receive, 0 in a timed run
+	uint64_t			rtoMin;				// cycles, the one of the scenario or defaultRtoMin()
+	toeNodeStats		statsA;
+	toeNodeStats		statsB;
+	linkStats			linkAB;
+	linkStats			linkBA;
+	double				simSeconds;			// wall-clock time of the simulation
+};
+
+/* Loads a private copy of the toe_node shared object */
+struct toeNode {
+	toeNodeInit_t		init;
+	toeNodeStep_t		step;
+	toeNodeStats_t		stats;
+};
+
+bool loadNode(const std::string& library, toeNode& node);
+
+/* Minimum RTO a profile needs, the TCP timers of the C-simulation are a few cycles long */
+uint64_t defaultRtoMin(const linkProfile& profile);
+
+/* Loads two fresh nodes and runs the scenario, false if the nodes can not be loaded.
+ * Once it is over the nodes idle until their latency histograms are read completely */
+bool runLoopback(const std::string& library, const loopbackScenario& scenario, loopbackResult& result);
+
+double gbps(uint64_t bytes, uint64_t cycles);
+
+/* Lowest latency in cycles of the bucket the percentile p (0 to 1) of a histogram falls in */
+uint32_t latencyPercentile(const toeNodeStats& stats, int kind, double p);
+
+#endif
@@ -0,0 +1,198 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+/*
+ * Closed loop simulation of two TOEs, each one with its application, connected by a link
+ * model in each direction. Node A runs the iperf2 client towards node B, which runs the
+ * iperf2 server or the echo server. The run ends when B received every byte (and A got the
+ * echo back), or when the time of a timed run is over, and reports goodput, retransmissions
+ * completion time and the latency percentiles of node A
+ *
+ *   test_toe_loopback [options]
+ *     --bytes N           bytes of the transfer, split among the connections (default 1000000)
+ *     --time CYCLES       timed run instead of a transfer size
+ *     --connections N     number of connections (default 1)
+ *     --mss N             bytes per segment written by the client (default 1460)
+ *     --echo              node B echoes the data back
+ *     --bandwidth GBPS    bandwidth of the link, 0 is the line rate (default 0)
+ *     --delay CYCLES      propagation delay of the link (default 0)
+ *     --loss P            probability of losing a packet
+ *     --reorder P         probability of delaying a packet by --reorder-delay cycles
+ *     --reorder-delay N   (default 1000)
+ *     --duplicate P       probability of delivering a packet twice
+ *     --buffer BYTES      switch buffer in front of the link, 0 is unbounded (default 0)
+ *     --seed N            seed of the impairments (default 1)
+ *     --rto-min CYCLES    minimum retransmission time-out, C-simulation compresses the TCP
+ *                         timers to a few cycles, by default 4 times the propagation delay
+ *                         plus the reorder delay and 2000 cycles
+ *     --memory TYPE       timing of the buffer memories of both nodes: ideal, ddr4 or hbm
+ *                         (default ideal, the memory answers at once)
+ *     --cycles N          maximum number of cycles (default 20000000)
+ *     --node FILE         toe_node shared object (default libtoe_node.so next to the binary)
+ */
+
+#include "loopback.hpp"
+#include <getopt.h>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+void printLink(const char* name, const linkStats& stats)
+{
+	cout << "  " << name << "\tpackets " << stats.packetsIn << " in, " << stats.packetsOut << " out\tbuffer drops " << stats.bufferDrops;
+	cout << "\tlost " << stats.lost << "\treordered " << stats.reordered << "\tduplicated " << stats.duplicated;
+	cout << "\tmax buffer " << stats.maxBufferBytes << " bytes" << endl;
+}
+
+void printNode(const char* name, const toeNodeStats& stats)
+{
+	cout << "  " << name << "\ttx " << stats.txPackets << " segments " << stats.txBytes << " bytes, " << stats.txRetransmissions << " retransmissions";
+	cout << "\trx " << stats.rxPackets << " segments " << stats.rxBytes << " bytes, " << stats.rxDrops << " drops";
+	cout << "\tapplication " << stats.appRxBytes << " bytes" << endl;
+	if (stats.memoryBytes != 0) {
+		cout << "  " << name << " memory\t" << stats.memoryBytes << " bytes\trow misses " << stats.memoryRowMisses;
+		cout << "\tstall cycles " << stats.memoryStallCycles << endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{"bytes",			required_argument, 0, 'b'},
+		{"time",			required_argument, 0, 't'},
+		{"connections",		required_argument, 0, 'n'},
+		{"mss",				required_argument, 0, 'm'},
+		{"echo",			no_argument,       0, 'e'},
+		{"bandwidth",		required_argument, 0, 'w'},
+		{"delay",			required_argument, 0, 'd'},
+		{"loss",			required_argument, 0, 'l'},
+		{"reorder",			required_argument, 0, 'r'},
+		{"reorder-delay",	required_argument, 0, 'R'},
+		{"duplicate",		required_argument, 0, 'u'},
+		{"buffer",			required_argument, 0, 'B'},
+		{"seed",			required_argument, 0, 's'},
+		{"rto-min",			required_argument, 0, 'o'},
+		{"memory",			required_argument, 0, 'M'},
+		{"cycles",			required_argument, 0, 'c'},
+		{"node",			required_argument, 0, 'N'},
+		{0, 0, 0, 0}
+	};
+	loopbackScenario 	scenario;
+	loopbackResult 		result;
+	string 				library 	= string(argv[0]).substr(0, string(argv[0]).find_last_of('/') + 1) + "libtoe_node.so";
+	toeNodeConfig& 		configA 	= scenario.client;
+	linkProfile& 		profile 	= scenario.profile;
+	int 				opt;
+
+	while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (opt) {
+			case 'b': configA.transferSize 		= strtoul(optarg, NULL, 0); 	break;
+			case 't': configA.runTime 			= strtoull(optarg, NULL, 0); 	break;
+			case 'n': configA.numConnections 	= strtoul(optarg, NULL, 0); 	break;
+			case 'm': configA.mss 				= strtoul(optarg, NULL, 0); 	break;
+			case 'e': scenario.echo 			= true; 						break;
+			case 'w': profile.bandwidth 		= atof(optarg); 				break;
+			case 'd': profile.delay 			= strtoull(optarg, NULL, 0); 	break;
+			case 'l': profile.loss 				= atof(optarg); 				break;
+			case 'r': profile.reorder 			= atof(optarg); 				break;
+			case 'R': profile.reorderDelay 		= strtoull(optarg, NULL, 0); 	break;
+			case 'u': profile.duplicate 		= atof(optarg); 				break;
+			case 'B': profile.bufferBytes 		= strtoull(optarg, NULL, 0); 	break;
+			case 's': profile.seed 				= strtoull(optarg, NULL, 0); 	break;
+			case 'o': configA.rtoMin 			= strtoull(optarg, NULL, 0); 	break;
+			case 'M':
+				if (string(optarg) == "ideal")
+					configA.memory = NODE_MEMORY_IDEAL;
+				else if (string(optarg) == "ddr4")
+					configA.memory = NODE_MEMORY_DDR4;
+				else if (string(optarg) == "hbm")
+					configA.memory = NODE_MEMORY_HBM;
+				else {
+					cerr << "[ERROR] the memory can be ideal, ddr4 or hbm" << endl;
+					return -1;
+				}
+				break;
+			case 'c': scenario.maxCycles 		= strtoull(optarg, NULL, 0); 	break;
+			case 'N': library 					= optarg; 						break;
+			default:
+				cerr << "[ERROR] unknown option, see the header of test_toe_loopback.cpp" << endl;
+				return -1;
+		}
+	}
+	if (configA.numConnections == 0 || configA.numConnections > MAX_SESSIONS) {
+		cerr << "[ERROR] the number of connections has to be between 1 and " << MAX_SESSIONS << endl;
+		return -1;
+	}
+
+	if (!runLoopback(library, scenario, result))
+		return -1;
+
+	const toeNodeStats& statsA = result.statsA;
+	const toeNodeStats& statsB = result.statsB;
+
+	cout << dec << fixed << setprecision(3);
+	cout << "  ------- Loopback ------- " << endl;
+	cout << "  link\tbandwidth " << profile.bandwidth << " Gb/s\tdelay " << profile.delay << " cycles\tloss " << profile.loss;
+	cout << "\treorder " << profile.reorder << "\tduplicate " << profile.duplicate << "\tbuffer " << profile.bufferBytes << " bytes" << endl;
+	cout << "  minimum RTO\t" << result.rtoMin << " cycles" << endl;
+	printLink("A -> B", result.linkAB);
+	printLink("B -> A", result.linkBA);
+	printNode("A", statsA);
+	printNode("B", statsB);
+	cout << "  completion\t" << result.duration << " cycles (" << (result.duration * CLOCK_PERIOD) << " us)";
+	if (configA.runTime == 0)
+		cout << "\tdelivered " << statsB.appRxBytes << " of " << result.expected << " bytes";
+	cout << endl;
+	cout << "  goodput\t" << gbps(statsB.appRxBytes, result.duration) << " Gb/s";
+	if (scenario.echo)
+		cout << ", echo " << gbps(statsA.appRxBytes, result.duration) << " Gb/s";
+	cout << "\tretransmissions " << (statsA.txRetransmissions + statsB.txRetransmissions) << endl;
+#if (LATENCY_HISTOGRAM)
+	// Percentiles are the lower bound of the bucket they fall in
+	const char* latKindNames[2] = {"write to wire", "round trip"};
+	for (int k = 0; k < 2; k++) {
+		cout << "  A " << latKindNames[k] << "\tp50 >= " << latencyPercentile(statsA, k, 0.5);
+		cout << "\tp99 >= " << latencyPercentile(statsA, k, 0.99);
+		cout << "\tp999 >= " << latencyPercentile(statsA, k, 0.999) << " cycles" << endl;
+	}
+#endif
+
+	if (!result.completed) {
+		cout << "ERROR the transfer did not complete in " << scenario.maxCycles << " cycles" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,394 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+/*
+ * Throughput and latency regression benchmark of the TOE. Every scenario is a closed loop
+ * of two fresh toe_node copies (see loopback.hpp), the results are simulated cycles at
+ * CLOCK_PERIOD, so they do not depend on the machine that runs them. The report is written
+ * as JSON and compared against a stored baseline: a scenario regresses when its goodput
+ * or cycles per packet get worse by more than --threshold percent, or a latency percentile
+ * by more than --latency-threshold percent. The percentiles are the lower bound of a bucket
+ * of the latency histogram, four per power of two, one bucket up is already 14 to 25 %
+ *
+ *   toe_benchmark [options]
+ *     --json FILE                 report, - is the standard output, shared with the messages
+ *                                 of the cores (default benchmark.json)
+ *     --baseline FILE             report to compare against, exits with 1 on a regression
+ *     --threshold PCT             (default 5)
+ *     --latency-threshold PCT     (default 25)
+ *     --scenario NAME             runs only this scenario, it can be repeated
+ *     --list                      prints the scenarios
+ *     --node FILE                 toe_node shared object (default libtoe_node.so next to the binary)
+ */
+
+#include "loopback.hpp"
+#include <getopt.h>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct benchmarkScenario {
+	const char*		name;
+	const char*		description;
+	uint32_t		bytes;
+	uint16_t		connections;
+	uint16_t		mss;
+	bool			echo;
+	double			bandwidth;		// Gb/s, 0 is the line rate
+	uint64_t		delay;			// cycles
+	double			loss;
+	double			reorder;
+	uint64_t		bufferBytes;
+	toeNodeMemory	memory;
+};
+
+static const benchmarkScenario scenarios[] = {
+	{"bulk",		"one bulk flow at line rate",						4000000,	1,		1460,	false,	0,		100,	0,		0,		0,		NODE_MEMORY_IDEAL},
+	{"bulk_wan",	"one bulk flow, 40 Gb/s and a long round trip",		2000000,	1,		1460,	false,	40,		2000,	0,		0,		0,		NODE_MEMORY_IDEAL},
+	{"sessions_64",	"64 flows sharing the line rate",					4000000,	64,		1460,	false,	0,		100,	0,		0,		0,		NODE_MEMORY_IDEAL},
+	{"sessions_1k",	"1024 flows sharing the line rate",					16000000,	1024,	1460,	false,	0,		100,	0,		0,		0,		NODE_MEMORY_IDEAL},
+	{"rpc_64B",		"64 B messages echoed back, back to back",				64000,		1,		64,		true,	0,		100,	0,		0,		0,		NODE_MEMORY_IDEAL},
+	{"loss",		"one flow, 40 Gb/s and 0.1 % loss",					2000000,	1,		1460,	false,	40,		1000,	0.001,	0,		0,		NODE_MEMORY_IDEAL},
+	{"reorder",		"one flow, 40 Gb/s and 1 % reordering",				2000000,	1,		1460,	false,	40,		1000,	0,		0.01,	0,		NODE_MEMORY_IDEAL},
+	{"congested",	"4 flows into a 10 Gb/s link with a small buffer",	1000000,	4,		1460,	false,	10,		100,	0,		0,		20000,	NODE_MEMORY_IDEAL},
+	{"loss_hbm",	"the loss scenario with the buffers in HBM",			2000000,	1,		1460,	false,	40,		1000,	0.001,	0,		0,		NODE_MEMORY_HBM},
+};
+static const int NUM_SCENARIOS = sizeof(scenarios) / sizeof(scenarios[0]);
+
+/* Metrics compared against the baseline */
+struct benchmarkMetric {
+	const char*		key;
+	bool			higherIsBetter;
+	bool			latency;
+};
+
+static const benchmarkMetric metrics[] = {
+	{"gbps",				true,	false},
+	{"cycles_per_packet",	false,	false},
+	{"wire_latency_p50",	false,	true},
+	{"wire_latency_p99",	false,	true},
+	{"wire_latency_p999",	false,	true},
+	{"rtt_p50",				false,	true},
+	{"rtt_p99",				false,	true},
+	{"rtt_p999",			false,	true},
+};
+static const int NUM_METRICS = sizeof(metrics) / sizeof(metrics[0]);
+
+typedef map<string, double> 				scenarioReport;
+typedef map<string, scenarioReport> 		benchmarkReport;
+
+/* Every value of the report is a number, the order of the keys is the one of the JSON output */
+void collect(const benchmarkScenario& bench, const loopbackResult& result, vector<pair<string, double> >& values)
+{
+	const toeNodeStats& 	statsA 		= result.statsA;
+	const toeNodeStats& 	statsB 		= result.statsB;
+	uint64_t 				packets 	= result.linkAB.packetsIn + result.linkBA.packetsIn;
+	uint64_t 				delivered 	= statsB.appRxBytes + (bench.echo ? statsA.appRxBytes : 0);
+
+	values.clear();
+	values.push_back(make_pair("completed", result.completed));
+	values.push_back(make_pair("sessions", bench.connections));
+	values.push_back(make_pair("bytes", delivered));
+	values.push_back(make_pair("cycles", result.duration));
+	values.push_back(make_pair("packets", packets));
+	values.push_back(make_pair("cycles_per_packet", (packets == 0) ? 0.0 : (double) result.duration / packets));
+	values.push_back(make_pair("gbps", gbps(delivered, result.duration)));
+	values.push_back(make_pair("retransmissions", statsA.txRetransmissions + statsB.txRetransmissions));
+	values.push_back(make_pair("rx_drops", statsA.rxDrops + statsB.rxDrops));
+	values.push_back(make_pair("wire_latency_p50", latencyPercentile(statsA, 0, 0.5)));
+	values.push_back(make_pair("wire_latency_p99", latencyPercentile(statsA, 0, 0.99)));
+	values.push_back(make_pair("wire_latency_p999", latencyPercentile(statsA, 0, 0.999)));
+	values.push_back(make_pair("rtt_p50", latencyPercentile(statsA, 1, 0.5)));
+	values.push_back(make_pair("rtt_p99", latencyPercentile(statsA, 1, 0.99)));
+	values.push_back(make_pair("rtt_p999", latencyPercentile(statsA, 1, 0.999)));
+	values.push_back(make_pair("memory_bytes", statsA.memoryBytes + statsB.memoryBytes));
+	values.push_back(make_pair("memory_stall_cycles", statsA.memoryStallCycles + statsB.memoryStallCycles));
+	values.push_back(make_pair("sim_seconds", result.simSeconds));
+	values.push_back(make_pair("sim_cycles_per_second", (result.simSeconds == 0) ? 0.0 : result.cycles / result.simSeconds));
+}
+
+/*
+ * Reads the scenarios of a report written by this benchmark, a subset of JSON: the numbers
+ * and booleans of the objects in the "scenarios" array, keyed by their "name"
+ */
+bool readReport(const string& fileName, benchmarkReport& report)
+{
+	ifstream 		file(fileName.c_str());
+	stringstream 	buffer;
+	string 			text;
+	size_t 			pos;
+
+	if (!file) {
+		cerr << "ERROR: can not open " << fileName << endl;
+		return false;
+	}
+	buffer << file.rdbuf();
+	text = buffer.str();
+
+	pos = text.find("\"scenarios\"");
+	pos = (pos == string::npos) ? pos : text.find('[', pos);
+	if (pos == string::npos) {
+		cerr << "ERROR: " << fileName << " has no scenarios" << endl;
+		return false;
+	}
+	pos++;
+	while (true) {
+		size_t 			begin 	= text.find_first_of("{]", pos);
+		size_t 			end;
+		scenarioReport 	values;
+		string 			name;
+
+		if (begin == string::npos || text[begin] == ']')
+			break;
+		end = text.find('}', begin);
+		if (end == string::npos) {
+			cerr << "ERROR: " << fileName << " is truncated" << endl;
+			return false;
+		}
+		// "key": value pairs, separated by commas
+		pos = begin + 1;
+		while (true) {
+			size_t 		keyBegin 	= text.find('"', pos);
+			size_t 		keyEnd;
+			size_t 		value;
+			string 		key;
+
+			if (keyBegin == string::npos || keyBegin > end)
+				break;
+			keyEnd 	= text.find('"', keyBegin + 1);
+			key 	= text.substr(keyBegin + 1, keyEnd - keyBegin - 1);
+			value 	= text.find_first_not_of(" \t\r\n:", keyEnd + 1);
+			if (text[value] == '"') {
+				pos = text.find('"', value + 1) + 1;
+				if (key == "name")
+					name = text.substr(value + 1, pos - value - 2);
+			}
+			else {
+				values[key] = (text.compare(value, 4, "true") == 0) ? 1 :
+							  (text.compare(value, 5, "false") == 0) ? 0 : strtod(text.c_str() + value, NULL);
+				pos = text.find_first_of(",}", value);
+			}
+		}
+		report[name] = values;
+		pos = end + 1;
+	}
+	return true;
+}
+
+void writeReport(ostream& out, const vector<pair<string, vector<pair<string, double> > > >& results)
+{
+	out << dec << setprecision(9);
+	out << "{" << endl;
+	out << "  \"clock_period_us\": " << CLOCK_PERIOD << "," << endl;
+	out << "  \"max_sessions\": " << MAX_SESSIONS << "," << endl;
+	out << "  \"scenarios\": [" << endl;
+	for (size_t s = 0; s < results.size(); s++) {
+		out << "    {\"name\": \"" << results[s].first << "\"";
+		for (size_t v = 0; v < results[s].second.size(); v++) {
+			const pair<string, double>& value = results[s].second[v];
+			out << ", \"" << value.first << "\": ";
+			if (value.first == "completed")
+				out << (value.second ? "true" : "false");
+			else
+				out << value.second;
+		}
+		out << "}" << ((s + 1 < results.size()) ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
+
+/* Returns the number of regressions */
+int compare(const benchmarkReport& current, const benchmarkReport& baseline, double threshold, double latencyThreshold)
+{
+	int 	regressions = 0;
+
+	cout << dec << "  ------- Comparison with the baseline ------- " << endl;
+	for (benchmarkReport::const_iterator s = current.begin(); s != current.end(); s++) {
+		benchmarkReport::const_iterator 	base = baseline.find(s->first);
+
+		if (base == baseline.end()) {
+			cout << "  " << setw(12) << left << s->first << right << " not in the baseline" << endl;
+			continue;
+		}
+		if (s->second.at("completed") == 0) {
+			cout << "  " << setw(12) << left << s->first << right << " REGRESSION did not complete" << endl;
+			regressions++;
+			continue;
+		}
+		for (int m = 0; m < NUM_METRICS; m++) {
+			scenarioReport::const_iterator 	now 	= s->second.find(metrics[m].key);
+			scenarioReport::const_iterator 	before 	= base->second.find(metrics[m].key);
+			double 							limit 	= metrics[m].latency ? latencyThreshold : threshold;
+			double 							change;
+
+			// No samples in the baseline, nothing to compare with
+			if (now == s->second.end() || before == base->second.end() || before->second == 0)
+				continue;
+			change = (now->second - before->second) / before->second * 100;
+			if (metrics[m].higherIsBetter)
+				change = -change;
+			if (change > limit || change < -limit) {
+				cout << "  " << setw(12) << left << s->first << " " << setw(18) << metrics[m].key << right;
+				cout << " " << before->second << " -> " << now->second;
+				if (change > limit) {
+					cout << "\tREGRESSION " << change << " % worse" << endl;
+					regressions++;
+				}
+				else {
+					cout << "\timproved " << -change << " %, update the baseline" << endl;
+				}
+			}
+		}
+	}
+	if (regressions == 0)
+		cout << "  no regressions, thresholds " << threshold << " % and " << latencyThreshold << " % for latencies" << endl;
+	return regressions;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{"json",				required_argument, 0, 'j'},
+		{"baseline",			required_argument, 0, 'b'},
+		{"threshold",			required_argument, 0, 't'},
+		{"latency-threshold",	required_argument, 0, 'T'},
+		{"scenario",			required_argument, 0, 's'},
+		{"list",				no_argument,       0, 'l'},
+		{"node",				required_argument, 0, 'N'},
+		{0, 0, 0, 0}
+	};
+	string 				library 			= string(argv[0]).substr(0, string(argv[0]).find_last_of('/') + 1) + "libtoe_node.so";
+	string 				jsonFile 			= "benchmark.json";
+	string 				baselineFile;
+	double 				threshold 			= 5;
+	double 				latencyThreshold 	= 25;
+	set<string> 		selected;
+	vector<pair<string, vector<pair<string, double> > > > 	results;
+	benchmarkReport 	current;
+	benchmarkReport 	baseline;
+	bool 				failed 				= false;
+	int 				opt;
+
+	while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (opt) {
+			case 'j': jsonFile 			= optarg; 			break;
+			case 'b': baselineFile 		= optarg; 			break;
+			case 't': threshold 		= atof(optarg); 	break;
+			case 'T': latencyThreshold 	= atof(optarg); 	break;
+			case 's': selected.insert(optarg); 				break;
+			case 'N': library 			= optarg; 			break;
+			case 'l':
+				for (int s = 0; s < NUM_SCENARIOS; s++)
+					cout << setw(12) << left << scenarios[s].name << " " << scenarios[s].description << endl;
+				return 0;
+			default:
+				cerr << "[ERROR] unknown option, see the header of toe_benchmark.cpp" << endl;
+				return -1;
+		}
+	}
+	// The baseline is read first, a wrong path does not waste a whole run
+	if (!baselineFile.empty() && !readReport(baselineFile, baseline))
+		return -1;
+
+	cout << fixed << setprecision(3);
+	cout << "  " << setw(12) << left << "scenario" << right << setw(10) << "Gb/s" << setw(14) << "cycles/pkt";
+	cout << setw(10) << "reTx" << setw(12) << "rtt p50" << setw(12) << "rtt p99" << setw(12) << "sim s" << endl;
+	for (int s = 0; s < NUM_SCENARIOS; s++) {
+		const benchmarkScenario& 	bench = scenarios[s];
+		loopbackScenario 			scenario;
+		loopbackResult 				result;
+		vector<pair<string, double> > 	values;
+
+		if (!selected.empty() && selected.count(bench.name) == 0)
+			continue;
+		// The session table of this build is too small
+		if (bench.connections > MAX_SESSIONS) {
+			cout << dec << "  " << setw(12) << left << bench.name << right << " skipped, it needs MAX_SESSIONS >= " << bench.connections << endl;
+			continue;
+		}
+		scenario.client.transferSize 	= bench.bytes;
+		scenario.client.numConnections 	= bench.connections;
+		scenario.client.mss 			= bench.mss;
+		scenario.echo 					= bench.echo;
+		scenario.profile.bandwidth 		= bench.bandwidth;
+		scenario.profile.delay 			= bench.delay;
+		scenario.profile.loss 			= bench.loss;
+		scenario.profile.reorder 		= bench.reorder;
+		scenario.profile.bufferBytes 	= bench.bufferBytes;
+		scenario.client.memory 			= bench.memory;
+		if (!runLoopback(library, scenario, result))
+			return -1;
+
+		collect(bench, result, values);
+		results.push_back(make_pair(string(bench.name), values));
+		current[bench.name] = scenarioReport(values.begin(), values.end());
+
+		// The messages of the cores may leave the stream in hexadecimal
+		const scenarioReport& report = current[bench.name];
+		cout << dec << "  " << setw(12) << left << bench.name << right << setw(10) << report.at("gbps");
+		cout << setw(14) << report.at("cycles_per_packet") << setw(10) << (uint64_t) report.at("retransmissions");
+		cout << setw(12) << (uint64_t) report.at("rtt_p50") << setw(12) << (uint64_t) report.at("rtt_p99");
+		cout << setw(12) << result.simSeconds;
+		if (!result.completed) {
+			cout << "\tERROR delivered " << result.statsB.appRxBytes << " of " << result.expected << " bytes";
+			failed = true;
+		}
+		cout << endl;
+	}
+
+	if (jsonFile == "-") {
+		writeReport(cout, results);
+	}
+	else {
+		ofstream 	out(jsonFile.c_str());
+		if (!out) {
+			cerr << "ERROR: can not write " << jsonFile << endl;
+			return -1;
+		}
+		writeReport(out, results);
+	}
+
+	if (!baselineFile.empty() && compare(current, baseline, threshold, latencyThreshold) != 0)
+		failed = true;
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,348 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+#include "toe_node.hpp"
+#include "../TOE/session_lookup_controller/session_lookup_controller.hpp"
+#include "../TOE/testbench/dummy_memory.hpp"
+#include "../TOE/testbench/toe_models.hpp"
+#include "../TOE/common_utilities/common_utilities.hpp"
+#include "../echo_replay/echo_server_application.hpp"
+#include "../iperf2_tcp/iperf_client.hpp"
+#include <cstring>
+
+using namespace std;
+
+unsigned int	simCycleCounter		= 0;
+
+static stream<axiWord>					rxBufferWriteData("rxBufferWriteData");
+static stream<axiWord>					rxBufferReadData("rxBufferReadData");
+static stream<mmStatus>					rxBufferWriteStatus("rxBufferWriteStatus");
+static stream<mmCmd>					rxBufferWriteCmd("rxBufferWriteCmd");
+static stream<mmCmd>					rxBufferReadCmd("rxBufferReadCmd");
+static stream<axiWord>					txBufferWriteData("txBufferWriteData");
+static stream<axiWord>					txBufferReadData("txBufferReadData");
+static stream<mmStatus>					txBufferWriteStatus("txBufferWriteStatus");
+static stream<mmCmd>					txBufferWriteCmd("txBufferWriteCmd");
+static stream<mmCmd>					txBufferReadCmd("txBufferReadCmd");
+static stream<rtlSessionLookupReply>	sessionLookup_rsp("sessionLookup_rsp");
+static stream<rtlSessionUpdateReply>	sessionUpdate_rsp("sessionUpdate_rsp");
+static stream<rtlSessionLookupRequest>	sessionLookup_req("sessionLookup_req");
+static stream<rtlSessionUpdateRequest>	sessionUpdate_req("sessionUpdate_req");
+static stream<ap_uint<16> >				listenPortReq("listenPortReq");
+static stream<listenPortStatus>			listenPortRsp("listenPortRsp");
+static stream<appReadRequest>			rxAppReadRequest("rxAppReadRequest");
+static stream<appNotification>			rxAppNotification("rxAppNotification");
+static stream<ap_uint<16> >				rxAppReadRspID("rxAppReadRspID");
+static stream<axiWord>					rxDataToApp("rxDataToApp");
+static stream<axiWord>					rxDataApp("rxDataApp");
+static stream<ipTuple>					openConnReq("openConnReq");
+static stream<openStatus>				openConnRsp("openConnRsp");
+static stream<ap_uint<16> >				closeConnReq("closeConnReq");
+static stream<appTxMeta>				txAppMeta("txAppMeta");
+static stream<axiWord>					txAppData("txAppData");
+static stream<appTxRsp>					txAppRsp("txAppRsp");
+#if (TX_APP_WRITABLE_NOTIFICATION)
+static stream<appTxWritable>			txAppWritable("txAppWritable");
+#endif
+static stream<txApp_client_status>		clientNotification("clientNotification");
+static stream<axiWord>					txPseudoPacket("txPseudoPacket");
+static stream<ap_uint<16> >				txPseudoChecksum("txPseudoChecksum");
+static stream<axiWord>					rxPseudoPacket("rxPseudoPacket");
+static stream<ap_uint<16> >				rxPseudoChecksum("rxPseudoChecksum");
+#if (STATISTICS_MODULE)
+static stream<axiWord>					statsSnapshot("statsSnapshot");
+static statsRegs						statRegisters;
+#endif
+#if (RT_POLICY_TABLE)
+static rtPolicyRegs						rtPolicyRegisters;
+#endif
+#if (DROP_REPORTS)
+static stream<dropReport>				dropReports("dropReports");
+#if (DROP_CAPTURE)
+static stream<axiWord>					dropCapture("dropCapture");
+#endif
+#endif
+#if (INSTRUMENTATION)
+static instrRegs						instrRegisters;
+#endif
+#if (LATENCY_HISTOGRAM)
+static latencyRegs						latencyRegisters;
+#endif
+
+static dummyMemory						rxMemory;
+static dummyMemory						txMemory;
+static toeNodeConfig					nodeConfig;
+static iperf_regs						iperfSettings;
+static ap_uint<32>						myIpAddress;
+static ap_uint<16>						regSessionCount;
+static uint64_t							appRxBytes;
+static uint64_t							appRxLastCycle;
+static uint32_t							latHistogram[2][LAT_BUCKETS];
+static uint32_t							latBucketLows[LAT_BUCKETS];
+
+void toe_node_init(const toeNodeConfig* config)
+{
+	nodeConfig = *config;
+	myIpAddress = byteSwap32(ap_uint<32>(config->ipAddress));
+
+	iperfSettings.runExperiment 	= 0;
+	iperfSettings.dualModeEn 		= 0;
+	iperfSettings.useTimer 			= (config->runTime != 0);
+	iperfSettings.runTime 			= config->runTime;
+	iperfSettings.numConnections 	= config->numConnections;
+	iperfSettings.transfer_size 	= config->transferSize;
+	iperfSettings.packet_mss 		= config->mss;
+	iperfSettings.ipDestination 	= config->dstAddress;
+	iperfSettings.dstPort 			= config->dstPort;
+
+#if (STATISTICS_MODULE)
+	statRegisters.readEnable 		= false;
+	statRegisters.userID 			= 0;
+	statRegisters.snapshotInterval 	= 0;
+#endif
+#if (RT_POLICY_TABLE)
+	rtPolicyRegisters.profileWrite 	= 0;
+	rtPolicyRegisters.portWrite 	= 0;
+	rtPolicyRegisters.sessionWrite 	= 0;
+	// The timers count scans of the session table, one every MAX_SESSIONS cycles
+	rtPolicyRegisters.profileID 	= 0;
+	rtPolicyRegisters.rtoMin 		= config->rtoMin / MAX_SESSIONS + 1;
+	rtPolicyRegisters.rtoMax 		= (config->rtoMin / MAX_SESSIONS + 1) * 64;
+	rtPolicyRegisters.backoffShift 	= 1;
+	rtPolicyRegisters.maxRetries 	= 4;
+	rtPolicyRegisters.synMaxRetries = 4;
+#endif
+#if (LATENCY_HISTOGRAM)
+	latencyRegisters.readEnable 	= 0;
+	latencyRegisters.group 			= 0;
+	latencyRegisters.sessionID 		= 0;
+	latencyRegisters.clear 			= 0;
+	latencyRegisters.portWrite 		= 0;
+	latencyRegisters.sessionWrite 	= 0;
+#endif
+	if (config->memory == NODE_MEMORY_IDEAL) {
+		rxMemory.clearTiming();
+		txMemory.clearTiming();
+	}
+	else {
+		rxMemory.setTiming((config->memory == NODE_MEMORY_HBM) ? HBM_TIMING : DDR4_TIMING);
+		txMemory.setTiming((config->memory == NODE_MEMORY_HBM) ? HBM_TIMING : DDR4_TIMING);
+	}
+	appRxBytes 		= 0;
+	appRxLastCycle 	= 0;
+	memset(latHistogram, 0, sizeof(latHistogram));
+	memset(latBucketLows, 0, sizeof(latBucketLows));
+}
+
+void toe_node_step(stream<axiWord>* ipRxData, stream<axiWord>* ipTxData, unsigned int cycle)
+{
+	axiWord 	currWord;
+
+	simCycleCounter = cycle;
+	iperfSettings.runExperiment = nodeConfig.runClient && (cycle >= nodeConfig.startCycle);
+#if (RT_POLICY_TABLE)
+	rtPolicyRegisters.profileWrite 	= (nodeConfig.rtoMin != 0) && (cycle == 1);
+#endif
+#if (LATENCY_HISTOGRAM)
+	// One bucket of the histograms of group 0 is read every two cycles
+	latencyRegisters.readEnable 	= cycle % 2;
+	latencyRegisters.kind 			= (cycle / 2) / LAT_BUCKETS % 2;
+	latencyRegisters.bucket 		= (cycle / 2) % LAT_BUCKETS;
+#endif
+
+	toe(
+		*ipRxData,
+#if (!RX_DDR_BYPASS)
+		rxBufferWriteStatus,
+		rxBufferWriteCmd,
+		rxBufferReadCmd,
+		rxBufferReadData,
+		rxBufferWriteData,
+#endif
+		txBufferWriteStatus,
+		txBufferReadData,
+		*ipTxData,
+		txBufferWriteCmd,
+		txBufferReadCmd,
+		txBufferWriteData,
+		sessionLookup_rsp,
+		sessionUpdate_rsp,
+		sessionLookup_req,
+		sessionUpdate_req,
+		listenPortReq,
+		rxAppReadRequest,
+		openConnReq,
+		closeConnReq,
+		txAppMeta,
+		txAppData,
+		listenPortRsp,
+		rxAppNotification,
+		clientNotification,
+		rxAppReadRspID,
+		rxDataToApp,
+		openConnRsp,
+		txAppRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+		txAppWritable,
+#endif
+#if (STATISTICS_MODULE)
+		statRegisters,
+		statsSnapshot,
+#endif
+#if (RT_POLICY_TABLE)
+		rtPolicyRegisters,
+#endif
+#if (DROP_REPORTS)
+		dropReports,
+#if (DROP_CAPTURE)
+		dropCapture,
+#endif
+#endif
+#if (INSTRUMENTATION)
+		instrRegisters,
+#endif
+#if (LATENCY_HISTOGRAM)
+		latencyRegisters,
+#endif
+		myIpAddress,
+		regSessionCount,
+		txPseudoPacket,
+		txPseudoChecksum,
+		rxPseudoPacket,
+		rxPseudoChecksum);
+
+	// The payload handed to the application is the goodput of the node
+	while (!rxDataToApp.empty()) {
+		rxDataToApp.read(currWord);
+		appRxBytes += keep2len(currWord.keep);
+		appRxLastCycle = cycle;
+		rxDataApp.write(currWord);
+	}
+
+	if (nodeConfig.app == NODE_ECHO) {
+		echo_server_application(
+			listenPortReq,
+			listenPortRsp,
+			rxAppNotification,
+			rxAppReadRequest,
+			rxAppReadRspID,
+			rxDataApp,
+			openConnReq,
+			openConnRsp,
+			closeConnReq,
+			txAppMeta,
+			txAppData,
+			txAppRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			txAppWritable,
+#endif
+			clientNotification);
+	}
+	else {
+		iperf2_client(
+			listenPortReq,
+			listenPortRsp,
+			rxAppNotification,
+			rxAppReadRequest,
+			rxAppReadRspID,
+			rxDataApp,
+			openConnReq,
+			openConnRsp,
+			closeConnReq,
+			txAppMeta,
+			txAppRsp,
+#if (TX_APP_WRITABLE_NOTIFICATION)
+			txAppWritable,
+#endif
+			txAppData,
+			clientNotification,
+			iperfSettings);
+	}
+
+#if (!RX_DDR_BYPASS)
+	simulateRx(&rxMemory, rxBufferWriteCmd, rxBufferWriteStatus, rxBufferReadCmd, rxBufferWriteData, rxBufferReadData);
+#endif
+	simulateTx(&txMemory, txBufferWriteCmd, txBufferWriteStatus, txBufferReadCmd, txBufferWriteData, txBufferReadData);
+	sessionLookupStub(sessionLookup_req, sessionLookup_rsp, sessionUpdate_req, sessionUpdate_rsp);
+	compute_pseudo_tcp_checksum(txPseudoPacket, txPseudoChecksum, 0);
+	compute_pseudo_tcp_checksum(rxPseudoPacket, rxPseudoChecksum, 1);
+
+#if (LATENCY_HISTOGRAM)
+	if (latencyRegisters.readEnable) {
+		latHistogram[latencyRegisters.kind][latencyRegisters.bucket] 	= latencyRegisters.bucketCount;
+		latBucketLows[latencyRegisters.bucket] 							= latencyRegisters.bucketLow;
+	}
+#endif
+
+	// Outputs nobody looks at in the loopback
+#if (STATISTICS_MODULE)
+	while (!statsSnapshot.empty())
+		statsSnapshot.read();
+#endif
+#if (DROP_REPORTS)
+	while (!dropReports.empty())
+		dropReports.read();
+#if (DROP_CAPTURE)
+	while (!dropCapture.empty())
+		dropCapture.read();
+#endif
+#endif
+}
+
+void toe_node_stats(toeNodeStats* stats)
+{
+#if (STATISTICS_MODULE)
+	stats->txBytes 				= statRegisters.globalTxBytes;
+	stats->txPackets 			= statRegisters.globalTxPackets;
+	stats->txRetransmissions 	= statRegisters.globalTxRetransmissions;
+	stats->rxBytes 				= statRegisters.globalRxBytes;
+	stats->rxPackets 			= statRegisters.globalRxPackets;
+	stats->rxDrops 				= statRegisters.globalRxDrops;
+#else
+	stats->txBytes = stats->txPackets = stats->txRetransmissions = 0;
+	stats->rxBytes = stats->rxPackets = stats->rxDrops = 0;
+#endif
+	stats->appRxBytes 			= appRxBytes;
+	stats->appRxLastCycle 		= appRxLastCycle;
+	stats->sessions 			= regSessionCount;
+	stats->memoryBytes 			= rxMemory.stats().readBytes + rxMemory.stats().writeBytes +
+								  txMemory.stats().readBytes + txMemory.stats().writeBytes;
+	stats->memoryRowMisses 		= rxMemory.stats().rowMisses + txMemory.stats().rowMisses;
+	stats->memoryStallCycles 	= rxMemory.stats().stallCycles + txMemory.stats().stallCycles;
+	for (int b = 0; b < LAT_BUCKETS; b++) {
+		stats->latencyCount[0][b] 	= latHistogram[0][b];
+		stats->latencyCount[1][b] 	= latHistogram[1][b];
+		stats->latencyLow[b] 		= latBucketLows[b];
+	}
+}
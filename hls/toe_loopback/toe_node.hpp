@@ -0,0 +1,101 @@
+/************************************************
+BSD 3-Clause License
+
+Copyright (c) 2019, HPCN Group, UAM Spain (hpcn-uam.es)
+and Systems Group, ETH Zurich (systems.ethz.ch)
+All rights reserved.
+
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+************************************************/
+
+#ifndef _TOE_NODE_H_
+#define _TOE_NODE_H_
+
+#include "../TOE/toe.hpp"
+
+/*
+ * One end of the loopback: a toe() with its application, the session lookup table,
+ * the checksum and the buffer memories of the testbench. The state of every core is
+ * static, so each node is a private copy of the toe_node shared object, loaded with
+ * dlopen() by test_toe_loopback. The interface is plain C to be looked up with dlsym()
+ */
+
+/* Application next to the TOE */
+enum toeNodeApp {NODE_IPERF, NODE_ECHO};
+
+/* Timing of the RX and TX buffer memories, ideal answers at once */
+enum toeNodeMemory {NODE_MEMORY_IDEAL, NODE_MEMORY_DDR4, NODE_MEMORY_HBM};
+
+struct toeNodeConfig {
+	uint32_t		ipAddress;			// 192.168.0.5 is 0xC0A80005
+	toeNodeApp		app;
+	// iperf client, the server side of iperf listens on 5001 and up, the echo server on 15000
+	bool			runClient;
+	uint32_t		dstAddress;
+	uint16_t		dstPort;
+	uint16_t		numConnections;
+	uint16_t		mss;
+	uint32_t		transferSize;		// bytes split among the connections, unless runTime is not 0
+	uint64_t		runTime;			// cycles
+	uint64_t		startCycle;			// rising edge of runExperiment
+	uint64_t		rtoMin;				// cycles, 0 keeps the default retransmit profile
+	toeNodeMemory	memory;
+};
+
+struct toeNodeStats {
+	uint64_t		txBytes;			// payload, from the statistics module
+	uint64_t		txPackets;
+	uint64_t		txRetransmissions;
+	uint64_t		rxBytes;
+	uint64_t		rxPackets;
+	uint64_t		rxDrops;
+	uint64_t		appRxBytes;			// payload delivered to the application
+	uint64_t		appRxLastCycle;		// cycle of the last delivered word
+	uint16_t		sessions;
+	// Buffer memories, RX and TX added up, zero with the ideal memory
+	uint64_t		memoryBytes;		// read and written
+	uint64_t		memoryRowMisses;
+	uint64_t		memoryStallCycles;
+	// Latency histograms of session group 0, kind 0 is write to wire and 1 round trip,
+	// polled continuously, a bucket is up to date after 4 * LAT_BUCKETS cycles
+	uint32_t		latencyCount[2][LAT_BUCKETS];
+	uint32_t		latencyLow[LAT_BUCKETS];	// lowest latency of each bucket in cycles
+};
+
+extern "C" {
+	void toe_node_init(const toeNodeConfig* config);
+	/* One cycle of the node, ipRxData comes from the link and ipTxData goes to it */
+	void toe_node_step(stream<axiWord>* ipRxData, stream<axiWord>* ipTxData, unsigned int cycle);
+	void toe_node_stats(toeNodeStats* stats);
+}
+
+typedef void (*toeNodeInit_t)(const toeNodeConfig*);
+typedef void (*toeNodeStep_t)(stream<axiWord>*, stream<axiWord>*, unsigned int);
+typedef void (*toeNodeStats_t)(toeNodeStats*);
+
+#endif
@@ -111,8 +111,6 @@ void managePasiveConnections(
     static op_states op_fsm_state = OPEN_PORT;
 #pragma HLS RESET variable=op_fsm_state
 
-    enum consumeFsmStateType {GET_DATA_NOTY , WAIT_SESSION_ID, CONSUME};
-    static consumeFsmStateType  serverFsmState = GET_DATA_NOTY;
     static ap_uint<16>      listen_port;
     
     listenPortStatus        listen_rsp;
@@ -0,0 +1,58 @@
+# Synthesis timing comparison of the keep and alignment helpers.
+# Every former implementation (chain/case/table) and its tree based
+# replacement is synthesized as a top of its own, the estimated clock
+# period of each one is printed and written to timing_summary.csv
+
+# Get the root folder
+set root_folder [lindex $argv 2]
+# Get project name from the arguments
+set proj_name [lindex $argv 3]
+# Get FPGA part 
+set fpga_part [lindex $argv 4]
+
+set tops [list \
+	keep2len_chain_512 keep2len_tree_512 \
+	keep2len_chain_1024 keep2len_tree_1024 popcount_tree_1024 \
+	len2keep_table_512 len2keep_tree_512 \
+	align_from_memory_case_512 align_from_memory_tree_512 \
+	align_to_memory_case_512 align_to_memory_tree_512 \
+	align_to_memory_case_1024 align_to_memory_tree_1024]
+
+# Create project
+open_project ${proj_name}
+
+add_files ${root_folder}/hls/TOE/common_utilities/bit_utilities_timing.cpp
+add_files ${root_folder}/hls/TOE/common_utilities/common_utilities.cpp
+
+add_files -tb ${root_folder}/hls/TOE/common_utilities/common_utilities_tb.cpp
+
+set summary [open "timing_summary.csv" w]
+puts $summary "top,target_ns,estimated_ns,latency,lut,ff"
+
+foreach top $tops {
+	set_top ${top}
+	open_solution ${top}
+	set_part ${fpga_part} -tool vivado
+	create_clock -period 2.5 -name default
+	set_clock_uncertainty 0.2
+	config_interface -register_io scalar_all
+
+	if {$top == [lindex $tops 0]} {
+		csim_design
+	}
+	csynth_design
+
+	set report [open "${proj_name}/${top}/syn/report/${top}_csynth.xml" r]
+	set xml [read $report]
+	close $report
+	regexp {<EstimatedClockPeriod>([0-9.]+)</EstimatedClockPeriod>} $xml -> estimated
+	regexp {<Worst-caseLatency>([0-9]+)</Worst-caseLatency>} $xml -> latency
+	regexp {<LUT>([0-9]+)</LUT>} $xml -> lut
+	regexp {<FF>([0-9]+)</FF>} $xml -> ff
+	puts "${top}: estimated clock ${estimated} ns, latency ${latency}, LUT ${lut}, FF ${ff}"
+	puts $summary "${top},2.5,${estimated},${latency},${lut},${ff}"
+	close_solution
+}
+
+close $summary
+exit
@@ -11,6 +11,7 @@ set_top echo_server_application
 
 add_files ${root_folder}/hls/echo_replay/echo_server_application.cpp
 add_files -tb ${root_folder}/hls/echo_replay/test_echo_server_application.cpp
+add_files -tb ${root_folder}/hls/TOE/testbench/tx_app_model.cpp
 
 open_solution "ultrascale_plus"
 set_part ${fpga_part} -tool vivado
@@ -11,6 +11,8 @@ set_top ethernet_header_inserter
 
 add_files ${root_folder}/hls/ethernet_inserter/ethernet_header_inserter.cpp
 add_files -tb ${root_folder}/hls/ethernet_inserter/ethernet_header_inserter_test.cpp
+add_files -tb ${root_folder}/hls/TOE/testbench/pcap.cpp
+add_files -tb ${root_folder}/hls/TOE/testbench/pcap_file.cpp
 
 open_solution "ultrascale_plus"
 set_part ${fpga_part} -tool vivado
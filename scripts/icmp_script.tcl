@@ -14,6 +14,7 @@ add_files ${root_folder}/hls/icmp_server/icmp_server.cpp
 add_files -tb ${root_folder}/hls/icmp_server/test_icmp_server.cpp -cflags "-Ihls/TOE/testbench/."
 add_files -tb ${root_folder}/hls/TOE/testbench/pcap2stream.cpp -cflags "-Ihls/TOE/testbench/."
 add_files -tb ${root_folder}/hls/TOE/testbench/pcap.cpp -cflags "-Ihls/TOE/testbench/."
+add_files -tb ${root_folder}/hls/TOE/testbench/pcap_file.cpp -cflags "-Ihls/TOE/testbench/."
 
 open_solution "ultrascale_plus"
 set_part ${fpga_part} -tool vivado
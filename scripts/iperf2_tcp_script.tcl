@@ -14,6 +14,7 @@ add_files ${root_folder}/hls/iperf2_tcp/iperf_client.cpp
 add_files ${root_folder}/hls/TOE/common_utilities/common_utilities.cpp
 
 add_files -tb ${root_folder}/hls/iperf2_tcp/test_iperf_client.cpp
+add_files -tb ${root_folder}/hls/TOE/testbench/tx_app_model.cpp
 
 open_solution "ultrascale_plus"
 set_part ${fpga_part} -tool vivado
@@ -0,0 +1,25 @@
+# Get the root folder
+set root_folder [lindex $argv 2]
+# Get project name from the arguments
+set proj_name [lindex $argv 3]
+# Get FPGA part 
+set fpga_part [lindex $argv 4]
+# Create project
+open_project ${proj_name}
+
+set_top memory_interleaver
+
+add_files ${root_folder}/hls/memory_interleaver/memory_interleaver.cpp
+add_files ${root_folder}/hls/TOE/common_utilities/common_utilities.cpp
+add_files -tb ${root_folder}/hls/memory_interleaver/test_memory_interleaver.cpp
+add_files -tb ${root_folder}/hls/TOE/testbench/dummy_memory.cpp
+
+open_solution "ultrascale_plus"
+set_part ${fpga_part} -tool vivado
+create_clock -period 3.1 -name default
+set_clock_uncertainty 0.2
+
+csynth_design
+
+export_design -rtl verilog -format ip_catalog
+exit
@@ -14,6 +14,7 @@ add_files ${root_folder}/hls/port_handler/port_handler.cpp
 
 add_files -tb ${root_folder}/hls/port_handler/port_handler_tb.cpp -cflags ""
 add_files -tb ${root_folder}/hls/TOE/testbench/pcap.cpp -cflags ""
+add_files -tb ${root_folder}/hls/TOE/testbench/pcap_file.cpp -cflags ""
 add_files -tb ${root_folder}/hls/TOE/testbench/pcap2stream.cpp -cflags ""
 
 open_solution "ultrascale_plus"
@@ -0,0 +1,25 @@
+# Get the root folder
+set root_folder [lindex $argv 2]
+# Get project name from the arguments
+set proj_name [lindex $argv 3]
+# Get FPGA part 
+set fpga_part [lindex $argv 4]
+# Create project
+open_project ${proj_name}
+
+set_top rx_zero_copy
+
+add_files ${root_folder}/hls/TOE/rx_zero_copy/rx_zero_copy.cpp
+add_files ${root_folder}/hls/TOE/common_utilities/common_utilities.cpp
+add_files -tb ${root_folder}/hls/TOE/rx_zero_copy/test_rx_zero_copy.cpp
+add_files -tb ${root_folder}/hls/TOE/rx_app_stream_if/rx_app_stream_if.cpp
+
+open_solution "ultrascale_plus"
+set_part ${fpga_part} -tool vivado
+create_clock -period 3.1 -name default
+set_clock_uncertainty 0.2
+
+csynth_design
+
+export_design -rtl verilog -format ip_catalog
+exit
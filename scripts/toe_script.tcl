@@ -16,6 +16,7 @@ add_files ${root_folder}/hls/TOE/port_table/port_table.cpp
 add_files ${root_folder}/hls/TOE/probe_timer/probe_timer.cpp
 add_files ${root_folder}/hls/TOE/retransmit_timer/retransmit_timer.cpp
 add_files ${root_folder}/hls/TOE/rx_app_stream_if/rx_app_stream_if.cpp
+add_files ${root_folder}/hls/TOE/rx_session_queues/rx_session_queues.cpp
 add_files ${root_folder}/hls/TOE/rx_engine/rx_engine.cpp
 add_files ${root_folder}/hls/TOE/rx_sar_table/rx_sar_table.cpp
 add_files ${root_folder}/hls/TOE/session_lookup_controller/session_lookup_controller.cpp
@@ -29,11 +30,15 @@ add_files ${root_folder}/hls/TOE/tx_app_stream_if/tx_app_stream_if.cpp
 add_files ${root_folder}/hls/TOE/tx_engine/tx_engine.cpp
 add_files ${root_folder}/hls/TOE/tx_sar_table/tx_sar_table.cpp
 add_files ${root_folder}/hls/TOE/statistics/statistics.cpp
+add_files ${root_folder}/hls/TOE/instrumentation/instrumentation.cpp
+add_files ${root_folder}/hls/TOE/latency_histogram/latency_histogram.cpp
 
 add_files -tb ${root_folder}/hls/iperf2_tcp/iperf_client.cpp
 add_files -tb ${root_folder}/hls/echo_replay/echo_server_application.cpp
 add_files -tb ${root_folder}/hls/TOE/testbench/dummy_memory.cpp
+add_files -tb ${root_folder}/hls/TOE/testbench/toe_models.cpp
 add_files -tb ${root_folder}/hls/TOE/testbench/pcap.cpp
+add_files -tb ${root_folder}/hls/TOE/testbench/pcap_file.cpp
 add_files -tb ${root_folder}/hls/TOE/testbench/pcap2stream.cpp
 add_files -tb ${root_folder}/hls/TOE/testbench/test_toe.cpp
 